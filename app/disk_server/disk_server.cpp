@@ -1,12 +1,15 @@
 ﻿#include <iostream>
+#include <string>
 
 #ifdef _WIN32
 #include <Windows.h>
 #else
 #include <signal.h>
+#include <unistd.h>
 #endif
 
 #include "crossocean.h"
+#include "replication.h"
 #include "thread_pool.h"
 
 using namespace std;
@@ -37,11 +40,35 @@ int main(int argc, char const* argv[]) {
     thread_num = atoi(argv[2]);
   }
   if (argc == 1) {
-    cout << "Usage: hdisk_server [server_port] [thread_num]" << endl;
+    cout << "Usage: hdisk_server [server_port] [thread_num] [replica_root] "
+            "[node_address]"
+         << endl;
   }
   cout << "Starting hdisk_server on port " << server_port << "..." << endl;
   cout << "Using thread pool size: " << thread_num << endl;
 
+  // 指定数据目录时作为链式复制的副本节点运行
+  if (argc > 3) {
+    ReplicaOptions options;
+    options.port = server_port;
+    options.threads = thread_num;
+    options.root = argv[3];
+    // 集群模式下本节点在分片表中的地址
+    options.address = argc > 4 ? string(argv[4])
+                               : "127.0.0.1:" + to_string(server_port);
+    ReplicaServer server(options);
+    if (!server.Start()) {
+      cerr << "main(): failed to start replica on " << server_port << endl;
+      return -1;
+    }
+    cout << "Serving replica root " << options.root << endl;
+#ifdef _WIN32
+    while (true) Sleep(INFINITE);
+#else
+    while (true) pause();
+#endif
+  }
+
   // 初始化线程池
   ThreadPool::GetInstance()->Init(thread_num);
 
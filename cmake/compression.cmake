@@ -0,0 +1,34 @@
+# compression.cmake 提供压缩库的查找和链接
+
+# 链接压缩库: zlib 必选, zstd 可选(找到时定义 CROSSOCEAN_WITH_ZSTD)
+macro(link_compression name)
+  find_package(ZLIB REQUIRED)
+  target_link_libraries(${name} PRIVATE ZLIB::ZLIB)
+
+  set(ZSTD_ENABLED OFF)
+  if(WIN32)
+    find_package(zstd CONFIG QUIET)
+    if(zstd_FOUND)
+      set(ZSTD_ENABLED ON)
+      if(TARGET zstd::libzstd_shared)
+        target_link_libraries(${name} PRIVATE zstd::libzstd_shared)
+      else()
+        target_link_libraries(${name} PRIVATE zstd::libzstd_static)
+      endif()
+    endif()
+  else()
+    find_package(PkgConfig REQUIRED)
+    pkg_check_modules(ZSTD QUIET libzstd)
+    if(ZSTD_FOUND)
+      set(ZSTD_ENABLED ON)
+      target_include_directories(${name} PRIVATE ${ZSTD_INCLUDE_DIRS})
+      target_link_libraries(${name} PRIVATE ${ZSTD_LIBRARIES})
+      target_link_directories(${name} PRIVATE ${ZSTD_LIBRARY_DIRS})
+    endif()
+  endif()
+
+  message("${name} zstd = ${ZSTD_ENABLED}")
+  if(ZSTD_ENABLED)
+    target_compile_definitions(${name} PRIVATE CROSSOCEAN_WITH_ZSTD)
+  endif()
+endmacro()
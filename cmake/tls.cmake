@@ -0,0 +1,8 @@
+# tls.cmake 提供 OpenSSL 的查找和链接
+
+# 链接 OpenSSL(TLS 和 kTLS 需要 OpenSSL 3.0 及以上版本)
+macro(link_tls name)
+  find_package(OpenSSL 3.0 REQUIRED)
+  message("${name} OpenSSL = ${OPENSSL_VERSION}")
+  target_link_libraries(${name} PRIVATE OpenSSL::SSL OpenSSL::Crypto)
+endmacro()
@@ -0,0 +1,471 @@
+﻿/**
+ * @file batch_download.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `BatchDownload`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/batch_download.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+
+#ifdef _WIN32
+#include <io.h>
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include "include/blocking_pool.h"
+#include "util.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief ustar头部中文件名字段的长度
+static const size_t kNameSize = 100;
+/// @brief ustar头部中文件名前缀字段的长度
+static const size_t kPrefixSize = 155;
+/// @brief 文件内容缩短时补0的缓冲区大小
+static const size_t kZeroBufferSize = 64 * 1024;
+/// @brief 未在等待文件打开
+static const size_t kNotWaiting = static_cast<size_t>(-1);
+
+/**
+ * @brief 与打开工作共享的状态, `BatchDownload`销毁后由未完成的工作继续持有
+ */
+struct BatchDownload::Shared {
+  mutex mutex_;
+  /// @brief 文件缓存
+  FileCache* cache = nullptr;
+  /// @brief 未指定缓存时使用的内部缓存
+  unique_ptr<FileCache> own_cache;
+  /// @brief 每个文件打开的结果, 打开失败为`nullptr`
+  vector<OpenFilePtr> files;
+  /// @brief 每个文件是否已完成打开
+  vector<char> opened;
+  /// @brief 发送游标等待的文件序号
+  size_t wait_index = kNotWaiting;
+  /// @brief 等待的文件打开后的回调
+  Ready ready;
+  /// @brief 执行回调的线程
+  Thread* thread = nullptr;
+  /// @brief 批量下载已销毁, 未开始的打开工作直接跳过
+  bool cancelled = false;
+};
+
+/**
+ * @brief 把整数以八进制写入tar头部字段(以NUL结尾), 放不下时使用base-256编码
+ *
+ * @param field 字段起始位置
+ * @param width 字段长度
+ * @param value 整数值
+ */
+static void PutOctal(char* field, size_t width, uint64_t value) {
+  int bits = static_cast<int>((width - 1) * 3);
+  if (bits >= 64 || value < (1ULL << bits)) {
+    field[width - 1] = '\0';
+    for (size_t i = width - 1; i > 0; --i) {
+      field[i - 1] = static_cast<char>('0' + (value & 7));
+      value >>= 3;
+    }
+    return;
+  }
+  // GNU扩展: 首字节最高位置1, 其余字节为大端序的二进制值
+  for (size_t i = width; i > 1; --i) {
+    field[i - 1] = static_cast<char>(value & 0xff);
+    value >>= 8;
+  }
+  field[0] = static_cast<char>(0x80);
+}
+
+/**
+ * @brief 生成一个ustar头部块
+ *
+ * @param name 文件名字段
+ * @param prefix 文件名前缀字段
+ * @param type 类型标志
+ * @param size 内容大小
+ * @param mtime 修改时间(秒)
+ * @return std::string 512字节的头部块
+ */
+static string MakeBlock(const string& name, const string& prefix, char type,
+                        long long size, long long mtime) {
+  string block(BatchDownload::kBlockSize, '\0');
+  char* header = &block[0];
+  memcpy(header, name.data(), min(name.size(), kNameSize));
+  PutOctal(header + 100, 8, 0644);
+  PutOctal(header + 108, 8, 0);
+  PutOctal(header + 116, 8, 0);
+  PutOctal(header + 124, 12, static_cast<uint64_t>(size));
+  PutOctal(header + 136, 12, static_cast<uint64_t>(max(mtime, 0LL)));
+  header[156] = type;
+  memcpy(header + 257, "ustar", 6);
+  memcpy(header + 263, "00", 2);
+  memcpy(header + 345, prefix.data(), min(prefix.size(), kPrefixSize));
+
+  // 校验和按校验和字段为8个空格计算
+  memset(header + 148, ' ', 8);
+  unsigned int sum = 0;
+  for (char c : block) sum += static_cast<unsigned char>(c);
+  PutOctal(header + 148, 7, sum);
+  header[155] = ' ';
+  return block;
+}
+
+/**
+ * @brief 构造批量下载
+ *
+ * @param pool 打开文件的阻塞I/O线程池, 为`nullptr`时在调用线程中打开
+ * @param cache 文件缓存, 为`nullptr`时使用内部的缓存
+ * @param entries 要发送的文件, 按顺序写入tar流
+ * @param lookahead 发送游标之前提前打开的文件数量
+ */
+BatchDownload::BatchDownload(BlockingPool* pool, FileCache* cache,
+                             vector<BatchEntry> entries, int lookahead)
+    : pool_(pool),
+      entries_(move(entries)),
+      lookahead_(lookahead > 0 ? lookahead : 1),
+      shared_(make_shared<Shared>()) {
+  if (cache) {
+    shared_->cache = cache;
+  } else {
+    shared_->own_cache = make_unique<FileCache>(lookahead_ + 1);
+    shared_->cache = shared_->own_cache.get();
+  }
+  shared_->files.resize(entries_.size());
+  shared_->opened.resize(entries_.size(), 0);
+}
+
+/**
+ * @brief 丢弃未发送的文件, 打开中的工作完成后释放文件
+ */
+BatchDownload::~BatchDownload() {
+  lock_guard<mutex> lock(shared_->mutex_);
+  shared_->cancelled = true;
+  shared_->ready = nullptr;
+  shared_->files.clear();
+}
+
+/**
+ * @brief 列出目录中路径以前缀开头的所有普通文件(按名称排序)
+ *
+ * 前缀为绝对路径或含`..`时返回空列表; 符号链接(包括前缀中的目录)不会被
+ * 跟随, 列出的文件都在`root`之内.
+ *
+ * @param root 根目录
+ * @param prefix 相对`root`的路径前缀, 如`src/`或`src/main`, 空为全部
+ * @return std::vector<BatchEntry> 文件列表, 名称相对`root`
+ */
+vector<BatchEntry> BatchDownload::List(const string& root,
+                                       const string& prefix) {
+  vector<BatchEntry> entries;
+  if (!prefix.empty() && !ValidRelativePath(prefix)) return entries;
+
+  // 只遍历前缀中最后一个`/`之前的目录, 其中的每一级都不能是符号链接
+  error_code ec;
+  size_t slash = prefix.rfind('/');
+  fs::path base = fs::path(root);
+  if (slash != string::npos) {
+    for (const auto& part : fs::path(prefix.substr(0, slash))) {
+      base /= part;
+      if (fs::is_symlink(fs::symlink_status(base, ec))) return entries;
+    }
+  }
+
+  fs::recursive_directory_iterator it(
+      base, fs::directory_options::skip_permission_denied, ec);
+  if (ec) return entries;
+  for (fs::recursive_directory_iterator end; it != end; it.increment(ec)) {
+    if (ec) break;
+    if (it->is_symlink(ec) || !it->is_regular_file(ec)) continue;
+    string name = it->path().lexically_relative(root).generic_string();
+    if (name.compare(0, prefix.size(), prefix) != 0) continue;
+    entries.push_back({name, it->path().string()});
+  }
+  sort(entries.begin(), entries.end(),
+       [](const BatchEntry& a, const BatchEntry& b) {
+         return a.name < b.name;
+       });
+  return entries;
+}
+
+/**
+ * @brief 开始提前打开文件
+ *
+ * @param thread 执行打开完成回调的线程, 为`nullptr`时在工作线程中执行
+ * @param ready 发送游标等待的文件打开后调用(在`thread`中执行)
+ */
+void BatchDownload::Start(Thread* thread, Ready ready) {
+  {
+    lock_guard<mutex> lock(shared_->mutex_);
+    shared_->thread = thread;
+    shared_->ready = move(ready);
+  }
+  started_ = true;
+  FillAhead();
+}
+
+/**
+ * @brief 提交打开工作, 使游标之前的打开数量达到`lookahead`
+ */
+void BatchDownload::FillAhead() {
+  while (next_open_ < entries_.size() &&
+         next_open_ < cursor_ + static_cast<size_t>(lookahead_)) {
+    size_t index = next_open_++;
+    shared_ptr<Shared> shared = shared_;
+    string path = entries_[index].path;
+    auto work = [shared, path, index]() {
+      {
+        lock_guard<mutex> lock(shared->mutex_);
+        if (shared->cancelled) return;
+      }
+      OpenFilePtr file = shared->cache->Open(path);
+      lock_guard<mutex> lock(shared->mutex_);
+      if (shared->cancelled) return;
+      shared->files[index] = move(file);
+      shared->opened[index] = 1;
+    };
+    auto done = [shared, index]() {
+      Ready ready;
+      {
+        lock_guard<mutex> lock(shared->mutex_);
+        if (shared->wait_index != index) return;
+        shared->wait_index = kNotWaiting;
+        ready = shared->ready;
+      }
+      if (ready) ready();
+    };
+    Thread* thread = nullptr;
+    {
+      lock_guard<mutex> lock(shared_->mutex_);
+      thread = shared_->thread;
+    }
+    if (!pool_ || !pool_->Submit(work, thread, done)) work();
+  }
+}
+
+/**
+ * @brief 向非阻塞socket发送尽可能多的数据
+ *
+ * @param sock 目标socket
+ * @return long long 本次发送的字节数, 出错返回-1
+ */
+long long BatchDownload::Pump(int sock) {
+  if (!started_) Start(nullptr, nullptr);
+
+  long long total = 0;
+  while (!finished_) {
+    if (pending_pos_ < pending_.size()) {
+      long long n = SendPending(sock);
+      if (n < 0) return -1;
+      total += n;
+      if (pending_pos_ < pending_.size()) return total;
+      pending_.clear();
+      pending_pos_ = 0;
+      if (stage_ == Stage::kTrailer) finished_ = true;
+      continue;
+    }
+
+    if (stage_ == Stage::kBody) {
+      long long n = SendBody(sock);
+      if (n < 0) return -1;
+      total += n;
+      if (body_pos_ < file_->size) return total;
+      // 内容之后用0填充到块边界
+      long long tail = file_->size % kBlockSize;
+      if (tail != 0) pending_.assign(kBlockSize - tail, '\0');
+      ++stats_.files;
+      file_.reset();
+      ++cursor_;
+      stage_ = Stage::kHeader;
+      FillAhead();
+      continue;
+    }
+
+    if (stage_ == Stage::kTrailer) break;
+    if (cursor_ == entries_.size()) {
+      // 两个全0块表示归档结束
+      pending_.assign(2 * kBlockSize, '\0');
+      stage_ = Stage::kTrailer;
+      continue;
+    }
+
+    OpenFilePtr file;
+    bool opened = false;
+    {
+      lock_guard<mutex> lock(shared_->mutex_);
+      opened = shared_->opened[cursor_] != 0;
+      if (opened) {
+        file = move(shared_->files[cursor_]);
+      } else {
+        shared_->wait_index = cursor_;
+      }
+    }
+    if (!opened) {
+      if (!waiting_) ++stats_.stalls;
+      waiting_ = true;
+      return total;
+    }
+    waiting_ = false;
+
+    if (!file) {
+      cerr << "BatchDownload::Pump() Skip " << entries_[cursor_].path
+           << endl;
+      ++stats_.skipped;
+      ++cursor_;
+      FillAhead();
+      continue;
+    }
+    pending_ = TarHeader(entries_[cursor_].name, file->size,
+                         file->mtime_ns / 1000000000LL);
+    file_ = move(file);
+    body_pos_ = 0;
+    zero_fill_ = false;
+    stage_ = Stage::kBody;
+  }
+  return total;
+}
+
+/**
+ * @brief 发送内存中待发送的数据
+ *
+ * @return long long 发送的字节数, socket已满返回0, 出错返回-1
+ */
+long long BatchDownload::SendPending(int sock) {
+  long long total = 0;
+  while (pending_pos_ < pending_.size()) {
+    size_t len = pending_.size() - pending_pos_;
+#ifdef _WIN32
+    int n = send(sock, pending_.data() + pending_pos_, static_cast<int>(len),
+                 0);
+    if (n < 0) {
+      if (WSAGetLastError() == WSAEWOULDBLOCK) break;
+      return -1;
+    }
+#else
+#ifdef MSG_NOSIGNAL
+    ssize_t n = send(sock, pending_.data() + pending_pos_, len, MSG_NOSIGNAL);
+#else
+    ssize_t n = send(sock, pending_.data() + pending_pos_, len, 0);
+#endif
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      return -1;
+    }
+#endif
+    pending_pos_ += n;
+    total += n;
+  }
+  stats_.header_bytes += total;
+  return total;
+}
+
+/**
+ * @brief 发送当前文件的内容
+ *
+ * @return long long 发送的字节数, socket已满返回0, 出错返回-1
+ */
+long long BatchDownload::SendBody(int sock) {
+  static const char kZeros[kZeroBufferSize] = {};
+  long long total = 0;
+  while (body_pos_ < file_->size) {
+    long long remaining = file_->size - body_pos_;
+    long long n = 0;
+    if (zero_fill_) {
+      size_t len = static_cast<size_t>(
+          min<long long>(remaining, static_cast<long long>(sizeof(kZeros))));
+#ifdef _WIN32
+      n = send(sock, kZeros, static_cast<int>(len), 0);
+#elif defined(MSG_NOSIGNAL)
+      n = send(sock, kZeros, len, MSG_NOSIGNAL);
+#else
+      n = send(sock, kZeros, len, 0);
+#endif
+    } else {
+#ifdef __linux__
+      off_t offset = body_pos_;
+      n = sendfile(sock, file_->fd, &offset, remaining);
+#else
+      char buffer[64 * 1024];
+      size_t len = static_cast<size_t>(
+          min<long long>(remaining, static_cast<long long>(sizeof(buffer))));
+#ifdef _WIN32
+      _lseeki64(file_->fd, body_pos_, SEEK_SET);
+      long long re = _read(file_->fd, buffer, static_cast<unsigned int>(len));
+#else
+      long long re = pread(file_->fd, buffer, len, body_pos_);
+#endif
+      if (re < 0) return -1;
+      n = re == 0 ? 0 : send(sock, buffer, static_cast<int>(re), 0);
+#endif
+      if (n == 0) {
+        // 文件在发送期间变短, 用0补齐头部中声明的大小
+        cerr << "BatchDownload::SendBody() " << file_->path
+             << " shrank while sending" << endl;
+        zero_fill_ = true;
+        continue;
+      }
+    }
+    if (n < 0) {
+#ifdef _WIN32
+      if (WSAGetLastError() == WSAEWOULDBLOCK) break;
+#else
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+#endif
+      return -1;
+    }
+    body_pos_ += n;
+    total += n;
+  }
+  stats_.body_bytes += total;
+  return total;
+}
+
+/**
+ * @brief 生成一个文件的tar头部(包括需要时的GNU长文件名记录)
+ *
+ * @param name 归档中的文件名
+ * @param size 文件大小
+ * @param mtime 修改时间(秒)
+ * @return std::string 512字节整数倍的头部
+ */
+string BatchDownload::TarHeader(const string& name, long long size,
+                                long long mtime) {
+  if (name.size() <= kNameSize) return MakeBlock(name, "", '0', size, mtime);
+
+  // 在`/`处拆分为前缀和文件名, 文件名部分尽量长
+  for (size_t slash = name.find('/'); slash != string::npos;
+       slash = name.find('/', slash + 1)) {
+    if (slash > kPrefixSize) break;
+    if (name.size() - slash - 1 <= kNameSize && slash + 1 < name.size()) {
+      return MakeBlock(name.substr(slash + 1), name.substr(0, slash), '0',
+                       size, mtime);
+    }
+  }
+
+  // GNU长文件名: 先发送一个类型为`L`、内容为完整文件名的记录
+  string data = name;
+  data.push_back('\0');
+  string header =
+      MakeBlock("././@LongLink", "", 'L', static_cast<long long>(data.size()),
+                0);
+  long long tail = static_cast<long long>(data.size()) % kBlockSize;
+  if (tail != 0) data.append(kBlockSize - tail, '\0');
+  return header + data + MakeBlock(name, "", '0', size, mtime);
+}
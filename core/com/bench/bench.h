@@ -0,0 +1,28 @@
+﻿// bench.h
+// 性能测试入口声明
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/**
+ * @brief 校验和性能测试: 输出单核吞吐量(GB/s)
+ *
+ * @return int 0为成功
+ */
+int ChecksumBench();
+
+/**
+ * @brief TLS 性能测试: 比较用户态加密和kTLS的文件发送吞吐量
+ *
+ * @return int 0为成功
+ */
+int TlsBench();
+
+/**
+ * @brief 唤醒延迟性能测试: 比较阻塞等待和忙等待的任务分发延迟
+ *
+ * @return int 0为成功
+ */
+int WakeupBench();
+
+#endif  // BENCH_H
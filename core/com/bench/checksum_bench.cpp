@@ -0,0 +1,63 @@
+﻿// checksum_bench.cpp
+// 校验和性能测试: 输出单核吞吐量(GB/s)
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "bench.h"
+#include "include/crc32c.h"
+#include "include/sha256.h"
+
+using namespace crossocean;
+using namespace std::chrono;
+
+/**
+ * @brief 测量函数处理`data`的单核吞吐量
+ *
+ * @param name 测试名称
+ * @param data 测试数据
+ * @param func 处理函数, 返回值用于防止被优化掉
+ */
+template <typename Func>
+static void Measure(const char* name, const std::string& data, Func func) {
+  // 至少运行0.5秒, 取平均值
+  unsigned long long sink = 0;
+  long long bytes = 0;
+  auto begin = steady_clock::now();
+  auto end = begin;
+  do {
+    sink += func(data.data(), data.size());
+    bytes += data.size();
+    end = steady_clock::now();
+  } while (end - begin < milliseconds(500));
+  double seconds = duration<double>(end - begin).count();
+  printf("%-28s %8zu bytes  %8.2f GB/s  (%llx)\n", name, data.size(),
+         bytes / seconds / 1e9, sink & 0xf);
+}
+
+/**
+ * @brief 校验和性能测试
+ */
+int ChecksumBench() {
+  printf("crc32c backend: %s\n", Crc32c::Backend());
+
+  std::mt19937 rng(1);
+  const size_t sizes[] = {4 * 1024, 64 * 1024, 1024 * 1024};
+  for (size_t size : sizes) {
+    std::string data(size, '\0');
+    for (auto& c : data) c = static_cast<char>(rng());
+
+    Measure("crc32c (dispatched)", data, [](const char* p, size_t n) {
+      return static_cast<unsigned long long>(Crc32c::Value(p, n));
+    });
+    Measure("crc32c (portable)", data, [](const char* p, size_t n) {
+      return static_cast<unsigned long long>(Crc32c::ExtendPortable(0, p, n));
+    });
+    Measure("sha256", data, [](const char* p, size_t n) {
+      return static_cast<unsigned long long>(Sha256::Hex(p, n)[0]);
+    });
+  }
+  return 0;
+}
@@ -0,0 +1,31 @@
+﻿// main.cpp
+// 性能测试主入口: bench_com [checksum] [tls] [wakeup], 不带参数时运行全部测试
+
+#include <cstdio>
+#include <cstring>
+
+#include "bench.h"
+
+int main(int argc, char* argv[]) {
+  struct Bench {
+    const char* name;
+    int (*run)();
+  };
+  const Bench benches[] = {
+      {"checksum", ChecksumBench},
+      {"tls", TlsBench},
+      {"wakeup", WakeupBench},
+  };
+
+  int result = 0;
+  for (const Bench& bench : benches) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; ++i) {
+      if (strcmp(argv[i], bench.name) == 0) selected = true;
+    }
+    if (!selected) continue;
+    printf("==================== %s ====================\n", bench.name);
+    result |= bench.run();
+  }
+  return result;
+}
@@ -0,0 +1,149 @@
+﻿// tls_bench.cpp
+// TLS 性能测试: 比较用户态加密和kTLS发送文件的吞吐量(GB/s)
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "bench.h"
+#include "include/tls.h"
+
+using namespace crossocean;
+using namespace std::chrono;
+namespace fs = std::filesystem;
+
+/// @brief 测试文件大小
+static const size_t kFileSize = 64 * 1024 * 1024;
+/// @brief 每种模式发送文件的次数
+static const int kRounds = 4;
+
+/**
+ * @brief 阻塞socket上完成握手
+ */
+static bool DoHandshake(TlsConnection* connection) {
+  TlsStatus status = connection->Handshake();
+  while (status == TlsStatus::kWantRead || status == TlsStatus::kWantWrite) {
+    status = connection->Handshake();
+  }
+  return status == TlsStatus::kDone;
+}
+
+/**
+ * @brief 通过本地回环TCP连接发送文件, 输出吞吐量
+ *
+ * @param ktls 是否启用kTLS
+ * @param path 测试文件路径
+ */
+static int RunMode(bool ktls, const std::string& path) {
+  std::string reason;
+  if (ktls && !TlsContext::KtlsSupported(&reason)) {
+    printf("%-10s skipped: %s\n", "ktls", reason.c_str());
+    return 0;
+  }
+  TlsContext server_ctx, client_ctx;
+  server_ctx.set_ktls(ktls);
+  client_ctx.set_ktls(ktls);
+  if (!server_ctx.InitSelfSigned("localhost") || !client_ctx.InitClient()) {
+    return 1;
+  }
+
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, 1) != 0 ||
+      getsockname(listen_fd, (sockaddr*)&addr, &addr_len) != 0) {
+    perror("tls bench listen");
+    close(listen_fd);
+    return 1;
+  }
+
+  const long long total = static_cast<long long>(kFileSize) * kRounds;
+  long long received = 0;
+  std::thread client([&] {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+      close(sock);
+      return;
+    }
+    TlsConnection connection(&client_ctx, sock);
+    if (DoHandshake(&connection)) {
+      std::string buf(256 * 1024, '\0');
+      while (received < total) {
+        TlsStatus status;
+        long long n = connection.Read(&buf[0], buf.size(), &status);
+        if (status != TlsStatus::kDone) break;
+        received += n;
+      }
+    }
+    close(sock);
+  });
+
+  int sock = accept(listen_fd, nullptr, nullptr);
+  TlsConnection connection(&server_ctx, sock);
+  bool ok = DoHandshake(&connection);
+  int fd = open(path.c_str(), O_RDONLY);
+  long long sent = 0;
+  auto begin = steady_clock::now();
+  for (int round = 0; ok && round < kRounds; ++round) {
+    long long offset = 0;
+    while (offset < static_cast<long long>(kFileSize)) {
+      TlsStatus status;
+      long long n =
+          connection.SendFile(fd, offset, kFileSize - offset, &status);
+      if (status != TlsStatus::kDone || n <= 0) {
+        ok = false;
+        break;
+      }
+      offset += n;
+      sent += n;
+    }
+  }
+  client.join();
+  double seconds = duration<double>(steady_clock::now() - begin).count();
+  printf("%-10s ktls_send=%-3s %-22s %8.2f GB/s  (%lld bytes)\n",
+         ktls ? "ktls" : "user-space", connection.ktls_send() ? "yes" : "no",
+         connection.cipher().c_str(), received / seconds / 1e9, received);
+  if (ktls && !connection.ktls_send()) {
+    printf("%-10s kTLS not enabled for %s, measured user-space encryption\n",
+           "", connection.cipher().c_str());
+  }
+
+  close(fd);
+  close(sock);
+  close(listen_fd);
+  return ok && received == total ? 0 : 1;
+}
+
+/**
+ * @brief TLS 性能测试: 比较用户态加密和kTLS的文件发送吞吐量
+ *
+ * @details 客户端和服务器在同一进程中, 吞吐量包含客户端解密的开销.
+ * OpenSSL或内核不支持kTLS时跳过kTLS模式并输出原因
+ */
+int TlsBench() {
+  fs::path path = fs::temp_directory_path() / "tls_bench.bin";
+  {
+    std::mt19937 rng(1);
+    std::string data(kFileSize, '\0');
+    for (auto& c : data) c = static_cast<char>(rng());
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+  }
+  int result = RunMode(false, path.string());
+  result |= RunMode(true, path.string());
+  fs::remove(path);
+  return result;
+}
@@ -0,0 +1,86 @@
+﻿// wakeup_bench.cpp
+// 唤醒延迟性能测试: 比较阻塞等待和忙等待时分发任务到执行的延迟(微秒)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "include/thread_pool.h"
+#include "task.h"
+
+using namespace crossocean;
+using namespace std::chrono;
+
+/// @brief 每种模式分发的任务数
+static const int kTasks = 5000;
+/// @brief 两次分发之间的间隔, 模拟请求间的空闲
+static const microseconds kGap(20);
+
+/**
+ * @brief 记录从分发到执行的延迟
+ */
+class LatencyTask : public Task {
+ public:
+  explicit LatencyTask(steady_clock::time_point dispatched)
+      : dispatched_(dispatched) {}
+
+  bool Init() override {
+    done_.set_value(steady_clock::now() - dispatched_);
+    delete this;
+    return true;
+  }
+
+  std::future<steady_clock::duration> done() { return done_.get_future(); }
+
+ private:
+  steady_clock::time_point dispatched_;
+  std::promise<steady_clock::duration> done_;
+};
+
+/**
+ * @brief 分发任务并输出延迟分位数
+ *
+ * @param name 模式名称
+ */
+static void RunMode(const char* name) {
+  std::vector<double> latencies;
+  latencies.reserve(kTasks);
+  for (int i = 0; i < kTasks; ++i) {
+    auto* task = new LatencyTask(steady_clock::now());
+    auto done = task->done();
+    ThreadPool::GetInstance()->Dispatch(task);
+    latencies.push_back(duration<double, std::micro>(done.get()).count());
+    std::this_thread::sleep_for(kGap);
+  }
+  std::sort(latencies.begin(), latencies.end());
+  printf("%-12s p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", name,
+         latencies[kTasks / 2], latencies[kTasks * 99 / 100],
+         latencies.back());
+}
+
+/**
+ * @brief 唤醒延迟性能测试
+ *
+ * @details 单个工作线程, 每次分发后等待任务执行再分发下一个.
+ * 分发和执行路径上的日志输出被关闭, 只测量唤醒本身
+ */
+int WakeupBench() {
+  std::cout.setstate(std::ios::badbit);
+  ThreadPool* pool = ThreadPool::GetInstance();
+  pool->Init(1);
+  RunMode("sleep");
+
+  BusyPollOptions options;
+  options.spin_us = 200;
+  pool->set_busy_poll(options);
+  RunMode("busy-poll");
+
+  pool->set_busy_poll(BusyPollOptions());
+  std::cout.clear();
+  return 0;
+}
@@ -0,0 +1,465 @@
+﻿/**
+ * @file block_cache.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `BlockCache`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/block_cache.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#include <winsock2.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 访问频率上限
+static const int kMaxFrequency = 3;
+/// @brief 小队列占分片容量的比例
+static const double kSmallQueueRatio = 0.1;
+/// @brief 单次`writev`最多使用的`iovec`数量
+static const int kMaxIovecs = 64;
+
+/**
+ * @brief 缓存分片, 独立加锁, 内部使用`S3-FIFO`淘汰
+ */
+struct BlockCache::Shard {
+  struct Key {
+    uint64_t file_id;
+    uint64_t index;
+    bool operator==(const Key& other) const {
+      return file_id == other.file_id && index == other.index;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return static_cast<size_t>(key.file_id * 0x9E3779B97F4A7C15ULL ^
+                                 (key.index + 0x632BE59BD9B4E019ULL));
+    }
+  };
+  struct Entry {
+    Key key;
+    CacheBlockPtr block;
+    /// @brief 访问频率(0 ~ kMaxFrequency)
+    int freq = 0;
+    /// @brief 是否在主队列
+    bool in_main = false;
+  };
+  using EntryList = list<Entry>;
+
+  mutex mutex_;
+  /// @brief 小队列, 新块从头部进入, 从尾部淘汰
+  EntryList small_;
+  /// @brief 主队列
+  EntryList main_;
+  /// @brief 键到队列节点的索引
+  unordered_map<Key, EntryList::iterator, KeyHash> index_;
+  /// @brief 幽灵队列, 只记录最近从小队列淘汰的键
+  list<Key> ghost_;
+  unordered_map<Key, list<Key>::iterator, KeyHash> ghost_index_;
+
+  size_t capacity_ = 0;
+  size_t small_capacity_ = 0;
+  size_t ghost_capacity_ = 0;
+  size_t small_bytes_ = 0;
+  size_t main_bytes_ = 0;
+
+  /**
+   * @brief 淘汰一个块(需持有`mutex_`)
+   *
+   * @return true 淘汰成功
+   * @return false 分片为空
+   */
+  bool Evict() {
+    while (!small_.empty() || !main_.empty()) {
+      if (!small_.empty() &&
+          (small_bytes_ >= small_capacity_ || main_.empty())) {
+        Entry& entry = small_.back();
+        size_t size = entry.block->data.size();
+        if (entry.freq > 0) {
+          // 在小队列中被再次访问, 晋升到主队列
+          entry.freq = 0;
+          entry.in_main = true;
+          main_.splice(main_.begin(), small_, prev(small_.end()));
+          small_bytes_ -= size;
+          main_bytes_ += size;
+          continue;
+        }
+        // 只访问过一次, 淘汰并记入幽灵队列
+        RememberGhost(entry.key);
+        index_.erase(entry.key);
+        small_bytes_ -= size;
+        small_.pop_back();
+        return true;
+      }
+
+      Entry& entry = main_.back();
+      if (entry.freq > 0) {
+        // 主队列中的块按访问频率获得重新插入的机会
+        --entry.freq;
+        main_.splice(main_.begin(), main_, prev(main_.end()));
+        continue;
+      }
+      main_bytes_ -= entry.block->data.size();
+      index_.erase(entry.key);
+      main_.pop_back();
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief 记录被淘汰的键(需持有`mutex_`)
+   */
+  void RememberGhost(const Key& key) {
+    if (ghost_capacity_ == 0) return;
+    ghost_.push_front(key);
+    ghost_index_[key] = ghost_.begin();
+    while (ghost_.size() > ghost_capacity_) {
+      ghost_index_.erase(ghost_.back());
+      ghost_.pop_back();
+    }
+  }
+
+  /**
+   * @brief 删除一个块(需持有`mutex_`)
+   */
+  void Erase(unordered_map<Key, EntryList::iterator, KeyHash>::iterator it) {
+    EntryList::iterator entry = it->second;
+    size_t size = entry->block->data.size();
+    if (entry->in_main) {
+      main_bytes_ -= size;
+      main_.erase(entry);
+    } else {
+      small_bytes_ -= size;
+      small_.erase(entry);
+    }
+    index_.erase(it);
+  }
+};
+
+/**
+ * @brief 构造块缓存
+ *
+ * @param capacity 缓存容量上限(字节)
+ * @param block_size 块大小(字节)
+ * @param shard_count 分片数量
+ */
+BlockCache::BlockCache(size_t capacity, size_t block_size, int shard_count)
+    : capacity_(capacity), block_size_(block_size > 0 ? block_size : 4096) {
+  if (shard_count < 1) shard_count = 1;
+  size_t shard_capacity = capacity_ / shard_count;
+  for (int i = 0; i < shard_count; ++i) {
+    Shard* shard = new Shard();
+    shard->capacity_ = shard_capacity;
+    shard->small_capacity_ = max(
+        block_size_, static_cast<size_t>(shard_capacity * kSmallQueueRatio));
+    // 幽灵队列记录的键数与主队列能容纳的块数相当
+    shard->ghost_capacity_ = shard_capacity / block_size_;
+    shards_.push_back(shard);
+  }
+}
+
+BlockCache::~BlockCache() {
+  if (memory_) {
+    memory_->RemoveReclaimer(reclaimer_id_);
+    memory_->Charge(MemoryCategory::kCache, 0, -stats().bytes);
+  }
+  for (Shard* shard : shards_) delete shard;
+}
+
+/**
+ * @brief 关联内存预算, 须在使用缓存之前调用
+ *
+ * @param budget 内存预算, 缓存销毁前不能释放
+ */
+void BlockCache::set_memory_budget(MemoryBudget* budget) {
+  memory_ = budget;
+  memory_->Charge(MemoryCategory::kCache, 0, stats().bytes);
+  reclaimer_id_ = memory_->AddReclaimer(
+      [this](long long bytes) { return Shrink(bytes); });
+}
+
+/**
+ * @brief 淘汰块释放内存, 不改变容量上限
+ *
+ * @param bytes 需要释放的字节数
+ * @return long long 实际释放的字节数
+ */
+long long BlockCache::Shrink(long long bytes) {
+  long long freed = 0;
+  for (Shard* shard : shards_) {
+    if (freed >= bytes) break;
+    lock_guard<mutex> lock(shard->mutex_);
+    while (freed < bytes) {
+      size_t before = shard->small_bytes_ + shard->main_bytes_;
+      if (!shard->Evict()) break;
+      freed += before - shard->small_bytes_ - shard->main_bytes_;
+      ++evictions_;
+    }
+  }
+  if (memory_) memory_->Charge(MemoryCategory::kCache, 0, -freed);
+  return freed;
+}
+
+/**
+ * @brief 根据键选择分片
+ */
+BlockCache::Shard* BlockCache::ShardFor(uint64_t file_id, uint64_t index) {
+  uint64_t hash = file_id * 0x9E3779B97F4A7C15ULL + index;
+  hash ^= hash >> 29;
+  return shards_[hash % shards_.size()];
+}
+
+/**
+ * @brief 查找缓存块
+ *
+ * @param file_id 文件ID
+ * @param index 块号
+ * @return CacheBlockPtr 缓存块, 未命中返回`nullptr`
+ */
+CacheBlockPtr BlockCache::Lookup(uint64_t file_id, uint64_t index) {
+  Shard* shard = ShardFor(file_id, index);
+  {
+    lock_guard<mutex> lock(shard->mutex_);
+    auto it = shard->index_.find({file_id, index});
+    if (it != shard->index_.end()) {
+      Shard::Entry& entry = *it->second;
+      // 命中只增加访问频率, 不移动节点
+      if (entry.freq < kMaxFrequency) ++entry.freq;
+      ++hits_;
+      return entry.block;
+    }
+  }
+  ++misses_;
+  return nullptr;
+}
+
+/**
+ * @brief 插入缓存块, 已存在时替换内容
+ *
+ * @param file_id 文件ID
+ * @param index 块号
+ * @param block 块内容, 大小不能超过`block_size`
+ */
+void BlockCache::Insert(uint64_t file_id, uint64_t index,
+                        CacheBlockPtr block) {
+  if (!block || block->data.size() > block_size_) {
+    cerr << "BlockCache::Insert() Invalid block." << endl;
+    return;
+  }
+  size_t size = block->data.size();
+  Shard* shard = ShardFor(file_id, index);
+  Shard::Key key = {file_id, index};
+
+  long long delta = 0;
+  {
+    lock_guard<mutex> lock(shard->mutex_);
+    if (size > shard->capacity_) return;
+    long long before = shard->small_bytes_ + shard->main_bytes_;
+    auto it = shard->index_.find(key);
+    if (it != shard->index_.end()) shard->Erase(it);
+
+    while (shard->small_bytes_ + shard->main_bytes_ + size >
+           shard->capacity_) {
+      if (!shard->Evict()) break;
+      ++evictions_;
+    }
+
+    Shard::Entry entry;
+    entry.key = key;
+    entry.block = move(block);
+    auto ghost = shard->ghost_index_.find(key);
+    if (ghost != shard->ghost_index_.end()) {
+      // 最近刚被淘汰又再次需要, 直接进入主队列
+      shard->ghost_.erase(ghost->second);
+      shard->ghost_index_.erase(ghost);
+      entry.in_main = true;
+      shard->main_.push_front(move(entry));
+      shard->index_[key] = shard->main_.begin();
+      shard->main_bytes_ += size;
+    } else {
+      shard->small_.push_front(move(entry));
+      shard->index_[key] = shard->small_.begin();
+      shard->small_bytes_ += size;
+    }
+    delta = shard->small_bytes_ + shard->main_bytes_ - before;
+  }
+  ++inserts_;
+  // 释放分片锁后再记账, 超出预算时回收函数需要加分片锁
+  if (memory_) memory_->Charge(MemoryCategory::kCache, 0, delta);
+}
+
+/**
+ * @brief 删除文件的所有缓存块(文件被修改或删除时调用)
+ *
+ * @param file_id 文件ID
+ */
+void BlockCache::Invalidate(uint64_t file_id) {
+  long long freed = 0;
+  for (Shard* shard : shards_) {
+    lock_guard<mutex> lock(shard->mutex_);
+    size_t before = shard->small_bytes_ + shard->main_bytes_;
+    for (auto it = shard->index_.begin(); it != shard->index_.end();) {
+      if (it->first.file_id == file_id) {
+        auto next_it = next(it);
+        shard->Erase(it);
+        it = next_it;
+      } else {
+        ++it;
+      }
+    }
+    freed += before - shard->small_bytes_ - shard->main_bytes_;
+  }
+  if (memory_) memory_->Charge(MemoryCategory::kCache, 0, -freed);
+}
+
+/**
+ * @brief 读取文件区间覆盖的缓存块, 未命中的块从文件读取并加入缓存
+ *
+ * @param file_id 文件ID
+ * @param fd 文件描述符
+ * @param offset 区间起始偏移
+ * @param length 区间长度
+ * @param blocks 输出覆盖区间的所有块(按顺序)
+ * @return true 读取成功
+ * @return false 读取文件失败
+ */
+bool BlockCache::ReadBlocks(uint64_t file_id, int fd, long long offset,
+                            long long length,
+                            vector<CacheBlockPtr>* blocks) {
+  if (offset < 0 || length <= 0) return true;
+  uint64_t first = offset / block_size_;
+  uint64_t last = (offset + length - 1) / block_size_;
+  for (uint64_t index = first; index <= last; ++index) {
+    CacheBlockPtr block = Lookup(file_id, index);
+    if (!block) {
+      auto loaded = make_shared<CacheBlock>();
+      loaded->data.resize(block_size_);
+      long long position = static_cast<long long>(index * block_size_);
+#ifdef _WIN32
+      _lseeki64(fd, position, SEEK_SET);
+      long long len = _read(fd, loaded->data.data(),
+                            static_cast<unsigned int>(block_size_));
+#else
+      long long len = pread(fd, loaded->data.data(), block_size_, position);
+#endif
+      if (len < 0) {
+        cerr << "BlockCache::ReadBlocks() Failed to read file." << endl;
+        return false;
+      }
+      // 到达文件末尾
+      if (len == 0) break;
+      loaded->data.resize(len);
+      block = loaded;
+      Insert(file_id, index, block);
+    }
+    blocks->push_back(block);
+    if (block->data.size() < block_size_) break;
+  }
+  return true;
+}
+
+/**
+ * @brief 通过缓存把文件区间发送到socket
+ *
+ * @param sock 目标socket(或管道)
+ * @param file_id 文件ID
+ * @param fd 文件描述符
+ * @param offset 区间起始偏移
+ * @param length 区间长度
+ * @return long long 实际发送的字节数, 出错返回-1
+ */
+long long BlockCache::Send(int sock, uint64_t file_id, int fd,
+                           long long offset, long long length) {
+  // 一次最多发送`kMaxIovecs`个块, 之后的块等下次调用再读取
+  long long block_size = static_cast<long long>(block_size_);
+  long long skip = offset % block_size;
+  length = min(length, kMaxIovecs * block_size - skip);
+  vector<CacheBlockPtr> blocks;
+  if (!ReadBlocks(file_id, fd, offset, length, &blocks)) return -1;
+  if (blocks.empty()) return 0;
+
+  long long remain = length;
+#ifdef _WIN32
+  long long sent = 0;
+  for (auto& block : blocks) {
+    long long len =
+        min(remain, static_cast<long long>(block->data.size()) - skip);
+    if (len <= 0) break;
+    int re = send(sock, block->data.data() + skip, static_cast<int>(len), 0);
+    if (re < 0) return sent > 0 ? sent : -1;
+    sent += re;
+    remain -= re;
+    if (re < len) break;
+    skip = 0;
+  }
+  return sent;
+#else
+  iovec iov[kMaxIovecs];
+  int count = 0;
+  for (auto& block : blocks) {
+    if (count == kMaxIovecs) break;
+    long long len =
+        min(remain, static_cast<long long>(block->data.size()) - skip);
+    if (len <= 0) break;
+    iov[count].iov_base = const_cast<char*>(block->data.data()) + skip;
+    iov[count].iov_len = static_cast<size_t>(len);
+    ++count;
+    remain -= len;
+    skip = 0;
+  }
+  // `blocks`持有块指针, `writev`期间块即使被淘汰也不会释放
+  return writev(sock, iov, count);
+#endif
+}
+
+/**
+ * @brief 由文件元数据计算文件ID
+ *
+ * @param dev 设备号
+ * @param ino inode号
+ * @param mtime_ns 修改时间(纳秒)
+ * @param size 文件大小
+ * @return uint64_t 文件ID
+ */
+uint64_t BlockCache::FileId(uint64_t dev, uint64_t ino, long long mtime_ns,
+                            long long size) {
+  uint64_t id = 1469598103934665603ULL;
+  const uint64_t parts[] = {dev, ino, static_cast<uint64_t>(mtime_ns),
+                            static_cast<uint64_t>(size)};
+  for (uint64_t part : parts) {
+    id ^= part;
+    id *= 1099511628211ULL;
+    id ^= id >> 31;
+  }
+  return id;
+}
+
+/**
+ * @brief 获取统计信息
+ *
+ * @return BlockCacheStats 统计信息
+ */
+BlockCacheStats BlockCache::stats() const {
+  BlockCacheStats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.inserts = inserts_;
+  stats.evictions = evictions_;
+  for (Shard* shard : shards_) {
+    lock_guard<mutex> lock(shard->mutex_);
+    stats.bytes += shard->small_bytes_ + shard->main_bytes_;
+  }
+  return stats;
+}
@@ -0,0 +1,166 @@
+﻿/**
+ * @file blocking_pool.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `BlockingPool`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/blocking_pool.h"
+
+#include <iostream>
+
+#include "task.h"
+#include "thread.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 把完成回调包装为任务, 投递到`Thread`中执行
+ */
+class CompletionTask : public Task {
+ public:
+  explicit CompletionTask(BlockingPool::Done done) : done_(move(done)) {}
+
+  /**
+   * @brief 执行完成回调后释放自身
+   *
+   * @return true 总是成功
+   */
+  bool Init() override {
+    if (done_) done_();
+    delete this;
+    return true;
+  }
+
+  /**
+   * @brief 回调任务超时仍然执行, 不能丢弃完成通知
+   */
+  void OnExpired() override { Init(); }
+
+ private:
+  BlockingPool::Done done_;
+};
+
+BlockingPool::~BlockingPool() { Stop(); }
+
+/**
+ * @brief 启动工作线程
+ *
+ * @param thread_num 工作线程数量
+ */
+void BlockingPool::Init(int thread_num) {
+  lock_guard<mutex> lock(mutex_);
+  if (!workers_.empty()) {
+    cerr << "BlockingPool::Init() Already initialized." << endl;
+    return;
+  }
+  if (thread_num <= 0) {
+    cerr << "BlockingPool::Init() Invalid thread number." << endl;
+    return;
+  }
+  stopping_ = false;
+  for (int i = 0; i < thread_num; ++i) {
+    workers_.emplace_back(&BlockingPool::Main, this);
+  }
+}
+
+/**
+ * @brief 停止接收新工作, 等待已提交的工作执行完毕后退出工作线程
+ */
+void BlockingPool::Stop() {
+  vector<thread> workers;
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+    workers.swap(workers_);
+  }
+  cond_.notify_all();
+  for (thread& worker : workers) {
+    if (worker.joinable()) worker.join();
+  }
+}
+
+/**
+ * @brief 提交阻塞工作
+ *
+ * @param work 在工作线程中执行的阻塞工作
+ * @return true 提交成功
+ * @return false 线程池未启动或已停止
+ */
+bool BlockingPool::Submit(Work work) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (workers_.empty() || stopping_) {
+      cerr << "BlockingPool::Submit() Pool is not running." << endl;
+      return false;
+    }
+    works_.push_back(move(work));
+  }
+  cond_.notify_one();
+  return true;
+}
+
+/**
+ * @brief 提交阻塞工作, 完成后在指定线程中执行回调
+ *
+ * @param work 在工作线程中执行的阻塞工作
+ * @param thread 执行回调的线程, 为`nullptr`时在工作线程中直接执行回调
+ * @param done 完成回调
+ * @return true 提交成功
+ * @return false 线程池未启动或已停止
+ */
+bool BlockingPool::Submit(Work work, Thread* thread, Done done) {
+  return Submit([work = move(work), thread, done = move(done)]() {
+    if (work) work();
+    Post(thread, done);
+  });
+}
+
+/**
+ * @brief 把回调作为高优先级任务投递到线程中执行
+ *
+ * @param thread 执行回调的线程, 为`nullptr`时在当前线程中直接执行
+ * @param done 回调
+ */
+void BlockingPool::Post(Thread* thread, Done done) {
+  if (!thread) {
+    if (done) done();
+    return;
+  }
+  // 完成通知是延迟敏感的, 放入高优先级通道
+  CompletionTask* task = new CompletionTask(move(done));
+  task->set_priority(TaskPriority::kHigh);
+  thread->AddTask(task);
+  thread->Activate();
+}
+
+/**
+ * @brief 获取等待执行的工作数量
+ *
+ * @return int 队列中的工作数量
+ */
+int BlockingPool::pending() {
+  lock_guard<mutex> lock(mutex_);
+  return static_cast<int>(works_.size());
+}
+
+/**
+ * @brief 工作线程入口, 循环取出工作执行
+ */
+void BlockingPool::Main() {
+  for (;;) {
+    Work work;
+    {
+      unique_lock<mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return stopping_ || !works_.empty(); });
+      // 停止时先执行完已提交的工作
+      if (works_.empty()) return;
+      work = move(works_.front());
+      works_.pop_front();
+    }
+    work();
+  }
+}
@@ -0,0 +1,163 @@
+﻿/**
+ * @file channel.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Channel`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "crossocean.h"
+#include "thread.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 消息通道的接收端接口
+ *
+ * @details 注册到接收线程后, 由线程的事件循环每一轮调用`Poll`
+ */
+class ChannelBase {
+ public:
+  virtual ~ChannelBase() {}
+
+  /**
+   * @brief 取出并处理通道中的所有消息(在接收线程中调用)
+   *
+   * @return size_t 处理的消息数量
+   */
+  virtual size_t Poll() = 0;
+};
+
+/**
+ * @brief 发往某个`Thread`的类型化消息通道
+ *
+ * @details
+ * 任意线程都可以发送(单个发送线程时锁没有竞争), 消息在接收线程中按发送顺序
+ * 交给处理函数. 消息先追加到待处理队列, 接收线程一次交换出整个队列成批处理,
+ * 两个队列交替使用, 稳定后不再分配内存.
+ * 只有队列由空变为非空时才通知接收线程, 而且`Thread::Signal`在接收线程的
+ * 一轮事件循环中最多写一次管道; 接收线程每轮阻塞之前都会轮询通道,
+ * 所以接收线程繁忙时发送消息不产生系统调用.
+ * 通道对象必须在接收线程之前销毁
+ *
+ * @tparam T 消息类型
+ */
+template <typename T>
+class Channel : public ChannelBase {
+ public:
+  /// @brief 消息处理函数, 在接收线程中执行
+  using Handler = std::function<void(T& message)>;
+
+  /**
+   * @brief 创建通道并注册到接收线程
+   *
+   * @param receiver 接收线程
+   * @param handler 消息处理函数
+   */
+  Channel(Thread* receiver, Handler handler)
+      : receiver_(receiver), handler_(std::move(handler)) {
+    receiver_->AddChannel(this);
+  }
+
+  /**
+   * @brief 从接收线程注销, 未处理的消息被丢弃
+   */
+  ~Channel() override { receiver_->RemoveChannel(this); }
+
+  Channel(const Channel&) = delete;
+  Channel& operator=(const Channel&) = delete;
+
+  /**
+   * @brief 发送一条消息
+   *
+   * @param message 消息
+   */
+  void Send(T message) {
+    bool first = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      first = pending_.empty();
+      pending_.push_back(std::move(message));
+    }
+    ++sent_;
+    if (first) receiver_->Signal();
+  }
+
+  /**
+   * @brief 发送一批消息, 只加锁和通知一次
+   *
+   * @param messages 消息
+   */
+  void SendBatch(std::vector<T> messages) {
+    if (messages.empty()) return;
+    size_t count = messages.size();
+    bool first = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      first = pending_.empty();
+      if (first) {
+        pending_.swap(messages);
+      } else {
+        for (T& message : messages) pending_.push_back(std::move(message));
+      }
+    }
+    sent_ += static_cast<long long>(count);
+    if (first) receiver_->Signal();
+  }
+
+  /**
+   * @brief 取出并处理通道中的所有消息(在接收线程中调用)
+   *
+   * @return size_t 处理的消息数量
+   */
+  size_t Poll() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (pending_.empty()) return 0;
+      batch_.swap(pending_);
+    }
+    ++batches_;
+    for (T& message : batch_) handler_(message);
+    size_t count = batch_.size();
+    batch_.clear();
+    received_ += static_cast<long long>(count);
+    return count;
+  }
+
+  /// @brief 接收线程
+  Thread* receiver() const { return receiver_; }
+  /// @brief 发送的消息数量
+  long long sent() const { return sent_; }
+  /// @brief 处理的消息数量
+  long long received() const { return received_; }
+  /// @brief 成批处理的次数
+  long long batches() const { return batches_; }
+
+ private:
+  Thread* receiver_;
+  Handler handler_;
+
+  std::mutex mutex_;
+  /// @brief 等待处理的消息
+  std::vector<T> pending_;
+  /// @brief 正在处理的消息(只在接收线程中访问)
+  std::vector<T> batch_;
+
+  std::atomic<long long> sent_{0};
+  std::atomic<long long> received_{0};
+  std::atomic<long long> batches_{0};
+};
+
+END_NAMESPACE
+
+#endif  // CHANNEL_H
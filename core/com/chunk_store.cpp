@@ -0,0 +1,289 @@
+﻿/**
+ * @file chunk_store.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ChunkStore`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/chunk_store.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+#include "include/sha256.h"
+#include "util.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 清单文件头
+static const char kManifestMagic[] = "crossocean-manifest 1";
+
+/**
+ * @brief 构造内容寻址存储
+ *
+ * @param root 存储根目录
+ */
+ChunkStore::ChunkStore(const string& root) : root_(root) {}
+
+/**
+ * @brief 创建存储目录
+ *
+ * @return true 成功
+ * @return false 创建目录失败
+ */
+bool ChunkStore::Init() {
+  for (const char* dir : {"chunks", "manifests"}) {
+    error_code ec;
+    fs::path path = fs::path(root_) / dir;
+    fs::create_directories(path, ec);
+    if (ec) {
+      cerr << "ChunkStore::Init() Failed to create " << path << ": "
+           << ec.message() << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief 校验块哈希格式(64个十六进制字符), 防止路径穿越
+ */
+bool ChunkStore::ValidHash(const string& hash) {
+  if (hash.size() != Sha256::kDigestSize * 2) return false;
+  for (char c : hash) {
+    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 校验清单名称, 不允许绝对路径和`..`
+ */
+bool ChunkStore::ValidName(const string& name) {
+  return ValidRelativePath(name);
+}
+
+/**
+ * @brief 块文件路径
+ *
+ * @param hash 块哈希
+ */
+string ChunkStore::ChunkPath(const string& hash) const {
+  return (fs::path(root_) / "chunks" / hash.substr(0, 2) / hash).string();
+}
+
+/**
+ * @brief 判断块是否已保存
+ *
+ * @param hash 块哈希
+ */
+bool ChunkStore::Has(const string& hash) const {
+  if (!ValidHash(hash)) return false;
+  error_code ec;
+  return fs::exists(ChunkPath(hash), ec);
+}
+
+/**
+ * @brief 返回需要客户端发送的块(去重, 保持原顺序)
+ *
+ * @param hashes 客户端文件的块哈希列表
+ * @return std::vector<std::string> 尚未保存的块哈希
+ */
+vector<string> ChunkStore::Missing(const vector<string>& hashes) {
+  vector<string> missing;
+  unordered_set<string> seen;
+  for (auto& hash : hashes) {
+    if (!seen.insert(hash).second) continue;
+    if (!Has(hash)) missing.push_back(hash);
+  }
+  return missing;
+}
+
+/**
+ * @brief 保存块, 校验内容与哈希一致, 已存在时直接返回
+ *
+ * @param hash 块哈希
+ * @param data 块内容
+ * @param len 块长度
+ * @return true 保存成功或已存在
+ * @return false 哈希不匹配或写入失败
+ */
+bool ChunkStore::Put(const string& hash, const char* data, size_t len) {
+  if (!ValidHash(hash) || Sha256::Hex(data, len) != hash) {
+    cerr << "ChunkStore::Put() Chunk hash mismatch." << endl;
+    return false;
+  }
+  if (Has(hash)) {
+    dedup_bytes_ += len;
+    return true;
+  }
+
+  fs::path path = ChunkPath(hash);
+  error_code ec;
+  fs::create_directories(path.parent_path(), ec);
+  // 先写临时文件再重命名, 读者不会看到写了一半的块
+  stringstream temp_name;
+  temp_name << hash << ".tmp." << this_thread::get_id() << "." << ++temp_seq_;
+  fs::path temp = path.parent_path() / temp_name.str();
+  {
+    ofstream out(temp, ios::binary | ios::trunc);
+    out.write(data, len);
+    if (!out) {
+      cerr << "ChunkStore::Put() Failed to write " << temp << endl;
+      out.close();
+      fs::remove(temp, ec);
+      return false;
+    }
+  }
+  fs::rename(temp, path, ec);
+  if (ec) {
+    cerr << "ChunkStore::Put() Failed to rename " << temp << endl;
+    fs::remove(temp, ec);
+    return false;
+  }
+  stored_bytes_ += len;
+  return true;
+}
+
+/**
+ * @brief 读取块
+ *
+ * @param hash 块哈希
+ * @param data 输出块内容
+ * @return true 成功
+ * @return false 块不存在
+ */
+bool ChunkStore::Get(const string& hash, string* data) const {
+  if (!ValidHash(hash)) return false;
+  ifstream in(ChunkPath(hash), ios::binary);
+  if (!in) return false;
+  data->assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+  return true;
+}
+
+/**
+ * @brief 写入文件清单, 清单引用的块必须都已保存
+ *
+ * @param name 文件名(相对路径)
+ * @param chunks 按顺序排列的块
+ * @return true 成功
+ * @return false 名称非法、缺少块或写入失败
+ */
+bool ChunkStore::WriteManifest(const string& name,
+                               const vector<ChunkRef>& chunks) {
+  if (!ValidName(name)) {
+    cerr << "ChunkStore::WriteManifest() Invalid name " << name << endl;
+    return false;
+  }
+  long long total = 0;
+  for (auto& chunk : chunks) {
+    if (!Has(chunk.hash)) {
+      cerr << "ChunkStore::WriteManifest() Missing chunk " << chunk.hash
+           << endl;
+      return false;
+    }
+    total += chunk.length;
+  }
+
+  fs::path path = fs::path(root_) / "manifests" / name;
+  error_code ec;
+  fs::create_directories(path.parent_path(), ec);
+  fs::path temp = path;
+  temp += ".tmp." + to_string(++temp_seq_);
+  {
+    ofstream out(temp, ios::trunc);
+    out << kManifestMagic << "\n" << total << " " << chunks.size() << "\n";
+    for (auto& chunk : chunks) {
+      out << chunk.hash << " " << chunk.length << "\n";
+    }
+    if (!out) {
+      out.close();
+      fs::remove(temp, ec);
+      return false;
+    }
+  }
+  fs::rename(temp, path, ec);
+  return !ec;
+}
+
+/**
+ * @brief 读取文件清单
+ *
+ * @param name 文件名(相对路径)
+ * @param chunks 输出按顺序排列的块(包含偏移)
+ * @return true 成功
+ * @return false 清单不存在或格式错误
+ */
+bool ChunkStore::ReadManifest(const string& name, vector<ChunkRef>* chunks) {
+  if (!ValidName(name)) return false;
+  ifstream in(fs::path(root_) / "manifests" / name);
+  if (!in) return false;
+
+  string magic;
+  getline(in, magic);
+  long long total = 0;
+  size_t count = 0;
+  if (magic != kManifestMagic || !(in >> total >> count)) return false;
+
+  chunks->clear();
+  long long offset = 0;
+  for (size_t i = 0; i < count; ++i) {
+    ChunkRef chunk;
+    if (!(in >> chunk.hash >> chunk.length)) return false;
+    chunk.offset = offset;
+    offset += chunk.length;
+    chunks->push_back(chunk);
+  }
+  return offset == total;
+}
+
+/**
+ * @brief 按清单还原文件
+ *
+ * @details 先写同目录的临时文件, 全部写完后重命名为`out_path`;
+ * 失败时删除临时文件, 已有的`out_path`不受影响
+ *
+ * @param name 文件名(相对路径)
+ * @param out_path 输出文件路径
+ * @return true 成功
+ * @return false 清单或块缺失
+ */
+bool ChunkStore::Restore(const string& name, const string& out_path) {
+  vector<ChunkRef> chunks;
+  if (!ReadManifest(name, &chunks)) return false;
+  fs::path path(out_path);
+  stringstream temp_name;
+  temp_name << path.filename().string() << ".tmp." << this_thread::get_id()
+            << "." << ++temp_seq_;
+  fs::path temp = path.parent_path() / temp_name.str();
+  bool ok = true;
+  {
+    ofstream out(temp, ios::binary | ios::trunc);
+    string data;
+    for (auto& chunk : chunks) {
+      if (!out) break;
+      if (!Get(chunk.hash, &data) || data.size() != chunk.length) {
+        cerr << "ChunkStore::Restore() Missing chunk " << chunk.hash << endl;
+        ok = false;
+        break;
+      }
+      out.write(data.data(), data.size());
+    }
+    if (!out) ok = false;
+  }
+  error_code ec;
+  if (ok) fs::rename(temp, path, ec);
+  if (!ok || ec) {
+    fs::remove(temp, ec);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,173 @@
+﻿/**
+ * @file chunker.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Chunker`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/chunker.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "include/sha256.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief FastCDC 使用的 Gear 表, 由固定种子生成, 保证不同进程分块结果一致
+ */
+static const uint64_t* GearTable() {
+  static uint64_t table[256];
+  static bool initialized = [] {
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+    for (int i = 0; i < 256; ++i) {
+      // splitmix64
+      uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      table[i] = z ^ (z >> 31);
+    }
+    return true;
+  }();
+  (void)initialized;
+  return table;
+}
+
+/**
+ * @brief 生成高位为1的掩码
+ *
+ * @details Gear 哈希每次左移一位, 高位受最近64个字节影响, 因此掩码取高位
+ *
+ * @param bits 掩码位数
+ */
+static uint64_t HighMask(int bits) {
+  if (bits <= 0) return 0;
+  if (bits >= 64) return ~0ULL;
+  return ((1ULL << bits) - 1) << (64 - bits);
+}
+
+/**
+ * @brief 构造分块器
+ *
+ * @param mode 分块方式
+ * @param avg_size 平均块大小(固定分块时为块大小), 取整到2的幂
+ */
+Chunker::Chunker(ChunkMode mode, size_t avg_size) : mode_(mode) {
+  int bits = 6;
+  while ((1ULL << bits) < avg_size && bits < 30) ++bits;
+  avg_size_ = static_cast<size_t>(1) << bits;
+  if (mode_ == ChunkMode::kFixed) {
+    min_size_ = max_size_ = avg_size_;
+  } else {
+    min_size_ = avg_size_ / 4;
+    max_size_ = avg_size_ * 4;
+  }
+  // 规范化分块: 平均大小前后掩码各偏移2位
+  mask_small_ = HighMask(bits + 2);
+  mask_large_ = HighMask(bits - 2);
+}
+
+/**
+ * @brief 查找块边界
+ *
+ * @param data 数据
+ * @param len 数据长度
+ * @return size_t 第一个块的长度
+ */
+size_t Chunker::FindBoundary(const unsigned char* data, size_t len) const {
+  if (mode_ == ChunkMode::kFixed || len <= min_size_) {
+    return min(len, max_size_);
+  }
+  const uint64_t* gear = GearTable();
+  size_t end = min(len, max_size_);
+  size_t normal = min(end, avg_size_);
+  uint64_t fp = 0;
+  size_t i = min_size_;
+  for (; i < normal; ++i) {
+    fp = (fp << 1) + gear[data[i]];
+    if (!(fp & mask_small_)) return i + 1;
+  }
+  for (; i < end; ++i) {
+    fp = (fp << 1) + gear[data[i]];
+    if (!(fp & mask_large_)) return i + 1;
+  }
+  return end;
+}
+
+/**
+ * @brief 切出`pending_`中未切出部分头部的一个块
+ */
+void Chunker::Emit(size_t len, const ChunkCallback& callback) {
+  const char* data = pending_.data() + consumed_;
+  ChunkRef chunk;
+  chunk.hash = Sha256::Hex(data, len);
+  chunk.offset = offset_;
+  chunk.length = len;
+  callback(chunk, data);
+  offset_ += len;
+  consumed_ += len;
+}
+
+/**
+ * @brief 输入数据
+ *
+ * @param data 数据
+ * @param len 数据长度
+ * @param callback 块回调
+ */
+void Chunker::Update(const char* data, size_t len,
+                     const ChunkCallback& callback) {
+  // 丢弃已经切出的数据, 每次输入只移动一次
+  pending_.erase(0, consumed_);
+  consumed_ = 0;
+  pending_.append(data, len);
+  // 数据不足一个最大块时无法确定边界, 等待更多数据
+  while (pending_.size() - consumed_ >= max_size_) {
+    size_t cut = FindBoundary(
+        reinterpret_cast<const unsigned char*>(pending_.data()) + consumed_,
+        pending_.size() - consumed_);
+    Emit(cut, callback);
+  }
+}
+
+/**
+ * @brief 输入结束, 切出剩余数据
+ *
+ * @param callback 块回调
+ */
+void Chunker::Finish(const ChunkCallback& callback) {
+  while (pending_.size() > consumed_) {
+    size_t cut = FindBoundary(
+        reinterpret_cast<const unsigned char*>(pending_.data()) + consumed_,
+        pending_.size() - consumed_);
+    Emit(cut, callback);
+  }
+  pending_.clear();
+  consumed_ = 0;
+  offset_ = 0;
+}
+
+/**
+ * @brief 对完整数据分块
+ *
+ * @param mode 分块方式
+ * @param avg_size 平均块大小
+ * @param data 数据
+ * @param len 数据长度
+ * @return std::vector<ChunkRef> 块列表
+ */
+vector<ChunkRef> Chunker::Split(ChunkMode mode, size_t avg_size,
+                                const char* data, size_t len) {
+  vector<ChunkRef> chunks;
+  Chunker chunker(mode, avg_size);
+  auto collect = [&chunks](const ChunkRef& chunk, const char*) {
+    chunks.push_back(chunk);
+  };
+  chunker.Update(data, len, collect);
+  chunker.Finish(collect);
+  return chunks;
+}
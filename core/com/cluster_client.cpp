@@ -0,0 +1,163 @@
+﻿/**
+ * @file cluster_client.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ClusterClient`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/cluster_client.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "include/replication.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 重定向后重试的次数上限
+static const int kMaxAttempts = 4;
+
+ClusterClient::ClusterClient() {}
+
+ClusterClient::~ClusterClient() {}
+
+/**
+ * @brief 从种子节点获取分片表
+ *
+ * @param seed 任一节点地址(`IP:端口`)
+ * @return true 成功
+ * @return false 连接失败或节点没有分片表
+ */
+bool ClusterClient::Connect(const string& seed) {
+  ChainClient* client = Client(seed);
+  ShardMap map;
+  if (!client || !client->GetShardMap(&map) || map.size() == 0) {
+    cerr << "ClusterClient::Connect() No shard map from " << seed << endl;
+    return false;
+  }
+  Adopt(map);
+  return true;
+}
+
+/**
+ * @brief 写入文件到归属节点(按分片表的副本链)
+ *
+ * @param path 相对根目录的文件路径
+ * @param data 文件内容
+ * @param len 文件大小
+ * @return true 所有副本已提交
+ * @return false 失败
+ */
+bool ClusterClient::Put(const string& path, const char* data, size_t len) {
+  for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    vector<string> owners = map_.Owners(path);
+    if (owners.empty()) return false;
+    ChainClient* client = Client(owners[0]);
+    if (!client) return false;
+    vector<string> chain(owners.begin() + 1, owners.end());
+    if (client->Put(path, data, len, chain)) return true;
+    if (!OnRedirect(client->redirect())) {
+      client->Close();
+      return false;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief 从归属节点读取文件
+ *
+ * @param path 相对根目录的文件路径
+ * @param data 输出文件内容
+ * @return true 成功
+ * @return false 文件不存在或节点不可用
+ */
+bool ClusterClient::Get(const string& path, string* data) {
+  for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    // 新分片表的副本在前, 文件还没移走时旧节点上有
+    vector<string> candidates = map_.Owners(path);
+    for (const string& address : previous_.Owners(path)) {
+      if (find(candidates.begin(), candidates.end(), address) ==
+          candidates.end()) {
+        candidates.push_back(address);
+      }
+    }
+    bool redirected = false;
+    for (const string& address : candidates) {
+      ChainClient* client = Client(address);
+      if (!client) continue;
+      if (client->Get(path, data)) return true;
+      if (OnRedirect(client->redirect())) {
+        redirected = true;
+        break;
+      }
+      if (client->redirect().empty()) client->Close();
+    }
+    if (!redirected) return false;
+  }
+  return false;
+}
+
+/**
+ * @brief 发布新的分片表: 发给新旧分片表中的所有节点
+ *
+ * @param map 分片表, 版本需比当前的新
+ * @return true 所有节点都已接受
+ * @return false 有节点不可用或拒绝
+ */
+bool ClusterClient::Publish(const ShardMap& map) {
+  vector<string> nodes;
+  for (const auto& node : map.nodes()) nodes.push_back(node.first);
+  for (const auto& node : map_.nodes()) {
+    if (find(nodes.begin(), nodes.end(), node.first) == nodes.end()) {
+      nodes.push_back(node.first);
+    }
+  }
+  bool ok = true;
+  for (const string& address : nodes) {
+    ChainClient* client = Client(address);
+    if (!client || !client->SetShardMap(map)) {
+      cerr << "ClusterClient::Publish() Rejected by " << address << endl;
+      ok = false;
+    }
+  }
+  Adopt(map);
+  return ok;
+}
+
+/**
+ * @brief 获取到节点的连接, 断开时重新连接
+ */
+ChainClient* ClusterClient::Client(const string& address) {
+  auto& client = clients_[address];
+  if (!client) client = make_unique<ChainClient>();
+  if (!client->connected() && !client->Connect(address)) return nullptr;
+  return client.get();
+}
+
+/**
+ * @brief 采用更新的分片表, 保留上一版用于读取
+ *
+ * @return true 分片表比当前的新
+ */
+bool ClusterClient::Adopt(const ShardMap& map) {
+  if (map.version() <= map_.version() && map_.size() > 0) return false;
+  previous_ = map_;
+  map_ = map;
+  return true;
+}
+
+/**
+ * @brief 处理重定向
+ *
+ * @return true 采用了节点返回的更新的分片表
+ */
+bool ClusterClient::OnRedirect(const string& encoded) {
+  if (encoded.empty()) return false;
+  ++redirects_;
+  ShardMap map;
+  return map.Decode(encoded) && Adopt(map);
+}
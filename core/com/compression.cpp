@@ -0,0 +1,481 @@
+﻿/**
+ * @file compression.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief 传输压缩相关类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/compression.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifdef CROSSOCEAN_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "util.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 内容探测使用的样本长度
+static const size_t kProbeSize = 4096;
+/// @brief 字节熵超过该值(比特/字节)的内容视为已压缩
+static const double kMaxEntropy = 7.5;
+/// @brief 小于该长度的数据块不压缩
+static const size_t kMinCompressSize = 64;
+
+/// @brief 原文帧类型
+static const char kFrameRaw = 'R';
+/// @brief 压缩帧类型
+static const char kFrameCompressed = 'Z';
+
+/**
+ * @brief 已压缩格式的文件头
+ */
+struct Magic {
+  const char* bytes;
+  size_t len;
+};
+
+static const Magic kCompressedMagics[] = {
+    {"\x1f\x8b", 2},                  // gzip
+    {"\x28\xb5\x2f\xfd", 4},          // zstd
+    {"PK\x03\x04", 4},                // zip / docx / jar
+    {"\xfd" "7zXZ", 5},               // xz
+    {"BZh", 3},                       // bzip2
+    {"7z\xbc\xaf\x27\x1c", 6},        // 7z
+    {"\xff\xd8\xff", 3},              // jpeg
+    {"\x89PNG", 4},                   // png
+    {"GIF8", 4},                      // gif
+    {"Rar!", 4},                      // rar
+    {"\x04\x22\x4d\x18", 4},          // lz4
+    {"OggS", 4},                      // ogg
+};
+
+// ==================== Compression ====================
+
+/**
+ * @brief 获取算法名称
+ *
+ * @param codec 压缩算法
+ * @return const char* 名称("none"、"zlib"、"zstd")
+ */
+const char* Compression::CodecName(CompressionCodec codec) {
+  switch (codec) {
+    case CompressionCodec::kZlib:
+      return "zlib";
+    case CompressionCodec::kZstd:
+      return "zstd";
+    default:
+      return "none";
+  }
+}
+
+/**
+ * @brief 按名称解析算法
+ *
+ * @param name 算法名称
+ * @param codec 输出压缩算法
+ * @return true 解析成功
+ * @return false 未知的名称
+ */
+bool Compression::ParseCodec(const string& name, CompressionCodec* codec) {
+  if (name == "none") {
+    *codec = CompressionCodec::kNone;
+  } else if (name == "zlib") {
+    *codec = CompressionCodec::kZlib;
+  } else if (name == "zstd") {
+    *codec = CompressionCodec::kZstd;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 当前编译版本是否支持该算法
+ */
+bool Compression::Available(CompressionCodec codec) {
+  switch (codec) {
+    case CompressionCodec::kNone:
+    case CompressionCodec::kZlib:
+      return true;
+    case CompressionCodec::kZstd:
+#ifdef CROSSOCEAN_WITH_ZSTD
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+/**
+ * @brief 本端支持的算法列表, 按优先顺序以逗号分隔(如"zstd,zlib")
+ */
+string Compression::Supported() {
+  // zstd 在相同压缩率下速度快得多, 优先使用
+  return Available(CompressionCodec::kZstd) ? "zstd,zlib" : "zlib";
+}
+
+/**
+ * @brief 协商压缩算法
+ *
+ * @details 按对端给出的顺序选择第一个本端也支持的算法
+ *
+ * @param offered 对端支持的算法列表(逗号分隔)
+ * @return CompressionCodec 选中的算法, 没有共同算法时为`kNone`
+ */
+CompressionCodec Compression::Negotiate(const string& offered) {
+  stringstream ss(offered);
+  string name;
+  while (getline(ss, name, ',')) {
+    name.erase(0, name.find_first_not_of(" \t"));
+    name.erase(name.find_last_not_of(" \t") + 1);
+    CompressionCodec codec;
+    if (!ParseCodec(name, &codec)) continue;
+    if (codec != CompressionCodec::kNone && Available(codec)) return codec;
+  }
+  return CompressionCodec::kNone;
+}
+
+/**
+ * @brief 根据内容样本判断是否值得压缩
+ *
+ * @param sample 内容样本(通常取开头几KB)
+ * @param len 样本长度
+ * @return true 值得压缩
+ * @return false 已压缩的内容
+ */
+bool Compression::LooksCompressible(const char* sample, size_t len) {
+  for (const Magic& magic : kCompressedMagics) {
+    if (len >= magic.len && memcmp(sample, magic.bytes, magic.len) == 0) {
+      return false;
+    }
+  }
+  if (len == 0) return true;
+
+  size_t counts[256] = {0};
+  for (size_t i = 0; i < len; ++i) {
+    ++counts[static_cast<unsigned char>(sample[i])];
+  }
+  double entropy = 0;
+  for (size_t count : counts) {
+    if (count == 0) continue;
+    double p = static_cast<double>(count) / len;
+    entropy -= p * log2(p);
+  }
+  return entropy < kMaxEntropy;
+}
+
+// ==================== CompressionBudget ====================
+
+/**
+ * @brief 构造压缩预算
+ *
+ * @param max_workers 同时进行压缩的最大数量, 小于等于0表示不限制
+ * @param bytes_per_second 每秒最多压缩的字节数, 小于等于0表示不限制
+ */
+CompressionBudget::CompressionBudget(int max_workers,
+                                     long long bytes_per_second)
+    : max_workers_(max_workers), bytes_(bytes_per_second, bytes_per_second) {}
+
+/**
+ * @brief 申请压缩`bytes`字节
+ *
+ * @param bytes 要压缩的字节数
+ * @return true 申请成功, 压缩完成后调用`Release`
+ * @return false 预算不足, 应发送原文
+ */
+bool CompressionBudget::TryAcquire(size_t bytes) {
+  int active = ++active_;
+  if (max_workers_ > 0 && active > max_workers_) {
+    --active_;
+    ++skipped_;
+    return false;
+  }
+  long long want = static_cast<long long>(bytes);
+  long long got = bytes_.Acquire(want);
+  if (got < want) {
+    bytes_.Refund(got);
+    --active_;
+    ++skipped_;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 归还一个压缩名额
+ */
+void CompressionBudget::Release() { --active_; }
+
+// ==================== ChunkEncoder ====================
+
+/**
+ * @brief 压缩上下文, 在数据块之间复用
+ */
+struct ChunkEncoder::Context {
+  z_stream zlib;
+  bool zlib_ready = false;
+#ifdef CROSSOCEAN_WITH_ZSTD
+  ZSTD_CCtx* zstd = nullptr;
+#endif
+
+  ~Context() {
+    if (zlib_ready) deflateEnd(&zlib);
+#ifdef CROSSOCEAN_WITH_ZSTD
+    if (zstd) ZSTD_freeCCtx(zstd);
+#endif
+  }
+};
+
+/**
+ * @brief 构造压缩器
+ *
+ * @param codec 协商得到的压缩算法
+ * @param level 压缩级别, 0为算法默认级别
+ * @param budget 压缩预算, 为`nullptr`时不限制
+ */
+ChunkEncoder::ChunkEncoder(CompressionCodec codec, int level,
+                           CompressionBudget* budget)
+    : codec_(codec), level_(level), budget_(budget), context_(new Context) {
+  if (!Compression::Available(codec_)) {
+    cerr << "ChunkEncoder::ChunkEncoder() Codec "
+         << Compression::CodecName(codec_) << " is not available." << endl;
+    codec_ = CompressionCodec::kNone;
+  }
+}
+
+ChunkEncoder::~ChunkEncoder() {}
+
+/**
+ * @brief 编码一个数据块
+ *
+ * @param data 数据块
+ * @param len 数据块长度, 不能超过`kMaxChunkSize`
+ * @param out 输出缓冲区(追加), 可以复用以减少内存分配
+ * @return true 成功
+ * @return false 数据块过大或压缩出错
+ */
+bool ChunkEncoder::Encode(const char* data, size_t len, string* out) {
+  if (len > kMaxChunkSize) {
+    cerr << "ChunkEncoder::Encode() Chunk too large." << endl;
+    return false;
+  }
+  // 用第一个数据块探测内容, 已压缩的内容整个传输都不再压缩
+  if (!probed_ && len > 0) {
+    probed_ = true;
+    if (codec_ != CompressionCodec::kNone &&
+        !Compression::LooksCompressible(data, min(len, kProbeSize))) {
+      bypassed_ = true;
+    }
+  }
+
+  bool compress = codec_ != CompressionCodec::kNone && !bypassed_ &&
+                  len >= kMinCompressSize;
+  if (compress && budget_ && !budget_->TryAcquire(len)) compress = false;
+
+  size_t header_pos = out->size();
+  out->resize(header_pos + kHeaderSize);
+  if (compress) {
+    bool ok = Compress(data, len, out);
+    if (budget_) budget_->Release();
+    if (!ok) {
+      out->resize(header_pos);
+      return false;
+    }
+    // 压缩后没有变小, 改为发送原文
+    if (out->size() - header_pos - kHeaderSize >= len) {
+      out->resize(header_pos + kHeaderSize);
+      compress = false;
+    }
+  }
+  if (!compress) out->append(data, len);
+
+  char* header = &(*out)[header_pos];
+  header[0] = compress ? kFrameCompressed : kFrameRaw;
+  PutUint(header + 1, len, 4);
+  PutUint(header + 5, out->size() - header_pos - kHeaderSize, 4);
+  raw_bytes_ += len;
+  encoded_bytes_ += out->size() - header_pos;
+  return true;
+}
+
+/**
+ * @brief 压缩数据块, 输出追加到`out`
+ *
+ * @return true 压缩成功
+ */
+bool ChunkEncoder::Compress(const char* data, size_t len, string* out) {
+  size_t pos = out->size();
+  if (codec_ == CompressionCodec::kZlib) {
+    z_stream& zs = context_->zlib;
+    if (!context_->zlib_ready) {
+      memset(&zs, 0, sizeof(zs));
+      int level = level_ == 0 ? Z_DEFAULT_COMPRESSION : level_;
+      if (deflateInit(&zs, level) != Z_OK) {
+        cerr << "ChunkEncoder::Compress() deflateInit failed." << endl;
+        return false;
+      }
+      context_->zlib_ready = true;
+    } else {
+      deflateReset(&zs);
+    }
+    out->resize(pos + deflateBound(&zs, static_cast<uLong>(len)));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = static_cast<uInt>(len);
+    zs.next_out = reinterpret_cast<Bytef*>(&(*out)[pos]);
+    zs.avail_out = static_cast<uInt>(out->size() - pos);
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+      cerr << "ChunkEncoder::Compress() deflate failed." << endl;
+      return false;
+    }
+    out->resize(pos + zs.total_out);
+    return true;
+  }
+#ifdef CROSSOCEAN_WITH_ZSTD
+  if (codec_ == CompressionCodec::kZstd) {
+    if (!context_->zstd) context_->zstd = ZSTD_createCCtx();
+    int level = level_ == 0 ? ZSTD_CLEVEL_DEFAULT : level_;
+    out->resize(pos + ZSTD_compressBound(len));
+    size_t re = ZSTD_compressCCtx(context_->zstd, &(*out)[pos],
+                                  out->size() - pos, data, len, level);
+    if (ZSTD_isError(re)) {
+      cerr << "ChunkEncoder::Compress() " << ZSTD_getErrorName(re) << endl;
+      return false;
+    }
+    out->resize(pos + re);
+    return true;
+  }
+#endif
+  return false;
+}
+
+// ==================== ChunkDecoder ====================
+
+/**
+ * @brief 解压上下文, 在数据块之间复用
+ */
+struct ChunkDecoder::Context {
+  z_stream zlib;
+  bool zlib_ready = false;
+#ifdef CROSSOCEAN_WITH_ZSTD
+  ZSTD_DCtx* zstd = nullptr;
+#endif
+
+  ~Context() {
+    if (zlib_ready) inflateEnd(&zlib);
+#ifdef CROSSOCEAN_WITH_ZSTD
+    if (zstd) ZSTD_freeDCtx(zstd);
+#endif
+  }
+};
+
+/**
+ * @brief 构造解压器
+ *
+ * @param codec 协商得到的压缩算法
+ */
+ChunkDecoder::ChunkDecoder(CompressionCodec codec)
+    : codec_(codec), context_(new Context) {
+  if (!Compression::Available(codec_)) {
+    cerr << "ChunkDecoder::ChunkDecoder() Codec "
+         << Compression::CodecName(codec_) << " is not available." << endl;
+    codec_ = CompressionCodec::kNone;
+  }
+}
+
+ChunkDecoder::~ChunkDecoder() {}
+
+/**
+ * @brief 输入编码数据(可以按任意边界分段输入)
+ *
+ * @param data 编码数据
+ * @param len 数据长度
+ * @param out 输出解码后的原文(追加)
+ * @return true 成功
+ * @return false 格式错误或解压出错
+ */
+bool ChunkDecoder::Feed(const char* data, size_t len, string* out) {
+  const size_t header_size = ChunkEncoder::kHeaderSize;
+  buffer_.append(data, len);
+  size_t pos = 0;
+  bool ok = true;
+  while (buffer_.size() - pos >= header_size) {
+    const char* frame = buffer_.data() + pos;
+    size_t raw_len = static_cast<size_t>(GetUint(frame + 1, 4));
+    size_t payload_len = static_cast<size_t>(GetUint(frame + 5, 4));
+    if (raw_len > ChunkEncoder::kMaxChunkSize ||
+        payload_len > ChunkEncoder::kMaxChunkSize) {
+      cerr << "ChunkDecoder::Feed() Frame too large." << endl;
+      ok = false;
+      break;
+    }
+    if (buffer_.size() - pos - header_size < payload_len) break;
+    const char* payload = frame + header_size;
+    if (frame[0] == kFrameRaw && payload_len == raw_len) {
+      out->append(payload, payload_len);
+    } else if (frame[0] == kFrameCompressed) {
+      ok = Decompress(payload, payload_len, raw_len, out);
+    } else {
+      cerr << "ChunkDecoder::Feed() Invalid frame." << endl;
+      ok = false;
+    }
+    if (!ok) break;
+    pos += header_size + payload_len;
+  }
+  buffer_.erase(0, pos);
+  return ok;
+}
+
+/**
+ * @brief 解压一个压缩帧的负载
+ */
+bool ChunkDecoder::Decompress(const char* data, size_t len, size_t raw_len,
+                              string* out) {
+  size_t pos = out->size();
+  out->resize(pos + raw_len);
+  if (codec_ == CompressionCodec::kZlib) {
+    z_stream& zs = context_->zlib;
+    if (!context_->zlib_ready) {
+      memset(&zs, 0, sizeof(zs));
+      if (inflateInit(&zs) != Z_OK) {
+        cerr << "ChunkDecoder::Decompress() inflateInit failed." << endl;
+        out->resize(pos);
+        return false;
+      }
+      context_->zlib_ready = true;
+    } else {
+      inflateReset(&zs);
+    }
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = static_cast<uInt>(len);
+    zs.next_out = reinterpret_cast<Bytef*>(&(*out)[pos]);
+    zs.avail_out = static_cast<uInt>(raw_len);
+    if (inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out == raw_len) {
+      return true;
+    }
+  }
+#ifdef CROSSOCEAN_WITH_ZSTD
+  if (codec_ == CompressionCodec::kZstd) {
+    if (!context_->zstd) context_->zstd = ZSTD_createDCtx();
+    size_t re =
+        ZSTD_decompressDCtx(context_->zstd, &(*out)[pos], raw_len, data, len);
+    if (!ZSTD_isError(re) && re == raw_len) return true;
+  }
+#endif
+  cerr << "ChunkDecoder::Decompress() Corrupt "
+       << Compression::CodecName(codec_) << " frame." << endl;
+  out->resize(pos);
+  return false;
+}
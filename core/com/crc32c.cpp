@@ -0,0 +1,420 @@
+﻿/**
+ * @file crc32c.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Crc32c`和`ChunkCrc`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/crc32c.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32C_TARGET_SSE42
+#else
+#define CRC32C_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#endif
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief CRC32C 多项式(反射)
+static const uint32_t kPoly = 0x82f63b78;
+/// @brief 硬件实现中三路交错的长块和短块大小
+static const size_t kLongBlock = 8192;
+static const size_t kShortBlock = 256;
+
+/**
+ * @brief 运行时生成的查找表
+ */
+struct Crc32cTables {
+  /// @brief 软件实现按8字节查表
+  uint32_t slice[8][256];
+  /// @brief 跳过`kLongBlock`个零字节的移位表
+  uint32_t long_shift[4][256];
+  /// @brief 跳过`kShortBlock`个零字节的移位表
+  uint32_t short_shift[4][256];
+};
+
+/**
+ * @brief GF(2) 矩阵乘向量
+ */
+static uint32_t MatrixTimes(const uint32_t* mat, uint32_t vec) {
+  uint32_t sum = 0;
+  while (vec) {
+    if (vec & 1) sum ^= *mat;
+    vec >>= 1;
+    ++mat;
+  }
+  return sum;
+}
+
+/**
+ * @brief GF(2) 矩阵平方
+ */
+static void MatrixSquare(uint32_t* square, const uint32_t* mat) {
+  for (int n = 0; n < 32; ++n) square[n] = MatrixTimes(mat, mat[n]);
+}
+
+/**
+ * @brief 生成"在校验和后追加`len`个零字节"的变换表
+ *
+ * @details 追加零字节是线性变换, 先用矩阵平方求出变换矩阵, 再按字节展开成表
+ */
+static void MakeShiftTable(uint32_t table[4][256], size_t len) {
+  uint32_t even[32], odd[32];
+  // 追加1个零位的矩阵
+  odd[0] = kPoly;
+  uint32_t row = 1;
+  for (int n = 1; n < 32; ++n) {
+    odd[n] = row;
+    row <<= 1;
+  }
+  MatrixSquare(even, odd);  // 2个零位
+  MatrixSquare(odd, even);  // 4个零位
+  // 第一次平方得到1个零字节, 之后按`len`的二进制位累乘
+  uint32_t op[32];
+  bool has_op = false;
+  uint32_t* cur = odd;
+  uint32_t* next = even;
+  size_t bytes = len;
+  while (bytes) {
+    MatrixSquare(next, cur);
+    swap(cur, next);
+    if (bytes & 1) {
+      if (!has_op) {
+        memcpy(op, cur, sizeof(op));
+        has_op = true;
+      } else {
+        uint32_t tmp[32];
+        for (int n = 0; n < 32; ++n) tmp[n] = MatrixTimes(cur, op[n]);
+        memcpy(op, tmp, sizeof(op));
+      }
+    }
+    bytes >>= 1;
+  }
+  for (uint32_t n = 0; n < 256; ++n) {
+    table[0][n] = MatrixTimes(op, n);
+    table[1][n] = MatrixTimes(op, n << 8);
+    table[2][n] = MatrixTimes(op, n << 16);
+    table[3][n] = MatrixTimes(op, n << 24);
+  }
+}
+
+static const Crc32cTables& Tables() {
+  static const Crc32cTables* tables = [] {
+    Crc32cTables* t = new Crc32cTables();
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t crc = n;
+      for (int k = 0; k < 8; ++k) crc = crc & 1 ? (crc >> 1) ^ kPoly : crc >> 1;
+      t->slice[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t crc = t->slice[0][n];
+      for (int k = 1; k < 8; ++k) {
+        crc = t->slice[0][crc & 0xff] ^ (crc >> 8);
+        t->slice[k][n] = crc;
+      }
+    }
+    MakeShiftTable(t->long_shift, kLongBlock);
+    MakeShiftTable(t->short_shift, kShortBlock);
+    return t;
+  }();
+  return *tables;
+}
+
+/**
+ * @brief 用移位表把校验和移过若干零字节
+ */
+static inline uint32_t Shift(const uint32_t table[4][256], uint32_t crc) {
+  return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+         table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+/**
+ * @brief 软件实现(用于测试和没有硬件支持的平台)
+ */
+uint32_t Crc32c::ExtendPortable(uint32_t crc, const void* data, size_t len) {
+  const Crc32cTables& t = Tables();
+  const unsigned char* next = static_cast<const unsigned char*>(data);
+  uint64_t crc0 = ~crc;
+  while (len && (reinterpret_cast<uintptr_t>(next) & 7)) {
+    crc0 = t.slice[0][(crc0 ^ *next++) & 0xff] ^ (crc0 >> 8);
+    --len;
+  }
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, next, 8);
+    // 按小端序处理, 大端平台逐字节计算
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    break;
+#endif
+    crc0 ^= word;
+    crc0 = t.slice[7][crc0 & 0xff] ^ t.slice[6][(crc0 >> 8) & 0xff] ^
+           t.slice[5][(crc0 >> 16) & 0xff] ^ t.slice[4][(crc0 >> 24) & 0xff] ^
+           t.slice[3][(crc0 >> 32) & 0xff] ^ t.slice[2][(crc0 >> 40) & 0xff] ^
+           t.slice[1][(crc0 >> 48) & 0xff] ^ t.slice[0][crc0 >> 56];
+    next += 8;
+    len -= 8;
+  }
+  while (len) {
+    crc0 = t.slice[0][(crc0 ^ *next++) & 0xff] ^ (crc0 >> 8);
+    --len;
+  }
+  return static_cast<uint32_t>(~crc0);
+}
+
+#ifdef CRC32C_X86
+/**
+ * @brief 检测CPU是否支持SSE4.2
+ */
+static bool HasSse42() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+#else
+  return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+/**
+ * @brief SSE4.2 硬件实现
+ *
+ * @details
+ * `crc32`指令延迟3个周期、吞吐1个周期, 三段数据交错计算可以让流水线满载,
+ * 最后用移位表把三段的结果合并
+ */
+CRC32C_TARGET_SSE42
+static uint32_t ExtendSse42(uint32_t crc, const void* data, size_t len) {
+  const Crc32cTables& t = Tables();
+  const unsigned char* next = static_cast<const unsigned char*>(data);
+  uint64_t crc0 = static_cast<uint32_t>(~crc);
+  while (len && (reinterpret_cast<uintptr_t>(next) & 7)) {
+    crc0 = _mm_crc32_u8(static_cast<uint32_t>(crc0), *next++);
+    --len;
+  }
+
+  while (len >= kLongBlock * 3) {
+    uint64_t crc1 = 0, crc2 = 0;
+    const unsigned char* end = next + kLongBlock;
+    do {
+      uint64_t w0, w1, w2;
+      memcpy(&w0, next, 8);
+      memcpy(&w1, next + kLongBlock, 8);
+      memcpy(&w2, next + kLongBlock * 2, 8);
+      crc0 = _mm_crc32_u64(crc0, w0);
+      crc1 = _mm_crc32_u64(crc1, w1);
+      crc2 = _mm_crc32_u64(crc2, w2);
+      next += 8;
+    } while (next < end);
+    crc0 = Shift(t.long_shift, static_cast<uint32_t>(crc0)) ^ crc1;
+    crc0 = Shift(t.long_shift, static_cast<uint32_t>(crc0)) ^ crc2;
+    next += kLongBlock * 2;
+    len -= kLongBlock * 3;
+  }
+
+  while (len >= kShortBlock * 3) {
+    uint64_t crc1 = 0, crc2 = 0;
+    const unsigned char* end = next + kShortBlock;
+    do {
+      uint64_t w0, w1, w2;
+      memcpy(&w0, next, 8);
+      memcpy(&w1, next + kShortBlock, 8);
+      memcpy(&w2, next + kShortBlock * 2, 8);
+      crc0 = _mm_crc32_u64(crc0, w0);
+      crc1 = _mm_crc32_u64(crc1, w1);
+      crc2 = _mm_crc32_u64(crc2, w2);
+      next += 8;
+    } while (next < end);
+    crc0 = Shift(t.short_shift, static_cast<uint32_t>(crc0)) ^ crc1;
+    crc0 = Shift(t.short_shift, static_cast<uint32_t>(crc0)) ^ crc2;
+    next += kShortBlock * 2;
+    len -= kShortBlock * 3;
+  }
+
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, next, 8);
+    crc0 = _mm_crc32_u64(crc0, word);
+    next += 8;
+    len -= 8;
+  }
+  while (len) {
+    crc0 = _mm_crc32_u8(static_cast<uint32_t>(crc0), *next++);
+    --len;
+  }
+  return static_cast<uint32_t>(~crc0);
+}
+#endif
+
+using ExtendFunc = uint32_t (*)(uint32_t, const void*, size_t);
+
+/**
+ * @brief 选择当前CPU可用的最快实现(只检测一次)
+ */
+static ExtendFunc SelectExtend() {
+  static const ExtendFunc func = [] {
+#ifdef CRC32C_X86
+    if (HasSse42()) return static_cast<ExtendFunc>(ExtendSse42);
+#endif
+    return static_cast<ExtendFunc>(Crc32c::ExtendPortable);
+  }();
+  return func;
+}
+
+/**
+ * @brief 在已有校验和基础上继续计算
+ *
+ * @param crc 之前数据的校验和(初始为0)
+ * @param data 数据
+ * @param len 数据长度
+ * @return uint32_t 包含新数据的校验和
+ */
+uint32_t Crc32c::Extend(uint32_t crc, const void* data, size_t len) {
+  return SelectExtend()(crc, data, len);
+}
+
+/**
+ * @brief 当前使用的实现名称
+ *
+ * @return const char* "sse4.2" 或 "portable"
+ */
+const char* Crc32c::Backend() {
+  return SelectExtend() == Crc32c::ExtendPortable ? "portable" : "sse4.2";
+}
+
+/**
+ * @brief 构造分块校验
+ *
+ * @param chunk_size 块大小
+ */
+ChunkCrc::ChunkCrc(size_t chunk_size)
+    : chunk_size_(chunk_size > 0 ? chunk_size : 1024 * 1024) {}
+
+/**
+ * @brief 输入数据
+ *
+ * @param data 数据
+ * @param len 数据长度
+ */
+void ChunkCrc::Update(const void* data, size_t len) {
+  const char* next = static_cast<const char*>(data);
+  total_size_ += len;
+  while (len > 0) {
+    size_t fill = min(len, chunk_size_ - filled_);
+    current_ = Crc32c::Extend(current_, next, fill);
+    filled_ += fill;
+    next += fill;
+    len -= fill;
+    if (filled_ == chunk_size_) {
+      crcs_.push_back(current_);
+      current_ = 0;
+      filled_ = 0;
+    }
+  }
+}
+
+/**
+ * @brief 输入结束, 保存最后一个不完整的块
+ */
+void ChunkCrc::Finish() {
+  if (filled_ > 0) {
+    crcs_.push_back(current_);
+    current_ = 0;
+    filled_ = 0;
+  }
+}
+
+/**
+ * @brief 校验和文件路径
+ *
+ * @param path 数据文件路径
+ * @return std::string 校验和文件路径(`<path>.crc32c`)
+ */
+string ChunkCrc::SidecarPath(const string& path) { return path + ".crc32c"; }
+
+/**
+ * @brief 保存校验和文件
+ *
+ * @param path 校验和文件路径
+ * @return true 成功
+ * @return false 写入失败
+ */
+bool ChunkCrc::Save(const string& path) const {
+  ofstream out(path, ios::trunc);
+  out << "crc32c " << chunk_size_ << " " << total_size_ << "\n";
+  char hex[16];
+  for (uint32_t crc : crcs_) {
+    snprintf(hex, sizeof(hex), "%08x\n", crc);
+    out << hex;
+  }
+  return static_cast<bool>(out);
+}
+
+/**
+ * @brief 读取校验和文件
+ *
+ * @param path 校验和文件路径
+ * @return true 成功
+ * @return false 文件不存在或格式错误
+ */
+bool ChunkCrc::Load(const string& path) {
+  ifstream in(path);
+  string magic;
+  size_t chunk_size = 0;
+  long long total_size = 0;
+  if (!(in >> magic >> chunk_size >> total_size) || magic != "crc32c" ||
+      chunk_size == 0) {
+    return false;
+  }
+  vector<uint32_t> crcs;
+  string hex;
+  while (in >> hex) {
+    char* end = nullptr;
+    unsigned long crc = strtoul(hex.c_str(), &end, 16);
+    if (hex.empty() || *end != '\0') return false;
+    crcs.push_back(static_cast<uint32_t>(crc));
+  }
+  if (static_cast<long long>(crcs.size()) !=
+      (total_size + static_cast<long long>(chunk_size) - 1) /
+          static_cast<long long>(chunk_size)) {
+    return false;
+  }
+  chunk_size_ = chunk_size;
+  total_size_ = total_size;
+  crcs_.swap(crcs);
+  filled_ = 0;
+  current_ = 0;
+  return true;
+}
+
+/**
+ * @brief 比较两组校验和
+ *
+ * @param other 另一组校验和
+ * @return long long 第一个不一致的块号, 完全一致返回-1
+ */
+long long ChunkCrc::FirstMismatch(const ChunkCrc& other) const {
+  if (chunk_size_ != other.chunk_size_) return 0;
+  size_t count = min(crcs_.size(), other.crcs_.size());
+  for (size_t i = 0; i < count; ++i) {
+    if (crcs_[i] != other.crcs_[i]) return static_cast<long long>(i);
+  }
+  if (crcs_.size() != other.crcs_.size() ||
+      total_size_ != other.total_size_) {
+    return static_cast<long long>(count);
+  }
+  return -1;
+}
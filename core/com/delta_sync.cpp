@@ -0,0 +1,676 @@
+﻿/**
+ * @file delta_sync.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief 增量同步(`rsync`算法)相关类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/delta_sync.h"
+
+#include <fcntl.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "include/blocking_pool.h"
+#include "include/sha256.h"
+#include "util.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 签名编码的魔数
+static const char kSignatureMagic[4] = {'D', 'S', 'I', 'G'};
+/// @brief 最小块大小(与`rsync`一致)
+static const uint32_t kMinBlockSize = 700;
+/// @brief 最大块大小
+static const uint32_t kMaxBlockSize = 128 * 1024;
+/// @brief 生成器缓存新数据的上限, 超过后输出一条新数据指令
+static const size_t kMaxLiteral = 1024 * 1024;
+/// @brief 重建器接受的单条新数据指令长度上限
+static const long long kMaxLiteralOp = 16 * 1024 * 1024;
+/// @brief 复制回退路径的缓冲区大小
+static const size_t kCopyBufferSize = 256 * 1024;
+
+/// @brief 复制指令标记
+static const char kOpCopy = 'C';
+/// @brief 新数据指令标记
+static const char kOpLiteral = 'L';
+
+// ==================== RollingChecksum ====================
+
+/**
+ * @brief 重新计算窗口的校验和
+ *
+ * @param data 窗口数据
+ * @param len 窗口长度
+ */
+void RollingChecksum::Reset(const char* data, size_t len) {
+  a_ = 0;
+  b_ = 0;
+  len_ = static_cast<uint32_t>(len);
+  for (size_t i = 0; i < len; ++i) {
+    a_ += static_cast<unsigned char>(data[i]);
+    b_ += a_;
+  }
+  a_ &= 0xffff;
+  b_ &= 0xffff;
+}
+
+/**
+ * @brief 窗口向后滑动一个字节
+ *
+ * @param out 移出窗口的字节
+ * @param in 移入窗口的字节
+ */
+void RollingChecksum::Roll(char out, char in) {
+  uint32_t x = static_cast<unsigned char>(out);
+  uint32_t y = static_cast<unsigned char>(in);
+  a_ = (a_ - x + y) & 0xffff;
+  b_ = (b_ - len_ * x + a_) & 0xffff;
+}
+
+// ==================== FileSignature ====================
+
+/**
+ * @brief 根据文件大小选择块大小(约为文件大小的平方根)
+ *
+ * @param file_size 文件大小
+ * @return uint32_t 块大小
+ */
+uint32_t FileSignature::DefaultBlockSize(long long file_size) {
+  if (file_size <= 0) return kMinBlockSize;
+  uint64_t size = static_cast<uint64_t>(sqrt(static_cast<double>(file_size)));
+  size &= ~static_cast<uint64_t>(7);  // 按8字节对齐
+  if (size < kMinBlockSize) return kMinBlockSize;
+  if (size > kMaxBlockSize) return kMaxBlockSize;
+  return static_cast<uint32_t>(size);
+}
+
+/**
+ * @brief 计算强校验和
+ *
+ * @param data 数据
+ * @param len 数据长度
+ * @return std::string 强校验和
+ */
+string FileSignature::StrongSum(const char* data, size_t len) {
+  Sha256 sha;
+  sha.Update(data, len);
+  unsigned char digest[Sha256::kDigestSize];
+  sha.Final(digest);
+  return string(reinterpret_cast<char*>(digest), kStrongSize);
+}
+
+/**
+ * @brief 读取文件计算签名(阻塞)
+ *
+ * @param fd 文件描述符
+ * @param block_size 块大小, 0为按文件大小选择
+ * @param signature 输出签名
+ * @return true 计算成功
+ * @return false 读取文件失败
+ */
+bool FileSignature::Compute(int fd, uint32_t block_size,
+                            FileSignature* signature) {
+  if (fd < 0 || !signature) {
+    cerr << "FileSignature::Compute() Invalid argument." << endl;
+    return false;
+  }
+  if (block_size == 0) {
+#ifdef _WIN32
+    long long size = _lseeki64(fd, 0, SEEK_END);
+#else
+    long long size = lseek(fd, 0, SEEK_END);
+#endif
+    block_size = DefaultBlockSize(size);
+  }
+  signature->block_size = block_size;
+  signature->file_size = 0;
+  signature->blocks.clear();
+
+  // 一次读取多个块, 减少系统调用
+  size_t blocks_per_read = max<size_t>(1, kCopyBufferSize / block_size);
+  vector<char> buf(blocks_per_read * block_size);
+  RollingChecksum rolling;
+  for (;;) {
+    long long len = ReadFull(fd, buf.data(), buf.size(), signature->file_size);
+    if (len < 0) {
+      cerr << "FileSignature::Compute() Failed to read file." << endl;
+      return false;
+    }
+    for (long long pos = 0; pos < len; pos += block_size) {
+      size_t n = static_cast<size_t>(min<long long>(block_size, len - pos));
+      BlockSignature block;
+      rolling.Reset(buf.data() + pos, n);
+      block.weak = rolling.value();
+      block.strong = StrongSum(buf.data() + pos, n);
+      signature->blocks.push_back(move(block));
+    }
+    signature->file_size += len;
+    if (len < static_cast<long long>(buf.size())) break;
+  }
+  return true;
+}
+
+/**
+ * @brief 在阻塞I/O线程池中计算签名, 完成后在`thread`中回调
+ *
+ * @param pool 阻塞I/O线程池
+ * @param path 文件路径
+ * @param block_size 块大小, 0为按文件大小选择
+ * @param thread 执行回调的线程
+ * @param done 完成回调, 失败时签名为`nullptr`
+ * @return true 已提交
+ * @return false 提交失败
+ */
+bool FileSignature::ComputeAsync(
+    BlockingPool* pool, const string& path, uint32_t block_size,
+    Thread* thread, function<void(shared_ptr<FileSignature>)> done) {
+  if (!pool) {
+    cerr << "FileSignature::ComputeAsync() Invalid pool." << endl;
+    return false;
+  }
+  auto signature = make_shared<FileSignature>();
+  auto ok = make_shared<bool>(false);
+  return pool->Submit(
+      [path, block_size, signature, ok]() {
+#ifdef _WIN32
+        int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+#endif
+        if (fd < 0) {
+          cerr << "FileSignature::ComputeAsync() Failed to open " << path
+               << endl;
+          return;
+        }
+        *ok = Compute(fd, block_size, signature.get());
+        CloseFd(fd);
+      },
+      thread,
+      [signature, ok, done]() {
+        if (done) done(*ok ? signature : nullptr);
+      });
+}
+
+/**
+ * @brief 编码为网络格式
+ *
+ * @param out 输出缓冲区(追加)
+ */
+void FileSignature::Serialize(string* out) const {
+  out->append(kSignatureMagic, sizeof(kSignatureMagic));
+  PutUint(out, block_size, 4);
+  PutUint(out, static_cast<uint64_t>(file_size), 8);
+  PutUint(out, blocks.size(), 4);
+  for (const BlockSignature& block : blocks) {
+    PutUint(out, block.weak, 4);
+    out->append(block.strong);
+  }
+}
+
+/**
+ * @brief 从网络格式解码
+ *
+ * @param data 编码数据
+ * @return true 解码成功
+ * @return false 数据格式错误
+ */
+bool FileSignature::Parse(const string& data) {
+  const size_t header_size = sizeof(kSignatureMagic) + 4 + 8 + 4;
+  const size_t entry_size = 4 + kStrongSize;
+  if (data.size() < header_size ||
+      memcmp(data.data(), kSignatureMagic, sizeof(kSignatureMagic)) != 0) {
+    cerr << "FileSignature::Parse() Invalid header." << endl;
+    return false;
+  }
+  const char* p = data.data() + sizeof(kSignatureMagic);
+  uint32_t size = static_cast<uint32_t>(GetUint(p, 4));
+  long long total = static_cast<long long>(GetUint(p + 4, 8));
+  uint64_t count = GetUint(p + 12, 4);
+  p += 16;
+  if (size == 0 || total < 0 ||
+      data.size() != header_size + count * entry_size ||
+      count != static_cast<uint64_t>((total + size - 1) / size)) {
+    cerr << "FileSignature::Parse() Invalid block table." << endl;
+    return false;
+  }
+  block_size = size;
+  file_size = total;
+  blocks.resize(count);
+  for (BlockSignature& block : blocks) {
+    block.weak = static_cast<uint32_t>(GetUint(p, 4));
+    block.strong.assign(p + 4, kStrongSize);
+    p += entry_size;
+  }
+  return true;
+}
+
+/**
+ * @brief 获取第`index`块的长度
+ */
+size_t FileSignature::BlockLength(size_t index) const {
+  long long offset = static_cast<long long>(index) * block_size;
+  return static_cast<size_t>(min<long long>(block_size, file_size - offset));
+}
+
+// ==================== DeltaOp ====================
+
+/**
+ * @brief 编码为网络格式
+ *
+ * @details 复制指令: 'C' 偏移(8字节) 长度(8字节);
+ * 新数据指令: 'L' 长度(8字节) 数据
+ *
+ * @param out 输出缓冲区(追加)
+ */
+void DeltaOp::Encode(string* out) const {
+  if (type == DeltaOpType::kCopy) {
+    out->push_back(kOpCopy);
+    PutUint(out, static_cast<uint64_t>(offset), 8);
+    PutUint(out, static_cast<uint64_t>(length), 8);
+  } else {
+    out->push_back(kOpLiteral);
+    PutUint(out, data.size(), 8);
+    out->append(data);
+  }
+}
+
+// ==================== DeltaGenerator ====================
+
+/**
+ * @brief 构造增量生成器
+ *
+ * @param signature 基准文件签名
+ * @param callback 指令回调
+ */
+DeltaGenerator::DeltaGenerator(const FileSignature& signature,
+                               OpCallback callback)
+    : signature_(signature), callback_(move(callback)) {
+  for (size_t i = 0; i < signature_.blocks.size(); ++i) {
+    // 最后一块较短时不参与滑动匹配, 在`Finish`中单独比较
+    if (signature_.BlockLength(i) != signature_.block_size) continue;
+    index_[signature_.blocks[i].weak].push_back(static_cast<uint32_t>(i));
+  }
+}
+
+/**
+ * @brief 输入新文件数据
+ *
+ * @param data 数据
+ * @param len 数据长度
+ * @return true 成功
+ * @return false 指令回调中止
+ */
+bool DeltaGenerator::Update(const char* data, size_t len) {
+  if (aborted_) return false;
+  pending_.append(data, len);
+  const size_t block_size = signature_.block_size;
+  if (block_size == 0 || index_.empty()) {
+    // 没有可匹配的块, 全部作为新数据
+    literal_.append(pending_);
+    literal_bytes_ += pending_.size();
+    pending_.clear();
+    if (literal_.size() >= kMaxLiteral) FlushLiteral();
+    return !aborted_;
+  }
+
+  while (!aborted_ && pending_.size() - pos_ >= block_size) {
+    const char* window = pending_.data() + pos_;
+    if (!rolling_valid_) {
+      rolling_.Reset(window, block_size);
+      rolling_valid_ = true;
+    }
+    long long block = FindBlock(window);
+    if (block >= 0) {
+      EmitCopy(block * block_size, block_size);
+      last_block_ = block;
+      pos_ += block_size;
+      rolling_valid_ = false;
+      continue;
+    }
+    // 没有匹配, 窗口滑动一个字节
+    literal_.push_back(*window);
+    ++literal_bytes_;
+    if (pending_.size() - pos_ > block_size) {
+      rolling_.Roll(window[0], window[block_size]);
+    } else {
+      rolling_valid_ = false;
+    }
+    ++pos_;
+    if (literal_.size() >= kMaxLiteral) FlushLiteral();
+  }
+  // 只保留不足一个窗口的数据
+  pending_.erase(0, pos_);
+  pos_ = 0;
+  return !aborted_;
+}
+
+/**
+ * @brief 输入结束, 输出剩余指令
+ *
+ * @return true 成功
+ * @return false 指令回调中止
+ */
+bool DeltaGenerator::Finish() {
+  if (aborted_) return false;
+  // 剩余数据可能与基准文件较短的最后一块相同
+  size_t count = signature_.blocks.size();
+  if (count > 0 && !pending_.empty()) {
+    size_t last = count - 1;
+    size_t last_len = signature_.BlockLength(last);
+    if (last_len == pending_.size() &&
+        FileSignature::StrongSum(pending_.data(), last_len) ==
+            signature_.blocks[last].strong) {
+      EmitCopy(static_cast<long long>(last) * signature_.block_size,
+               last_len);
+      pending_.clear();
+    }
+  }
+  literal_.append(pending_);
+  literal_bytes_ += pending_.size();
+  pending_.clear();
+  FlushLiteral();
+  FlushCopy();
+  return !aborted_;
+}
+
+/**
+ * @brief 查找与窗口内容相同的基准块
+ *
+ * @param data 窗口数据
+ * @return long long 块号, 没有匹配返回-1
+ */
+long long DeltaGenerator::FindBlock(const char* data) {
+  auto it = index_.find(rolling_.value());
+  if (it == index_.end()) return -1;
+  // 弱校验和命中后才计算强校验和
+  string strong = FileSignature::StrongSum(data, signature_.block_size);
+  long long found = -1;
+  for (uint32_t block : it->second) {
+    if (signature_.blocks[block].strong != strong) continue;
+    // 优先选择上一块的后一块, 便于合并复制指令
+    if (block == last_block_ + 1) return block;
+    if (found < 0) found = block;
+  }
+  return found;
+}
+
+/**
+ * @brief 输出复制指令(与上一条复制指令相邻时合并)
+ */
+void DeltaGenerator::EmitCopy(long long offset, long long length) {
+  FlushLiteral();
+  copied_bytes_ += length;
+  if (copy_length_ > 0 && copy_offset_ + copy_length_ == offset) {
+    copy_length_ += length;
+    return;
+  }
+  FlushCopy();
+  copy_offset_ = offset;
+  copy_length_ = length;
+}
+
+/**
+ * @brief 输出缓存的复制指令
+ */
+void DeltaGenerator::FlushCopy() {
+  if (copy_length_ == 0) return;
+  DeltaOp op;
+  op.type = DeltaOpType::kCopy;
+  op.offset = copy_offset_;
+  op.length = copy_length_;
+  copy_length_ = 0;
+  Emit(op);
+}
+
+/**
+ * @brief 输出缓存的新数据(先输出之前的复制指令)
+ */
+void DeltaGenerator::FlushLiteral() {
+  if (literal_.empty()) return;
+  FlushCopy();
+  DeltaOp op;
+  op.type = DeltaOpType::kLiteral;
+  op.length = static_cast<long long>(literal_.size());
+  op.data.swap(literal_);
+  Emit(op);
+}
+
+/**
+ * @brief 调用指令回调
+ */
+void DeltaGenerator::Emit(const DeltaOp& op) {
+  if (aborted_) return;
+  if (callback_ && !callback_(op)) aborted_ = true;
+}
+
+// ==================== DeltaPatcher ====================
+
+/// @brief 临时文件序号
+static atomic<long long> patch_seq{0};
+
+/**
+ * @brief 构造增量重建器
+ *
+ * @details 临时文件名带进程号和序号(`文件名.<进程号>.<序号>.delta.tmp`),
+ * 同一文件同时进行的多次重建不会共用临时文件
+ *
+ * @param path 要更新的文件路径(同时是基准文件)
+ */
+DeltaPatcher::DeltaPatcher(const string& path)
+    : path_(path),
+      temp_path_(path + "." + to_string(getpid()) + "." +
+                 to_string(++patch_seq) + ".delta.tmp") {}
+
+DeltaPatcher::~DeltaPatcher() {
+  Abort();
+  CloseFd(basis_fd_);
+}
+
+/**
+ * @brief 打开基准文件并创建临时文件
+ *
+ * @details 基准文件不存在时只接受新数据指令
+ *
+ * @return true 成功
+ * @return false 创建临时文件失败
+ */
+bool DeltaPatcher::Open() {
+#ifdef _WIN32
+  basis_fd_ = _open(path_.c_str(), _O_RDONLY | _O_BINARY);
+  if (basis_fd_ >= 0) basis_size_ = _lseeki64(basis_fd_, 0, SEEK_END);
+  out_fd_ = _open(temp_path_.c_str(),
+                  _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, 0644);
+#else
+  basis_fd_ = open(path_.c_str(), O_RDONLY);
+  if (basis_fd_ >= 0) basis_size_ = lseek(basis_fd_, 0, SEEK_END);
+  out_fd_ = open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+#endif
+  if (out_fd_ < 0) {
+    cerr << "DeltaPatcher::Open() Failed to create " << temp_path_ << endl;
+    return false;
+  }
+  out_offset_ = 0;
+  buffer_.clear();
+  return true;
+}
+
+/**
+ * @brief 执行一条增量指令
+ *
+ * @param op 增量指令
+ * @return true 成功
+ * @return false 指令越界或写入失败
+ */
+bool DeltaPatcher::Apply(const DeltaOp& op) {
+  if (out_fd_ < 0) {
+    cerr << "DeltaPatcher::Apply() Not opened." << endl;
+    return false;
+  }
+  if (op.type == DeltaOpType::kLiteral) {
+    if (!Write(op.data.data(), op.data.size())) return false;
+    literal_bytes_ += op.data.size();
+    return true;
+  }
+  // 先比较再相减, 偏移和长度都接近上限时不会溢出
+  if (basis_fd_ < 0 || op.offset < 0 || op.length < 0 ||
+      op.offset > basis_size_ || op.length > basis_size_ - op.offset) {
+    cerr << "DeltaPatcher::Apply() Copy out of range." << endl;
+    return false;
+  }
+  if (!CopyRange(op.offset, op.length)) return false;
+  copied_bytes_ += op.length;
+  return true;
+}
+
+/**
+ * @brief 输入网络格式的增量指令流(可以分段输入)
+ *
+ * @param data 数据
+ * @param len 数据长度
+ * @return true 成功
+ * @return false 格式错误或执行失败
+ */
+bool DeltaPatcher::Feed(const char* data, size_t len) {
+  buffer_.append(data, len);
+  size_t pos = 0;
+  bool ok = true;
+  while (ok && pos < buffer_.size()) {
+    const char* p = buffer_.data() + pos;
+    size_t left = buffer_.size() - pos;
+    DeltaOp op;
+    if (p[0] == kOpCopy) {
+      if (left < 17) break;
+      op.type = DeltaOpType::kCopy;
+      op.offset = static_cast<long long>(GetUint(p + 1, 8));
+      op.length = static_cast<long long>(GetUint(p + 9, 8));
+      pos += 17;
+    } else if (p[0] == kOpLiteral) {
+      if (left < 9) break;
+      long long size = static_cast<long long>(GetUint(p + 1, 8));
+      if (size < 0 || size > kMaxLiteralOp) {
+        cerr << "DeltaPatcher::Feed() Literal too large." << endl;
+        ok = false;
+        break;
+      }
+      if (left < 9 + static_cast<size_t>(size)) break;
+      op.type = DeltaOpType::kLiteral;
+      op.data.assign(p + 9, size);
+      pos += 9 + size;
+    } else {
+      cerr << "DeltaPatcher::Feed() Invalid op." << endl;
+      ok = false;
+      break;
+    }
+    ok = Apply(op);
+  }
+  buffer_.erase(0, pos);
+  return ok;
+}
+
+/**
+ * @brief 完成重建, 用新文件替换原文件
+ *
+ * @return true 成功
+ * @return false 指令流不完整或替换失败
+ */
+bool DeltaPatcher::Finish() {
+  if (out_fd_ < 0) {
+    cerr << "DeltaPatcher::Finish() Not opened." << endl;
+    return false;
+  }
+  if (!buffer_.empty()) {
+    cerr << "DeltaPatcher::Finish() Incomplete delta stream." << endl;
+    Abort();
+    return false;
+  }
+  CloseFd(out_fd_);
+  out_fd_ = -1;
+  // Windows 不能替换仍被打开的文件
+  CloseFd(basis_fd_);
+  basis_fd_ = -1;
+  error_code ec;
+  filesystem::rename(temp_path_, path_, ec);
+  if (ec) {
+    cerr << "DeltaPatcher::Finish() Failed to replace " << path_ << ": "
+         << ec.message() << endl;
+    filesystem::remove(temp_path_, ec);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 放弃重建, 删除临时文件
+ */
+void DeltaPatcher::Abort() {
+  if (out_fd_ < 0) return;
+  CloseFd(out_fd_);
+  out_fd_ = -1;
+  error_code ec;
+  filesystem::remove(temp_path_, ec);
+}
+
+/**
+ * @brief 从基准文件复制数据到临时文件
+ */
+bool DeltaPatcher::CopyRange(long long offset, long long length) {
+#if defined(__linux__)
+  // 内核中直接复制, 支持reflink的文件系统只共享数据块
+  loff_t in_offset = offset;
+  loff_t out_offset = out_offset_;
+  while (length > 0) {
+    ssize_t re = copy_file_range(basis_fd_, &in_offset, out_fd_, &out_offset,
+                                 static_cast<size_t>(length), 0);
+    if (re < 0 && errno == EINTR) continue;
+    // 跨文件系统或内核不支持时回退到读写复制
+    if (re <= 0) break;
+    length -= re;
+    offset += re;
+    out_offset_ += re;
+  }
+  if (length == 0) return true;
+#endif
+  long long buf_size = min<long long>(length, kCopyBufferSize);
+  vector<char> buf(static_cast<size_t>(buf_size));
+  while (length > 0) {
+    size_t n = static_cast<size_t>(min<long long>(length, buf.size()));
+    long long re = ReadFull(basis_fd_, buf.data(), n, offset);
+    if (re != static_cast<long long>(n)) {
+      cerr << "DeltaPatcher::CopyRange() Failed to read basis file." << endl;
+      return false;
+    }
+    if (!Write(buf.data(), n)) return false;
+    offset += n;
+    length -= n;
+  }
+  return true;
+}
+
+/**
+ * @brief 写入数据到临时文件
+ */
+bool DeltaPatcher::Write(const char* data, size_t len) {
+  if (!WriteFull(out_fd_, data, len, out_offset_)) {
+    cerr << "DeltaPatcher::Write() Failed to write " << temp_path_ << endl;
+    return false;
+  }
+  out_offset_ += len;
+  return true;
+}
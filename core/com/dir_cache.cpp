@@ -0,0 +1,583 @@
+﻿/**
+ * @file dir_cache.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `DirCache`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/dir_cache.h"
+
+#include <sys/stat.h>
+
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <utility>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "util.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+USING_CROSSOCEAN_NAMESPACE
+
+#ifdef __linux__
+/// @brief 监视的事件: 目录项增删改名、属性变化、写入后关闭, 以及目录自身被删除
+static const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE |
+                                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+#endif
+
+/**
+ * @brief 追加varint编码的整数
+ */
+static void PutVarint(string* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+/**
+ * @brief 读取varint编码的整数
+ */
+static bool GetVarint(const string& data, size_t* pos, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *pos < data.size(); shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(data[(*pos)++]);
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief 追加长度前缀的字段
+ */
+static void PutBytes(string* out, int field, const string& bytes) {
+  PutVarint(out, static_cast<uint64_t>(field) << 3 | 2);
+  PutVarint(out, bytes.size());
+  out->append(bytes);
+}
+
+/**
+ * @brief 编码目录项为`Listing.entries`字段
+ */
+static string EncodeEntry(const DirEntry& entry) {
+  string body;
+  PutBytes(&body, 1, entry.name);
+  if (entry.is_dir) {
+    PutVarint(&body, 2 << 3);
+    PutVarint(&body, 1);
+  }
+  PutVarint(&body, 3 << 3);
+  PutVarint(&body, static_cast<uint64_t>(entry.size));
+  PutVarint(&body, 4 << 3);
+  PutVarint(&body, static_cast<uint64_t>(entry.mtime_ns));
+  string field;
+  PutBytes(&field, 1, body);
+  return field;
+}
+
+/**
+ * @brief 解码`Entry`消息
+ */
+static bool DecodeEntry(const string& data, DirEntry* entry) {
+  size_t pos = 0;
+  while (pos < data.size()) {
+    uint64_t key = 0, value = 0;
+    if (!GetVarint(data, &pos, &key)) return false;
+    int wire = static_cast<int>(key & 7);
+    if (wire == 2) {
+      if (!GetVarint(data, &pos, &value) || value > data.size() - pos) {
+        return false;
+      }
+      if ((key >> 3) == 1) entry->name = data.substr(pos, value);
+      pos += value;
+    } else if (wire == 0) {
+      if (!GetVarint(data, &pos, &value)) return false;
+      switch (key >> 3) {
+        case 2:
+          entry->is_dir = value != 0;
+          break;
+        case 3:
+          entry->size = static_cast<long long>(value);
+          break;
+        case 4:
+          entry->mtime_ns = static_cast<long long>(value);
+          break;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief 读取目录项的元数据
+ *
+ * @param path 目录项的完整路径
+ * @param name 目录项名称
+ * @param entry 输出目录项
+ * @return true 成功
+ * @return false 不存在
+ */
+static bool StatEntry(const string& path, const string& name,
+                      DirEntry* entry) {
+  StatType st;
+  if (FileStat(path.c_str(), &st) != 0) return false;
+  entry->name = name;
+  entry->is_dir = (st.st_mode & S_IFMT) == S_IFDIR;
+  entry->size = entry->is_dir ? 0 : static_cast<long long>(st.st_size);
+  entry->mtime_ns = MtimeNs(st);
+  return true;
+}
+
+/**
+ * @brief 拼接目录路径和名称
+ */
+static string Join(const string& dir, const string& name) {
+  return dir.empty() ? name : dir + "/" + name;
+}
+
+/**
+ * @brief 构造目录列表缓存
+ *
+ * @param root 根目录, 列表请求的路径都相对于该目录
+ * @param max_dirs 缓存的目录数量上限
+ */
+DirCache::DirCache(const string& root, int max_dirs)
+    : root_(root), max_dirs_(max_dirs > 0 ? max_dirs : 1) {}
+
+/**
+ * @brief 关闭inotify
+ */
+DirCache::~DirCache() {
+#ifdef __linux__
+  if (inotify_fd_ >= 0) close(inotify_fd_);
+#endif
+}
+
+/**
+ * @brief 初始化inotify(非Linux系统或初始化失败时改为检查目录修改时间)
+ *
+ * @return true 已启用inotify
+ * @return false 未启用inotify
+ */
+bool DirCache::Init() {
+#ifdef __linux__
+  if (inotify_fd_ >= 0) return true;
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    cerr << "DirCache::Init() inotify_init1 failed, fall back to mtime check"
+         << endl;
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief 规范化相对路径(去掉多余的`/`和`.`)
+ *
+ * @param path 相对路径
+ * @param normalized 输出规范化的路径, 根目录为空
+ * @return true 成功
+ * @return false 包含`..`或为绝对路径
+ */
+bool DirCache::Normalize(const string& path, string* normalized) {
+  normalized->clear();
+  if (!path.empty() && !ValidRelativePath(path)) return false;
+  size_t begin = 0;
+  while (begin <= path.size()) {
+    size_t end = path.find('/', begin);
+    if (end == string::npos) end = path.size();
+    string part = path.substr(begin, end - begin);
+    begin = end + 1;
+    if (part.empty() || part == ".") continue;
+    *normalized = Join(*normalized, part);
+  }
+  return true;
+}
+
+/**
+ * @brief 读取目录的所有目录项(不持有锁)
+ *
+ * @param dir 规范化的目录路径
+ * @param listing 输出列表
+ * @return true 成功
+ * @return false 目录不存在
+ */
+bool DirCache::Load(const string& dir, Listing* listing) const {
+  string path = Join(root_, dir);
+  StatType st;
+  if (FileStat(path.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFDIR) {
+    return false;
+  }
+  listing->mtime_ns = MtimeNs(st);
+#ifdef __linux__
+  // 先添加监视再读取, 读取期间的修改会产生事件
+  if (inotify_fd_ >= 0) {
+    listing->wd = inotify_add_watch(inotify_fd_, path.c_str(), kWatchMask);
+  }
+#endif
+
+  error_code ec;
+  fs::directory_iterator it(path, ec);
+  if (ec) return false;
+  for (fs::directory_iterator end; it != end; it.increment(ec)) {
+    if (ec) return false;
+    string name = it->path().filename().string();
+    DirEntry entry;
+    // 读取和`stat`之间被删除的项直接跳过
+    if (!StatEntry(it->path().string(), name, &entry)) continue;
+    listing->entries[name] = EncodeEntry(entry);
+  }
+  return true;
+}
+
+/**
+ * @brief 列出目录, 优先使用缓存
+ *
+ * @param dir 相对根目录的目录路径, 空为根目录
+ * @param cursor 上一页返回的游标, 空为第一页
+ * @param limit 每页最多的目录项数量, 小于等于0为不分页
+ * @param page 输出的一页列表
+ * @return true 成功
+ * @return false 路径非法或目录不存在
+ */
+bool DirCache::List(const string& dir, const string& cursor, int limit,
+                    DirPage* page) {
+  string key;
+  if (!Normalize(dir, &key)) return false;
+
+  // 从名称大于游标的项开始拼接预先编码的字段, 游标可能就是`page`中的游标
+  string after = cursor;
+  auto make_page = [&](const map<string, string>& entries) {
+    page->data.clear();
+    page->count = 0;
+    page->next_cursor.clear();
+    auto it = after.empty() ? entries.begin() : entries.upper_bound(after);
+    for (; it != entries.end(); ++it) {
+      if (limit > 0 && page->count == limit) {
+        page->next_cursor = prev(it)->first;
+        PutBytes(&page->data, 2, page->next_cursor);
+        break;
+      }
+      page->data.append(it->second);
+      ++page->count;
+    }
+  };
+
+  long long cached_mtime = -1;
+  {
+    lock_guard<mutex> lock(mutex_);
+    auto it = dirs_.find(key);
+    if (it != dirs_.end()) {
+      if (it->second.wd >= 0) {
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        make_page(it->second.entries);
+        return true;
+      }
+      cached_mtime = it->second.mtime_ns;
+    }
+  }
+
+  if (cached_mtime >= 0) {
+    // 没有inotify监视, 目录修改时间不变则缓存仍然有效
+    StatType st;
+    bool valid = FileStat(Join(root_, key).c_str(), &st) == 0 &&
+                 MtimeNs(st) == cached_mtime;
+    lock_guard<mutex> lock(mutex_);
+    auto it = dirs_.find(key);
+    if (it != dirs_.end()) {
+      if (valid && it->second.mtime_ns == cached_mtime) {
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        make_page(it->second.entries);
+        return true;
+      }
+      ++stats_.invalidations;
+      Erase(key);
+    }
+  }
+
+  {
+    lock_guard<mutex> lock(mutex_);
+    ++loading_[key].loaders;
+  }
+  Listing listing;
+  bool ok = Load(key, &listing);
+
+  lock_guard<mutex> lock(mutex_);
+  ++stats_.loads;
+  auto loading = loading_.find(key);
+  bool dirty = loading->second.dirty;
+  if (--loading->second.loaders == 0) loading_.erase(loading);
+  if (ok) make_page(listing.entries);
+
+  // 读取期间目录发生过修改则结果不放入缓存, 其它线程已放入缓存时使用已有的
+  if (ok && !dirty && dirs_.find(key) == dirs_.end()) {
+    lru_.push_front(key);
+    listing.lru = lru_.begin();
+    if (listing.wd >= 0) watches_[listing.wd] = key;
+    dirs_.emplace(key, move(listing));
+    while (static_cast<int>(dirs_.size()) > max_dirs_) {
+      Erase(lru_.back());
+      ++stats_.evictions;
+    }
+    return true;
+  }
+#ifdef __linux__
+  // 同一目录的监视描述符相同, 仍在使用时不能删除
+  if (listing.wd >= 0 && dirs_.find(key) == dirs_.end() &&
+      loading_.find(key) == loading_.end()) {
+    inotify_rm_watch(inotify_fd_, listing.wd);
+  }
+#endif
+  return ok;
+}
+
+/**
+ * @brief 重新`stat`目录中的一项并更新缓存的列表(不持有锁时调用)
+ *
+ * @param dir 规范化的目录路径
+ * @param name 目录项名称
+ */
+void DirCache::Refresh(const string& dir, const string& name) {
+  bool watched = false;
+  {
+    lock_guard<mutex> lock(mutex_);
+    MarkDirty(dir);
+    auto it = dirs_.find(dir);
+    if (it == dirs_.end()) return;
+    watched = it->second.wd >= 0;
+  }
+  DirEntry entry;
+  bool exists = StatEntry(Join(Join(root_, dir), name), name, &entry);
+  // 没有监视的目录同时记下新的修改时间, 否则下次列目录会重新读取
+  long long dir_mtime = -1;
+  StatType st;
+  if (!watched && FileStat(Join(root_, dir).c_str(), &st) == 0) {
+    dir_mtime = MtimeNs(st);
+  }
+
+  lock_guard<mutex> lock(mutex_);
+  auto it = dirs_.find(dir);
+  if (it == dirs_.end()) return;
+  ++stats_.updates;
+  if (dir_mtime >= 0 && it->second.wd < 0) it->second.mtime_ns = dir_mtime;
+  if (exists) {
+    it->second.entries[name] = EncodeEntry(entry);
+  } else {
+    it->second.entries.erase(name);
+  }
+  if (!exists || !entry.is_dir) EraseTree(Join(dir, name));
+}
+
+/**
+ * @brief 服务器写入文件或创建目录后更新缓存
+ *
+ * @param path 相对根目录的路径
+ */
+void DirCache::OnWrite(const string& path) {
+  string normalized;
+  if (!Normalize(path, &normalized) || normalized.empty()) return;
+  // 逐级更新: 新创建的上级目录加入其父目录, 已有目录的修改时间随之更新
+  string dir;
+  size_t begin = 0;
+  while (begin < normalized.size()) {
+    size_t end = normalized.find('/', begin);
+    if (end == string::npos) end = normalized.size();
+    string name = normalized.substr(begin, end - begin);
+    Refresh(dir, name);
+    dir = Join(dir, name);
+    begin = end + 1;
+  }
+}
+
+/**
+ * @brief 服务器删除文件或目录后更新缓存
+ *
+ * @param path 相对根目录的路径
+ */
+void DirCache::OnRemove(const string& path) {
+  // 逐级重新`stat`: 已删除的项从列表中移除, 其子目录的缓存一起删除
+  OnWrite(path);
+}
+
+/**
+ * @brief 处理inotify中所有待处理的事件(在`fd()`可读时调用)
+ *
+ * @return int 处理的事件数量
+ */
+int DirCache::ProcessEvents() {
+#ifdef __linux__
+  if (inotify_fd_ < 0) return 0;
+  int count = 0;
+  bool overflow = false;
+  // 同一批事件中的重复目录项只`stat`一次
+  set<pair<int, string>> changed;
+  set<int> removed;
+  alignas(struct inotify_event) char buffer[64 * 1024];
+  while (true) {
+    ssize_t n = read(inotify_fd_, buffer, sizeof(buffer));
+    if (n <= 0) break;
+    for (char* p = buffer; p < buffer + n;) {
+      auto* event = reinterpret_cast<struct inotify_event*>(p);
+      p += sizeof(struct inotify_event) + event->len;
+      ++count;
+      if (event->mask & IN_Q_OVERFLOW) {
+        overflow = true;
+      } else if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+        removed.insert(event->wd);
+      } else if (event->len > 0) {
+        changed.insert({event->wd, string(event->name)});
+      }
+    }
+  }
+
+  if (overflow) {
+    // 丢失了事件, 无法知道哪些目录变了
+    lock_guard<mutex> lock(mutex_);
+    for (auto& loading : loading_) loading.second.dirty = true;
+    stats_.invalidations += static_cast<long long>(dirs_.size());
+    EraseTree("");
+    return count;
+  }
+
+  vector<pair<string, string>> refresh;
+  {
+    lock_guard<mutex> lock(mutex_);
+    for (int wd : removed) {
+      auto it = watches_.find(wd);
+      if (it == watches_.end()) continue;
+      string dir = it->second;
+      MarkDirty(dir);
+      ++stats_.invalidations;
+      EraseTree(dir);
+    }
+    for (auto& change : changed) {
+      auto it = watches_.find(change.first);
+      if (it != watches_.end()) refresh.push_back({it->second, change.second});
+    }
+  }
+  for (auto& item : refresh) Refresh(item.first, item.second);
+  return count;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief 使目录的缓存失效
+ *
+ * @param dir 相对根目录的目录路径
+ */
+void DirCache::Invalidate(const string& dir) {
+  string key;
+  if (!Normalize(dir, &key)) return;
+  lock_guard<mutex> lock(mutex_);
+  MarkDirty(key);
+  if (dirs_.find(key) != dirs_.end()) ++stats_.invalidations;
+  Erase(key);
+}
+
+/**
+ * @brief 标记目录已修改: 正在读取的结果不放入缓存(需持有`mutex_`)
+ */
+void DirCache::MarkDirty(const string& dir) {
+  auto it = loading_.find(dir);
+  if (it != loading_.end()) it->second.dirty = true;
+}
+
+/**
+ * @brief 删除目录的缓存和监视(需持有`mutex_`)
+ */
+void DirCache::Erase(const string& dir) {
+  auto it = dirs_.find(dir);
+  if (it == dirs_.end()) return;
+  if (it->second.wd >= 0) {
+    watches_.erase(it->second.wd);
+#ifdef __linux__
+    inotify_rm_watch(inotify_fd_, it->second.wd);
+#endif
+  }
+  lru_.erase(it->second.lru);
+  dirs_.erase(it);
+}
+
+/**
+ * @brief 删除目录及其所有子目录的缓存(需持有`mutex_`)
+ */
+void DirCache::EraseTree(const string& dir) {
+  string prefix = dir + "/";
+  vector<string> erased;
+  for (auto& item : dirs_) {
+    if (dir.empty() || item.first == dir ||
+        item.first.compare(0, prefix.size(), prefix) == 0) {
+      erased.push_back(item.first);
+    }
+  }
+  for (auto& key : erased) Erase(key);
+}
+
+/**
+ * @brief 解码`Listing`消息(供客户端和测试使用)
+ *
+ * @param data protobuf编码的`Listing`消息
+ * @param entries 输出目录项
+ * @param next_cursor 输出下一页的游标
+ * @return true 成功
+ * @return false 格式错误
+ */
+bool DirCache::Decode(const string& data, vector<DirEntry>* entries,
+                      string* next_cursor) {
+  entries->clear();
+  next_cursor->clear();
+  size_t pos = 0;
+  while (pos < data.size()) {
+    uint64_t key = 0, len = 0;
+    if (!GetVarint(data, &pos, &key) || (key & 7) != 2 ||
+        !GetVarint(data, &pos, &len) || len > data.size() - pos) {
+      return false;
+    }
+    if ((key >> 3) == 1) {
+      DirEntry entry;
+      if (!DecodeEntry(data.substr(pos, len), &entry)) return false;
+      entries->push_back(move(entry));
+    } else if ((key >> 3) == 2) {
+      *next_cursor = data.substr(pos, len);
+    }
+    pos += len;
+  }
+  return true;
+}
+
+/**
+ * @brief 获取统计信息
+ *
+ * @return DirCacheStats 统计信息
+ */
+DirCacheStats DirCache::stats() {
+  lock_guard<mutex> lock(mutex_);
+  DirCacheStats stats = stats_;
+  stats.cached = static_cast<int>(dirs_.size());
+  return stats;
+}
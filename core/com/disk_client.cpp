@@ -0,0 +1,956 @@
+﻿/**
+ * @file disk_client.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `DiskClient`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/disk_client.h"
+
+#include <event2/buffer.h>
+#include <event2/event.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <random>
+
+#ifdef _WIN32
+#include <io.h>
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "include/blocking_pool.h"
+#include "include/compression.h"
+#include "include/crc32c.h"
+#include "include/frame.h"
+#include "task.h"
+#include "thread.h"
+#include "util.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 管道容量, 每次`splice`最多移动的字节数
+static const int kPipeSize = 1024 * 1024;
+/// @brief 不支持`splice`时接收数据的缓冲区大小
+static const size_t kRecvBufferSize = 256 * 1024;
+
+/**
+ * @brief 非阻塞socket的错误是否表示稍后重试
+ */
+static bool Retriable(int error) {
+#ifdef _WIN32
+  return error == WSAEWOULDBLOCK || error == WSAEINTR;
+#else
+  return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+#endif
+}
+
+/**
+ * @brief 生成上传ID
+ *
+ * @details 高位随机, 不同客户端的上传ID几乎不会相同; 同一进程内依次递增
+ */
+static uint64_t NewUploadId() {
+  static atomic<uint64_t> next(
+      (static_cast<uint64_t>(random_device()()) << 32) ^
+      static_cast<uint64_t>(
+          chrono::steady_clock::now().time_since_epoch().count()));
+  return next++;
+}
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 一个请求
+ */
+struct ClientRequest {
+  FrameType type = FrameType::kAck;
+  /// @brief 请求ID, 提交到连接时分配
+  uint32_t id = 0;
+  /// @brief 消息体中数据之前的字段
+  std::string fields;
+  /// @brief 上传: 作为数据发送的本地文件区间
+  int file_fd = -1;
+  long long file_offset = 0;
+  long long file_length = 0;
+  /// @brief 下载: 接收`kData`数据的本地文件
+  int sink_fd = -1;
+  /// @brief 下载: 请求带有压缩算法列表, `kData`中有选中的算法
+  bool negotiate = false;
+  /// @brief 完成回调, `reply`为响应(`kData`时只含文件大小和偏移)
+  std::function<void(bool ok, const Frame& reply)> done;
+};
+
+/**
+ * @brief 一次上传或下载
+ */
+struct Transfer {
+  ~Transfer() {
+    if (fd >= 0) close(fd);
+  }
+
+  bool upload = true;
+  std::string server;
+  std::string path;
+  /// @brief 本地文件
+  int fd = -1;
+  long long size = 0;
+  /// @brief 上传: 本地文件的CRC32C
+  uint32_t crc = 0;
+  /// @brief 上传ID, 服务器按它区分同一文件同时进行的上传
+  uint64_t upload_id = 0;
+  /// @brief 第一块使用的连接, 之后的块依次使用后面的连接
+  size_t first = 0;
+  /// @brief 未完成的块数
+  std::atomic<long long> remaining{0};
+  std::atomic<bool> failed{false};
+  DiskClient::Callback done;
+};
+
+/**
+ * @brief 到服务器的一个连接
+ *
+ * @details
+ * 在所属`Thread`的事件循环中运行, 其它线程通过`BlockingPool::Post`提交请求.
+ * 不使用`bufferevent`: 下载的数据要从socket直接`splice`到文件,
+ * 所以按消息边界自己读取socket, 发送仍用`evbuffer`(文件区间走`sendfile`)
+ */
+class ClientConnection : public Task {
+ public:
+  ClientConnection(DiskClient* client, Thread* thread,
+                   const std::string& address)
+      : client_(client), thread_(thread), address_(address) {}
+
+  ~ClientConnection() {
+    if (out_) evbuffer_free(out_);
+  }
+
+  /**
+   * @brief 在事件循环线程中开始连接
+   */
+  bool Init() override;
+
+  /**
+   * @brief 提交请求(事件循环线程)
+   */
+  void Submit(std::shared_ptr<ClientRequest> request);
+
+  /**
+   * @brief 关闭连接, 未完成的请求失败(事件循环线程)
+   */
+  void Close(const std::string& reason);
+
+  void OnRead();
+  void OnWrite();
+
+  Thread* thread() const { return thread_; }
+  bool closed() const { return closed_; }
+
+ private:
+  /// @brief 读取状态
+  enum class ReadState {
+    kHeader,   ///< 读取消息头
+    kPrefix,   ///< 读取`kData`的文件大小和偏移
+    kSink,     ///< `kData`的数据写入本地文件
+    kEncoded,  ///< 读取压缩的`kData`数据, 解码后写入本地文件
+    kBody,     ///< 读取其它消息的消息体
+  };
+
+  /**
+   * @brief 把等待的请求移入在途队列并写入发送缓冲区
+   */
+  void Pump();
+
+  /**
+   * @brief 读取到`in_`满`want`字节
+   *
+   * @return int 1为已读满, 0为暂无数据, -1为连接断开
+   */
+  int ReadExact(size_t want);
+
+  /**
+   * @brief 把`kData`的数据写入本地文件
+   *
+   * @return int 1为写完, 0为暂无数据, -1为失败
+   */
+  int ReadSink();
+
+  /**
+   * @brief 解码压缩的`kData`数据并写入本地文件
+   *
+   * @return true 成功
+   */
+  bool WriteEncoded();
+
+  /**
+   * @brief `kData`的数据已写入本地文件, 完成请求
+   */
+  void CompleteData();
+
+  /**
+   * @brief 在途队列的第一个请求收到响应
+   */
+  void Complete(bool ok, const Frame& reply);
+
+  DiskClient* client_;
+  Thread* thread_;
+  std::string address_;
+  evutil_socket_t fd_ = -1;
+  ::event* read_event_ = nullptr;
+  ::event* write_event_ = nullptr;
+  ::evbuffer* out_ = nullptr;
+  bool connecting_ = true;
+  std::atomic<bool> closed_{false};
+  uint32_t next_id_ = 1;
+
+  /// @brief 还没发送的请求
+  std::deque<std::shared_ptr<ClientRequest>> waiting_;
+  /// @brief 已发送等待响应的请求, 响应按顺序返回
+  std::deque<std::shared_ptr<ClientRequest>> inflight_;
+
+  ReadState state_ = ReadState::kHeader;
+  std::string in_;
+  FrameType type_ = FrameType::kAck;
+  uint32_t id_ = 0;
+  uint32_t body_size_ = 0;
+  /// @brief `kData`的文件大小和本块剩余的字节数
+  long long data_size_ = 0;
+  long long sink_offset_ = 0;
+  long long sink_left_ = 0;
+  long long sink_start_ = 0;
+  /// @brief `kData`数据使用的压缩算法
+  CompressionCodec codec_ = CompressionCodec::kNone;
+  /// @brief `splice`使用的管道
+  int pipe_[2] = {-1, -1};
+};
+
+END_NAMESPACE
+
+static void ReadCB(evutil_socket_t /*fd*/, short /*events*/, void* arg) {
+  static_cast<ClientConnection*>(arg)->OnRead();
+}
+
+static void WriteCB(evutil_socket_t /*fd*/, short /*events*/, void* arg) {
+  static_cast<ClientConnection*>(arg)->OnWrite();
+}
+
+/**
+ * @brief 在事件循环线程中开始连接
+ */
+bool ClientConnection::Init() {
+  if (closed_) return false;
+  sockaddr_storage addr;
+  int addr_len = sizeof(addr);
+  if (evutil_parse_sockaddr_port(address_.c_str(),
+                                 reinterpret_cast<sockaddr*>(&addr),
+                                 &addr_len) != 0) {
+    Close("invalid address " + address_);
+    return false;
+  }
+  fd_ = socket(addr.ss_family, SOCK_STREAM, 0);
+  if (fd_ < 0) {
+    Close("socket failed");
+    return false;
+  }
+  evutil_make_socket_nonblocking(fd_);
+  evutil_make_socket_closeonexec(fd_);
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY,
+             reinterpret_cast<const char*>(&one), sizeof(one));
+  int re = connect(fd_, reinterpret_cast<sockaddr*>(&addr), addr_len);
+  if (re != 0 && EVUTIL_SOCKET_ERROR() != EINPROGRESS &&
+      !Retriable(EVUTIL_SOCKET_ERROR())) {
+    Close("failed to connect " + address_);
+    return false;
+  }
+#ifdef __linux__
+  if (pipe2(pipe_, O_CLOEXEC) == 0) {
+    fcntl(pipe_[1], F_SETPIPE_SZ, kPipeSize);
+  } else {
+    pipe_[0] = pipe_[1] = -1;
+  }
+#endif
+  out_ = evbuffer_new();
+  read_event_ = event_new(base(), fd_, EV_READ | EV_PERSIST, ReadCB, this);
+  write_event_ = event_new(base(), fd_, EV_WRITE | EV_PERSIST, WriteCB, this);
+  event_add(read_event_, nullptr);
+  // 连接完成时可写
+  event_add(write_event_, nullptr);
+  ++client_->connects_;
+  Pump();
+  return true;
+}
+
+/**
+ * @brief 提交请求(事件循环线程)
+ */
+void ClientConnection::Submit(shared_ptr<ClientRequest> request) {
+  if (closed_) {
+    ++client_->failures_;
+    request->done(false, Frame());
+    return;
+  }
+  waiting_.push_back(move(request));
+  Pump();
+}
+
+/**
+ * @brief 把等待的请求移入在途队列并写入发送缓冲区
+ */
+void ClientConnection::Pump() {
+  if (!out_) return;
+  bool added = false;
+  while (!waiting_.empty() &&
+         static_cast<int>(inflight_.size()) <
+             max(client_->options_.pipeline_depth, 1)) {
+    auto request = move(waiting_.front());
+    waiting_.pop_front();
+    // 引用本地文件区间, 发送时由`sendfile`直接从页缓存发出
+    evbuffer_file_segment* segment = nullptr;
+    if (request->file_length > 0) {
+      segment = evbuffer_file_segment_new(
+          request->file_fd, request->file_offset, request->file_length, 0);
+      if (!segment) {
+        ++client_->failures_;
+        request->done(false, Frame());
+        continue;
+      }
+    }
+    request->id = next_id_++;
+    char header[Frame::kHeaderSize];
+    Frame::EncodeHeader(
+        request->type, request->id,
+        static_cast<uint32_t>(request->fields.size() + request->file_length),
+        header);
+    evbuffer_add(out_, header, sizeof(header));
+    evbuffer_add(out_, request->fields.data(), request->fields.size());
+    if (segment) {
+      evbuffer_add_file_segment(out_, segment, 0, request->file_length);
+      evbuffer_file_segment_free(segment);
+      client_->bytes_sent_ += request->file_length;
+    }
+    ++client_->requests_;
+    inflight_.push_back(move(request));
+    added = true;
+  }
+  if (added && !connecting_) OnWrite();
+}
+
+/**
+ * @brief 连接完成或socket可写时发送缓冲区中的数据
+ */
+void ClientConnection::OnWrite() {
+  if (closed_) return;
+  if (connecting_) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    getsockopt(fd_, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error),
+               &len);
+    if (error != 0) {
+      Close("failed to connect " + address_);
+      return;
+    }
+    connecting_ = false;
+  }
+  while (evbuffer_get_length(out_) > 0) {
+    int n = evbuffer_write(out_, fd_);
+    if (n < 0) {
+      int error = EVUTIL_SOCKET_ERROR();
+      if (Retriable(error)) break;
+      Close("send failed");
+      return;
+    }
+    if (n == 0) break;
+  }
+  // 发送完后不再关注可写事件
+  if (evbuffer_get_length(out_) == 0) {
+    event_del(write_event_);
+  } else {
+    event_add(write_event_, nullptr);
+  }
+}
+
+/**
+ * @brief 读取到`in_`满`want`字节
+ *
+ * @return int 1为已读满, 0为暂无数据, -1为连接断开
+ */
+int ClientConnection::ReadExact(size_t want) {
+  while (in_.size() < want) {
+    size_t have = in_.size();
+    in_.resize(want);
+    auto n = recv(fd_, &in_[have], static_cast<int>(want - have), 0);
+    in_.resize(have + max<long long>(n, 0));
+    if (n == 0) return -1;
+    if (n < 0) {
+      int error = EVUTIL_SOCKET_ERROR();
+      if (error == EINTR) continue;
+      return Retriable(error) ? 0 : -1;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief 把`kData`的数据写入本地文件
+ *
+ * @return int 1为写完, 0为暂无数据, -1为失败
+ */
+int ClientConnection::ReadSink() {
+  int sink = inflight_.front()->sink_fd;
+#ifdef __linux__
+  // socket -> 管道 -> 文件, 数据不经过用户态
+  while (sink_left_ > 0 && pipe_[0] >= 0) {
+    ssize_t n = splice(fd_, nullptr, pipe_[1], nullptr,
+                       min<long long>(sink_left_, kPipeSize),
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n == 0) return -1;
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return errno == EAGAIN ? 0 : -1;
+    }
+    while (n > 0) {
+      loff_t offset = sink_offset_;
+      ssize_t m = splice(pipe_[0], nullptr, sink, &offset, n, SPLICE_F_MOVE);
+      if (m < 0 && errno == EINTR) continue;
+      if (m < 0 && errno == EINVAL) {
+        // 文件系统不支持`splice`写入, 经缓冲区转写
+        char buffer[64 * 1024];
+        m = read(pipe_[0], buffer, min<size_t>(n, sizeof(buffer)));
+        if (m > 0 && pwrite(sink, buffer, m, sink_offset_) != m) m = -1;
+      }
+      if (m <= 0) return -1;
+      n -= m;
+      sink_offset_ += m;
+      sink_left_ -= m;
+    }
+  }
+#endif
+  string buffer;
+  while (sink_left_ > 0) {
+    buffer.resize(min<long long>(sink_left_, kRecvBufferSize));
+    auto n = recv(fd_, &buffer[0], static_cast<int>(buffer.size()), 0);
+    if (n == 0) return -1;
+    if (n < 0) {
+      int error = EVUTIL_SOCKET_ERROR();
+      if (error == EINTR) continue;
+      return Retriable(error) ? 0 : -1;
+    }
+#ifdef _WIN32
+    if (_lseeki64(sink, sink_offset_, SEEK_SET) < 0 ||
+        _write(sink, buffer.data(), static_cast<unsigned>(n)) != n) {
+      return -1;
+    }
+#else
+    if (pwrite(sink, buffer.data(), n, sink_offset_) != n) return -1;
+#endif
+    sink_offset_ += n;
+    sink_left_ -= n;
+  }
+  return 1;
+}
+
+/**
+ * @brief 读取响应
+ */
+void ClientConnection::OnRead() {
+  while (!closed_) {
+    int re = 1;
+    switch (state_) {
+      case ReadState::kHeader:
+        re = ReadExact(Frame::kHeaderSize);
+        if (re <= 0) break;
+        if (!Frame::DecodeHeader(in_.data(), &type_, &id_, &body_size_) ||
+            inflight_.empty() || inflight_.front()->id != id_) {
+          Close("unexpected response");
+          return;
+        }
+        in_.clear();
+        if (type_ == FrameType::kData && inflight_.front()->sink_fd >= 0) {
+          state_ = ReadState::kPrefix;
+        } else {
+          state_ = ReadState::kBody;
+        }
+        break;
+      case ReadState::kPrefix: {
+        size_t prefix_size = inflight_.front()->negotiate ? 17 : 16;
+        if (body_size_ < prefix_size) {
+          Close("malformed data");
+          return;
+        }
+        re = ReadExact(prefix_size);
+        if (re <= 0) break;
+        FrameReader reader(in_);
+        uint64_t size = 0, offset = 0;
+        uint8_t codec = 0;
+        reader.GetU64(&size);
+        reader.GetU64(&offset);
+        if (prefix_size > 16) reader.GetU8(&codec);
+        in_.clear();
+        data_size_ = static_cast<long long>(size);
+        sink_start_ = sink_offset_ = static_cast<long long>(offset);
+        sink_left_ = static_cast<long long>(body_size_ - prefix_size);
+        codec_ = static_cast<CompressionCodec>(codec);
+        if (codec_ == CompressionCodec::kNone) {
+          state_ = ReadState::kSink;
+        } else if (Compression::Available(codec_)) {
+          state_ = ReadState::kEncoded;
+        } else {
+          Close("unsupported codec");
+          return;
+        }
+        break;
+      }
+      case ReadState::kSink:
+        re = ReadSink();
+        if (re <= 0) break;
+        CompleteData();
+        break;
+      case ReadState::kEncoded:
+        re = ReadExact(static_cast<size_t>(sink_left_));
+        if (re <= 0) break;
+        if (!WriteEncoded()) {
+          Close("invalid compressed data");
+          return;
+        }
+        CompleteData();
+        break;
+      case ReadState::kBody: {
+        re = ReadExact(body_size_);
+        if (re <= 0) break;
+        Frame reply;
+        reply.type = type_;
+        reply.id = id_;
+        reply.body.swap(in_);
+        in_.clear();
+        state_ = ReadState::kHeader;
+        bool ok = false;
+        if (type_ == FrameType::kAck) {
+          FrameReader reader(reply.body);
+          uint8_t status = 0;
+          ok = reader.GetU8(&status) &&
+               status == static_cast<uint8_t>(AckStatus::kCommitted);
+        }
+        Complete(ok, reply);
+        break;
+      }
+    }
+    if (re < 0) {
+      Close("connection lost");
+      return;
+    }
+    if (re == 0) return;
+  }
+}
+
+/**
+ * @brief 解码压缩的`kData`数据并写入本地文件
+ *
+ * @return true 成功
+ */
+bool ClientConnection::WriteEncoded() {
+  ChunkDecoder decoder(codec_);
+  string data;
+  bool ok = decoder.Feed(in_.data(), in_.size(), &data) && !decoder.pending();
+  client_->compressed_bytes_ += static_cast<long long>(in_.size());
+  in_.clear();
+  if (!ok || !WriteFull(inflight_.front()->sink_fd, data.data(), data.size(),
+                        sink_start_)) {
+    return false;
+  }
+  sink_offset_ = sink_start_ + static_cast<long long>(data.size());
+  sink_left_ = 0;
+  return true;
+}
+
+/**
+ * @brief `kData`的数据已写入本地文件, 完成请求
+ */
+void ClientConnection::CompleteData() {
+  client_->bytes_received_ += sink_offset_ - sink_start_;
+  FrameWriter prefix;
+  prefix.PutU64(static_cast<uint64_t>(data_size_));
+  prefix.PutU64(static_cast<uint64_t>(sink_start_));
+  Frame reply;
+  reply.type = type_;
+  reply.id = id_;
+  reply.body = prefix.body();
+  state_ = ReadState::kHeader;
+  Complete(true, reply);
+}
+
+/**
+ * @brief 在途队列的第一个请求收到响应
+ */
+void ClientConnection::Complete(bool ok, const Frame& reply) {
+  auto request = move(inflight_.front());
+  inflight_.pop_front();
+  if (!ok) ++client_->failures_;
+  request->done(ok, reply);
+  Pump();
+}
+
+/**
+ * @brief 关闭连接, 未完成的请求失败(事件循环线程)
+ */
+void ClientConnection::Close(const string& reason) {
+  if (closed_) return;
+  closed_ = true;
+  if (!reason.empty()) {
+    cerr << "ClientConnection::Close() " << address_ << ": " << reason
+         << endl;
+  }
+  if (read_event_) event_free(read_event_);
+  if (write_event_) event_free(write_event_);
+  read_event_ = write_event_ = nullptr;
+  if (out_) evbuffer_free(out_);
+  out_ = nullptr;
+  if (fd_ >= 0) evutil_closesocket(fd_);
+  fd_ = -1;
+#ifdef __linux__
+  for (int& fd : pipe_) {
+    if (fd >= 0) close(fd);
+    fd = -1;
+  }
+#endif
+  auto requests = move(inflight_);
+  for (auto& request : waiting_) requests.push_back(move(request));
+  waiting_.clear();
+  for (auto& request : requests) {
+    ++client_->failures_;
+    request->done(false, Frame());
+  }
+}
+
+/**
+ * @brief 构造客户端
+ *
+ * @param options 客户端参数
+ */
+DiskClient::DiskClient(const DiskClientOptions& options) : options_(options) {
+  options_.chunk_size = max<size_t>(
+      min<size_t>(options_.chunk_size, Frame::kMaxBodySize - 4096), 1);
+}
+
+/**
+ * @brief 关闭所有连接
+ *
+ * @details 在各连接的事件循环线程中关闭并等待完成, 事件循环线程保持空闲
+ */
+DiskClient::~DiskClient() {
+  blocking_.Stop();
+  vector<shared_ptr<ClientConnection>> connections;
+  {
+    lock_guard<mutex> lock(mutex_);
+    for (auto& pool : pools_) {
+      for (auto& connection : pool.second) {
+        if (connection) connections.push_back(connection);
+      }
+    }
+    pools_.clear();
+  }
+  for (auto& connection : connections) {
+    promise<void> closed;
+    BlockingPool::Post(connection->thread(), [&]() {
+      connection->Close("");
+      closed.set_value();
+    });
+    closed.get_future().wait();
+  }
+}
+
+/**
+ * @brief 启动事件循环线程
+ *
+ * @return true 成功
+ * @return false 已经启动
+ */
+bool DiskClient::Start() {
+  if (!threads_.empty()) return false;
+  int count = max(options_.threads, 1);
+  for (int i = 0; i < count; ++i) {
+    Thread* thread = new Thread();
+    thread->id_ = i + 1;
+    thread->Start();
+    threads_.push_back(thread);
+  }
+  if (options_.verify_upload) blocking_.Init(1);
+  return true;
+}
+
+/**
+ * @brief 获取连接, 不存在或已断开时新建
+ */
+shared_ptr<ClientConnection> DiskClient::Connection(const string& server,
+                                                    size_t index) {
+  lock_guard<mutex> lock(mutex_);
+  auto& pool = pools_[server];
+  pool.resize(max(options_.connections, 1));
+  auto& connection = pool[index % pool.size()];
+  if (!connection || connection->closed()) {
+    Thread* thread = threads_[next_thread_++ % threads_.size()];
+    connection = make_shared<ClientConnection>(this, thread, server);
+    // 与之后投递的请求在同一通道中, 保证先开始连接
+    connection->set_priority(TaskPriority::kHigh);
+    thread->AddTask(connection.get());
+    thread->Activate();
+  }
+  return connection;
+}
+
+/**
+ * @brief 把请求发给服务器的第`index`个连接(取模)
+ */
+void DiskClient::Send(const string& server, size_t index,
+                      shared_ptr<ClientRequest> request) {
+  if (threads_.empty()) {
+    cerr << "DiskClient::Send() Client is not started" << endl;
+    request->done(false, Frame());
+    return;
+  }
+  auto connection = Connection(server, index);
+  BlockingPool::Post(connection->thread(), [connection, request]() {
+    connection->Submit(request);
+  });
+}
+
+/**
+ * @brief 上传本地文件(异步)
+ *
+ * @param server 服务器地址(`IP:端口`)
+ * @param local_path 本地文件路径
+ * @param remote_path 服务器上相对根目录的路径
+ * @param done 完成回调
+ */
+void DiskClient::Upload(const string& server, const string& local_path,
+                        const string& remote_path, Callback done) {
+  auto transfer = make_shared<Transfer>();
+  transfer->server = server;
+  transfer->path = remote_path;
+  transfer->done = move(done);
+  transfer->first = next_connection_++;
+#ifdef _WIN32
+  transfer->fd = _open(local_path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+  transfer->fd = open(local_path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+  struct stat st;
+  if (transfer->fd < 0 || fstat(transfer->fd, &st) != 0) {
+    cerr << "DiskClient::Upload() Failed to open " << local_path << endl;
+    transfer->done(false);
+    return;
+  }
+  transfer->size = static_cast<long long>(st.st_size);
+  transfer->upload_id = NewUploadId();
+
+  long long chunk = static_cast<long long>(options_.chunk_size);
+  long long chunks = transfer->size > 0 ? (transfer->size + chunk - 1) / chunk
+                                        : 0;
+  // 计算校验和与传输并行, 作为一块计数; 空文件没有块, 直接提交
+  bool verify = options_.verify_upload;
+  transfer->remaining = max<long long>(chunks, 1) + (verify ? 1 : 0);
+  if (verify) {
+    bool submitted =
+        !threads_.empty() &&
+        blocking_.Submit(
+            [transfer, local_path]() {
+              ifstream in(local_path, ios::binary);
+              vector<char> buffer(kRecvBufferSize);
+              Crc32c crc;
+              while (in) {
+                in.read(buffer.data(), buffer.size());
+                if (in.gcount() > 0) crc.Update(buffer.data(), in.gcount());
+              }
+              transfer->crc = crc.value();
+            },
+            threads_[0], [this, transfer]() { ChunkDone(transfer, true); });
+    if (!submitted) ChunkDone(transfer, false);
+  }
+  if (chunks == 0) ChunkDone(transfer, true);
+  for (long long i = 0; i < chunks; ++i) {
+    auto request = make_shared<ClientRequest>();
+    request->type = FrameType::kWriteAt;
+    FrameWriter fields;
+    fields.PutString(remote_path);
+    fields.PutU64(static_cast<uint64_t>(transfer->size));
+    fields.PutU64(transfer->upload_id);
+    fields.PutU64(static_cast<uint64_t>(i * chunk));
+    request->fields = fields.body();
+    request->file_fd = transfer->fd;
+    request->file_offset = i * chunk;
+    request->file_length = min(chunk, transfer->size - i * chunk);
+    request->done = [this, transfer](bool ok, const Frame&) {
+      ChunkDone(transfer, ok);
+    };
+    Send(server, transfer->first + static_cast<size_t>(i), request);
+  }
+}
+
+/**
+ * @brief 下载文件到本地(异步)
+ *
+ * @param server 服务器地址(`IP:端口`)
+ * @param remote_path 服务器上相对根目录的路径
+ * @param local_path 本地文件路径, 已存在时覆盖
+ * @param done 完成回调
+ */
+void DiskClient::Download(const string& server, const string& remote_path,
+                          const string& local_path, Callback done) {
+  auto transfer = make_shared<Transfer>();
+  transfer->upload = false;
+  transfer->server = server;
+  transfer->path = remote_path;
+  transfer->done = move(done);
+  transfer->first = next_connection_++;
+#ifdef _WIN32
+  transfer->fd = _open(local_path.c_str(),
+                       _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+  transfer->fd =
+      open(local_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+  if (transfer->fd < 0) {
+    cerr << "DiskClient::Download() Failed to create " << local_path << endl;
+    transfer->done(false);
+    return;
+  }
+  // 第一块同时返回文件大小
+  auto request = make_shared<ClientRequest>();
+  request->type = FrameType::kReadAt;
+  FrameWriter fields;
+  fields.PutString(remote_path);
+  fields.PutU64(0);
+  fields.PutU64(options_.chunk_size);
+  if (!options_.codecs.empty()) fields.PutString(options_.codecs);
+  request->fields = fields.body();
+  request->sink_fd = transfer->fd;
+  request->negotiate = !options_.codecs.empty();
+  request->done = [this, transfer](bool ok, const Frame& reply) {
+    FrameReader reader(reply.body);
+    uint64_t size = 0;
+    if (!ok || !reader.GetU64(&size)) {
+      transfer->done(false);
+      return;
+    }
+    ReadRest(transfer, static_cast<long long>(size));
+  };
+  Send(server, transfer->first, request);
+}
+
+/**
+ * @brief 下载的第一块返回了文件大小, 并行读取其余块
+ */
+void DiskClient::ReadRest(const shared_ptr<Transfer>& transfer,
+                          long long size) {
+  transfer->size = size;
+  long long chunk = static_cast<long long>(options_.chunk_size);
+  long long chunks = max<long long>((size + chunk - 1) / chunk, 1);
+  // 第一块已经完成
+  transfer->remaining = chunks;
+  for (long long i = 1; i < chunks; ++i) {
+    auto request = make_shared<ClientRequest>();
+    request->type = FrameType::kReadAt;
+    FrameWriter fields;
+    fields.PutString(transfer->path);
+    fields.PutU64(static_cast<uint64_t>(i * chunk));
+    fields.PutU64(static_cast<uint64_t>(chunk));
+    if (!options_.codecs.empty()) fields.PutString(options_.codecs);
+    request->fields = fields.body();
+    request->sink_fd = transfer->fd;
+    request->negotiate = !options_.codecs.empty();
+    request->done = [this, transfer](bool ok, const Frame& reply) {
+      FrameReader reader(reply.body);
+      uint64_t current = 0;
+      // 下载期间文件被替换
+      ok = ok && reader.GetU64(&current) &&
+           static_cast<long long>(current) == transfer->size;
+      ChunkDone(transfer, ok);
+    };
+    Send(transfer->server, transfer->first + static_cast<size_t>(i),
+         request);
+  }
+  ChunkDone(transfer, true);
+}
+
+/**
+ * @brief 一块传输完成, 全部完成后提交或结束
+ */
+void DiskClient::ChunkDone(const shared_ptr<Transfer>& transfer, bool ok) {
+  if (!ok) transfer->failed = true;
+  if (--transfer->remaining > 0) return;
+  if (transfer->failed) {
+    transfer->done(false);
+    return;
+  }
+  if (!transfer->upload) {
+    bool truncated = true;
+#ifndef _WIN32
+    truncated = ftruncate(transfer->fd, transfer->size) == 0;
+#endif
+    transfer->done(truncated);
+    return;
+  }
+  auto request = make_shared<ClientRequest>();
+  request->type = FrameType::kCommit;
+  FrameWriter fields;
+  fields.PutString(transfer->path);
+  fields.PutU64(static_cast<uint64_t>(transfer->size));
+  fields.PutU64(transfer->upload_id);
+  if (options_.verify_upload) fields.PutU32(transfer->crc);
+  request->fields = fields.body();
+  request->done = [transfer](bool ok, const Frame&) { transfer->done(ok); };
+  Send(transfer->server, transfer->first, request);
+}
+
+/**
+ * @brief 上传本地文件(阻塞)
+ */
+bool DiskClient::Upload(const string& server, const string& local_path,
+                        const string& remote_path) {
+  auto result = make_shared<promise<bool>>();
+  Upload(server, local_path, remote_path,
+         [result](bool ok) { result->set_value(ok); });
+  return result->get_future().get();
+}
+
+/**
+ * @brief 下载文件到本地(阻塞)
+ */
+bool DiskClient::Download(const string& server, const string& remote_path,
+                          const string& local_path) {
+  auto result = make_shared<promise<bool>>();
+  Download(server, remote_path, local_path,
+           [result](bool ok) { result->set_value(ok); });
+  return result->get_future().get();
+}
+
+/**
+ * @brief 获取统计信息
+ *
+ * @return DiskClientStats 统计信息
+ */
+DiskClientStats DiskClient::stats() const {
+  DiskClientStats stats;
+  stats.requests = requests_;
+  stats.bytes_sent = bytes_sent_;
+  stats.bytes_received = bytes_received_;
+  stats.compressed_bytes = compressed_bytes_;
+  stats.connects = connects_;
+  stats.failures = failures_;
+  return stats;
+}
@@ -0,0 +1,503 @@
+﻿/**
+ * @file disk_set.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `DiskSet`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/disk_set.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "util.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+USING_CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 磁盘: 数据目录、I/O队列和统计
+ */
+struct DiskSet::Disk {
+  string path;
+  double weight = 0;
+  /// @brief 该磁盘独占的I/O队列
+  BlockingPool pool;
+
+  atomic<long long> reads{0};
+  atomic<long long> writes{0};
+  atomic<long long> read_bytes{0};
+  atomic<long long> write_bytes{0};
+  atomic<long long> errors{0};
+  atomic<long long> busy_us{0};
+  atomic<long long> max_latency_us{0};
+};
+
+/**
+ * @brief 一次多条带读写的完成状态, 最后一个完成的条带负责回调
+ */
+struct StripeBatch {
+  atomic<long long> remaining{0};
+  atomic<bool> ok{true};
+  Thread* thread = nullptr;
+  /// @brief 读取时的文件内容
+  string data;
+
+  /**
+   * @brief 标记一个条带完成
+   *
+   * @return true 所有条带都已完成
+   */
+  bool Finish(bool stripe_ok) {
+    if (!stripe_ok) ok = false;
+    return --remaining == 0;
+  }
+};
+
+/// @brief 临时文件序号
+static atomic<long long> temp_seq{0};
+
+/// @brief 每个数据目录下保存条带和临时文件的保留目录
+static const char kReservedDir[] = ".diskset";
+
+/**
+ * @brief 构造多磁盘存储层
+ *
+ * @param stripe_size 条带大小(字节), 小于等于0表示不切分
+ * @param threads_per_disk 每块磁盘的I/O线程数
+ */
+DiskSet::DiskSet(long long stripe_size, int threads_per_disk)
+    : stripe_size_(stripe_size), threads_per_disk_(max(threads_per_disk, 1)) {}
+
+/**
+ * @brief 等待所有队列中的操作完成后退出I/O线程
+ */
+DiskSet::~DiskSet() { Stop(); }
+
+/**
+ * @brief 添加数据目录, 需在`Init`之前调用
+ *
+ * @param path 数据目录
+ * @param weight 放置权重, 小于等于0时按磁盘容量计算
+ * @return true 成功
+ * @return false 已经初始化或目录重复
+ */
+bool DiskSet::AddDisk(const string& path, double weight) {
+  if (initialized_) {
+    cerr << "DiskSet::AddDisk() Disks cannot change after Init." << endl;
+    return false;
+  }
+  for (auto& disk : disks_) {
+    if (disk->path == path) {
+      cerr << "DiskSet::AddDisk() Duplicate disk " << path << endl;
+      return false;
+    }
+  }
+  auto disk = make_unique<Disk>();
+  disk->path = path;
+  disk->weight = weight;
+  disks_.push_back(move(disk));
+  return true;
+}
+
+/**
+ * @brief 创建数据目录, 计算权重并启动每块磁盘的I/O线程
+ *
+ * @return true 成功
+ * @return false 没有磁盘或创建目录失败
+ */
+bool DiskSet::Init() {
+  if (initialized_) return true;
+  if (disks_.empty()) {
+    cerr << "DiskSet::Init() No disks configured." << endl;
+    return false;
+  }
+
+  // 未指定权重的磁盘按容量计算, 以最大的磁盘为1
+  vector<double> capacity(disks_.size(), 0);
+  double max_capacity = 0;
+  for (size_t i = 0; i < disks_.size(); ++i) {
+    error_code ec;
+    fs::create_directories(disks_[i]->path, ec);
+    if (ec) {
+      cerr << "DiskSet::Init() Failed to create " << disks_[i]->path << ": "
+           << ec.message() << endl;
+      return false;
+    }
+    fs::space_info space = fs::space(disks_[i]->path, ec);
+    if (!ec) capacity[i] = static_cast<double>(space.capacity);
+    max_capacity = max(max_capacity, capacity[i]);
+  }
+  for (size_t i = 0; i < disks_.size(); ++i) {
+    Disk* disk = disks_[i].get();
+    if (disk->weight <= 0) {
+      disk->weight = max_capacity > 0 && capacity[i] > 0
+                         ? capacity[i] / max_capacity
+                         : 1.0;
+    }
+    ring_.AddNode(to_string(i), disk->weight);
+    disk->pool.Init(threads_per_disk_);
+  }
+  initialized_ = true;
+  return true;
+}
+
+/**
+ * @brief 停止所有磁盘的I/O线程(等待队列中的操作完成)
+ */
+void DiskSet::Stop() {
+  for (auto& disk : disks_) disk->pool.Stop();
+}
+
+/**
+ * @brief 校验文件名, 不允许绝对路径、`..`和保留目录`.diskset`
+ */
+bool DiskSet::ValidName(const string& name) {
+  return ValidRelativePath(name) && *fs::path(name).begin() != kReservedDir;
+}
+
+/**
+ * @brief 查找文件条带所在的磁盘
+ *
+ * @param name 文件名(相对路径)
+ * @param stripe 条带序号
+ * @return int 磁盘序号, 未初始化时返回-1
+ */
+int DiskSet::Locate(const string& name, long long stripe) const {
+  const string* node = ring_.Lookup(name + "#" + to_string(stripe));
+  return node ? stoi(*node) : -1;
+}
+
+/**
+ * @brief 文件条带的保存路径
+ *
+ * @param name 文件名(相对路径)
+ * @param stripe 条带序号
+ * @return std::string 文件路径, 未初始化时返回空字符串
+ */
+string DiskSet::StripePath(const string& name, long long stripe) const {
+  int disk = Locate(name, stripe);
+  if (disk < 0) return "";
+  fs::path root(disks_[disk]->path);
+  if (stripe == 0) return (root / name).string();
+  return (root / kReservedDir / ("stripe" + to_string(stripe)) / name)
+      .string();
+}
+
+/**
+ * @brief 把阻塞工作提交到指定磁盘的I/O队列
+ *
+ * @param disk 磁盘序号
+ * @param work 在该磁盘的I/O线程中执行的工作
+ * @param thread 执行回调的线程, 为`nullptr`时在I/O线程中直接执行
+ * @param done 完成回调
+ * @return true 提交成功
+ * @return false 磁盘序号无效或已停止
+ */
+bool DiskSet::Submit(int disk, BlockingPool::Work work, Thread* thread,
+                     BlockingPool::Done done) {
+  if (disk < 0 || disk >= disk_count()) return false;
+  return disks_[disk]->pool.Submit(move(work), thread, move(done));
+}
+
+/**
+ * @brief 在磁盘的I/O线程中执行一次读写并记录统计
+ *
+ * @param disk 磁盘
+ * @param write 是否为写操作
+ * @param op 实际的读写, 返回处理的字节数, 失败返回-1
+ */
+void DiskSet::Measure(Disk* disk, bool write,
+                      const function<long long()>& op) {
+  auto start = chrono::steady_clock::now();
+  long long bytes = op();
+  long long us = chrono::duration_cast<chrono::microseconds>(
+                     chrono::steady_clock::now() - start)
+                     .count();
+  disk->busy_us += us;
+  long long max_us = disk->max_latency_us;
+  while (us > max_us &&
+         !disk->max_latency_us.compare_exchange_weak(max_us, us)) {
+  }
+  if (bytes < 0) {
+    ++disk->errors;
+    return;
+  }
+  if (write) {
+    ++disk->writes;
+    disk->write_bytes += bytes;
+  } else {
+    ++disk->reads;
+    disk->read_bytes += bytes;
+  }
+}
+
+/**
+ * @brief 写入文件(覆盖), 各条带并行写入所在的磁盘
+ *
+ * @param name 文件名(相对路径)
+ * @param data 文件内容
+ * @param thread 执行回调的线程
+ * @param done 所有条带完成后的回调
+ * @return true 已提交
+ * @return false 名称非法或未初始化
+ */
+bool DiskSet::Write(const string& name, shared_ptr<const string> data,
+                    Thread* thread, WriteDone done) {
+  return WriteRange(name, 0, move(data), true, thread, move(done));
+}
+
+/**
+ * @brief 从`offset`开始写入文件的一段, 各条带并行写入所在的磁盘
+ *
+ * @param name 文件名(相对路径)
+ * @param offset 在文件中的偏移
+ * @param data 这一段的内容
+ * @param last 是否为文件的最后一段
+ * @param thread 执行回调的线程
+ * @param done 所有条带完成后的回调
+ * @return true 已提交
+ * @return false 名称非法、未初始化或区间没有按条带对齐
+ */
+bool DiskSet::WriteRange(const string& name, long long offset,
+                         shared_ptr<const string> data, bool last,
+                         Thread* thread, WriteDone done) {
+  if (!initialized_ || !ValidName(name) || !data) {
+    cerr << "DiskSet::WriteRange() Invalid name or not initialized." << endl;
+    return false;
+  }
+  long long size = static_cast<long long>(data->size());
+  // 中间的条带不满时读取会认为文件在此结束, 各段必须按条带对齐
+  bool aligned = stripe_size_ > 0
+                     ? offset >= 0 && offset % stripe_size_ == 0 &&
+                           (last || (size > 0 && size % stripe_size_ == 0))
+                     : offset == 0;
+  if (!aligned) {
+    cerr << "DiskSet::WriteRange() Range is not aligned to stripes." << endl;
+    return false;
+  }
+  long long first = stripe_size_ > 0 ? offset / stripe_size_ : 0;
+  long long count = 1;
+  if (stripe_size_ > 0 && size > stripe_size_) {
+    count = (size + stripe_size_ - 1) / stripe_size_;
+  }
+
+  auto batch = make_shared<StripeBatch>();
+  batch->remaining = count;
+  batch->thread = thread;
+  // 最后一个完成的条带删除旧版本多出的条带并回调
+  auto finish = [this, name, first, count, last, batch, done](bool stripe_ok) {
+    if (!batch->Finish(stripe_ok)) return;
+    for (long long i = first + count; last; ++i) {
+      error_code ec;
+      if (!fs::remove(StripePath(name, i), ec)) break;
+    }
+    bool ok = batch->ok;
+    BlockingPool::Post(batch->thread, [done, ok]() { done(ok); });
+  };
+
+  for (long long i = 0; i < count; ++i) {
+    Disk* disk = disks_[Locate(name, first + i)].get();
+    fs::path path = StripePath(name, first + i);
+    fs::path temp_dir = fs::path(disk->path) / kReservedDir / "tmp";
+    long long begin = i * stripe_size_;
+    long long len = count == 1 ? size : min(stripe_size_, size - begin);
+    auto work = [disk, path, temp_dir, data, begin, len, finish]() {
+      bool ok = true;
+      Measure(disk, true, [&]() -> long long {
+        error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        fs::create_directories(temp_dir, ec);
+        // 先写临时文件再重命名, 读者不会看到写了一半的条带
+        stringstream temp_name;
+        temp_name << path.filename().string() << "." << this_thread::get_id()
+                  << "." << ++temp_seq;
+        fs::path temp = temp_dir / temp_name.str();
+        {
+          ofstream out(temp, ios::binary | ios::trunc);
+          out.write(data->data() + begin, len);
+          if (!out) ok = false;
+        }
+        if (ok) fs::rename(temp, path, ec);
+        if (!ok || ec) {
+          cerr << "DiskSet::WriteRange() Failed to write " << path << endl;
+          fs::remove(temp, ec);
+          ok = false;
+          return -1;
+        }
+        return len;
+      });
+      finish(ok);
+    };
+    if (!disk->pool.Submit(work)) finish(false);
+  }
+  return true;
+}
+
+/**
+ * @brief 读取文件, 各条带并行从所在的磁盘读取
+ *
+ * @param name 文件名(相对路径)
+ * @param thread 执行回调的线程
+ * @param done 所有条带完成后的回调
+ * @return true 已提交
+ * @return false 名称非法或未初始化
+ */
+bool DiskSet::Read(const string& name, Thread* thread, ReadDone done) {
+  return ReadRange(name, 0, -1, thread, move(done));
+}
+
+/**
+ * @brief 读取文件的一段, 只读取区间涉及的条带
+ *
+ * @details 文件大小由条带0所在磁盘的I/O线程检查得到, 不阻塞调用线程
+ *
+ * @param name 文件名(相对路径)
+ * @param offset 在文件中的偏移
+ * @param length 读取的长度, 小于0表示读到文件末尾
+ * @param thread 执行回调的线程
+ * @param done 所有条带完成后的回调
+ * @return true 已提交
+ * @return false 名称非法、未初始化或偏移为负数
+ */
+bool DiskSet::ReadRange(const string& name, long long offset, long long length,
+                        Thread* thread, ReadDone done) {
+  if (!initialized_ || !ValidName(name) || offset < 0) {
+    cerr << "DiskSet::ReadRange() Invalid name or not initialized." << endl;
+    return false;
+  }
+  auto batch = make_shared<StripeBatch>();
+  batch->thread = thread;
+  auto finish = [batch, done](bool stripe_ok) {
+    if (!batch->Finish(stripe_ok)) return;
+    bool ok = batch->ok;
+    auto result = make_shared<string>(ok ? move(batch->data) : string());
+    BlockingPool::Post(batch->thread,
+                       [done, ok, result]() { done(ok, move(*result)); });
+  };
+
+  auto start = [this, name, offset, length, batch, finish]() {
+    long long size = 0;
+    if (!Stat(name, &size)) {
+      batch->remaining = 1;
+      finish(false);
+      return;
+    }
+    // 区间截断到文件末尾
+    long long begin = min(offset, size);
+    long long end = length < 0 ? size : min(size, begin + min(length, size));
+    long long first = 0, count = 1;
+    if (stripe_size_ > 0 && end > begin) {
+      first = begin / stripe_size_;
+      count = (end - 1) / stripe_size_ - first + 1;
+    }
+    batch->data.resize(end - begin);
+    batch->remaining = count;
+    for (long long i = first; i < first + count; ++i) {
+      Disk* disk = disks_[Locate(name, i)].get();
+      string path = StripePath(name, i);
+      // 条带与区间重叠的部分: 条带内偏移和在结果中的偏移
+      long long stripe_begin = stripe_size_ > 0 ? i * stripe_size_ : 0;
+      long long from = max(begin, stripe_begin);
+      long long to = stripe_size_ > 0 ? min(end, stripe_begin + stripe_size_)
+                                      : end;
+      long long skip = from - stripe_begin;
+      long long pos = from - begin;
+      long long len = max(to - from, 0LL);
+      auto work = [disk, path, batch, skip, pos, len, finish]() {
+        bool ok = true;
+        Measure(disk, false, [&]() -> long long {
+          ifstream in(path, ios::binary);
+          in.seekg(skip);
+          in.read(&batch->data[0] + pos, len);
+          if (!in || in.gcount() != len) {
+            cerr << "DiskSet::ReadRange() Failed to read " << path << endl;
+            ok = false;
+            return -1;
+          }
+          return len;
+        });
+        finish(ok);
+      };
+      if (!disk->pool.Submit(work)) finish(false);
+    }
+  };
+  return disks_[Locate(name, 0)]->pool.Submit(start);
+}
+
+/**
+ * @brief 获取文件大小(按顺序检查条带, 阻塞)
+ *
+ * @details 除最后一个条带外每个条带都是`stripe_size`字节,
+ * 条带缺失或不满一个条带时文件结束
+ *
+ * @param name 文件名(相对路径)
+ * @param size 输出文件大小
+ * @return true 文件存在
+ * @return false 文件不存在
+ */
+bool DiskSet::Stat(const string& name, long long* size) const {
+  if (!initialized_ || !ValidName(name)) return false;
+  long long total = 0;
+  for (long long i = 0;; ++i) {
+    error_code ec;
+    uintmax_t len = fs::file_size(StripePath(name, i), ec);
+    if (ec) {
+      if (i == 0) return false;
+      break;
+    }
+    total += static_cast<long long>(len);
+    if (stripe_size_ <= 0 || static_cast<long long>(len) < stripe_size_) break;
+  }
+  *size = total;
+  return true;
+}
+
+/**
+ * @brief 删除文件的所有条带(阻塞)
+ *
+ * @param name 文件名(相对路径)
+ * @return true 文件存在并已删除
+ * @return false 文件不存在
+ */
+bool DiskSet::Remove(const string& name) {
+  if (!initialized_ || !ValidName(name)) return false;
+  long long i = 0;
+  for (;; ++i) {
+    error_code ec;
+    if (!fs::remove(StripePath(name, i), ec)) break;
+  }
+  return i > 0;
+}
+
+/**
+ * @brief 获取每块磁盘的统计信息
+ *
+ * @return std::vector<DiskStats> 按磁盘序号排列的统计信息
+ */
+vector<DiskStats> DiskSet::stats() const {
+  vector<DiskStats> result;
+  for (auto& disk : disks_) {
+    DiskStats stats;
+    stats.path = disk->path;
+    stats.weight = disk->weight;
+    stats.reads = disk->reads;
+    stats.writes = disk->writes;
+    stats.read_bytes = disk->read_bytes;
+    stats.write_bytes = disk->write_bytes;
+    stats.errors = disk->errors;
+    stats.busy_us = disk->busy_us;
+    stats.max_latency_us = disk->max_latency_us;
+    stats.pending = disk->pool.pending();
+    result.push_back(stats);
+  }
+  return result;
+}
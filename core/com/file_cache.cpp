@@ -0,0 +1,224 @@
+﻿/**
+ * @file file_cache.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `FileCache`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/file_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "include/block_cache.h"
+#include "util.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+OpenFile::~OpenFile() {
+  if (fd < 0) return;
+#ifdef _WIN32
+  _close(fd);
+#else
+  close(fd);
+#endif
+}
+
+/**
+ * @brief 构造文件缓存
+ *
+ * @param max_files 缓存的文件描述符数量上限
+ * @param revalidate_ms 条目重新`stat`校验的间隔(毫秒), 0为每次都校验
+ */
+FileCache::FileCache(int max_files, int revalidate_ms)
+    : max_files_(max_files > 0 ? max_files : 1),
+      revalidate_(revalidate_ms) {}
+
+/**
+ * @brief 打开文件并读取元数据(不持有锁)
+ *
+ * @param path 文件路径
+ * @return OpenFilePtr 打开的文件, 失败返回`nullptr`
+ */
+OpenFilePtr FileCache::Load(const string& path) {
+#ifdef _WIN32
+  int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+  if (fd < 0) return nullptr;
+
+  auto file = make_shared<OpenFile>();
+  file->path = path;
+  file->fd = fd;
+  StatType st;
+  if (FileFstat(fd, &st) != 0) {
+    cerr << "FileCache::Load() Failed to stat " << path << endl;
+    return nullptr;
+  }
+  file->size = st.st_size;
+  file->mtime_ns = MtimeNs(st);
+  file->dev = static_cast<uint64_t>(st.st_dev);
+  file->ino = static_cast<uint64_t>(st.st_ino);
+
+  // 混合设备号、inode、修改时间和大小得到内容标识
+  file->file_id =
+      BlockCache::FileId(file->dev, file->ino, file->mtime_ns, file->size);
+  return file;
+}
+
+/**
+ * @brief 检查缓存的文件是否仍与路径上的文件一致
+ *
+ * @param file 缓存的文件
+ * @return true 一致
+ * @return false 文件已被替换或修改
+ */
+bool FileCache::StillValid(const OpenFile& file) {
+  StatType st;
+  if (FileStat(file.path.c_str(), &st) != 0) return false;
+  return static_cast<uint64_t>(st.st_ino) == file.ino &&
+         static_cast<uint64_t>(st.st_dev) == file.dev &&
+         st.st_size == file.size && MtimeNs(st) == file.mtime_ns;
+}
+
+/**
+ * @brief 打开文件(只读), 优先使用缓存
+ *
+ * @param path 文件路径
+ * @return OpenFilePtr 打开的文件, 失败返回`nullptr`
+ */
+OpenFilePtr FileCache::Open(const string& path) {
+  OpenFilePtr stale;
+  uint64_t generation = 0;
+  {
+    unique_lock<mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+      Entry& entry = it->second.first;
+      Clock::time_point now = Clock::now();
+      if (now - entry.checked < revalidate_) {
+        ++hits_;
+        lru_.splice(lru_.begin(), lru_, it->second.second);
+        return entry.file;
+      }
+      // 超过校验间隔, 在锁外重新`stat`
+      stale = entry.file;
+    }
+    Pending& pending = pending_[path];
+    ++pending.loads;
+    generation = pending.generation;
+  }
+
+  if (stale) {
+    bool valid = StillValid(*stale);
+    lock_guard<mutex> lock(mutex_);
+    ++revalidations_;
+    auto it = entries_.find(path);
+    if (valid && pending_[path].generation == generation &&
+        it != entries_.end() && it->second.first.file == stale) {
+      EndLoad(path, generation);
+      ++hits_;
+      it->second.first.checked = Clock::now();
+      lru_.splice(lru_.begin(), lru_, it->second.second);
+      return stale;
+    }
+    if (it != entries_.end() && it->second.first.file == stale) Erase(path);
+  }
+
+  OpenFilePtr file = Load(path);
+  lock_guard<mutex> lock(mutex_);
+  ++misses_;
+  bool current = EndLoad(path, generation);
+  if (!file) return nullptr;
+  // 打开期间路径失效过, 文件可能已经过时, 不放入缓存
+  if (!current) return file;
+
+  auto it = entries_.find(path);
+  if (it != entries_.end()) {
+    // 其它线程已经放入缓存, 使用已缓存的文件
+    return it->second.first.file;
+  }
+  lru_.push_front(path);
+  entries_[path] = make_pair(Entry{file, Clock::now()}, lru_.begin());
+  while (static_cast<int>(entries_.size()) > max_files_) {
+    Erase(lru_.back());
+    ++evictions_;
+  }
+  return file;
+}
+
+/**
+ * @brief 删除条目(需持有`mutex_`)
+ */
+void FileCache::Erase(const string& path) {
+  auto it = entries_.find(path);
+  if (it == entries_.end()) return;
+  lru_.erase(it->second.second);
+  entries_.erase(it);
+}
+
+/**
+ * @brief 结束一次锁外打开(需持有`mutex_`)
+ *
+ * @param path 文件路径
+ * @param generation 开始打开时路径的失效代数
+ * @return true 打开期间路径没有失效
+ * @return false 打开期间路径失效过, 结果不能放入缓存
+ */
+bool FileCache::EndLoad(const string& path, uint64_t generation) {
+  auto it = pending_.find(path);
+  if (it == pending_.end()) return false;
+  bool current = it->second.generation == generation;
+  if (--it->second.loads == 0) pending_.erase(it);
+  return current;
+}
+
+/**
+ * @brief 使路径对应的缓存失效(文件被上传覆盖或删除时调用)
+ *
+ * @param path 文件路径
+ */
+void FileCache::Invalidate(const string& path) {
+  lock_guard<mutex> lock(mutex_);
+  auto it = pending_.find(path);
+  if (it != pending_.end()) ++it->second.generation;
+  Erase(path);
+}
+
+/**
+ * @brief 清空缓存
+ */
+void FileCache::Clear() {
+  lock_guard<mutex> lock(mutex_);
+  for (auto& pending : pending_) ++pending.second.generation;
+  entries_.clear();
+  lru_.clear();
+}
+
+/**
+ * @brief 获取统计信息
+ *
+ * @return FileCacheStats 统计信息
+ */
+FileCacheStats FileCache::stats() {
+  lock_guard<mutex> lock(mutex_);
+  FileCacheStats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.revalidations = revalidations_;
+  stats.evictions = evictions_;
+  stats.cached = static_cast<int>(entries_.size());
+  return stats;
+}
@@ -0,0 +1,276 @@
+﻿/**
+ * @file file_writer.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `FileWriter`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/file_writer.h"
+
+#include <fcntl.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "util.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 合并重叠或相邻的区间
+ */
+static void MergeRanges(vector<pair<long long, long long>>* ranges) {
+  if (ranges->size() < 2) return;
+  sort(ranges->begin(), ranges->end());
+  size_t out = 0;
+  for (size_t i = 1; i < ranges->size(); ++i) {
+    auto& last = (*ranges)[out];
+    if ((*ranges)[i].first <= last.second) {
+      last.second = max(last.second, (*ranges)[i].second);
+    } else {
+      (*ranges)[++out] = (*ranges)[i];
+    }
+  }
+  ranges->resize(out + 1);
+}
+
+/**
+ * @brief 构造文件写入器
+ *
+ * @param path 文件路径
+ * @param options 写入选项
+ */
+FileWriter::FileWriter(const string& path, const FileWriterOptions& options)
+    : path_(path), options_(options) {
+  if (options_.alignment == 0 ||
+      (options_.alignment & (options_.alignment - 1)) != 0) {
+    options_.alignment = 4096;
+  }
+}
+
+FileWriter::~FileWriter() {
+  Close();
+#ifdef _WIN32
+  _aligned_free(aligned_buf_);
+#else
+  free(aligned_buf_);
+#endif
+}
+
+/**
+ * @brief 创建(或截断)文件并预分配空间
+ *
+ * @param declared_size 声明的文件大小, 小于等于0表示未知
+ * @return true 成功
+ * @return false 创建文件失败
+ */
+bool FileWriter::Open(long long declared_size) {
+  Close();
+  failed_ = false;
+#ifdef _WIN32
+  fd_ = _open(path_.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+              0644);
+#else
+  fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+  if (fd_ < 0) {
+    cerr << "FileWriter::Open() Failed to create " << path_ << endl;
+    return false;
+  }
+  if (declared_size <= 0) return true;
+
+  if (options_.preallocate) {
+#if defined(__linux__)
+    // 一次分配连续空间, 乱序写入也不会产生碎片
+    preallocated_ = fallocate(fd_, 0, 0, declared_size) == 0;
+    if (!preallocated_ && ftruncate(fd_, declared_size) != 0) {
+      cerr << "FileWriter::Open() Failed to size " << path_ << endl;
+    }
+#elif defined(_WIN32)
+    _chsize_s(fd_, declared_size);
+#else
+    if (ftruncate(fd_, declared_size) != 0) {
+      cerr << "FileWriter::Open() Failed to size " << path_ << endl;
+    }
+#endif
+  }
+
+#if defined(__linux__)
+  if (options_.direct_threshold > 0 &&
+      declared_size >= options_.direct_threshold) {
+    // 文件系统不支持`O_DIRECT`时使用普通写入
+    direct_fd_ = open(path_.c_str(), O_WRONLY | O_DIRECT);
+  }
+#endif
+  return true;
+}
+
+/**
+ * @brief 在指定偏移写入数据(线程不安全, 调用者保证同一时间只有一次写入)
+ *
+ * @param offset 文件偏移
+ * @param data 数据
+ * @param len 数据长度
+ * @return true 成功
+ * @return false 写入失败
+ */
+bool FileWriter::WriteAt(long long offset, const char* data, size_t len) {
+  if (fd_ < 0) {
+    cerr << "FileWriter::WriteAt() Not opened." << endl;
+    return false;
+  }
+  if (len == 0) return true;
+
+  if (direct_fd_ >= 0) {
+    // 对齐的部分直接写入, 首尾不对齐的部分走页缓存
+    const long long align = static_cast<long long>(options_.alignment);
+    long long end = offset + static_cast<long long>(len);
+    long long begin_aligned = (offset + align - 1) / align * align;
+    long long end_aligned = end / align * align;
+    if (begin_aligned < end_aligned) {
+      if (!WriteDirect(begin_aligned, data + (begin_aligned - offset),
+                       static_cast<size_t>(end_aligned - begin_aligned))) {
+        return false;
+      }
+      bytes_written_ += end_aligned - begin_aligned;
+      if (begin_aligned > offset &&
+          !WriteAt(offset, data, static_cast<size_t>(begin_aligned - offset))) {
+        return false;
+      }
+      if (end > end_aligned &&
+          !WriteAt(end_aligned, data + (end_aligned - offset),
+                   static_cast<size_t>(end - end_aligned))) {
+        return false;
+      }
+      return true;
+    }
+  }
+
+  if (!WriteFull(fd_, data, len, offset)) {
+    cerr << "FileWriter::WriteAt() Failed to write " << path_ << endl;
+    failed_ = true;
+    return false;
+  }
+  bytes_written_ += len;
+  Track(offset, len);
+  return true;
+}
+
+/**
+ * @brief 完成写入: 发起剩余数据的写回并释放页缓存, 然后关闭文件
+ *
+ * @return true 成功
+ * @return false 未打开或写入失败
+ */
+bool FileWriter::Finish() {
+  if (fd_ < 0) {
+    cerr << "FileWriter::Finish() Not opened." << endl;
+    return false;
+  }
+  if (options_.writeback_bytes > 0) Writeback(true);
+  Close();
+  return !failed_;
+}
+
+/**
+ * @brief 记录写入的区间, 累计到阈值时发起一轮写回
+ */
+void FileWriter::Track(long long offset, size_t len) {
+  if (options_.writeback_bytes <= 0) return;
+  dirty_.push_back({offset, offset + static_cast<long long>(len)});
+  dirty_bytes_ += len;
+  if (dirty_bytes_ >= options_.writeback_bytes) Writeback(false);
+}
+
+/**
+ * @brief 发起当前区间的写回, 等待上一轮写回完成并释放页缓存
+ *
+ * @param wait_all 是否同时等待本轮写回完成(结束写入时)
+ */
+void FileWriter::Writeback(bool wait_all) {
+  MergeRanges(&dirty_);
+#if defined(__linux__)
+  // 发起本轮写回, 不等待
+  for (const Range& range : dirty_) {
+    sync_file_range(fd_, range.first, range.second - range.first,
+                    SYNC_FILE_RANGE_WRITE);
+  }
+  // 上一轮的写回通常已经完成, 等待后释放页缓存
+  if (wait_all) flushing_.insert(flushing_.end(), dirty_.begin(), dirty_.end());
+  for (const Range& range : flushing_) {
+    long long length = range.second - range.first;
+    sync_file_range(fd_, range.first, length,
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                        SYNC_FILE_RANGE_WAIT_AFTER);
+    if (options_.drop_cache) {
+      posix_fadvise(fd_, range.first, length, POSIX_FADV_DONTNEED);
+    }
+  }
+#endif
+  flushing_.swap(dirty_);
+  dirty_.clear();
+  dirty_bytes_ = 0;
+  if (wait_all) flushing_.clear();
+  ++writeback_rounds_;
+}
+
+/**
+ * @brief 通过`O_DIRECT`描述符写入对齐的数据
+ */
+bool FileWriter::WriteDirect(long long offset, const char* data, size_t len) {
+  // 用户数据的地址不一定对齐, 复制到对齐的缓冲区后写入
+  if (aligned_size_ < len) {
+#ifdef _WIN32
+    _aligned_free(aligned_buf_);
+    aligned_buf_ = static_cast<char*>(_aligned_malloc(len, options_.alignment));
+#else
+    free(aligned_buf_);
+    void* buf = nullptr;
+    if (posix_memalign(&buf, options_.alignment, len) != 0) buf = nullptr;
+    aligned_buf_ = static_cast<char*>(buf);
+#endif
+    aligned_size_ = aligned_buf_ ? len : 0;
+    if (!aligned_buf_) {
+      cerr << "FileWriter::WriteDirect() Out of memory." << endl;
+      failed_ = true;
+      return false;
+    }
+  }
+  memcpy(aligned_buf_, data, len);
+  if (!WriteFull(direct_fd_, aligned_buf_, len, offset)) {
+    cerr << "FileWriter::WriteDirect() Failed to write " << path_ << endl;
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 关闭文件描述符
+ */
+void FileWriter::Close() {
+  for (int* fd : {&fd_, &direct_fd_}) {
+    if (*fd < 0) continue;
+#ifdef _WIN32
+    _close(*fd);
+#else
+    close(*fd);
+#endif
+    *fd = -1;
+  }
+  dirty_.clear();
+  flushing_.clear();
+  dirty_bytes_ = 0;
+}
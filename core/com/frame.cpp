@@ -0,0 +1,174 @@
+﻿/**
+ * @file frame.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Frame`、`FrameWriter`和`FrameReader`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/frame.h"
+
+#include <event2/buffer.h>
+
+#include <iostream>
+
+#include "util.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 编码消息头
+ *
+ * @param type 消息类型
+ * @param id 请求ID
+ * @param body_size 消息体长度
+ * @param out 输出`kHeaderSize`字节
+ */
+void Frame::EncodeHeader(FrameType type, uint32_t id, uint32_t body_size,
+                         char* out) {
+  PutUint(out, body_size, 4);
+  out[4] = static_cast<char>(type);
+  PutUint(out + 5, id, 4);
+}
+
+/**
+ * @brief 解码消息头
+ *
+ * @param data `kHeaderSize`字节的消息头
+ * @param type 输出消息类型
+ * @param id 输出请求ID
+ * @param body_size 输出消息体长度
+ * @return true 成功
+ * @return false 消息体超过长度上限
+ */
+bool Frame::DecodeHeader(const char* data, FrameType* type, uint32_t* id,
+                         uint32_t* body_size) {
+  *body_size = static_cast<uint32_t>(GetUint(data, 4));
+  *type = static_cast<FrameType>(static_cast<uint8_t>(data[4]));
+  *id = static_cast<uint32_t>(GetUint(data + 5, 4));
+  if (*body_size > kMaxBodySize) {
+    cerr << "Frame::DecodeHeader() Frame too large: " << *body_size << endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 查看缓冲区中第一条完整消息的长度
+ *
+ * @param in 输入缓冲区
+ * @param frame_size 输出消息总长度(含消息头)
+ * @return int 1为有完整消息, 0为数据不足, -1为格式错误
+ */
+int Frame::Peek(evbuffer* in, size_t* frame_size) {
+  char header[kHeaderSize];
+  if (evbuffer_copyout(in, header, kHeaderSize) !=
+      static_cast<ev_ssize_t>(kHeaderSize)) {
+    return 0;
+  }
+  FrameType type;
+  uint32_t id = 0, body_size = 0;
+  if (!DecodeHeader(header, &type, &id, &body_size)) return -1;
+  *frame_size = kHeaderSize + body_size;
+  return evbuffer_get_length(in) >= *frame_size ? 1 : 0;
+}
+
+/**
+ * @brief 从缓冲区取出一条完整消息
+ *
+ * @param in 输入缓冲区
+ * @param frame 输出消息
+ * @return int 1为取出一条消息, 0为数据不足, -1为格式错误
+ */
+int Frame::Pop(evbuffer* in, Frame* frame) {
+  size_t frame_size = 0;
+  int re = Peek(in, &frame_size);
+  if (re <= 0) return re;
+  char header[kHeaderSize];
+  evbuffer_remove(in, header, kHeaderSize);
+  uint32_t body_size = 0;
+  DecodeHeader(header, &frame->type, &frame->id, &body_size);
+  frame->body.resize(body_size);
+  if (body_size > 0) evbuffer_remove(in, &frame->body[0], body_size);
+  return 1;
+}
+
+/**
+ * @brief 编码整条消息
+ *
+ * @return std::string 消息头和消息体
+ */
+string Frame::Encode() const {
+  string out(kHeaderSize, '\0');
+  EncodeHeader(type, id, static_cast<uint32_t>(body.size()), &out[0]);
+  out += body;
+  return out;
+}
+
+/**
+ * @brief 追加长度前缀(4字节)的字符串
+ */
+void FrameWriter::PutString(const string& value) {
+  PutU32(static_cast<uint32_t>(value.size()));
+  body_ += value;
+}
+
+/**
+ * @brief 按小端序追加整数
+ */
+void FrameWriter::PutUint(uint64_t value, int bytes) {
+  char buf[8];
+  ::PutUint(buf, value, bytes);
+  body_.append(buf, bytes);
+}
+
+/**
+ * @brief 生成消息
+ *
+ * @param type 消息类型
+ * @param id 请求ID
+ * @return std::string 编码后的整条消息
+ */
+string FrameWriter::Finish(FrameType type, uint32_t id) const {
+  Frame frame;
+  frame.type = type;
+  frame.id = id;
+  frame.body = body_;
+  return frame.Encode();
+}
+
+bool FrameReader::GetU8(uint8_t* value) {
+  uint64_t v = 0;
+  if (!GetUint(&v, 1)) return false;
+  *value = static_cast<uint8_t>(v);
+  return true;
+}
+
+bool FrameReader::GetU32(uint32_t* value) {
+  uint64_t v = 0;
+  if (!GetUint(&v, 4)) return false;
+  *value = static_cast<uint32_t>(v);
+  return true;
+}
+
+bool FrameReader::GetU64(uint64_t* value) { return GetUint(value, 8); }
+
+bool FrameReader::GetString(string* value) {
+  uint32_t len = 0;
+  if (!GetU32(&len) || len > remaining()) return false;
+  value->assign(data_ + pos_, len);
+  pos_ += len;
+  return true;
+}
+
+/**
+ * @brief 按小端序读取整数
+ */
+bool FrameReader::GetUint(uint64_t* value, int bytes) {
+  if (remaining() < static_cast<size_t>(bytes)) return false;
+  *value = ::GetUint(data_ + pos_, bytes);
+  pos_ += bytes;
+  return true;
+}
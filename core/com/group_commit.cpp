@@ -0,0 +1,232 @@
+﻿/**
+ * @file group_commit.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `GroupCommitter`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/group_commit.h"
+
+#include <fcntl.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+#include "include/blocking_pool.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 把文件数据(不含无关元数据)刷写到磁盘
+ *
+ * @param fd 文件描述符
+ * @return true 成功
+ */
+static bool DataSync(int fd) {
+#if defined(_WIN32)
+  return _commit(fd) == 0;
+#elif defined(__APPLE__)
+  return fsync(fd) == 0;
+#else
+  return fdatasync(fd) == 0;
+#endif
+}
+
+/**
+ * @brief 构造组提交器, 启动收集线程
+ *
+ * @param pool 执行落盘的阻塞I/O线程池, 为`nullptr`时在收集线程中落盘
+ * @param window_ms 合并窗口(毫秒), 从组内第一个请求开始计时
+ * @param max_bytes 组内累计字节数达到该值时立即落盘, 小于等于0表示不限制
+ */
+GroupCommitter::GroupCommitter(BlockingPool* pool, int window_ms,
+                               long long max_bytes)
+    : pool_(pool),
+      window_(window_ms < 0 ? 0 : window_ms),
+      max_bytes_(max_bytes) {
+  collector_ = thread(&GroupCommitter::Main, this);
+}
+
+/**
+ * @brief 落盘剩余的请求后停止收集线程, 等待线程池中的落盘完成
+ *
+ * @details 落盘工作引用本对象, 全部完成前不能释放
+ */
+GroupCommitter::~GroupCommitter() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cond_.notify_all();
+  if (collector_.joinable()) collector_.join();
+  unique_lock<mutex> lock(mutex_);
+  cond_.wait(lock, [this] { return in_flight_ == 0; });
+}
+
+/**
+ * @brief 提交落盘请求
+ *
+ * @param fd 已写入数据的文件描述符
+ * @param offset 写入的起始偏移
+ * @param length 写入的字节数
+ * @param durability 持久化级别
+ * @param thread 执行回调的线程, 为`nullptr`时在落盘线程中直接回调
+ * @param done 落盘完成回调
+ */
+void GroupCommitter::Commit(int fd, long long offset, long long length,
+                            Durability durability, Thread* thread,
+                            Done done) {
+  ++commits_;
+  if (durability == Durability::kNone) {
+    if (done) done(true);
+    return;
+  }
+  Waiter waiter{fd, offset, length, thread, move(done)};
+  if (durability == Durability::kImmediate) {
+    Run([this, waiter]() mutable {
+      vector<Waiter> group;
+      group.push_back(move(waiter));
+      SyncGroup(group);
+    });
+    return;
+  }
+
+  bool full = false;
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (pending_.empty()) group_start_ = chrono::steady_clock::now();
+    pending_.push_back(move(waiter));
+    pending_bytes_ += length;
+    full = max_bytes_ > 0 && pending_bytes_ >= max_bytes_;
+    // 只在组的第一个请求和达到阈值时唤醒收集线程
+    if (pending_.size() > 1 && !full) return;
+  }
+  cond_.notify_one();
+}
+
+/**
+ * @brief 不等待窗口结束, 立即落盘当前组
+ */
+void GroupCommitter::Flush() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (pending_.empty()) return;
+    flush_now_ = true;
+  }
+  cond_.notify_one();
+}
+
+/**
+ * @brief 获取统计信息
+ */
+GroupCommitStats GroupCommitter::stats() const {
+  GroupCommitStats stats;
+  stats.commits = commits_;
+  stats.groups = groups_;
+  stats.syncs = syncs_;
+  stats.failures = failures_;
+  return stats;
+}
+
+/**
+ * @brief 收集线程入口: 等待窗口结束或字节数达到阈值后提交一组
+ */
+void GroupCommitter::Main() {
+  unique_lock<mutex> lock(mutex_);
+  for (;;) {
+    cond_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+    if (pending_.empty()) return;  // 停止且没有剩余请求
+
+    cond_.wait_until(lock, group_start_ + window_, [this] {
+      return stopping_ || flush_now_ ||
+             (max_bytes_ > 0 && pending_bytes_ >= max_bytes_);
+    });
+    auto group = make_shared<vector<Waiter>>();
+    group->swap(pending_);
+    pending_bytes_ = 0;
+    flush_now_ = false;
+    ++groups_;
+
+    lock.unlock();
+    Run([this, group]() { SyncGroup(*group); });
+    lock.lock();
+  }
+}
+
+/**
+ * @brief 落盘一组请求并确认(阻塞)
+ *
+ * @param group 一组请求
+ */
+void GroupCommitter::SyncGroup(vector<Waiter>& group) {
+  // 合并每个文件的写入范围
+  map<int, pair<long long, long long>> ranges;
+  for (const Waiter& waiter : group) {
+    auto it = ranges.find(waiter.fd);
+    long long end = waiter.offset + waiter.length;
+    if (it == ranges.end()) {
+      ranges[waiter.fd] = {waiter.offset, end};
+    } else {
+      it->second.first = min(it->second.first, waiter.offset);
+      it->second.second = max(it->second.second, end);
+    }
+  }
+
+#if defined(__linux__)
+  // 先对所有文件发起写回, 让磁盘同时处理多个文件的脏页
+  for (auto& item : ranges) {
+    long long length = item.second.second - item.second.first;
+    sync_file_range(item.first, item.second.first, length > 0 ? length : 0,
+                    SYNC_FILE_RANGE_WRITE);
+  }
+#endif
+
+  // 每个文件只调用一次`fdatasync`, 同时刷写元数据和磁盘缓存
+  map<int, bool> results;
+  for (auto& item : ranges) {
+    ++syncs_;
+    results[item.first] = DataSync(item.first);
+    if (!results[item.first]) {
+      cerr << "GroupCommitter::SyncGroup() Failed to sync fd " << item.first
+           << endl;
+    }
+  }
+
+  for (Waiter& waiter : group) {
+    bool ok = results[waiter.fd];
+    if (!ok) ++failures_;
+    if (!waiter.done) continue;
+    Done done = move(waiter.done);
+    BlockingPool::Post(waiter.thread, [done, ok]() { done(ok); });
+  }
+}
+
+/**
+ * @brief 在阻塞I/O线程池中执行, 线程池不可用时直接执行
+ *
+ * @details 记录正在执行的落盘数, 完成时在持有锁的情况下通知析构函数,
+ * 之后不再访问本对象
+ */
+void GroupCommitter::Run(function<void()> work) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    ++in_flight_;
+  }
+  auto tracked = [this, work]() {
+    work();
+    lock_guard<mutex> lock(mutex_);
+    if (--in_flight_ == 0) cond_.notify_all();
+  };
+  if (pool_ && pool_->Submit(tracked)) return;
+  tracked();
+}
@@ -0,0 +1,152 @@
+﻿/**
+ * @file hash_ring.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `HashRing`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/hash_ring.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 构造哈希环
+ *
+ * @param vnodes 权重为1的节点放置的虚拟节点数
+ */
+HashRing::HashRing(int vnodes) : vnodes_(max(vnodes, 1)) {}
+
+/**
+ * @brief 计算字符串的64位哈希
+ *
+ * @param data 字符串
+ * @return uint64_t 哈希值
+ */
+uint64_t HashRing::Hash(const string& data) {
+  uint64_t h = 1469598103934665603ULL;
+  for (unsigned char c : data) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  // splitmix64 的混合函数, 改善FNV-1a在高位上的分布
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+/**
+ * @brief 添加节点, 已存在时更新权重
+ *
+ * @param node 节点名称
+ * @param weight 权重
+ * @return true 成功
+ * @return false 名称为空或权重不大于0
+ */
+bool HashRing::AddNode(const string& node, double weight) {
+  if (node.empty() || !(weight > 0)) return false;
+  auto it = find_if(nodes_.begin(), nodes_.end(),
+                    [&](const pair<string, double>& n) {
+                      return n.first == node;
+                    });
+  if (it != nodes_.end()) {
+    it->second = weight;
+  } else {
+    nodes_.emplace_back(node, weight);
+  }
+  Rebuild();
+  return true;
+}
+
+/**
+ * @brief 删除节点
+ *
+ * @param node 节点名称
+ * @return true 成功
+ * @return false 节点不存在
+ */
+bool HashRing::RemoveNode(const string& node) {
+  auto it = find_if(nodes_.begin(), nodes_.end(),
+                    [&](const pair<string, double>& n) {
+                      return n.first == node;
+                    });
+  if (it == nodes_.end()) return false;
+  nodes_.erase(it);
+  Rebuild();
+  return true;
+}
+
+/**
+ * @brief 判断节点是否存在
+ */
+bool HashRing::Contains(const string& node) const {
+  for (auto& n : nodes_) {
+    if (n.first == node) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief 按节点列表重建虚拟节点
+ *
+ * @details 虚拟节点的位置只由节点名称和序号决定, 与其它节点无关,
+ * 所以增删一个节点不会移动其它节点的虚拟节点
+ */
+void HashRing::Rebuild() {
+  ring_.clear();
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    int count = max(1, static_cast<int>(lround(vnodes_ * nodes_[i].second)));
+    for (int v = 0; v < count; ++v) {
+      ring_.emplace_back(Hash(nodes_[i].first + "#" + to_string(v)),
+                         static_cast<int>(i));
+    }
+  }
+  sort(ring_.begin(), ring_.end());
+}
+
+/**
+ * @brief 查找键的归属节点
+ *
+ * @param key 键
+ * @return const std::string* 节点名称, 环为空时返回`nullptr`
+ */
+const string* HashRing::Lookup(const string& key) const {
+  if (ring_.empty()) return nullptr;
+  auto it = lower_bound(ring_.begin(), ring_.end(),
+                        make_pair(Hash(key), 0));
+  if (it == ring_.end()) it = ring_.begin();
+  return &nodes_[it->second].first;
+}
+
+/**
+ * @brief 查找键的前`count`个不同节点(沿环顺时针)
+ *
+ * @param key 键
+ * @param count 需要的节点数
+ * @return std::vector<std::string> 节点名称
+ */
+vector<string> HashRing::Lookup(const string& key, int count) const {
+  vector<string> result;
+  if (ring_.empty() || count <= 0) return result;
+  count = min(count, size());
+  vector<bool> taken(nodes_.size(), false);
+  size_t start = lower_bound(ring_.begin(), ring_.end(),
+                             make_pair(Hash(key), 0)) -
+                 ring_.begin();
+  for (size_t i = 0;
+       i < ring_.size() && static_cast<int>(result.size()) < count; ++i) {
+    int node = ring_[(start + i) % ring_.size()].second;
+    if (taken[node]) continue;
+    taken[node] = true;
+    result.push_back(nodes_[node].first);
+  }
+  return result;
+}
@@ -0,0 +1,190 @@
+﻿/**
+ * @file batch_download.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `BatchDownload`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef BATCH_DOWNLOAD_H
+#define BATCH_DOWNLOAD_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "crossocean.h"
+#include "file_cache.h"
+
+CROSSOCEAN_NAMESPACE
+
+class BlockingPool;
+class Thread;
+
+/**
+ * @brief 批量下载中的一个文件
+ */
+struct CROSSOCEAN_API BatchEntry {
+  /// @brief 归档中的文件名(相对路径, 使用`/`分隔)
+  std::string name;
+  /// @brief 磁盘上的文件路径
+  std::string path;
+};
+
+/**
+ * @brief 批量下载统计信息
+ */
+struct CROSSOCEAN_API BatchDownloadStats {
+  long long files = 0;         ///< 已发送的文件数
+  long long skipped = 0;       ///< 打开失败而跳过的文件数
+  long long header_bytes = 0;  ///< 发送的头部、填充和结束块字节数
+  long long body_bytes = 0;    ///< 发送的文件内容字节数
+  long long stalls = 0;        ///< 发送游标等待文件打开的次数
+};
+
+/**
+ * @brief 批量下载: 把多个文件以tar(ustar)流的形式在一个连接上连续发送
+ *
+ * @details
+ * 客户端下载包含上万个小文件的目录时, 逐个请求要为每个文件付出一次往返.
+ * `BatchDownload`把文件列表(或目录前缀下的所有文件)编码为标准tar流,
+ * 客户端可以直接交给`tar -x`解包. 文件在阻塞I/O线程池中提前打开:
+ * 发送游标之前始终保持最多`lookahead`个文件正在打开或已打开,
+ * 事件循环发送时不会因`open`/`fstat`阻塞. 文件头和填充从内存发送,
+ * 文件内容用`sendfile`零拷贝发送. 超过100字节的文件名按ustar前缀拆分,
+ * 无法拆分时使用GNU长文件名扩展; 超过8GB的大小使用GNU base-256编码.
+ * 打开失败(如列出后被删除)的文件被跳过; 发送期间文件变短时用0补齐,
+ * 保证tar流的结构完整.
+ * `Pump`只由所属`Thread`调用; 打开完成的回调投递回该线程执行
+ */
+class CROSSOCEAN_API BatchDownload {
+ public:
+  /// @brief 发送游标等待的文件已打开, 可以继续`Pump`
+  using Ready = std::function<void()>;
+
+  /**
+   * @brief 构造批量下载
+   *
+   * @param pool 打开文件的阻塞I/O线程池, 为`nullptr`时在调用线程中打开
+   * @param cache 文件缓存, 为`nullptr`时使用内部的缓存
+   * @param entries 要发送的文件, 按顺序写入tar流
+   * @param lookahead 发送游标之前提前打开的文件数量
+   */
+  BatchDownload(BlockingPool* pool, FileCache* cache,
+                std::vector<BatchEntry> entries, int lookahead = 32);
+
+  /**
+   * @brief 丢弃未发送的文件, 打开中的工作完成后释放文件
+   */
+  ~BatchDownload();
+
+  /**
+   * @brief 列出目录中路径以前缀开头的所有普通文件(按名称排序)
+   *
+   * @param root 根目录
+   * @param prefix 相对`root`的路径前缀, 如`src/`或`src/main`, 空为全部
+   * @return std::vector<BatchEntry> 文件列表, 名称相对`root`
+   */
+  static std::vector<BatchEntry> List(const std::string& root,
+                                      const std::string& prefix);
+
+  /**
+   * @brief 开始提前打开文件
+   *
+   * @param thread 执行打开完成回调的线程, 为`nullptr`时在工作线程中执行
+   * @param ready 发送游标等待的文件打开后调用(在`thread`中执行)
+   */
+  void Start(Thread* thread, Ready ready);
+
+  /**
+   * @brief 向非阻塞socket发送尽可能多的数据
+   *
+   * @details 返回后根据`finished`和`waiting`判断: 都为false时socket已满,
+   * 等待可写后再次调用; `waiting`为true时等待`Ready`回调
+   *
+   * @param sock 目标socket
+   * @return long long 本次发送的字节数, 出错返回-1
+   */
+  long long Pump(int sock);
+
+  /// @brief 是否已发送完整个tar流(包括结束块)
+  bool finished() const { return finished_; }
+  /// @brief 发送游标是否在等待文件打开
+  bool waiting() const { return waiting_; }
+  /// @brief 文件数量
+  size_t size() const { return entries_.size(); }
+  /// @brief 统计信息
+  const BatchDownloadStats& stats() const { return stats_; }
+
+  /**
+   * @brief 生成一个文件的tar头部(包括需要时的GNU长文件名记录)
+   *
+   * @param name 归档中的文件名
+   * @param size 文件大小
+   * @param mtime 修改时间(秒)
+   * @return std::string 512字节整数倍的头部
+   */
+  static std::string TarHeader(const std::string& name, long long size,
+                               long long mtime);
+
+  /// @brief tar块大小
+  static constexpr long long kBlockSize = 512;
+
+ private:
+  struct Shared;
+
+  /// @brief 发送阶段
+  enum class Stage { kHeader, kBody, kTrailer };
+
+  /**
+   * @brief 提交打开工作, 使游标之前的打开数量达到`lookahead`
+   */
+  void FillAhead();
+
+  /**
+   * @brief 发送内存中待发送的数据
+   *
+   * @return long long 发送的字节数, socket已满返回0, 出错返回-1
+   */
+  long long SendPending(int sock);
+
+  /**
+   * @brief 发送当前文件的内容
+   *
+   * @return long long 发送的字节数, socket已满返回0, 出错返回-1
+   */
+  long long SendBody(int sock);
+
+  BlockingPool* pool_;
+  std::vector<BatchEntry> entries_;
+  int lookahead_;
+  /// @brief 与打开工作共享的状态
+  std::shared_ptr<Shared> shared_;
+
+  /// @brief 下一个要提交打开的文件
+  size_t next_open_ = 0;
+  /// @brief 正在发送的文件序号
+  size_t cursor_ = 0;
+  Stage stage_ = Stage::kHeader;
+  /// @brief 正在发送的文件
+  OpenFilePtr file_;
+  /// @brief 当前文件已发送的内容字节数
+  long long body_pos_ = 0;
+  /// @brief 当前文件在发送期间变短, 剩余部分用0补齐
+  bool zero_fill_ = false;
+  /// @brief 内存中待发送的头部或填充
+  std::string pending_;
+  /// @brief `pending_`中已发送的字节数
+  size_t pending_pos_ = 0;
+
+  bool started_ = false;
+  bool waiting_ = false;
+  bool finished_ = false;
+  BatchDownloadStats stats_;
+};
+
+END_NAMESPACE
+
+#endif  // BATCH_DOWNLOAD_H
@@ -0,0 +1,201 @@
+﻿/**
+ * @file block_cache.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `BlockCache`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "crossocean.h"
+#include "memory_budget.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 缓存块, 保存文件中一个固定大小块的内容(文件最后一块可能较短)
+ */
+struct CROSSOCEAN_API CacheBlock {
+  std::vector<char> data;
+};
+
+/// @brief 缓存块指针, 发送期间持有指针, 即使块被淘汰内容也保持有效
+using CacheBlockPtr = std::shared_ptr<const CacheBlock>;
+
+/**
+ * @brief 缓存统计信息
+ */
+struct CROSSOCEAN_API BlockCacheStats {
+  long long hits = 0;       ///< 命中次数
+  long long misses = 0;     ///< 未命中次数
+  long long inserts = 0;    ///< 插入次数
+  long long evictions = 0;  ///< 淘汰次数
+  long long bytes = 0;      ///< 当前缓存字节数
+
+  /// @brief 命中率(0 ~ 1)
+  double hit_ratio() const {
+    long long total = hits + misses;
+    return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+  }
+};
+
+/**
+ * @brief 分片的文件块缓存
+ *
+ * @details
+ * 文件按`block_size`切分为固定大小的块, 以(文件ID, 块号)为键缓存.
+ * 缓存分为多个分片, 每个分片一把锁, 不同分片的读取互不阻塞.
+ * 每个分片使用`S3-FIFO`淘汰算法: 新块先进入小队列, 在小队列中再次被访问的块
+ * 才会进入主队列, 只访问一次的块(如顺序扫描)很快被淘汰, 不会冲掉热点数据.
+ * 文件ID由调用者决定, 通常由设备号和`inode`计算得到.
+ * 关联内存预算后缓存占用记在预算上, 预算超出时按淘汰顺序释放块
+ */
+class CROSSOCEAN_API BlockCache {
+ public:
+  /**
+   * @brief 构造块缓存
+   *
+   * @param capacity 缓存容量上限(字节)
+   * @param block_size 块大小(字节)
+   * @param shard_count 分片数量
+   */
+  BlockCache(size_t capacity, size_t block_size = 64 * 1024,
+             int shard_count = 16);
+  ~BlockCache();
+
+  /**
+   * @brief 查找缓存块
+   *
+   * @param file_id 文件ID
+   * @param index 块号
+   * @return CacheBlockPtr 缓存块, 未命中返回`nullptr`
+   */
+  CacheBlockPtr Lookup(uint64_t file_id, uint64_t index);
+
+  /**
+   * @brief 插入缓存块, 已存在时替换内容
+   *
+   * @param file_id 文件ID
+   * @param index 块号
+   * @param block 块内容, 大小不能超过`block_size`
+   */
+  void Insert(uint64_t file_id, uint64_t index, CacheBlockPtr block);
+
+  /**
+   * @brief 删除文件的所有缓存块(文件被修改或删除时调用)
+   *
+   * @param file_id 文件ID
+   */
+  void Invalidate(uint64_t file_id);
+
+  /**
+   * @brief 读取文件区间覆盖的缓存块, 未命中的块从文件读取并加入缓存
+   *
+   * @param file_id 文件ID
+   * @param fd 文件描述符
+   * @param offset 区间起始偏移
+   * @param length 区间长度
+   * @param blocks 输出覆盖区间的所有块(按顺序)
+   * @return true 读取成功
+   * @return false 读取文件失败
+   */
+  bool ReadBlocks(uint64_t file_id, int fd, long long offset, long long length,
+                  std::vector<CacheBlockPtr>* blocks);
+
+  /**
+   * @brief 通过缓存把文件区间发送到socket
+   *
+   * @details 直接把缓存块作为`iovec`交给`writev`, 不做额外拷贝.
+   * 一次最多发送64个块, 只读取这些块. 非阻塞socket也可能只发送一部分,
+   * 调用者按返回值推进偏移后重试
+   *
+   * @param sock 目标socket(或管道)
+   * @param file_id 文件ID
+   * @param fd 文件描述符
+   * @param offset 区间起始偏移
+   * @param length 区间长度
+   * @return long long 实际发送的字节数, 出错返回-1
+   */
+  long long Send(int sock, uint64_t file_id, int fd, long long offset,
+                 long long length);
+
+  /**
+   * @brief 获取统计信息
+   *
+   * @return BlockCacheStats 统计信息
+   */
+  BlockCacheStats stats() const;
+
+  /**
+   * @brief 由文件元数据计算文件ID
+   *
+   * @details 混合设备号、inode、修改时间和大小, 文件被替换或修改后ID随之改变,
+   * 旧文件的块不会再被命中, 按淘汰顺序释放
+   *
+   * @param dev 设备号
+   * @param ino inode号
+   * @param mtime_ns 修改时间(纳秒)
+   * @param size 文件大小
+   * @return uint64_t 文件ID
+   */
+  static uint64_t FileId(uint64_t dev, uint64_t ino, long long mtime_ns,
+                         long long size);
+
+  /**
+   * @brief 关联内存预算, 须在使用缓存之前调用
+   *
+   * @param budget 内存预算, 缓存销毁前不能释放
+   */
+  void set_memory_budget(MemoryBudget* budget);
+
+  /**
+   * @brief 淘汰块释放内存, 不改变容量上限
+   *
+   * @param bytes 需要释放的字节数
+   * @return long long 实际释放的字节数
+   */
+  long long Shrink(long long bytes);
+
+  size_t block_size() const { return block_size_; }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  struct Shard;
+
+  /**
+   * @brief 根据键选择分片
+   */
+  Shard* ShardFor(uint64_t file_id, uint64_t index);
+
+  /// @brief 缓存容量上限
+  size_t capacity_;
+  /// @brief 块大小
+  size_t block_size_;
+  /// @brief 缓存分片
+  std::vector<Shard*> shards_;
+
+  std::atomic<long long> hits_{0};
+  std::atomic<long long> misses_{0};
+  std::atomic<long long> inserts_{0};
+  std::atomic<long long> evictions_{0};
+
+  /// @brief 内存预算
+  MemoryBudget* memory_ = nullptr;
+  /// @brief 在内存预算中注册的回收函数编号
+  int reclaimer_id_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // BLOCK_CACHE_H
@@ -0,0 +1,124 @@
+﻿/**
+ * @file blocking_pool.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `BlockingPool`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef BLOCKING_POOL_H
+#define BLOCKING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+class Thread;
+
+/**
+ * @brief 阻塞I/O线程池
+ *
+ * @details
+ * 读整个文件计算签名、`fsync`等会长时间阻塞的操作不能在`Thread`的
+ * 事件循环中执行, 否则同一线程上的所有连接都会停顿.
+ * 这类工作交给`BlockingPool`的工作线程执行, 完成后把回调作为任务投递回
+ * 发起请求的`Thread`, 回调在事件循环线程中执行, 可以直接操作该线程的连接
+ */
+class CROSSOCEAN_API BlockingPool {
+ public:
+  /// @brief 阻塞工作
+  using Work = std::function<void()>;
+  /// @brief 完成回调
+  using Done = std::function<void()>;
+
+  /**
+   * @brief 获取进程内全局的`BlockingPool`对象
+   *
+   * @return BlockingPool* 全局阻塞I/O线程池
+   */
+  static BlockingPool* GetInstance() {
+    static BlockingPool instance;
+    return &instance;
+  }
+
+  BlockingPool() {}
+  ~BlockingPool();
+
+  /**
+   * @brief 启动工作线程
+   *
+   * @param thread_num 工作线程数量
+   */
+  void Init(int thread_num);
+
+  /**
+   * @brief 停止接收新工作, 等待已提交的工作执行完毕后退出工作线程
+   */
+  void Stop();
+
+  /**
+   * @brief 提交阻塞工作
+   *
+   * @param work 在工作线程中执行的阻塞工作
+   * @return true 提交成功
+   * @return false 线程池未启动或已停止
+   */
+  bool Submit(Work work);
+
+  /**
+   * @brief 提交阻塞工作, 完成后在指定线程中执行回调
+   *
+   * @param work 在工作线程中执行的阻塞工作
+   * @param thread 执行回调的线程, 为`nullptr`时在工作线程中直接执行回调
+   * @param done 完成回调
+   * @return true 提交成功
+   * @return false 线程池未启动或已停止
+   */
+  bool Submit(Work work, Thread* thread, Done done);
+
+  /**
+   * @brief 把回调作为高优先级任务投递到线程中执行
+   *
+   * @param thread 执行回调的线程, 为`nullptr`时在当前线程中直接执行
+   * @param done 回调
+   */
+  static void Post(Thread* thread, Done done);
+
+  /**
+   * @brief 获取等待执行的工作数量
+   *
+   * @return int 队列中的工作数量
+   */
+  int pending();
+
+  /// @brief 工作线程数量
+  int thread_num() const { return static_cast<int>(workers_.size()); }
+
+ private:
+  /**
+   * @brief 工作线程入口, 循环取出工作执行
+   */
+  void Main();
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  /// @brief 等待执行的工作
+  std::deque<Work> works_;
+  /// @brief 是否正在停止
+  bool stopping_ = false;
+  /// @brief 工作线程
+  std::vector<std::thread> workers_;
+};
+
+END_NAMESPACE
+
+#endif  // BLOCKING_POOL_H
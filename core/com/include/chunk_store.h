@@ -0,0 +1,151 @@
+﻿/**
+ * @file chunk_store.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ChunkStore`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "chunker.h"
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 内容寻址存储
+ *
+ * @details
+ * 块以SHA-256命名保存在`<root>/chunks/<前2位>/<哈希>`, 相同内容只保存一份.
+ * 文件保存为清单`<root>/manifests/<name>`, 按顺序记录块的哈希和长度.
+ * 上传流程:
+ * 1. 客户端分块并计算哈希, 把哈希列表发给服务器;
+ * 2. 服务器用`Missing`返回尚未保存的块(have/need 交换);
+ * 3. 客户端只发送缺少的块, 服务器`Put`保存;
+ * 4. 服务器`WriteManifest`写入清单.
+ * 线程安全, 块先写入临时文件再重命名, 并发写入同一块不会产生半个文件
+ */
+class CROSSOCEAN_API ChunkStore {
+ public:
+  /**
+   * @brief 构造内容寻址存储
+   *
+   * @param root 存储根目录
+   */
+  explicit ChunkStore(const std::string& root);
+
+  /**
+   * @brief 创建存储目录
+   *
+   * @return true 成功
+   * @return false 创建目录失败
+   */
+  bool Init();
+
+  /**
+   * @brief 判断块是否已保存
+   *
+   * @param hash 块哈希
+   */
+  bool Has(const std::string& hash) const;
+
+  /**
+   * @brief 返回需要客户端发送的块(去重, 保持原顺序)
+   *
+   * @param hashes 客户端文件的块哈希列表
+   * @return std::vector<std::string> 尚未保存的块哈希
+   */
+  std::vector<std::string> Missing(const std::vector<std::string>& hashes);
+
+  /**
+   * @brief 保存块, 校验内容与哈希一致, 已存在时直接返回
+   *
+   * @param hash 块哈希
+   * @param data 块内容
+   * @param len 块长度
+   * @return true 保存成功或已存在
+   * @return false 哈希不匹配或写入失败
+   */
+  bool Put(const std::string& hash, const char* data, size_t len);
+
+  /**
+   * @brief 读取块
+   *
+   * @param hash 块哈希
+   * @param data 输出块内容
+   * @return true 成功
+   * @return false 块不存在
+   */
+  bool Get(const std::string& hash, std::string* data) const;
+
+  /**
+   * @brief 写入文件清单, 清单引用的块必须都已保存
+   *
+   * @param name 文件名(相对路径)
+   * @param chunks 按顺序排列的块
+   * @return true 成功
+   * @return false 名称非法、缺少块或写入失败
+   */
+  bool WriteManifest(const std::string& name,
+                     const std::vector<ChunkRef>& chunks);
+
+  /**
+   * @brief 读取文件清单
+   *
+   * @param name 文件名(相对路径)
+   * @param chunks 输出按顺序排列的块(包含偏移)
+   * @return true 成功
+   * @return false 清单不存在或格式错误
+   */
+  bool ReadManifest(const std::string& name, std::vector<ChunkRef>* chunks);
+
+  /**
+   * @brief 按清单还原文件
+   *
+   * @param name 文件名(相对路径)
+   * @param out_path 输出文件路径
+   * @return true 成功
+   * @return false 清单或块缺失
+   */
+  bool Restore(const std::string& name, const std::string& out_path);
+
+  /**
+   * @brief 块文件路径
+   *
+   * @param hash 块哈希
+   */
+  std::string ChunkPath(const std::string& hash) const;
+
+  /// @brief 实际写入的块字节数
+  long long stored_bytes() const { return stored_bytes_; }
+  /// @brief 因块已存在而省去写入的字节数
+  long long dedup_bytes() const { return dedup_bytes_; }
+
+ private:
+  /**
+   * @brief 校验块哈希格式(64个十六进制字符), 防止路径穿越
+   */
+  static bool ValidHash(const std::string& hash);
+
+  /**
+   * @brief 校验清单名称, 不允许绝对路径和`..`
+   */
+  static bool ValidName(const std::string& name);
+
+  std::string root_;
+  std::atomic<long long> stored_bytes_{0};
+  std::atomic<long long> dedup_bytes_{0};
+  /// @brief 临时文件序号
+  std::atomic<long long> temp_seq_{0};
+};
+
+END_NAMESPACE
+
+#endif  // CHUNK_STORE_H
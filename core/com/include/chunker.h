@@ -0,0 +1,135 @@
+﻿/**
+ * @file chunker.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Chunker`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 分块方式
+ */
+enum class ChunkMode {
+  kFixed,    ///< 固定大小分块
+  kFastCdc,  ///< FastCDC 内容定义分块, 插入删除只影响附近的块
+};
+
+/**
+ * @brief 文件中的一个块
+ */
+struct CROSSOCEAN_API ChunkRef {
+  /// @brief 块内容的SHA-256(十六进制)
+  std::string hash;
+  /// @brief 块在文件中的偏移
+  long long offset = 0;
+  /// @brief 块长度
+  size_t length = 0;
+};
+
+/**
+ * @brief 流式分块器
+ *
+ * @details
+ * 上传数据分段输入`Update`, 每切出一个完整的块就回调一次, 回调中给出块的
+ * 描述和内容. 内容定义分块使用`FastCDC`的规范化分块: 平均大小之前使用较严格的
+ * 掩码, 之后使用较宽松的掩码, 块大小集中在平均值附近
+ */
+class CROSSOCEAN_API Chunker {
+ public:
+  /**
+   * @brief 块回调
+   *
+   * @param chunk 块描述
+   * @param data 块内容
+   */
+  using ChunkCallback =
+      std::function<void(const ChunkRef& chunk, const char* data)>;
+
+  /**
+   * @brief 构造分块器
+   *
+   * @param mode 分块方式
+   * @param avg_size 平均块大小(固定分块时为块大小), 取整到2的幂
+   */
+  Chunker(ChunkMode mode, size_t avg_size = 64 * 1024);
+
+  /**
+   * @brief 输入数据
+   *
+   * @param data 数据
+   * @param len 数据长度
+   * @param callback 块回调
+   */
+  void Update(const char* data, size_t len, const ChunkCallback& callback);
+
+  /**
+   * @brief 输入结束, 切出剩余数据
+   *
+   * @param callback 块回调
+   */
+  void Finish(const ChunkCallback& callback);
+
+  /**
+   * @brief 对完整数据分块
+   *
+   * @param mode 分块方式
+   * @param avg_size 平均块大小
+   * @param data 数据
+   * @param len 数据长度
+   * @return std::vector<ChunkRef> 块列表
+   */
+  static std::vector<ChunkRef> Split(ChunkMode mode, size_t avg_size,
+                                     const char* data, size_t len);
+
+  size_t min_size() const { return min_size_; }
+  size_t avg_size() const { return avg_size_; }
+  size_t max_size() const { return max_size_; }
+
+ private:
+  /**
+   * @brief 查找块边界
+   *
+   * @param data 数据
+   * @param len 数据长度
+   * @return size_t 第一个块的长度
+   */
+  size_t FindBoundary(const unsigned char* data, size_t len) const;
+
+  /**
+   * @brief 切出`pending_`中未切出部分头部的一个块
+   */
+  void Emit(size_t len, const ChunkCallback& callback);
+
+  ChunkMode mode_;
+  size_t min_size_;
+  size_t avg_size_;
+  size_t max_size_;
+  /// @brief 平均大小之前使用的掩码(较严格)
+  unsigned long long mask_small_;
+  /// @brief 平均大小之后使用的掩码(较宽松)
+  unsigned long long mask_large_;
+
+  /// @brief 尚未切出的数据
+  std::string pending_;
+  /// @brief `pending_`头部已经切出的字节数
+  size_t consumed_ = 0;
+  /// @brief 下一个块在文件中的偏移
+  long long offset_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // CHUNKER_H
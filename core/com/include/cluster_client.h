@@ -0,0 +1,112 @@
+﻿/**
+ * @file cluster_client.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ClusterClient`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef CLUSTER_CLIENT_H
+#define CLUSTER_CLIENT_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "crossocean.h"
+#include "shard_map.h"
+
+CROSSOCEAN_NAMESPACE
+
+class ChainClient;
+
+/**
+ * @brief 集群客户端(阻塞)
+ *
+ * @details
+ * 从任一节点获取分片表后按路径直接访问归属节点, 每个节点保持一个连接.
+ * 请求被重定向时采用节点返回的更新的分片表并重试. 再平衡期间文件可能
+ * 还在旧的归属节点上, 读取时依次尝试新旧分片表中的节点
+ */
+class CROSSOCEAN_API ClusterClient {
+ public:
+  ClusterClient();
+  ~ClusterClient();
+
+  /**
+   * @brief 从种子节点获取分片表
+   *
+   * @param seed 任一节点地址(`IP:端口`)
+   * @return true 成功
+   * @return false 连接失败或节点没有分片表
+   */
+  bool Connect(const std::string& seed);
+
+  /**
+   * @brief 写入文件到归属节点(按分片表的副本链)
+   *
+   * @param path 相对根目录的文件路径
+   * @param data 文件内容
+   * @param len 文件大小
+   * @return true 所有副本已提交
+   * @return false 失败
+   */
+  bool Put(const std::string& path, const char* data, size_t len);
+
+  /**
+   * @brief 从归属节点读取文件
+   *
+   * @param path 相对根目录的文件路径
+   * @param data 输出文件内容
+   * @return true 成功
+   * @return false 文件不存在或节点不可用
+   */
+  bool Get(const std::string& path, std::string* data);
+
+  /**
+   * @brief 发布新的分片表: 发给新旧分片表中的所有节点
+   *
+   * @param map 分片表, 版本需比当前的新
+   * @return true 所有节点都已接受
+   * @return false 有节点不可用或拒绝
+   */
+  bool Publish(const ShardMap& map);
+
+  /// @brief 当前分片表
+  const ShardMap& map() const { return map_; }
+  /// @brief 被重定向的次数
+  long long redirects() const { return redirects_; }
+
+ private:
+  /**
+   * @brief 获取到节点的连接, 断开时重新连接
+   */
+  ChainClient* Client(const std::string& address);
+
+  /**
+   * @brief 采用更新的分片表, 保留上一版用于读取
+   *
+   * @return true 分片表比当前的新
+   */
+  bool Adopt(const ShardMap& map);
+
+  /**
+   * @brief 处理重定向
+   *
+   * @return true 采用了节点返回的更新的分片表
+   */
+  bool OnRedirect(const std::string& encoded);
+
+  ShardMap map_;
+  /// @brief 上一版分片表
+  ShardMap previous_;
+  /// @brief 到各节点的连接
+  std::map<std::string, std::unique_ptr<ChainClient>> clients_;
+  long long redirects_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // CLUSTER_CLIENT_H
@@ -0,0 +1,243 @@
+﻿/**
+ * @file compression.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief 传输压缩相关类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "crossocean.h"
+#include "rate_limiter.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 压缩算法
+ */
+enum class CompressionCodec {
+  kNone,  ///< 不压缩
+  kZlib,  ///< zlib(deflate)
+  kZstd,  ///< zstd(可选依赖, 编译时找到 zstd 才可用)
+};
+
+/**
+ * @brief 压缩算法的协商和内容探测
+ */
+class CROSSOCEAN_API Compression {
+ public:
+  /**
+   * @brief 获取算法名称
+   *
+   * @param codec 压缩算法
+   * @return const char* 名称("none"、"zlib"、"zstd")
+   */
+  static const char* CodecName(CompressionCodec codec);
+
+  /**
+   * @brief 按名称解析算法
+   *
+   * @param name 算法名称
+   * @param codec 输出压缩算法
+   * @return true 解析成功
+   * @return false 未知的名称
+   */
+  static bool ParseCodec(const std::string& name, CompressionCodec* codec);
+
+  /**
+   * @brief 当前编译版本是否支持该算法
+   */
+  static bool Available(CompressionCodec codec);
+
+  /**
+   * @brief 本端支持的算法列表, 按优先顺序以逗号分隔(如"zstd,zlib")
+   */
+  static std::string Supported();
+
+  /**
+   * @brief 协商压缩算法
+   *
+   * @details 按对端给出的顺序选择第一个本端也支持的算法
+   *
+   * @param offered 对端支持的算法列表(逗号分隔)
+   * @return CompressionCodec 选中的算法, 没有共同算法时为`kNone`
+   */
+  static CompressionCodec Negotiate(const std::string& offered);
+
+  /**
+   * @brief 根据内容样本判断是否值得压缩
+   *
+   * @details
+   * 识别常见压缩格式(gzip、zstd、zip、xz、bzip2、7z、jpeg、png等)的文件头,
+   * 并估计样本的字节熵, 熵接近8比特/字节的内容(已压缩或已加密)不再压缩
+   *
+   * @param sample 内容样本(通常取开头几KB)
+   * @param len 样本长度
+   * @return true 值得压缩
+   * @return false 已压缩的内容
+   */
+  static bool LooksCompressible(const char* sample, size_t len);
+};
+
+/**
+ * @brief 压缩工作预算
+ *
+ * @details
+ * 压缩消耗CPU, 限制同时进行压缩的数量和每秒压缩的字节数,
+ * 避免压缩占满事件循环线程影响其它连接的I/O. 预算不足时数据块直接以原文发送,
+ * 而不是排队等待
+ */
+class CROSSOCEAN_API CompressionBudget {
+ public:
+  /**
+   * @brief 构造压缩预算
+   *
+   * @param max_workers 同时进行压缩的最大数量, 小于等于0表示不限制
+   * @param bytes_per_second 每秒最多压缩的字节数, 小于等于0表示不限制
+   */
+  CompressionBudget(int max_workers, long long bytes_per_second = 0);
+
+  /**
+   * @brief 申请压缩`bytes`字节
+   *
+   * @param bytes 要压缩的字节数
+   * @return true 申请成功, 压缩完成后调用`Release`
+   * @return false 预算不足, 应发送原文
+   */
+  bool TryAcquire(size_t bytes);
+
+  /**
+   * @brief 归还一个压缩名额
+   */
+  void Release();
+
+  /// @brief 因预算不足而未压缩的次数
+  long long skipped_count() const { return skipped_; }
+
+ private:
+  int max_workers_;
+  std::atomic<int> active_{0};
+  /// @brief 压缩字节数令牌桶
+  TokenBucket bytes_;
+  std::atomic<long long> skipped_{0};
+};
+
+/**
+ * @brief 数据块压缩器(发送端)
+ *
+ * @details
+ * 每个数据块独立压缩(复用压缩上下文), 输出带帧头的数据:
+ * 类型(1字节, 'R'原文 / 'Z'压缩) 原文长度(4字节) 负载长度(4字节) 负载.
+ * 每个块可以单独选择是否压缩: 第一个块探测到已压缩的内容后整个传输不再压缩,
+ * 压缩预算不足或压缩后没有变小的块以原文发送. 对端用`ChunkDecoder`解码
+ */
+class CROSSOCEAN_API ChunkEncoder {
+ public:
+  /**
+   * @brief 构造压缩器
+   *
+   * @param codec 协商得到的压缩算法
+   * @param level 压缩级别, 0为算法默认级别
+   * @param budget 压缩预算, 为`nullptr`时不限制
+   */
+  ChunkEncoder(CompressionCodec codec, int level = 0,
+               CompressionBudget* budget = nullptr);
+  ~ChunkEncoder();
+
+  /**
+   * @brief 编码一个数据块
+   *
+   * @param data 数据块
+   * @param len 数据块长度, 不能超过`kMaxChunkSize`
+   * @param out 输出缓冲区(追加), 可以复用以减少内存分配
+   * @return true 成功
+   * @return false 数据块过大或压缩出错
+   */
+  bool Encode(const char* data, size_t len, std::string* out);
+
+  /// @brief 是否因内容已压缩而停止压缩
+  bool bypassed() const { return bypassed_; }
+  /// @brief 输入的原文字节数
+  long long raw_bytes() const { return raw_bytes_; }
+  /// @brief 输出的字节数(含帧头)
+  long long encoded_bytes() const { return encoded_bytes_; }
+
+  /// @brief 单个数据块的最大长度
+  static constexpr size_t kMaxChunkSize = 16 * 1024 * 1024;
+  /// @brief 帧头长度
+  static constexpr size_t kHeaderSize = 9;
+
+ private:
+  struct Context;
+
+  /**
+   * @brief 压缩数据块, 输出追加到`out`
+   *
+   * @return true 压缩成功
+   */
+  bool Compress(const char* data, size_t len, std::string* out);
+
+  CompressionCodec codec_;
+  int level_;
+  CompressionBudget* budget_;
+  std::unique_ptr<Context> context_;
+  /// @brief 是否已经探测过内容
+  bool probed_ = false;
+  bool bypassed_ = false;
+  long long raw_bytes_ = 0;
+  long long encoded_bytes_ = 0;
+};
+
+/**
+ * @brief 数据块解压器(接收端)
+ */
+class CROSSOCEAN_API ChunkDecoder {
+ public:
+  /**
+   * @brief 构造解压器
+   *
+   * @param codec 协商得到的压缩算法
+   */
+  explicit ChunkDecoder(CompressionCodec codec);
+  ~ChunkDecoder();
+
+  /**
+   * @brief 输入编码数据(可以按任意边界分段输入)
+   *
+   * @param data 编码数据
+   * @param len 数据长度
+   * @param out 输出解码后的原文(追加)
+   * @return true 成功
+   * @return false 格式错误或解压出错
+   */
+  bool Feed(const char* data, size_t len, std::string* out);
+
+  /// @brief 是否有未解码完的数据
+  bool pending() const { return !buffer_.empty(); }
+
+ private:
+  struct Context;
+
+  /**
+   * @brief 解压一个压缩帧的负载
+   */
+  bool Decompress(const char* data, size_t len, size_t raw_len,
+                  std::string* out);
+
+  CompressionCodec codec_;
+  std::unique_ptr<Context> context_;
+  /// @brief 未解码完的数据
+  std::string buffer_;
+};
+
+END_NAMESPACE
+
+#endif  // COMPRESSION_H
@@ -0,0 +1,168 @@
+﻿/**
+ * @file crc32c.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Crc32c`和`ChunkCrc`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief CRC32C(Castagnoli) 校验和
+ *
+ * @details
+ * 运行时检测CPU特性选择实现: 支持SSE4.2的x86 CPU使用`crc32`指令,
+ * 三路交错计算以隐藏指令延迟; 其它平台使用按8字节查表的软件实现
+ */
+class CROSSOCEAN_API Crc32c {
+ public:
+  /**
+   * @brief 在已有校验和基础上继续计算
+   *
+   * @param crc 之前数据的校验和(初始为0)
+   * @param data 数据
+   * @param len 数据长度
+   * @return uint32_t 包含新数据的校验和
+   */
+  static uint32_t Extend(uint32_t crc, const void* data, size_t len);
+
+  /**
+   * @brief 计算数据的校验和
+   *
+   * @param data 数据
+   * @param len 数据长度
+   * @return uint32_t 校验和
+   */
+  static uint32_t Value(const void* data, size_t len) {
+    return Extend(0, data, len);
+  }
+
+  /**
+   * @brief 软件实现(用于测试和没有硬件支持的平台)
+   */
+  static uint32_t ExtendPortable(uint32_t crc, const void* data, size_t len);
+
+  /**
+   * @brief 当前使用的实现名称
+   *
+   * @return const char* "sse4.2" 或 "portable"
+   */
+  static const char* Backend();
+
+  /**
+   * @brief 流式输入数据
+   *
+   * @param data 数据
+   * @param len 数据长度
+   */
+  void Update(const void* data, size_t len) { crc_ = Extend(crc_, data, len); }
+
+  /**
+   * @brief 获取当前校验和
+   */
+  uint32_t value() const { return crc_; }
+
+  /**
+   * @brief 重新开始计算
+   */
+  void Reset() { crc_ = 0; }
+
+ private:
+  uint32_t crc_ = 0;
+};
+
+/**
+ * @brief 按固定大小分块计算校验和, 结果可以保存在文件旁边
+ *
+ * @details
+ * 上传和下载路径把经过的数据依次输入`Update`, 每满`chunk_size`字节得到一个
+ * 块校验和. 校验和文件格式为文本: 第一行`crc32c <块大小> <文件大小>`,
+ * 之后每行一个块的十六进制校验和
+ */
+class CROSSOCEAN_API ChunkCrc {
+ public:
+  /**
+   * @brief 构造分块校验
+   *
+   * @param chunk_size 块大小
+   */
+  explicit ChunkCrc(size_t chunk_size = 1024 * 1024);
+
+  /**
+   * @brief 输入数据
+   *
+   * @param data 数据
+   * @param len 数据长度
+   */
+  void Update(const void* data, size_t len);
+
+  /**
+   * @brief 输入结束, 保存最后一个不完整的块
+   */
+  void Finish();
+
+  /**
+   * @brief 校验和文件路径
+   *
+   * @param path 数据文件路径
+   * @return std::string 校验和文件路径(`<path>.crc32c`)
+   */
+  static std::string SidecarPath(const std::string& path);
+
+  /**
+   * @brief 保存校验和文件
+   *
+   * @param path 校验和文件路径
+   * @return true 成功
+   * @return false 写入失败
+   */
+  bool Save(const std::string& path) const;
+
+  /**
+   * @brief 读取校验和文件
+   *
+   * @param path 校验和文件路径
+   * @return true 成功
+   * @return false 文件不存在或格式错误
+   */
+  bool Load(const std::string& path);
+
+  /**
+   * @brief 比较两组校验和
+   *
+   * @param other 另一组校验和
+   * @return long long 第一个不一致的块号, 完全一致返回-1
+   */
+  long long FirstMismatch(const ChunkCrc& other) const;
+
+  size_t chunk_size() const { return chunk_size_; }
+  long long total_size() const { return total_size_; }
+  const std::vector<uint32_t>& crcs() const { return crcs_; }
+
+ private:
+  size_t chunk_size_;
+  /// @brief 当前块已输入的字节数
+  size_t filled_ = 0;
+  /// @brief 当前块的校验和
+  uint32_t current_ = 0;
+  /// @brief 已输入的总字节数
+  long long total_size_ = 0;
+  /// @brief 每个块的校验和
+  std::vector<uint32_t> crcs_;
+};
+
+END_NAMESPACE
+
+#endif  // CRC32C_H
@@ -0,0 +1,368 @@
+﻿/**
+ * @file delta_sync.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief 增量同步(`rsync`算法)相关类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef DELTA_SYNC_H
+#define DELTA_SYNC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+class BlockingPool;
+class Thread;
+
+/**
+ * @brief `rsync`弱校验和, 窗口滑动一个字节时可以O(1)更新
+ */
+class CROSSOCEAN_API RollingChecksum {
+ public:
+  /**
+   * @brief 重新计算窗口的校验和
+   *
+   * @param data 窗口数据
+   * @param len 窗口长度
+   */
+  void Reset(const char* data, size_t len);
+
+  /**
+   * @brief 窗口向后滑动一个字节
+   *
+   * @param out 移出窗口的字节
+   * @param in 移入窗口的字节
+   */
+  void Roll(char out, char in);
+
+  /// @brief 当前校验和
+  uint32_t value() const { return (b_ << 16) | (a_ & 0xffff); }
+
+ private:
+  uint32_t a_ = 0;
+  uint32_t b_ = 0;
+  /// @brief 窗口长度
+  uint32_t len_ = 0;
+};
+
+/**
+ * @brief 基准文件中一个块的签名
+ */
+struct CROSSOCEAN_API BlockSignature {
+  /// @brief 弱校验和
+  uint32_t weak = 0;
+  /// @brief 强校验和(SHA-256的前`kStrongSize`字节)
+  std::string strong;
+};
+
+/**
+ * @brief 基准文件的签名, 由服务器计算后发送给客户端
+ */
+struct CROSSOCEAN_API FileSignature {
+  /// @brief 强校验和长度
+  static const size_t kStrongSize = 16;
+
+  /// @brief 块大小
+  uint32_t block_size = 0;
+  /// @brief 文件大小
+  long long file_size = 0;
+  /// @brief 所有块的签名, 最后一块可能较短
+  std::vector<BlockSignature> blocks;
+
+  /**
+   * @brief 根据文件大小选择块大小(约为文件大小的平方根)
+   *
+   * @param file_size 文件大小
+   * @return uint32_t 块大小
+   */
+  static uint32_t DefaultBlockSize(long long file_size);
+
+  /**
+   * @brief 计算强校验和
+   *
+   * @param data 数据
+   * @param len 数据长度
+   * @return std::string 强校验和
+   */
+  static std::string StrongSum(const char* data, size_t len);
+
+  /**
+   * @brief 读取文件计算签名(阻塞)
+   *
+   * @param fd 文件描述符
+   * @param block_size 块大小, 0为按文件大小选择
+   * @param signature 输出签名
+   * @return true 计算成功
+   * @return false 读取文件失败
+   */
+  static bool Compute(int fd, uint32_t block_size, FileSignature* signature);
+
+  /**
+   * @brief 在阻塞I/O线程池中计算签名, 完成后在`thread`中回调
+   *
+   * @param pool 阻塞I/O线程池
+   * @param path 文件路径
+   * @param block_size 块大小, 0为按文件大小选择
+   * @param thread 执行回调的线程
+   * @param done 完成回调, 失败时签名为`nullptr`
+   * @return true 已提交
+   * @return false 提交失败
+   */
+  static bool ComputeAsync(
+      BlockingPool* pool, const std::string& path, uint32_t block_size,
+      Thread* thread,
+      std::function<void(std::shared_ptr<FileSignature>)> done);
+
+  /**
+   * @brief 编码为网络格式
+   *
+   * @param out 输出缓冲区(追加)
+   */
+  void Serialize(std::string* out) const;
+
+  /**
+   * @brief 从网络格式解码
+   *
+   * @param data 编码数据
+   * @return true 解码成功
+   * @return false 数据格式错误
+   */
+  bool Parse(const std::string& data);
+
+  /**
+   * @brief 获取第`index`块的长度
+   */
+  size_t BlockLength(size_t index) const;
+};
+
+/**
+ * @brief 增量指令类型
+ */
+enum class DeltaOpType {
+  kCopy,     ///< 复制基准文件中的一段数据
+  kLiteral,  ///< 写入新数据
+};
+
+/**
+ * @brief 增量指令
+ */
+struct CROSSOCEAN_API DeltaOp {
+  DeltaOpType type = DeltaOpType::kLiteral;
+  /// @brief 复制指令: 基准文件中的偏移
+  long long offset = 0;
+  /// @brief 复制指令: 复制长度
+  long long length = 0;
+  /// @brief 新数据指令: 数据
+  std::string data;
+
+  /**
+   * @brief 编码为网络格式
+   *
+   * @param out 输出缓冲区(追加)
+   */
+  void Encode(std::string* out) const;
+};
+
+/**
+ * @brief 增量生成器(客户端)
+ *
+ * @details
+ * 根据服务器发来的基准文件签名, 流式扫描新文件内容: 窗口的弱校验和命中后
+ * 再比较强校验和, 匹配则输出复制指令并跳过整块, 否则窗口滑动一个字节,
+ * 移出的字节作为新数据. 相邻的复制指令合并为一条
+ */
+class CROSSOCEAN_API DeltaGenerator {
+ public:
+  /**
+   * @brief 指令回调
+   *
+   * @param op 增量指令
+   * @return true 继续
+   * @return false 中止生成
+   */
+  using OpCallback = std::function<bool(const DeltaOp& op)>;
+
+  /**
+   * @brief 构造增量生成器
+   *
+   * @param signature 基准文件签名
+   * @param callback 指令回调
+   */
+  DeltaGenerator(const FileSignature& signature, OpCallback callback);
+
+  /**
+   * @brief 输入新文件数据
+   *
+   * @param data 数据
+   * @param len 数据长度
+   * @return true 成功
+   * @return false 指令回调中止
+   */
+  bool Update(const char* data, size_t len);
+
+  /**
+   * @brief 输入结束, 输出剩余指令
+   *
+   * @return true 成功
+   * @return false 指令回调中止
+   */
+  bool Finish();
+
+  /// @brief 复制指令覆盖的字节数
+  long long copied_bytes() const { return copied_bytes_; }
+  /// @brief 新数据字节数
+  long long literal_bytes() const { return literal_bytes_; }
+
+ private:
+  /**
+   * @brief 查找与窗口内容相同的基准块
+   *
+   * @param data 窗口数据
+   * @return long long 块号, 没有匹配返回-1
+   */
+  long long FindBlock(const char* data);
+
+  /**
+   * @brief 输出复制指令(与上一条复制指令相邻时合并)
+   */
+  void EmitCopy(long long offset, long long length);
+
+  /// @brief 输出缓存的复制指令
+  void FlushCopy();
+  /// @brief 输出缓存的新数据(先输出之前的复制指令)
+  void FlushLiteral();
+  /// @brief 调用指令回调
+  void Emit(const DeltaOp& op);
+
+  const FileSignature& signature_;
+  OpCallback callback_;
+  /// @brief 弱校验和 -> 块号(只包含完整块)
+  std::unordered_map<uint32_t, std::vector<uint32_t>> index_;
+
+  /// @brief 未处理的输入数据
+  std::string pending_;
+  /// @brief 窗口在`pending_`中的起始位置
+  size_t pos_ = 0;
+  RollingChecksum rolling_;
+  /// @brief `rolling_`是否对应当前窗口
+  bool rolling_valid_ = false;
+  /// @brief 上一次匹配的块号, 优先匹配其后一块
+  long long last_block_ = -1;
+
+  /// @brief 缓存的新数据
+  std::string literal_;
+  /// @brief 缓存的复制指令
+  long long copy_offset_ = 0;
+  long long copy_length_ = 0;
+
+  bool aborted_ = false;
+  long long copied_bytes_ = 0;
+  long long literal_bytes_ = 0;
+};
+
+/**
+ * @brief 增量重建器(服务器)
+ *
+ * @details
+ * 按增量指令重建文件: 复制指令使用`copy_file_range`在内核中直接从基准文件复制
+ * (文件系统支持时共享数据块, 不发生拷贝), 新数据直接写入. 新文件先写入临时文件,
+ * `Finish`时替换原文件, 中途失败不影响原文件
+ */
+class CROSSOCEAN_API DeltaPatcher {
+ public:
+  /**
+   * @brief 构造增量重建器
+   *
+   * @param path 要更新的文件路径(同时是基准文件)
+   */
+  explicit DeltaPatcher(const std::string& path);
+  ~DeltaPatcher();
+
+  /**
+   * @brief 打开基准文件并创建临时文件
+   *
+   * @details 基准文件不存在时只接受新数据指令
+   *
+   * @return true 成功
+   * @return false 创建临时文件失败
+   */
+  bool Open();
+
+  /**
+   * @brief 执行一条增量指令
+   *
+   * @param op 增量指令
+   * @return true 成功
+   * @return false 指令越界或写入失败
+   */
+  bool Apply(const DeltaOp& op);
+
+  /**
+   * @brief 输入网络格式的增量指令流(可以分段输入)
+   *
+   * @param data 数据
+   * @param len 数据长度
+   * @return true 成功
+   * @return false 格式错误或执行失败
+   */
+  bool Feed(const char* data, size_t len);
+
+  /**
+   * @brief 完成重建, 用新文件替换原文件
+   *
+   * @return true 成功
+   * @return false 指令流不完整或替换失败
+   */
+  bool Finish();
+
+  /**
+   * @brief 放弃重建, 删除临时文件
+   */
+  void Abort();
+
+  /// @brief 从基准文件复制的字节数
+  long long copied_bytes() const { return copied_bytes_; }
+  /// @brief 写入的新数据字节数
+  long long literal_bytes() const { return literal_bytes_; }
+
+ private:
+  /**
+   * @brief 从基准文件复制数据到临时文件
+   */
+  bool CopyRange(long long offset, long long length);
+
+  /**
+   * @brief 写入数据到临时文件
+   */
+  bool Write(const char* data, size_t len);
+
+  std::string path_;
+  std::string temp_path_;
+  int basis_fd_ = -1;
+  int out_fd_ = -1;
+  /// @brief 基准文件大小
+  long long basis_size_ = 0;
+  /// @brief 临时文件当前写入偏移
+  long long out_offset_ = 0;
+
+  /// @brief `Feed`中未解码完的数据
+  std::string buffer_;
+
+  long long copied_bytes_ = 0;
+  long long literal_bytes_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // DELTA_SYNC_H
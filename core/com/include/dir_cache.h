@@ -0,0 +1,261 @@
+﻿/**
+ * @file dir_cache.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `DirCache`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef DIR_CACHE_H
+#define DIR_CACHE_H
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 目录项
+ */
+struct CROSSOCEAN_API DirEntry {
+  /// @brief 名称
+  std::string name;
+  /// @brief 是否为目录
+  bool is_dir = false;
+  /// @brief 文件大小, 目录为0
+  long long size = 0;
+  /// @brief 修改时间(纳秒)
+  long long mtime_ns = 0;
+};
+
+/**
+ * @brief 一页目录列表
+ */
+struct CROSSOCEAN_API DirPage {
+  /// @brief protobuf编码的`Listing`消息, 可以直接发送
+  std::string data;
+  /// @brief 本页的目录项数量
+  int count = 0;
+  /// @brief 下一页的游标, 已是最后一页时为空
+  std::string next_cursor;
+};
+
+/**
+ * @brief 缓存统计信息
+ */
+struct CROSSOCEAN_API DirCacheStats {
+  long long hits = 0;           ///< 命中次数
+  long long loads = 0;          ///< 读取目录(`readdir`+`stat`)次数
+  long long updates = 0;        ///< 增量更新目录项的次数
+  long long invalidations = 0;  ///< 整个目录失效的次数
+  long long evictions = 0;      ///< 因目录数量上限淘汰的次数
+  int cached = 0;               ///< 当前缓存的目录数
+};
+
+/**
+ * @brief 目录列表缓存
+ *
+ * @details
+ * 每次列目录都`readdir`并逐项`stat`, 对大目录代价很高.
+ * `DirCache`按目录缓存已序列化的列表: 每个目录项预先编码为protobuf的
+ * `Listing.entries`字段, 按名称(字节序)排序保存, 分页时直接拼接:
+ * @code
+ * message Entry {
+ *   string name = 1;
+ *   bool is_dir = 2;
+ *   uint64 size = 3;
+ *   int64 mtime_ns = 4;
+ * }
+ * message Listing {
+ *   repeated Entry entries = 1;
+ *   string next_cursor = 2;
+ * }
+ * @endcode
+ * 游标是上一页最后一项的名称, 下一页从名称大于游标的项开始,
+ * 翻页期间有文件增删也不会重复或遗漏未改变的项.
+ * 缓存的维护:
+ * - 服务器自己上传或删除文件后调用`OnWrite`/`OnRemove`, 只重新`stat`
+ *   路径上的各级目录项;
+ * - 其它进程的修改: Linux上对缓存的目录添加inotify监视, 事件循环在`fd()`
+ *   可读时调用`ProcessEvents`按事件更新目录项, 事件队列溢出时清空缓存;
+ *   没有inotify时每次列目录检查目录的修改时间, 变化则重新读取.
+ * 缓存的目录数量不超过`max_dirs`, 超出时淘汰最久未使用的目录. 线程安全
+ */
+class CROSSOCEAN_API DirCache {
+ public:
+  /**
+   * @brief 构造目录列表缓存
+   *
+   * @param root 根目录, 列表请求的路径都相对于该目录
+   * @param max_dirs 缓存的目录数量上限
+   */
+  DirCache(const std::string& root, int max_dirs = 1024);
+
+  /**
+   * @brief 关闭inotify
+   */
+  ~DirCache();
+
+  /**
+   * @brief 初始化inotify(非Linux系统或初始化失败时改为检查目录修改时间)
+   *
+   * @return true 已启用inotify
+   * @return false 未启用inotify
+   */
+  bool Init();
+
+  /// @brief inotify文件描述符(非阻塞), 未启用时为-1
+  int fd() const { return inotify_fd_; }
+
+  /**
+   * @brief 列出目录, 优先使用缓存
+   *
+   * @param dir 相对根目录的目录路径, 空为根目录
+   * @param cursor 上一页返回的游标, 空为第一页
+   * @param limit 每页最多的目录项数量, 小于等于0为不分页
+   * @param page 输出的一页列表
+   * @return true 成功
+   * @return false 路径非法或目录不存在
+   */
+  bool List(const std::string& dir, const std::string& cursor, int limit,
+            DirPage* page);
+
+  /**
+   * @brief 服务器写入文件或创建目录后更新缓存
+   *
+   * @details 更新所在目录中的目录项, 新创建的上级目录也加入其父目录的列表
+   *
+   * @param path 相对根目录的路径
+   */
+  void OnWrite(const std::string& path);
+
+  /**
+   * @brief 服务器删除文件或目录后更新缓存
+   *
+   * @param path 相对根目录的路径
+   */
+  void OnRemove(const std::string& path);
+
+  /**
+   * @brief 处理inotify中所有待处理的事件(在`fd()`可读时调用)
+   *
+   * @return int 处理的事件数量
+   */
+  int ProcessEvents();
+
+  /**
+   * @brief 使目录的缓存失效
+   *
+   * @param dir 相对根目录的目录路径
+   */
+  void Invalidate(const std::string& dir);
+
+  /**
+   * @brief 解码`Listing`消息(供客户端和测试使用)
+   *
+   * @param data protobuf编码的`Listing`消息
+   * @param entries 输出目录项
+   * @param next_cursor 输出下一页的游标
+   * @return true 成功
+   * @return false 格式错误
+   */
+  static bool Decode(const std::string& data, std::vector<DirEntry>* entries,
+                     std::string* next_cursor);
+
+  /// @brief 统计信息
+  DirCacheStats stats();
+
+ private:
+  using LruList = std::list<std::string>;
+
+  /// @brief 一个目录的缓存
+  struct Listing {
+    /// @brief 名称到编码后的`entries`字段
+    std::map<std::string, std::string> entries;
+    /// @brief inotify监视描述符, 未监视时为-1
+    int wd = -1;
+    /// @brief 读取时目录的修改时间, 未监视时用于检查外部修改
+    long long mtime_ns = 0;
+    /// @brief 在最近使用顺序中的位置
+    LruList::iterator lru;
+  };
+
+  /// @brief 正在读取的目录
+  struct Loading {
+    /// @brief 读取该目录的线程数
+    int loaders = 0;
+    /// @brief 读取期间目录发生过修改, 结果不放入缓存
+    bool dirty = false;
+  };
+
+  /**
+   * @brief 规范化相对路径(去掉多余的`/`和`.`)
+   *
+   * @param path 相对路径
+   * @param normalized 输出规范化的路径, 根目录为空
+   * @return true 成功
+   * @return false 包含`..`或为绝对路径
+   */
+  static bool Normalize(const std::string& path, std::string* normalized);
+
+  /**
+   * @brief 读取目录的所有目录项(不持有锁)
+   *
+   * @param dir 规范化的目录路径
+   * @param listing 输出列表
+   * @return true 成功
+   * @return false 目录不存在
+   */
+  bool Load(const std::string& dir, Listing* listing) const;
+
+  /**
+   * @brief 重新`stat`目录中的一项并更新缓存的列表(不持有锁时调用)
+   *
+   * @param dir 规范化的目录路径
+   * @param name 目录项名称
+   */
+  void Refresh(const std::string& dir, const std::string& name);
+
+  /**
+   * @brief 标记目录已修改: 正在读取的结果不放入缓存(需持有`mutex_`)
+   */
+  void MarkDirty(const std::string& dir);
+
+  /**
+   * @brief 删除目录的缓存和监视(需持有`mutex_`)
+   */
+  void Erase(const std::string& dir);
+
+  /**
+   * @brief 删除目录及其所有子目录的缓存(需持有`mutex_`)
+   */
+  void EraseTree(const std::string& dir);
+
+  std::string root_;
+  int max_dirs_;
+  /// @brief inotify文件描述符
+  int inotify_fd_ = -1;
+
+  std::mutex mutex_;
+  /// @brief 目录路径到缓存的列表
+  std::unordered_map<std::string, Listing> dirs_;
+  /// @brief 最近使用顺序, 头部为最近使用
+  LruList lru_;
+  /// @brief inotify监视描述符到目录路径
+  std::unordered_map<int, std::string> watches_;
+  /// @brief 正在读取的目录
+  std::unordered_map<std::string, Loading> loading_;
+
+  DirCacheStats stats_;
+};
+
+END_NAMESPACE
+
+#endif  // DIR_CACHE_H
@@ -0,0 +1,190 @@
+﻿/**
+ * @file disk_client.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `DiskClient`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef DISK_CLIENT_H
+#define DISK_CLIENT_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "blocking_pool.h"
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+class Thread;
+class ClientConnection;
+struct ClientRequest;
+struct Transfer;
+
+/**
+ * @brief 客户端参数
+ */
+struct CROSSOCEAN_API DiskClientOptions {
+  /// @brief 处理连接的事件循环线程数
+  int threads = 2;
+  /// @brief 每个服务器的连接数, 大文件的块分散到这些连接上并行传输
+  int connections = 4;
+  /// @brief 每个连接上在途(已发送未响应)的请求数上限
+  int pipeline_depth = 8;
+  /// @brief 并行传输的块大小
+  size_t chunk_size = 4 * 1024 * 1024;
+  /// @brief 上传时读取本地文件计算CRC32C随`kCommit`发送, 服务器校验后提交
+  bool verify_upload = true;
+  /// @brief 下载时提供给服务器的压缩算法列表(如`Compression::Supported()`),
+  /// 空为不压缩; 服务器选中算法后压缩发送, 客户端解码后写入本地文件
+  std::string codecs;
+};
+
+/**
+ * @brief 客户端统计信息
+ */
+struct CROSSOCEAN_API DiskClientStats {
+  long long requests = 0;          ///< 发送的请求数
+  long long bytes_sent = 0;        ///< 上传的文件数据字节数
+  long long bytes_received = 0;    ///< 下载的文件数据字节数
+  long long compressed_bytes = 0;  ///< 下载时以压缩形式收到的字节数(解码前)
+  long long connects = 0;          ///< 建立的连接数
+  long long failures = 0;          ///< 失败的请求数
+};
+
+/**
+ * @brief 文件服务器客户端
+ *
+ * @details
+ * 与服务器(`ReplicaServer`)使用相同的消息格式和`Thread`事件循环.
+ * 每个服务器保持一组长连接, 连接断开后下次使用时重新建立.
+ * 每个连接上的请求流水线发送, 不等上一个请求的响应, 响应按发送顺序返回.
+ * 大文件按`chunk_size`分块, 分散到同一服务器的多个连接上并行传输:
+ * 上传时每块是一条`kWriteAt`, 数据直接引用本地文件区间由`sendfile`发送,
+ * 同时在阻塞I/O线程中读取本地文件计算CRC32C(`verify_upload`),
+ * 全部块确认后发送带CRC32C的`kCommit`, 服务器校验整个文件后提交;
+ * 下载时先读第一块得到文件大小, 再并行读取其余块,
+ * 数据用`splice`从socket经管道移入本地文件, 不经过用户态缓冲区.
+ * 异步接口的回调在事件循环线程中执行, 不能在回调中调用阻塞接口
+ */
+class CROSSOCEAN_API DiskClient {
+ public:
+  /// @brief 完成回调
+  using Callback = std::function<void(bool ok)>;
+
+  /**
+   * @brief 构造客户端
+   *
+   * @param options 客户端参数
+   */
+  explicit DiskClient(const DiskClientOptions& options = DiskClientOptions());
+
+  /**
+   * @brief 关闭所有连接
+   */
+  ~DiskClient();
+
+  /**
+   * @brief 启动事件循环线程
+   *
+   * @return true 成功
+   * @return false 已经启动
+   */
+  bool Start();
+
+  /**
+   * @brief 上传本地文件(异步)
+   *
+   * @param server 服务器地址(`IP:端口`)
+   * @param local_path 本地文件路径
+   * @param remote_path 服务器上相对根目录的路径
+   * @param done 完成回调
+   */
+  void Upload(const std::string& server, const std::string& local_path,
+              const std::string& remote_path, Callback done);
+
+  /**
+   * @brief 下载文件到本地(异步)
+   *
+   * @param server 服务器地址(`IP:端口`)
+   * @param remote_path 服务器上相对根目录的路径
+   * @param local_path 本地文件路径, 已存在时覆盖
+   * @param done 完成回调
+   */
+  void Download(const std::string& server, const std::string& remote_path,
+                const std::string& local_path, Callback done);
+
+  /**
+   * @brief 上传本地文件(阻塞)
+   */
+  bool Upload(const std::string& server, const std::string& local_path,
+              const std::string& remote_path);
+
+  /**
+   * @brief 下载文件到本地(阻塞)
+   */
+  bool Download(const std::string& server, const std::string& remote_path,
+                const std::string& local_path);
+
+  /// @brief 客户端参数
+  const DiskClientOptions& options() const { return options_; }
+  /// @brief 统计信息
+  DiskClientStats stats() const;
+
+ private:
+  friend class ClientConnection;
+
+  /**
+   * @brief 把请求发给服务器的第`index`个连接(取模)
+   */
+  void Send(const std::string& server, size_t index,
+            std::shared_ptr<ClientRequest> request);
+
+  /**
+   * @brief 获取连接, 不存在或已断开时新建
+   */
+  std::shared_ptr<ClientConnection> Connection(const std::string& server,
+                                               size_t index);
+
+  /**
+   * @brief 一块传输完成, 全部完成后提交或结束
+   */
+  void ChunkDone(const std::shared_ptr<Transfer>& transfer, bool ok);
+
+  /**
+   * @brief 下载的第一块返回了文件大小, 并行读取其余块
+   */
+  void ReadRest(const std::shared_ptr<Transfer>& transfer, long long size);
+
+  DiskClientOptions options_;
+  /// @brief 事件循环线程
+  std::vector<Thread*> threads_;
+  std::atomic<unsigned> next_thread_{0};
+  /// @brief 计算上传文件校验和的阻塞I/O线程
+  BlockingPool blocking_;
+  /// @brief 各传输轮流从不同的连接开始, 小文件也分散到整个连接池
+  std::atomic<size_t> next_connection_{0};
+
+  std::mutex mutex_;
+  /// @brief 每个服务器的连接池
+  std::map<std::string, std::vector<std::shared_ptr<ClientConnection>>>
+      pools_;
+
+  std::atomic<long long> requests_{0};
+  std::atomic<long long> bytes_sent_{0};
+  std::atomic<long long> bytes_received_{0};
+  std::atomic<long long> compressed_bytes_{0};
+  std::atomic<long long> connects_{0};
+  std::atomic<long long> failures_{0};
+};
+
+END_NAMESPACE
+
+#endif  // DISK_CLIENT_H
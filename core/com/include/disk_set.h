@@ -0,0 +1,269 @@
+﻿/**
+ * @file disk_set.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `DiskSet`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef DISK_SET_H
+#define DISK_SET_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "blocking_pool.h"
+#include "crossocean.h"
+#include "hash_ring.h"
+
+CROSSOCEAN_NAMESPACE
+
+class Thread;
+
+/**
+ * @brief 单个磁盘的统计信息
+ */
+struct CROSSOCEAN_API DiskStats {
+  std::string path;              ///< 数据目录
+  double weight = 0;             ///< 放置权重
+  long long reads = 0;           ///< 读操作次数
+  long long writes = 0;          ///< 写操作次数
+  long long read_bytes = 0;      ///< 读取的字节数
+  long long write_bytes = 0;     ///< 写入的字节数
+  long long errors = 0;          ///< 失败的操作次数
+  long long busy_us = 0;         ///< 操作累计耗时(微秒)
+  long long max_latency_us = 0;  ///< 单次操作的最大耗时(微秒)
+  int pending = 0;               ///< 队列中等待执行的操作数
+
+  /// @brief 平均每次操作的耗时(微秒)
+  double avg_latency_us() const {
+    long long ops = reads + writes;
+    return ops == 0 ? 0.0 : static_cast<double>(busy_us) / ops;
+  }
+
+  /// @brief 操作期间的吞吐量(字节/秒)
+  double throughput() const {
+    return busy_us == 0 ? 0.0 : (read_bytes + write_bytes) * 1e6 / busy_us;
+  }
+};
+
+/**
+ * @brief 多磁盘存储层
+ *
+ * @details
+ * 文件保存在多个数据目录(通常每个目录对应一块独立的磁盘)中, 用带权重的一致性
+ * 哈希决定位置, 权重默认取磁盘容量. 大于`stripe_size`的文件按`stripe_size`
+ * 切分为条带, 每个条带单独放置, 一个大文件的读写可以同时使用多块磁盘.
+ * 条带0保存为`<目录>/<名称>`, 条带i保存为`<目录>/.diskset/stripe<i>/<名称>`,
+ * 写入用的临时文件在`<目录>/.diskset/tmp`中; `.diskset`开头的名称被保留,
+ * 条带和临时文件不会与其它文件重名. 大文件可以按区间分段读写,
+ * 不必整个放在内存中.
+ * 每块磁盘有自己的`BlockingPool`作为I/O队列, 一块慢盘只会堵住自己的队列,
+ * 不影响其它磁盘上的读写. 完成回调投递回发起请求的`Thread`.
+ * `Init`之后磁盘列表不能再修改; 各方法可以在多个线程中同时调用
+ */
+class CROSSOCEAN_API DiskSet {
+ public:
+  /**
+   * @brief 写入完成回调
+   *
+   * @param ok 是否全部写入成功
+   */
+  using WriteDone = std::function<void(bool ok)>;
+  /**
+   * @brief 读取完成回调
+   *
+   * @param ok 是否读取成功
+   * @param data 文件内容
+   */
+  using ReadDone = std::function<void(bool ok, std::string data)>;
+
+  /**
+   * @brief 构造多磁盘存储层
+   *
+   * @param stripe_size 条带大小(字节), 小于等于0表示不切分
+   * @param threads_per_disk 每块磁盘的I/O线程数
+   */
+  explicit DiskSet(long long stripe_size = 4 * 1024 * 1024,
+                   int threads_per_disk = 2);
+
+  /**
+   * @brief 等待所有队列中的操作完成后退出I/O线程
+   */
+  ~DiskSet();
+
+  /**
+   * @brief 添加数据目录, 需在`Init`之前调用
+   *
+   * @param path 数据目录
+   * @param weight 放置权重, 小于等于0时按磁盘容量计算
+   * @return true 成功
+   * @return false 已经初始化或目录重复
+   */
+  bool AddDisk(const std::string& path, double weight = 0);
+
+  /**
+   * @brief 创建数据目录, 计算权重并启动每块磁盘的I/O线程
+   *
+   * @return true 成功
+   * @return false 没有磁盘或创建目录失败
+   */
+  bool Init();
+
+  /**
+   * @brief 停止所有磁盘的I/O线程(等待队列中的操作完成)
+   */
+  void Stop();
+
+  /**
+   * @brief 查找文件条带所在的磁盘
+   *
+   * @param name 文件名(相对路径)
+   * @param stripe 条带序号
+   * @return int 磁盘序号, 未初始化时返回-1
+   */
+  int Locate(const std::string& name, long long stripe) const;
+
+  /**
+   * @brief 文件条带的保存路径
+   *
+   * @param name 文件名(相对路径)
+   * @param stripe 条带序号
+   * @return std::string 文件路径, 未初始化时返回空字符串
+   */
+  std::string StripePath(const std::string& name, long long stripe) const;
+
+  /**
+   * @brief 把阻塞工作提交到指定磁盘的I/O队列
+   *
+   * @param disk 磁盘序号
+   * @param work 在该磁盘的I/O线程中执行的工作
+   * @param thread 执行回调的线程, 为`nullptr`时在I/O线程中直接执行
+   * @param done 完成回调
+   * @return true 提交成功
+   * @return false 磁盘序号无效或已停止
+   */
+  bool Submit(int disk, BlockingPool::Work work, Thread* thread,
+              BlockingPool::Done done);
+
+  /**
+   * @brief 写入文件(覆盖), 各条带并行写入所在的磁盘
+   *
+   * @param name 文件名(相对路径)
+   * @param data 文件内容
+   * @param thread 执行回调的线程
+   * @param done 所有条带完成后的回调
+   * @return true 已提交
+   * @return false 名称非法或未初始化
+   */
+  bool Write(const std::string& name, std::shared_ptr<const std::string> data,
+             Thread* thread, WriteDone done);
+
+  /**
+   * @brief 从`offset`开始写入文件的一段, 各条带并行写入所在的磁盘
+   *
+   * @details 大文件可以按顺序分段写入. `offset`必须是条带大小的整数倍
+   * (不切分时为0); 不是最后一段时长度也必须是条带大小的整数倍.
+   * 最后一段写完后删除旧版本多出的条带
+   *
+   * @param name 文件名(相对路径)
+   * @param offset 在文件中的偏移
+   * @param data 这一段的内容
+   * @param last 是否为文件的最后一段
+   * @param thread 执行回调的线程
+   * @param done 所有条带完成后的回调
+   * @return true 已提交
+   * @return false 名称非法、未初始化或区间没有按条带对齐
+   */
+  bool WriteRange(const std::string& name, long long offset,
+                  std::shared_ptr<const std::string> data, bool last,
+                  Thread* thread, WriteDone done);
+
+  /**
+   * @brief 读取文件, 各条带并行从所在的磁盘读取
+   *
+   * @param name 文件名(相对路径)
+   * @param thread 执行回调的线程
+   * @param done 所有条带完成后的回调
+   * @return true 已提交
+   * @return false 名称非法或未初始化
+   */
+  bool Read(const std::string& name, Thread* thread, ReadDone done);
+
+  /**
+   * @brief 读取文件的一段, 只读取区间涉及的条带
+   *
+   * @param name 文件名(相对路径)
+   * @param offset 在文件中的偏移
+   * @param length 读取的长度, 小于0表示读到文件末尾; 超出文件末尾的部分不返回
+   * @param thread 执行回调的线程
+   * @param done 所有条带完成后的回调, `data`为区间内容
+   * @return true 已提交
+   * @return false 名称非法、未初始化或偏移为负数
+   */
+  bool ReadRange(const std::string& name, long long offset, long long length,
+                 Thread* thread, ReadDone done);
+
+  /**
+   * @brief 获取文件大小(按顺序检查条带, 阻塞)
+   *
+   * @param name 文件名(相对路径)
+   * @param size 输出文件大小
+   * @return true 文件存在
+   * @return false 文件不存在
+   */
+  bool Stat(const std::string& name, long long* size) const;
+
+  /**
+   * @brief 删除文件的所有条带(阻塞)
+   *
+   * @param name 文件名(相对路径)
+   * @return true 文件存在并已删除
+   * @return false 文件不存在
+   */
+  bool Remove(const std::string& name);
+
+  /**
+   * @brief 获取每块磁盘的统计信息
+   *
+   * @return std::vector<DiskStats> 按磁盘序号排列的统计信息
+   */
+  std::vector<DiskStats> stats() const;
+
+  /// @brief 磁盘数量
+  int disk_count() const { return static_cast<int>(disks_.size()); }
+  /// @brief 条带大小
+  long long stripe_size() const { return stripe_size_; }
+
+ private:
+  struct Disk;
+
+  /**
+   * @brief 校验文件名, 不允许绝对路径、`..`和保留目录`.diskset`
+   */
+  static bool ValidName(const std::string& name);
+
+  /**
+   * @brief 在磁盘的I/O线程中执行一次读写并记录统计
+   *
+   * @param disk 磁盘
+   * @param write 是否为写操作
+   * @param op 实际的读写, 返回处理的字节数, 失败返回-1
+   */
+  static void Measure(Disk* disk, bool write,
+                      const std::function<long long()>& op);
+
+  long long stripe_size_;
+  int threads_per_disk_;
+  bool initialized_ = false;
+  std::vector<std::unique_ptr<Disk>> disks_;
+  HashRing ring_;
+};
+
+END_NAMESPACE
+
+#endif  // DISK_SET_H
@@ -0,0 +1,189 @@
+﻿/**
+ * @file file_cache.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `FileCache`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 已打开的只读文件及其元数据
+ *
+ * @details 由`FileCache`共享, 最后一个引用释放时关闭文件描述符
+ */
+struct CROSSOCEAN_API OpenFile {
+  ~OpenFile();
+
+  /// @brief 文件路径
+  std::string path;
+  /// @brief 文件描述符
+  int fd = -1;
+  /// @brief 文件大小
+  long long size = 0;
+  /// @brief 修改时间(纳秒)
+  long long mtime_ns = 0;
+  /// @brief 设备号
+  uint64_t dev = 0;
+  /// @brief inode号
+  uint64_t ino = 0;
+
+  /**
+   * @brief 文件内容标识, 由设备号、inode、修改时间和大小计算,
+   * 文件内容变化后标识随之改变, 可以作为`BlockCache`的文件ID
+   */
+  uint64_t file_id = 0;
+};
+
+/// @brief 共享的已打开文件
+using OpenFilePtr = std::shared_ptr<const OpenFile>;
+
+/**
+ * @brief 缓存统计信息
+ */
+struct CROSSOCEAN_API FileCacheStats {
+  long long hits = 0;           ///< 命中次数
+  long long misses = 0;         ///< 未命中(需要`open`)次数
+  long long revalidations = 0;  ///< 重新`stat`校验次数
+  long long evictions = 0;      ///< 因描述符预算淘汰的次数
+  int cached = 0;               ///< 当前缓存的文件数
+};
+
+/**
+ * @brief 按路径缓存打开的文件描述符和`stat`信息
+ *
+ * @details
+ * 线程安全, 所有`Thread`共享一个缓存. 重复下载同一文件时直接复用已打开的描述符,
+ * 省去`open`+`fstat`+`close`. 缓存条目在以下情况失效:
+ * - 服务器自己修改或删除文件时调用`Invalidate`删除条目; 未命中时在锁外打开
+ *   文件, 期间同一路径发生过失效则结果不放入缓存, 避免缓存旧文件,
+ *   其它路径的失效不影响;
+ * - 其它进程修改文件: 条目超过`revalidate_ms`后重新`stat`路径,
+ *   inode、大小或修改时间变化则重新打开.
+ * 缓存的描述符数量不超过`max_files`, 超出时淘汰最久未使用的条目;
+ * 正在使用的文件由调用者持有引用, 用完后才真正关闭
+ */
+class CROSSOCEAN_API FileCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief 构造文件缓存
+   *
+   * @param max_files 缓存的文件描述符数量上限
+   * @param revalidate_ms 条目重新`stat`校验的间隔(毫秒), 0为每次都校验
+   */
+  FileCache(int max_files, int revalidate_ms = 1000);
+
+  /**
+   * @brief 打开文件(只读), 优先使用缓存
+   *
+   * @param path 文件路径
+   * @return OpenFilePtr 打开的文件, 失败返回`nullptr`
+   */
+  OpenFilePtr Open(const std::string& path);
+
+  /**
+   * @brief 使路径对应的缓存失效(文件被上传覆盖或删除时调用)
+   *
+   * @param path 文件路径
+   */
+  void Invalidate(const std::string& path);
+
+  /**
+   * @brief 清空缓存
+   */
+  void Clear();
+
+  /**
+   * @brief 获取统计信息
+   *
+   * @return FileCacheStats 统计信息
+   */
+  FileCacheStats stats();
+
+ private:
+  struct Entry {
+    OpenFilePtr file;
+    /// @brief 上次校验时间
+    Clock::time_point checked;
+  };
+  /**
+   * @brief 锁外正在打开或校验的路径
+   */
+  struct Pending {
+    /// @brief 进行中的打开数量, 降到0时删除
+    int loads = 0;
+    /// @brief 失效代数, 打开期间路径失效时加1
+    uint64_t generation = 0;
+  };
+  using LruList = std::list<std::string>;
+
+  /**
+   * @brief 打开文件并读取元数据(不持有锁)
+   *
+   * @param path 文件路径
+   * @return OpenFilePtr 打开的文件, 失败返回`nullptr`
+   */
+  static OpenFilePtr Load(const std::string& path);
+
+  /**
+   * @brief 检查缓存的文件是否仍与路径上的文件一致
+   *
+   * @param file 缓存的文件
+   * @return true 一致
+   * @return false 文件已被替换或修改
+   */
+  static bool StillValid(const OpenFile& file);
+
+  /**
+   * @brief 删除条目(需持有`mutex_`)
+   */
+  void Erase(const std::string& path);
+
+  /**
+   * @brief 结束一次锁外打开(需持有`mutex_`)
+   *
+   * @param path 文件路径
+   * @param generation 开始打开时路径的失效代数
+   * @return true 打开期间路径没有失效
+   * @return false 打开期间路径失效过, 结果不能放入缓存
+   */
+  bool EndLoad(const std::string& path, uint64_t generation);
+
+  int max_files_;
+  std::chrono::milliseconds revalidate_;
+
+  std::mutex mutex_;
+  /// @brief 路径到条目的索引
+  std::unordered_map<std::string, std::pair<Entry, LruList::iterator>>
+      entries_;
+  /// @brief 最近使用顺序, 头部为最近使用
+  LruList lru_;
+  /// @brief 锁外正在打开的路径及其失效代数, 只包含进行中的打开
+  std::unordered_map<std::string, Pending> pending_;
+
+  long long hits_ = 0;
+  long long misses_ = 0;
+  long long revalidations_ = 0;
+  long long evictions_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // FILE_CACHE_H
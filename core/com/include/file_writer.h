@@ -0,0 +1,152 @@
+﻿/**
+ * @file file_writer.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `FileWriter`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 文件写入选项
+ */
+struct CROSSOCEAN_API FileWriterOptions {
+  /// @brief 是否按声明的大小预分配磁盘空间
+  bool preallocate = true;
+  /// @brief 每写入多少字节发起一次写回(0为不主动写回)
+  long long writeback_bytes = 8 * 1024 * 1024;
+  /// @brief 写回完成的数据是否从页缓存中释放
+  bool drop_cache = true;
+  /// @brief 声明大小不小于该值的文件使用`O_DIRECT`写入(0为不使用)
+  long long direct_threshold = 0;
+  /// @brief `O_DIRECT`要求的对齐大小
+  size_t alignment = 4096;
+};
+
+/**
+ * @brief 上传文件写入器
+ *
+ * @details
+ * 分块并行上传的数据乱序到达, 文件系统边写边分配会产生大量碎片,
+ * 影响之后的顺序读取. `FileWriter`打开文件时按声明的大小`fallocate`
+ * 一次分配连续的空间, 之后各块用`pwrite`写入各自的位置.
+ * 写入过程中每累计`writeback_bytes`字节用`sync_file_range`发起一轮写回,
+ * 并等待上一轮写回完成后用`posix_fadvise(DONTNEED)`释放页缓存,
+ * 脏页稳定地流向磁盘而不是在最后集中刷写, 大量上传也不会挤掉热点文件的缓存.
+ * 超大文件可以使用`O_DIRECT`完全绕过页缓存: 对齐的块直接写入,
+ * 不对齐的部分(通常是文件末尾)通过普通描述符写入.
+ * 只负责写入, 持久化由`GroupCommitter`负责
+ */
+class CROSSOCEAN_API FileWriter {
+ public:
+  /**
+   * @brief 构造文件写入器
+   *
+   * @param path 文件路径
+   * @param options 写入选项
+   */
+  FileWriter(const std::string& path,
+             const FileWriterOptions& options = FileWriterOptions());
+  ~FileWriter();
+
+  /**
+   * @brief 创建(或截断)文件并预分配空间
+   *
+   * @param declared_size 声明的文件大小, 小于等于0表示未知
+   * @return true 成功
+   * @return false 创建文件失败
+   */
+  bool Open(long long declared_size);
+
+  /**
+   * @brief 在指定偏移写入数据(线程不安全, 调用者保证同一时间只有一次写入)
+   *
+   * @param offset 文件偏移
+   * @param data 数据
+   * @param len 数据长度
+   * @return true 成功
+   * @return false 写入失败
+   */
+  bool WriteAt(long long offset, const char* data, size_t len);
+
+  /**
+   * @brief 完成写入: 发起剩余数据的写回并释放页缓存, 然后关闭文件
+   *
+   * @return true 成功
+   * @return false 未打开或写入失败
+   */
+  bool Finish();
+
+  /// @brief 普通(带页缓存)的文件描述符, 可以交给`GroupCommitter`落盘
+  int fd() const { return fd_; }
+  /// @brief 是否使用了`O_DIRECT`
+  bool direct() const { return direct_fd_ >= 0; }
+  /// @brief 是否成功预分配了空间
+  bool preallocated() const { return preallocated_; }
+  /// @brief 已写入的字节数
+  long long bytes_written() const { return bytes_written_; }
+  /// @brief 发起写回的轮数
+  int writeback_rounds() const { return writeback_rounds_; }
+
+ private:
+  /// @brief 文件区间[起始, 结束)
+  using Range = std::pair<long long, long long>;
+
+  /**
+   * @brief 记录写入的区间, 累计到阈值时发起一轮写回
+   */
+  void Track(long long offset, size_t len);
+
+  /**
+   * @brief 发起当前区间的写回, 等待上一轮写回完成并释放页缓存
+   *
+   * @param wait_all 是否同时等待本轮写回完成(结束写入时)
+   */
+  void Writeback(bool wait_all);
+
+  /**
+   * @brief 通过`O_DIRECT`描述符写入对齐的数据
+   */
+  bool WriteDirect(long long offset, const char* data, size_t len);
+
+  /**
+   * @brief 关闭文件描述符
+   */
+  void Close();
+
+  std::string path_;
+  FileWriterOptions options_;
+  int fd_ = -1;
+  int direct_fd_ = -1;
+  bool preallocated_ = false;
+
+  /// @brief `O_DIRECT`使用的对齐缓冲区
+  char* aligned_buf_ = nullptr;
+  size_t aligned_size_ = 0;
+
+  /// @brief 本轮写入的区间(带页缓存的写入)
+  std::vector<Range> dirty_;
+  long long dirty_bytes_ = 0;
+  /// @brief 上一轮已发起写回的区间
+  std::vector<Range> flushing_;
+
+  long long bytes_written_ = 0;
+  int writeback_rounds_ = 0;
+  bool failed_ = false;
+};
+
+END_NAMESPACE
+
+#endif  // FILE_WRITER_H
@@ -0,0 +1,190 @@
+﻿/**
+ * @file frame.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Frame`、`FrameWriter`和`FrameReader`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <cstdint>
+#include <string>
+
+#include "crossocean.h"
+
+struct evbuffer;
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 消息类型
+ */
+enum class FrameType : uint8_t {
+  kPutBegin = 1,     ///< 开始写入文件: 路径、大小、副本链、标志、压缩算法(可选)
+  kPutData = 2,      ///< 文件数据: 偏移 + 数据(协商压缩时为编码的数据块)
+  kPutEnd = 3,       ///< 文件结束: 整个文件的CRC32C
+  kAck = 4,          ///< 确认: 状态 + 已确认的偏移
+  kSyncRequest = 5,  ///< 追赶请求: 路径 + 本地的分块校验和
+  kSyncBegin = 6,    ///< 追赶响应: 文件大小 + 源文件的分块校验和
+  kGetMap = 7,       ///< 获取分片表
+  kMap = 8,          ///< 分片表
+  kSetMap = 9,       ///< 更新节点的分片表
+  kRedirect = 10,    ///< 文件不归本节点: 节点当前的分片表
+  kWriteAt = 11,     ///< 写入文件区间: 路径、文件大小、上传ID、偏移 + 数据
+  kCommit = 12,      ///< 提交区间写入的文件: 路径、大小、上传ID、CRC32C(可选)
+  kReadAt = 13,      ///< 读取文件区间: 路径、偏移、长度、压缩算法(可选)
+  kData = 14,        ///< 文件区间: 文件大小、偏移、压缩算法(协商时) + 数据
+};
+
+/// @brief `kPutBegin`的标志: 正式文件已存在时跳过写入(再平衡使用)
+constexpr uint8_t kPutIfAbsent = 1;
+
+/**
+ * @brief 确认状态
+ */
+enum class AckStatus : uint8_t {
+  kProgress = 0,   ///< 已写入到偏移(写入进行中)
+  kCommitted = 1,  ///< 整个文件已提交
+  kError = 2,      ///< 失败
+};
+
+/**
+ * @brief 一条消息
+ *
+ * @details
+ * 线上格式: 长度4 + 类型1 + 请求ID4 + 消息体(长度字节), 整数为小端序.
+ * 请求ID由发起方分配, 响应使用相同的ID, 同一连接上可以有多个请求在途
+ */
+struct CROSSOCEAN_API Frame {
+  /// @brief 消息类型
+  FrameType type = FrameType::kAck;
+  /// @brief 请求ID
+  uint32_t id = 0;
+  /// @brief 消息体
+  std::string body;
+
+  /// @brief 消息头长度
+  static constexpr size_t kHeaderSize = 9;
+  /// @brief 消息体长度上限
+  static constexpr uint32_t kMaxBodySize = 64 * 1024 * 1024;
+
+  /**
+   * @brief 编码消息头
+   *
+   * @param type 消息类型
+   * @param id 请求ID
+   * @param body_size 消息体长度
+   * @param out 输出`kHeaderSize`字节
+   */
+  static void EncodeHeader(FrameType type, uint32_t id, uint32_t body_size,
+                           char* out);
+
+  /**
+   * @brief 解码消息头
+   *
+   * @param data `kHeaderSize`字节的消息头
+   * @param type 输出消息类型
+   * @param id 输出请求ID
+   * @param body_size 输出消息体长度
+   * @return true 成功
+   * @return false 消息体超过长度上限
+   */
+  static bool DecodeHeader(const char* data, FrameType* type, uint32_t* id,
+                           uint32_t* body_size);
+
+  /**
+   * @brief 查看缓冲区中第一条完整消息的长度
+   *
+   * @param in 输入缓冲区
+   * @param frame_size 输出消息总长度(含消息头)
+   * @return int 1为有完整消息, 0为数据不足, -1为格式错误
+   */
+  static int Peek(::evbuffer* in, size_t* frame_size);
+
+  /**
+   * @brief 从缓冲区取出一条完整消息
+   *
+   * @param in 输入缓冲区
+   * @param frame 输出消息
+   * @return int 1为取出一条消息, 0为数据不足, -1为格式错误
+   */
+  static int Pop(::evbuffer* in, Frame* frame);
+
+  /**
+   * @brief 编码整条消息
+   *
+   * @return std::string 消息头和消息体
+   */
+  std::string Encode() const;
+};
+
+/**
+ * @brief 消息体编码
+ */
+class CROSSOCEAN_API FrameWriter {
+ public:
+  void PutU8(uint8_t value) { body_.push_back(static_cast<char>(value)); }
+  void PutU32(uint32_t value) { PutUint(value, 4); }
+  void PutU64(uint64_t value) { PutUint(value, 8); }
+
+  /**
+   * @brief 追加长度前缀(4字节)的字符串
+   */
+  void PutString(const std::string& value);
+
+  /**
+   * @brief 追加原始字节(放在消息体末尾, 长度由消息体长度确定)
+   */
+  void PutBytes(const char* data, size_t len) { body_.append(data, len); }
+
+  /**
+   * @brief 生成消息
+   *
+   * @param type 消息类型
+   * @param id 请求ID
+   * @return std::string 编码后的整条消息
+   */
+  std::string Finish(FrameType type, uint32_t id) const;
+
+  /// @brief 消息体
+  const std::string& body() const { return body_; }
+
+ private:
+  void PutUint(uint64_t value, int bytes);
+
+  std::string body_;
+};
+
+/**
+ * @brief 消息体解码, 越界读取返回false
+ */
+class CROSSOCEAN_API FrameReader {
+ public:
+  FrameReader(const char* data, size_t len) : data_(data), len_(len) {}
+  explicit FrameReader(const std::string& body)
+      : FrameReader(body.data(), body.size()) {}
+
+  bool GetU8(uint8_t* value);
+  bool GetU32(uint32_t* value);
+  bool GetU64(uint64_t* value);
+  bool GetString(std::string* value);
+
+  /// @brief 剩余的原始字节
+  const char* rest() const { return data_ + pos_; }
+  /// @brief 剩余的字节数
+  size_t remaining() const { return len_ - pos_; }
+
+ private:
+  bool GetUint(uint64_t* value, int bytes);
+
+  const char* data_;
+  size_t len_;
+  size_t pos_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // FRAME_H
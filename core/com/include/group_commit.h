@@ -0,0 +1,159 @@
+﻿/**
+ * @file group_commit.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `GroupCommitter`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef GROUP_COMMIT_H
+#define GROUP_COMMIT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+class BlockingPool;
+class Thread;
+
+/**
+ * @brief 上传数据的持久化级别(每个请求可以单独指定)
+ */
+enum class Durability {
+  kNone,       ///< 不等待落盘, 立即确认
+  kGroup,      ///< 与其它请求合并落盘后确认(默认)
+  kImmediate,  ///< 单独立即落盘后确认
+};
+
+/**
+ * @brief 组提交统计信息
+ */
+struct CROSSOCEAN_API GroupCommitStats {
+  long long commits = 0;   ///< 提交请求数
+  long long groups = 0;    ///< 合并落盘的批次数
+  long long syncs = 0;     ///< `fdatasync`调用次数
+  long long failures = 0;  ///< 落盘失败的请求数
+};
+
+/**
+ * @brief 组提交: 合并多个连接的落盘请求
+ *
+ * @details
+ * 每个上传块写完后单独`fsync`, 吞吐量会受限于磁盘刷写延迟.
+ * `GroupCommitter`把一个时间窗口内(或累计字节数达到阈值前)的提交请求
+ * 合并为一组, 在阻塞I/O线程池中先对每个文件用`sync_file_range`发起写回,
+ * 再对每个文件只调用一次`fdatasync`, 完成后一起确认组内所有请求.
+ * 确认回调投递回发起请求的`Thread`. 调用者在回调之前必须保持文件描述符打开
+ */
+class CROSSOCEAN_API GroupCommitter {
+ public:
+  /**
+   * @brief 落盘完成回调
+   *
+   * @param ok 是否成功落盘
+   */
+  using Done = std::function<void(bool ok)>;
+
+  /**
+   * @brief 构造组提交器, 启动收集线程
+   *
+   * @param pool 执行落盘的阻塞I/O线程池, 为`nullptr`时在收集线程中落盘
+   * @param window_ms 合并窗口(毫秒), 从组内第一个请求开始计时
+   * @param max_bytes 组内累计字节数达到该值时立即落盘, 小于等于0表示不限制
+   */
+  GroupCommitter(BlockingPool* pool, int window_ms = 2,
+                 long long max_bytes = 8 * 1024 * 1024);
+
+  /**
+   * @brief 落盘剩余的请求后停止收集线程, 等待线程池中的落盘完成
+   */
+  ~GroupCommitter();
+
+  /**
+   * @brief 提交落盘请求
+   *
+   * @param fd 已写入数据的文件描述符
+   * @param offset 写入的起始偏移
+   * @param length 写入的字节数
+   * @param durability 持久化级别
+   * @param thread 执行回调的线程, 为`nullptr`时在落盘线程中直接回调
+   * @param done 落盘完成回调
+   */
+  void Commit(int fd, long long offset, long long length,
+              Durability durability, Thread* thread, Done done);
+
+  /**
+   * @brief 不等待窗口结束, 立即落盘当前组
+   */
+  void Flush();
+
+  /**
+   * @brief 获取统计信息
+   */
+  GroupCommitStats stats() const;
+
+ private:
+  /**
+   * @brief 一个等待落盘的请求
+   */
+  struct Waiter {
+    int fd;
+    long long offset;
+    long long length;
+    Thread* thread;
+    Done done;
+  };
+
+  /**
+   * @brief 收集线程入口: 等待窗口结束或字节数达到阈值后提交一组
+   */
+  void Main();
+
+  /**
+   * @brief 落盘一组请求并确认(阻塞)
+   *
+   * @param group 一组请求
+   */
+  void SyncGroup(std::vector<Waiter>& group);
+
+  /**
+   * @brief 在阻塞I/O线程池中执行, 线程池不可用时直接执行
+   */
+  void Run(std::function<void()> work);
+
+  BlockingPool* pool_;
+  std::chrono::milliseconds window_;
+  long long max_bytes_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  /// @brief 当前组的请求
+  std::vector<Waiter> pending_;
+  /// @brief 当前组累计的字节数
+  long long pending_bytes_ = 0;
+  /// @brief 当前组第一个请求的时间
+  std::chrono::steady_clock::time_point group_start_;
+  bool flush_now_ = false;
+  bool stopping_ = false;
+  /// @brief 已交给线程池还没完成的落盘数, 析构时等待归零
+  int in_flight_ = 0;
+  std::thread collector_;
+
+  std::atomic<long long> commits_{0};
+  std::atomic<long long> groups_{0};
+  std::atomic<long long> syncs_{0};
+  std::atomic<long long> failures_{0};
+};
+
+END_NAMESPACE
+
+#endif  // GROUP_COMMIT_H
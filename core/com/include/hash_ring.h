@@ -0,0 +1,113 @@
+﻿/**
+ * @file hash_ring.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `HashRing`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef HASH_RING_H
+#define HASH_RING_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 带权重的一致性哈希环
+ *
+ * @details
+ * 每个节点按权重在环上放置多个虚拟节点, 键顺时针找到的第一个虚拟节点
+ * 所属的节点即为键的归属节点. 增删节点时只有相邻区间的键改变归属,
+ * 其余键保持不变. 权重越大的节点虚拟节点越多, 分到的键也越多.
+ * 不是线程安全的, 构建完成后只读访问可以在多个线程中进行
+ */
+class CROSSOCEAN_API HashRing {
+ public:
+  /**
+   * @brief 构造哈希环
+   *
+   * @param vnodes 权重为1的节点放置的虚拟节点数
+   */
+  explicit HashRing(int vnodes = 256);
+
+  /**
+   * @brief 添加节点, 已存在时更新权重
+   *
+   * @param node 节点名称
+   * @param weight 权重, 虚拟节点数为`vnodes * weight`(至少1个)
+   * @return true 成功
+   * @return false 名称为空或权重不大于0
+   */
+  bool AddNode(const std::string& node, double weight = 1.0);
+
+  /**
+   * @brief 删除节点
+   *
+   * @param node 节点名称
+   * @return true 成功
+   * @return false 节点不存在
+   */
+  bool RemoveNode(const std::string& node);
+
+  /**
+   * @brief 查找键的归属节点
+   *
+   * @param key 键
+   * @return const std::string* 节点名称, 环为空时返回`nullptr`
+   */
+  const std::string* Lookup(const std::string& key) const;
+
+  /**
+   * @brief 查找键的前`count`个不同节点(沿环顺时针), 用于副本放置
+   *
+   * @param key 键
+   * @param count 需要的节点数
+   * @return std::vector<std::string> 节点名称, 节点不足时返回全部节点
+   */
+  std::vector<std::string> Lookup(const std::string& key, int count) const;
+
+  /**
+   * @brief 判断节点是否存在
+   */
+  bool Contains(const std::string& node) const;
+
+  /// @brief 节点名称和权重
+  const std::vector<std::pair<std::string, double>>& nodes() const {
+    return nodes_;
+  }
+  /// @brief 节点数量
+  int size() const { return static_cast<int>(nodes_.size()); }
+  /// @brief 虚拟节点总数
+  int vnode_count() const { return static_cast<int>(ring_.size()); }
+
+  /**
+   * @brief 计算字符串的64位哈希(FNV-1a后再混合, 使相近的键分散到整个环上)
+   *
+   * @param data 字符串
+   * @return uint64_t 哈希值
+   */
+  static uint64_t Hash(const std::string& data);
+
+ private:
+  /**
+   * @brief 按节点列表重建虚拟节点
+   */
+  void Rebuild();
+
+  int vnodes_;
+  /// @brief 节点名称和权重
+  std::vector<std::pair<std::string, double>> nodes_;
+  /// @brief 按哈希排序的虚拟节点(哈希, 节点下标)
+  std::vector<std::pair<uint64_t, int>> ring_;
+};
+
+END_NAMESPACE
+
+#endif  // HASH_RING_H
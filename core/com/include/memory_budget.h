@@ -0,0 +1,200 @@
+﻿/**
+ * @file memory_budget.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `MemoryBudget`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 内存用途
+ */
+enum class MemoryCategory {
+  kTask = 0,    ///< 任务(连接)对象
+  kBuffer = 1,  ///< 连接的收发缓冲区
+  kCache = 2,   ///< 缓存
+};
+
+/// @brief 内存用途数量
+constexpr int kMemoryCategoryCount = 3;
+
+/**
+ * @brief 内存统计信息
+ */
+struct CROSSOCEAN_API MemoryStats {
+  long long used = 0;   ///< 当前占用字节数
+  long long peak = 0;   ///< 占用峰值
+  long long limit = 0;  ///< 全局预算(0为不限制)
+  /// @brief 各用途占用的字节数(下标为`MemoryCategory`)
+  long long categories[kMemoryCategoryCount] = {};
+  /// @brief 各工作线程占用的字节数(下标为线程编号, 0为其它线程)
+  std::vector<long long> workers;
+  long long reclaimed = 0;  ///< 超出预算时从缓存回收的字节数
+  long long shed = 0;       ///< 超出预算时拒绝的请求(连接)数
+  long long pauses = 0;     ///< 连接超出预算暂停读取的次数
+};
+
+/**
+ * @brief 全局内存预算
+ *
+ * @details
+ * 各子系统把占用的内存按用途和所属工作线程记到同一个预算上, 得到全局和
+ * 每个工作线程的内存用量. 记账只用原子变量, 可以在任意线程中调用.
+ * 超出预算时依次调用注册的回收函数(如缓存淘汰)释放内存, 仍然超出时
+ * 由调用者拒绝新请求或暂停读取, 见`over_limit`
+ */
+class CROSSOCEAN_API MemoryBudget {
+ public:
+  /// @brief 回收函数: 尝试释放`bytes`字节, 返回实际释放的字节数
+  using Reclaimer = std::function<long long(long long bytes)>;
+
+  /**
+   * @brief 构造内存预算
+   *
+   * @param limit 全局预算(字节), 0为不限制
+   * @param workers 工作线程数量, 线程编号为1 ~ workers
+   */
+  explicit MemoryBudget(long long limit = 0, int workers = 0);
+
+  /**
+   * @brief 记录内存占用的变化
+   *
+   * @details 增加占用后超出预算时调用回收函数
+   *
+   * @param category 用途
+   * @param worker 所属工作线程编号, 超出范围时记到0
+   * @param bytes 增加的字节数, 释放时为负数
+   */
+  void Charge(MemoryCategory category, int worker, long long bytes);
+
+  /**
+   * @brief 注册回收函数
+   *
+   * @param reclaimer 回收函数, 在超出预算的线程中调用
+   * @return int 回收函数编号, 用于注销
+   */
+  int AddReclaimer(Reclaimer reclaimer);
+
+  /**
+   * @brief 注销回收函数, 返回后回收函数不会再被调用
+   *
+   * @param id 回收函数编号
+   */
+  void RemoveReclaimer(int id);
+
+  /**
+   * @brief 调用回收函数释放内存
+   *
+   * @param bytes 需要释放的字节数
+   * @return long long 实际释放的字节数
+   */
+  long long Reclaim(long long bytes);
+
+  /// @brief 记录一次因超出预算拒绝的请求
+  void RecordShed() { ++shed_; }
+  /// @brief 记录一次连接因超出预算暂停读取
+  void RecordPause() { ++pauses_; }
+
+  /// @brief 是否超出全局预算
+  bool over_limit() const {
+    long long limit = limit_;
+    return limit > 0 && used_ > limit;
+  }
+  /// @brief 当前占用字节数
+  long long used() const { return used_; }
+  /// @brief 全局预算(0为不限制)
+  long long limit() const { return limit_; }
+  void set_limit(long long limit) { limit_ = limit; }
+
+  /**
+   * @brief 获取统计信息
+   *
+   * @return MemoryStats 统计信息
+   */
+  MemoryStats stats() const;
+
+ private:
+  std::atomic<long long> limit_;
+  std::atomic<long long> used_{0};
+  std::atomic<long long> peak_{0};
+  std::atomic<long long> categories_[kMemoryCategoryCount] = {};
+  /// @brief 各工作线程的占用, 下标0为其它线程
+  std::vector<std::atomic<long long>> workers_;
+
+  /// @brief 保护回收函数列表, 回收期间持有
+  std::mutex mutex_;
+  std::map<int, Reclaimer> reclaimers_;
+  int next_id_ = 1;
+  /// @brief 正在回收, 回收函数释放内存时不再触发回收
+  std::atomic<bool> reclaiming_{false};
+
+  std::atomic<long long> reclaimed_{0};
+  std::atomic<long long> shed_{0};
+  std::atomic<long long> pauses_{0};
+};
+
+/**
+ * @brief 单个连接的内存记账
+ *
+ * @details
+ * 连接在自己的事件循环线程中更新当前用量, 变化量记到全局预算上,
+ * 对象销毁时释放全部用量
+ */
+class CROSSOCEAN_API MemoryAccount {
+ public:
+  MemoryAccount() {}
+  ~MemoryAccount() { Update(0); }
+
+  MemoryAccount(const MemoryAccount&) = delete;
+  MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+  /**
+   * @brief 关联全局预算
+   *
+   * @param budget 全局预算, 为`nullptr`时只在本地记账
+   * @param category 用途
+   * @param worker 所属工作线程编号
+   * @param limit 连接的预算(字节), 0为不限制
+   */
+  void Attach(MemoryBudget* budget, MemoryCategory category, int worker,
+              long long limit);
+
+  /**
+   * @brief 更新当前用量
+   *
+   * @param bytes 当前占用的字节数
+   */
+  void Update(long long bytes);
+
+  /// @brief 当前占用字节数
+  long long used() const { return used_; }
+  /// @brief 连接的预算(0为不限制)
+  long long limit() const { return limit_; }
+  /// @brief 是否超出连接的预算
+  bool over() const { return limit_ > 0 && used_ > limit_; }
+
+ private:
+  MemoryBudget* budget_ = nullptr;
+  MemoryCategory category_ = MemoryCategory::kBuffer;
+  int worker_ = 0;
+  long long limit_ = 0;
+  long long used_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // MEMORY_BUDGET_H
@@ -0,0 +1,230 @@
+﻿/**
+ * @file meta_index.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `MetaIndex`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef META_INDEX_H
+#define META_INDEX_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chunker.h"
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+class BlockingPool;
+
+/**
+ * @brief 文件元数据
+ */
+struct CROSSOCEAN_API FileMeta {
+  /// @brief 文件路径(索引键)
+  std::string path;
+  /// @brief 文件大小
+  long long size = 0;
+  /// @brief 修改时间(纳秒)
+  long long mtime_ns = 0;
+  /// @brief 整个文件的CRC32C校验和
+  uint32_t checksum = 0;
+  /// @brief 块映射, 块哈希为SHA-256(十六进制), 偏移由长度依次累加得到
+  std::vector<ChunkRef> chunks;
+};
+
+/**
+ * @brief 元数据索引统计信息
+ */
+struct CROSSOCEAN_API MetaIndexStats {
+  long long snapshot_records = 0;  ///< 快照中的记录数
+  long long log_records = 0;       ///< 当前变更日志中的记录数
+  long long replayed = 0;          ///< 启动时重放的日志记录数
+  long long compactions = 0;       ///< 完成的合并次数
+};
+
+/**
+ * @brief 持久化的文件元数据索引
+ *
+ * @details
+ * 索引由两部分组成:
+ * - 快照`<dir>/meta.snap`: 开放寻址哈希表(每个槽16字节: 路径哈希和记录偏移)
+ *   加紧凑编码的记录, 启动时直接`mmap`, 不需要解析或逐条插入;
+ * - 变更日志`<dir>/meta.log`: 每次修改追加一条带CRC32C的记录,
+ *   启动时重放到内存中的覆盖表, 末尾写了一半的记录被截断.
+ * 查找依次检查覆盖表和快照哈希表, 快照中按槽线性探测, 通常只访问一两个缓存行.
+ * 日志记录数达到阈值后在阻塞I/O线程池中合并: 把当前日志改名冻结,
+ * 新的修改写入新日志, 后台把快照和冻结的覆盖表合并为新快照后原子替换.
+ * 日志记录是完整的状态, 重复重放结果不变, 合并中途崩溃后重启可以正确恢复.
+ * 线程安全
+ */
+class CROSSOCEAN_API MetaIndex {
+ public:
+  /**
+   * @brief 构造元数据索引
+   *
+   * @param dir 索引目录
+   * @param pool 执行合并的阻塞I/O线程池, 为`nullptr`时在调用线程中合并
+   * @param compact_records 日志记录数达到该值时合并, 小于等于0表示不自动合并
+   */
+  MetaIndex(const std::string& dir, BlockingPool* pool = nullptr,
+            long long compact_records = 1000000);
+
+  /**
+   * @brief 等待进行中的合并完成后关闭索引
+   */
+  ~MetaIndex();
+
+  /**
+   * @brief 打开索引: 映射快照并重放变更日志
+   *
+   * @return true 成功
+   * @return false 创建目录、快照格式错误或打开日志失败
+   */
+  bool Open();
+
+  /**
+   * @brief 添加或替换文件元数据
+   *
+   * @param meta 文件元数据
+   * @return true 成功
+   * @return false 路径为空、块哈希格式错误或写入日志失败
+   */
+  bool Put(const FileMeta& meta);
+
+  /**
+   * @brief 删除文件元数据
+   *
+   * @param path 文件路径
+   * @return true 成功(路径不存在时也返回true)
+   * @return false 写入日志失败
+   */
+  bool Remove(const std::string& path);
+
+  /**
+   * @brief 查找文件元数据
+   *
+   * @param path 文件路径
+   * @param meta 输出文件元数据(块偏移已计算)
+   * @return true 找到
+   * @return false 不存在
+   */
+  bool Lookup(const std::string& path, FileMeta* meta) const;
+
+  /**
+   * @brief 把变更日志刷到磁盘(`fdatasync`)
+   *
+   * @return true 成功
+   * @return false 刷写失败
+   */
+  bool Sync();
+
+  /**
+   * @brief 立即合并快照和变更日志(阻塞), 已有合并进行中时等待其完成
+   *
+   * @return true 成功
+   * @return false 写入新快照失败
+   */
+  bool Compact();
+
+  /**
+   * @brief 等待后台合并完成
+   */
+  void WaitCompaction();
+
+  /**
+   * @brief 遍历所有文件元数据(顺序不确定)
+   *
+   * @param fn 回调函数
+   */
+  void ForEach(const std::function<void(const FileMeta&)>& fn) const;
+
+  /// @brief 文件数量
+  long long size() const;
+  /// @brief 统计信息
+  MetaIndexStats stats() const;
+
+ private:
+  struct Snapshot;
+  using Overlay = std::unordered_map<std::string, std::shared_ptr<FileMeta>>;
+
+  /**
+   * @brief 重放变更日志到覆盖表, 截断末尾不完整的记录
+   *
+   * @param path 日志路径
+   * @param overlay 覆盖表
+   * @return long long 重放的记录数, 读取失败返回-1
+   */
+  long long Replay(const std::string& path, Overlay* overlay);
+
+  /**
+   * @brief 追加一条变更记录(需持有`mutex_`)
+   *
+   * @param record 编码后的记录
+   * @return true 成功
+   * @return false 写入失败
+   */
+  bool Append(const std::string& record);
+
+  /**
+   * @brief 在覆盖表和快照中查找(需持有`mutex_`)
+   *
+   * @param path 文件路径
+   * @param meta 输出文件元数据, 可以为`nullptr`
+   * @return true 找到
+   * @return false 不存在
+   */
+  bool Find(const std::string& path, FileMeta* meta) const;
+
+  /**
+   * @brief 冻结当前日志并启动合并(需持有`mutex_`)
+   *
+   * @param lock 持有的锁, 合并在调用线程中执行时临时释放
+   * @return true 已启动(或已完成)
+   * @return false 冻结日志失败
+   */
+  bool StartCompaction(std::unique_lock<std::mutex>& lock);
+
+  /**
+   * @brief 把快照和冻结的覆盖表写为新快照并替换(不持有锁)
+   *
+   * @return true 成功
+   * @return false 写入失败
+   */
+  bool RunCompaction();
+
+  std::string dir_;
+  BlockingPool* pool_;
+  long long compact_records_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable compacted_;
+  /// @brief 当前快照
+  std::shared_ptr<const Snapshot> snapshot_;
+  /// @brief 当前日志的修改
+  Overlay active_;
+  /// @brief 合并中的日志的修改, 合并期间不再改变
+  std::shared_ptr<const Overlay> frozen_;
+  /// @brief 当前日志的文件描述符
+  int log_fd_ = -1;
+  /// @brief 是否正在合并
+  bool compacting_ = false;
+  /// @brief 上一次合并是否成功
+  bool compact_ok_ = true;
+
+  long long count_ = 0;
+  MetaIndexStats stats_;
+};
+
+END_NAMESPACE
+
+#endif  // META_INDEX_H
@@ -0,0 +1,300 @@
+﻿/**
+ * @file rate_limiter.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `TokenBucket`、`RateLimiter`和`WriteThrottle`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "crossocean.h"
+
+struct bufferevent;
+struct evbuffer_cb_entry;
+struct event;
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 令牌桶, 按字节限速
+ *
+ * @details 线程安全, 可以被多个`Thread`中的连接共享
+ */
+class CROSSOCEAN_API TokenBucket {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief 构造令牌桶, 初始为满桶
+   *
+   * @param rate 每秒补充的字节数, 小于等于0表示不限速
+   * @param burst 桶容量(允许的突发字节数), 小于等于0时取`rate`
+   */
+  TokenBucket(long long rate, long long burst);
+
+  /**
+   * @brief 修改限速参数
+   *
+   * @param rate 每秒补充的字节数, 小于等于0表示不限速
+   * @param burst 桶容量, 小于等于0时取`rate`
+   */
+  void Reset(long long rate, long long burst);
+
+  /**
+   * @brief 申请发送字节数
+   *
+   * @param bytes 希望发送的字节数
+   * @param now 当前时间
+   * @return long long 实际允许发送的字节数(0 ~ bytes), 已从桶中扣除
+   */
+  long long Acquire(long long bytes, Clock::time_point now);
+  long long Acquire(long long bytes) { return Acquire(bytes, Clock::now()); }
+
+  /**
+   * @brief 归还未使用的字节数
+   *
+   * @param bytes 归还的字节数
+   */
+  void Refund(long long bytes);
+
+  /**
+   * @brief 计算积累到`bytes`个令牌需要等待的时间
+   *
+   * @param bytes 需要的字节数
+   * @param now 当前时间
+   * @return std::chrono::microseconds 等待时间, 令牌足够时为0
+   */
+  std::chrono::microseconds Delay(long long bytes, Clock::time_point now);
+
+ private:
+  /**
+   * @brief 按流逝的时间补充令牌(需持有`mutex_`)
+   *
+   * @param now 当前时间
+   */
+  void Refill(Clock::time_point now);
+
+  std::mutex mutex_;
+  /// @brief 每秒补充的字节数
+  long long rate_ = 0;
+  /// @brief 桶容量
+  long long burst_ = 0;
+  /// @brief 当前令牌数
+  double tokens_ = 0;
+  /// @brief 上次补充令牌的时间
+  Clock::time_point last_;
+};
+
+/**
+ * @brief 单个连接的限速句柄
+ *
+ * @details
+ * 由`RateLimiter::Register`创建, 持有连接自己的令牌桶以及所属客户端IP的令牌桶,
+ * 同一IP的多个连接共享同一个IP令牌桶
+ */
+struct CROSSOCEAN_API RateLimitHandle {
+  /// @brief 客户端IP
+  std::string ip;
+  /// @brief 连接令牌桶
+  std::unique_ptr<TokenBucket> connection;
+  /// @brief IP令牌桶(多个连接共享)
+  std::shared_ptr<TokenBucket> client;
+};
+
+/**
+ * @brief 分层限速器: 连接 -> 客户端IP -> 全局
+ *
+ * @details
+ * 发送路径在把数据交给内核之前(包括`sendfile`等零拷贝发送)调用`Acquire`
+ * 申请字节数, 只发送被允许的部分, 剩余部分按`Delay`给出的时间等待后重试.
+ * 每次申请最多分配`quantum`字节, 使共享全局令牌的连接轮流发送,
+ * 避免个别连接一次占满全局带宽
+ */
+class CROSSOCEAN_API RateLimiter {
+ public:
+  using Clock = TokenBucket::Clock;
+
+  /**
+   * @brief 获取进程内全局的`RateLimiter`对象
+   *
+   * @return RateLimiter* 全局限速器
+   */
+  static RateLimiter* GetInstance() {
+    static RateLimiter instance;
+    return &instance;
+  }
+
+  RateLimiter();
+
+  /**
+   * @brief 设置全局限速
+   *
+   * @param rate 每秒字节数, 小于等于0表示不限速
+   * @param burst 突发字节数
+   */
+  void SetGlobalLimit(long long rate, long long burst);
+
+  /**
+   * @brief 设置每个客户端IP的限速, 对之后注册的IP生效
+   *
+   * @param rate 每秒字节数, 小于等于0表示不限速
+   * @param burst 突发字节数
+   */
+  void SetClientLimit(long long rate, long long burst);
+
+  /**
+   * @brief 设置每个连接的限速, 对之后注册的连接生效
+   *
+   * @param rate 每秒字节数, 小于等于0表示不限速
+   * @param burst 突发字节数
+   */
+  void SetConnectionLimit(long long rate, long long burst);
+
+  /**
+   * @brief 设置单次申请最多分配的字节数
+   *
+   * @param quantum 字节数, 小于等于0表示不限制
+   */
+  void set_quantum(long long quantum) { quantum_ = quantum; }
+
+  /**
+   * @brief 注册一个新连接
+   *
+   * @param ip 客户端IP
+   * @return std::shared_ptr<RateLimitHandle> 连接的限速句柄
+   */
+  std::shared_ptr<RateLimitHandle> Register(const std::string& ip);
+
+  /**
+   * @brief 为连接申请发送字节数
+   *
+   * @details 依次扣除全局、IP、连接令牌, 多扣除的部分归还上一层
+   *
+   * @param handle 连接限速句柄
+   * @param bytes 希望发送的字节数
+   * @param now 当前时间
+   * @return long long 允许发送的字节数(0 ~ bytes)
+   */
+  long long Acquire(RateLimitHandle* handle, long long bytes,
+                    Clock::time_point now);
+  long long Acquire(RateLimitHandle* handle, long long bytes) {
+    return Acquire(handle, bytes, Clock::now());
+  }
+
+  /**
+   * @brief 计算连接发送`bytes`字节需要等待的时间
+   *
+   * @param handle 连接限速句柄
+   * @param bytes 希望发送的字节数
+   * @param now 当前时间
+   * @return std::chrono::microseconds 等待时间
+   */
+  std::chrono::microseconds Delay(RateLimitHandle* handle, long long bytes,
+                                  Clock::time_point now);
+
+  /**
+   * @brief 获取当前有活动连接的客户端IP数量
+   */
+  int client_count();
+
+ private:
+  /// @brief 全局令牌桶
+  TokenBucket global_;
+
+  std::mutex mutex_;
+  /// @brief 客户端IP令牌桶, 最后一个连接关闭后自动释放
+  std::map<std::string, std::weak_ptr<TokenBucket>> clients_;
+  /// @brief 每个IP的限速参数
+  long long client_rate_ = 0;
+  long long client_burst_ = 0;
+  /// @brief 每个连接的限速参数
+  long long connection_rate_ = 0;
+  long long connection_burst_ = 0;
+  /// @brief 单次申请最多分配的字节数
+  std::atomic<long long> quantum_{0};
+};
+
+/**
+ * @brief 按连接的限速句柄控制`bufferevent`的发送
+ *
+ * @details
+ * 在发送缓冲区上注册回调, 统计libevent实际交给内核的字节数(包括`sendfile`).
+ * 每次写入不超过已申请的令牌数; 令牌用完时停止写入, 按`Delay`给出的时间
+ * 设置定时器, 到期后重新申请. `sendfile`的一块可能超出已申请的令牌数,
+ * 超出的部分记为欠账, 之后先补足欠账; 调用者按`kQuantum`分段加入文件,
+ * 使欠账不超过一段. 只能在`bufferevent`所属的事件循环
+ * 线程中使用, 释放`bufferevent`之前先销毁
+ */
+class CROSSOCEAN_API WriteThrottle {
+ public:
+  /// @brief 每次申请的令牌数, 也是单次写入的上限
+  static constexpr long long kQuantum = 64 * 1024;
+
+  /**
+   * @brief 构造发送限速
+   *
+   * @param limiter 限速器
+   * @param handle 连接的限速句柄, 同一连接的多个`bufferevent`可以共享
+   */
+  WriteThrottle(RateLimiter* limiter, std::shared_ptr<RateLimitHandle> handle);
+  ~WriteThrottle();
+
+  WriteThrottle(const WriteThrottle&) = delete;
+  WriteThrottle& operator=(const WriteThrottle&) = delete;
+
+  /**
+   * @brief 开始控制`bufferevent`的发送
+   *
+   * @param bev 已启用写入的`bufferevent`
+   */
+  void Attach(::bufferevent* bev);
+
+  /**
+   * @brief 发送缓冲区的数据交给内核后调用: 扣除已发送的字节数
+   *
+   * @param bytes 交给内核的字节数
+   */
+  void OnSent(long long bytes);
+
+  /**
+   * @brief 等待令牌的定时器到期后调用: 重新申请令牌
+   */
+  void OnTimer() { Refill(); }
+
+  /// @brief 已发送的字节数
+  long long sent() const { return sent_; }
+  /// @brief 因令牌用完停止写入的次数
+  long long stalls() const { return stalls_; }
+
+ private:
+  /**
+   * @brief 申请令牌, 不足时停止写入并设置定时器
+   */
+  void Refill();
+
+  RateLimiter* limiter_;
+  std::shared_ptr<RateLimitHandle> handle_;
+  ::bufferevent* bev_ = nullptr;
+  ::evbuffer_cb_entry* entry_ = nullptr;
+  ::event* timer_ = nullptr;
+  /// @brief 已申请未使用的令牌数, 小于0为欠账
+  long long allowance_ = 0;
+  /// @brief 是否因令牌用完停止了写入
+  bool stalled_ = false;
+  long long sent_ = 0;
+  long long stalls_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // RATE_LIMITER_H
@@ -0,0 +1,154 @@
+﻿/**
+ * @file readahead.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ReadaheadStream`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include "crossocean.h"
+#include "file_cache.h"
+
+CROSSOCEAN_NAMESPACE
+
+class BlockingPool;
+
+/**
+ * @brief 预读参数
+ */
+struct CROSSOCEAN_API ReadaheadOptions {
+  /// @brief 最小预读窗口(字节), 尚未测出发送速率时使用
+  long long min_window = 256 * 1024;
+  /// @brief 最大预读窗口(字节)
+  long long max_window = 32 * 1024 * 1024;
+  /// @brief 预读量覆盖的发送时间(毫秒), 窗口 = 发送速率 x 该时间
+  int lead_ms = 500;
+  /// @brief 连续多少次顺序发送后开始预读
+  int sequential_trigger = 2;
+  /// @brief 是否释放已发送部分的页缓存, 多个连接共享的热点文件应关闭
+  bool drop_behind = true;
+  /// @brief 发送位置之前保留不释放的字节数
+  long long keep_behind = 1024 * 1024;
+};
+
+/**
+ * @brief 预读统计信息
+ */
+struct CROSSOCEAN_API ReadaheadStats {
+  long long prefetches = 0;        ///< 发起预读的次数
+  long long prefetched_bytes = 0;  ///< 预读的字节数
+  long long releases = 0;          ///< 释放页缓存的次数
+  long long released_bytes = 0;    ///< 释放的字节数
+  long long skipped = 0;           ///< 上一次预读未完成而跳过的次数
+};
+
+/**
+ * @brief 单个下载流的自适应预读
+ *
+ * @details
+ * 内核默认的预读窗口较小, 从磁盘阵列顺序下载大文件时连接经常停下来等待缺页.
+ * 下载任务每次发送文件数据后调用`OnSend`, `ReadaheadStream`据此判断访问模式:
+ * 连续的顺序发送达到`sequential_trigger`次后, 在阻塞I/O线程池中对发送位置之后
+ * 的区间发起预读(`readahead`/`posix_fadvise(WILLNEED)`), 预读窗口按测得的
+ * 发送速率覆盖`lead_ms`毫秒的发送量; 已发送的部分用`posix_fadvise(DONTNEED)`
+ * 释放, 避免大文件顺序扫描冲掉其它文件的页缓存. 跳转发送(随机访问)时停止预读.
+ * 每个流只由所属`Thread`访问, 不是线程安全的. 预读工作持有`OpenFilePtr`,
+ * 流销毁后文件描述符也会保持打开直到工作完成
+ */
+class CROSSOCEAN_API ReadaheadStream {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief 构造下载流的预读状态
+   *
+   * @param pool 执行预读的阻塞I/O线程池, 为`nullptr`时在调用线程中直接执行
+   * @param file 发送的文件
+   * @param options 预读参数
+   */
+  ReadaheadStream(BlockingPool* pool, OpenFilePtr file,
+                  const ReadaheadOptions& options = ReadaheadOptions());
+
+  /**
+   * @brief 记录一次文件发送, 按需发起预读和释放
+   *
+   * @param offset 发送的起始偏移
+   * @param length 发送的字节数
+   * @param now 当前时间
+   */
+  void OnSend(long long offset, long long length, Clock::time_point now);
+  void OnSend(long long offset, long long length) {
+    OnSend(offset, length, Clock::now());
+  }
+
+  /// @brief 当前是否判定为顺序访问
+  bool sequential() const {
+    return sequential_count_ >= options_.sequential_trigger;
+  }
+  /// @brief 测得的发送速率(字节/秒), 尚未测出时为0
+  long long send_rate() const { return static_cast<long long>(rate_); }
+  /// @brief 当前的预读窗口(字节)
+  long long window() const;
+  /// @brief 已发起预读的区间末尾
+  long long prefetched_end() const { return prefetched_end_; }
+  /// @brief 统计信息
+  const ReadaheadStats& stats() const { return stats_; }
+  /// @brief 发送的文件
+  const OpenFilePtr& file() const { return file_; }
+
+ private:
+  /// @brief 文件建议类型
+  enum class Advice { kWillNeed, kDontNeed };
+
+  /**
+   * @brief 在阻塞I/O线程池中对区间执行文件建议
+   *
+   * @param advice 建议类型
+   * @param offset 区间起始偏移
+   * @param length 区间长度
+   * @return true 已提交
+   * @return false 上一次预读尚未完成, 本次跳过
+   */
+  bool Advise(Advice advice, long long offset, long long length);
+
+  /**
+   * @brief 按发送的字节数更新发送速率
+   */
+  void UpdateRate(long long length, Clock::time_point now);
+
+  BlockingPool* pool_;
+  OpenFilePtr file_;
+  ReadaheadOptions options_;
+
+  /// @brief 下一次顺序发送的预期偏移
+  long long next_offset_ = -1;
+  /// @brief 连续顺序发送的次数
+  int sequential_count_ = 0;
+  /// @brief 已发起预读的区间末尾
+  long long prefetched_end_ = 0;
+  /// @brief 已释放页缓存的区间末尾
+  long long released_end_ = 0;
+
+  /// @brief 发送速率(字节/秒, 指数加权平均)
+  double rate_ = 0;
+  /// @brief 当前采样周期的开始时间
+  Clock::time_point sample_start_;
+  /// @brief 当前采样周期内发送的字节数
+  long long sample_bytes_ = 0;
+
+  /// @brief 未完成的预读数量, 与预读工作共享
+  std::shared_ptr<std::atomic<int>> inflight_;
+  ReadaheadStats stats_;
+};
+
+END_NAMESPACE
+
+#endif  // READAHEAD_H
@@ -0,0 +1,460 @@
+﻿/**
+ * @file replication.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ReplicaServer`和`ChainClient`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "block_cache.h"
+#include "blocking_pool.h"
+#include "compression.h"
+#include "crossocean.h"
+#include "file_cache.h"
+#include "frame.h"
+#include "memory_budget.h"
+#include "rate_limiter.h"
+#include "readahead.h"
+#include "shard_map.h"
+#include "thread_pool.h"
+
+CROSSOCEAN_NAMESPACE
+
+class Thread;
+class ServerTask;
+class ChainTask;
+
+/**
+ * @brief 副本节点参数
+ */
+struct CROSSOCEAN_API ReplicaOptions {
+  /// @brief 监听端口
+  int port = 0;
+  /// @brief 数据根目录
+  std::string root;
+  /// @brief 本节点在分片表中的地址(`IP:端口`), 集群模式需要
+  std::string address;
+  /// @brief 处理连接的事件循环线程数
+  int threads = 2;
+  /// @brief 执行阻塞I/O(如追赶时读取整个文件计算校验和)的线程数
+  int blocking_threads = 2;
+  /// @brief 每写入多少字节向上游发送一次进度确认
+  long long ack_bytes = 1024 * 1024;
+  /// @brief 分块校验和的块大小, 追赶时按块比较
+  size_t chunk_size = 1024 * 1024;
+  /// @brief 下游发送缓冲区超过该值时暂停读取上游, 降到一半时恢复
+  size_t high_water = 8 * 1024 * 1024;
+  /// @brief 事件循环线程的忙等待参数(默认不自旋)
+  BusyPollOptions busy_poll;
+  /// @brief 全局内存预算(字节, 0为不限制), 超出时拒绝新连接并回收缓存
+  long long memory_limit = 0;
+  /// @brief 单个连接待发送数据的预算(字节, 0为不限制),
+  /// 超出时暂停读取该连接的请求, 降到一半时恢复
+  long long connection_memory = 32 * 1024 * 1024;
+  /// @brief 读取请求使用的块缓存容量(字节, 0为不使用缓存, 直接`sendfile`),
+  /// 缓存占用记在内存预算上, 超出预算时被回收
+  size_t cache_capacity = 0;
+  /// @brief 读取请求缓存的文件描述符数量上限, 重复读取同一文件时不再
+  /// `open`+`fstat`; 节点自己提交或移出文件时失效, 其它进程的修改在
+  /// 重新`stat`校验(1秒)后发现
+  int open_files = 1024;
+  /// @brief 是否对顺序读取的连接自适应预读, 每个连接跟踪最近读取的文件
+  bool readahead = true;
+  /// @brief 预读参数, 多个连接读取同一热点文件时应关闭`drop_behind`
+  ReadaheadOptions readahead_options;
+  /// @brief 同时压缩读取数据的最大数量(0为不压缩), 压缩在阻塞I/O线程中执行,
+  /// 名额不足的数据块以原文发送
+  int compression_workers = 1;
+  /// @brief 每秒最多压缩的字节数(0为不限制)
+  long long compression_rate = 0;
+  /// @brief 压缩级别, 0为算法默认级别
+  int compression_level = 0;
+  /// @brief 每个连接的发送限速(字节/秒, 0为不限速);
+  /// 节点转发给下游的数据合计也按该值限速
+  long long connection_rate = 0;
+  /// @brief 每个客户端IP的发送限速(字节/秒, 0为不限速), 同一IP的连接共享
+  long long client_rate = 0;
+  /// @brief 节点总的发送限速(字节/秒, 0为不限速)
+  long long total_rate = 0;
+};
+
+/**
+ * @brief 副本节点统计信息
+ */
+struct CROSSOCEAN_API ReplicaStats {
+  long long puts = 0;              ///< 提交的文件数
+  long long put_bytes = 0;         ///< 写入本地的字节数
+  long long forwarded_bytes = 0;   ///< 转发给下游的字节数
+  long long syncs = 0;             ///< 响应的追赶请求数
+  long long sync_bytes = 0;        ///< 追赶时发送的数据字节数
+  long long errors = 0;            ///< 失败的写入数
+  long long redirects = 0;         ///< 重定向的请求数
+  long long moved_files = 0;       ///< 再平衡时移出的文件数
+  long long moved_bytes = 0;       ///< 再平衡时移出的字节数
+  long long rebalances = 0;        ///< 完成的再平衡轮数
+  long long prefetched_bytes = 0;  ///< 读取请求预读的字节数
+};
+
+/**
+ * @brief 链式复制的副本节点
+ *
+ * @details
+ * 客户端把文件上传到链首(主节点), 同时给出后续副本的地址列表.
+ * 每个节点收到`kPutBegin`后连接链上的下一个节点并转发去掉自己的链,
+ * 之后每收到一块`kPutData`就写入本地临时文件并立即原样转发给下游,
+ * 不等整个文件到达, 整条链的传输时间接近单个节点. 确认沿链反向传回:
+ * 节点向上游确认的偏移是本地已写入和下游已确认中较小的一个,
+ * 收到`kPutEnd`后校验CRC32C, 下游也提交后把临时文件改名为正式文件,
+ * 保存分块校验和(`ChunkCrc`边车文件)并向上游发送`kCommitted`.
+ * 客户端也可以在多个连接上用`kWriteAt`并行写入区间, 最后发送`kCommit`,
+ * 同一次上传的区间带有客户端选择的上传ID, 写入按上传ID区分的临时文件,
+ * 节点在阻塞I/O线程中校验整个文件的CRC32C并保存分块校验和后提交.
+ * 任何节点失败时错误沿链传回客户端. 下游较慢时暂停读取上游, 反压传到客户端.
+ * 落后或损坏的副本用`CatchUp`从其它节点追赶: 发送本地的分块校验和,
+ * 源节点只把不一致的块用`sendfile`发回.
+ * 地址使用数字形式的`IP:端口`. 节点使用自己的事件循环线程, 不依赖全局线程池.
+ *
+ * 集群模式: 设置分片表(`ShardMap`)后, 不归本节点的写入和读取返回
+ * `kRedirect`和本节点的分片表, 客户端更新分片表后直接访问归属节点.
+ * 分片表更新时后台线程扫描数据目录, 把不再归本节点的文件以`kPutIfAbsent`
+ * 写入新的归属节点(不覆盖期间客户端写入的新版本), 提交后删除本地文件.
+ *
+ * 内存: 连接对象和收发缓冲区按所属线程记在节点的内存预算上.
+ * 读取慢的客户端使连接待发送的数据超出`connection_memory`时暂停读取它的请求;
+ * 全局超出`memory_limit`时先回收关联到预算的缓存(包括读取使用的块缓存),
+ * 再拒绝新连接,
+ * 有待发送数据的连接暂停读取直到发送完
+ *
+ * 限速: 设置`connection_rate`等参数后, 接入连接时按客户端IP注册限速句柄,
+ * 连接发给上游的数据(包括`sendfile`)按连接 -> IP -> 节点三层令牌桶限速;
+ * 转发给下游的数据使用节点自己的限速句柄, 不占用客户端连接的令牌
+ *
+ * 压缩: `kPutBegin`和`kReadAt`可以带上客户端支持的压缩算法列表,
+ * 节点用`Compression::Negotiate`选出算法. 写入时节点先回复带算法名的
+ * `kProgress`确认, 之后的`kPutData`是`ChunkEncoder`编码的数据块,
+ * 节点解码后写入并原样转发(下游使用同一算法); 读取时节点在阻塞I/O线程中
+ * 读取区间并压缩, `kData`中带有选中的算法. 压缩名额和速率受压缩预算限制
+ */
+class CROSSOCEAN_API ReplicaServer {
+ public:
+  /**
+   * @brief 构造副本节点
+   *
+   * @param options 节点参数
+   */
+  explicit ReplicaServer(const ReplicaOptions& options);
+
+  /**
+   * @brief 停止节点, 见`Stop`
+   */
+  ~ReplicaServer();
+
+  /**
+   * @brief 启动事件循环线程并开始监听
+   *
+   * @return true 成功
+   * @return false 参数错误或创建目录失败
+   */
+  bool Start();
+
+  /**
+   * @brief 停止节点(阻塞)
+   *
+   * @details 停止再平衡线程, 在事件循环线程中关闭监听, 等待阻塞I/O完成,
+   * 再关闭所有连接(未提交的写入被丢弃), 然后停止并释放事件循环线程.
+   * 可以重复调用
+   */
+  void Stop();
+
+  /**
+   * @brief 把新连接分发给事件循环线程(由监听回调调用)
+   *
+   * @param sock 新连接的socket
+   * @param rate_limit 连接的限速句柄, 不限速时为空
+   */
+  void Accept(int sock,
+              std::shared_ptr<RateLimitHandle> rate_limit = nullptr);
+
+  /**
+   * @brief 从源节点追赶一个文件(阻塞)
+   *
+   * @details 按`chunk_size`计算本地文件的分块校验和发给源节点,
+   * 写入源节点发回的不一致的块, 截断到源文件大小后重新校验全部块
+   *
+   * @param root 本地数据根目录
+   * @param path 相对根目录的文件路径
+   * @param source 源节点地址(`IP:端口`)
+   * @param chunk_size 分块大小, 需与源节点一致
+   * @param fetched 输出从源节点接收的数据字节数, 可以为`nullptr`
+   * @return true 追赶完成, 本地文件与源文件一致
+   * @return false 连接失败、源文件不存在或校验失败
+   */
+  static bool CatchUp(const std::string& root, const std::string& path,
+                      const std::string& source, size_t chunk_size,
+                      long long* fetched);
+
+  /**
+   * @brief 检查相对路径是否合法(非空、非绝对路径、不含`..`)
+   */
+  static bool ValidPath(const std::string& path);
+
+  /**
+   * @brief 设置分片表并触发再平衡
+   *
+   * @param map 分片表
+   * @return true 成功
+   * @return false 未配置本节点地址或版本不比当前的新
+   */
+  bool SetShardMap(const ShardMap& map);
+
+  /// @brief 当前分片表, 未设置时为`nullptr`
+  std::shared_ptr<const ShardMap> shard_map() const;
+
+  /// @brief 节点参数
+  const ReplicaOptions& options() const { return options_; }
+  /// @brief 统计信息
+  ReplicaStats stats() const;
+  /// @brief 内存统计信息(按用途和事件循环线程)
+  MemoryStats memory_stats() const { return memory_.stats(); }
+  /// @brief 内存预算, 缓存可以关联到该预算, 超出时被回收
+  MemoryBudget* memory() { return &memory_; }
+  /// @brief 读取请求使用的块缓存, 未启用时为`nullptr`
+  BlockCache* cache() { return cache_.get(); }
+  /// @brief 读取请求打开的文件的缓存
+  FileCache* files() { return &files_; }
+
+ private:
+  friend class ChainTask;
+
+  /**
+   * @brief 再平衡线程入口: 分片表更新后扫描数据目录
+   */
+  void Main();
+
+  /**
+   * @brief 把不归本节点的文件移到归属节点
+   *
+   * @param map 分片表
+   * @return true 全部移完
+   * @return false 有文件移动失败或扫描期间分片表已更新
+   */
+  bool Rebalance(const ShardMap& map);
+
+  /**
+   * @brief 准入检查: 超出全局内存预算时拒绝新连接
+   *
+   * @param user_arg `ReplicaServer`对象指针
+   */
+  static bool AdmitMemory(void* user_arg);
+
+  /// @brief 统计计数, 由各连接的事件循环线程更新
+  struct Counters {
+    std::atomic<long long> puts{0};
+    std::atomic<long long> put_bytes{0};
+    std::atomic<long long> forwarded_bytes{0};
+    std::atomic<long long> syncs{0};
+    std::atomic<long long> sync_bytes{0};
+    std::atomic<long long> errors{0};
+    std::atomic<long long> redirects{0};
+    std::atomic<long long> moved_files{0};
+    std::atomic<long long> moved_bytes{0};
+    std::atomic<long long> rebalances{0};
+    std::atomic<long long> prefetched_bytes{0};
+  };
+
+  ReplicaOptions options_;
+  /// @brief 事件循环线程
+  std::vector<Thread*> threads_;
+  /// @brief 下一个分发连接的线程
+  std::atomic<unsigned> next_thread_{0};
+  /// @brief 下一个链式写入的编号, 区分同一文件同时进行的写入的临时文件
+  std::atomic<unsigned long long> next_upload_{0};
+  /// @brief 监听任务
+  ServerTask* listen_task_ = nullptr;
+  /// @brief 各事件循环线程上的连接(下标为线程编号减一), 只在所属线程中访问
+  std::vector<std::unordered_set<ChainTask*>> connections_;
+  /// @brief 正在停止, 之后开始的连接直接关闭
+  std::atomic<bool> stopped_{false};
+  /// @brief 阻塞I/O线程池, 完成回调投递回连接所在的事件循环线程
+  BlockingPool blocking_;
+  Counters counters_;
+  /// @brief 内存预算
+  MemoryBudget memory_;
+  /// @brief 块缓存, 在内存预算之后销毁
+  std::unique_ptr<BlockCache> cache_;
+  /// @brief 读取请求打开的文件
+  FileCache files_;
+  /// @brief 读取数据的压缩预算
+  CompressionBudget compression_;
+  /// @brief 发送限速器, 设置了限速参数时关联到监听任务
+  RateLimiter limiter_;
+  /// @brief 转发给下游节点的限速句柄(所有连接共用), 不限速时为空
+  std::shared_ptr<RateLimitHandle> forward_limit_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  /// @brief 分片表, 事件循环线程读取时复制指针
+  std::shared_ptr<const ShardMap> map_;
+  bool stopping_ = false;
+  /// @brief 再平衡线程, 第一次设置分片表时启动
+  std::thread rebalancer_;
+};
+
+/**
+ * @brief 链式写入的客户端(阻塞)
+ *
+ * @details 用于测试和命令行工具, 一个连接上可以依次写入多个文件
+ */
+class CROSSOCEAN_API ChainClient {
+ public:
+  ChainClient() {}
+  ~ChainClient();
+
+  /**
+   * @brief 连接链首节点
+   *
+   * @param address 节点地址(`IP:端口`)
+   * @return true 成功
+   * @return false 连接失败
+   */
+  bool Connect(const std::string& address);
+
+  /**
+   * @brief 写入整个文件并等待整条链提交
+   *
+   * @param path 相对根目录的文件路径
+   * @param data 文件内容
+   * @param len 文件大小
+   * @param chain 链首之后的副本地址
+   * @param piece 每条`kPutData`消息的数据大小
+   * @return true 所有副本已提交
+   * @return false 发送失败或某个副本失败
+   */
+  bool Put(const std::string& path, const char* data, size_t len,
+           const std::vector<std::string>& chain, size_t piece = 256 * 1024);
+
+  /**
+   * @brief 开始写入文件
+   *
+   * @param flags `kPutIfAbsent`等标志
+   */
+  bool Begin(const std::string& path, long long size,
+             const std::vector<std::string>& chain, uint8_t flags = 0);
+
+  /**
+   * @brief 发送文件数据(按顺序)
+   */
+  bool Write(const char* data, size_t len, size_t piece = 256 * 1024);
+
+  /**
+   * @brief 结束写入并等待整条链提交
+   */
+  bool End();
+
+  /**
+   * @brief 读取整个文件
+   *
+   * @param path 相对根目录的文件路径
+   * @param data 输出文件内容
+   * @return true 成功
+   * @return false 文件不存在、被重定向或连接断开
+   */
+  bool Get(const std::string& path, std::string* data);
+
+  /**
+   * @brief 获取节点的分片表
+   */
+  bool GetShardMap(ShardMap* map);
+
+  /**
+   * @brief 更新节点的分片表
+   *
+   * @return true 节点接受了分片表
+   * @return false 连接断开或版本不比节点的新
+   */
+  bool SetShardMap(const ShardMap& map);
+
+  /**
+   * @brief 关闭连接
+   */
+  void Close();
+
+  /// @brief 是否已连接
+  bool connected() const { return sock_ >= 0; }
+  /// @brief 最近一次确认的偏移
+  long long acked() const { return acked_; }
+  /// @brief 最近一次请求被重定向时节点返回的分片表(编码), 否则为空
+  const std::string& redirect() const { return redirect_; }
+
+  /**
+   * @brief 设置写入时提供给节点的压缩算法列表
+   *
+   * @details 如`Compression::Supported()`, 空为不压缩(默认).
+   * 节点回复选中的算法之前发送的数据块以原文编码
+   *
+   * @param codecs 按优先顺序以逗号分隔的算法名称
+   * @param level 压缩级别, 0为算法默认级别
+   */
+  void set_codecs(const std::string& codecs, int level = 0) {
+    codecs_ = codecs;
+    level_ = level;
+  }
+  /// @brief 最近一次写入协商得到的压缩算法
+  CompressionCodec codec() const { return codec_; }
+  /// @brief 最近一次写入发送的数据(编码后)字节数
+  long long encoded_bytes() const {
+    return encoder_ ? encoded_base_ + encoder_->encoded_bytes() : offset_;
+  }
+
+ private:
+  /**
+   * @brief 读取已到达的确认(非阻塞), 出错返回false
+   */
+  bool DrainAcks(bool wait_commit);
+
+  /**
+   * @brief 发送请求并等待一条响应(阻塞)
+   */
+  bool Call(FrameType type, const std::string& body, Frame* reply);
+
+  int sock_ = -1;
+  uint32_t next_id_ = 1;
+  uint32_t id_ = 0;
+  long long offset_ = 0;
+  long long acked_ = 0;
+  uint32_t crc_ = 0;
+  bool failed_ = false;
+  /// @brief 节点已提交(跳过写入时提前提交)
+  bool committed_ = false;
+  std::string redirect_;
+  /// @brief 已接收但未解析的数据
+  std::string inbox_;
+
+  /// @brief 提供给节点的压缩算法列表, 空为不压缩
+  std::string codecs_;
+  int level_ = 0;
+  /// @brief 协商得到的压缩算法
+  CompressionCodec codec_ = CompressionCodec::kNone;
+  /// @brief 当前写入的数据块编码器, 不压缩时为空
+  std::unique_ptr<ChunkEncoder> encoder_;
+  /// @brief 更换编码器之前已发送的编码字节数
+  long long encoded_base_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // REPLICATION_H
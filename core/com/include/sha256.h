@@ -0,0 +1,83 @@
+﻿/**
+ * @file sha256.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Sha256`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief SHA-256 摘要计算, 支持流式输入
+ */
+class CROSSOCEAN_API Sha256 {
+ public:
+  /// @brief 摘要长度(字节)
+  static const int kDigestSize = 32;
+
+  Sha256();
+
+  /**
+   * @brief 重新开始计算
+   */
+  void Reset();
+
+  /**
+   * @brief 输入数据
+   *
+   * @param data 数据
+   * @param len 数据长度
+   */
+  void Update(const void* data, size_t len);
+
+  /**
+   * @brief 结束计算, 输出摘要
+   *
+   * @param digest 输出摘要(`kDigestSize`字节)
+   */
+  void Final(unsigned char digest[kDigestSize]);
+
+  /**
+   * @brief 结束计算, 输出十六进制摘要
+   *
+   * @return std::string 64个字符的十六进制摘要
+   */
+  std::string FinalHex();
+
+  /**
+   * @brief 计算数据的十六进制摘要
+   *
+   * @param data 数据
+   * @param len 数据长度
+   * @return std::string 64个字符的十六进制摘要
+   */
+  static std::string Hex(const void* data, size_t len);
+
+ private:
+  /**
+   * @brief 处理一个64字节的分组
+   */
+  void Transform(const unsigned char block[64]);
+
+  uint32_t state_[8];
+  unsigned char buffer_[64];
+  /// @brief 已输入的总字节数
+  uint64_t length_ = 0;
+  /// @brief `buffer_`中的字节数
+  size_t buffered_ = 0;
+};
+
+END_NAMESPACE
+
+#endif  // SHA256_H
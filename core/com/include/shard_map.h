@@ -0,0 +1,114 @@
+﻿/**
+ * @file shard_map.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ShardMap`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef SHARD_MAP_H
+#define SHARD_MAP_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "crossocean.h"
+#include "hash_ring.h"
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 集群的分片表
+ *
+ * @details
+ * 节点按地址(`IP:端口`)和权重放到一致性哈希环上, 文件按规范化后的相对路径
+ * 找到前`replicas`个不同节点: 第一个为主节点, 其余按顺序组成复制链.
+ * 版本号单调递增, 节点和客户端只接受更新的版本. 分片表很小, 整张表随
+ * 重定向一起发给客户端, 客户端之后直接访问归属节点, 数据不经过代理
+ */
+class CROSSOCEAN_API ShardMap {
+ public:
+  /**
+   * @brief 构造空的分片表
+   *
+   * @param vnodes 权重为1的节点放置的虚拟节点数
+   * @param replicas 每个文件的副本数
+   */
+  explicit ShardMap(int vnodes = 128, int replicas = 1);
+
+  /**
+   * @brief 添加节点, 已存在时更新权重
+   *
+   * @param address 节点地址(`IP:端口`)
+   * @param weight 权重
+   * @return true 成功
+   * @return false 地址为空或权重不大于0
+   */
+  bool AddNode(const std::string& address, double weight = 1.0);
+
+  /**
+   * @brief 删除节点
+   *
+   * @param address 节点地址
+   * @return true 成功
+   * @return false 节点不存在
+   */
+  bool RemoveNode(const std::string& address);
+
+  /**
+   * @brief 查找文件的归属节点
+   *
+   * @param path 相对根目录的文件路径
+   * @return std::vector<std::string> 主节点在前的副本地址, 表为空时为空
+   */
+  std::vector<std::string> Owners(const std::string& path) const;
+
+  /**
+   * @brief 判断节点是否为文件的副本之一
+   */
+  bool Owns(const std::string& address, const std::string& path) const;
+
+  /**
+   * @brief 编码为消息体
+   */
+  std::string Encode() const;
+
+  /**
+   * @brief 从消息体解码
+   *
+   * @param data 消息体
+   * @return true 成功
+   * @return false 格式错误
+   */
+  bool Decode(const std::string& data);
+
+  /**
+   * @brief 规范化路径作为哈希的键(去掉`.`和多余的`/`)
+   */
+  static std::string Key(const std::string& path);
+
+  /// @brief 版本号, 0表示未配置
+  uint64_t version() const { return version_; }
+  void set_version(uint64_t version) { version_ = version; }
+  /// @brief 每个文件的副本数
+  int replicas() const { return replicas_; }
+  /// @brief 节点地址和权重
+  const std::vector<std::pair<std::string, double>>& nodes() const {
+    return ring_.nodes();
+  }
+  /// @brief 节点数量
+  int size() const { return ring_.size(); }
+
+ private:
+  uint64_t version_ = 0;
+  int vnodes_;
+  int replicas_;
+  HashRing ring_;
+};
+
+END_NAMESPACE
+
+#endif  // SHARD_MAP_H
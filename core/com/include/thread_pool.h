@@ -19,6 +19,27 @@ CROSSOCEAN_NAMESPACE
 class Thread;
 class Task;
 
+/**
+ * @brief 工作线程的忙等待参数
+ *
+ * @details
+ * 默认工作线程空闲时阻塞在`epoll`中, 由管道唤醒, 每个任务要多经过一次
+ * 写管道、`epoll`返回和读管道. 开启忙等待后, 工作线程处理完事件先在
+ * 一段时间内反复检查任务队列、消息通道并以非阻塞方式运行事件循环,
+ * 这段时间内分发的任务不写管道. 自旋时间自适应: 两次工作之间的空闲时间
+ * 不超过`spin_us`时(工作间隔短)自旋`spin_us`, 否则每次减半,
+ * 低于`min_spin_us`后不再自旋, 空闲线程不会一直占用CPU
+ */
+struct CROSSOCEAN_API BusyPollOptions {
+  /// @brief 最长自旋时间(微秒), 0表示不自旋(默认)
+  int spin_us = 0;
+  /// @brief 自适应缩短后的最短自旋时间(微秒)
+  int min_spin_us = 5;
+  /// @brief 新连接的`SO_BUSY_POLL`时间(微秒), 0表示不设置(仅Linux).
+  /// 之后创建的`ServerTask`使用该值
+  int socket_busy_poll_us = 0;
+};
+
 class CROSSOCEAN_API ThreadPool {
  public:
   /**
@@ -53,6 +74,37 @@ class CROSSOCEAN_API ThreadPool {
    */
   void Dispatch(Task* task);
 
+  /**
+   * @brief 批量分发任务到线程
+   *
+   * @details
+   * 按与`Dispatch`相同的轮询策略把任务划分给各个线程,
+   * 每个线程的任务一次加入队列, 每个线程只激活一次(一次写管道),
+   * 用于复制扇出、批量下载和集中到达的连接等成批产生的任务
+   *
+   * @param tasks 任务指针, 空指针被忽略
+   */
+  void DispatchBatch(const std::vector<Task*>& tasks);
+
+  /**
+   * @brief 获取所有线程等待执行的任务总数
+   *
+   * @return int 任务队列总深度
+   */
+  int task_count();
+
+  /**
+   * @brief 设置工作线程的忙等待参数
+   *
+   * @details 可以在`Init`之前或之后调用, 对所有工作线程生效
+   *
+   * @param options 忙等待参数
+   */
+  void set_busy_poll(const BusyPollOptions& options);
+
+  /// @brief 工作线程的忙等待参数
+  const BusyPollOptions& busy_poll() const { return busy_poll_; }
+
  private:
   ThreadPool() {};
 
@@ -65,6 +117,9 @@ class CROSSOCEAN_API ThreadPool {
 
   /// @brief 线程池列表
   std::vector<Thread*> threads_;
+
+  /// @brief 工作线程的忙等待参数
+  BusyPollOptions busy_poll_;
 };
 
 END_NAMESPACE
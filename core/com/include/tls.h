@@ -0,0 +1,264 @@
+﻿/**
+ * @file tls.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `TlsContext`和`TlsConnection`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef TLS_H
+#define TLS_H
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "crossocean.h"
+
+struct ssl_ctx_st;
+struct ssl_st;
+struct ssl_session_st;
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief TLS 操作的结果
+ */
+enum class TlsStatus {
+  kDone,       ///< 操作完成
+  kWantRead,   ///< 需要等待socket可读后重试
+  kWantWrite,  ///< 需要等待socket可写后重试
+  kClosed,     ///< 对端关闭了TLS连接
+  kError,      ///< 出错, 应关闭连接
+};
+
+/**
+ * @brief TLS 统计信息
+ */
+struct CROSSOCEAN_API TlsStats {
+  long long handshakes = 0;  ///< 完成的握手次数
+  long long resumed = 0;     ///< 复用会话(简化握手)的次数
+  long long ktls_send = 0;   ///< 启用了内核TLS发送的连接数
+  long long ktls_recv = 0;   ///< 启用了内核TLS接收的连接数
+  /// @brief 通过`SSL_sendfile`零拷贝发送的文件字节数
+  long long ktls_sendfile_bytes = 0;
+};
+
+/**
+ * @brief TLS 配置(证书、会话缓存、kTLS), 所有连接共享
+ *
+ * @details
+ * 默认打开`SSL_OP_ENABLE_KTLS`: 握手完成后由内核负责加解密,
+ * `TlsConnection::SendFile`可以继续使用`sendfile`零拷贝发送文件.
+ * 内核或密码套件不支持kTLS时自动回退到用户态加密, 可以用`KtlsSupported`
+ * 检查OpenSSL和内核是否支持kTLS.
+ * 服务器同时启用会话缓存和会话票据, 客户端按对端地址缓存会话,
+ * 重连时只需简化握手
+ */
+class CROSSOCEAN_API TlsContext {
+ public:
+  TlsContext();
+  ~TlsContext();
+
+  /**
+   * @brief 初始化服务器配置
+   *
+   * @param cert_file 证书文件(PEM, 可以包含证书链)
+   * @param key_file 私钥文件(PEM)
+   * @return true 初始化成功
+   * @return false 证书或私钥加载失败
+   */
+  bool InitServer(const std::string& cert_file, const std::string& key_file);
+
+  /**
+   * @brief 使用临时生成的自签名证书初始化服务器配置(用于开发和测试)
+   *
+   * @param common_name 证书的通用名称
+   * @return true 初始化成功
+   * @return false 生成证书失败
+   */
+  bool InitSelfSigned(const std::string& common_name);
+
+  /**
+   * @brief 初始化客户端配置
+   *
+   * @param ca_file 用于验证服务器证书的CA文件, 为空时不验证服务器证书
+   * @return true 初始化成功
+   * @return false CA文件加载失败
+   */
+  bool InitClient(const std::string& ca_file = "");
+
+  /**
+   * @brief 是否启用kTLS(默认启用), 对之后创建的连接生效
+   */
+  void set_ktls(bool enable);
+  bool ktls() const { return ktls_; }
+
+  /**
+   * @brief 检查OpenSSL和内核是否支持kTLS(结果在第一次调用时检测并缓存)
+   *
+   * @details Linux上在本地回环TCP连接上设置`tls` ULP, 内核没有`tls`模块时失败
+   *
+   * @param reason 不支持时输出原因, 可以为`nullptr`
+   * @return true 支持kTLS, 密码套件也支持时握手后启用
+   * @return false OpenSSL编译时未启用kTLS或内核不支持
+   */
+  static bool KtlsSupported(std::string* reason = nullptr);
+
+  /**
+   * @brief 设置服务器会话缓存的容量和超时时间
+   *
+   * @param size 缓存的会话数量
+   * @param timeout_seconds 会话有效期(秒)
+   */
+  void SetSessionCache(long size, long timeout_seconds);
+
+  /**
+   * @brief 获取统计信息
+   */
+  TlsStats stats() const;
+
+  /// @brief 是否为服务器配置
+  bool is_server() const { return server_; }
+  /// @brief OpenSSL 上下文
+  ::ssl_ctx_st* native() { return ctx_; }
+
+ private:
+  friend class TlsConnection;
+
+  /**
+   * @brief 创建`SSL_CTX`并设置公共选项
+   */
+  bool Create(bool server);
+
+  /**
+   * @brief 客户端: 获取对端的缓存会话(引用计数加1), 没有返回`nullptr`
+   */
+  ::ssl_session_st* FindSession(const std::string& peer);
+
+  /**
+   * @brief 客户端: 保存对端的会话(接管引用)
+   */
+  void StoreSession(const std::string& peer, ::ssl_session_st* session);
+
+  /**
+   * @brief 客户端新会话回调(OpenSSL 回调)
+   */
+  static int NewSessionCB(::ssl_st* ssl, ::ssl_session_st* session);
+
+  ::ssl_ctx_st* ctx_ = nullptr;
+  bool server_ = false;
+  bool ktls_ = true;
+
+  /// @brief 客户端会话缓存: 对端 -> 会话
+  std::mutex sessions_mutex_;
+  std::map<std::string, ::ssl_session_st*> sessions_;
+
+  std::atomic<long long> handshakes_{0};
+  std::atomic<long long> resumed_{0};
+  std::atomic<long long> ktls_send_{0};
+  std::atomic<long long> ktls_recv_{0};
+  std::atomic<long long> ktls_sendfile_bytes_{0};
+};
+
+/**
+ * @brief 一个 TLS 连接
+ *
+ * @details
+ * 适用于非阻塞socket: 各操作返回`kWantRead`/`kWantWrite`时,
+ * 调用者在事件循环中等待对应事件后用相同参数重试. 不负责关闭socket
+ */
+class CROSSOCEAN_API TlsConnection {
+ public:
+  /**
+   * @brief 构造 TLS 连接
+   *
+   * @param context TLS 配置
+   * @param sock 已连接的socket
+   * @param peer 客户端用于缓存会话的对端标识(如"host:port"), 为空不缓存
+   */
+  TlsConnection(TlsContext* context, int sock, const std::string& peer = "");
+  ~TlsConnection();
+
+  /**
+   * @brief 执行握手(服务器接受 / 客户端发起)
+   *
+   * @return TlsStatus 握手结果
+   */
+  TlsStatus Handshake();
+
+  /**
+   * @brief 读取解密后的数据
+   *
+   * @param buf 缓冲区
+   * @param len 缓冲区长度
+   * @param status 输出操作结果
+   * @return long long 读取的字节数
+   */
+  long long Read(char* buf, size_t len, TlsStatus* status);
+
+  /**
+   * @brief 加密发送数据
+   *
+   * @param data 数据
+   * @param len 数据长度
+   * @param status 输出操作结果
+   * @return long long 发送的字节数
+   */
+  long long Write(const char* data, size_t len, TlsStatus* status);
+
+  /**
+   * @brief 发送文件内容
+   *
+   * @details 只有连接的socket BIO启用了kTLS发送(`ktls_send`)时才使用
+   * `SSL_sendfile`(内核`sendfile`, 零拷贝), 否则读取文件后在用户态加密发送
+   *
+   * @param fd 文件描述符
+   * @param offset 文件偏移
+   * @param len 发送长度
+   * @param status 输出操作结果
+   * @return long long 发送的字节数
+   */
+  long long SendFile(int fd, long long offset, size_t len, TlsStatus* status);
+
+  /**
+   * @brief 发送关闭通知
+   *
+   * @return TlsStatus 操作结果
+   */
+  TlsStatus Shutdown();
+
+  /// @brief 是否启用了内核TLS发送
+  bool ktls_send() const;
+  /// @brief 是否启用了内核TLS接收
+  bool ktls_recv() const;
+  /// @brief 是否复用了会话
+  bool session_reused() const;
+  /// @brief 协商的TLS版本
+  std::string version() const;
+  /// @brief 协商的密码套件
+  std::string cipher() const;
+
+  /// @brief 握手是否已完成
+  bool established() const { return established_; }
+
+ private:
+  friend class TlsContext;
+
+  /**
+   * @brief 根据OpenSSL返回值得到操作结果
+   */
+  TlsStatus StatusFor(int ret);
+
+  TlsContext* context_;
+  ::ssl_st* ssl_ = nullptr;
+  std::string peer_;
+  bool established_ = false;
+};
+
+END_NAMESPACE
+
+#endif  // TLS_H
@@ -0,0 +1,366 @@
+﻿/**
+ * @file volume.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Volume`和`VolumeStore`类声明
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef VOLUME_H
+#define VOLUME_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+class BlockingPool;
+
+/**
+ * @brief 打开的卷文件
+ *
+ * @details 合并替换文件后, 读者仍持有的旧文件在最后一个引用释放时关闭
+ */
+struct CROSSOCEAN_API VolumeFile {
+  ~VolumeFile();
+
+  /// @brief 文件描述符
+  int fd = -1;
+};
+
+/**
+ * @brief 卷中一个小文件(needle)的位置
+ *
+ * @details 持有卷文件的引用, 在锁外读取或发送时即使卷被合并也保持有效
+ */
+struct CROSSOCEAN_API NeedleRef {
+  /// @brief 卷文件
+  std::shared_ptr<const VolumeFile> file;
+  /// @brief 数据在卷文件中的偏移
+  long long offset = 0;
+  /// @brief 数据长度
+  long long length = 0;
+};
+
+/**
+ * @brief 卷统计信息
+ */
+struct CROSSOCEAN_API VolumeStats {
+  long long needles = 0;        ///< 有效的小文件数
+  long long live_bytes = 0;     ///< 有效记录的字节数
+  long long garbage_bytes = 0;  ///< 被覆盖或删除的记录字节数
+  long long file_size = 0;      ///< 卷文件大小
+  long long compactions = 0;    ///< 完成的合并次数
+
+  /// @brief 垃圾字节占比(0 ~ 1)
+  double garbage_ratio() const {
+    return file_size == 0 ? 0.0
+                          : static_cast<double>(garbage_bytes) / file_size;
+  }
+};
+
+/**
+ * @brief Haystack 风格的追加写卷
+ *
+ * @details
+ * 大量小文件追加保存在一个大文件中, 内存中按键记录每个小文件的偏移.
+ * 读取时不需要打开文件或查找目录, 一次`pread`就能读出数据和校验和,
+ * 也可以用`sendfile`直接从卷文件发送.
+ * 每条记录: 标识4 + 标志1 + 键长度2 + 数据长度4 + 键 + 数据 + CRC32C 4,
+ * 按8字节对齐. 删除追加一条墓碑记录, 被覆盖和删除的记录由`Compact`回收:
+ * 把有效记录复制到新文件, 合并期间追加的记录在最后补上, 再原子替换卷文件.
+ * 打开时顺序扫描记录头重建索引, 截断末尾写了一半的记录. 线程安全
+ */
+class CROSSOCEAN_API Volume {
+ public:
+  /**
+   * @brief 构造卷
+   *
+   * @param path 卷文件路径
+   */
+  explicit Volume(const std::string& path);
+
+  /**
+   * @brief 打开或创建卷文件, 扫描记录重建索引
+   *
+   * @return true 成功
+   * @return false 打开失败或文件格式错误
+   */
+  bool Open();
+
+  /**
+   * @brief 追加小文件, 已存在的同名小文件被覆盖
+   *
+   * @param key 键(小文件名)
+   * @param data 数据
+   * @param len 数据长度
+   * @return true 成功
+   * @return false 键为空或过长、写入失败
+   */
+  bool Append(const std::string& key, const char* data, size_t len);
+
+  /**
+   * @brief 删除小文件(追加墓碑记录)
+   *
+   * @param key 键
+   * @return true 成功
+   * @return false 不存在或写入失败
+   */
+  bool Remove(const std::string& key);
+
+  /**
+   * @brief 查找小文件的位置
+   *
+   * @param key 键
+   * @param ref 输出位置
+   * @return true 找到
+   * @return false 不存在
+   */
+  bool Lookup(const std::string& key, NeedleRef* ref) const;
+
+  /**
+   * @brief 读取小文件(一次`pread`), 并校验CRC32C
+   *
+   * @param key 键
+   * @param data 输出数据
+   * @return true 成功
+   * @return false 不存在、读取失败或校验和不匹配
+   */
+  bool Read(const std::string& key, std::string* data) const;
+
+  /**
+   * @brief 合并卷文件, 回收被覆盖和删除的记录占用的空间
+   *
+   * @details 复制有效记录时不持有锁, 期间读写照常进行
+   *
+   * @return true 成功
+   * @return false 写入新文件失败
+   */
+  bool Compact();
+
+  /**
+   * @brief 把卷文件刷到磁盘(`fdatasync`)
+   *
+   * @return true 成功
+   * @return false 刷写失败
+   */
+  bool Sync();
+
+  /**
+   * @brief 获取所有有效的键
+   */
+  std::vector<std::string> Keys() const;
+
+  /**
+   * @brief 从卷文件发送小文件的一部分到socket
+   *
+   * @param sock 目标socket
+   * @param ref 小文件位置
+   * @param pos 小文件内的起始偏移
+   * @return long long 实际发送的字节数, 出错返回-1
+   */
+  static long long Send(int sock, const NeedleRef& ref, long long pos);
+
+  /// @brief 统计信息
+  VolumeStats stats() const;
+  /// @brief 卷文件路径
+  const std::string& path() const { return path_; }
+
+  /// @brief 每条记录的最大键长度
+  static constexpr size_t kMaxKeySize = 0xffff;
+
+ private:
+  /// @brief 索引中记录的位置
+  struct Location {
+    /// @brief 记录起始偏移
+    long long record = 0;
+    /// @brief 记录总长度(含对齐)
+    long long record_size = 0;
+    /// @brief 数据长度
+    uint32_t length = 0;
+  };
+
+  /**
+   * @brief 解析卷文件中的记录并应用到索引(需持有`mutex_`或在打开时调用)
+   *
+   * @param fd 卷文件
+   * @param begin 起始偏移
+   * @param end 结束偏移
+   * @param apply 每条记录的回调: 键、是否为墓碑、位置
+   * @return long long 最后一条完整记录的结束偏移
+   */
+  template <typename Fn>
+  static long long Scan(int fd, long long begin, long long end, Fn apply);
+
+  /**
+   * @brief 追加一条记录(需持有`mutex_`)
+   */
+  bool AppendRecord(const std::string& key, const char* data, size_t len,
+                    bool tombstone, Location* location);
+
+  /**
+   * @brief 按位置生成小文件引用(需持有`mutex_`)
+   */
+  NeedleRef MakeRef(const std::string& key, const Location& location) const;
+
+  std::string path_;
+
+  mutable std::mutex mutex_;
+  /// @brief 当前卷文件
+  std::shared_ptr<VolumeFile> file_;
+  /// @brief 键到记录位置的索引
+  std::unordered_map<std::string, Location> index_;
+  /// @brief 卷文件末尾(下一条记录的偏移)
+  long long size_ = 0;
+  long long live_bytes_ = 0;
+  long long garbage_bytes_ = 0;
+  long long compactions_ = 0;
+  /// @brief 同一时刻只进行一次合并
+  std::mutex compact_mutex_;
+};
+
+/**
+ * @brief 小文件卷存储
+ *
+ * @details
+ * 小于`threshold`的上传追加到当前可写卷中, 卷大小达到`max_volume_size`后
+ * 创建新卷. 卷文件保存为`<dir>/<序号>.vol`, 打开时加载所有卷并合并索引
+ * (同一键出现在多个卷中时以序号大的卷为准). 垃圾占比超过`compact_ratio`的卷
+ * 在阻塞I/O线程池中后台合并. 线程安全
+ */
+class CROSSOCEAN_API VolumeStore {
+ public:
+  /**
+   * @brief 构造小文件卷存储
+   *
+   * @param dir 卷目录
+   * @param pool 执行后台合并的阻塞I/O线程池, 为`nullptr`时在调用线程中合并
+   * @param threshold 小文件大小上限(字节), 不小于该值的文件不放入卷
+   * @param max_volume_size 单个卷文件的大小上限(字节)
+   * @param compact_ratio 垃圾占比超过该值时合并卷
+   */
+  VolumeStore(const std::string& dir, BlockingPool* pool = nullptr,
+              size_t threshold = 256 * 1024,
+              long long max_volume_size = 4LL * 1024 * 1024 * 1024,
+              double compact_ratio = 0.3);
+
+  /**
+   * @brief 等待后台合并完成
+   */
+  ~VolumeStore();
+
+  /**
+   * @brief 创建目录并加载已有的卷
+   *
+   * @return true 成功
+   * @return false 创建目录或打开卷失败
+   */
+  bool Open();
+
+  /**
+   * @brief 判断数据是否应放入卷
+   *
+   * @param len 数据长度
+   */
+  bool Accepts(size_t len) const { return len < threshold_; }
+
+  /**
+   * @brief 保存小文件
+   *
+   * @param key 键(小文件名)
+   * @param data 数据
+   * @param len 数据长度, 必须小于`threshold`
+   * @return true 成功
+   * @return false 数据过大或写入失败
+   */
+  bool Put(const std::string& key, const char* data, size_t len);
+
+  /**
+   * @brief 读取小文件
+   *
+   * @param key 键
+   * @param data 输出数据
+   * @return true 成功
+   * @return false 不存在或读取失败
+   */
+  bool Get(const std::string& key, std::string* data) const;
+
+  /**
+   * @brief 查找小文件的位置(用于`sendfile`发送)
+   *
+   * @param key 键
+   * @param ref 输出位置
+   * @return true 找到
+   * @return false 不存在
+   */
+  bool Lookup(const std::string& key, NeedleRef* ref) const;
+
+  /**
+   * @brief 删除小文件
+   *
+   * @param key 键
+   * @return true 成功
+   * @return false 不存在或写入失败
+   */
+  bool Remove(const std::string& key);
+
+  /**
+   * @brief 检查所有卷, 合并垃圾占比超过阈值的卷
+   *
+   * @return int 开始合并的卷数量
+   */
+  int CompactIfNeeded();
+
+  /**
+   * @brief 等待后台合并完成
+   */
+  void WaitCompaction();
+
+  /// @brief 卷数量
+  int volume_count() const;
+  /// @brief 小文件数量
+  long long size() const;
+  /// @brief 每个卷的统计信息
+  std::vector<VolumeStats> stats() const;
+
+ private:
+  /**
+   * @brief 获取可写卷, 当前卷已满时创建新卷(需持有`mutex_`)
+   */
+  Volume* Writable();
+
+  /**
+   * @brief 合并卷(阻塞)并减少进行中的合并计数
+   */
+  void RunCompaction(Volume* volume);
+
+  std::string dir_;
+  BlockingPool* pool_;
+  size_t threshold_;
+  long long max_volume_size_;
+  double compact_ratio_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable compacted_;
+  /// @brief 序号到卷
+  std::map<int, std::unique_ptr<Volume>> volumes_;
+  /// @brief 键到所在卷的序号
+  std::unordered_map<std::string, int> keys_;
+  /// @brief 当前可写卷的序号
+  int writable_ = -1;
+  /// @brief 正在合并的卷
+  std::vector<Volume*> compacting_;
+};
+
+END_NAMESPACE
+
+#endif  // VOLUME_H
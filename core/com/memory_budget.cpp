@@ -0,0 +1,142 @@
+﻿/**
+ * @file memory_budget.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `MemoryBudget`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/memory_budget.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 构造内存预算
+ *
+ * @param limit 全局预算(字节), 0为不限制
+ * @param workers 工作线程数量, 线程编号为1 ~ workers
+ */
+MemoryBudget::MemoryBudget(long long limit, int workers)
+    : limit_(limit), workers_(workers > 0 ? workers + 1 : 1) {
+  for (auto& worker : workers_) worker = 0;
+}
+
+/**
+ * @brief 记录内存占用的变化
+ *
+ * @param category 用途
+ * @param worker 所属工作线程编号, 超出范围时记到0
+ * @param bytes 增加的字节数, 释放时为负数
+ */
+void MemoryBudget::Charge(MemoryCategory category, int worker,
+                          long long bytes) {
+  if (bytes == 0) return;
+  if (worker < 0 || worker >= static_cast<int>(workers_.size())) worker = 0;
+  categories_[static_cast<int>(category)] += bytes;
+  workers_[worker] += bytes;
+  long long used = used_ += bytes;
+  if (bytes < 0) return;
+
+  long long peak = peak_;
+  while (used > peak && !peak_.compare_exchange_weak(peak, used)) {
+  }
+  long long limit = limit_;
+  if (limit > 0 && used > limit) Reclaim(used - limit);
+}
+
+/**
+ * @brief 注册回收函数
+ *
+ * @param reclaimer 回收函数, 在超出预算的线程中调用
+ * @return int 回收函数编号, 用于注销
+ */
+int MemoryBudget::AddReclaimer(Reclaimer reclaimer) {
+  lock_guard<mutex> lock(mutex_);
+  int id = next_id_++;
+  reclaimers_[id] = move(reclaimer);
+  return id;
+}
+
+/**
+ * @brief 注销回收函数, 返回后回收函数不会再被调用
+ *
+ * @param id 回收函数编号
+ */
+void MemoryBudget::RemoveReclaimer(int id) {
+  lock_guard<mutex> lock(mutex_);
+  reclaimers_.erase(id);
+}
+
+/**
+ * @brief 调用回收函数释放内存
+ *
+ * @details 回收函数释放内存时会再次调用`Charge`, 回收期间不重复触发;
+ * 其它线程同时超出预算时不等待, 由正在回收的线程处理
+ *
+ * @param bytes 需要释放的字节数
+ * @return long long 实际释放的字节数
+ */
+long long MemoryBudget::Reclaim(long long bytes) {
+  if (bytes <= 0 || reclaiming_.exchange(true)) return 0;
+  long long freed = 0;
+  {
+    lock_guard<mutex> lock(mutex_);
+    for (auto& reclaimer : reclaimers_) {
+      if (freed >= bytes) break;
+      freed += reclaimer.second(bytes - freed);
+    }
+  }
+  reclaiming_ = false;
+  reclaimed_ += freed;
+  return freed;
+}
+
+/**
+ * @brief 获取统计信息
+ *
+ * @return MemoryStats 统计信息
+ */
+MemoryStats MemoryBudget::stats() const {
+  MemoryStats stats;
+  stats.used = used_;
+  stats.peak = peak_;
+  stats.limit = limit_;
+  for (int i = 0; i < kMemoryCategoryCount; ++i) {
+    stats.categories[i] = categories_[i];
+  }
+  for (auto& worker : workers_) stats.workers.push_back(worker);
+  stats.reclaimed = reclaimed_;
+  stats.shed = shed_;
+  stats.pauses = pauses_;
+  return stats;
+}
+
+/**
+ * @brief 关联全局预算
+ *
+ * @param budget 全局预算, 为`nullptr`时只在本地记账
+ * @param category 用途
+ * @param worker 所属工作线程编号
+ * @param limit 连接的预算(字节), 0为不限制
+ */
+void MemoryAccount::Attach(MemoryBudget* budget, MemoryCategory category,
+                           int worker, long long limit) {
+  Update(0);
+  budget_ = budget;
+  category_ = category;
+  worker_ = worker;
+  limit_ = limit;
+}
+
+/**
+ * @brief 更新当前用量
+ *
+ * @param bytes 当前占用的字节数
+ */
+void MemoryAccount::Update(long long bytes) {
+  if (bytes == used_) return;
+  if (budget_) budget_->Charge(category_, worker_, bytes - used_);
+  used_ = bytes;
+}
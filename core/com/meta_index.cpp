@@ -0,0 +1,849 @@
+﻿/**
+ * @file meta_index.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `MetaIndex`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/meta_index.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "include/blocking_pool.h"
+#include "include/crc32c.h"
+#include "include/hash_ring.h"
+#include "include/sha256.h"
+#include "util.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 快照文件头标识
+static const char kSnapshotMagic[4] = {'M', 'I', 'D', 'X'};
+/// @brief 快照格式版本
+static const uint32_t kSnapshotVersion = 1;
+/// @brief 快照文件头长度: 标识4 + 版本4 + 记录数8 + 槽数8 + 槽偏移8
+static const size_t kSnapshotHeaderSize = 32;
+/// @brief 哈希表每个槽的长度: 路径哈希8 + 记录偏移8
+static const size_t kSlotSize = 16;
+/// @brief 日志记录头长度: 长度4 + CRC32C 4
+static const size_t kLogHeaderSize = 8;
+/// @brief 单条日志记录的长度上限
+static const uint32_t kMaxLogRecord = 64 * 1024 * 1024;
+/// @brief 日志操作: 添加或替换
+static const char kOpPut = 'P';
+/// @brief 日志操作: 删除
+static const char kOpRemove = 'D';
+
+/**
+ * @brief 路径在快照哈希表中使用的哈希, 0表示空槽
+ */
+static uint64_t PathHash(const char* path, size_t len) {
+  uint64_t hash = HashRing::Hash(string(path, len));
+  return hash == 0 ? 1 : hash;
+}
+
+/**
+ * @brief 十六进制字符的值, 非法字符返回-1
+ */
+static int HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+/**
+ * @brief 把二进制摘要转换为十六进制
+ */
+static string ToHex(const char* data, size_t len) {
+  static const char kDigits[] = "0123456789abcdef";
+  string hex(len * 2, '0');
+  for (size_t i = 0; i < len; ++i) {
+    unsigned char c = static_cast<unsigned char>(data[i]);
+    hex[i * 2] = kDigits[c >> 4];
+    hex[i * 2 + 1] = kDigits[c & 0xf];
+  }
+  return hex;
+}
+
+/**
+ * @brief 检查块哈希是否为SHA-256的十六进制形式
+ */
+static bool ValidChunkHash(const string& hash) {
+  if (hash.size() != Sha256::kDigestSize * 2) return false;
+  for (char c : hash) {
+    if (HexValue(c) < 0) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 编码文件元数据: 路径长度4 + 路径 + 大小8 + 修改时间8 + 校验和4
+ * + 块数4 + 每块(哈希32 + 长度4)
+ */
+static void EncodeMeta(const FileMeta& meta, string* out) {
+  PutUint(out, meta.path.size(), 4);
+  out->append(meta.path);
+  PutUint(out, static_cast<uint64_t>(meta.size), 8);
+  PutUint(out, static_cast<uint64_t>(meta.mtime_ns), 8);
+  PutUint(out, meta.checksum, 4);
+  PutUint(out, meta.chunks.size(), 4);
+  for (auto& chunk : meta.chunks) {
+    for (size_t i = 0; i < chunk.hash.size(); i += 2) {
+      out->push_back(static_cast<char>(HexValue(chunk.hash[i]) << 4 |
+                                       HexValue(chunk.hash[i + 1])));
+    }
+    PutUint(out, chunk.length, 4);
+  }
+}
+
+/**
+ * @brief 解码文件元数据
+ *
+ * @param data 编码数据
+ * @param avail 可用的字节数
+ * @param meta 输出文件元数据, 为`nullptr`时只计算长度
+ * @return size_t 记录长度, 数据不完整返回0
+ */
+static size_t DecodeMeta(const char* data, size_t avail, FileMeta* meta) {
+  if (avail < 4) return 0;
+  size_t path_len = GetUint(data, 4);
+  size_t pos = 4;
+  if (avail - pos < path_len + 24) return 0;
+  if (meta) meta->path.assign(data + pos, path_len);
+  pos += path_len;
+  if (meta) {
+    meta->size = static_cast<long long>(GetUint(data + pos, 8));
+    meta->mtime_ns = static_cast<long long>(GetUint(data + pos + 8, 8));
+    meta->checksum = static_cast<uint32_t>(GetUint(data + pos + 16, 4));
+  }
+  size_t count = GetUint(data + pos + 20, 4);
+  pos += 24;
+  const size_t chunk_size = Sha256::kDigestSize + 4;
+  if ((avail - pos) / chunk_size < count) return 0;
+  if (meta) {
+    meta->chunks.clear();
+    meta->chunks.reserve(count);
+    long long offset = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const char* p = data + pos + i * chunk_size;
+      ChunkRef chunk;
+      chunk.hash = ToHex(p, Sha256::kDigestSize);
+      chunk.offset = offset;
+      chunk.length = GetUint(p + Sha256::kDigestSize, 4);
+      offset += chunk.length;
+      meta->chunks.push_back(move(chunk));
+    }
+  }
+  return pos + count * chunk_size;
+}
+
+/**
+ * @brief 以追加方式打开日志文件
+ */
+static int OpenLog(const string& path) {
+#ifdef _WIN32
+  return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY,
+               _S_IREAD | _S_IWRITE);
+#else
+  return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+}
+
+/**
+ * @brief 把文件内容刷到磁盘
+ */
+static bool SyncFile(const string& path) {
+#ifdef _WIN32
+  int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+  bool ok = fd >= 0 && _commit(fd) == 0;
+#else
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  bool ok = fd >= 0 && fsync(fd) == 0;
+#endif
+  CloseFd(fd);
+  return ok;
+}
+
+/**
+ * @brief 把目录项(改名、创建)刷到磁盘
+ */
+static bool SyncDir(const string& dir) {
+#ifdef _WIN32
+  (void)dir;
+  return true;
+#else
+  int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  bool ok = fd >= 0 && fsync(fd) == 0;
+  CloseFd(fd);
+  return ok;
+#endif
+}
+
+// ==================== Snapshot ====================
+
+/**
+ * @brief 映射到内存的只读快照
+ *
+ * @details 文件布局: 文件头 | 记录 | 按8字节对齐的哈希表.
+ * 哈希表大小为2的幂, 槽中记录偏移从文件开头计算
+ */
+struct MetaIndex::Snapshot {
+  ~Snapshot() {
+#ifndef _WIN32
+    if (mapped) munmap(const_cast<char*>(data), length);
+#endif
+  }
+
+  /**
+   * @brief 加载快照, 文件不存在时返回空快照
+   *
+   * @param path 快照路径
+   * @return std::shared_ptr<Snapshot> 快照, 格式错误返回`nullptr`
+   */
+  static shared_ptr<Snapshot> Load(const string& path) {
+    auto snapshot = make_shared<Snapshot>();
+    error_code ec;
+    if (!fs::exists(path, ec)) return snapshot;
+
+#ifdef _WIN32
+    ifstream in(path, ios::binary);
+    snapshot->buffer.assign(istreambuf_iterator<char>(in),
+                            istreambuf_iterator<char>());
+    snapshot->data = snapshot->buffer.data();
+    snapshot->length = snapshot->buffer.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      cerr << "MetaIndex::Open() Failed to open " << path << endl;
+      CloseFd(fd);
+      return nullptr;
+    }
+    snapshot->length = static_cast<size_t>(st.st_size);
+    if (snapshot->length > 0) {
+      void* addr =
+          mmap(nullptr, snapshot->length, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr == MAP_FAILED) {
+        cerr << "MetaIndex::Open() Failed to map " << path << ": "
+             << strerror(errno) << endl;
+        CloseFd(fd);
+        return nullptr;
+      }
+      snapshot->data = static_cast<const char*>(addr);
+      snapshot->mapped = true;
+    }
+    CloseFd(fd);
+#endif
+
+    const char* data = snapshot->data;
+    size_t length = snapshot->length;
+    if (length < kSnapshotHeaderSize ||
+        memcmp(data, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+        GetUint(data + 4, 4) != kSnapshotVersion) {
+      cerr << "MetaIndex::Open() Invalid snapshot " << path << endl;
+      return nullptr;
+    }
+    snapshot->records = GetUint(data + 8, 8);
+    snapshot->slots = GetUint(data + 16, 8);
+    snapshot->slot_offset = GetUint(data + 24, 8);
+    bool power_of_two =
+        snapshot->slots > 0 && (snapshot->slots & (snapshot->slots - 1)) == 0;
+    if (!power_of_two || snapshot->slot_offset < kSnapshotHeaderSize ||
+        snapshot->slot_offset > length ||
+        (length - snapshot->slot_offset) / kSlotSize < snapshot->slots) {
+      cerr << "MetaIndex::Open() Corrupted snapshot " << path << endl;
+      return nullptr;
+    }
+    return snapshot;
+  }
+
+  /**
+   * @brief 按路径查找记录
+   *
+   * @param path 文件路径
+   * @return const char* 记录起始位置, 不存在返回`nullptr`
+   */
+  const char* Find(const string& path) const {
+    if (records == 0) return nullptr;
+    uint64_t hash = PathHash(path.data(), path.size());
+    const char* table = data + slot_offset;
+    for (uint64_t i = 0; i < slots; ++i) {
+      const char* slot = table + ((hash + i) & (slots - 1)) * kSlotSize;
+      uint64_t slot_hash = GetUint(slot, 8);
+      if (slot_hash == 0) return nullptr;
+      if (slot_hash != hash) continue;
+      uint64_t offset = GetUint(slot + 8, 8);
+      if (offset + 4 > slot_offset) return nullptr;
+      const char* record = data + offset;
+      size_t path_len = GetUint(record, 4);
+      if (path_len == path.size() && offset + 4 + path_len <= slot_offset &&
+          memcmp(record + 4, path.data(), path_len) == 0) {
+        return record;
+      }
+    }
+    return nullptr;
+  }
+
+  /// @brief 剩余可解码的字节数
+  size_t Avail(const char* record) const {
+    return slot_offset - static_cast<size_t>(record - data);
+  }
+
+  /**
+   * @brief 按顺序遍历所有记录
+   *
+   * @param fn 回调, 参数为记录起始位置和长度
+   */
+  void ForEach(const function<void(const char*, size_t)>& fn) const {
+    size_t pos = kSnapshotHeaderSize;
+    for (uint64_t i = 0; i < records; ++i) {
+      size_t len = DecodeMeta(data + pos, slot_offset - pos, nullptr);
+      if (len == 0) return;
+      fn(data + pos, len);
+      pos += len;
+    }
+  }
+
+  const char* data = nullptr;
+  size_t length = 0;
+  bool mapped = false;
+#ifdef _WIN32
+  vector<char> buffer;
+#endif
+  uint64_t records = 0;
+  uint64_t slots = 0;
+  uint64_t slot_offset = 0;
+};
+
+// ==================== MetaIndex ====================
+
+/**
+ * @brief 构造元数据索引
+ *
+ * @param dir 索引目录
+ * @param pool 执行合并的阻塞I/O线程池, 为`nullptr`时在调用线程中合并
+ * @param compact_records 日志记录数达到该值时合并, 小于等于0表示不自动合并
+ */
+MetaIndex::MetaIndex(const string& dir, BlockingPool* pool,
+                     long long compact_records)
+    : dir_(dir), pool_(pool), compact_records_(compact_records) {}
+
+/**
+ * @brief 等待进行中的合并完成后关闭索引
+ */
+MetaIndex::~MetaIndex() {
+  WaitCompaction();
+  CloseFd(log_fd_);
+}
+
+/**
+ * @brief 打开索引: 映射快照并重放变更日志
+ *
+ * @return true 成功
+ * @return false 创建目录、快照格式错误或打开日志失败
+ */
+bool MetaIndex::Open() {
+  error_code ec;
+  fs::create_directories(dir_, ec);
+  if (ec) {
+    cerr << "MetaIndex::Open() Failed to create " << dir_ << ": "
+         << ec.message() << endl;
+    return false;
+  }
+  string snap_path = (fs::path(dir_) / "meta.snap").string();
+  string log_path = (fs::path(dir_) / "meta.log").string();
+  string old_path = (fs::path(dir_) / "meta.log.old").string();
+
+  unique_lock<mutex> lock(mutex_);
+  shared_ptr<const Snapshot> snapshot = Snapshot::Load(snap_path);
+  if (!snapshot) return false;
+  snapshot_ = snapshot;
+  active_.clear();
+
+  // 上次合并没有完成时冻结的日志仍然存在, 先重放它
+  bool has_old = fs::exists(old_path, ec);
+  long long replayed = 0;
+  if (has_old) {
+    long long count = Replay(old_path, &active_);
+    if (count < 0) return false;
+    replayed += count;
+  }
+  long long count = Replay(log_path, &active_);
+  if (count < 0) return false;
+  replayed += count;
+
+  count_ = static_cast<long long>(snapshot_->records);
+  for (auto& item : active_) {
+    bool in_snapshot = snapshot_->Find(item.first) != nullptr;
+    if (item.second && !in_snapshot) ++count_;
+    if (!item.second && in_snapshot) --count_;
+  }
+  stats_.snapshot_records = static_cast<long long>(snapshot_->records);
+  stats_.replayed = replayed;
+  stats_.log_records = replayed;
+
+  if (has_old) {
+    // 把两份日志一起合并进快照, 然后从空日志开始
+    frozen_ = make_shared<const Overlay>(move(active_));
+    active_.clear();
+    lock.unlock();
+    bool ok = RunCompaction();
+    lock.lock();
+    if (!ok) return false;
+    fs::remove(log_path, ec);
+    stats_.log_records = 0;
+  }
+
+  log_fd_ = OpenLog(log_path);
+  if (log_fd_ < 0) {
+    cerr << "MetaIndex::Open() Failed to open " << log_path << ": "
+         << strerror(errno) << endl;
+    return false;
+  }
+  SyncDir(dir_);
+  return true;
+}
+
+/**
+ * @brief 重放变更日志到覆盖表, 截断末尾不完整的记录
+ *
+ * @param path 日志路径
+ * @param overlay 覆盖表
+ * @return long long 重放的记录数, 读取失败返回-1
+ */
+long long MetaIndex::Replay(const string& path, Overlay* overlay) {
+  error_code ec;
+  if (!fs::exists(path, ec)) return 0;
+  ifstream in(path, ios::binary);
+  if (!in) {
+    cerr << "MetaIndex::Replay() Failed to open " << path << endl;
+    return -1;
+  }
+  string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  in.close();
+
+  long long count = 0;
+  size_t pos = 0;
+  while (data.size() - pos >= kLogHeaderSize) {
+    uint32_t len = static_cast<uint32_t>(GetUint(data.data() + pos, 4));
+    uint32_t crc = static_cast<uint32_t>(GetUint(data.data() + pos + 4, 4));
+    const char* payload = data.data() + pos + kLogHeaderSize;
+    if (len == 0 || len > kMaxLogRecord ||
+        data.size() - pos - kLogHeaderSize < len ||
+        Crc32c::Value(payload, len) != crc) {
+      break;
+    }
+    if (payload[0] == kOpPut) {
+      auto meta = make_shared<FileMeta>();
+      if (DecodeMeta(payload + 1, len - 1, meta.get()) == 0) break;
+      string key = meta->path;
+      (*overlay)[key] = move(meta);
+    } else if (payload[0] == kOpRemove) {
+      (*overlay)[string(payload + 1, len - 1)] = nullptr;
+    } else {
+      break;
+    }
+    pos += kLogHeaderSize + len;
+    ++count;
+  }
+  if (pos < data.size()) {
+    // 崩溃时写了一半的记录, 截断后继续追加
+    cerr << "MetaIndex::Replay() Truncating " << data.size() - pos
+         << " bytes of torn log " << path << endl;
+    fs::resize_file(path, pos, ec);
+  }
+  return count;
+}
+
+/**
+ * @brief 追加一条变更记录(需持有`mutex_`)
+ *
+ * @param record 编码后的记录
+ * @return true 成功
+ * @return false 写入失败
+ */
+bool MetaIndex::Append(const string& record) {
+  if (log_fd_ < 0) {
+    cerr << "MetaIndex::Append() Index is not open." << endl;
+    return false;
+  }
+  string entry;
+  entry.reserve(kLogHeaderSize + record.size());
+  PutUint(&entry, record.size(), 4);
+  PutUint(&entry, Crc32c::Value(record.data(), record.size()), 4);
+  entry.append(record);
+  // 写入失败时截断回追加前的长度, 不能在日志中间留下不完整的记录,
+  // 否则重启时重放在这里停止, 之后追加成功的记录会被截断
+#ifdef _WIN32
+  long long start = _lseeki64(log_fd_, 0, SEEK_END);
+#else
+  long long start = lseek(log_fd_, 0, SEEK_END);
+#endif
+  size_t total = 0;
+  while (total < entry.size()) {
+#ifdef _WIN32
+    long long re = _write(log_fd_, entry.data() + total,
+                          static_cast<unsigned int>(entry.size() - total));
+#else
+    long long re = write(log_fd_, entry.data() + total, entry.size() - total);
+#endif
+    if (re < 0) {
+      if (errno == EINTR) continue;
+      cerr << "MetaIndex::Append() Failed to write log: " << strerror(errno)
+           << endl;
+      if (total == 0) return false;
+#ifdef _WIN32
+      bool truncated = start >= 0 && _chsize_s(log_fd_, start) == 0;
+#else
+      bool truncated = start >= 0 && ftruncate(log_fd_, start) == 0;
+#endif
+      if (!truncated) {
+        // 无法去掉不完整的记录, 之后的写入都失败, 重新打开时截断
+        cerr << "MetaIndex::Append() Failed to truncate torn record, index "
+                "is read-only until reopened."
+             << endl;
+        CloseFd(log_fd_);
+        log_fd_ = -1;
+      }
+      return false;
+    }
+    total += re;
+  }
+  ++stats_.log_records;
+  return true;
+}
+
+/**
+ * @brief 添加或替换文件元数据
+ *
+ * @param meta 文件元数据
+ * @return true 成功
+ * @return false 路径为空、块哈希格式错误或写入日志失败
+ */
+bool MetaIndex::Put(const FileMeta& meta) {
+  if (meta.path.empty()) return false;
+  for (auto& chunk : meta.chunks) {
+    if (!ValidChunkHash(chunk.hash)) {
+      cerr << "MetaIndex::Put() Invalid chunk hash " << chunk.hash << endl;
+      return false;
+    }
+  }
+  string record(1, kOpPut);
+  EncodeMeta(meta, &record);
+
+  // 与从快照解码的结果一致, 块偏移由长度依次累加
+  auto stored = make_shared<FileMeta>(meta);
+  long long offset = 0;
+  for (auto& chunk : stored->chunks) {
+    chunk.offset = offset;
+    offset += chunk.length;
+  }
+
+  unique_lock<mutex> lock(mutex_);
+  bool exists = Find(meta.path, nullptr);
+  if (!Append(record)) return false;
+  active_[meta.path] = move(stored);
+  if (!exists) ++count_;
+  if (compact_records_ > 0 && stats_.log_records >= compact_records_) {
+    StartCompaction(lock);
+  }
+  return true;
+}
+
+/**
+ * @brief 删除文件元数据
+ *
+ * @param path 文件路径
+ * @return true 成功(路径不存在时也返回true)
+ * @return false 写入日志失败
+ */
+bool MetaIndex::Remove(const string& path) {
+  unique_lock<mutex> lock(mutex_);
+  if (!Find(path, nullptr)) return true;
+  string record(1, kOpRemove);
+  record.append(path);
+  if (!Append(record)) return false;
+  active_[path] = nullptr;
+  --count_;
+  if (compact_records_ > 0 && stats_.log_records >= compact_records_) {
+    StartCompaction(lock);
+  }
+  return true;
+}
+
+/**
+ * @brief 在覆盖表和快照中查找(需持有`mutex_`)
+ *
+ * @param path 文件路径
+ * @param meta 输出文件元数据, 可以为`nullptr`
+ * @return true 找到
+ * @return false 不存在
+ */
+bool MetaIndex::Find(const string& path, FileMeta* meta) const {
+  const Overlay* overlays[] = {&active_, frozen_.get()};
+  for (const Overlay* overlay : overlays) {
+    if (!overlay) continue;
+    auto it = overlay->find(path);
+    if (it == overlay->end()) continue;
+    if (!it->second) return false;
+    if (meta) *meta = *it->second;
+    return true;
+  }
+  if (!snapshot_) return false;
+  const char* record = snapshot_->Find(path);
+  if (!record) return false;
+  if (meta) DecodeMeta(record, snapshot_->Avail(record), meta);
+  return true;
+}
+
+/**
+ * @brief 查找文件元数据
+ *
+ * @param path 文件路径
+ * @param meta 输出文件元数据(块偏移已计算)
+ * @return true 找到
+ * @return false 不存在
+ */
+bool MetaIndex::Lookup(const string& path, FileMeta* meta) const {
+  lock_guard<mutex> lock(mutex_);
+  return Find(path, meta);
+}
+
+/**
+ * @brief 把变更日志刷到磁盘(`fdatasync`)
+ *
+ * @return true 成功
+ * @return false 刷写失败
+ */
+bool MetaIndex::Sync() {
+  lock_guard<mutex> lock(mutex_);
+  if (log_fd_ < 0) return false;
+#ifdef _WIN32
+  return _commit(log_fd_) == 0;
+#elif defined(__APPLE__)
+  return fsync(log_fd_) == 0;
+#else
+  return fdatasync(log_fd_) == 0;
+#endif
+}
+
+/**
+ * @brief 冻结当前日志并启动合并(需持有`mutex_`)
+ *
+ * @param lock 持有的锁, 合并在调用线程中执行时临时释放
+ * @return true 已启动(或已完成)
+ * @return false 冻结日志失败
+ */
+bool MetaIndex::StartCompaction(unique_lock<mutex>& lock) {
+  if (compacting_) return true;
+  // 上次合并失败时冻结的日志还在, 直接重试, 不能覆盖它
+  if (!frozen_) {
+    string log_path = (fs::path(dir_) / "meta.log").string();
+    string old_path = (fs::path(dir_) / "meta.log.old").string();
+    CloseFd(log_fd_);
+    error_code ec;
+    fs::rename(log_path, old_path, ec);
+    log_fd_ = OpenLog(log_path);
+    if (!ec && log_fd_ >= 0) SyncDir(dir_);
+    if (ec || log_fd_ < 0) {
+      cerr << "MetaIndex::StartCompaction() Failed to rotate log." << endl;
+      return false;
+    }
+    frozen_ = make_shared<const Overlay>(move(active_));
+    active_.clear();
+    stats_.log_records = 0;
+  }
+  compacting_ = true;
+
+  auto work = [this]() { RunCompaction(); };
+  if (pool_ && pool_->Submit(work)) return true;
+  lock.unlock();
+  work();
+  lock.lock();
+  return true;
+}
+
+/**
+ * @brief 把快照和冻结的覆盖表写为新快照并替换(不持有锁)
+ *
+ * @return true 成功
+ * @return false 写入失败
+ */
+bool MetaIndex::RunCompaction() {
+  shared_ptr<const Snapshot> snapshot;
+  shared_ptr<const Overlay> frozen;
+  {
+    lock_guard<mutex> lock(mutex_);
+    snapshot = snapshot_;
+    frozen = frozen_;
+  }
+  string snap_path = (fs::path(dir_) / "meta.snap").string();
+  string temp_path = snap_path + ".tmp";
+
+  // 顺序写出记录, 同时收集(路径哈希, 记录偏移)
+  vector<pair<uint64_t, uint64_t>> entries;
+  ofstream out(temp_path, ios::binary | ios::trunc);
+  out.write(string(kSnapshotHeaderSize, '\0').data(), kSnapshotHeaderSize);
+  uint64_t offset = kSnapshotHeaderSize;
+  auto write_record = [&](const char* record, size_t len) {
+    entries.emplace_back(PathHash(record + 4, GetUint(record, 4)), offset);
+    out.write(record, len);
+    offset += len;
+  };
+  snapshot->ForEach([&](const char* record, size_t len) {
+    string path(record + 4, GetUint(record, 4));
+    if (frozen->count(path) == 0) write_record(record, len);
+  });
+  string encoded;
+  for (auto& item : *frozen) {
+    if (!item.second) continue;
+    encoded.clear();
+    EncodeMeta(*item.second, &encoded);
+    write_record(encoded.data(), encoded.size());
+  }
+
+  // 负载因子不超过0.5的开放寻址哈希表
+  uint64_t slots = 16;
+  while (slots < entries.size() * 2) slots <<= 1;
+  string padding((8 - offset % 8) % 8, '\0');
+  out.write(padding.data(), padding.size());
+  uint64_t slot_offset = offset + padding.size();
+  string table(slots * kSlotSize, '\0');
+  for (auto& entry : entries) {
+    for (uint64_t i = 0;; ++i) {
+      char* slot = &table[((entry.first + i) & (slots - 1)) * kSlotSize];
+      if (GetUint(slot, 8) != 0) continue;
+      string encoded_slot;
+      PutUint(&encoded_slot, entry.first, 8);
+      PutUint(&encoded_slot, entry.second, 8);
+      memcpy(slot, encoded_slot.data(), kSlotSize);
+      break;
+    }
+  }
+  out.write(table.data(), table.size());
+
+  string header(kSnapshotMagic, sizeof(kSnapshotMagic));
+  PutUint(&header, kSnapshotVersion, 4);
+  PutUint(&header, entries.size(), 8);
+  PutUint(&header, slots, 8);
+  PutUint(&header, slot_offset, 8);
+  out.seekp(0);
+  out.write(header.data(), header.size());
+  out.close();
+
+  shared_ptr<const Snapshot> compacted;
+  error_code ec;
+  bool ok = out.good() && SyncFile(temp_path);
+  if (ok) {
+    fs::rename(temp_path, snap_path, ec);
+    // 改名刷到磁盘后才能删除冻结的日志
+    ok = !ec && SyncDir(dir_);
+  }
+  if (ok) {
+    compacted = Snapshot::Load(snap_path);
+    ok = compacted != nullptr;
+  }
+  if (!ok) {
+    cerr << "MetaIndex::RunCompaction() Failed to write " << snap_path
+         << endl;
+    fs::remove(temp_path, ec);
+  } else {
+    // 新快照已包含冻结日志的内容, 重启时不再需要它
+    fs::remove(fs::path(dir_) / "meta.log.old", ec);
+  }
+
+  lock_guard<mutex> lock(mutex_);
+  if (ok) {
+    snapshot_ = compacted;
+    frozen_.reset();
+    stats_.snapshot_records = static_cast<long long>(compacted->records);
+    ++stats_.compactions;
+  }
+  compacting_ = false;
+  compact_ok_ = ok;
+  compacted_.notify_all();
+  return ok;
+}
+
+/**
+ * @brief 立即合并快照和变更日志(阻塞), 已有合并进行中时等待其完成
+ *
+ * @return true 成功
+ * @return false 写入新快照失败
+ */
+bool MetaIndex::Compact() {
+  unique_lock<mutex> lock(mutex_);
+  compacted_.wait(lock, [this]() { return !compacting_; });
+  if (active_.empty() && !frozen_) return true;
+  if (!StartCompaction(lock)) return false;
+  compacted_.wait(lock, [this]() { return !compacting_; });
+  return compact_ok_;
+}
+
+/**
+ * @brief 等待后台合并完成
+ */
+void MetaIndex::WaitCompaction() {
+  unique_lock<mutex> lock(mutex_);
+  compacted_.wait(lock, [this]() { return !compacting_; });
+}
+
+/**
+ * @brief 遍历所有文件元数据(顺序不确定), 回调中不能访问索引
+ *
+ * @param fn 回调函数
+ */
+void MetaIndex::ForEach(const function<void(const FileMeta&)>& fn) const {
+  lock_guard<mutex> lock(mutex_);
+  FileMeta meta;
+  if (snapshot_) {
+    snapshot_->ForEach([&](const char* record, size_t len) {
+      string path(record + 4, GetUint(record, 4));
+      if (active_.count(path) || (frozen_ && frozen_->count(path))) return;
+      DecodeMeta(record, len, &meta);
+      fn(meta);
+    });
+  }
+  if (frozen_) {
+    for (auto& item : *frozen_) {
+      if (item.second && active_.count(item.first) == 0) fn(*item.second);
+    }
+  }
+  for (auto& item : active_) {
+    if (item.second) fn(*item.second);
+  }
+}
+
+/**
+ * @brief 获取文件数量
+ */
+long long MetaIndex::size() const {
+  lock_guard<mutex> lock(mutex_);
+  return count_;
+}
+
+/**
+ * @brief 获取统计信息
+ */
+MetaIndexStats MetaIndex::stats() const {
+  lock_guard<mutex> lock(mutex_);
+  return stats_;
+}
@@ -0,0 +1,302 @@
+﻿/**
+ * @file rate_limiter.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `TokenBucket`、`RateLimiter`和`WriteThrottle`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/rate_limiter.h"
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace std::chrono;
+USING_CROSSOCEAN_NAMESPACE
+
+TokenBucket::TokenBucket(long long rate, long long burst) {
+  Reset(rate, burst);
+}
+
+/**
+ * @brief 修改限速参数
+ *
+ * @param rate 每秒补充的字节数, 小于等于0表示不限速
+ * @param burst 桶容量, 小于等于0时取`rate`
+ */
+void TokenBucket::Reset(long long rate, long long burst) {
+  lock_guard<mutex> lock(mutex_);
+  rate_ = rate > 0 ? rate : 0;
+  burst_ = burst > 0 ? burst : rate_;
+  tokens_ = static_cast<double>(burst_);
+  last_ = Clock::now();
+}
+
+/**
+ * @brief 按流逝的时间补充令牌(需持有`mutex_`)
+ *
+ * @param now 当前时间
+ */
+void TokenBucket::Refill(Clock::time_point now) {
+  if (now <= last_) return;
+  double elapsed = duration<double>(now - last_).count();
+  tokens_ = min(static_cast<double>(burst_), tokens_ + elapsed * rate_);
+  last_ = now;
+}
+
+/**
+ * @brief 申请发送字节数
+ *
+ * @param bytes 希望发送的字节数
+ * @param now 当前时间
+ * @return long long 实际允许发送的字节数(0 ~ bytes), 已从桶中扣除
+ */
+long long TokenBucket::Acquire(long long bytes, Clock::time_point now) {
+  if (bytes <= 0) return 0;
+  lock_guard<mutex> lock(mutex_);
+  if (rate_ <= 0) return bytes;
+  Refill(now);
+  long long granted = min(bytes, static_cast<long long>(tokens_));
+  tokens_ -= granted;
+  return granted;
+}
+
+/**
+ * @brief 归还未使用的字节数
+ *
+ * @param bytes 归还的字节数
+ */
+void TokenBucket::Refund(long long bytes) {
+  if (bytes <= 0) return;
+  lock_guard<mutex> lock(mutex_);
+  if (rate_ <= 0) return;
+  tokens_ = min(static_cast<double>(burst_), tokens_ + bytes);
+}
+
+/**
+ * @brief 计算积累到`bytes`个令牌需要等待的时间
+ *
+ * @param bytes 需要的字节数
+ * @param now 当前时间
+ * @return std::chrono::microseconds 等待时间, 令牌足够时为0
+ */
+microseconds TokenBucket::Delay(long long bytes, Clock::time_point now) {
+  lock_guard<mutex> lock(mutex_);
+  if (rate_ <= 0) return microseconds(0);
+  Refill(now);
+  // 超过桶容量的请求只需要等到桶满
+  double need = static_cast<double>(min(bytes, burst_));
+  if (tokens_ >= need) return microseconds(0);
+  double seconds = (need - tokens_) / rate_;
+  return microseconds(static_cast<long long>(seconds * 1000000) + 1);
+}
+
+RateLimiter::RateLimiter() : global_(0, 0) {}
+
+/**
+ * @brief 设置全局限速
+ *
+ * @param rate 每秒字节数, 小于等于0表示不限速
+ * @param burst 突发字节数
+ */
+void RateLimiter::SetGlobalLimit(long long rate, long long burst) {
+  global_.Reset(rate, burst);
+}
+
+/**
+ * @brief 设置每个客户端IP的限速, 对之后注册的IP生效
+ *
+ * @param rate 每秒字节数, 小于等于0表示不限速
+ * @param burst 突发字节数
+ */
+void RateLimiter::SetClientLimit(long long rate, long long burst) {
+  lock_guard<mutex> lock(mutex_);
+  client_rate_ = rate;
+  client_burst_ = burst;
+}
+
+/**
+ * @brief 设置每个连接的限速, 对之后注册的连接生效
+ *
+ * @param rate 每秒字节数, 小于等于0表示不限速
+ * @param burst 突发字节数
+ */
+void RateLimiter::SetConnectionLimit(long long rate, long long burst) {
+  lock_guard<mutex> lock(mutex_);
+  connection_rate_ = rate;
+  connection_burst_ = burst;
+}
+
+/**
+ * @brief 注册一个新连接
+ *
+ * @param ip 客户端IP
+ * @return std::shared_ptr<RateLimitHandle> 连接的限速句柄
+ */
+shared_ptr<RateLimitHandle> RateLimiter::Register(const string& ip) {
+  auto handle = make_shared<RateLimitHandle>();
+  handle->ip = ip;
+
+  lock_guard<mutex> lock(mutex_);
+  handle->connection.reset(
+      new TokenBucket(connection_rate_, connection_burst_));
+  // 同一IP的连接共享令牌桶, 顺便清理已经没有连接的IP
+  for (auto it = clients_.begin(); it != clients_.end();) {
+    if (it->second.expired()) {
+      it = clients_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  handle->client = clients_[ip].lock();
+  if (!handle->client) {
+    handle->client = make_shared<TokenBucket>(client_rate_, client_burst_);
+    clients_[ip] = handle->client;
+  }
+  return handle;
+}
+
+/**
+ * @brief 为连接申请发送字节数
+ *
+ * @details 依次扣除全局、IP、连接令牌, 多扣除的部分归还上一层
+ *
+ * @param handle 连接限速句柄
+ * @param bytes 希望发送的字节数
+ * @param now 当前时间
+ * @return long long 允许发送的字节数(0 ~ bytes)
+ */
+long long RateLimiter::Acquire(RateLimitHandle* handle, long long bytes,
+                               Clock::time_point now) {
+  if (!handle || bytes <= 0) return 0;
+  long long quantum = quantum_;
+  if (quantum > 0) bytes = min(bytes, quantum);
+
+  long long global_granted = global_.Acquire(bytes, now);
+  if (global_granted <= 0) return 0;
+
+  long long client_granted = handle->client->Acquire(global_granted, now);
+  global_.Refund(global_granted - client_granted);
+  if (client_granted <= 0) return 0;
+
+  long long granted = handle->connection->Acquire(client_granted, now);
+  handle->client->Refund(client_granted - granted);
+  global_.Refund(client_granted - granted);
+  return granted;
+}
+
+/**
+ * @brief 计算连接发送`bytes`字节需要等待的时间
+ *
+ * @param handle 连接限速句柄
+ * @param bytes 希望发送的字节数
+ * @param now 当前时间
+ * @return std::chrono::microseconds 等待时间
+ */
+microseconds RateLimiter::Delay(RateLimitHandle* handle, long long bytes,
+                                Clock::time_point now) {
+  if (!handle) return microseconds(0);
+  long long quantum = quantum_;
+  if (quantum > 0) bytes = min(bytes, quantum);
+  return max({global_.Delay(bytes, now), handle->client->Delay(bytes, now),
+              handle->connection->Delay(bytes, now)});
+}
+
+/**
+ * @brief 获取当前有活动连接的客户端IP数量
+ */
+int RateLimiter::client_count() {
+  lock_guard<mutex> lock(mutex_);
+  int count = 0;
+  for (auto& client : clients_) {
+    if (!client.second.expired()) ++count;
+  }
+  return count;
+}
+
+static void ThrottleSentCB(evbuffer* /*buffer*/, const evbuffer_cb_info* info,
+                           void* arg) {
+  if (info->n_deleted == 0) return;
+  static_cast<WriteThrottle*>(arg)->OnSent(
+      static_cast<long long>(info->n_deleted));
+}
+static void ThrottleTimerCB(evutil_socket_t /*fd*/, short /*events*/,
+                            void* arg) {
+  static_cast<WriteThrottle*>(arg)->OnTimer();
+}
+
+/**
+ * @brief 构造发送限速
+ *
+ * @param limiter 限速器
+ * @param handle 连接的限速句柄
+ */
+WriteThrottle::WriteThrottle(RateLimiter* limiter,
+                             shared_ptr<RateLimitHandle> handle)
+    : limiter_(limiter), handle_(move(handle)) {}
+
+WriteThrottle::~WriteThrottle() {
+  if (entry_) evbuffer_remove_cb_entry(bufferevent_get_output(bev_), entry_);
+  if (timer_) event_free(timer_);
+}
+
+/**
+ * @brief 开始控制`bufferevent`的发送
+ *
+ * @param bev 已启用写入的`bufferevent`
+ */
+void WriteThrottle::Attach(bufferevent* bev) {
+  bev_ = bev;
+  entry_ = evbuffer_add_cb(bufferevent_get_output(bev_), ThrottleSentCB, this);
+  timer_ = evtimer_new(bufferevent_get_base(bev_), ThrottleTimerCB, this);
+  Refill();
+}
+
+/**
+ * @brief 发送缓冲区的数据交给内核后调用: 扣除已发送的字节数
+ *
+ * @param bytes 交给内核的字节数
+ */
+void WriteThrottle::OnSent(long long bytes) {
+  allowance_ -= bytes;
+  sent_ += bytes;
+  if (!stalled_) Refill();
+}
+
+/**
+ * @brief 申请令牌, 不足时停止写入并设置定时器
+ *
+ * @details 欠账时申请的令牌先用于补足欠账
+ */
+void WriteThrottle::Refill() {
+  if (allowance_ < kQuantum) {
+    allowance_ += limiter_->Acquire(handle_.get(), kQuantum - allowance_);
+  }
+  if (allowance_ > 0) {
+    bufferevent_set_max_single_write(bev_, static_cast<size_t>(allowance_));
+    if (stalled_) {
+      stalled_ = false;
+      bufferevent_enable(bev_, EV_WRITE);
+    }
+    return;
+  }
+
+  if (!stalled_) {
+    stalled_ = true;
+    ++stalls_;
+    bufferevent_disable(bev_, EV_WRITE);
+  }
+  // 与其它连接共享令牌时可能被抢先, 至少等待1毫秒避免空转
+  long long need = min(kQuantum, 1 - allowance_);
+  long long delay = max<long long>(
+      limiter_->Delay(handle_.get(), need, RateLimiter::Clock::now()).count(),
+      1000);
+  timeval tv = {static_cast<long>(delay / 1000000),
+                static_cast<long>(delay % 1000000)};
+  evtimer_add(timer_, &tv);
+}
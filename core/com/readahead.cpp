@@ -0,0 +1,172 @@
+﻿/**
+ * @file readahead.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ReadaheadStream`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/readahead.h"
+
+#include <fcntl.h>
+
+#include <algorithm>
+
+#include "include/blocking_pool.h"
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 发送速率的采样周期
+static const chrono::milliseconds kRateSamplePeriod(100);
+/// @brief 发送速率指数加权平均中新样本的权重
+static const double kRateWeight = 0.3;
+
+/**
+ * @brief 对文件区间执行预读或释放(阻塞)
+ *
+ * @param fd 文件描述符
+ * @param will_need true为预读, false为释放页缓存
+ * @param offset 区间起始偏移
+ * @param length 区间长度
+ */
+static void ApplyAdvice(int fd, bool will_need, long long offset,
+                        long long length) {
+#if defined(__linux__)
+  // `readahead`在提交读请求后返回, 不受`WILLNEED`的预读上限影响
+  if (will_need && ::readahead(fd, offset, length) == 0) return;
+  posix_fadvise(fd, offset, length,
+                will_need ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED);
+#elif !defined(_WIN32)
+  posix_fadvise(fd, offset, length,
+                will_need ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED);
+#else
+  (void)fd;
+  (void)will_need;
+  (void)offset;
+  (void)length;
+#endif
+}
+
+/**
+ * @brief 构造下载流的预读状态
+ *
+ * @param pool 执行预读的阻塞I/O线程池, 为`nullptr`时在调用线程中直接执行
+ * @param file 发送的文件
+ * @param options 预读参数
+ */
+ReadaheadStream::ReadaheadStream(BlockingPool* pool, OpenFilePtr file,
+                                 const ReadaheadOptions& options)
+    : pool_(pool),
+      file_(move(file)),
+      options_(options),
+      inflight_(make_shared<atomic<int>>(0)) {}
+
+/**
+ * @brief 记录一次文件发送, 按需发起预读和释放
+ *
+ * @param offset 发送的起始偏移
+ * @param length 发送的字节数
+ * @param now 当前时间
+ */
+void ReadaheadStream::OnSend(long long offset, long long length,
+                             Clock::time_point now) {
+  if (!file_ || length <= 0) return;
+
+  // 允许跳过一小段(如客户端已有的数据), 仍视为顺序访问
+  bool forward = next_offset_ >= 0 && offset >= next_offset_ &&
+                 offset - next_offset_ <= options_.min_window;
+  if (forward) {
+    ++sequential_count_;
+  } else {
+    sequential_count_ = 0;
+    prefetched_end_ = offset;
+    released_end_ = offset;
+  }
+  next_offset_ = offset + length;
+  UpdateRate(length, now);
+  if (!sequential()) return;
+
+  long long cursor = next_offset_;
+  long long window_size = window();
+  prefetched_end_ = max(prefetched_end_, cursor);
+  long long target = min(cursor + window_size, file_->size);
+  // 剩余的预读量不足半个窗口时才补充, 每次提交一大段
+  if (target > prefetched_end_ && prefetched_end_ - cursor < window_size / 2 &&
+      Advise(Advice::kWillNeed, prefetched_end_, target - prefetched_end_)) {
+    ++stats_.prefetches;
+    stats_.prefetched_bytes += target - prefetched_end_;
+    prefetched_end_ = target;
+  }
+
+  if (!options_.drop_behind) return;
+  long long release_end = cursor - options_.keep_behind;
+  if (release_end - released_end_ >= options_.min_window) {
+    Advise(Advice::kDontNeed, released_end_, release_end - released_end_);
+    ++stats_.releases;
+    stats_.released_bytes += release_end - released_end_;
+    released_end_ = release_end;
+  }
+}
+
+/**
+ * @brief 获取当前的预读窗口
+ *
+ * @return long long 预读窗口(字节)
+ */
+long long ReadaheadStream::window() const {
+  if (rate_ <= 0) return options_.min_window;
+  long long window_size =
+      static_cast<long long>(rate_ * options_.lead_ms / 1000);
+  return min(max(window_size, options_.min_window), options_.max_window);
+}
+
+/**
+ * @brief 在阻塞I/O线程池中对区间执行文件建议
+ *
+ * @param advice 建议类型
+ * @param offset 区间起始偏移
+ * @param length 区间长度
+ * @return true 已提交
+ * @return false 上一次预读尚未完成, 本次跳过
+ */
+bool ReadaheadStream::Advise(Advice advice, long long offset,
+                             long long length) {
+  bool will_need = advice == Advice::kWillNeed;
+  // 磁盘跟不上时不再堆积预读请求, 等上一次完成后再补充
+  if (will_need && inflight_->load() > 0) {
+    ++stats_.skipped;
+    return false;
+  }
+  if (will_need) inflight_->fetch_add(1);
+
+  OpenFilePtr file = file_;
+  auto inflight = inflight_;
+  auto work = [file, inflight, will_need, offset, length]() {
+    ApplyAdvice(file->fd, will_need, offset, length);
+    if (will_need) inflight->fetch_sub(1);
+  };
+  if (!pool_ || !pool_->Submit(work)) work();
+  return true;
+}
+
+/**
+ * @brief 按发送的字节数更新发送速率
+ *
+ * @param length 发送的字节数
+ * @param now 当前时间
+ */
+void ReadaheadStream::UpdateRate(long long length, Clock::time_point now) {
+  if (sample_start_ == Clock::time_point()) sample_start_ = now;
+  sample_bytes_ += length;
+  auto elapsed = now - sample_start_;
+  if (elapsed < kRateSamplePeriod) return;
+
+  double seconds = chrono::duration<double>(elapsed).count();
+  double sample = sample_bytes_ / seconds;
+  rate_ = rate_ <= 0 ? sample
+                     : rate_ * (1 - kRateWeight) + sample * kRateWeight;
+  sample_start_ = now;
+  sample_bytes_ = 0;
+}
@@ -0,0 +1,2252 @@
+﻿/**
+ * @file replication.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ReplicaServer`和`ChainClient`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/replication.h"
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+
+#ifdef _WIN32
+#include <io.h>
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "include/blocking_pool.h"
+#include "include/crc32c.h"
+#include "include/file_writer.h"
+#include "include/frame.h"
+#include "server_task.h"
+#include "task.h"
+#include "thread.h"
+#include "util.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 写入中的临时文件后缀, 前面是写入编号
+static const char kTempSuffix[] = ".chain.tmp";
+/// @brief 按区间并行写入中的临时文件后缀, 前面是上传ID
+static const char kPartSuffix[] = ".part.tmp";
+/// @brief 追赶时读取本地文件的缓冲区大小
+static const size_t kReadBufferSize = 1024 * 1024;
+/// @brief 压缩读取数据时每个编码块的大小
+static const long long kCompressPiece = 1024 * 1024;
+/// @brief 超过该长度的读取区间不压缩, 限制阻塞I/O线程中的内存
+static const long long kMaxCompressRange = 16 * 1024 * 1024;
+
+/**
+ * @brief 判断字符串是否以`suffix`结尾
+ */
+static bool HasSuffix(const string& value, const string& suffix) {
+  return value.size() >= suffix.size() &&
+         value.compare(value.size() - suffix.size(), suffix.size(), suffix) ==
+             0;
+}
+
+/**
+ * @brief 按区间写入的临时文件路径
+ *
+ * @details 同一文件的多个上传(如两个客户端, 或客户端和再平衡)
+ * 各自写入自己的临时文件, 不会互相覆盖
+ *
+ * @param full 正式文件路径
+ * @param upload 客户端选择的上传ID
+ */
+static string PartPath(const string& full, uint64_t upload) {
+  char id[17];
+  snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(upload));
+  return full + "." + id + kPartSuffix;
+}
+
+/**
+ * @brief 连接节点(阻塞)
+ *
+ * @param address 节点地址(`IP:端口`)
+ * @return int 连接的socket, 失败返回-1
+ */
+static int ConnectTo(const string& address) {
+  sockaddr_storage addr;
+  int addr_len = sizeof(addr);
+  if (evutil_parse_sockaddr_port(address.c_str(),
+                                 reinterpret_cast<sockaddr*>(&addr),
+                                 &addr_len) != 0) {
+    cerr << "ConnectTo() Invalid address " << address << endl;
+    return -1;
+  }
+  evutil_socket_t sock = socket(addr.ss_family, SOCK_STREAM, 0);
+  if (sock < 0) return -1;
+  if (connect(sock, reinterpret_cast<sockaddr*>(&addr), addr_len) != 0) {
+    evutil_closesocket(sock);
+    return -1;
+  }
+  int one = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY,
+             reinterpret_cast<const char*>(&one), sizeof(one));
+  return static_cast<int>(sock);
+}
+
+/**
+ * @brief 发送全部数据(阻塞)
+ */
+static bool SendAll(int sock, const string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+#if defined(MSG_NOSIGNAL)
+    auto n = send(sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+#else
+    auto n = send(sock, data.data() + sent,
+                  static_cast<int>(data.size() - sent), 0);
+#endif
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+/**
+ * @brief 从缓冲区解析一条完整消息
+ *
+ * @return int 1为解析出一条消息, 0为数据不足, -1为格式错误
+ */
+static int ParseFrame(string* inbox, Frame* frame) {
+  if (inbox->size() < Frame::kHeaderSize) return 0;
+  uint32_t body_size = 0;
+  if (!Frame::DecodeHeader(inbox->data(), &frame->type, &frame->id,
+                           &body_size)) {
+    return -1;
+  }
+  if (inbox->size() < Frame::kHeaderSize + body_size) return 0;
+  frame->body.assign(*inbox, Frame::kHeaderSize, body_size);
+  inbox->erase(0, Frame::kHeaderSize + body_size);
+  return 1;
+}
+
+/**
+ * @brief 接收一条完整消息(阻塞)
+ */
+static bool RecvFrame(int sock, string* inbox, Frame* frame) {
+  char buffer[64 * 1024];
+  while (true) {
+    int re = ParseFrame(inbox, frame);
+    if (re != 0) return re > 0;
+    auto n = recv(sock, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    inbox->append(buffer, n);
+  }
+}
+
+/**
+ * @brief 编码确认消息
+ */
+static string AckFrame(uint32_t id, AckStatus status, long long offset,
+                       const string& message) {
+  FrameWriter writer;
+  writer.PutU8(static_cast<uint8_t>(status));
+  writer.PutU64(static_cast<uint64_t>(offset));
+  writer.PutString(message);
+  return writer.Finish(FrameType::kAck, id);
+}
+
+/**
+ * @brief 把缓冲区开头`len`字节写入文件, 不复制到连续内存
+ *
+ * @return true 成功
+ * @return false 写入失败
+ */
+static bool WriteBuffer(int fd, long long offset, evbuffer* in, size_t len) {
+#ifdef _WIN32
+  const char* data = reinterpret_cast<const char*>(
+      evbuffer_pullup(in, static_cast<ev_ssize_t>(len)));
+  if (_lseeki64(fd, offset, SEEK_SET) < 0) return false;
+  return _write(fd, data, static_cast<unsigned>(len)) ==
+         static_cast<int>(len);
+#else
+  int count = evbuffer_peek(in, static_cast<ev_ssize_t>(len), nullptr,
+                            nullptr, 0);
+  vector<evbuffer_iovec> chunks(max(count, 0));
+  evbuffer_peek(in, static_cast<ev_ssize_t>(len), nullptr, chunks.data(),
+                count);
+  vector<iovec> iov;
+  size_t left = len;
+  for (const auto& chunk : chunks) {
+    if (left == 0) break;
+    size_t n = min(left, chunk.iov_len);
+    iov.push_back({chunk.iov_base, n});
+    left -= n;
+  }
+  // 一次系统调用写入多个分散的缓冲区, 部分写入时跳过已写的部分
+  size_t index = 0;
+  while (index < iov.size()) {
+    int batch = static_cast<int>(min<size_t>(iov.size() - index, IOV_MAX));
+    ssize_t n = pwritev(fd, &iov[index], batch, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    offset += n;
+    while (n > 0) {
+      size_t step = min<size_t>(n, iov[index].iov_len);
+      iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + step;
+      iov[index].iov_len -= step;
+      n -= step;
+      if (iov[index].iov_len == 0) ++index;
+    }
+  }
+  return true;
+#endif
+}
+
+/**
+ * @brief 按块计算文件的校验和(阻塞), 文件不存在时为空
+ *
+ * @param path 文件路径
+ * @param chunks 输出分块校验和
+ * @param crc 输出整个文件的CRC32C, 可以为`nullptr`
+ */
+static void ComputeChunks(const string& path, ChunkCrc* chunks,
+                          uint32_t* crc = nullptr) {
+  ifstream in(path, ios::binary);
+  vector<char> buffer(kReadBufferSize);
+  Crc32c whole;
+  while (in) {
+    in.read(buffer.data(), buffer.size());
+    if (in.gcount() <= 0) continue;
+    chunks->Update(buffer.data(), in.gcount());
+    if (crc) whole.Update(buffer.data(), in.gcount());
+  }
+  chunks->Finish();
+  if (crc) *crc = whole.value();
+}
+
+CROSSOCEAN_NAMESPACE
+
+/**
+ * @brief 副本节点的监听任务
+ */
+class ReplicaListenTask : public ServerTask {
+ public:
+  explicit ReplicaListenTask(ReplicaServer* server) : server_(server) {}
+
+  /**
+   * @brief 开始监听, 结果通知`ReplicaServer::Start`
+   */
+  bool Init() override {
+    bool ok = ServerTask::Init();
+    ready_.set_value(ok);
+    return ok;
+  }
+
+  ReplicaServer* server() const { return server_; }
+  std::future<bool> ready() { return ready_.get_future(); }
+
+ private:
+  ReplicaServer* server_;
+  std::promise<bool> ready_;
+};
+
+/**
+ * @brief 副本节点上的一个连接
+ *
+ * @details
+ * 处理上游(客户端或上一个节点)发来的链式写入和追赶请求.
+ * 写入时按需连接下游节点, 数据块写入本地后把消息原样移动到下游的发送缓冲区.
+ * 连接关闭时删除自身
+ */
+class ChainTask : public Task {
+ public:
+  ChainTask(ReplicaServer* server, shared_ptr<RateLimitHandle> rate_limit)
+      : server_(server),
+        options_(server->options_),
+        rate_limit_(move(rate_limit)) {}
+
+  bool Init() override;
+
+  void OnUpRead();
+  void OnUpWrite();
+  void OnUpEvent(short events);
+  void OnDownRead();
+  void OnDownWrite();
+  void OnDownEvent(short events);
+
+  /**
+   * @brief 关闭连接并删除任务
+   */
+  void Close();
+
+ private:
+  /**
+   * @brief 开始写入文件, 按需连接下游并转发
+   */
+  bool BeginPut(const Frame& frame);
+
+  /**
+   * @brief 写入一块数据并转发给下游
+   *
+   * @param in 上游输入缓冲区, 第一条消息为`kPutData`
+   * @param frame_size 消息总长度
+   */
+  bool PutData(evbuffer* in, size_t frame_size);
+
+  /**
+   * @brief 结束写入: 校验并提交本地文件, 转发给下游
+   */
+  bool EndPut(const Frame& frame);
+
+  /**
+   * @brief 响应追赶请求: 发回与请求方不一致的块
+   *
+   * @details 没有可用的分块校验和文件时在阻塞I/O线程中计算
+   */
+  bool Sync(const Frame& frame);
+
+  /**
+   * @brief 在阻塞I/O线程中执行工作, 期间暂停读取上游
+   *
+   * @details 同一事件循环上的其它连接不受影响. 完成回调在本连接的
+   * 事件循环线程中执行, 之后恢复读取, 后续请求的响应保持顺序
+   *
+   * @param work 阻塞工作
+   * @param done 完成回调, 连接已关闭时参数为false, 只做清理
+   * @return false 节点正在停止, 工作没有提交, 连接已失败
+   */
+  bool RunBlocking(function<void()> work, function<void(bool alive)> done);
+
+  /**
+   * @brief 发回与请求方不一致的块
+   */
+  void SendSync(uint32_t id, int fd, long long size, const ChunkCrc& ours,
+                const vector<uint32_t>& theirs);
+
+  /**
+   * @brief 写入文件区间(客户端在多个连接上并行写入同一文件)
+   *
+   * @details 出错时只回复错误确认, 不关闭连接, 流水线上的其它请求继续
+   *
+   * @param in 上游输入缓冲区, 第一条消息为`kWriteAt`
+   * @param frame_size 消息总长度
+   */
+  void WriteAt(evbuffer* in, size_t frame_size);
+
+  /**
+   * @brief 提交按区间写入的文件
+   *
+   * @details 在阻塞I/O线程中校验CRC32C并保存分块校验和
+   */
+  bool Commit(const Frame& frame);
+
+  /**
+   * @brief 回复提交结果
+   */
+  void CommitDone(uint32_t id, long long size, const string& message);
+
+  /**
+   * @brief 读取文件区间, 数据由`sendfile`发送, 启用块缓存时从缓存发送
+   */
+  bool ReadAt(const Frame& frame);
+
+  /**
+   * @brief 把文件区间加入上游发送缓冲区, 限速时分段加入
+   */
+  void AddFile(evbuffer* out, evbuffer_file_segment* segment,
+               long long offset, long long len);
+
+  /**
+   * @brief 通过块缓存发送文件区间
+   */
+  bool SendCached(const OpenFile& file, long long begin, long long len);
+
+  /**
+   * @brief 在阻塞I/O线程中读取文件区间并压缩后发送
+   */
+  bool SendCompressed(uint32_t id, const OpenFilePtr& file, long long begin,
+                      long long len, CompressionCodec codec);
+
+  /**
+   * @brief 记录一次文件读取, 按访问模式预读
+   */
+  void Readahead(const OpenFilePtr& file, long long begin, long long len);
+
+  /**
+   * @brief 获取或更新分片表
+   */
+  bool HandleMap(const Frame& frame);
+
+  /**
+   * @brief 判断文件是否归本节点(未设置分片表时总是归本节点)
+   */
+  bool Owned(const string& path) const;
+
+  /**
+   * @brief 回复重定向并丢弃该请求的后续消息
+   */
+  void Redirect(uint32_t id);
+
+  /**
+   * @brief 按本地和下游的进度向上游确认
+   */
+  void MaybeAck();
+
+  /**
+   * @brief 写入失败: 向上游发送错误确认, 发送完成后关闭连接
+   */
+  void Fail(const string& message);
+
+  /**
+   * @brief 丢弃未提交的临时文件
+   */
+  void AbortPut();
+
+  /**
+   * @brief 更新连接的内存用量, 按连接和全局预算暂停或恢复读取上游
+   */
+  void TrackMemory();
+
+  void CloseDown();
+
+  ReplicaServer* server_;
+  const ReplicaOptions& options_;
+  bufferevent* up_ = nullptr;
+  bufferevent* down_ = nullptr;
+  /// @brief 下游节点地址
+  string down_address_;
+  /// @brief 连接的限速句柄, 不限速时为空
+  shared_ptr<RateLimitHandle> rate_limit_;
+  /// @brief 发给上游和转发给下游的限速, 在释放对应的`bufferevent`之前销毁
+  unique_ptr<WriteThrottle> up_throttle_;
+  unique_ptr<WriteThrottle> down_throttle_;
+  /// @brief 最近读取的文件的预读状态, 读取其它文件时重新创建
+  unique_ptr<ReadaheadStream> readahead_;
+  /// @brief 协商压缩的写入: 解码`kPutData`的数据块, 否则为空
+  unique_ptr<ChunkDecoder> decoder_;
+  /// @brief 解码后的数据, 复用以减少内存分配
+  string decoded_;
+
+  /// @brief 是否有正在写入的文件
+  bool active_ = false;
+  /// @brief 写入请求的ID
+  uint32_t id_ = 0;
+  /// @brief 正式文件路径
+  string path_;
+  /// @brief 临时文件路径
+  string temp_path_;
+  long long size_ = 0;
+  unique_ptr<FileWriter> writer_;
+  /// @brief 已接收数据的CRC32C
+  uint32_t crc_ = 0;
+  unique_ptr<ChunkCrc> chunks_;
+  /// @brief 本地已写入的字节数
+  long long written_ = 0;
+  /// @brief 是否转发给下游
+  bool forward_ = false;
+  /// @brief 下游已确认的偏移
+  long long down_acked_ = 0;
+  /// @brief 已向上游确认的偏移
+  long long acked_ = 0;
+  bool local_done_ = false;
+  bool down_done_ = false;
+
+  /// @brief 下游发送缓冲区过大, 暂停处理上游数据
+  bool paused_ = false;
+  /// @brief 连接的收发缓冲区占用
+  MemoryAccount memory_;
+  /// @brief 待发送的数据超出内存预算, 暂停读取上游
+  bool memory_paused_ = false;
+  /// @brief 发送完错误确认后关闭
+  bool closing_ = false;
+  /// @brief 正在等待阻塞I/O线程中的工作完成, 暂停读取上游
+  bool waiting_ = false;
+  /// @brief 连接是否存在, 关闭时置为false, 阻塞工作的完成回调据此判断
+  shared_ptr<bool> alive_ = make_shared<bool>(true);
+  /// @brief 正在丢弃`discard_id_`的后续消息
+  bool discarding_ = false;
+  uint32_t discard_id_ = 0;
+};
+
+END_NAMESPACE
+
+static void UpReadCB(bufferevent* /*bev*/, void* arg) {
+  static_cast<ChainTask*>(arg)->OnUpRead();
+}
+static void UpWriteCB(bufferevent* /*bev*/, void* arg) {
+  static_cast<ChainTask*>(arg)->OnUpWrite();
+}
+static void UpEventCB(bufferevent* /*bev*/, short events, void* arg) {
+  static_cast<ChainTask*>(arg)->OnUpEvent(events);
+}
+static void DownReadCB(bufferevent* /*bev*/, void* arg) {
+  static_cast<ChainTask*>(arg)->OnDownRead();
+}
+static void DownWriteCB(bufferevent* /*bev*/, void* arg) {
+  static_cast<ChainTask*>(arg)->OnDownWrite();
+}
+static void DownEventCB(bufferevent* /*bev*/, short events, void* arg) {
+  static_cast<ChainTask*>(arg)->OnDownEvent(events);
+}
+
+/**
+ * @brief 在事件循环线程中为连接创建`bufferevent`
+ *
+ * @details 节点正在停止时直接关闭连接
+ */
+bool ChainTask::Init() {
+  if (!server_->stopped_) {
+    up_ = bufferevent_socket_new(base(), sock(), BEV_OPT_CLOSE_ON_FREE);
+  }
+  if (!up_) {
+    evutil_closesocket(sock());
+    server_->listen_task_->ConnectionClosed();
+    delete this;
+    return false;
+  }
+  server_->connections_[thread_id() - 1].insert(this);
+  bufferevent_setcb(up_, UpReadCB, UpWriteCB, UpEventCB, this);
+  // 发送缓冲区降到连接预算的一半时检查是否恢复读取
+  bufferevent_setwatermark(
+      up_, EV_WRITE, static_cast<size_t>(options_.connection_memory / 2), 0);
+  bufferevent_enable(up_, EV_READ | EV_WRITE);
+  if (rate_limit_) {
+    up_throttle_.reset(new WriteThrottle(&server_->limiter_, rate_limit_));
+    up_throttle_->Attach(up_);
+  }
+  server_->memory_.Charge(MemoryCategory::kTask, thread_id(),
+                          sizeof(ChainTask));
+  memory_.Attach(&server_->memory_, MemoryCategory::kBuffer, thread_id(),
+                 options_.connection_memory);
+  return true;
+}
+
+/**
+ * @brief 处理上游发来的消息
+ */
+void ChainTask::OnUpRead() {
+  evbuffer* in = bufferevent_get_input(up_);
+  while (!closing_ && !paused_ && !waiting_) {
+    // 上一条请求的回复可能使连接超出内存预算
+    TrackMemory();
+    if (memory_paused_) return;
+    size_t frame_size = 0;
+    int re = Frame::Peek(in, &frame_size);
+    if (re < 0) {
+      Fail("malformed frame");
+      return;
+    }
+    if (re == 0) break;
+
+    char header[Frame::kHeaderSize];
+    evbuffer_copyout(in, header, sizeof(header));
+    FrameType type;
+    uint32_t id = 0, body_size = 0;
+    Frame::DecodeHeader(header, &type, &id, &body_size);
+    // 丢弃被重定向或跳过的写入的后续消息
+    if (discarding_ && id == discard_id_ &&
+        (type == FrameType::kPutData || type == FrameType::kPutEnd)) {
+      evbuffer_drain(in, frame_size);
+      continue;
+    }
+    // 数据块不复制到消息对象, 写入本地后直接移动到下游
+    if (type == FrameType::kPutData) {
+      if (!PutData(in, frame_size)) return;
+      continue;
+    }
+    if (type == FrameType::kWriteAt) {
+      WriteAt(in, frame_size);
+      continue;
+    }
+
+    Frame frame;
+    Frame::Pop(in, &frame);
+    bool ok = false;
+    switch (frame.type) {
+      case FrameType::kPutBegin:
+        ok = BeginPut(frame);
+        break;
+      case FrameType::kPutEnd:
+        ok = EndPut(frame);
+        break;
+      case FrameType::kSyncRequest:
+        ok = Sync(frame);
+        break;
+      case FrameType::kGetMap:
+      case FrameType::kSetMap:
+        ok = HandleMap(frame);
+        break;
+      case FrameType::kCommit:
+        ok = Commit(frame);
+        break;
+      case FrameType::kReadAt:
+        ok = ReadAt(frame);
+        break;
+      default:
+        Fail("unexpected frame");
+        break;
+    }
+    if (!ok) return;
+  }
+  TrackMemory();
+}
+
+/**
+ * @brief 开始写入文件, 按需连接下游并转发
+ */
+bool ChainTask::BeginPut(const Frame& frame) {
+  if (active_) {
+    Fail("another put is in progress");
+    return false;
+  }
+  FrameReader reader(frame.body);
+  string path;
+  uint64_t size = 0;
+  uint32_t count = 0;
+  vector<string> chain;
+  bool ok = reader.GetString(&path) && reader.GetU64(&size) &&
+            reader.GetU32(&count);
+  for (uint32_t i = 0; ok && i < count; ++i) {
+    string address;
+    ok = reader.GetString(&address);
+    chain.push_back(address);
+  }
+  // 标志和压缩算法列表是后加的字段, 旧客户端不发送
+  uint8_t flags = 0;
+  if (ok && reader.remaining() > 0) ok = reader.GetU8(&flags);
+  string offered;
+  bool encoded = ok && reader.remaining() > 0;
+  if (encoded) ok = reader.GetString(&offered);
+  id_ = frame.id;
+  if (!ok || !ReplicaServer::ValidPath(path)) {
+    Fail("invalid put request");
+    return false;
+  }
+  if (!Owned(path)) {
+    Redirect(frame.id);
+    return true;
+  }
+
+  path_ = (fs::path(options_.root) / path).string();
+  temp_path_ = path_ + "." + to_string(++server_->next_upload_) + kTempSuffix;
+  error_code ec;
+  if ((flags & kPutIfAbsent) && fs::exists(path_, ec)) {
+    discarding_ = true;
+    discard_id_ = frame.id;
+    string ack = AckFrame(frame.id, AckStatus::kCommitted, 0, "exists");
+    bufferevent_write(up_, ack.data(), ack.size());
+    return true;
+  }
+  fs::create_directories(fs::path(path_).parent_path(), ec);
+  writer_ = make_unique<FileWriter>(temp_path_);
+  if (!writer_->Open(static_cast<long long>(size))) {
+    Fail("failed to create " + path);
+    return false;
+  }
+  active_ = true;
+  size_ = static_cast<long long>(size);
+  crc_ = 0;
+  chunks_ = make_unique<ChunkCrc>(options_.chunk_size);
+  written_ = 0;
+  down_acked_ = 0;
+  acked_ = 0;
+  local_done_ = false;
+  down_done_ = false;
+  forward_ = !chain.empty();
+  // 带有算法列表时数据按编码块发送, 先回复选中的算法
+  CompressionCodec codec = CompressionCodec::kNone;
+  decoder_.reset();
+  if (encoded) {
+    if (options_.compression_workers > 0) {
+      codec = Compression::Negotiate(offered);
+    }
+    decoder_.reset(new ChunkDecoder(codec));
+    string ack = AckFrame(frame.id, AckStatus::kProgress, 0,
+                          Compression::CodecName(codec));
+    bufferevent_write(up_, ack.data(), ack.size());
+  }
+  if (!forward_) return true;
+
+  // 复用到同一下游节点的连接
+  if (!down_ || down_address_ != chain[0]) {
+    CloseDown();
+    sockaddr_storage addr;
+    int addr_len = sizeof(addr);
+    if (evutil_parse_sockaddr_port(chain[0].c_str(),
+                                   reinterpret_cast<sockaddr*>(&addr),
+                                   &addr_len) != 0) {
+      Fail("invalid replica address " + chain[0]);
+      return false;
+    }
+    down_ = bufferevent_socket_new(base(), -1, BEV_OPT_CLOSE_ON_FREE);
+    bufferevent_setcb(down_, DownReadCB, DownWriteCB, DownEventCB, this);
+    bufferevent_setwatermark(down_, EV_WRITE, options_.high_water / 2, 0);
+    bufferevent_enable(down_, EV_READ | EV_WRITE);
+    if (server_->forward_limit_) {
+      down_throttle_.reset(
+          new WriteThrottle(&server_->limiter_, server_->forward_limit_));
+      down_throttle_->Attach(down_);
+    }
+    if (bufferevent_socket_connect(down_, reinterpret_cast<sockaddr*>(&addr),
+                                   addr_len) != 0) {
+      Fail("failed to connect " + chain[0]);
+      return false;
+    }
+    down_address_ = chain[0];
+  }
+  FrameWriter writer;
+  writer.PutString(path);
+  writer.PutU64(size);
+  writer.PutU32(static_cast<uint32_t>(chain.size() - 1));
+  for (size_t i = 1; i < chain.size(); ++i) writer.PutString(chain[i]);
+  writer.PutU8(flags);
+  if (encoded) writer.PutString(Compression::CodecName(codec));
+  string begin = writer.Finish(FrameType::kPutBegin, frame.id);
+  bufferevent_write(down_, begin.data(), begin.size());
+  return true;
+}
+
+/**
+ * @brief 写入一块数据并转发给下游
+ *
+ * @param in 上游输入缓冲区, 第一条消息为`kPutData`
+ * @param frame_size 消息总长度
+ */
+bool ChainTask::PutData(evbuffer* in, size_t frame_size) {
+  if (!active_ || local_done_) {
+    Fail("unexpected data");
+    return false;
+  }
+  const char* frame = reinterpret_cast<const char*>(
+      evbuffer_pullup(in, static_cast<ev_ssize_t>(frame_size)));
+  FrameReader reader(frame + Frame::kHeaderSize,
+                     frame_size - Frame::kHeaderSize);
+  uint64_t offset = 0;
+  bool ok = reader.GetU64(&offset);
+  const char* data = reader.rest();
+  size_t len = reader.remaining();
+  if (ok && decoder_) {
+    // 协商压缩后每条消息是完整的编码块, 解码后写入, 原样转发
+    decoded_.clear();
+    if (!decoder_->Feed(data, len, &decoded_) || decoder_->pending()) {
+      Fail("invalid compressed data");
+      return false;
+    }
+    data = decoded_.data();
+    len = decoded_.size();
+  }
+  if (!ok || static_cast<long long>(offset) != written_ ||
+      written_ + static_cast<long long>(len) > size_) {
+    Fail("data out of order");
+    return false;
+  }
+  if (!writer_->WriteAt(written_, data, len)) {
+    Fail("write failed");
+    return false;
+  }
+  crc_ = Crc32c::Extend(crc_, data, len);
+  chunks_->Update(data, len);
+  written_ += static_cast<long long>(len);
+  server_->counters_.put_bytes += static_cast<long long>(len);
+
+  if (forward_) {
+    evbuffer* out = bufferevent_get_output(down_);
+    evbuffer_remove_buffer(in, out, frame_size);
+    server_->counters_.forwarded_bytes += static_cast<long long>(len);
+    // 下游跟不上时停止读取上游, 压力沿链传回客户端
+    if (evbuffer_get_length(out) > options_.high_water) {
+      paused_ = true;
+      bufferevent_disable(up_, EV_READ);
+    }
+  } else {
+    evbuffer_drain(in, frame_size);
+  }
+  MaybeAck();
+  return true;
+}
+
+/**
+ * @brief 结束写入: 校验并提交本地文件, 转发给下游
+ */
+bool ChainTask::EndPut(const Frame& frame) {
+  FrameReader reader(frame.body);
+  uint32_t crc = 0;
+  if (!active_ || local_done_ || !reader.GetU32(&crc)) {
+    Fail("unexpected end");
+    return false;
+  }
+  if (written_ != size_) {
+    Fail("size mismatch");
+    return false;
+  }
+  if (crc != crc_) {
+    Fail("checksum mismatch");
+    return false;
+  }
+  bool ok = writer_->Finish();
+  writer_.reset();
+  if (!ok) {
+    Fail("failed to flush");
+    return false;
+  }
+  chunks_->Finish();
+  local_done_ = true;
+
+  if (forward_) {
+    string end = frame.Encode();
+    bufferevent_write(down_, end.data(), end.size());
+  }
+  MaybeAck();
+  return true;
+}
+
+/**
+ * @brief 响应追赶请求: 发回与请求方不一致的块
+ */
+bool ChainTask::Sync(const Frame& frame) {
+  FrameReader reader(frame.body);
+  string path;
+  uint32_t chunk_size = 0, count = 0;
+  bool ok = reader.GetString(&path) && reader.GetU32(&chunk_size) &&
+            reader.GetU32(&count) && chunk_size > 0 &&
+            count <= reader.remaining() / 4;
+  vector<uint32_t> theirs(ok ? count : 0);
+  for (uint32_t i = 0; ok && i < count; ++i) ok = reader.GetU32(&theirs[i]);
+  id_ = frame.id;
+  if (!ok || !ReplicaServer::ValidPath(path) || active_) {
+    Fail("invalid sync request");
+    return false;
+  }
+
+  string full = (fs::path(options_.root) / path).string();
+#ifdef _WIN32
+  int fd = _open(full.c_str(), _O_RDONLY | _O_BINARY);
+#else
+  int fd = open(full.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) close(fd);
+    // 再平衡期间文件可能还在旧节点上, 本地有就直接返回
+    if (!Owned(path)) {
+      Redirect(frame.id);
+      return true;
+    }
+    Fail("no such file " + path);
+    return false;
+  }
+  long long size = static_cast<long long>(st.st_size);
+
+  // 优先使用写入时保存的分块校验和
+  auto ours = make_shared<ChunkCrc>(chunk_size);
+  if (ours->Load(ChunkCrc::SidecarPath(full)) &&
+      ours->chunk_size() == chunk_size && ours->total_size() == size) {
+    SendSync(frame.id, fd, size, *ours, theirs);
+    return true;
+  }
+
+  // 不可用时在阻塞I/O线程中读取文件计算
+  *ours = ChunkCrc(chunk_size);
+  uint32_t id = frame.id;
+  bool submitted = RunBlocking(
+      [ours, full]() { ComputeChunks(full, ours.get()); },
+      [this, ours, fd, size, id, theirs](bool alive) {
+        if (alive) {
+          SendSync(id, fd, size, *ours, theirs);
+        } else {
+          close(fd);
+        }
+      });
+  if (!submitted) close(fd);
+  return submitted;
+}
+
+/**
+ * @brief 在阻塞I/O线程中执行工作, 期间暂停读取上游
+ *
+ * @param work 阻塞工作
+ * @param done 完成回调, 连接已关闭时参数为false, 只做清理
+ * @return false 节点正在停止, 工作没有提交, 连接已失败
+ */
+bool ChainTask::RunBlocking(function<void()> work,
+                            function<void(bool alive)> done) {
+  waiting_ = true;
+  bufferevent_disable(up_, EV_READ);
+  shared_ptr<bool> alive = alive_;
+  bool submitted = server_->blocking_.Submit(
+      move(work), server_->threads_[thread_id() - 1],
+      [this, alive, done]() {
+        // 工作期间连接已关闭
+        if (!*alive) {
+          done(false);
+          return;
+        }
+        waiting_ = false;
+        done(true);
+        if (paused_ || memory_paused_ || closing_) return;
+        bufferevent_enable(up_, EV_READ);
+        OnUpRead();
+      });
+  if (!submitted) {
+    waiting_ = false;
+    Fail("server is stopping");
+  }
+  return submitted;
+}
+
+/**
+ * @brief 发回与请求方不一致的块
+ *
+ * @param id 请求ID
+ * @param fd 打开的文件, 由本函数关闭
+ * @param size 文件大小
+ * @param ours 本地文件的分块校验和
+ * @param theirs 请求方的分块校验和
+ */
+void ChainTask::SendSync(uint32_t id, int fd, long long size,
+                         const ChunkCrc& ours, const vector<uint32_t>& theirs) {
+  uint32_t chunk_size = static_cast<uint32_t>(ours.chunk_size());
+  FrameWriter begin;
+  begin.PutU64(static_cast<uint64_t>(size));
+  begin.PutU32(chunk_size);
+  begin.PutU32(static_cast<uint32_t>(ours.crcs().size()));
+  for (uint32_t crc : ours.crcs()) begin.PutU32(crc);
+  string message = begin.Finish(FrameType::kSyncBegin, id);
+  evbuffer* out = bufferevent_get_output(up_);
+  evbuffer_add(out, message.data(), message.size());
+
+  // 不一致的块直接引用文件区间, 由`sendfile`发送
+  evbuffer_file_segment* segment =
+      size > 0 ? evbuffer_file_segment_new(fd, 0, size,
+                                           EVBUF_FS_CLOSE_ON_FREE)
+               : nullptr;
+  if (!segment) close(fd);
+  const vector<uint32_t>& crcs = ours.crcs();
+  for (size_t i = 0; segment && i < crcs.size(); ++i) {
+    if (i < theirs.size() && theirs[i] == crcs[i]) continue;
+    long long offset = static_cast<long long>(i) * chunk_size;
+    long long len = min<long long>(chunk_size, size - offset);
+    char header[Frame::kHeaderSize + 8];
+    Frame::EncodeHeader(FrameType::kPutData, id,
+                        static_cast<uint32_t>(8 + len), header);
+    for (int b = 0; b < 8; ++b) {
+      header[Frame::kHeaderSize + b] =
+          static_cast<char>((static_cast<uint64_t>(offset) >> (8 * b)) & 0xff);
+    }
+    evbuffer_add(out, header, sizeof(header));
+    AddFile(out, segment, offset, len);
+    server_->counters_.sync_bytes += len;
+  }
+  if (segment) evbuffer_file_segment_free(segment);
+  ++server_->counters_.syncs;
+
+  string ack = AckFrame(id, AckStatus::kCommitted, size, "");
+  evbuffer_add(out, ack.data(), ack.size());
+}
+
+/**
+ * @brief 写入文件区间(客户端在多个连接上并行写入同一文件)
+ *
+ * @details 出错时只回复错误确认, 不关闭连接, 流水线上的其它请求继续
+ *
+ * @param in 上游输入缓冲区, 第一条消息为`kWriteAt`
+ * @param frame_size 消息总长度
+ */
+void ChainTask::WriteAt(evbuffer* in, size_t frame_size) {
+  // 只复制消息头和路径等字段, 数据直接从缓冲区写入文件
+  char header[Frame::kHeaderSize + 4];
+  evbuffer_copyout(in, header, sizeof(header));
+  FrameType type;
+  uint32_t id = 0, body_size = 0;
+  Frame::DecodeHeader(header, &type, &id, &body_size);
+  FrameReader length(header + Frame::kHeaderSize, 4);
+  uint32_t path_size = 0;
+  length.GetU32(&path_size);
+  size_t fields = 4 + static_cast<size_t>(path_size) + 24;
+  string message;
+  if (fields > body_size) {
+    evbuffer_drain(in, frame_size);
+    message = "invalid write request";
+  } else {
+    evbuffer_drain(in, Frame::kHeaderSize);
+    string prefix(fields, '\0');
+    evbuffer_remove(in, &prefix[0], fields);
+    FrameReader reader(prefix);
+    string path;
+    uint64_t size = 0, upload = 0, offset = 0;
+    reader.GetString(&path);
+    reader.GetU64(&size);
+    reader.GetU64(&upload);
+    reader.GetU64(&offset);
+    size_t len = body_size - fields;
+    if (!ReplicaServer::ValidPath(path) || offset + len > size) {
+      message = "invalid write request";
+    } else if (!Owned(path)) {
+      evbuffer_drain(in, len);
+      Redirect(id);
+      return;
+    } else {
+      fs::path full = fs::path(options_.root) / path;
+      string temp = PartPath(full.string(), upload);
+      error_code ec;
+      fs::create_directories(full.parent_path(), ec);
+#ifdef _WIN32
+      int fd = _open(temp.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY, 0644);
+#else
+      int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+#endif
+      bool ok = fd >= 0 && WriteBuffer(fd, static_cast<long long>(offset),
+                                       in, len);
+      if (fd >= 0) close(fd);
+      if (ok) server_->counters_.put_bytes += static_cast<long long>(len);
+      message = ok ? "" : "write failed";
+    }
+    evbuffer_drain(in, len);
+  }
+  if (!message.empty()) ++server_->counters_.errors;
+  string ack = AckFrame(id,
+                        message.empty() ? AckStatus::kCommitted
+                                        : AckStatus::kError,
+                        0, message);
+  bufferevent_write(up_, ack.data(), ack.size());
+}
+
+/**
+ * @brief 提交按区间写入的文件(阻塞)
+ *
+ * @details 截掉以前中断的上传留下的多余数据, 读取整个文件计算分块校验和,
+ * 带有CRC32C时校验, 不一致时删除临时文件. 改名后保存分块校验和文件
+ *
+ * @return string 错误信息, 成功时为空
+ */
+static string CommitFile(const string& full, uint64_t upload, long long size,
+                         size_t chunk_size, bool verify, uint32_t crc) {
+  string temp = PartPath(full, upload);
+  error_code ec;
+  // 空文件没有区间写入
+  if (size == 0 && !fs::exists(temp, ec)) {
+    fs::create_directories(fs::path(full).parent_path(), ec);
+    ofstream(temp, ios::binary);
+  }
+  if (!fs::exists(temp, ec) ||
+      fs::file_size(temp, ec) < static_cast<uintmax_t>(size)) {
+    return "incomplete file";
+  }
+  fs::resize_file(temp, static_cast<uintmax_t>(size), ec);
+  if (ec) return "failed to commit";
+  ChunkCrc chunks(chunk_size);
+  uint32_t value = 0;
+  ComputeChunks(temp, &chunks, &value);
+  if (chunks.total_size() != size || (verify && value != crc)) {
+    fs::remove(temp, ec);
+    return "checksum mismatch";
+  }
+  fs::rename(temp, full, ec);
+  if (ec) return "failed to commit";
+  chunks.Save(ChunkCrc::SidecarPath(full));
+  return "";
+}
+
+/**
+ * @brief 提交按区间写入的文件
+ *
+ * @details 在阻塞I/O线程中校验CRC32C并保存分块校验和
+ */
+bool ChainTask::Commit(const Frame& frame) {
+  FrameReader reader(frame.body);
+  string path;
+  uint64_t size = 0, upload = 0;
+  uint32_t id = frame.id;
+  auto message = make_shared<string>();
+  if (!reader.GetString(&path) || !reader.GetU64(&size) ||
+      !reader.GetU64(&upload) || !ReplicaServer::ValidPath(path)) {
+    *message = "invalid commit request";
+  } else if (!Owned(path)) {
+    Redirect(frame.id);
+    return true;
+  } else {
+    // 上传ID之后可以带有整个文件的CRC32C
+    uint32_t crc = 0;
+    bool verify = reader.remaining() >= 4 && reader.GetU32(&crc);
+    string full = (fs::path(options_.root) / path).string();
+    size_t chunk_size = options_.chunk_size;
+    long long total = static_cast<long long>(size);
+    FileCache* files = &server_->files_;
+    return RunBlocking(
+        [message, files, full, upload, total, chunk_size, verify, crc]() {
+          *message = CommitFile(full, upload, total, chunk_size, verify, crc);
+          if (message->empty()) files->Invalidate(full);
+        },
+        [this, id, total, message](bool alive) {
+          if (message->empty()) {
+            ++server_->counters_.puts;
+          } else {
+            ++server_->counters_.errors;
+          }
+          if (alive) CommitDone(id, total, *message);
+        });
+  }
+  ++server_->counters_.errors;
+  CommitDone(id, static_cast<long long>(size), *message);
+  return true;
+}
+
+/**
+ * @brief 回复提交结果
+ *
+ * @param id 请求ID
+ * @param size 文件大小
+ * @param message 错误信息, 成功时为空
+ */
+void ChainTask::CommitDone(uint32_t id, long long size,
+                           const string& message) {
+  string ack = AckFrame(id,
+                        message.empty() ? AckStatus::kCommitted
+                                        : AckStatus::kError,
+                        size, message);
+  bufferevent_write(up_, ack.data(), ack.size());
+}
+
+/**
+ * @brief 发送缓冲区释放文件段时释放打开的文件
+ */
+static void ReleaseFile(const evbuffer_file_segment* /*segment*/,
+                        int /*flags*/, void* arg) {
+  delete static_cast<OpenFilePtr*>(arg);
+}
+
+/**
+ * @brief 读取文件区间, 数据由`sendfile`发送, 启用块缓存时从缓存发送
+ *
+ * @details 文件从节点的`FileCache`打开, 重复读取同一文件时复用描述符
+ */
+bool ChainTask::ReadAt(const Frame& frame) {
+  FrameReader reader(frame.body);
+  string path;
+  uint64_t offset = 0, length = 0;
+  bool ok = reader.GetString(&path) && reader.GetU64(&offset) &&
+            reader.GetU64(&length);
+  // 压缩算法列表是后加的字段, 带有该字段时响应中有选中的算法
+  string offered;
+  bool negotiate = ok && reader.remaining() > 0;
+  if (negotiate) ok = reader.GetString(&offered);
+  uint32_t prefix_size = negotiate ? 17 : 16;
+  if (!ok || !ReplicaServer::ValidPath(path) ||
+      length > Frame::kMaxBodySize - prefix_size) {
+    string ack = AckFrame(frame.id, AckStatus::kError, 0, "invalid read");
+    bufferevent_write(up_, ack.data(), ack.size());
+    return true;
+  }
+  string full = (fs::path(options_.root) / path).string();
+  OpenFilePtr file = server_->files_.Open(full);
+  if (!file) {
+    if (!Owned(path)) {
+      Redirect(frame.id);
+    } else {
+      string ack = AckFrame(frame.id, AckStatus::kError, 0, "no such file");
+      bufferevent_write(up_, ack.data(), ack.size());
+    }
+    return true;
+  }
+  long long size = file->size;
+  long long begin = min<long long>(static_cast<long long>(offset), size);
+  long long len = min<long long>(static_cast<long long>(length), size - begin);
+  server_->counters_.sync_bytes += len;
+  Readahead(file, begin, len);
+
+  CompressionCodec codec = CompressionCodec::kNone;
+  if (negotiate && options_.compression_workers > 0 && len > 0 &&
+      len <= kMaxCompressRange) {
+    codec = Compression::Negotiate(offered);
+  }
+  if (codec != CompressionCodec::kNone) {
+    return SendCompressed(frame.id, file, begin, len, codec);
+  }
+
+  char header[Frame::kHeaderSize + 17];
+  Frame::EncodeHeader(FrameType::kData, frame.id,
+                      static_cast<uint32_t>(prefix_size + len), header);
+  FrameWriter prefix;
+  prefix.PutU64(static_cast<uint64_t>(size));
+  prefix.PutU64(static_cast<uint64_t>(begin));
+  if (negotiate) prefix.PutU8(static_cast<uint8_t>(CompressionCodec::kNone));
+  memcpy(header + Frame::kHeaderSize, prefix.body().data(), prefix_size);
+  evbuffer* out = bufferevent_get_output(up_);
+  evbuffer_add(out, header, Frame::kHeaderSize + prefix_size);
+  if (server_->cache_ && len > 0 && SendCached(*file, begin, len)) {
+    return true;
+  }
+  // 描述符由缓存共享, 文件段释放时只释放引用
+  evbuffer_file_segment* segment =
+      len > 0 ? evbuffer_file_segment_new(file->fd, begin, len, 0) : nullptr;
+  if (segment) {
+    evbuffer_file_segment_add_cleanup_cb(segment, ReleaseFile,
+                                         new OpenFilePtr(file));
+    AddFile(out, segment, 0, len);
+    evbuffer_file_segment_free(segment);
+  }
+  return true;
+}
+
+/**
+ * @brief 发送缓冲区释放压缩后的数据
+ */
+static void ReleaseBuffer(const void* /*data*/, size_t /*len*/, void* arg) {
+  delete static_cast<shared_ptr<string>*>(arg);
+}
+
+/**
+ * @brief 在阻塞I/O线程中读取文件区间并压缩后发送
+ *
+ * @details 区间按`kCompressPiece`分块编码, 压缩预算不足的块以原文编码;
+ * 工作期间暂停读取上游, 响应保持请求的顺序
+ *
+ * @param id 请求ID
+ * @param file 读取的文件
+ * @param begin 区间起始偏移
+ * @param len 区间长度
+ * @param codec 协商得到的压缩算法
+ * @return false 节点正在停止, 连接已失败
+ */
+bool ChainTask::SendCompressed(uint32_t id, const OpenFilePtr& file,
+                               long long begin, long long len,
+                               CompressionCodec codec) {
+  auto body = make_shared<string>();
+  auto ok = make_shared<bool>(false);
+  CompressionBudget* budget = &server_->compression_;
+  int level = options_.compression_level;
+  long long size = file->size;
+  return RunBlocking(
+      [file, begin, len, codec, level, budget, body, ok]() {
+        string data(static_cast<size_t>(len), '\0');
+        if (ReadFull(file->fd, &data[0], data.size(), begin) != len) return;
+        ChunkEncoder encoder(codec, level, budget);
+        for (long long pos = 0; pos < len; pos += kCompressPiece) {
+          size_t n = static_cast<size_t>(min(kCompressPiece, len - pos));
+          if (!encoder.Encode(data.data() + pos, n, body.get())) return;
+        }
+        *ok = true;
+      },
+      [this, id, size, begin, codec, body, ok](bool alive) {
+        if (!alive) return;
+        if (!*ok || body->size() > Frame::kMaxBodySize - 17) {
+          string ack = AckFrame(id, AckStatus::kError, 0, "read failed");
+          bufferevent_write(up_, ack.data(), ack.size());
+          return;
+        }
+        char header[Frame::kHeaderSize + 17];
+        Frame::EncodeHeader(FrameType::kData, id,
+                            static_cast<uint32_t>(17 + body->size()), header);
+        FrameWriter prefix;
+        prefix.PutU64(static_cast<uint64_t>(size));
+        prefix.PutU64(static_cast<uint64_t>(begin));
+        prefix.PutU8(static_cast<uint8_t>(codec));
+        memcpy(header + Frame::kHeaderSize, prefix.body().data(), 17);
+        evbuffer* out = bufferevent_get_output(up_);
+        evbuffer_add(out, header, sizeof(header));
+        evbuffer_add_reference(out, body->data(), body->size(),
+                               ReleaseBuffer, new shared_ptr<string>(body));
+      });
+}
+
+/**
+ * @brief 记录一次文件读取, 按访问模式预读
+ *
+ * @details 连接顺序读取同一文件时, 预读在阻塞I/O线程池中执行;
+ * 读取其它文件(或文件被替换)时重新开始判断访问模式
+ *
+ * @param file 读取的文件
+ * @param begin 区间起始偏移
+ * @param len 区间长度
+ */
+void ChainTask::Readahead(const OpenFilePtr& file, long long begin,
+                          long long len) {
+  if (!options_.readahead || len <= 0) return;
+  if (!readahead_ || readahead_->file() != file) {
+    readahead_.reset(new ReadaheadStream(&server_->blocking_, file,
+                                         options_.readahead_options));
+  }
+  long long before = readahead_->stats().prefetched_bytes;
+  readahead_->OnSend(begin, len);
+  server_->counters_.prefetched_bytes +=
+      readahead_->stats().prefetched_bytes - before;
+}
+
+/**
+ * @brief 把文件区间加入上游发送缓冲区
+ *
+ * @details 一次`sendfile`会发送一整段, 不受单次写入上限约束;
+ * 限速时按`WriteThrottle::kQuantum`分成多段, 超出令牌的部分不超过一段
+ *
+ * @param out 上游发送缓冲区
+ * @param segment 打开的文件段
+ * @param offset 区间在文件段中的偏移
+ * @param len 区间长度
+ */
+void ChainTask::AddFile(evbuffer* out, evbuffer_file_segment* segment,
+                        long long offset, long long len) {
+  long long piece = up_throttle_ ? WriteThrottle::kQuantum : len;
+  for (long long done = 0; done < len; done += piece) {
+    evbuffer_add_file_segment(out, segment, offset + done,
+                              min(piece, len - done));
+  }
+}
+
+/**
+ * @brief 发送缓冲区释放缓存块的引用
+ */
+static void ReleaseBlock(const void* /*data*/, size_t /*len*/, void* arg) {
+  delete static_cast<CacheBlockPtr*>(arg);
+}
+
+/**
+ * @brief 通过块缓存发送文件区间
+ *
+ * @details 缓存块按引用加入发送缓冲区, 不复制, 发送完后释放引用
+ *
+ * @param file 打开的文件, 内容标识作为块缓存的文件ID
+ * @param begin 区间起始偏移
+ * @param len 区间长度
+ * @return true 已加入发送缓冲区
+ * @return false 读取文件失败, 没有加入任何数据
+ */
+bool ChainTask::SendCached(const OpenFile& file, long long begin,
+                           long long len) {
+  BlockCache* cache = server_->cache_.get();
+  vector<CacheBlockPtr> blocks;
+  if (!cache->ReadBlocks(file.file_id, file.fd, begin, len, &blocks)) {
+    return false;
+  }
+  evbuffer* out = bufferevent_get_output(up_);
+  long long skip = begin % static_cast<long long>(cache->block_size());
+  for (const CacheBlockPtr& block : blocks) {
+    long long piece =
+        min(len, static_cast<long long>(block->data.size()) - skip);
+    if (piece <= 0) break;
+    evbuffer_add_reference(out, block->data.data() + skip,
+                           static_cast<size_t>(piece), ReleaseBlock,
+                           new CacheBlockPtr(block));
+    len -= piece;
+    skip = 0;
+  }
+  return true;
+}
+
+/**
+ * @brief 获取或更新分片表
+ */
+bool ChainTask::HandleMap(const Frame& frame) {
+  if (frame.type == FrameType::kGetMap) {
+    auto map = server_->shard_map();
+    Frame reply;
+    reply.type = FrameType::kMap;
+    reply.id = frame.id;
+    reply.body = map ? map->Encode() : ShardMap().Encode();
+    string out = reply.Encode();
+    bufferevent_write(up_, out.data(), out.size());
+    return true;
+  }
+  ShardMap map;
+  bool ok = map.Decode(frame.body) && server_->SetShardMap(map);
+  string ack = AckFrame(frame.id,
+                        ok ? AckStatus::kCommitted : AckStatus::kError, 0,
+                        ok ? "" : "stale or invalid shard map");
+  bufferevent_write(up_, ack.data(), ack.size());
+  return true;
+}
+
+/**
+ * @brief 判断文件是否归本节点(未设置分片表时总是归本节点)
+ */
+bool ChainTask::Owned(const string& path) const {
+  auto map = server_->shard_map();
+  return !map || map->size() == 0 || map->Owns(options_.address, path);
+}
+
+/**
+ * @brief 回复重定向并丢弃该请求的后续消息
+ */
+void ChainTask::Redirect(uint32_t id) {
+  ++server_->counters_.redirects;
+  discarding_ = true;
+  discard_id_ = id;
+  Frame reply;
+  reply.type = FrameType::kRedirect;
+  reply.id = id;
+  reply.body = server_->shard_map()->Encode();
+  string out = reply.Encode();
+  bufferevent_write(up_, out.data(), out.size());
+}
+
+/**
+ * @brief 按本地和下游的进度向上游确认
+ */
+void ChainTask::MaybeAck() {
+  if (!active_) return;
+  // 整条链都写完后才改名, 失败的写入在任何节点上都不可见
+  if (local_done_ && (!forward_ || down_done_)) {
+    error_code ec;
+    fs::rename(temp_path_, path_, ec);
+    if (ec) {
+      Fail("failed to commit");
+      return;
+    }
+    server_->files_.Invalidate(path_);
+    chunks_->Save(ChunkCrc::SidecarPath(path_));
+    ++server_->counters_.puts;
+    string ack = AckFrame(id_, AckStatus::kCommitted, size_, "");
+    bufferevent_write(up_, ack.data(), ack.size());
+    active_ = false;
+    chunks_.reset();
+    return;
+  }
+  long long offset = forward_ ? min(written_, down_acked_) : written_;
+  if (offset - acked_ >= options_.ack_bytes) {
+    string ack = AckFrame(id_, AckStatus::kProgress, offset, "");
+    bufferevent_write(up_, ack.data(), ack.size());
+    acked_ = offset;
+  }
+}
+
+/**
+ * @brief 处理下游返回的确认
+ */
+void ChainTask::OnDownRead() {
+  evbuffer* in = bufferevent_get_input(down_);
+  Frame frame;
+  int re;
+  while ((re = Frame::Pop(in, &frame)) > 0) {
+    if (frame.type != FrameType::kAck || !active_ || frame.id != id_) {
+      continue;
+    }
+    FrameReader reader(frame.body);
+    uint8_t status = 0;
+    uint64_t offset = 0;
+    string message;
+    if (!reader.GetU8(&status) || !reader.GetU64(&offset) ||
+        !reader.GetString(&message)) {
+      re = -1;
+      break;
+    }
+    if (status == static_cast<uint8_t>(AckStatus::kError)) {
+      Fail("replica " + down_address_ + ": " + message);
+      return;
+    }
+    down_acked_ = max(down_acked_, static_cast<long long>(offset));
+    if (status == static_cast<uint8_t>(AckStatus::kCommitted)) {
+      down_done_ = true;
+    }
+    MaybeAck();
+  }
+  if (re < 0) Fail("malformed ack from " + down_address_);
+}
+
+/**
+ * @brief 下游发送缓冲区降到低水位, 恢复处理上游数据
+ */
+void ChainTask::OnDownWrite() {
+  if (!paused_ || closing_) return;
+  paused_ = false;
+  if (memory_paused_ || waiting_) return;
+  bufferevent_enable(up_, EV_READ);
+  OnUpRead();
+}
+
+void ChainTask::OnDownEvent(short events) {
+  if (events & BEV_EVENT_CONNECTED) return;
+  if (active_ && forward_ && !down_done_) {
+    Fail("lost replica " + down_address_);
+    return;
+  }
+  CloseDown();
+}
+
+/**
+ * @brief 错误确认发送完毕后关闭连接, 否则检查是否恢复读取
+ */
+void ChainTask::OnUpWrite() {
+  if (closing_ && evbuffer_get_length(bufferevent_get_output(up_)) == 0) {
+    Close();
+    return;
+  }
+  TrackMemory();
+}
+
+void ChainTask::OnUpEvent(short events) {
+  if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) Close();
+}
+
+/**
+ * @brief 写入失败: 向上游发送错误确认, 发送完成后关闭连接
+ */
+void ChainTask::Fail(const string& message) {
+  cerr << "ChainTask::Fail() " << message << endl;
+  ++server_->counters_.errors;
+  AbortPut();
+  CloseDown();
+  string ack = AckFrame(id_, AckStatus::kError, 0, message);
+  bufferevent_write(up_, ack.data(), ack.size());
+  bufferevent_disable(up_, EV_READ);
+  closing_ = true;
+}
+
+/**
+ * @brief 丢弃未提交的临时文件
+ */
+void ChainTask::AbortPut() {
+  if (!active_) return;
+  active_ = false;
+  writer_.reset();
+  error_code ec;
+  fs::remove(temp_path_, ec);
+  chunks_.reset();
+}
+
+/**
+ * @brief 更新连接的内存用量, 按连接和全局预算暂停或恢复读取上游
+ *
+ * @details 用量是上下游收发缓冲区的总长度, 其中`sendfile`发送的文件区间
+ * 并不占用内存, 按长度计入偏保守. 发往上游的数据超出连接预算,
+ * 或全局超出预算且还有待发送的数据时暂停读取请求, 请求留在内核缓冲区,
+ * 反压传到客户端; 降到连接预算的一半(全局超出时发送完)后恢复
+ */
+void ChainTask::TrackMemory() {
+  long long output = evbuffer_get_length(bufferevent_get_output(up_));
+  long long used = output + evbuffer_get_length(bufferevent_get_input(up_));
+  if (down_) {
+    used += evbuffer_get_length(bufferevent_get_output(down_)) +
+            evbuffer_get_length(bufferevent_get_input(down_));
+  }
+  memory_.Update(used);
+
+  long long limit = memory_.limit();
+  bool global = server_->memory_.over_limit() && output > 0;
+  if (!memory_paused_) {
+    if (!global && (limit <= 0 || output <= limit)) return;
+    memory_paused_ = true;
+    server_->memory_.RecordPause();
+    bufferevent_disable(up_, EV_READ);
+    return;
+  }
+  if (global || (limit > 0 && output > limit / 2)) return;
+  memory_paused_ = false;
+  if (paused_ || closing_ || waiting_) return;
+  bufferevent_enable(up_, EV_READ);
+  OnUpRead();
+}
+
+void ChainTask::CloseDown() {
+  if (!down_) return;
+  down_throttle_.reset();
+  bufferevent_free(down_);
+  down_ = nullptr;
+  down_address_.clear();
+}
+
+/**
+ * @brief 关闭连接并删除任务
+ */
+void ChainTask::Close() {
+  *alive_ = false;
+  AbortPut();
+  CloseDown();
+  up_throttle_.reset();
+  bufferevent_free(up_);
+  up_ = nullptr;
+  memory_.Update(0);
+  server_->memory_.Charge(MemoryCategory::kTask, thread_id(),
+                          -static_cast<long long>(sizeof(ChainTask)));
+  server_->listen_task_->ConnectionClosed();
+  server_->connections_[thread_id() - 1].erase(this);
+  delete this;
+}
+
+/**
+ * @brief 监听回调: 新连接交给副本节点分发
+ */
+static void ReplicaListenCB(int sock, sockaddr* addr, int /*socklen*/,
+                            void* user_arg) {
+  auto* task = static_cast<ReplicaListenTask*>(user_arg);
+  task->server()->Accept(sock, task->RegisterRateLimit(addr));
+}
+
+/**
+ * @brief 构造副本节点
+ *
+ * @param options 节点参数
+ */
+ReplicaServer::ReplicaServer(const ReplicaOptions& options)
+    : options_(options),
+      memory_(options.memory_limit, max(options.threads, 1)),
+      files_(options.open_files),
+      compression_(options.compression_workers, options.compression_rate) {
+  if (options_.cache_capacity > 0) {
+    cache_.reset(new BlockCache(options_.cache_capacity));
+    cache_->set_memory_budget(&memory_);
+  }
+}
+
+/**
+ * @brief 停止节点, 见`Stop`
+ */
+ReplicaServer::~ReplicaServer() { Stop(); }
+
+/**
+ * @brief 启动事件循环线程并开始监听
+ *
+ * @return true 成功
+ * @return false 参数错误、创建目录或监听失败
+ */
+bool ReplicaServer::Start() {
+  if (options_.port <= 0 || options_.root.empty() || !threads_.empty()) {
+    cerr << "ReplicaServer::Start() Invalid options" << endl;
+    return false;
+  }
+  error_code ec;
+  fs::create_directories(options_.root, ec);
+  if (ec) {
+    cerr << "ReplicaServer::Start() Failed to create " << options_.root
+         << endl;
+    return false;
+  }
+  blocking_.Init(max(options_.blocking_threads, 1));
+  int count = max(options_.threads, 1);
+  connections_.resize(count);
+  for (int i = 0; i < count; ++i) {
+    Thread* thread = new Thread();
+    thread->id_ = i + 1;
+    thread->set_busy_poll(options_.busy_poll);
+    thread->Start();
+    threads_.push_back(thread);
+  }
+
+  auto* task = new ReplicaListenTask(this);
+  task->set_server_port(options_.port);
+  task->set_socket_busy_poll_us(options_.busy_poll.socket_busy_poll_us);
+  task->ListenCB = ReplicaListenCB;
+  if (options_.connection_rate > 0 || options_.client_rate > 0 ||
+      options_.total_rate > 0) {
+    limiter_.SetGlobalLimit(options_.total_rate, 0);
+    limiter_.SetClientLimit(options_.client_rate, 0);
+    limiter_.SetConnectionLimit(options_.connection_rate, 0);
+    task->set_rate_limiter(&limiter_);
+    forward_limit_ = limiter_.Register("");
+  }
+  if (options_.memory_limit > 0) {
+    task->AdmissionCheck = AdmitMemory;
+    task->admission_arg = this;
+  }
+  future<bool> ready = task->ready();
+  listen_task_ = task;
+  threads_[0]->AddTask(task);
+  threads_[0]->Activate();
+  return ready.get();
+}
+
+/**
+ * @brief 停止节点(阻塞)
+ *
+ * @details 事件循环是无锁的, 监听和连接只能在所属线程中释放:
+ * 先在监听线程中关闭监听, 之后不再分发新连接; 等待阻塞I/O完成,
+ * 完成回调已投递到事件循环线程; 再在每个线程中关闭
+ * 该线程上的连接, 已分发但还没开始的连接看到`stopped_`后直接关闭.
+ * 线程上没有事件后停止并释放线程
+ */
+void ReplicaServer::Stop() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cond_.notify_all();
+  if (rebalancer_.joinable()) rebalancer_.join();
+  if (threads_.empty()) return;
+
+  // 在线程中执行并等待完成
+  auto run = [](Thread* thread, function<void()> work) {
+    promise<void> done;
+    BlockingPool::Post(thread, [&]() {
+      work();
+      done.set_value();
+    });
+    done.get_future().wait();
+  };
+  if (listen_task_) run(threads_[0], [this]() { listen_task_->Close(); });
+  // 已提交的阻塞I/O完成后, 完成回调排在关闭连接之前
+  blocking_.Stop();
+  stopped_ = true;
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    run(threads_[i], [this, i]() {
+      // 关闭时从集合中删除, 先复制
+      vector<ChainTask*> tasks(connections_[i].begin(),
+                               connections_[i].end());
+      for (ChainTask* task : tasks) task->Close();
+    });
+  }
+  for (Thread* thread : threads_) {
+    thread->Stop();
+    delete thread;
+  }
+  threads_.clear();
+  delete listen_task_;
+  listen_task_ = nullptr;
+}
+
+/**
+ * @brief 把新连接分发给事件循环线程(由监听回调调用)
+ *
+ * @param sock 新连接的socket
+ * @param rate_limit 连接的限速句柄, 不限速时为空
+ */
+void ReplicaServer::Accept(int sock, shared_ptr<RateLimitHandle> rate_limit) {
+  evutil_make_socket_nonblocking(sock);
+  int one = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY,
+             reinterpret_cast<const char*>(&one), sizeof(one));
+  Thread* thread = threads_[next_thread_++ % threads_.size()];
+  auto* task = new ChainTask(this, move(rate_limit));
+  task->set_sock(sock);
+  thread->AddTask(task);
+  thread->Activate();
+}
+
+/**
+ * @brief 准入检查: 超出全局内存预算时拒绝新连接
+ *
+ * @param user_arg `ReplicaServer`对象指针
+ */
+bool ReplicaServer::AdmitMemory(void* user_arg) {
+  MemoryBudget& memory = static_cast<ReplicaServer*>(user_arg)->memory_;
+  if (!memory.over_limit()) return true;
+  memory.RecordShed();
+  return false;
+}
+
+/**
+ * @brief 检查相对路径是否合法(非空、非绝对路径、不含`..`)
+ */
+bool ReplicaServer::ValidPath(const string& path) {
+  return ValidRelativePath(path);
+}
+
+/**
+ * @brief 设置分片表并触发再平衡
+ *
+ * @param map 分片表
+ * @return true 成功
+ * @return false 未配置本节点地址或版本不比当前的新
+ */
+bool ReplicaServer::SetShardMap(const ShardMap& map) {
+  if (options_.address.empty()) {
+    cerr << "ReplicaServer::SetShardMap() No node address configured" << endl;
+    return false;
+  }
+  lock_guard<mutex> lock(mutex_);
+  if (map_ && map.version() <= map_->version()) return false;
+  map_ = make_shared<const ShardMap>(map);
+  if (!rebalancer_.joinable()) rebalancer_ = thread(&ReplicaServer::Main, this);
+  cond_.notify_all();
+  return true;
+}
+
+/**
+ * @brief 当前分片表, 未设置时为`nullptr`
+ */
+shared_ptr<const ShardMap> ReplicaServer::shard_map() const {
+  lock_guard<mutex> lock(mutex_);
+  return map_;
+}
+
+/**
+ * @brief 再平衡线程入口: 分片表更新后扫描数据目录
+ *
+ * @details 有文件移动失败(如归属节点暂时不可用)时稍后重试
+ */
+void ReplicaServer::Main() {
+  unique_lock<mutex> lock(mutex_);
+  uint64_t done = 0;
+  while (!stopping_) {
+    if (!map_ || map_->version() == done) {
+      cond_.wait(lock);
+      continue;
+    }
+    shared_ptr<const ShardMap> map = map_;
+    lock.unlock();
+    bool complete = Rebalance(*map);
+    lock.lock();
+    if (complete) {
+      done = map->version();
+      ++counters_.rebalances;
+    } else if (!stopping_ && map_ == map) {
+      cond_.wait_for(lock, chrono::seconds(1));
+    }
+  }
+}
+
+/**
+ * @brief 把不归本节点的文件移到归属节点
+ *
+ * @param map 分片表
+ * @return true 全部移完
+ * @return false 有文件移动失败或扫描期间分片表已更新
+ */
+bool ReplicaServer::Rebalance(const ShardMap& map) {
+  // 先列出再移动, 避免边遍历边删除
+  vector<string> moving;
+  error_code ec;
+  for (fs::recursive_directory_iterator it(options_.root, ec), end;
+       !ec && it != end; it.increment(ec)) {
+    if (!it->is_regular_file(ec)) continue;
+    string path = it->path().lexically_relative(options_.root).generic_string();
+    // 临时文件和校验和文件随正式文件处理
+    if (HasSuffix(path, kTempSuffix) || HasSuffix(path, kPartSuffix) ||
+        HasSuffix(path, ChunkCrc::SidecarPath(""))) {
+      continue;
+    }
+    if (!map.Owns(options_.address, path)) moving.push_back(path);
+  }
+
+  // 每个归属节点保持一个连接
+  std::map<string, unique_ptr<ChainClient>> clients;
+  vector<char> buffer(kReadBufferSize);
+  bool complete = !ec;
+  for (const string& path : moving) {
+    {
+      lock_guard<mutex> lock(mutex_);
+      if (stopping_ || map_.get() != &map) return false;
+    }
+    vector<string> owners = map.Owners(path);
+    if (owners.empty()) return false;
+    auto& client = clients[owners[0]];
+    if (!client) client = make_unique<ChainClient>();
+    if (!client->connected() && !client->Connect(owners[0])) {
+      complete = false;
+      continue;
+    }
+    fs::path full = fs::path(options_.root) / path;
+    ifstream in(full, ios::binary);
+    long long size = static_cast<long long>(fs::file_size(full, ec));
+    if (!in || ec) continue;
+    vector<string> chain(owners.begin() + 1, owners.end());
+    bool ok = client->Begin(path, size, chain, kPutIfAbsent);
+    long long sent = 0;
+    while (ok && sent < size) {
+      in.read(buffer.data(), min<long long>(buffer.size(), size - sent));
+      ok = in.gcount() > 0 && client->Write(buffer.data(), in.gcount());
+      sent += in.gcount();
+    }
+    if (!(ok && client->End())) {
+      cerr << "ReplicaServer::Rebalance() Failed to move " << path << " to "
+           << owners[0] << endl;
+      client->Close();
+      complete = false;
+      continue;
+    }
+    in.close();
+    fs::remove(full, ec);
+    fs::remove(ChunkCrc::SidecarPath(full.string()), ec);
+    files_.Invalidate(full.string());
+    ++counters_.moved_files;
+    counters_.moved_bytes += size;
+  }
+  return complete;
+}
+
+/**
+ * @brief 获取统计信息
+ *
+ * @return ReplicaStats 统计信息
+ */
+ReplicaStats ReplicaServer::stats() const {
+  ReplicaStats stats;
+  stats.puts = counters_.puts;
+  stats.put_bytes = counters_.put_bytes;
+  stats.forwarded_bytes = counters_.forwarded_bytes;
+  stats.syncs = counters_.syncs;
+  stats.sync_bytes = counters_.sync_bytes;
+  stats.errors = counters_.errors;
+  stats.redirects = counters_.redirects;
+  stats.moved_files = counters_.moved_files;
+  stats.moved_bytes = counters_.moved_bytes;
+  stats.rebalances = counters_.rebalances;
+  stats.prefetched_bytes = counters_.prefetched_bytes;
+  return stats;
+}
+
+/**
+ * @brief 从源节点追赶一个文件(阻塞)
+ *
+ * @param root 本地数据根目录
+ * @param path 相对根目录的文件路径
+ * @param source 源节点地址(`IP:端口`)
+ * @param chunk_size 分块大小, 需与源节点一致
+ * @param fetched 输出从源节点接收的数据字节数, 可以为`nullptr`
+ * @return true 追赶完成, 本地文件与源文件一致
+ * @return false 连接失败、源文件不存在或校验失败
+ */
+bool ReplicaServer::CatchUp(const string& root, const string& path,
+                            const string& source, size_t chunk_size,
+                            long long* fetched) {
+  if (fetched) *fetched = 0;
+  if (!ValidPath(path) || chunk_size == 0) return false;
+  fs::path full = fs::path(root) / path;
+  ChunkCrc local(chunk_size);
+  ComputeChunks(full.string(), &local);
+
+  int sock = ConnectTo(source);
+  if (sock < 0) {
+    cerr << "ReplicaServer::CatchUp() Failed to connect " << source << endl;
+    return false;
+  }
+  FrameWriter request;
+  request.PutString(path);
+  request.PutU32(static_cast<uint32_t>(chunk_size));
+  request.PutU32(static_cast<uint32_t>(local.crcs().size()));
+  for (uint32_t crc : local.crcs()) request.PutU32(crc);
+  string inbox;
+  bool ok = SendAll(sock, request.Finish(FrameType::kSyncRequest, 1));
+
+  error_code ec;
+  fstream file;
+  uint64_t size = 0;
+  vector<uint32_t> crcs;
+  bool committed = false;
+  Frame frame;
+  while (ok && !committed && RecvFrame(sock, &inbox, &frame)) {
+    FrameReader reader(frame.body);
+    if (frame.type == FrameType::kSyncBegin) {
+      uint32_t chunk = 0, count = 0;
+      ok = reader.GetU64(&size) && reader.GetU32(&chunk) &&
+           reader.GetU32(&count) && chunk == chunk_size &&
+           count <= reader.remaining() / 4;
+      crcs.resize(ok ? count : 0);
+      for (uint32_t i = 0; ok && i < count; ++i) ok = reader.GetU32(&crcs[i]);
+      // 源文件存在时才创建本地文件
+      fs::create_directories(full.parent_path(), ec);
+      if (!fs::exists(full)) ofstream(full, ios::binary);
+      file.open(full, ios::binary | ios::in | ios::out);
+      ok = ok && file.is_open();
+    } else if (frame.type == FrameType::kPutData) {
+      uint64_t offset = 0;
+      ok = file.is_open() && reader.GetU64(&offset);
+      file.seekp(static_cast<streamoff>(offset));
+      file.write(reader.rest(), reader.remaining());
+      ok = ok && !file.fail();
+      if (fetched) *fetched += static_cast<long long>(reader.remaining());
+    } else if (frame.type == FrameType::kAck) {
+      uint8_t status = 0;
+      string message;
+      uint64_t offset = 0;
+      ok = reader.GetU8(&status) && reader.GetU64(&offset) &&
+           reader.GetString(&message) &&
+           status == static_cast<uint8_t>(AckStatus::kCommitted);
+      if (!ok) cerr << "ReplicaServer::CatchUp() " << message << endl;
+      committed = ok;
+    }
+  }
+  evutil_closesocket(sock);
+  file.close();
+  if (!ok || !committed) return false;
+
+  // 截断到源文件大小后重新校验全部块
+  fs::resize_file(full, size, ec);
+  ChunkCrc result(chunk_size);
+  ComputeChunks(full.string(), &result);
+  if (ec || result.total_size() != static_cast<long long>(size) ||
+      result.crcs() != crcs) {
+    cerr << "ReplicaServer::CatchUp() Verification failed for " << path
+         << endl;
+    return false;
+  }
+  return result.Save(ChunkCrc::SidecarPath(full.string()));
+}
+
+ChainClient::~ChainClient() { Close(); }
+
+/**
+ * @brief 连接链首节点
+ *
+ * @param address 节点地址(`IP:端口`)
+ * @return true 成功
+ * @return false 连接失败
+ */
+bool ChainClient::Connect(const string& address) {
+  Close();
+  sock_ = ConnectTo(address);
+  return sock_ >= 0;
+}
+
+/**
+ * @brief 写入整个文件并等待整条链提交
+ *
+ * @param path 相对根目录的文件路径
+ * @param data 文件内容
+ * @param len 文件大小
+ * @param chain 链首之后的副本地址
+ * @param piece 每条`kPutData`消息的数据大小
+ * @return true 所有副本已提交
+ * @return false 发送失败或某个副本失败
+ */
+bool ChainClient::Put(const string& path, const char* data, size_t len,
+                      const vector<string>& chain, size_t piece) {
+  return Begin(path, static_cast<long long>(len), chain) &&
+         Write(data, len, piece) && End();
+}
+
+/**
+ * @brief 开始写入文件
+ */
+bool ChainClient::Begin(const string& path, long long size,
+                        const vector<string>& chain, uint8_t flags) {
+  if (sock_ < 0) return false;
+  id_ = next_id_++;
+  offset_ = 0;
+  acked_ = 0;
+  crc_ = 0;
+  failed_ = false;
+  committed_ = false;
+  redirect_.clear();
+  codec_ = CompressionCodec::kNone;
+  encoder_.reset();
+  encoded_base_ = 0;
+  FrameWriter writer;
+  writer.PutString(path);
+  writer.PutU64(static_cast<uint64_t>(size));
+  writer.PutU32(static_cast<uint32_t>(chain.size()));
+  for (const string& address : chain) writer.PutString(address);
+  writer.PutU8(flags);
+  if (!codecs_.empty()) {
+    writer.PutString(codecs_);
+    // 节点回复选中的算法之前以原文编码
+    encoder_.reset(new ChunkEncoder(CompressionCodec::kNone));
+  }
+  return SendAll(sock_, writer.Finish(FrameType::kPutBegin, id_));
+}
+
+/**
+ * @brief 发送文件数据(按顺序)
+ */
+bool ChainClient::Write(const char* data, size_t len, size_t piece) {
+  if (sock_ < 0 || failed_) return false;
+  piece = max<size_t>(piece, 1);
+  // 节点跳过写入时已经提交, 不再发送
+  for (size_t pos = 0; pos < len && !committed_; pos += piece) {
+    size_t n = min(piece, len - pos);
+    FrameWriter writer;
+    writer.PutU64(static_cast<uint64_t>(offset_));
+    if (encoder_) {
+      string encoded;
+      if (!encoder_->Encode(data + pos, n, &encoded)) return false;
+      writer.PutBytes(encoded.data(), encoded.size());
+    } else {
+      writer.PutBytes(data + pos, n);
+    }
+    if (!SendAll(sock_, writer.Finish(FrameType::kPutData, id_))) {
+      return false;
+    }
+    crc_ = Crc32c::Extend(crc_, data + pos, n);
+    offset_ += static_cast<long long>(n);
+    // 及早发现副本失败
+    if (!DrainAcks(false)) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 结束写入并等待整条链提交
+ */
+bool ChainClient::End() {
+  if (sock_ < 0 || failed_) return false;
+  if (committed_) return true;
+  FrameWriter writer;
+  writer.PutU32(crc_);
+  if (!SendAll(sock_, writer.Finish(FrameType::kPutEnd, id_))) return false;
+  return DrainAcks(true);
+}
+
+/**
+ * @brief 读取已到达的确认, 等待提交时阻塞
+ *
+ * @param wait_commit 是否等待到提交或失败
+ * @return true 没有失败(等待提交时为已提交)
+ * @return false 连接断开或某个副本失败
+ */
+bool ChainClient::DrainAcks(bool wait_commit) {
+  char buffer[4096];
+  while (true) {
+    Frame frame;
+    int re;
+    while ((re = ParseFrame(&inbox_, &frame)) > 0) {
+      if (frame.type == FrameType::kRedirect && frame.id == id_) {
+        redirect_ = frame.body;
+        failed_ = true;
+        return false;
+      }
+      FrameReader reader(frame.body);
+      uint8_t status = 0;
+      uint64_t offset = 0;
+      string message;
+      if (frame.type != FrameType::kAck || frame.id != id_ ||
+          !reader.GetU8(&status) || !reader.GetU64(&offset) ||
+          !reader.GetString(&message)) {
+        continue;
+      }
+      acked_ = static_cast<long long>(offset);
+      // 节点选中的压缩算法, 之后的数据块用该算法编码
+      CompressionCodec codec;
+      if (status == static_cast<uint8_t>(AckStatus::kProgress) && encoder_ &&
+          Compression::ParseCodec(message, &codec) && codec != codec_) {
+        codec_ = codec;
+        encoded_base_ += encoder_->encoded_bytes();
+        encoder_.reset(new ChunkEncoder(codec, level_));
+      }
+      if (status == static_cast<uint8_t>(AckStatus::kError)) {
+        cerr << "ChainClient::DrainAcks() " << message << endl;
+        failed_ = true;
+        return false;
+      }
+      if (status == static_cast<uint8_t>(AckStatus::kCommitted)) {
+        committed_ = true;
+        return true;
+      }
+    }
+    if (re < 0) return false;
+#ifdef MSG_DONTWAIT
+    int flags = wait_commit ? 0 : MSG_DONTWAIT;
+#else
+    int flags = 0;
+    if (!wait_commit) return true;
+#endif
+    auto n = recv(sock_, buffer, sizeof(buffer), flags);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && !wait_commit && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return true;
+    }
+    if (n <= 0) return false;
+    inbox_.append(buffer, n);
+  }
+}
+
+/**
+ * @brief 读取整个文件
+ *
+ * @details 复用追赶协议: 不带校验和的`kSyncRequest`使源节点发回全部块
+ *
+ * @param path 相对根目录的文件路径
+ * @param data 输出文件内容
+ * @return true 成功
+ * @return false 文件不存在、被重定向或连接断开
+ */
+bool ChainClient::Get(const string& path, string* data) {
+  if (sock_ < 0) return false;
+  id_ = next_id_++;
+  redirect_.clear();
+  FrameWriter request;
+  request.PutString(path);
+  request.PutU32(static_cast<uint32_t>(kReadBufferSize));
+  request.PutU32(0);
+  if (!SendAll(sock_, request.Finish(FrameType::kSyncRequest, id_))) {
+    return false;
+  }
+  data->clear();
+  Frame frame;
+  while (RecvFrame(sock_, &inbox_, &frame)) {
+    if (frame.id != id_) continue;
+    FrameReader reader(frame.body);
+    if (frame.type == FrameType::kRedirect) {
+      redirect_ = frame.body;
+      return false;
+    } else if (frame.type == FrameType::kSyncBegin) {
+      uint64_t size = 0;
+      if (!reader.GetU64(&size)) return false;
+      data->resize(size);
+    } else if (frame.type == FrameType::kPutData) {
+      uint64_t offset = 0;
+      if (!reader.GetU64(&offset) ||
+          offset + reader.remaining() > data->size()) {
+        return false;
+      }
+      data->replace(offset, reader.remaining(), reader.rest(),
+                    reader.remaining());
+    } else if (frame.type == FrameType::kAck) {
+      uint8_t status = 0;
+      return reader.GetU8(&status) &&
+             status == static_cast<uint8_t>(AckStatus::kCommitted);
+    }
+  }
+  Close();
+  return false;
+}
+
+/**
+ * @brief 获取节点的分片表
+ */
+bool ChainClient::GetShardMap(ShardMap* map) {
+  Frame reply;
+  return Call(FrameType::kGetMap, "", &reply) &&
+         reply.type == FrameType::kMap && map->Decode(reply.body);
+}
+
+/**
+ * @brief 更新节点的分片表
+ *
+ * @return true 节点接受了分片表
+ * @return false 连接断开或版本不比节点的新
+ */
+bool ChainClient::SetShardMap(const ShardMap& map) {
+  Frame reply;
+  if (!Call(FrameType::kSetMap, map.Encode(), &reply)) return false;
+  FrameReader reader(reply.body);
+  uint8_t status = 0;
+  return reply.type == FrameType::kAck && reader.GetU8(&status) &&
+         status == static_cast<uint8_t>(AckStatus::kCommitted);
+}
+
+/**
+ * @brief 发送请求并等待一条响应(阻塞)
+ */
+bool ChainClient::Call(FrameType type, const string& body, Frame* reply) {
+  if (sock_ < 0) return false;
+  id_ = next_id_++;
+  Frame request;
+  request.type = type;
+  request.id = id_;
+  request.body = body;
+  if (!SendAll(sock_, request.Encode())) return false;
+  while (RecvFrame(sock_, &inbox_, reply)) {
+    if (reply->id == id_) return true;
+  }
+  Close();
+  return false;
+}
+
+/**
+ * @brief 关闭连接
+ */
+void ChainClient::Close() {
+  if (sock_ < 0) return;
+  evutil_closesocket(sock_);
+  sock_ = -1;
+  inbox_.clear();
+}
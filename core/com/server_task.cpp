@@ -6,15 +6,43 @@
 #include <cstring>
 #include <iostream>
 
+#include "include/rate_limiter.h"
+#include "include/thread_pool.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
 using namespace std;
 USING_CROSSOCEAN_NAMESPACE
 
-static void SListenCB(struct evconnlistener* listener, evutil_socket_t fd,
+static void SListenCB(struct evconnlistener* /*listener*/, evutil_socket_t fd,
                       struct sockaddr* addr, int socklen, void* user_arg) {
   // 这里可以处理新的连接请求
   cout << "ServerTask::ListenCB(): New connection received." << endl;
   // 获取任务对象指针
   auto server_task = static_cast<ServerTask*>(user_arg);
+
+  // 准入控制: 过载时快速拒绝, 避免队列和内存无限增长
+  if (!server_task->Admit()) {
+    server_task->Reject(fd);
+    if (server_task->overload_action() == OverloadAction::kPause) {
+      server_task->Pause();
+    }
+    return;
+  }
+#ifdef SO_BUSY_POLL
+  // 低延迟模式: 读取时在驱动队列上忙等待, 不等中断
+  int busy_poll = server_task->socket_busy_poll_us();
+  if (busy_poll > 0) {
+    setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL,
+               reinterpret_cast<const char*>(&busy_poll), sizeof(busy_poll));
+  }
+#endif
   // 调用用户定义的回调函数（如果有的话）
   if (server_task->ListenCB) {
     server_task->ListenCB(fd, addr, socklen, user_arg);
@@ -22,9 +50,19 @@ static void SListenCB(struct evconnlistener* listener, evutil_socket_t fd,
     // 默认处理（如果没有用户定义的回调函数）
     cout << "ServerTask::ListenCB(): No user-defined callback provided."
          << endl;
+    // 没有处理者, 关闭连接并释放连接名额
+    evutil_closesocket(fd);
+    server_task->ConnectionClosed();
   }
 }
 
+/**
+ * @brief 构造监听任务, `SO_BUSY_POLL`时间取线程池的忙等待参数
+ */
+ServerTask::ServerTask()
+    : socket_busy_poll_us_(
+          ThreadPool::GetInstance()->busy_poll().socket_busy_poll_us) {}
+
 bool ServerTask::Init() {
   // 处理客户端请求的连接
 
@@ -48,7 +86,7 @@ bool ServerTask::Init() {
                               this,       // 回调函数参数
                               LEV_OPT_REUSEABLE |         // 端口可重用
                                   LEV_OPT_CLOSE_ON_FREE,  // 释放时关闭套接字
-                              -1,  // 连接队列长度(-1为默认值)
+                              backlog_,  // 连接队列长度(-1为默认值)
                               (sockaddr*)&client_addr,  // 监听地址
                               sizeof(client_addr));     // 地址长度
 
@@ -56,7 +94,154 @@ bool ServerTask::Init() {
     cerr << "ServerTask::Init(): Failed to create listener" << endl;
     return false;
   }
+  listener_ = listener;
   cout << "ServerTask::Init(): Server listening on port " << server_port_
        << endl;
   return true;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 准入检查
+ *
+ * @details 依次检查打开的连接数、工作线程任务队列深度和自定义检查函数
+ *
+ * @return true 允许接入新连接
+ * @return false 已过载, 应拒绝新连接
+ */
+bool ServerTask::Admit() {
+  if (max_connections_ > 0) {
+    // 先占用名额, 超限再归还, 保证并发接入时不会超过上限
+    if (++active_connections_ > max_connections_) {
+      --active_connections_;
+      return false;
+    }
+  } else {
+    ++active_connections_;
+  }
+
+  bool admitted = true;
+  if (max_queue_depth_ > 0 &&
+      ThreadPool::GetInstance()->task_count() >= max_queue_depth_) {
+    admitted = false;
+  } else if (AdmissionCheck && !AdmissionCheck(admission_arg)) {
+    admitted = false;
+  }
+  if (!admitted) --active_connections_;
+  return admitted;
+}
+
+/**
+ * @brief 快速拒绝连接: 发送繁忙响应后关闭
+ *
+ * @param sock 新连接的socket
+ */
+void ServerTask::Reject(int sock) {
+  ++rejected_count_;
+  cout << "ServerTask::Reject(): Server busy, connection rejected." << endl;
+  if (!busy_response_.empty()) {
+    // 新连接的发送缓冲区为空, 非阻塞发送一次即可
+    send(sock, busy_response_.data(), static_cast<int>(busy_response_.size()),
+         0);
+  }
+  evutil_closesocket(sock);
+}
+
+/**
+ * @brief 连接关闭时调用, 释放一个连接名额(线程安全)
+ */
+void ServerTask::ConnectionClosed() {
+  // 多个事件循环线程可能同时关闭连接, 比较后原子地减一, 计数不会小于0
+  int count = active_connections_;
+  while (count > 0 &&
+         !active_connections_.compare_exchange_weak(count, count - 1)) {
+  }
+}
+
+/**
+ * @brief 停止监听: 释放监听对象和恢复检查定时器
+ */
+void ServerTask::Close() {
+  if (resume_event_) {
+    event_free(resume_event_);
+    resume_event_ = nullptr;
+  }
+  if (listener_) {
+    evconnlistener_free(listener_);
+    listener_ = nullptr;
+  }
+  paused_ = false;
+}
+
+/**
+ * @brief 恢复检查定时器回调
+ *
+ * @param fd 未使用
+ * @param events 事件类型
+ * @param arg `ServerTask`对象指针
+ */
+static void ResumeCB(evutil_socket_t /*fd*/, short /*events*/, void* arg) {
+  static_cast<ServerTask*>(arg)->TryResume();
+}
+
+/**
+ * @brief 暂停监听, 定时重新检查负载
+ */
+void ServerTask::Pause() {
+  if (!listener_ || paused_) return;
+  // 暂停后新连接留在内核连接队列中(长度由`backlog`限制)
+  evconnlistener_disable(listener_);
+  paused_ = true;
+  cout << "ServerTask::Pause(): Listener paused on port " << server_port_
+       << endl;
+
+  if (!resume_event_) {
+    resume_event_ = evtimer_new(base(), ResumeCB, this);
+  }
+  timeval tv = {resume_interval_ms_ / 1000,
+                (resume_interval_ms_ % 1000) * 1000};
+  evtimer_add(resume_event_, &tv);
+}
+
+/**
+ * @brief 检查负载, 未过载时恢复监听
+ */
+void ServerTask::TryResume() {
+  if (!listener_ || !paused_) return;
+  bool overloaded =
+      (max_connections_ > 0 && active_connections_ >= max_connections_) ||
+      (max_queue_depth_ > 0 &&
+       ThreadPool::GetInstance()->task_count() >= max_queue_depth_) ||
+      (AdmissionCheck && !AdmissionCheck(admission_arg));
+  if (overloaded) {
+    timeval tv = {resume_interval_ms_ / 1000,
+                  (resume_interval_ms_ % 1000) * 1000};
+    evtimer_add(resume_event_, &tv);
+    return;
+  }
+  evconnlistener_enable(listener_);
+  paused_ = false;
+  cout << "ServerTask::TryResume(): Listener resumed on port " << server_port_
+       << endl;
+}
+
+/**
+ * @brief 为新连接注册限速句柄
+ *
+ * @param addr 客户端地址
+ * @return std::shared_ptr<RateLimitHandle> 限速句柄, 未设置限速器时为空
+ */
+shared_ptr<RateLimitHandle> ServerTask::RegisterRateLimit(
+    const struct sockaddr* addr) {
+  if (!rate_limiter_) return nullptr;
+  char ip[64] = "";
+  if (addr && addr->sa_family == AF_INET) {
+    evutil_inet_ntop(AF_INET,
+                     &reinterpret_cast<const sockaddr_in*>(addr)->sin_addr, ip,
+                     sizeof(ip));
+  } else if (addr && addr->sa_family == AF_INET6) {
+    evutil_inet_ntop(AF_INET6,
+                     &reinterpret_cast<const sockaddr_in6*>(addr)->sin6_addr,
+                     ip, sizeof(ip));
+  }
+  return rate_limiter_->Register(ip);
+}
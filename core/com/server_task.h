@@ -1,30 +1,184 @@
 ﻿#ifndef SERVER_TASK_H
 #define SERVER_TASK_H
 
+#include <atomic>
+#include <memory>
+#include <string>
+
 #include "crossocean.h"
 #include "task.h"
 
 typedef void (*ListenCBFunc)(int socket_fd, struct sockaddr* addr, int socklen,
                              void* user_arg);
 
+/**
+ * @brief 自定义准入检查函数, 如缓冲池余量检查
+ *
+ * @param user_arg 用户参数(`ServerTask::admission_arg`)
+ * @return true 允许接入新连接
+ * @return false 拒绝新连接
+ */
+typedef bool (*AdmissionCheckFunc)(void* user_arg);
+
+struct evconnlistener;
+struct event;
+
 CROSSOCEAN_NAMESPACE
 
+class RateLimiter;
+struct RateLimitHandle;
+
+/**
+ * @brief 过载时的处理方式
+ */
+enum class OverloadAction {
+  kReject,  ///< 立即向新连接返回繁忙响应并关闭
+  kPause,   ///< 拒绝当前连接并暂停监听, 负载下降后自动恢复
+};
+
 class ServerTask : public Task {
  public:
-  ServerTask() {}
-  ~ServerTask() {}
+  /**
+   * @brief 构造监听任务, `SO_BUSY_POLL`时间取线程池的忙等待参数
+   */
+  ServerTask();
+  /**
+   * @brief 析构时停止监听
+   *
+   * @details 与`Close`相同, 应在所属的事件循环线程中或事件循环释放前析构
+   */
+  ~ServerTask() { Close(); }
 
   virtual bool Init() override;
 
+  /**
+   * @brief 准入检查
+   *
+   * @details 依次检查打开的连接数、工作线程任务队列深度和自定义检查函数
+   *
+   * @return true 允许接入新连接
+   * @return false 已过载, 应拒绝新连接
+   */
+  bool Admit();
+
+  /**
+   * @brief 快速拒绝连接: 发送繁忙响应后关闭
+   *
+   * @param sock 新连接的socket
+   */
+  void Reject(int sock);
+
+  /**
+   * @brief 连接关闭时调用, 释放一个连接名额(线程安全)
+   */
+  void ConnectionClosed();
+
+  /**
+   * @brief 停止监听: 释放监听对象和恢复检查定时器
+   *
+   * @details 在所属的事件循环线程中调用, 之后不再接入新连接
+   */
+  void Close();
+
+  /**
+   * @brief 暂停监听, 定时重新检查负载
+   */
+  void Pause();
+
+  /**
+   * @brief 检查负载, 未过载时恢复监听
+   */
+  void TryResume();
+
+  /**
+   * @brief 为新连接注册限速句柄
+   *
+   * @details 按客户端IP注册, 同一IP的连接共享IP令牌桶. 由`ListenCB`在
+   * 接入连接时调用, 连接关闭时释放句柄
+   *
+   * @param addr 客户端地址
+   * @return std::shared_ptr<RateLimitHandle> 限速句柄, 未设置限速器时为空
+   */
+  std::shared_ptr<RateLimitHandle> RegisterRateLimit(
+      const struct sockaddr* addr);
+
   // 封装回调函数(函数指针)
   ListenCBFunc ListenCB = nullptr;
 
+  /// @brief 自定义准入检查函数(可选)
+  AdmissionCheckFunc AdmissionCheck = nullptr;
+  /// @brief 自定义准入检查函数的参数
+  void* admission_arg = nullptr;
+
  public:
   int server_port() const { return server_port_; }
   void set_server_port(int port) { server_port_ = port; }
 
+  /// @brief 内核连接队列长度(-1为系统默认值)
+  int backlog() const { return backlog_; }
+  void set_backlog(int backlog) { backlog_ = backlog; }
+
+  /// @brief 最大打开连接数(0为不限制)
+  int max_connections() const { return max_connections_; }
+  void set_max_connections(int max) { max_connections_ = max; }
+
+  /// @brief 线程池任务队列总深度上限(0为不限制)
+  int max_queue_depth() const { return max_queue_depth_; }
+  void set_max_queue_depth(int max) { max_queue_depth_ = max; }
+
+  /// @brief 过载时的处理方式
+  OverloadAction overload_action() const { return overload_action_; }
+  void set_overload_action(OverloadAction action) { overload_action_ = action; }
+
+  /// @brief 暂停监听后重新检查负载的间隔(毫秒)
+  int resume_interval_ms() const { return resume_interval_ms_; }
+  void set_resume_interval_ms(int ms) { resume_interval_ms_ = ms; }
+
+  /// @brief 拒绝连接时发送的繁忙响应
+  const std::string& busy_response() const { return busy_response_; }
+  void set_busy_response(const std::string& response) {
+    busy_response_ = response;
+  }
+
+  /// @brief 新连接的`SO_BUSY_POLL`时间(微秒, 0为不设置, 仅Linux),
+  /// 默认为创建时线程池的`BusyPollOptions::socket_busy_poll_us`
+  int socket_busy_poll_us() const { return socket_busy_poll_us_; }
+  void set_socket_busy_poll_us(int us) { socket_busy_poll_us_ = us; }
+
+  /**
+   * @brief 发送限速器, 为`nullptr`时不限速
+   *
+   * @details 由`ListenCB`处理的新连接通过`RegisterRateLimit`注册
+   */
+  RateLimiter* rate_limiter() const { return rate_limiter_; }
+  void set_rate_limiter(RateLimiter* limiter) { rate_limiter_ = limiter; }
+
+  /// @brief 当前打开的连接数
+  int active_connections() const { return active_connections_; }
+  /// @brief 累计拒绝的连接数
+  long long rejected_count() const { return rejected_count_; }
+  /// @brief 监听是否处于暂停状态
+  bool paused() const { return paused_; }
+
  private:
-  int server_port_;
+  int server_port_ = 0;
+  int backlog_ = -1;
+  int max_connections_ = 0;
+  int max_queue_depth_ = 0;
+  OverloadAction overload_action_ = OverloadAction::kReject;
+  int resume_interval_ms_ = 100;
+  std::string busy_response_ = "BUSY\n";
+  int socket_busy_poll_us_ = 0;
+  RateLimiter* rate_limiter_ = nullptr;
+
+  /// @brief 监听对象
+  ::evconnlistener* listener_ = nullptr;
+  /// @brief 暂停监听后的恢复检查定时器
+  ::event* resume_event_ = nullptr;
+
+  std::atomic<int> active_connections_{0};
+  std::atomic<long long> rejected_count_{0};
+  std::atomic<bool> paused_{false};
 };
 
 END_NAMESPACE
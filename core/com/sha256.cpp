@@ -0,0 +1,176 @@
+﻿/**
+ * @file sha256.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Sha256`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/sha256.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+static const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t RotateRight(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+Sha256::Sha256() { Reset(); }
+
+/**
+ * @brief 重新开始计算
+ */
+void Sha256::Reset() {
+  static const uint32_t kInitState[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                         0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                         0x1f83d9ab, 0x5be0cd19};
+  memcpy(state_, kInitState, sizeof(state_));
+  length_ = 0;
+  buffered_ = 0;
+}
+
+/**
+ * @brief 处理一个64字节的分组
+ */
+void Sha256::Transform(const unsigned char block[64]) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; ++i) {
+    w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+           (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+  }
+  for (int i = 16; i < 64; ++i) {
+    uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^
+                  (w[i - 15] >> 3);
+    uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^
+                  (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+  uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+  for (int i = 0; i < 64; ++i) {
+    uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + ch + kRoundConstants[i] + w[i];
+    uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+  state_[4] += e;
+  state_[5] += f;
+  state_[6] += g;
+  state_[7] += h;
+}
+
+/**
+ * @brief 输入数据
+ *
+ * @param data 数据
+ * @param len 数据长度
+ */
+void Sha256::Update(const void* data, size_t len) {
+  const unsigned char* input = static_cast<const unsigned char*>(data);
+  length_ += len;
+  if (buffered_ > 0) {
+    size_t fill = min(len, sizeof(buffer_) - buffered_);
+    memcpy(buffer_ + buffered_, input, fill);
+    buffered_ += fill;
+    input += fill;
+    len -= fill;
+    if (buffered_ < sizeof(buffer_)) return;
+    Transform(buffer_);
+    buffered_ = 0;
+  }
+  // 整块直接处理, 不经过缓冲区
+  while (len >= sizeof(buffer_)) {
+    Transform(input);
+    input += sizeof(buffer_);
+    len -= sizeof(buffer_);
+  }
+  if (len > 0) {
+    memcpy(buffer_, input, len);
+    buffered_ = len;
+  }
+}
+
+/**
+ * @brief 结束计算, 输出摘要
+ *
+ * @param digest 输出摘要(`kDigestSize`字节)
+ */
+void Sha256::Final(unsigned char digest[kDigestSize]) {
+  uint64_t bits = length_ * 8;
+  unsigned char pad[72] = {0x80};
+  // 填充到 56 mod 64, 再附加64位长度
+  size_t pad_len = buffered_ < 56 ? 56 - buffered_ : 120 - buffered_;
+  for (int i = 0; i < 8; ++i) {
+    pad[pad_len + i] = static_cast<unsigned char>(bits >> (56 - i * 8));
+  }
+  Update(pad, pad_len + 8);
+  for (int i = 0; i < 8; ++i) {
+    digest[i * 4] = static_cast<unsigned char>(state_[i] >> 24);
+    digest[i * 4 + 1] = static_cast<unsigned char>(state_[i] >> 16);
+    digest[i * 4 + 2] = static_cast<unsigned char>(state_[i] >> 8);
+    digest[i * 4 + 3] = static_cast<unsigned char>(state_[i]);
+  }
+  Reset();
+}
+
+/**
+ * @brief 结束计算, 输出十六进制摘要
+ *
+ * @return std::string 64个字符的十六进制摘要
+ */
+string Sha256::FinalHex() {
+  static const char kHexDigits[] = "0123456789abcdef";
+  unsigned char digest[kDigestSize];
+  Final(digest);
+  string hex(kDigestSize * 2, '0');
+  for (int i = 0; i < kDigestSize; ++i) {
+    hex[i * 2] = kHexDigits[digest[i] >> 4];
+    hex[i * 2 + 1] = kHexDigits[digest[i] & 0x0f];
+  }
+  return hex;
+}
+
+/**
+ * @brief 计算数据的十六进制摘要
+ *
+ * @param data 数据
+ * @param len 数据长度
+ * @return std::string 64个字符的十六进制摘要
+ */
+string Sha256::Hex(const void* data, size_t len) {
+  Sha256 sha;
+  sha.Update(data, len);
+  return sha.FinalHex();
+}
@@ -0,0 +1,130 @@
+﻿/**
+ * @file shard_map.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `ShardMap`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/shard_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+#include "include/frame.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 权重按千分之一编码
+static const double kWeightScale = 1000.0;
+
+/**
+ * @brief 构造空的分片表
+ *
+ * @param vnodes 权重为1的节点放置的虚拟节点数
+ * @param replicas 每个文件的副本数
+ */
+ShardMap::ShardMap(int vnodes, int replicas)
+    : vnodes_(max(vnodes, 1)), replicas_(max(replicas, 1)), ring_(vnodes_) {}
+
+/**
+ * @brief 添加节点, 已存在时更新权重
+ *
+ * @param address 节点地址(`IP:端口`)
+ * @param weight 权重
+ * @return true 成功
+ * @return false 地址为空或权重不大于0
+ */
+bool ShardMap::AddNode(const string& address, double weight) {
+  return ring_.AddNode(address, weight);
+}
+
+/**
+ * @brief 删除节点
+ *
+ * @param address 节点地址
+ * @return true 成功
+ * @return false 节点不存在
+ */
+bool ShardMap::RemoveNode(const string& address) {
+  return ring_.RemoveNode(address);
+}
+
+/**
+ * @brief 查找文件的归属节点
+ *
+ * @param path 相对根目录的文件路径
+ * @return std::vector<std::string> 主节点在前的副本地址, 表为空时为空
+ */
+vector<string> ShardMap::Owners(const string& path) const {
+  return ring_.Lookup(Key(path), replicas_);
+}
+
+/**
+ * @brief 判断节点是否为文件的副本之一
+ */
+bool ShardMap::Owns(const string& address, const string& path) const {
+  vector<string> owners = Owners(path);
+  return find(owners.begin(), owners.end(), address) != owners.end();
+}
+
+/**
+ * @brief 编码为消息体
+ *
+ * @details 版本8 + 虚拟节点数4 + 副本数4 + 节点数4 + (地址 + 权重4)*
+ */
+string ShardMap::Encode() const {
+  FrameWriter writer;
+  writer.PutU64(version_);
+  writer.PutU32(static_cast<uint32_t>(vnodes_));
+  writer.PutU32(static_cast<uint32_t>(replicas_));
+  writer.PutU32(static_cast<uint32_t>(ring_.size()));
+  for (const auto& node : ring_.nodes()) {
+    writer.PutString(node.first);
+    writer.PutU32(static_cast<uint32_t>(lround(node.second * kWeightScale)));
+  }
+  return writer.body();
+}
+
+/**
+ * @brief 从消息体解码
+ *
+ * @param data 消息体
+ * @return true 成功
+ * @return false 格式错误
+ */
+bool ShardMap::Decode(const string& data) {
+  FrameReader reader(data);
+  uint64_t version = 0;
+  uint32_t vnodes = 0, replicas = 0, count = 0;
+  if (!reader.GetU64(&version) || !reader.GetU32(&vnodes) ||
+      !reader.GetU32(&replicas) || !reader.GetU32(&count) || vnodes == 0 ||
+      replicas == 0 || vnodes > 1u << 16 || count > reader.remaining() / 8) {
+    return false;
+  }
+  ShardMap map(static_cast<int>(vnodes), static_cast<int>(replicas));
+  map.version_ = version;
+  for (uint32_t i = 0; i < count; ++i) {
+    string address;
+    uint32_t weight = 0;
+    if (!reader.GetString(&address) || !reader.GetU32(&weight) ||
+        !map.AddNode(address, weight / kWeightScale)) {
+      return false;
+    }
+  }
+  *this = move(map);
+  return true;
+}
+
+/**
+ * @brief 规范化路径作为哈希的键(去掉`.`和多余的`/`)
+ */
+string ShardMap::Key(const string& path) {
+  string key = fs::path(path).lexically_normal().generic_string();
+  while (!key.empty() && key.back() == '/') key.pop_back();
+  return key;
+}
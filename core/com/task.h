@@ -10,14 +10,35 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include <chrono>
+
 #include "crossocean.h"
 
 struct event_base;
 
 CROSSOCEAN_NAMESPACE
 
+/**
+ * @brief 任务优先级(数值越小优先级越高)
+ *
+ * @details 每个`Thread`为每个优先级维护一条独立的任务队列(优先级通道)
+ */
+enum class TaskPriority {
+  kHigh = 0,    ///< 延迟敏感任务, 如元数据请求
+  kNormal = 1,  ///< 普通任务(默认)
+  kLow = 2,     ///< 批量任务, 如大文件上传
+};
+
+/// @brief 优先级通道数量
+constexpr int kTaskPriorityCount = 3;
+
 class Task {
  public:
+  /// @brief 任务截止时间使用的时钟
+  using Clock = std::chrono::steady_clock;
+
+  virtual ~Task() {}
+
   /**
    * @brief 任务初始化函数 (纯虚函数)
    *
@@ -26,6 +47,15 @@ class Task {
    */
   virtual bool Init() = 0;
 
+  /**
+   * @brief 任务超过截止时间被线程丢弃时的回调
+   *
+   * @details
+   * 在任务所属线程中调用, 此时`Init`不会再被调用,
+   * 子类可以在这里释放资源或者向客户端返回繁忙响应
+   */
+  virtual void OnExpired() {}
+
   /**
    * @brief 获取线程ID
    *
@@ -65,6 +95,61 @@ class Task {
    */
   void set_base(::event_base* base) { this->base_ = base; }
 
+  /**
+   * @brief 获取任务优先级
+   *
+   * @return TaskPriority 任务优先级
+   */
+  TaskPriority priority() const { return priority_; }
+  /**
+   * @brief 设置任务优先级, 需在分发任务之前设置
+   *
+   * @param priority 任务优先级
+   */
+  void set_priority(TaskPriority priority) { priority_ = priority; }
+
+  /**
+   * @brief 任务是否设置了截止时间
+   *
+   * @return true 已设置截止时间
+   * @return false 未设置截止时间
+   */
+  bool has_deadline() const { return has_deadline_; }
+  /**
+   * @brief 获取任务截止时间
+   *
+   * @return Clock::time_point 任务截止时间
+   */
+  Clock::time_point deadline() const { return deadline_; }
+  /**
+   * @brief 设置任务截止时间, 超过截止时间仍未执行的任务不再执行
+   *
+   * @param deadline 任务截止时间
+   */
+  void set_deadline(Clock::time_point deadline) {
+    deadline_ = deadline;
+    has_deadline_ = true;
+  }
+  /**
+   * @brief 设置任务从现在开始的超时时间
+   *
+   * @param timeout 超时时间
+   */
+  void set_timeout(std::chrono::milliseconds timeout) {
+    set_deadline(Clock::now() + timeout);
+  }
+
+  /**
+   * @brief 判断任务是否已经超过截止时间
+   *
+   * @param now 当前时间
+   * @return true 已超时
+   * @return false 未超时或者未设置截止时间
+   */
+  bool IsExpired(Clock::time_point now) const {
+    return has_deadline_ && now >= deadline_;
+  }
+
  private:
   /// @brief 关联的 event_base
   ::event_base* base_ = 0;
@@ -72,6 +157,12 @@ class Task {
   int sock_ = 0;
   /// @brief 任务所属线程ID
   int thread_id_ = 0;
+  /// @brief 任务优先级
+  TaskPriority priority_ = TaskPriority::kNormal;
+  /// @brief 是否设置了截止时间
+  bool has_deadline_ = false;
+  /// @brief 任务截止时间
+  Clock::time_point deadline_;
 };
 
 END_NAMESPACE
@@ -0,0 +1,285 @@
+﻿// batch_download_test.cpp
+// BatchDownload 类单元测试
+
+#include "include/batch_download.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "include/blocking_pool.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 解析tar流中的文件(支持ustar前缀和GNU长文件名)
+static bool ParseTar(const std::string& tar,
+                     std::vector<std::pair<std::string, std::string>>* files) {
+  size_t pos = 0;
+  std::string long_name;
+  while (pos + 512 <= tar.size()) {
+    const char* header = tar.data() + pos;
+    if (std::string(header, 512) == std::string(512, '\0')) return true;
+
+    // 校验和
+    unsigned int sum = 0;
+    for (int i = 0; i < 512; ++i) {
+      bool chksum = i >= 148 && i < 156;
+      sum += chksum ? ' ' : static_cast<unsigned char>(header[i]);
+    }
+    if (std::stoul(std::string(header + 148, 6), nullptr, 8) != sum) {
+      return false;
+    }
+    long long size = 0;
+    if (static_cast<unsigned char>(header[124]) & 0x80) {
+      for (int i = 1; i < 12; ++i) {
+        size = (size << 8) | static_cast<unsigned char>(header[124 + i]);
+      }
+    } else {
+      size = std::stoll(std::string(header + 124, 11), nullptr, 8);
+    }
+    std::string name(header, strnlen(header, 100));
+    std::string prefix(header + 345, strnlen(header + 345, 155));
+    if (!prefix.empty()) name = prefix + "/" + name;
+    pos += 512;
+    if (pos + size > tar.size()) return false;
+    std::string content = tar.substr(pos, size);
+    pos += (size + 511) / 512 * 512;
+
+    if (header[156] == 'L') {
+      long_name = content.c_str();
+      continue;
+    }
+    if (!long_name.empty()) name = long_name;
+    long_name.clear();
+    files->push_back({name, content});
+  }
+  return false;
+}
+
+// 创建测试目录
+class BatchDownloadTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = fs::temp_directory_path() / "batch_download_test";
+    fs::remove_all(root_);
+    fs::create_directories(root_);
+  }
+
+  void TearDown() override { fs::remove_all(root_); }
+
+  // 创建文件
+  void Write(const std::string& name, const std::string& data) {
+    fs::path path = root_ / name;
+    fs::create_directories(path.parent_path());
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+  }
+
+  // 生成文件内容
+  static std::string Content(int i) {
+    std::string data(i * 37 % 3000, '\0');
+    for (size_t j = 0; j < data.size(); ++j) {
+      data[j] = static_cast<char>(i + j * 7);
+    }
+    return data;
+  }
+
+  // 在非阻塞socket上发送整个tar流, 另一个线程接收
+  static std::string Download(BatchDownload& batch) {
+    int fds[2];
+    EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    std::string received;
+    std::thread reader([&]() {
+      char buffer[4096];
+      ssize_t n;
+      while ((n = read(fds[1], buffer, sizeof(buffer))) > 0) {
+        received.append(buffer, n);
+      }
+    });
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool ready = false;
+    batch.Start(nullptr, [&]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      ready = true;
+      cond.notify_one();
+    });
+    while (!batch.finished()) {
+      if (batch.Pump(fds[0]) < 0) break;
+      if (batch.waiting()) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return ready; });
+        ready = false;
+      } else if (!batch.finished()) {
+        pollfd pfd = {fds[0], POLLOUT, 0};
+        poll(&pfd, 1, 1000);
+      }
+    }
+    close(fds[0]);
+    reader.join();
+    close(fds[1]);
+    return received;
+  }
+
+  fs::path root_;
+};
+
+// ==================== BatchDownload 测试 ====================
+
+// 测试tar头部: 校验和、长文件名拆分、GNU长文件名和大文件大小
+TEST_F(BatchDownloadTest, TarHeader) {
+  std::string header = BatchDownload::TarHeader("a/b.txt", 1234, 1700000000);
+  ASSERT_EQ(header.size(), 512u);
+  EXPECT_EQ(std::string(header.data() + 257, 5), "ustar");
+  EXPECT_EQ(std::string(header.data() + 124, 11), "00000002322");
+  std::vector<std::pair<std::string, std::string>> files;
+  std::string tar = header + std::string(1024 + 1024, '\0');
+  ASSERT_TRUE(ParseTar(tar, &files));
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].first, "a/b.txt");
+  EXPECT_EQ(files[0].second.size(), 1234u);
+
+  // 超过100字节的文件名在`/`处拆分为前缀
+  std::string dir(120, 'd');
+  header = BatchDownload::TarHeader(dir + "/file.txt", 0, 0);
+  ASSERT_EQ(header.size(), 512u);
+  EXPECT_EQ(std::string(header.data(), 8), "file.txt");
+  EXPECT_EQ(std::string(header.data() + 345, 120), dir);
+
+  // 无法拆分时使用GNU长文件名记录
+  std::string name(300, 'n');
+  header = BatchDownload::TarHeader(name, 0, 0);
+  EXPECT_EQ(header.size(), 512u * 3);
+  EXPECT_EQ(header[156], 'L');
+  files.clear();
+  ASSERT_TRUE(ParseTar(header + std::string(1024, '\0'), &files));
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].first, name);
+
+  // 超过8GB的大小使用base-256编码
+  long long big = 10LL * 1024 * 1024 * 1024;
+  header = BatchDownload::TarHeader("big", big, 0);
+  EXPECT_EQ(static_cast<unsigned char>(header[124]), 0x80);
+  long long size = 0;
+  for (int i = 1; i < 12; ++i) {
+    size = (size << 8) | static_cast<unsigned char>(header[124 + i]);
+  }
+  EXPECT_EQ(size, big);
+}
+
+// 测试按前缀列出文件
+TEST_F(BatchDownloadTest, ListPrefix) {
+  Write("src/main.cpp", "m");
+  Write("src/lib/a.cpp", "a");
+  Write("src/lib/b.cpp", "b");
+  Write("srcx/other.cpp", "o");
+  Write("doc/readme.md", "r");
+
+  auto entries = BatchDownload::List(root_.string(), "src/");
+  ASSERT_EQ(entries.size(), 3u);
+  EXPECT_EQ(entries[0].name, "src/lib/a.cpp");
+  EXPECT_EQ(entries[1].name, "src/lib/b.cpp");
+  EXPECT_EQ(entries[2].name, "src/main.cpp");
+  EXPECT_EQ(fs::path(entries[2].path), root_ / "src/main.cpp");
+
+  EXPECT_EQ(BatchDownload::List(root_.string(), "src").size(), 4u);
+  EXPECT_EQ(BatchDownload::List(root_.string(), "src/lib/b").size(), 1u);
+  EXPECT_EQ(BatchDownload::List(root_.string(), "").size(), 5u);
+  EXPECT_TRUE(BatchDownload::List(root_.string(), "none/").empty());
+}
+
+// 测试拒绝越出根目录的前缀, 不跟随符号链接
+TEST_F(BatchDownloadTest, ListStaysInsideRoot) {
+  Write("root/a.txt", "a");
+  Write("outside/secret.txt", "s");
+  fs::path root = root_ / "root";
+  fs::create_symlink(root_ / "outside/secret.txt", root / "file_link");
+  fs::create_directory_symlink(root_ / "outside", root / "dir_link");
+
+  auto entries = BatchDownload::List(root.string(), "");
+  ASSERT_EQ(entries.size(), 1u);
+  EXPECT_EQ(entries[0].name, "a.txt");
+
+  EXPECT_TRUE(BatchDownload::List(root.string(), "../").empty());
+  EXPECT_TRUE(BatchDownload::List(root.string(), "../outside/").empty());
+  EXPECT_TRUE(BatchDownload::List(root.string(), "x/../../").empty());
+  EXPECT_TRUE(
+      BatchDownload::List(root.string(), (root_ / "outside/").string())
+          .empty());
+  EXPECT_TRUE(BatchDownload::List(root.string(), "dir_link/").empty());
+  EXPECT_TRUE(BatchDownload::List(root.string(), "file_link").empty());
+}
+
+// 测试在阻塞I/O线程池中提前打开文件, 在一个连接上连续发送
+TEST_F(BatchDownloadTest, StreamsDirectory) {
+  for (int i = 0; i < 500; ++i) {
+    Write("tree/d" + std::to_string(i % 7) + "/f" + std::to_string(i),
+          Content(i));
+  }
+  Write(std::string(150, 'x') + "/long", "long name");
+  BlockingPool pool;
+  pool.Init(2);
+
+  auto entries = BatchDownload::List(root_.string(), "");
+  ASSERT_EQ(entries.size(), 501u);
+  BatchDownload batch(&pool, nullptr, entries, 8);
+  std::string tar = Download(batch);
+  pool.Stop();
+
+  ASSERT_TRUE(batch.finished());
+  EXPECT_EQ(tar.size() % 512, 0u);
+  std::vector<std::pair<std::string, std::string>> files;
+  ASSERT_TRUE(ParseTar(tar, &files));
+  ASSERT_EQ(files.size(), entries.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    EXPECT_EQ(files[i].first, entries[i].name);
+  }
+  for (auto& file : files) {
+    if (file.first.compare(0, 5, "tree/") != 0) {
+      EXPECT_EQ(file.second, "long name");
+      continue;
+    }
+    int i = std::stoi(file.first.substr(file.first.rfind('f') + 1));
+    EXPECT_EQ(file.second, Content(i)) << file.first;
+  }
+
+  const BatchDownloadStats& stats = batch.stats();
+  EXPECT_EQ(stats.files, 501);
+  EXPECT_EQ(stats.skipped, 0);
+  EXPECT_EQ(stats.header_bytes + stats.body_bytes,
+            static_cast<long long>(tar.size()));
+}
+
+// 测试跳过列出后被删除的文件, tar流保持完整
+TEST_F(BatchDownloadTest, SkipsMissingFiles) {
+  for (int i = 0; i < 10; ++i) {
+    Write("f" + std::to_string(i), Content(i + 1));
+  }
+  auto entries = BatchDownload::List(root_.string(), "");
+  fs::remove(root_ / "f3");
+  fs::remove(root_ / "f9");
+
+  BatchDownload batch(nullptr, nullptr, entries);
+  std::string tar = Download(batch);
+  std::vector<std::pair<std::string, std::string>> files;
+  ASSERT_TRUE(ParseTar(tar, &files));
+  ASSERT_EQ(files.size(), 8u);
+  EXPECT_EQ(files[3].first, "f4");
+  EXPECT_EQ(files[3].second, Content(5));
+  EXPECT_EQ(batch.stats().skipped, 2);
+  EXPECT_EQ(batch.stats().stalls, 0);
+}
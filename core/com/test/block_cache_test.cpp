@@ -0,0 +1,150 @@
+﻿// block_cache_test.cpp
+// BlockCache 类单元测试
+
+#include "include/block_cache.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace crossocean;
+
+// 创建指定大小和内容的缓存块
+static CacheBlockPtr MakeBlock(size_t size, char fill) {
+  auto block = std::make_shared<CacheBlock>();
+  block->data.assign(size, fill);
+  return block;
+}
+
+// ==================== BlockCache 测试 ====================
+
+// 测试插入、查找和命中率统计
+TEST(BlockCacheTest, LookupAndStats) {
+  BlockCache cache(1024 * 1024, 4096, 4);
+
+  EXPECT_EQ(cache.Lookup(1, 0), nullptr);
+  cache.Insert(1, 0, MakeBlock(4096, 'a'));
+
+  CacheBlockPtr block = cache.Lookup(1, 0);
+  ASSERT_NE(block, nullptr);
+  EXPECT_EQ(block->data[0], 'a');
+
+  BlockCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.bytes, 4096);
+  EXPECT_DOUBLE_EQ(stats.hit_ratio(), 0.5);
+}
+
+// 测试缓存容量上限
+TEST(BlockCacheTest, CapacityBound) {
+  BlockCache cache(16 * 1024, 1024, 1);
+
+  for (int i = 0; i < 100; ++i) {
+    cache.Insert(1, i, MakeBlock(1024, 'x'));
+  }
+  BlockCacheStats stats = cache.stats();
+  EXPECT_LE(stats.bytes, 16 * 1024);
+  EXPECT_EQ(stats.evictions, 100 - 16);
+}
+
+// 测试顺序扫描不会冲掉热点块
+TEST(BlockCacheTest, ScanResistance) {
+  BlockCache cache(32 * 1024, 1024, 1);
+
+  // 热点块被多次访问
+  for (int i = 0; i < 8; ++i) cache.Insert(1, i, MakeBlock(1024, 'h'));
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < 8; ++i) EXPECT_NE(cache.Lookup(1, i), nullptr);
+  }
+
+  // 扫描大量只访问一次的块
+  for (int i = 0; i < 1000; ++i) cache.Insert(2, i, MakeBlock(1024, 's'));
+
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_NE(cache.Lookup(1, i), nullptr) << "hot block " << i;
+  }
+}
+
+// 测试按文件失效
+TEST(BlockCacheTest, Invalidate) {
+  BlockCache cache(1024 * 1024, 1024, 4);
+  for (int i = 0; i < 10; ++i) {
+    cache.Insert(1, i, MakeBlock(1024, '1'));
+    cache.Insert(2, i, MakeBlock(1024, '2'));
+  }
+  cache.Invalidate(1);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(cache.Lookup(1, i), nullptr);
+    EXPECT_NE(cache.Lookup(2, i), nullptr);
+  }
+  EXPECT_EQ(cache.stats().bytes, 10 * 1024);
+}
+
+#ifndef _WIN32
+// 测试从文件读取并通过`writev`发送
+TEST(BlockCacheTest, ReadThroughAndSend) {
+  char path[] = "/tmp/block_cache_testXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  std::string content;
+  for (int i = 0; i < 10000; ++i) content.push_back('a' + i % 26);
+  ASSERT_EQ(write(fd, content.data(), content.size()),
+            static_cast<ssize_t>(content.size()));
+
+  BlockCache cache(1024 * 1024, 4096, 4);
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  // 跨越3个块的区间
+  long long sent = cache.Send(fds[1], 7, fd, 1000, 8000);
+  EXPECT_EQ(sent, 8000);
+  std::string received(8000, '\0');
+  ASSERT_EQ(read(fds[0], &received[0], received.size()), 8000);
+  EXPECT_EQ(received, content.substr(1000, 8000));
+  EXPECT_EQ(cache.stats().misses, 3);
+
+  // 第二次读取全部命中, 文件末尾的块较短
+  sent = cache.Send(fds[1], 7, fd, 9000, 5000);
+  EXPECT_EQ(sent, 1000);
+  received.assign(1000, '\0');
+  ASSERT_EQ(read(fds[0], &received[0], received.size()), 1000);
+  EXPECT_EQ(received, content.substr(9000));
+  EXPECT_EQ(cache.stats().hits, 1);
+
+  close(fds[0]);
+  close(fds[1]);
+  close(fd);
+  unlink(path);
+}
+
+// 测试一次发送最多64个块, 只读取要发送的块
+TEST(BlockCacheTest, SendReadsAtMostIovecs) {
+  char path[] = "/tmp/block_cache_testXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  const size_t kBlockSize = 512;
+  std::string content(100 * kBlockSize, 'x');
+  ASSERT_EQ(write(fd, content.data(), content.size()),
+            static_cast<ssize_t>(content.size()));
+
+  BlockCache cache(1024 * 1024, kBlockSize, 1);
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  long long sent =
+      cache.Send(fds[1], 9, fd, 100, static_cast<long long>(content.size()));
+  EXPECT_EQ(sent, static_cast<long long>(64 * kBlockSize - 100));
+  EXPECT_EQ(cache.stats().misses, 64);
+
+  close(fds[0]);
+  close(fds[1]);
+  close(fd);
+  unlink(path);
+}
+#endif
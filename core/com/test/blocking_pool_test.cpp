@@ -0,0 +1,79 @@
+﻿// blocking_pool_test.cpp
+// BlockingPool 类单元测试
+
+#include "include/blocking_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "thread.h"
+
+using namespace crossocean;
+
+// ==================== BlockingPool 测试 ====================
+
+// 测试提交的工作全部在工作线程中执行, 停止时等待已提交的工作完成
+TEST(BlockingPoolTest, SubmitAndStop) {
+  BlockingPool pool;
+  // 未启动时不接收工作
+  EXPECT_FALSE(pool.Submit([] {}));
+
+  pool.Init(2);
+  EXPECT_EQ(pool.thread_num(), 2);
+
+  std::atomic<int> count{0};
+  std::thread::id caller = std::this_thread::get_id();
+  std::atomic<bool> on_caller{false};
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(pool.Submit([&] {
+      if (std::this_thread::get_id() == caller) on_caller = true;
+      ++count;
+    }));
+  }
+  pool.Stop();
+  EXPECT_EQ(count, 100);
+  EXPECT_FALSE(on_caller);
+
+  // 停止后不再接收工作
+  EXPECT_FALSE(pool.Submit([] {}));
+}
+
+// 测试完成回调被投递回指定的 Thread 执行
+TEST(BlockingPoolTest, CompletionOnThread) {
+  Thread thread;
+  thread.id_ = 7;
+  thread.Start();
+
+  BlockingPool pool;
+  pool.Init(1);
+
+  std::atomic<bool> work_done{false};
+  std::atomic<bool> done_after_work{false};
+  std::atomic<bool> finished{false};
+  std::thread::id worker_id, done_id;
+  ASSERT_TRUE(pool.Submit(
+      [&] {
+        worker_id = std::this_thread::get_id();
+        work_done = true;
+      },
+      &thread,
+      [&] {
+        done_id = std::this_thread::get_id();
+        done_after_work = work_done.load();
+        finished = true;
+      }));
+
+  for (int i = 0; i < 200 && !finished; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  pool.Stop();
+
+  ASSERT_TRUE(finished);
+  EXPECT_TRUE(done_after_work);
+  // 回调在事件循环线程中执行, 而不是工作线程
+  EXPECT_NE(done_id, worker_id);
+  EXPECT_NE(done_id, std::this_thread::get_id());
+}
@@ -0,0 +1,155 @@
+﻿// channel_test.cpp
+// Channel 类单元测试
+
+#include "channel.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/blocking_pool.h"
+#include "thread.h"
+
+using namespace crossocean;
+
+// 启动事件循环线程
+static Thread* StartThread(int id) {
+  Thread* thread = new Thread();
+  thread->id_ = id;
+  thread->Start();
+  return thread;
+}
+
+// 等待条件成立
+template <typename F>
+static bool WaitFor(F condition) {
+  for (int i = 0; i < 500; ++i) {
+    if (condition()) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return condition();
+}
+
+// ==================== Channel 测试 ====================
+
+// 测试消息在接收线程中按发送顺序处理
+TEST(ChannelTest, DeliversInOrder) {
+  Thread* receiver = StartThread(1);
+  std::vector<int> received;
+  std::atomic<bool> in_receiver(true);
+  std::promise<std::thread::id> loop_id;
+  BlockingPool::Post(receiver,
+                     [&]() { loop_id.set_value(std::this_thread::get_id()); });
+  std::thread::id receiver_id = loop_id.get_future().get();
+
+  Channel<int> channel(receiver, [&](int& message) {
+    if (std::this_thread::get_id() != receiver_id) in_receiver = false;
+    received.push_back(message);
+  });
+  const int kMessages = 10000;
+  for (int i = 0; i < kMessages; ++i) channel.Send(i);
+  ASSERT_TRUE(WaitFor([&]() { return channel.received() == kMessages; }));
+  EXPECT_TRUE(in_receiver);
+  for (int i = 0; i < kMessages; ++i) ASSERT_EQ(received[i], i);
+  EXPECT_EQ(channel.sent(), kMessages);
+}
+
+// 测试接收线程繁忙时消息成批处理, 只唤醒一次
+TEST(ChannelTest, BatchesAndCoalescesSignals) {
+  Thread* receiver = StartThread(2);
+  std::atomic<int> received(0);
+  Channel<std::string> channel(receiver,
+                               [&](std::string&) { ++received; });
+
+  // 接收线程正在执行任务
+  std::promise<void> started;
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  BlockingPool::Post(receiver, [&, released]() {
+    started.set_value();
+    released.wait();
+  });
+  started.get_future().wait();
+
+  long long signals = receiver->signal_count();
+  const int kMessages = 1000;
+  for (int i = 0; i < kMessages; ++i) channel.Send(std::to_string(i));
+  std::vector<std::string> batch(kMessages, "batch");
+  channel.SendBatch(std::move(batch));
+  EXPECT_EQ(receiver->signal_count() - signals, 1);
+  EXPECT_EQ(received, 0);
+
+  release.set_value();
+  ASSERT_TRUE(WaitFor([&]() { return received == 2 * kMessages; }));
+  EXPECT_EQ(channel.batches(), 1);
+  EXPECT_EQ(receiver->signal_count() - signals, 1);
+}
+
+// 测试多个发送线程, 每个发送线程的消息保持顺序
+TEST(ChannelTest, MultipleProducers) {
+  Thread* receiver = StartThread(3);
+  const int kProducers = 4;
+  const int kMessages = 5000;
+  std::vector<int> next(kProducers, 0);
+  std::atomic<bool> ordered(true);
+  Channel<std::pair<int, int>> channel(
+      receiver, [&](std::pair<int, int>& message) {
+        if (message.second != next[message.first]) ordered = false;
+        next[message.first] = message.second + 1;
+      });
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&channel, p]() {
+      for (int i = 0; i < kMessages; ++i) channel.Send({p, i});
+    });
+  }
+  for (auto& producer : producers) producer.join();
+  ASSERT_TRUE(WaitFor(
+      [&]() { return channel.received() == kProducers * kMessages; }));
+  EXPECT_TRUE(ordered);
+  EXPECT_LT(channel.batches(), kProducers * kMessages);
+}
+
+// 测试两个线程之间来回发送消息, 处理函数中发送和注销通道
+TEST(ChannelTest, PingPong) {
+  Thread* a = StartThread(4);
+  Thread* b = StartThread(5);
+  const int kRounds = 2000;
+  std::promise<void> finished;
+  std::unique_ptr<Channel<int>> to_a;
+  std::unique_ptr<Channel<int>> to_b;
+  to_b.reset(new Channel<int>(b, [&](int& n) { to_a->Send(n + 1); }));
+  to_a.reset(new Channel<int>(a, [&](int& n) {
+    if (n >= kRounds) {
+      finished.set_value();
+      return;
+    }
+    to_b->Send(n + 1);
+  }));
+  to_b->Send(0);
+  ASSERT_EQ(finished.get_future().wait_for(std::chrono::seconds(10)),
+            std::future_status::ready);
+  // b收到0, 2, ..., kRounds, a收到1, 3, ..., kRounds + 1
+  EXPECT_TRUE(WaitFor([&]() {
+    return to_a->received() == kRounds / 2 + 1 &&
+           to_b->received() == kRounds / 2 + 1;
+  }));
+
+  // 在接收线程的处理函数中注销通道
+  std::promise<void> removed;
+  Channel<int>* self = new Channel<int>(a, [&](int&) {});
+  Channel<int> trigger(a, [&](int&) {
+    delete self;
+    removed.set_value();
+  });
+  trigger.Send(1);
+  ASSERT_EQ(removed.get_future().wait_for(std::chrono::seconds(10)),
+            std::future_status::ready);
+}
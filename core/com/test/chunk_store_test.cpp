@@ -0,0 +1,152 @@
+﻿// chunk_store_test.cpp
+// ChunkStore 类单元测试
+
+#include "include/chunk_store.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "include/sha256.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// ==================== ChunkStore 测试 ====================
+
+// 测试块的保存、去重和 have/need 交换
+TEST(ChunkStoreTest, PutAndMissing) {
+  fs::path root = fs::temp_directory_path() / "chunk_store_test_put";
+  fs::remove_all(root);
+  ChunkStore store(root.string());
+  ASSERT_TRUE(store.Init());
+
+  std::string a = "chunk a", b = "chunk b";
+  std::string hash_a = Sha256::Hex(a.data(), a.size());
+  std::string hash_b = Sha256::Hex(b.data(), b.size());
+
+  EXPECT_TRUE(store.Put(hash_a, a.data(), a.size()));
+  EXPECT_TRUE(store.Has(hash_a));
+
+  // 已有的块不需要再发送, 重复的哈希只要一次
+  auto missing = store.Missing({hash_a, hash_b, hash_b});
+  ASSERT_EQ(missing.size(), 1u);
+  EXPECT_EQ(missing[0], hash_b);
+
+  // 再次保存相同块只计入去重字节
+  EXPECT_TRUE(store.Put(hash_a, a.data(), a.size()));
+  EXPECT_EQ(store.stored_bytes(), static_cast<long long>(a.size()));
+  EXPECT_EQ(store.dedup_bytes(), static_cast<long long>(a.size()));
+
+  std::string data;
+  EXPECT_TRUE(store.Get(hash_a, &data));
+  EXPECT_EQ(data, a);
+
+  fs::remove_all(root);
+}
+
+// 测试拒绝哈希不匹配和非法的哈希
+TEST(ChunkStoreTest, RejectBadChunk) {
+  fs::path root = fs::temp_directory_path() / "chunk_store_test_bad";
+  fs::remove_all(root);
+  ChunkStore store(root.string());
+  ASSERT_TRUE(store.Init());
+
+  std::string a = "chunk a";
+  std::string wrong = Sha256::Hex("other", 5);
+  EXPECT_FALSE(store.Put(wrong, a.data(), a.size()));
+  EXPECT_FALSE(store.Has("../../etc/passwd"));
+  EXPECT_FALSE(store.Put("../x", a.data(), a.size()));
+
+  fs::remove_all(root);
+}
+
+// 测试清单写入和文件还原
+TEST(ChunkStoreTest, ManifestRoundTrip) {
+  fs::path root = fs::temp_directory_path() / "chunk_store_test_manifest";
+  fs::remove_all(root);
+  ChunkStore store(root.string());
+  ASSERT_TRUE(store.Init());
+
+  std::string content;
+  for (int i = 0; i < 50000; ++i) content.push_back('a' + (i * 7) % 26);
+  Chunker chunker(ChunkMode::kFixed, 4096);
+  std::vector<ChunkRef> chunks;
+  auto save = [&](const ChunkRef& chunk, const char* data) {
+    EXPECT_TRUE(store.Put(chunk.hash, data, chunk.length));
+    chunks.push_back(chunk);
+  };
+  chunker.Update(content.data(), content.size(), save);
+  chunker.Finish(save);
+
+  // 清单名称不能越出存储目录
+  EXPECT_FALSE(store.WriteManifest("../escape", chunks));
+  ASSERT_TRUE(store.WriteManifest("dir/file.bin", chunks));
+
+  std::vector<ChunkRef> loaded;
+  ASSERT_TRUE(store.ReadManifest("dir/file.bin", &loaded));
+  ASSERT_EQ(loaded.size(), chunks.size());
+  EXPECT_EQ(loaded.back().offset, chunks.back().offset);
+
+  fs::path out = root / "restored.bin";
+  ASSERT_TRUE(store.Restore("dir/file.bin", out.string()));
+  std::ifstream in(out, std::ios::binary);
+  std::string restored((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  EXPECT_EQ(restored, content);
+
+  fs::remove_all(root);
+}
+
+// 测试任一存储目录创建失败时初始化失败
+TEST(ChunkStoreTest, InitChecksEachDirectory) {
+  fs::path root = fs::temp_directory_path() / "chunk_store_test_init";
+  fs::remove_all(root);
+  fs::create_directories(root);
+  // `chunks`被普通文件占用, 之后的`manifests`仍能创建成功
+  std::ofstream(root / "chunks") << "not a directory";
+  ChunkStore store(root.string());
+  EXPECT_FALSE(store.Init());
+
+  fs::remove_all(root);
+}
+
+// 测试还原失败时不破坏已有的输出文件, 不留下临时文件
+TEST(ChunkStoreTest, RestoreIsAtomic) {
+  fs::path root = fs::temp_directory_path() / "chunk_store_test_restore";
+  fs::remove_all(root);
+  ChunkStore store(root.string());
+  ASSERT_TRUE(store.Init());
+
+  std::string a(5000, 'a'), b(5000, 'b');
+  std::vector<ChunkRef> chunks(2);
+  chunks[0].hash = Sha256::Hex(a.data(), a.size());
+  chunks[0].length = a.size();
+  chunks[1].hash = Sha256::Hex(b.data(), b.size());
+  chunks[1].length = b.size();
+  ASSERT_TRUE(store.Put(chunks[0].hash, a.data(), a.size()));
+  ASSERT_TRUE(store.Put(chunks[1].hash, b.data(), b.size()));
+  ASSERT_TRUE(store.WriteManifest("file.bin", chunks));
+
+  fs::path out_dir = root / "out";
+  fs::create_directories(out_dir);
+  fs::path out = out_dir / "file.bin";
+  std::ofstream(out) << "old content";
+
+  // 第二个块缺失, 还原失败
+  fs::remove_all(root / "chunks");
+  ASSERT_TRUE(store.Init());
+  ASSERT_TRUE(store.Put(chunks[0].hash, a.data(), a.size()));
+  EXPECT_FALSE(store.Restore("file.bin", out.string()));
+  std::ifstream in(out, std::ios::binary);
+  std::string kept((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  EXPECT_EQ(kept, "old content");
+  EXPECT_EQ(std::distance(fs::directory_iterator(out_dir),
+                          fs::directory_iterator()),
+            1);
+
+  fs::remove_all(root);
+}
@@ -0,0 +1,97 @@
+﻿// chunker_test.cpp
+// Chunker 类单元测试
+
+#include "include/chunker.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <string>
+
+using namespace crossocean;
+
+// 生成固定种子的随机数据
+static std::string RandomData(size_t size, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::string data(size, '\0');
+  for (auto& c : data) c = static_cast<char>(rng());
+  return data;
+}
+
+// ==================== Chunker 测试 ====================
+
+// 测试固定大小分块
+TEST(ChunkerTest, FixedSize) {
+  std::string data = RandomData(10000, 1);
+  auto chunks =
+      Chunker::Split(ChunkMode::kFixed, 4096, data.data(), data.size());
+  ASSERT_EQ(chunks.size(), 3u);
+  EXPECT_EQ(chunks[0].length, 4096u);
+  EXPECT_EQ(chunks[1].offset, 4096);
+  EXPECT_EQ(chunks[2].length, 10000u - 8192u);
+}
+
+// 测试内容定义分块的块大小范围
+TEST(ChunkerTest, FastCdcSizeBounds) {
+  std::string data = RandomData(1 << 20, 2);
+  Chunker chunker(ChunkMode::kFastCdc, 8192);
+  auto chunks =
+      Chunker::Split(ChunkMode::kFastCdc, 8192, data.data(), data.size());
+
+  long long total = 0;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    EXPECT_EQ(chunks[i].offset, total);
+    EXPECT_LE(chunks[i].length, chunker.max_size());
+    if (i + 1 < chunks.size()) {
+      EXPECT_GE(chunks[i].length, chunker.min_size());
+    }
+    total += chunks[i].length;
+  }
+  EXPECT_EQ(total, static_cast<long long>(data.size()));
+  // 平均块大小接近设定值
+  double avg = static_cast<double>(data.size()) / chunks.size();
+  EXPECT_GT(avg, 8192 / 2);
+  EXPECT_LT(avg, 8192 * 2);
+}
+
+// 测试在文件头部插入数据后大部分块保持不变
+TEST(ChunkerTest, FastCdcShiftResistance) {
+  std::string data = RandomData(1 << 20, 3);
+  std::string shifted = "inserted bytes" + data;
+
+  auto chunks1 =
+      Chunker::Split(ChunkMode::kFastCdc, 8192, data.data(), data.size());
+  auto chunks2 =
+      Chunker::Split(ChunkMode::kFastCdc, 8192, shifted.data(), shifted.size());
+
+  std::set<std::string> hashes;
+  for (auto& chunk : chunks1) hashes.insert(chunk.hash);
+  size_t shared = 0;
+  for (auto& chunk : chunks2) shared += hashes.count(chunk.hash);
+  EXPECT_GE(shared, chunks1.size() - 2);
+}
+
+// 测试分段输入与一次输入结果一致
+TEST(ChunkerTest, StreamingMatchesSplit) {
+  std::string data = RandomData(300000, 4);
+  auto expected =
+      Chunker::Split(ChunkMode::kFastCdc, 4096, data.data(), data.size());
+
+  std::vector<ChunkRef> chunks;
+  Chunker chunker(ChunkMode::kFastCdc, 4096);
+  auto collect = [&chunks](const ChunkRef& chunk, const char*) {
+    chunks.push_back(chunk);
+  };
+  for (size_t pos = 0; pos < data.size(); pos += 1000) {
+    chunker.Update(data.data() + pos, std::min<size_t>(1000, data.size() - pos),
+                   collect);
+  }
+  chunker.Finish(collect);
+
+  ASSERT_EQ(chunks.size(), expected.size());
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    EXPECT_EQ(chunks[i].hash, expected[i].hash);
+    EXPECT_EQ(chunks[i].offset, expected[i].offset);
+  }
+}
@@ -0,0 +1,264 @@
+﻿// cluster_client_test.cpp
+// ClusterClient 类单元测试
+
+#include "include/cluster_client.h"
+
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/replication.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 在子进程中启动集群节点, 模拟多台机器
+class ClusterClientTest : public ::testing::Test {
+ protected:
+  static constexpr int kMaxNodes = 4;
+
+  void SetUp() override {
+    base_ = fs::temp_directory_path() /
+            ("cluster_client_test_" + std::to_string(getpid()));
+    fs::remove_all(base_);
+    int port = 20000 + (getpid() * 7) % 20000;
+    for (int i = 0; i < kMaxNodes; ++i) {
+      roots_.push_back(base_ / ("node" + std::to_string(i)));
+      addresses_.push_back("127.0.0.1:" + std::to_string(port + i));
+      pids_.push_back(-1);
+    }
+  }
+
+  void TearDown() override {
+    for (pid_t pid : pids_) {
+      if (pid < 0) continue;
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+    fs::remove_all(base_);
+  }
+
+  // 启动节点进程并等待开始监听
+  void StartNode(int i) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      ReplicaOptions options;
+      options.port = std::stoi(addresses_[i].substr(10));
+      options.root = roots_[i].string();
+      options.address = addresses_[i];
+      ReplicaServer server(options);
+      if (!server.Start()) _exit(1);
+      while (true) pause();
+    }
+    pids_[i] = pid;
+    for (int n = 0; n < 200; ++n) {
+      ChainClient client;
+      if (client.Connect(addresses_[i])) return;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    FAIL() << "node " << i << " did not start";
+  }
+
+  // 由前`count`个节点组成的分片表
+  ShardMap Map(int count, uint64_t version, int replicas = 1) {
+    ShardMap map(64, replicas);
+    map.set_version(version);
+    for (int i = 0; i < count; ++i) map.AddNode(addresses_[i]);
+    return map;
+  }
+
+  // 生成测试数据
+  static std::string Data(size_t size, int seed) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = static_cast<char>((i * 131 + seed) % 251);
+    }
+    return data;
+  }
+
+  static std::string FileName(int i) {
+    return "dir" + std::to_string(i % 7) + "/file-" + std::to_string(i);
+  }
+
+  // 文件是否有写入中的临时文件(`文件名.<编号>.chain.tmp`)
+  static bool HasTemp(const fs::path& file) {
+    std::error_code ec;
+    std::string prefix = file.filename().string() + ".";
+    for (fs::directory_iterator it(file.parent_path(), ec), end;
+         !ec && it != end; it.increment(ec)) {
+      std::string name = it->path().filename().string();
+      if (name.compare(0, prefix.size(), prefix) == 0 &&
+          name.find(".chain.tmp") != std::string::npos) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // 文件是否只在归属节点上(不在其它节点上, 没有临时文件)
+  bool Placed(const ShardMap& map, int files) {
+    for (int i = 0; i < files; ++i) {
+      std::string name = FileName(i);
+      for (int n = 0; n < kMaxNodes; ++n) {
+        fs::path path = roots_[n] / name;
+        if (fs::exists(path) != map.Owns(addresses_[n], name)) return false;
+        if (HasTemp(path)) return false;
+      }
+    }
+    return true;
+  }
+
+  // 等待再平衡完成
+  bool WaitPlaced(const ShardMap& map, int files) {
+    for (int n = 0; n < 1000; ++n) {
+      if (Placed(map, files)) return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+  }
+
+  fs::path base_;
+  std::vector<fs::path> roots_;
+  std::vector<std::string> addresses_;
+  std::vector<pid_t> pids_;
+};
+
+// ==================== ClusterClient 测试 ====================
+
+// 测试客户端获取分片表后直接写入和读取归属节点
+TEST_F(ClusterClientTest, RoutesToOwners) {
+  for (int i = 0; i < 3; ++i) StartNode(i);
+  ClusterClient admin;
+  ASSERT_TRUE(admin.Publish(Map(3, 1, 2)));
+
+  ClusterClient client;
+  ASSERT_TRUE(client.Connect(addresses_[1]));
+  EXPECT_EQ(client.map().version(), 1u);
+  const int kFiles = 60;
+  for (int i = 0; i < kFiles; ++i) {
+    std::string data = Data(1000 + i, i);
+    ASSERT_TRUE(client.Put(FileName(i), data.data(), data.size())) << i;
+  }
+  EXPECT_TRUE(Placed(client.map(), kFiles));
+  for (int i = 0; i < kFiles; ++i) {
+    std::string data;
+    ASSERT_TRUE(client.Get(FileName(i), &data)) << i;
+    EXPECT_EQ(data, Data(1000 + i, i));
+  }
+  EXPECT_EQ(client.redirects(), 0);
+
+  // 旧版本的分片表被拒绝
+  ChainClient node;
+  ASSERT_TRUE(node.Connect(addresses_[0]));
+  EXPECT_FALSE(node.SetShardMap(Map(2, 1)));
+}
+
+// 测试持有旧分片表的客户端被重定向后更新分片表
+TEST_F(ClusterClientTest, RedirectsStaleClients) {
+  for (int i = 0; i < 4; ++i) StartNode(i);
+  ClusterClient admin;
+  ASSERT_TRUE(admin.Publish(Map(3, 1)));
+  ClusterClient stale;
+  ASSERT_TRUE(stale.Connect(addresses_[0]));
+
+  ShardMap map = Map(4, 2);
+  ASSERT_TRUE(admin.Publish(map));
+  // 找到归属改变的文件
+  int moved = -1;
+  for (int i = 0; i < 1000 && moved < 0; ++i) {
+    if (map.Owners(FileName(i)) != stale.map().Owners(FileName(i))) moved = i;
+  }
+  ASSERT_GE(moved, 0);
+  std::string data = Data(300000, 1);
+  ASSERT_TRUE(stale.Put(FileName(moved), data.data(), data.size()));
+  EXPECT_GT(stale.redirects(), 0);
+  EXPECT_EQ(stale.map().version(), 2u);
+  EXPECT_TRUE(fs::exists(roots_[3] / FileName(moved)));
+
+  std::string read;
+  ClusterClient fresh;
+  ASSERT_TRUE(fresh.Connect(addresses_[2]));
+  ASSERT_TRUE(fresh.Get(FileName(moved), &read));
+  EXPECT_EQ(read, data);
+}
+
+// 测试增删节点后后台再平衡: 文件移到新的归属节点, 内容不变
+TEST_F(ClusterClientTest, Rebalance) {
+  for (int i = 0; i < 4; ++i) StartNode(i);
+  ClusterClient client;
+  ASSERT_TRUE(client.Publish(Map(3, 1)));
+  const int kFiles = 200;
+  const size_t kSize = 64 * 1024;
+  for (int i = 0; i < kFiles; ++i) {
+    std::string data = Data(kSize, i);
+    ASSERT_TRUE(client.Put(FileName(i), data.data(), data.size())) << i;
+  }
+  ASSERT_TRUE(Placed(client.map(), kFiles));
+
+  // 增加节点
+  ShardMap grown = Map(4, 2);
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(client.Publish(grown));
+  ASSERT_TRUE(WaitPlaced(grown, kFiles));
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  int moved = 0;
+  for (int i = 0; i < kFiles; ++i) {
+    if (grown.Owns(addresses_[3], FileName(i))) ++moved;
+  }
+  EXPECT_GT(moved, 0);
+  std::cout << "Rebalanced " << moved << " files ("
+            << moved * kSize / 1024 << " KiB) in " << seconds * 1000
+            << " ms" << std::endl;
+
+  // 删除节点: 节点0上的文件移到其余节点
+  ShardMap shrunk(64, 1);
+  shrunk.set_version(3);
+  for (int i = 1; i < 4; ++i) shrunk.AddNode(addresses_[i]);
+  ASSERT_TRUE(client.Publish(shrunk));
+  ASSERT_TRUE(WaitPlaced(shrunk, kFiles));
+
+  for (int i = 0; i < kFiles; ++i) {
+    std::string data;
+    ASSERT_TRUE(client.Get(FileName(i), &data)) << i;
+    EXPECT_EQ(data, Data(kSize, i)) << i;
+  }
+}
+
+// 测试再平衡不覆盖期间写入归属节点的新版本
+TEST_F(ClusterClientTest, RebalanceKeepsNewerWrites) {
+  for (int i = 0; i < 2; ++i) StartNode(i);
+  ClusterClient client;
+  ASSERT_TRUE(client.Publish(Map(1, 1)));
+  std::string old_data = Data(1000, 1);
+  ASSERT_TRUE(client.Put("a.txt", old_data.data(), old_data.size()));
+
+  // 新版本先直接写入将来的归属节点
+  ShardMap map(64, 1);
+  map.set_version(2);
+  map.AddNode(addresses_[1]);
+  std::string new_data = Data(2000, 2);
+  ChainClient node;
+  ASSERT_TRUE(node.Connect(addresses_[1]));
+  ASSERT_TRUE(node.Put("a.txt", new_data.data(), new_data.size(), {}));
+
+  ASSERT_TRUE(client.Publish(map));
+  ASSERT_TRUE(WaitPlaced(map, 0));
+  for (int n = 0; n < 500 && fs::exists(roots_[0] / "a.txt"); ++n) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_FALSE(fs::exists(roots_[0] / "a.txt"));
+  std::string data;
+  ASSERT_TRUE(client.Get("a.txt", &data));
+  EXPECT_EQ(data, new_data);
+}
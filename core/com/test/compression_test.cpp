@@ -0,0 +1,143 @@
+﻿// compression_test.cpp
+// Compression / CompressionBudget / ChunkEncoder / ChunkDecoder 类单元测试
+
+#include "include/compression.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+using namespace crossocean;
+
+// 生成可压缩的文本数据(类似日志)
+static std::string LogText(size_t len) {
+  std::string text;
+  int line = 0;
+  while (text.size() < len) {
+    text += "2026-10-19 12:00:" + std::to_string(line % 60) +
+            " INFO disk_server request id=" + std::to_string(line) +
+            " path=/data/archive/file.log status=200\n";
+    ++line;
+  }
+  text.resize(len);
+  return text;
+}
+
+// 生成随机数据(不可压缩)
+static std::string RandomBytes(size_t len, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::string data(len, '\0');
+  for (char& c : data) c = static_cast<char>(rng() & 0xff);
+  return data;
+}
+
+// ==================== Compression 测试 ====================
+
+// 测试压缩算法协商
+TEST(CompressionTest, Negotiate) {
+  EXPECT_EQ(Compression::Negotiate("zlib"), CompressionCodec::kZlib);
+  EXPECT_EQ(Compression::Negotiate("lz4, zlib"), CompressionCodec::kZlib);
+  EXPECT_EQ(Compression::Negotiate("lz4"), CompressionCodec::kNone);
+  EXPECT_EQ(Compression::Negotiate(""), CompressionCodec::kNone);
+  if (Compression::Available(CompressionCodec::kZstd)) {
+    EXPECT_EQ(Compression::Negotiate("zstd,zlib"), CompressionCodec::kZstd);
+  } else {
+    // 未编译 zstd 时回退到 zlib
+    EXPECT_EQ(Compression::Negotiate("zstd,zlib"), CompressionCodec::kZlib);
+  }
+  EXPECT_EQ(Compression::Negotiate(Compression::Supported()),
+            Compression::Available(CompressionCodec::kZstd)
+                ? CompressionCodec::kZstd
+                : CompressionCodec::kZlib);
+}
+
+// 测试已压缩内容的探测
+TEST(CompressionTest, LooksCompressible) {
+  std::string text = LogText(4096);
+  EXPECT_TRUE(Compression::LooksCompressible(text.data(), text.size()));
+
+  std::string random = RandomBytes(4096, 1);
+  EXPECT_FALSE(Compression::LooksCompressible(random.data(), random.size()));
+
+  // 文件头为 gzip 的内容直接跳过
+  std::string gzip = "\x1f\x8b" + text;
+  EXPECT_FALSE(Compression::LooksCompressible(gzip.data(), gzip.size()));
+}
+
+// ==================== ChunkEncoder / ChunkDecoder 测试 ====================
+
+// 测试分块压缩和分段解压
+TEST(ChunkEncoderTest, RoundTrip) {
+  std::string text = LogText(1024 * 1024);
+  ChunkEncoder encoder(CompressionCodec::kZlib);
+  std::string encoded;
+  const size_t chunk = 64 * 1024;
+  for (size_t pos = 0; pos < text.size(); pos += chunk) {
+    ASSERT_TRUE(encoder.Encode(text.data() + pos,
+                               std::min(chunk, text.size() - pos), &encoded));
+  }
+  EXPECT_FALSE(encoder.bypassed());
+  EXPECT_EQ(encoder.raw_bytes(), static_cast<long long>(text.size()));
+  EXPECT_EQ(encoder.encoded_bytes(), static_cast<long long>(encoded.size()));
+  // 日志文本至少压缩到原来的1/5
+  EXPECT_LT(encoded.size() * 5, text.size());
+
+  ChunkDecoder decoder(CompressionCodec::kZlib);
+  std::string decoded;
+  for (size_t pos = 0; pos < encoded.size(); pos += 1000) {
+    ASSERT_TRUE(decoder.Feed(encoded.data() + pos,
+                             std::min<size_t>(1000, encoded.size() - pos),
+                             &decoded));
+  }
+  EXPECT_FALSE(decoder.pending());
+  EXPECT_EQ(decoded, text);
+}
+
+// 测试已压缩的内容以原文发送
+TEST(ChunkEncoderTest, BypassIncompressible) {
+  std::string random = RandomBytes(256 * 1024, 2);
+  ChunkEncoder encoder(CompressionCodec::kZlib);
+  std::string encoded;
+  ASSERT_TRUE(encoder.Encode(random.data(), random.size(), &encoded));
+  EXPECT_TRUE(encoder.bypassed());
+  EXPECT_EQ(encoded.size(), random.size() + ChunkEncoder::kHeaderSize);
+
+  ChunkDecoder decoder(CompressionCodec::kZlib);
+  std::string decoded;
+  ASSERT_TRUE(decoder.Feed(encoded.data(), encoded.size(), &decoded));
+  EXPECT_EQ(decoded, random);
+
+  // 损坏的压缩帧解压失败
+  std::string text = LogText(8192);
+  ChunkEncoder text_encoder(CompressionCodec::kZlib);
+  std::string frame;
+  ASSERT_TRUE(text_encoder.Encode(text.data(), text.size(), &frame));
+  frame[ChunkEncoder::kHeaderSize + 4] ^= 0x55;
+  ChunkDecoder bad_decoder(CompressionCodec::kZlib);
+  std::string out;
+  EXPECT_FALSE(bad_decoder.Feed(frame.data(), frame.size(), &out));
+}
+
+// 测试压缩预算不足时数据块以原文发送
+TEST(ChunkEncoderTest, BudgetExhausted) {
+  std::string text = LogText(64 * 1024);
+  // 每秒只允许压缩 100KB
+  CompressionBudget budget(1, 100 * 1024);
+  ChunkEncoder encoder(CompressionCodec::kZlib, 1, &budget);
+
+  std::string first, second;
+  ASSERT_TRUE(encoder.Encode(text.data(), text.size(), &first));
+  ASSERT_TRUE(encoder.Encode(text.data(), text.size(), &second));
+  EXPECT_LT(first.size(), text.size());
+  EXPECT_EQ(second.size(), text.size() + ChunkEncoder::kHeaderSize);
+  EXPECT_EQ(budget.skipped_count(), 1);
+
+  // 同时压缩的数量受限
+  CompressionBudget workers(1);
+  EXPECT_TRUE(workers.TryAcquire(100));
+  EXPECT_FALSE(workers.TryAcquire(100));
+  workers.Release();
+  EXPECT_TRUE(workers.TryAcquire(100));
+  workers.Release();
+}
@@ -0,0 +1,82 @@
+﻿// crc32c_test.cpp
+// Crc32c 和 ChunkCrc 类单元测试
+
+#include "include/crc32c.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+using namespace crossocean;
+
+// ==================== Crc32c 测试 ====================
+
+// 测试标准测试向量
+TEST(Crc32cTest, KnownVectors) {
+  EXPECT_EQ(Crc32c::Value("", 0), 0u);
+  EXPECT_EQ(Crc32c::Value("123456789", 9), 0xE3069283u);
+  EXPECT_EQ(Crc32c::ExtendPortable(0, "123456789", 9), 0xE3069283u);
+  std::string zeros(32, '\0');
+  EXPECT_EQ(Crc32c::Value(zeros.data(), zeros.size()), 0x8A9136AAu);
+}
+
+// 测试硬件实现与软件实现在各种长度和对齐下结果一致
+TEST(Crc32cTest, MatchesPortable) {
+  std::mt19937 rng(7);
+  std::string data(100000, '\0');
+  for (auto& c : data) c = static_cast<char>(rng());
+
+  const size_t lengths[] = {0,   1,    7,    8,     9,     255,   768,
+                            769, 4096, 8192, 24576, 24583, 99000};
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t len : lengths) {
+      EXPECT_EQ(Crc32c::Value(data.data() + offset, len),
+                Crc32c::ExtendPortable(0, data.data() + offset, len))
+          << "backend " << Crc32c::Backend() << " offset " << offset
+          << " len " << len;
+    }
+  }
+}
+
+// 测试流式计算与一次计算结果一致
+TEST(Crc32cTest, StreamingUpdate) {
+  std::string data(50000, 'x');
+  Crc32c crc;
+  for (size_t pos = 0; pos < data.size(); pos += 333) {
+    crc.Update(data.data() + pos, std::min<size_t>(333, data.size() - pos));
+  }
+  EXPECT_EQ(crc.value(), Crc32c::Value(data.data(), data.size()));
+}
+
+// ==================== ChunkCrc 测试 ====================
+
+// 测试分块校验和的计算、保存和比较
+TEST(ChunkCrcTest, SaveLoadAndCompare) {
+  std::string data(10000, 'a');
+  ChunkCrc crc(4096);
+  crc.Update(data.data(), 5000);
+  crc.Update(data.data() + 5000, 5000);
+  crc.Finish();
+  ASSERT_EQ(crc.crcs().size(), 3u);
+  EXPECT_EQ(crc.crcs()[0], Crc32c::Value(data.data(), 4096));
+  EXPECT_EQ(crc.crcs()[2], Crc32c::Value(data.data(), 10000 - 8192));
+
+  std::string path = ChunkCrc::SidecarPath("chunk_crc_test.bin");
+  ASSERT_TRUE(crc.Save(path));
+  ChunkCrc loaded;
+  ASSERT_TRUE(loaded.Load(path));
+  EXPECT_EQ(loaded.chunk_size(), 4096u);
+  EXPECT_EQ(loaded.total_size(), 10000);
+  EXPECT_EQ(crc.FirstMismatch(loaded), -1);
+
+  // 第二块内容损坏
+  data[5000] = 'b';
+  ChunkCrc corrupted(4096);
+  corrupted.Update(data.data(), data.size());
+  corrupted.Finish();
+  EXPECT_EQ(loaded.FirstMismatch(corrupted), 1);
+
+  std::remove(path.c_str());
+}
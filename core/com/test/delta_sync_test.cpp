@@ -0,0 +1,280 @@
+﻿// delta_sync_test.cpp
+// 增量同步(RollingChecksum / FileSignature / DeltaGenerator / DeltaPatcher)
+// 单元测试
+
+#include "include/delta_sync.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/blocking_pool.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 生成确定的随机数据
+static std::string RandomData(size_t len, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::string data(len, '\0');
+  for (char& c : data) c = static_cast<char>(rng() & 0xff);
+  return data;
+}
+
+static void WriteFile(const fs::path& path, const std::string& data) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(data.data(), data.size());
+}
+
+static std::string ReadFile(const fs::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+// 统计文件的重建临时文件(`文件名.<进程号>.<序号>.delta.tmp`)
+static int CountTemps(const fs::path& path) {
+  std::string prefix = path.filename().string() + ".";
+  const std::string suffix = ".delta.tmp";
+  int count = 0;
+  for (const auto& entry : fs::directory_iterator(path.parent_path())) {
+    std::string name = entry.path().filename().string();
+    if (name.size() > prefix.size() + suffix.size() &&
+        name.compare(0, prefix.size(), prefix) == 0 &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) ==
+            0) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// 计算文件签名
+static FileSignature SignFile(const fs::path& path, uint32_t block_size) {
+  FileSignature signature;
+  int fd = open(path.c_str(), O_RDONLY);
+  EXPECT_GE(fd, 0);
+  EXPECT_TRUE(FileSignature::Compute(fd, block_size, &signature));
+  close(fd);
+  return signature;
+}
+
+// ==================== RollingChecksum 测试 ====================
+
+// 测试滑动更新与重新计算的结果一致
+TEST(RollingChecksumTest, RollMatchesReset) {
+  std::string data = RandomData(4096, 1);
+  const size_t window = 700;
+  RollingChecksum rolling, fresh;
+  rolling.Reset(data.data(), window);
+  for (size_t pos = 1; pos + window <= data.size(); ++pos) {
+    rolling.Roll(data[pos - 1], data[pos + window - 1]);
+    fresh.Reset(data.data() + pos, window);
+    ASSERT_EQ(rolling.value(), fresh.value()) << "pos " << pos;
+  }
+}
+
+// ==================== FileSignature 测试 ====================
+
+// 测试签名计算、编码和解码
+TEST(FileSignatureTest, ComputeAndSerialize) {
+  fs::path path = fs::temp_directory_path() / "delta_sync_test_sig.bin";
+  WriteFile(path, RandomData(10000, 2));
+
+  FileSignature signature = SignFile(path, 1024);
+  EXPECT_EQ(signature.file_size, 10000);
+  ASSERT_EQ(signature.blocks.size(), 10u);
+  EXPECT_EQ(signature.BlockLength(9), 10000u - 9 * 1024);
+
+  std::string encoded;
+  signature.Serialize(&encoded);
+  FileSignature parsed;
+  ASSERT_TRUE(parsed.Parse(encoded));
+  EXPECT_EQ(parsed.block_size, 1024u);
+  EXPECT_EQ(parsed.file_size, 10000);
+  ASSERT_EQ(parsed.blocks.size(), 10u);
+  EXPECT_EQ(parsed.blocks[3].weak, signature.blocks[3].weak);
+  EXPECT_EQ(parsed.blocks[3].strong, signature.blocks[3].strong);
+
+  // 截断的数据解码失败
+  EXPECT_FALSE(parsed.Parse(encoded.substr(0, encoded.size() - 1)));
+
+  // 默认块大小约为文件大小的平方根
+  EXPECT_EQ(FileSignature::DefaultBlockSize(100), 700u);
+  EXPECT_EQ(FileSignature::DefaultBlockSize(1LL << 30), 32768u);
+  EXPECT_EQ(FileSignature::DefaultBlockSize(1LL << 40), 128u * 1024);
+  fs::remove(path);
+}
+
+// 测试在阻塞I/O线程池中计算签名
+TEST(FileSignatureTest, ComputeAsync) {
+  fs::path path = fs::temp_directory_path() / "delta_sync_test_async.bin";
+  WriteFile(path, RandomData(5000, 3));
+
+  BlockingPool pool;
+  pool.Init(1);
+  std::atomic<bool> finished{false};
+  std::shared_ptr<FileSignature> result;
+  ASSERT_TRUE(FileSignature::ComputeAsync(
+      &pool, path.string(), 1000, nullptr,
+      [&](std::shared_ptr<FileSignature> signature) {
+        result = signature;
+        finished = true;
+      }));
+  for (int i = 0; i < 200 && !finished; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  pool.Stop();
+  ASSERT_TRUE(finished);
+  ASSERT_NE(result, nullptr);
+  EXPECT_EQ(result->blocks.size(), 5u);
+  fs::remove(path);
+}
+
+// ==================== DeltaGenerator / DeltaPatcher 测试 ====================
+
+// 测试修改文件中间部分后, 增量只包含修改的数据, 并能重建出新文件
+TEST(DeltaSyncTest, RoundTripWithEdits) {
+  fs::path path = fs::temp_directory_path() / "delta_sync_test_roundtrip.bin";
+  std::string basis = RandomData(200000, 4);
+  WriteFile(path, basis);
+  FileSignature signature = SignFile(path, 1024);
+
+  // 插入、替换和删除数据, 并在末尾追加数据
+  std::string target = basis;
+  target.insert(5000, "inserted bytes");
+  target.replace(80000, 300, RandomData(300, 5));
+  target.erase(150000, 2000);
+  target += "tail";
+
+  std::string encoded;
+  DeltaGenerator generator(signature, [&](const DeltaOp& op) {
+    op.Encode(&encoded);
+    return true;
+  });
+  // 分段输入
+  for (size_t pos = 0; pos < target.size(); pos += 4093) {
+    size_t n = std::min<size_t>(4093, target.size() - pos);
+    ASSERT_TRUE(generator.Update(target.data() + pos, n));
+  }
+  ASSERT_TRUE(generator.Finish());
+  EXPECT_EQ(generator.copied_bytes() + generator.literal_bytes(),
+            static_cast<long long>(target.size()));
+  // 只有修改附近的块需要重新发送
+  EXPECT_LT(generator.literal_bytes(), 8 * 1024);
+  EXPECT_LT(encoded.size(), 10 * 1024u);
+
+  DeltaPatcher patcher(path.string());
+  ASSERT_TRUE(patcher.Open());
+  // 指令流按任意边界分段输入
+  for (size_t pos = 0; pos < encoded.size(); pos += 7) {
+    size_t n = std::min<size_t>(7, encoded.size() - pos);
+    ASSERT_TRUE(patcher.Feed(encoded.data() + pos, n));
+  }
+  ASSERT_TRUE(patcher.Finish());
+  EXPECT_EQ(patcher.copied_bytes(), generator.copied_bytes());
+  EXPECT_EQ(ReadFile(path), target);
+  EXPECT_EQ(CountTemps(path), 0);
+  fs::remove(path);
+}
+
+// 测试内容不变时只有一条复制指令(包括较短的最后一块)
+TEST(DeltaSyncTest, UnchangedFileIsSingleCopy) {
+  fs::path path = fs::temp_directory_path() / "delta_sync_test_same.bin";
+  std::string basis = RandomData(10500, 6);
+  WriteFile(path, basis);
+  FileSignature signature = SignFile(path, 1000);
+
+  std::vector<DeltaOp> ops;
+  DeltaGenerator generator(signature, [&](const DeltaOp& op) {
+    ops.push_back(op);
+    return true;
+  });
+  ASSERT_TRUE(generator.Update(basis.data(), basis.size()));
+  ASSERT_TRUE(generator.Finish());
+  ASSERT_EQ(ops.size(), 1u);
+  EXPECT_EQ(ops[0].type, DeltaOpType::kCopy);
+  EXPECT_EQ(ops[0].offset, 0);
+  EXPECT_EQ(ops[0].length, 10500);
+  fs::remove(path);
+}
+
+// 测试基准文件不存在时只用新数据重建, 越界的复制指令被拒绝
+TEST(DeltaSyncTest, NewFileAndInvalidCopy) {
+  fs::path path = fs::temp_directory_path() / "delta_sync_test_new.bin";
+  fs::remove(path);
+
+  DeltaPatcher patcher(path.string());
+  ASSERT_TRUE(patcher.Open());
+  DeltaOp copy;
+  copy.type = DeltaOpType::kCopy;
+  copy.offset = 0;
+  copy.length = 10;
+  EXPECT_FALSE(patcher.Apply(copy));
+
+  DeltaOp literal;
+  literal.data = "hello delta";
+  ASSERT_TRUE(patcher.Apply(literal));
+  ASSERT_TRUE(patcher.Finish());
+  EXPECT_EQ(ReadFile(path), "hello delta");
+
+  // 不完整的指令流不会替换文件
+  DeltaPatcher broken(path.string());
+  ASSERT_TRUE(broken.Open());
+  std::string encoded;
+  literal.Encode(&encoded);
+  ASSERT_TRUE(broken.Feed(encoded.data(), encoded.size() - 3));
+  EXPECT_FALSE(broken.Finish());
+  EXPECT_EQ(ReadFile(path), "hello delta");
+  fs::remove(path);
+}
+
+// 测试同一文件的多个重建使用各自的临时文件, 溢出的复制区间被拒绝
+TEST(DeltaSyncTest, ConcurrentPatchersAndOverflowingCopy) {
+  fs::path path = fs::temp_directory_path() / "delta_sync_test_concurrent.bin";
+  std::string basis = RandomData(5000, 7);
+  WriteFile(path, basis);
+
+  DeltaPatcher first(path.string());
+  DeltaPatcher second(path.string());
+  ASSERT_TRUE(first.Open());
+  ASSERT_TRUE(second.Open());
+  EXPECT_EQ(CountTemps(path), 2);
+
+  // 偏移加长度超出`long long`范围
+  DeltaOp copy;
+  copy.type = DeltaOpType::kCopy;
+  copy.offset = 100;
+  copy.length = std::numeric_limits<long long>::max() - 50;
+  EXPECT_FALSE(first.Apply(copy));
+  copy.offset = std::numeric_limits<long long>::max();
+  copy.length = 10;
+  EXPECT_FALSE(first.Apply(copy));
+
+  DeltaOp literal;
+  literal.data = "first";
+  ASSERT_TRUE(first.Apply(literal));
+  copy.offset = 0;
+  copy.length = static_cast<long long>(basis.size());
+  ASSERT_TRUE(second.Apply(copy));
+
+  // 各自的临时文件互不影响
+  ASSERT_TRUE(first.Finish());
+  EXPECT_EQ(ReadFile(path), "first");
+  ASSERT_TRUE(second.Finish());
+  EXPECT_EQ(ReadFile(path), basis);
+  EXPECT_EQ(CountTemps(path), 0);
+  fs::remove(path);
+}
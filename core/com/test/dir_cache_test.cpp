@@ -0,0 +1,234 @@
+﻿// dir_cache_test.cpp
+// DirCache 类单元测试
+
+#include "include/dir_cache.h"
+
+#include <gtest/gtest.h>
+#include <poll.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 创建测试目录
+class DirCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = fs::temp_directory_path() / "dir_cache_test";
+    fs::remove_all(root_);
+    fs::create_directories(root_);
+  }
+
+  void TearDown() override { fs::remove_all(root_); }
+
+  // 创建文件
+  void Write(const std::string& name, size_t size) {
+    fs::path path = root_ / name;
+    fs::create_directories(path.parent_path());
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << std::string(size, 'x');
+  }
+
+  // 列出整个目录的名称
+  static std::vector<std::string> Names(DirCache& cache,
+                                        const std::string& dir) {
+    DirPage page;
+    std::vector<std::string> names;
+    if (!cache.List(dir, "", 0, &page)) return names;
+    std::vector<DirEntry> entries;
+    std::string cursor;
+    EXPECT_TRUE(DirCache::Decode(page.data, &entries, &cursor));
+    for (auto& entry : entries) names.push_back(entry.name);
+    return names;
+  }
+
+  // 等待inotify事件并处理
+  static void WaitEvents(DirCache& cache) {
+    pollfd pfd = {cache.fd(), POLLIN, 0};
+    ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+    EXPECT_GT(cache.ProcessEvents(), 0);
+  }
+
+  fs::path root_;
+};
+
+// ==================== DirCache 测试 ====================
+
+// 测试列出目录和分页, 第二次列出使用缓存
+TEST_F(DirCacheTest, ListAndPaginate) {
+  for (int i = 0; i < 250; ++i) {
+    char name[16];
+    snprintf(name, sizeof(name), "f%03d", i);
+    Write(name, i);
+  }
+  fs::create_directories(root_ / "sub");
+  DirCache cache(root_.string());
+
+  std::vector<DirEntry> all;
+  std::string cursor;
+  int pages = 0;
+  do {
+    DirPage page;
+    ASSERT_TRUE(cache.List("", cursor, 100, &page));
+    std::vector<DirEntry> entries;
+    std::string next;
+    ASSERT_TRUE(DirCache::Decode(page.data, &entries, &next));
+    EXPECT_EQ(next, page.next_cursor);
+    EXPECT_EQ(static_cast<int>(entries.size()), page.count);
+    all.insert(all.end(), entries.begin(), entries.end());
+    cursor = next;
+    ++pages;
+  } while (!cursor.empty());
+
+  EXPECT_EQ(pages, 3);
+  ASSERT_EQ(all.size(), 251u);
+  EXPECT_EQ(all[0].name, "f000");
+  EXPECT_EQ(all[123].name, "f123");
+  EXPECT_EQ(all[123].size, 123);
+  EXPECT_FALSE(all[123].is_dir);
+  EXPECT_GT(all[123].mtime_ns, 0);
+  EXPECT_EQ(all[250].name, "sub");
+  EXPECT_TRUE(all[250].is_dir);
+
+  DirCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.loads, 1);
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.cached, 1);
+}
+
+// 测试翻页期间增删文件, 游标之后的项不重复也不遗漏
+TEST_F(DirCacheTest, StableCursor) {
+  for (int i = 0; i < 20; ++i) {
+    Write("f" + std::to_string(i + 10), 1);
+  }
+  DirCache cache(root_.string());
+  DirPage page;
+  ASSERT_TRUE(cache.List("", "", 5, &page));
+  EXPECT_EQ(page.next_cursor, "f14");
+
+  // 游标之前新增、游标之后删除
+  Write("f00", 1);
+  cache.OnWrite("f00");
+  fs::remove(root_ / "f15");
+  cache.OnRemove("f15");
+  // 删除游标本身所在的项
+  fs::remove(root_ / "f14");
+  cache.OnRemove("f14");
+
+  ASSERT_TRUE(cache.List("", page.next_cursor, 5, &page));
+  std::vector<DirEntry> entries;
+  std::string cursor;
+  ASSERT_TRUE(DirCache::Decode(page.data, &entries, &cursor));
+  ASSERT_EQ(entries.size(), 5u);
+  EXPECT_EQ(entries[0].name, "f16");
+  EXPECT_EQ(entries[4].name, "f20");
+  EXPECT_EQ(cache.stats().loads, 1);
+}
+
+// 测试服务器上传和删除时增量更新缓存
+TEST_F(DirCacheTest, IncrementalUpdates) {
+  Write("a.txt", 10);
+  DirCache cache(root_.string());
+  EXPECT_EQ(Names(cache, ""), std::vector<std::string>({"a.txt"}));
+
+  // 上传到新创建的子目录, 根目录中出现子目录
+  Write("new/dir/b.txt", 5);
+  cache.OnWrite("new/dir/b.txt");
+  EXPECT_EQ(Names(cache, ""), std::vector<std::string>({"a.txt", "new"}));
+  EXPECT_EQ(Names(cache, "new/dir"), std::vector<std::string>({"b.txt"}));
+
+  // 覆盖后大小更新
+  Write("a.txt", 99);
+  cache.OnWrite("./a.txt");
+  DirPage page;
+  ASSERT_TRUE(cache.List("", "", 1, &page));
+  std::vector<DirEntry> entries;
+  std::string cursor;
+  ASSERT_TRUE(DirCache::Decode(page.data, &entries, &cursor));
+  ASSERT_EQ(entries.size(), 1u);
+  EXPECT_EQ(entries[0].size, 99);
+
+  // 删除目录时子目录的缓存一起删除
+  fs::remove_all(root_ / "new");
+  cache.OnRemove("new");
+  EXPECT_EQ(Names(cache, ""), std::vector<std::string>({"a.txt"}));
+  EXPECT_FALSE(cache.List("new/dir", "", 0, &page));
+
+  DirCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.loads, 3);
+  EXPECT_GT(stats.updates, 0);
+}
+
+// 测试通过inotify发现其它进程的修改
+TEST_F(DirCacheTest, InotifyDetectsExternalChanges) {
+  Write("dir/a", 1);
+  DirCache cache(root_.string());
+  if (!cache.Init()) GTEST_SKIP() << "inotify is not available";
+  EXPECT_EQ(Names(cache, "dir"), std::vector<std::string>({"a"}));
+
+  Write("dir/b", 2);
+  WaitEvents(cache);
+  EXPECT_EQ(Names(cache, "dir"), std::vector<std::string>({"a", "b"}));
+
+  fs::rename(root_ / "dir/a", root_ / "dir/c");
+  WaitEvents(cache);
+  EXPECT_EQ(Names(cache, "dir"), std::vector<std::string>({"b", "c"}));
+  EXPECT_EQ(cache.stats().loads, 1);
+
+  // 目录本身被删除后缓存失效
+  fs::remove_all(root_ / "dir");
+  WaitEvents(cache);
+  EXPECT_EQ(cache.stats().cached, 0);
+  DirPage page;
+  EXPECT_FALSE(cache.List("dir", "", 0, &page));
+}
+
+// 测试没有inotify时按目录修改时间发现外部修改
+TEST_F(DirCacheTest, MtimeFallback) {
+  Write("a", 1);
+  DirCache cache(root_.string());
+  EXPECT_EQ(Names(cache, ""), std::vector<std::string>({"a"}));
+  EXPECT_EQ(Names(cache, ""), std::vector<std::string>({"a"}));
+  EXPECT_EQ(cache.stats().hits, 1);
+
+  // 避开粗粒度时间戳
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  Write("b", 1);
+  EXPECT_EQ(Names(cache, ""), std::vector<std::string>({"a", "b"}));
+  DirCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.loads, 2);
+  EXPECT_EQ(stats.invalidations, 1);
+}
+
+// 测试非法路径和目录数量上限
+TEST_F(DirCacheTest, PathsAndEviction) {
+  for (int i = 0; i < 4; ++i) {
+    Write("d" + std::to_string(i) + "/f", 1);
+  }
+  Write("file", 1);
+  DirCache cache(root_.string(), 2);
+  DirPage page;
+  EXPECT_FALSE(cache.List("../", "", 0, &page));
+  EXPECT_FALSE(cache.List("d0/../d1", "", 0, &page));
+  EXPECT_FALSE(cache.List("/etc", "", 0, &page));
+  EXPECT_FALSE(cache.List("missing", "", 0, &page));
+  EXPECT_FALSE(cache.List("file", "", 0, &page));
+  EXPECT_TRUE(cache.List("d0//", "", 0, &page));
+  EXPECT_EQ(page.count, 1);
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(cache.List("d" + std::to_string(i), "", 0, &page));
+  }
+  DirCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.cached, 2);
+  EXPECT_EQ(stats.evictions, 2);
+  // 最近使用的目录仍在缓存中
+  ASSERT_TRUE(cache.List("d3", "", 0, &page));
+  EXPECT_EQ(cache.stats().hits, stats.hits + 1);
+}
@@ -0,0 +1,227 @@
+﻿// disk_client_test.cpp
+// DiskClient 类单元测试
+
+#include "include/disk_client.h"
+
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "include/crc32c.h"
+#include "include/replication.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 在子进程中启动服务器
+class DiskClientTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    base_ = fs::temp_directory_path() /
+            ("disk_client_test_" + std::to_string(getpid()));
+    fs::remove_all(base_);
+    fs::create_directories(base_ / "local");
+    port_ = 20000 + (getpid() * 13) % 20000;
+    server_ = "127.0.0.1:" + std::to_string(port_);
+    root_ = base_ / "server";
+    StartServer();
+  }
+
+  void TearDown() override {
+    StopServer();
+    fs::remove_all(base_);
+  }
+
+  void StartServer() {
+    pid_ = fork();
+    if (pid_ == 0) {
+      ReplicaOptions options;
+      options.port = port_;
+      options.root = root_.string();
+      ReplicaServer server(options);
+      if (!server.Start()) _exit(1);
+      while (true) pause();
+    }
+    for (int i = 0; i < 200; ++i) {
+      ChainClient client;
+      if (client.Connect(server_)) return;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    FAIL() << "server did not start";
+  }
+
+  void StopServer() {
+    if (pid_ <= 0) return;
+    kill(pid_, SIGKILL);
+    waitpid(pid_, nullptr, 0);
+    pid_ = -1;
+  }
+
+  // 生成本地文件
+  fs::path WriteLocal(const std::string& name, size_t size, int seed) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = static_cast<char>((i * 131 + seed) % 251);
+    }
+    fs::path path = base_ / "local" / name;
+    std::ofstream(path, std::ios::binary) << data;
+    return path;
+  }
+
+  static std::string ReadFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+  }
+
+  fs::path base_;
+  fs::path root_;
+  int port_ = 0;
+  std::string server_;
+  pid_t pid_ = -1;
+};
+
+// ==================== DiskClient 测试 ====================
+
+// 测试大文件分块在多个连接上并行上传和下载
+TEST_F(DiskClientTest, ParallelChunkedTransfer) {
+  DiskClientOptions options;
+  options.connections = 4;
+  options.chunk_size = 1024 * 1024;
+  DiskClient client(options);
+  ASSERT_TRUE(client.Start());
+
+  fs::path local = WriteLocal("big.bin", 10 * 1024 * 1024 + 17, 1);
+  ASSERT_TRUE(client.Upload(server_, local.string(), "dir/big.bin"));
+  EXPECT_EQ(ReadFile(root_ / "dir/big.bin"), ReadFile(local));
+  // 没有留下临时文件(`big.bin.<上传ID>.part.tmp`)
+  for (const auto& entry : fs::directory_iterator(root_ / "dir")) {
+    EXPECT_EQ(entry.path().string().find(".part.tmp"), std::string::npos);
+  }
+  // 服务器校验CRC32C后保存了分块校验和
+  ChunkCrc chunks;
+  ASSERT_TRUE(
+      chunks.Load(ChunkCrc::SidecarPath((root_ / "dir/big.bin").string())));
+  EXPECT_EQ(chunks.total_size(), static_cast<long long>(fs::file_size(local)));
+
+  fs::path copy = base_ / "local" / "copy.bin";
+  ASSERT_TRUE(client.Download(server_, "dir/big.bin", copy.string()));
+  EXPECT_EQ(ReadFile(copy), ReadFile(local));
+
+  DiskClientStats stats = client.stats();
+  EXPECT_EQ(stats.connects, 4);
+  // 11块上传 + 提交 + 11块下载
+  EXPECT_EQ(stats.requests, 23);
+  EXPECT_EQ(stats.bytes_sent, static_cast<long long>(fs::file_size(local)));
+  EXPECT_EQ(stats.bytes_received, stats.bytes_sent);
+  EXPECT_EQ(stats.failures, 0);
+}
+
+// 测试下载时协商压缩: 服务器压缩发送, 客户端解码写入本地文件
+TEST_F(DiskClientTest, CompressedDownload) {
+  DiskClientOptions options;
+  options.connections = 2;
+  options.chunk_size = 1024 * 1024;
+  options.codecs = "zlib";
+  DiskClient client(options);
+  ASSERT_TRUE(client.Start());
+
+  // 熵低的文本数据, 压缩后明显变小
+  std::string data;
+  for (int i = 0; data.size() < 3 * 1024 * 1024; ++i) {
+    data += "record " + std::to_string(i) + ": downloaded text\n";
+  }
+  fs::path local = base_ / "local" / "z.bin";
+  std::ofstream(local, std::ios::binary) << data;
+  ASSERT_TRUE(client.Upload(server_, local.string(), "z.bin"));
+  fs::path copy = base_ / "local" / "z.copy";
+  ASSERT_TRUE(client.Download(server_, "z.bin", copy.string()));
+  EXPECT_EQ(ReadFile(copy), ReadFile(local));
+
+  DiskClientStats stats = client.stats();
+  EXPECT_EQ(stats.bytes_received,
+            static_cast<long long>(fs::file_size(local)));
+  EXPECT_GT(stats.compressed_bytes, 0);
+  EXPECT_LT(stats.compressed_bytes, stats.bytes_received);
+  EXPECT_EQ(stats.failures, 0);
+}
+
+// 测试大量小文件的请求在连接池上流水线发送
+TEST_F(DiskClientTest, PipelinedSmallFiles) {
+  DiskClientOptions options;
+  options.connections = 2;
+  options.pipeline_depth = 16;
+  DiskClient client(options);
+  ASSERT_TRUE(client.Start());
+
+  const int kFiles = 200;
+  std::atomic<int> pending(kFiles);
+  std::atomic<int> failed(0);
+  std::promise<void> all_done;
+  for (int i = 0; i < kFiles; ++i) {
+    fs::path local = WriteLocal("f" + std::to_string(i), 100 + i, i);
+    client.Upload(server_, local.string(), "small/f" + std::to_string(i),
+                  [&](bool ok) {
+                    if (!ok) ++failed;
+                    if (--pending == 0) all_done.set_value();
+                  });
+  }
+  all_done.get_future().wait();
+  EXPECT_EQ(failed, 0);
+  for (int i = 0; i < kFiles; ++i) {
+    std::string name = "f" + std::to_string(i);
+    EXPECT_EQ(ReadFile(root_ / "small" / name),
+              ReadFile(base_ / "local" / name));
+  }
+  EXPECT_EQ(client.stats().connects, 2);
+}
+
+// 测试空文件和不存在的文件, 失败后连接继续可用
+TEST_F(DiskClientTest, EmptyAndMissingFiles) {
+  DiskClient client;
+  ASSERT_TRUE(client.Start());
+  fs::path empty = WriteLocal("empty", 0, 0);
+  ASSERT_TRUE(client.Upload(server_, empty.string(), "empty"));
+  EXPECT_TRUE(fs::exists(root_ / "empty"));
+  EXPECT_EQ(fs::file_size(root_ / "empty"), 0u);
+
+  fs::path copy = base_ / "local" / "copy";
+  std::ofstream(copy) << "old content";
+  ASSERT_TRUE(client.Download(server_, "empty", copy.string()));
+  EXPECT_EQ(fs::file_size(copy), 0u);
+
+  EXPECT_FALSE(client.Download(server_, "missing", copy.string()));
+  EXPECT_FALSE(client.Upload(server_, (base_ / "nope").string(), "x"));
+  EXPECT_FALSE(client.Upload(server_, empty.string(), "../escape"));
+  fs::path small = WriteLocal("small", 10, 3);
+  EXPECT_TRUE(client.Upload(server_, small.string(), "small"));
+  EXPECT_LE(client.stats().connects, 4);
+}
+
+// 测试服务器重启后连接池重新建立连接
+TEST_F(DiskClientTest, ReconnectsAfterServerRestart) {
+  DiskClientOptions options;
+  options.connections = 1;
+  DiskClient client(options);
+  ASSERT_TRUE(client.Start());
+  fs::path local = WriteLocal("a", 1000, 1);
+  ASSERT_TRUE(client.Upload(server_, local.string(), "a"));
+
+  StopServer();
+  EXPECT_FALSE(client.Upload(server_, local.string(), "b"));
+  StartServer();
+  ASSERT_TRUE(client.Upload(server_, local.string(), "b"));
+  EXPECT_EQ(ReadFile(root_ / "b"), ReadFile(local));
+  EXPECT_GE(client.stats().connects, 2);
+}
@@ -0,0 +1,311 @@
+﻿// disk_set_test.cpp
+// DiskSet 类单元测试
+
+#include "include/disk_set.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 创建包含多个数据目录的测试环境
+class DiskSetTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = fs::temp_directory_path() / "disk_set_test";
+    fs::remove_all(root_);
+    for (int i = 0; i < 4; ++i) {
+      disks_.push_back((root_ / ("disk" + std::to_string(i))).string());
+    }
+  }
+
+  void TearDown() override { fs::remove_all(root_); }
+
+  // 同步写入
+  static bool WriteSync(DiskSet& set, const std::string& name,
+                        const std::string& data) {
+    std::promise<bool> done;
+    auto future = done.get_future();
+    if (!set.Write(name, std::make_shared<std::string>(data), nullptr,
+                   [&](bool ok) { done.set_value(ok); })) {
+      return false;
+    }
+    return future.get();
+  }
+
+  // 同步读取
+  static bool ReadSync(DiskSet& set, const std::string& name,
+                       std::string* data) {
+    std::promise<std::pair<bool, std::string>> done;
+    auto future = done.get_future();
+    if (!set.Read(name, nullptr, [&](bool ok, std::string content) {
+          done.set_value({ok, std::move(content)});
+        })) {
+      return false;
+    }
+    auto result = future.get();
+    *data = std::move(result.second);
+    return result.first;
+  }
+
+  static std::string Pattern(size_t len) {
+    std::string data(len, '\0');
+    for (size_t i = 0; i < len; ++i) data[i] = static_cast<char>(i * 31 + 7);
+    return data;
+  }
+
+  // 同步读取区间
+  static bool ReadRangeSync(DiskSet& set, const std::string& name,
+                            long long offset, long long length,
+                            std::string* data) {
+    std::promise<std::pair<bool, std::string>> done;
+    auto future = done.get_future();
+    if (!set.ReadRange(name, offset, length, nullptr,
+                       [&](bool ok, std::string content) {
+                         done.set_value({ok, std::move(content)});
+                       })) {
+      return false;
+    }
+    auto result = future.get();
+    *data = std::move(result.second);
+    return result.first;
+  }
+
+  // 同步写入区间
+  static bool WriteRangeSync(DiskSet& set, const std::string& name,
+                             long long offset, const std::string& data,
+                             bool last) {
+    std::promise<bool> done;
+    auto future = done.get_future();
+    if (!set.WriteRange(name, offset, std::make_shared<std::string>(data),
+                        last, nullptr, [&](bool ok) { done.set_value(ok); })) {
+      return false;
+    }
+    return future.get();
+  }
+
+  fs::path root_;
+  std::vector<std::string> disks_;
+};
+
+// ==================== DiskSet 测试 ====================
+
+// 测试小文件按一致性哈希分散到各磁盘
+TEST_F(DiskSetTest, SpreadsFilesAcrossDisks) {
+  DiskSet set(1024 * 1024, 1);
+  EXPECT_FALSE(set.Init());
+  for (auto& disk : disks_) ASSERT_TRUE(set.AddDisk(disk, 1.0));
+  EXPECT_FALSE(set.AddDisk(disks_[0]));
+  ASSERT_TRUE(set.Init());
+  EXPECT_FALSE(set.AddDisk((root_ / "late").string()));
+
+  std::set<int> used;
+  for (int i = 0; i < 40; ++i) {
+    std::string name = "dir/file" + std::to_string(i);
+    ASSERT_TRUE(WriteSync(set, name, "content " + std::to_string(i)));
+    int disk = set.Locate(name, 0);
+    used.insert(disk);
+    EXPECT_TRUE(fs::exists(fs::path(disks_[disk]) / name));
+  }
+  EXPECT_EQ(used.size(), 4u);
+
+  std::string data;
+  ASSERT_TRUE(ReadSync(set, "dir/file7", &data));
+  EXPECT_EQ(data, "content 7");
+  EXPECT_FALSE(ReadSync(set, "dir/missing", &data));
+  EXPECT_FALSE(set.Write("../escape", std::make_shared<std::string>("x"),
+                         nullptr, [](bool) {}));
+}
+
+// 测试大文件按条带切分到多块磁盘并还原
+TEST_F(DiskSetTest, StripesLargeFiles) {
+  const long long stripe = 64 * 1024;
+  DiskSet set(stripe, 2);
+  for (auto& disk : disks_) set.AddDisk(disk);
+  ASSERT_TRUE(set.Init());
+
+  std::string data = Pattern(stripe * 10 + 123);
+  ASSERT_TRUE(WriteSync(set, "big.bin", data));
+  std::set<int> used;
+  for (int i = 0; i < 11; ++i) {
+    used.insert(set.Locate("big.bin", i));
+    EXPECT_TRUE(fs::exists(set.StripePath("big.bin", i)));
+  }
+  EXPECT_GT(used.size(), 1u);
+
+  long long size = 0;
+  ASSERT_TRUE(set.Stat("big.bin", &size));
+  EXPECT_EQ(size, static_cast<long long>(data.size()));
+  std::string read;
+  ASSERT_TRUE(ReadSync(set, "big.bin", &read));
+  EXPECT_EQ(read, data);
+
+  // 覆盖为较短的内容后删除多余的条带
+  std::string shorter = Pattern(stripe * 2);
+  ASSERT_TRUE(WriteSync(set, "big.bin", shorter));
+  EXPECT_FALSE(fs::exists(set.StripePath("big.bin", 2)));
+  ASSERT_TRUE(ReadSync(set, "big.bin", &read));
+  EXPECT_EQ(read, shorter);
+
+  EXPECT_TRUE(set.Remove("big.bin"));
+  EXPECT_FALSE(set.Stat("big.bin", &size));
+  EXPECT_FALSE(set.Remove("big.bin"));
+}
+
+// 测试条带保存在保留目录中, 不会与名称相近的文件冲突
+TEST_F(DiskSetTest, StripesDoNotCollideWithFiles) {
+  const long long stripe = 16 * 1024;
+  DiskSet set(stripe, 1);
+  for (auto& disk : disks_) set.AddDisk(disk);
+  ASSERT_TRUE(set.Init());
+
+  std::string big = Pattern(stripe * 3);
+  ASSERT_TRUE(WriteSync(set, "a.bin", big));
+  ASSERT_TRUE(WriteSync(set, "a.bin.stripe1", "user file"));
+  ASSERT_TRUE(WriteSync(set, "a.bin.tmp.1", "another"));
+  std::string read;
+  ASSERT_TRUE(ReadSync(set, "a.bin", &read));
+  EXPECT_EQ(read, big);
+  ASSERT_TRUE(ReadSync(set, "a.bin.stripe1", &read));
+  EXPECT_EQ(read, "user file");
+  ASSERT_TRUE(set.Remove("a.bin"));
+  ASSERT_TRUE(ReadSync(set, "a.bin.stripe1", &read));
+  EXPECT_EQ(read, "user file");
+
+  // 保留目录中的名称被拒绝
+  EXPECT_FALSE(set.Write(".diskset/stripe1/a.bin",
+                         std::make_shared<std::string>("x"), nullptr,
+                         [](bool) {}));
+  long long size = 0;
+  EXPECT_FALSE(set.Stat(".diskset/tmp", &size));
+}
+
+// 测试按区间分段写入和读取, 只读取区间涉及的条带
+TEST_F(DiskSetTest, RangeReadsAndWrites) {
+  const long long stripe = 16 * 1024;
+  DiskSet set(stripe, 2);
+  for (auto& disk : disks_) set.AddDisk(disk);
+  ASSERT_TRUE(set.Init());
+
+  std::string data = Pattern(stripe * 5 + 77);
+  // 不对齐的区间被拒绝
+  EXPECT_FALSE(set.WriteRange("r.bin", 10, std::make_shared<std::string>("x"),
+                              true, nullptr, [](bool) {}));
+  EXPECT_FALSE(set.WriteRange("r.bin", 0, std::make_shared<std::string>("x"),
+                              false, nullptr, [](bool) {}));
+  // 分两段写入
+  ASSERT_TRUE(WriteRangeSync(set, "r.bin", 0, data.substr(0, stripe * 2),
+                             false));
+  ASSERT_TRUE(WriteRangeSync(set, "r.bin", stripe * 2,
+                             data.substr(stripe * 2), true));
+  long long size = 0;
+  ASSERT_TRUE(set.Stat("r.bin", &size));
+  EXPECT_EQ(size, static_cast<long long>(data.size()));
+
+  long long reads = 0;
+  for (auto& stats : set.stats()) reads += stats.reads;
+  std::string read;
+  // 跨越两个条带的区间
+  ASSERT_TRUE(ReadRangeSync(set, "r.bin", stripe - 10, 30, &read));
+  EXPECT_EQ(read, data.substr(stripe - 10, 30));
+  long long after = 0;
+  for (auto& stats : set.stats()) after += stats.reads;
+  EXPECT_EQ(after - reads, 2);
+  // 超出文件末尾的部分被截断
+  ASSERT_TRUE(ReadRangeSync(set, "r.bin", stripe * 5, 1000, &read));
+  EXPECT_EQ(read, data.substr(stripe * 5));
+  ASSERT_TRUE(ReadRangeSync(set, "r.bin", size + 5, 10, &read));
+  EXPECT_TRUE(read.empty());
+  ASSERT_TRUE(ReadSync(set, "r.bin", &read));
+  EXPECT_EQ(read, data);
+
+  // 较短的最后一段删除多余的条带
+  ASSERT_TRUE(WriteRangeSync(set, "r.bin", stripe, "tail", true));
+  ASSERT_TRUE(ReadSync(set, "r.bin", &read));
+  EXPECT_EQ(read, data.substr(0, stripe) + "tail");
+  EXPECT_FALSE(fs::exists(set.StripePath("r.bin", 2)));
+}
+
+// 测试一块磁盘的队列阻塞时不影响其它磁盘
+TEST_F(DiskSetTest, SlowDiskDoesNotBlockOthers) {
+  DiskSet set(0, 1);
+  for (auto& disk : disks_) set.AddDisk(disk, 1.0);
+  ASSERT_TRUE(set.Init());
+
+  // 找到两个位于不同磁盘的文件
+  std::string slow_name = "slow";
+  int slow_disk = set.Locate(slow_name, 0);
+  std::string fast_name;
+  for (int i = 0; fast_name.empty(); ++i) {
+    std::string name = "fast" + std::to_string(i);
+    if (set.Locate(name, 0) != slow_disk) fast_name = name;
+  }
+
+  // 占住慢盘的I/O线程
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool release = false;
+  ASSERT_TRUE(set.Submit(
+      slow_disk,
+      [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] { return release; });
+      },
+      nullptr, nullptr));
+
+  std::atomic<bool> slow_done{false};
+  ASSERT_TRUE(set.Write(slow_name, std::make_shared<std::string>("slow"),
+                        nullptr, [&](bool) { slow_done = true; }));
+  // 其它磁盘上的文件照常完成
+  ASSERT_TRUE(WriteSync(set, fast_name, "fast"));
+  EXPECT_FALSE(slow_done);
+  EXPECT_EQ(set.stats()[slow_disk].pending, 1);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    release = true;
+  }
+  cond.notify_all();
+  set.Stop();
+  EXPECT_TRUE(slow_done);
+}
+
+// 测试每块磁盘的吞吐量和延迟统计
+TEST_F(DiskSetTest, PerDiskMetrics) {
+  DiskSet set(16 * 1024, 1);
+  for (auto& disk : disks_) set.AddDisk(disk);
+  ASSERT_TRUE(set.Init());
+
+  std::string data = Pattern(16 * 1024 * 8);
+  ASSERT_TRUE(WriteSync(set, "metrics.bin", data));
+  std::string read;
+  ASSERT_TRUE(ReadSync(set, "metrics.bin", &read));
+
+  long long writes = 0, reads = 0, write_bytes = 0, read_bytes = 0;
+  for (auto& stats : set.stats()) {
+    EXPECT_GT(stats.weight, 0);
+    writes += stats.writes;
+    reads += stats.reads;
+    write_bytes += stats.write_bytes;
+    read_bytes += stats.read_bytes;
+    EXPECT_EQ(stats.errors, 0);
+    if (stats.writes + stats.reads > 0) {
+      EXPECT_GE(stats.max_latency_us, 0);
+      EXPECT_LE(stats.avg_latency_us(), stats.max_latency_us);
+    }
+  }
+  EXPECT_EQ(writes, 8);
+  EXPECT_EQ(reads, 8);
+  EXPECT_EQ(write_bytes, static_cast<long long>(data.size()));
+  EXPECT_EQ(read_bytes, static_cast<long long>(data.size()));
+}
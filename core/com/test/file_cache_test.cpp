@@ -0,0 +1,142 @@
+﻿// file_cache_test.cpp
+// FileCache 类单元测试
+
+#include "include/file_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace crossocean;
+
+// 写入测试文件
+static void WriteFile(const std::string& path, const std::string& content) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out << content;
+}
+
+// ==================== FileCache 测试 ====================
+
+// 测试重复打开复用同一个描述符
+TEST(FileCacheTest, ReuseOpenFile) {
+  std::string path = "file_cache_test_reuse.txt";
+  WriteFile(path, "hello");
+
+  FileCache cache(8);
+  OpenFilePtr file1 = cache.Open(path);
+  ASSERT_NE(file1, nullptr);
+  EXPECT_EQ(file1->size, 5);
+  EXPECT_GE(file1->fd, 0);
+
+  OpenFilePtr file2 = cache.Open(path);
+  EXPECT_EQ(file1, file2);
+
+  FileCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.cached, 1);
+
+  std::remove(path.c_str());
+}
+
+// 测试打开不存在的文件
+TEST(FileCacheTest, MissingFile) {
+  FileCache cache(8);
+  EXPECT_EQ(cache.Open("file_cache_test_missing.txt"), nullptr);
+  EXPECT_EQ(cache.stats().cached, 0);
+}
+
+// 测试主动失效后重新打开
+TEST(FileCacheTest, Invalidate) {
+  std::string path = "file_cache_test_invalidate.txt";
+  WriteFile(path, "old");
+
+  FileCache cache(8);
+  OpenFilePtr old_file = cache.Open(path);
+  ASSERT_NE(old_file, nullptr);
+
+  WriteFile(path, "new content");
+  cache.Invalidate(path);
+  OpenFilePtr new_file = cache.Open(path);
+  ASSERT_NE(new_file, nullptr);
+  EXPECT_NE(old_file, new_file);
+  EXPECT_EQ(new_file->size, 11);
+  EXPECT_NE(old_file->file_id, new_file->file_id);
+
+  std::remove(path.c_str());
+}
+
+// 测试其它路径的失效不影响正在打开的文件放入缓存
+TEST(FileCacheTest, InvalidateOtherPath) {
+  std::string path = "file_cache_test_busy.txt";
+  std::string other = "file_cache_test_other.txt";
+  WriteFile(path, "busy");
+
+  FileCache cache(8);
+  std::atomic<bool> stop{false};
+  std::thread invalidator([&]() {
+    while (!stop) cache.Invalidate(other);
+  });
+  for (int i = 0; i < 200; ++i) ASSERT_NE(cache.Open(path), nullptr);
+  stop = true;
+  invalidator.join();
+
+  FileCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.hits, 199);
+  EXPECT_EQ(stats.cached, 1);
+
+  std::remove(path.c_str());
+}
+
+// 测试其它进程修改文件后通过重新`stat`发现
+TEST(FileCacheTest, RevalidateOutOfBandChange) {
+  std::string path = "file_cache_test_revalidate.txt";
+  WriteFile(path, "abc");
+
+  // 每次打开都重新校验
+  FileCache cache(8, 0);
+  OpenFilePtr file1 = cache.Open(path);
+  ASSERT_NE(file1, nullptr);
+  EXPECT_EQ(cache.Open(path), file1);
+
+  WriteFile(path, "abcdef");
+  OpenFilePtr file2 = cache.Open(path);
+  ASSERT_NE(file2, nullptr);
+  EXPECT_NE(file1, file2);
+  EXPECT_EQ(file2->size, 6);
+  EXPECT_GE(cache.stats().revalidations, 2);
+
+  std::remove(path.c_str());
+}
+
+// 测试描述符预算淘汰, 仍被持有的文件保持可用
+TEST(FileCacheTest, FdBudget) {
+  FileCache cache(2);
+  std::string paths[3] = {"file_cache_test_a.txt", "file_cache_test_b.txt",
+                          "file_cache_test_c.txt"};
+  for (auto& path : paths) WriteFile(path, path);
+
+  OpenFilePtr held = cache.Open(paths[0]);
+  ASSERT_NE(held, nullptr);
+  cache.Open(paths[1]);
+  cache.Open(paths[2]);
+
+  FileCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.cached, 2);
+  EXPECT_EQ(stats.evictions, 1);
+
+  // 被淘汰但仍被持有的文件描述符没有关闭
+  EXPECT_GE(held->fd, 0);
+  EXPECT_EQ(held->size, static_cast<long long>(paths[0].size()));
+
+  // 再次打开需要重新`open`
+  OpenFilePtr reopened = cache.Open(paths[0]);
+  EXPECT_NE(reopened, held);
+
+  for (auto& path : paths) std::remove(path.c_str());
+}
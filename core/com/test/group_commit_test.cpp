@@ -0,0 +1,161 @@
+﻿// group_commit_test.cpp
+// GroupCommitter 类单元测试
+
+#include "include/group_commit.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "include/blocking_pool.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 等待条件成立, 最多等待 timeout_ms 毫秒
+template <typename Pred>
+static bool WaitFor(Pred pred, int timeout_ms) {
+  for (int i = 0; i < timeout_ms / 5 && !pred(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return pred();
+}
+
+// 打开测试文件并写入数据
+static int OpenAndWrite(const fs::path& path, size_t len) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  std::string data(len, 'x');
+  EXPECT_EQ(write(fd, data.data(), data.size()),
+            static_cast<ssize_t>(data.size()));
+  return fd;
+}
+
+// ==================== GroupCommitter 测试 ====================
+
+// 测试窗口内的请求合并为一组, 每个文件只落盘一次
+TEST(GroupCommitterTest, GroupsConcurrentCommits) {
+  fs::path path_a = fs::temp_directory_path() / "group_commit_test_a.bin";
+  fs::path path_b = fs::temp_directory_path() / "group_commit_test_b.bin";
+  int fd_a = OpenAndWrite(path_a, 10 * 4096);
+  int fd_b = OpenAndWrite(path_b, 4096);
+
+  BlockingPool pool;
+  pool.Init(1);
+  std::atomic<int> acked{0};
+  {
+    GroupCommitter committer(&pool, 100);
+    for (int i = 0; i < 10; ++i) {
+      committer.Commit(fd_a, i * 4096, 4096, Durability::kGroup, nullptr,
+                       [&](bool ok) {
+                         if (ok) ++acked;
+                       });
+    }
+    committer.Commit(fd_b, 0, 4096, Durability::kGroup, nullptr,
+                     [&](bool ok) {
+                       if (ok) ++acked;
+                     });
+    // 窗口结束前不确认
+    EXPECT_EQ(acked, 0);
+    ASSERT_TRUE(WaitFor([&] { return acked == 11; }, 2000));
+
+    GroupCommitStats stats = committer.stats();
+    EXPECT_EQ(stats.commits, 11);
+    EXPECT_EQ(stats.groups, 1);
+    EXPECT_EQ(stats.syncs, 2);
+    EXPECT_EQ(stats.failures, 0);
+  }
+  pool.Stop();
+  close(fd_a);
+  close(fd_b);
+  fs::remove(path_a);
+  fs::remove(path_b);
+}
+
+// 测试累计字节数达到阈值或调用 Flush 时立即落盘
+TEST(GroupCommitterTest, ByteThresholdAndFlush) {
+  fs::path path = fs::temp_directory_path() / "group_commit_test_bytes.bin";
+  int fd = OpenAndWrite(path, 8192);
+
+  std::atomic<int> acked{0};
+  // 窗口很长, 只能由阈值或 Flush 触发落盘
+  GroupCommitter committer(nullptr, 60 * 1000, 6000);
+  auto on_done = [&](bool ok) {
+    if (ok) ++acked;
+  };
+  committer.Commit(fd, 0, 4096, Durability::kGroup, nullptr, on_done);
+  committer.Commit(fd, 4096, 4096, Durability::kGroup, nullptr, on_done);
+  EXPECT_TRUE(WaitFor([&] { return acked == 2; }, 2000));
+
+  committer.Commit(fd, 0, 100, Durability::kGroup, nullptr, on_done);
+  committer.Flush();
+  EXPECT_TRUE(WaitFor([&] { return acked == 3; }, 2000));
+  EXPECT_EQ(committer.stats().groups, 2);
+  close(fd);
+  fs::remove(path);
+}
+
+// 测试不同的持久化级别和落盘失败的处理
+TEST(GroupCommitterTest, DurabilityLevels) {
+  fs::path path = fs::temp_directory_path() / "group_commit_test_levels.bin";
+  int fd = OpenAndWrite(path, 4096);
+
+  GroupCommitter committer(nullptr, 10);
+  // 不等待落盘时立即确认
+  bool none_acked = false;
+  committer.Commit(fd, 0, 4096, Durability::kNone, nullptr,
+                   [&](bool ok) { none_acked = ok; });
+  EXPECT_TRUE(none_acked);
+
+  // 立即落盘不参与合并
+  std::atomic<bool> immediate_acked{false};
+  committer.Commit(fd, 0, 4096, Durability::kImmediate, nullptr,
+                   [&](bool ok) { immediate_acked = ok; });
+  EXPECT_TRUE(immediate_acked);
+  EXPECT_EQ(committer.stats().groups, 0);
+  EXPECT_EQ(committer.stats().syncs, 1);
+
+  // 无效的文件描述符落盘失败
+  std::atomic<int> result{-1};
+  committer.Commit(-1, 0, 10, Durability::kGroup, nullptr,
+                   [&](bool ok) { result = ok ? 1 : 0; });
+  EXPECT_TRUE(WaitFor([&] { return result != -1; }, 2000));
+  EXPECT_EQ(result, 0);
+  EXPECT_EQ(committer.stats().failures, 1);
+  close(fd);
+  fs::remove(path);
+}
+
+// 测试销毁时等待线程池中还没完成的落盘, 所有请求都得到确认
+TEST(GroupCommitterTest, DestructorWaitsForPool) {
+  fs::path path = fs::temp_directory_path() / "group_commit_test_stop.bin";
+  int fd = OpenAndWrite(path, 4096);
+
+  BlockingPool pool;
+  pool.Init(1);
+  // 占住唯一的工作线程, 落盘排在它之后
+  pool.Submit(
+      [] { std::this_thread::sleep_for(std::chrono::milliseconds(100)); });
+  std::atomic<int> acked{0};
+  {
+    GroupCommitter committer(&pool, 1000);
+    for (int i = 0; i < 4; ++i) {
+      committer.Commit(fd, 0, 4096, Durability::kImmediate, nullptr,
+                       [&](bool ok) {
+                         if (ok) ++acked;
+                       });
+    }
+    committer.Commit(fd, 0, 4096, Durability::kGroup, nullptr,
+                     [&](bool ok) {
+                       if (ok) ++acked;
+                     });
+  }
+  EXPECT_EQ(acked, 5);
+  close(fd);
+  fs::remove(path);
+}
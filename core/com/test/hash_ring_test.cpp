@@ -0,0 +1,110 @@
+﻿// hash_ring_test.cpp
+// HashRing 类单元测试
+
+#include "include/hash_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <set>
+#include <string>
+
+using namespace crossocean;
+
+// 统计每个节点分到的键数量
+static std::map<std::string, int> Distribute(const HashRing& ring, int keys) {
+  std::map<std::string, int> counts;
+  for (int i = 0; i < keys; ++i) {
+    counts[*ring.Lookup("file-" + std::to_string(i))]++;
+  }
+  return counts;
+}
+
+// ==================== HashRing 测试 ====================
+
+// 测试空环和节点增删
+TEST(HashRingTest, AddAndRemoveNodes) {
+  HashRing ring(64);
+  EXPECT_EQ(ring.Lookup("key"), nullptr);
+  EXPECT_TRUE(ring.Lookup("key", 3).empty());
+
+  EXPECT_FALSE(ring.AddNode(""));
+  EXPECT_FALSE(ring.AddNode("a", 0));
+  EXPECT_TRUE(ring.AddNode("a"));
+  EXPECT_TRUE(ring.AddNode("b", 2.0));
+  EXPECT_EQ(ring.size(), 2);
+  EXPECT_EQ(ring.vnode_count(), 64 * 3);
+  EXPECT_TRUE(ring.Contains("b"));
+
+  // 已存在的节点更新权重
+  EXPECT_TRUE(ring.AddNode("b", 1.0));
+  EXPECT_EQ(ring.size(), 2);
+  EXPECT_EQ(ring.vnode_count(), 64 * 2);
+
+  EXPECT_TRUE(ring.RemoveNode("a"));
+  EXPECT_FALSE(ring.RemoveNode("a"));
+  EXPECT_EQ(*ring.Lookup("key"), "b");
+}
+
+// 测试键均匀分布, 且按权重分配
+TEST(HashRingTest, WeightedDistribution) {
+  HashRing ring;
+  for (int i = 0; i < 4; ++i) ring.AddNode("disk" + std::to_string(i));
+  auto counts = Distribute(ring, 40000);
+  ASSERT_EQ(counts.size(), 4u);
+  for (auto& item : counts) {
+    EXPECT_GT(item.second, 10000 * 0.8) << item.first;
+    EXPECT_LT(item.second, 10000 * 1.2) << item.first;
+  }
+
+  // 权重为2的节点分到约两倍的键
+  ring.AddNode("big", 2.0);
+  counts = Distribute(ring, 60000);
+  double ratio = static_cast<double>(counts["big"]) / counts["disk0"];
+  EXPECT_GT(ratio, 1.5);
+  EXPECT_LT(ratio, 2.6);
+}
+
+// 测试增删节点时只有少量键改变归属
+TEST(HashRingTest, MinimalMovement) {
+  HashRing ring;
+  for (int i = 0; i < 8; ++i) ring.AddNode("node" + std::to_string(i));
+  const int keys = 20000;
+  std::map<int, std::string> before;
+  for (int i = 0; i < keys; ++i) {
+    before[i] = *ring.Lookup("key" + std::to_string(i));
+  }
+
+  ring.AddNode("node8");
+  int moved = 0;
+  for (int i = 0; i < keys; ++i) {
+    const std::string& owner = *ring.Lookup("key" + std::to_string(i));
+    if (owner != before[i]) {
+      // 改变归属的键只会移动到新节点
+      EXPECT_EQ(owner, "node8");
+      ++moved;
+    }
+  }
+  // 约1/9的键移动
+  EXPECT_GT(moved, keys / 9 / 2);
+  EXPECT_LT(moved, keys / 9 * 2);
+
+  // 删除新节点后恢复原来的归属
+  ring.RemoveNode("node8");
+  for (int i = 0; i < keys; ++i) {
+    EXPECT_EQ(*ring.Lookup("key" + std::to_string(i)), before[i]);
+  }
+}
+
+// 测试查找多个不同节点
+TEST(HashRingTest, LookupReplicas) {
+  HashRing ring;
+  for (int i = 0; i < 5; ++i) ring.AddNode("node" + std::to_string(i));
+  auto owners = ring.Lookup("object", 3);
+  ASSERT_EQ(owners.size(), 3u);
+  EXPECT_EQ(std::set<std::string>(owners.begin(), owners.end()).size(), 3u);
+  // 第一个节点就是归属节点
+  EXPECT_EQ(owners[0], *ring.Lookup("object"));
+  // 节点不足时返回全部节点
+  EXPECT_EQ(ring.Lookup("object", 10).size(), 5u);
+}
@@ -0,0 +1,260 @@
+﻿// memory_budget_test.cpp
+// MemoryBudget 类单元测试
+
+#include "include/memory_budget.h"
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/block_cache.h"
+#include "include/frame.h"
+#include "include/replication.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 等待条件成立
+template <typename F>
+static bool WaitFor(F condition) {
+  for (int i = 0; i < 500; ++i) {
+    if (condition()) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return condition();
+}
+
+// 连接本机端口, 失败返回-1
+static int ConnectLocal(int port) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+// 读取指定字节数
+static bool ReadFull(int sock, char* data, size_t size) {
+  while (size > 0) {
+    ssize_t len = recv(sock, data, size, 0);
+    if (len <= 0) return false;
+    data += len;
+    size -= static_cast<size_t>(len);
+  }
+  return true;
+}
+
+// ==================== MemoryBudget 测试 ====================
+
+// 测试按用途和工作线程记账, 记录峰值
+TEST(MemoryBudgetTest, ChargeAndGauges) {
+  MemoryBudget budget(0, 2);
+  budget.Charge(MemoryCategory::kTask, 1, 100);
+  budget.Charge(MemoryCategory::kBuffer, 2, 1000);
+  budget.Charge(MemoryCategory::kCache, 0, 500);
+  // 超出范围的线程编号记到0
+  budget.Charge(MemoryCategory::kBuffer, 7, 10);
+
+  MemoryStats stats = budget.stats();
+  EXPECT_EQ(stats.used, 1610);
+  EXPECT_EQ(stats.categories[static_cast<int>(MemoryCategory::kTask)], 100);
+  EXPECT_EQ(stats.categories[static_cast<int>(MemoryCategory::kBuffer)],
+            1010);
+  EXPECT_EQ(stats.categories[static_cast<int>(MemoryCategory::kCache)], 500);
+  ASSERT_EQ(stats.workers.size(), 3u);
+  EXPECT_EQ(stats.workers[0], 510);
+  EXPECT_EQ(stats.workers[1], 100);
+  EXPECT_EQ(stats.workers[2], 1000);
+
+  budget.Charge(MemoryCategory::kBuffer, 2, -1000);
+  stats = budget.stats();
+  EXPECT_EQ(stats.used, 610);
+  EXPECT_EQ(stats.peak, 1610);
+  EXPECT_EQ(stats.workers[2], 0);
+  EXPECT_FALSE(budget.over_limit());
+}
+
+// 测试超出预算时调用回收函数, 注销后不再调用
+TEST(MemoryBudgetTest, ReclaimWhenOverLimit) {
+  MemoryBudget budget(1000, 1);
+  long long requested = 0;
+  int id = budget.AddReclaimer([&](long long bytes) {
+    requested = bytes;
+    budget.Charge(MemoryCategory::kCache, 0, -bytes);
+    return bytes;
+  });
+
+  budget.Charge(MemoryCategory::kCache, 0, 800);
+  EXPECT_EQ(requested, 0);
+  budget.Charge(MemoryCategory::kBuffer, 1, 500);
+  EXPECT_EQ(requested, 300);
+  EXPECT_EQ(budget.used(), 1000);
+  EXPECT_FALSE(budget.over_limit());
+  EXPECT_EQ(budget.stats().reclaimed, 300);
+
+  budget.RemoveReclaimer(id);
+  budget.Charge(MemoryCategory::kBuffer, 1, 100);
+  EXPECT_EQ(requested, 300);
+  EXPECT_TRUE(budget.over_limit());
+}
+
+// 测试连接记账: 记录变化量, 销毁时释放
+TEST(MemoryBudgetTest, Account) {
+  MemoryBudget budget(0, 1);
+  {
+    MemoryAccount account;
+    account.Attach(&budget, MemoryCategory::kBuffer, 1, 100);
+    account.Update(60);
+    EXPECT_EQ(budget.used(), 60);
+    EXPECT_FALSE(account.over());
+    account.Update(150);
+    EXPECT_EQ(budget.stats().workers[1], 150);
+    EXPECT_TRUE(account.over());
+    account.Update(20);
+    EXPECT_EQ(budget.used(), 20);
+  }
+  EXPECT_EQ(budget.used(), 0);
+}
+
+// 测试缓存关联预算后占用记账, 超出预算时淘汰块
+TEST(MemoryBudgetTest, BlockCacheReclaim) {
+  const size_t kBlockSize = 1024;
+  MemoryBudget budget(64 * kBlockSize, 1);
+  // 一个工作线程的缓冲区占用一半预算
+  budget.Charge(MemoryCategory::kBuffer, 1, 32 * kBlockSize);
+  {
+    BlockCache cache(1024 * kBlockSize, kBlockSize, 4);
+    cache.set_memory_budget(&budget);
+    auto block = std::make_shared<CacheBlock>();
+    block->data.assign(kBlockSize, 'x');
+    for (uint64_t i = 0; i < 20; ++i) cache.Insert(1, i, block);
+    EXPECT_EQ(budget.stats().categories[static_cast<int>(
+                  MemoryCategory::kCache)],
+              static_cast<long long>(20 * kBlockSize));
+    EXPECT_EQ(budget.stats().reclaimed, 0);
+
+    // 缓存容量足够, 但超出全局预算后淘汰
+    for (uint64_t i = 20; i < 100; ++i) cache.Insert(1, i, block);
+    EXPECT_LE(budget.used(), budget.limit());
+    EXPECT_GT(budget.stats().reclaimed, 0);
+    EXPECT_EQ(cache.stats().bytes,
+              budget.stats().categories[static_cast<int>(
+                  MemoryCategory::kCache)]);
+
+    cache.Invalidate(1);
+    EXPECT_EQ(budget.used(), static_cast<long long>(32 * kBlockSize));
+    cache.Insert(2, 0, block);
+  }
+  // 缓存销毁时释放
+  EXPECT_EQ(budget.used(), static_cast<long long>(32 * kBlockSize));
+}
+
+// 测试读取慢的连接超出预算时暂停读取请求, 读取后恢复
+TEST(MemoryBudgetTest, SlowReaderPauses) {
+  fs::path root = fs::temp_directory_path() /
+                  ("memory_budget_test_" + std::to_string(getpid()));
+  fs::remove_all(root);
+  fs::create_directories(root);
+  const size_t kFileSize = 512 * 1024;
+  {
+    std::ofstream out(root / "data", std::ios::binary);
+    out << std::string(kFileSize, 'd');
+  }
+
+  ReplicaOptions options;
+  options.port = 20000 + (getpid() * 17) % 20000;
+  options.root = root.string();
+  options.threads = 1;
+  options.connection_memory = 1024 * 1024;
+  ReplicaServer server(options);
+  ASSERT_TRUE(server.Start());
+
+  int sock = ConnectLocal(options.port);
+  ASSERT_GE(sock, 0);
+  // 不读取回复, 连续发送读取请求
+  const int kRequests = 64;
+  std::string requests;
+  for (int i = 0; i < kRequests; ++i) {
+    FrameWriter writer;
+    writer.PutString("data");
+    writer.PutU64(0);
+    writer.PutU64(kFileSize);
+    requests += writer.Finish(FrameType::kReadAt, i + 1);
+  }
+  ASSERT_EQ(send(sock, requests.data(), requests.size(), 0),
+            static_cast<ssize_t>(requests.size()));
+  ASSERT_TRUE(WaitFor([&]() { return server.memory_stats().pauses > 0; }));
+  MemoryStats stats = server.memory_stats();
+  EXPECT_GT(stats.workers[1], 0);
+  EXPECT_GT(stats.categories[static_cast<int>(MemoryCategory::kTask)], 0);
+  // 暂停后待发送的数据不超过连接预算加一个回复
+  EXPECT_LE(stats.categories[static_cast<int>(MemoryCategory::kBuffer)],
+            options.connection_memory + static_cast<long long>(kFileSize) +
+                static_cast<long long>(requests.size()));
+
+  // 读取后恢复, 所有请求都得到回复
+  std::vector<char> body;
+  for (int i = 0; i < kRequests; ++i) {
+    char header[Frame::kHeaderSize];
+    ASSERT_TRUE(ReadFull(sock, header, sizeof(header)));
+    FrameType type;
+    uint32_t id = 0, body_size = 0;
+    ASSERT_TRUE(Frame::DecodeHeader(header, &type, &id, &body_size));
+    EXPECT_EQ(type, FrameType::kData);
+    EXPECT_EQ(id, static_cast<uint32_t>(i + 1));
+    ASSERT_EQ(body_size, 16 + kFileSize);
+    body.resize(body_size);
+    ASSERT_TRUE(ReadFull(sock, body.data(), body.size()));
+  }
+  close(sock);
+  EXPECT_TRUE(WaitFor([&]() { return server.memory_stats().used == 0; }));
+  fs::remove_all(root);
+}
+
+// 测试超出全局预算时拒绝新连接
+TEST(MemoryBudgetTest, ShedsWhenOverLimit) {
+  fs::path root = fs::temp_directory_path() /
+                  ("memory_budget_shed_" + std::to_string(getpid()));
+  fs::remove_all(root);
+  ReplicaOptions options;
+  options.port = 20000 + (getpid() * 17 + 1) % 20000;
+  options.root = root.string();
+  options.threads = 1;
+  options.memory_limit = 1024 * 1024;
+  ReplicaServer server(options);
+  ASSERT_TRUE(server.Start());
+
+  // 未超出预算时正常接入
+  int sock = ConnectLocal(options.port);
+  ASSERT_GE(sock, 0);
+  ASSERT_TRUE(WaitFor([&]() { return server.memory_stats().used > 0; }));
+  EXPECT_EQ(server.memory_stats().shed, 0);
+
+  // 其它子系统占满预算后拒绝新连接
+  server.memory()->Charge(MemoryCategory::kCache, 0, 2 * 1024 * 1024);
+  int rejected = ConnectLocal(options.port);
+  ASSERT_GE(rejected, 0);
+  char buffer[256];
+  while (recv(rejected, buffer, sizeof(buffer), 0) > 0) {
+  }
+  close(rejected);
+  EXPECT_TRUE(WaitFor([&]() { return server.memory_stats().shed > 0; }));
+  server.memory()->Charge(MemoryCategory::kCache, 0, -2 * 1024 * 1024);
+  close(sock);
+  fs::remove_all(root);
+}
@@ -0,0 +1,285 @@
+﻿// meta_index_test.cpp
+// MetaIndex 类单元测试
+
+#include "include/meta_index.h"
+
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/resource.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "include/blocking_pool.h"
+#include "include/sha256.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 创建索引目录
+class MetaIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = (fs::temp_directory_path() / "meta_index_test").string();
+    fs::remove_all(dir_);
+  }
+
+  void TearDown() override { fs::remove_all(dir_); }
+
+  // 生成测试元数据
+  static FileMeta MakeMeta(const std::string& path, int chunks) {
+    FileMeta meta;
+    meta.path = path;
+    meta.mtime_ns = 1700000000000000000LL + chunks;
+    meta.checksum = 0x12345678u + chunks;
+    for (int i = 0; i < chunks; ++i) {
+      ChunkRef chunk;
+      std::string content = path + "#" + std::to_string(i);
+      chunk.hash = Sha256::Hex(content.data(), content.size());
+      chunk.length = 4096 + i;
+      meta.chunks.push_back(chunk);
+      meta.size += chunk.length;
+    }
+    return meta;
+  }
+
+  static void ExpectEqual(const FileMeta& a, const FileMeta& b) {
+    EXPECT_EQ(a.path, b.path);
+    EXPECT_EQ(a.size, b.size);
+    EXPECT_EQ(a.mtime_ns, b.mtime_ns);
+    EXPECT_EQ(a.checksum, b.checksum);
+    ASSERT_EQ(a.chunks.size(), b.chunks.size());
+    long long offset = 0;
+    for (size_t i = 0; i < a.chunks.size(); ++i) {
+      EXPECT_EQ(a.chunks[i].hash, b.chunks[i].hash);
+      EXPECT_EQ(a.chunks[i].length, b.chunks[i].length);
+      EXPECT_EQ(b.chunks[i].offset, offset);
+      offset += b.chunks[i].length;
+    }
+  }
+
+  std::string dir_;
+};
+
+// ==================== MetaIndex 测试 ====================
+
+// 测试添加、查找、替换和删除
+TEST_F(MetaIndexTest, PutLookupRemove) {
+  MetaIndex index(dir_);
+  ASSERT_TRUE(index.Open());
+  EXPECT_EQ(index.size(), 0);
+
+  FileMeta meta = MakeMeta("a/b.txt", 3);
+  ASSERT_TRUE(index.Put(meta));
+  FileMeta found;
+  ASSERT_TRUE(index.Lookup("a/b.txt", &found));
+  ExpectEqual(meta, found);
+  EXPECT_FALSE(index.Lookup("a/c.txt", &found));
+
+  // 替换不增加数量
+  FileMeta updated = MakeMeta("a/b.txt", 5);
+  ASSERT_TRUE(index.Put(updated));
+  EXPECT_EQ(index.size(), 1);
+  ASSERT_TRUE(index.Lookup("a/b.txt", &found));
+  ExpectEqual(updated, found);
+
+  ASSERT_TRUE(index.Remove("a/b.txt"));
+  EXPECT_FALSE(index.Lookup("a/b.txt", &found));
+  EXPECT_EQ(index.size(), 0);
+  EXPECT_TRUE(index.Remove("a/b.txt"));
+
+  // 非法的块哈希
+  FileMeta bad = MakeMeta("bad", 1);
+  bad.chunks[0].hash = "xyz";
+  EXPECT_FALSE(index.Put(bad));
+  EXPECT_FALSE(index.Put(FileMeta()));
+}
+
+// 测试重启时重放变更日志
+TEST_F(MetaIndexTest, ReopenReplaysLog) {
+  {
+    MetaIndex index(dir_, nullptr, 0);
+    ASSERT_TRUE(index.Open());
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_TRUE(index.Put(MakeMeta("file" + std::to_string(i), i % 4)));
+    }
+    ASSERT_TRUE(index.Remove("file7"));
+    ASSERT_TRUE(index.Sync());
+  }
+
+  MetaIndex index(dir_, nullptr, 0);
+  ASSERT_TRUE(index.Open());
+  EXPECT_EQ(index.stats().replayed, 101);
+  EXPECT_EQ(index.size(), 99);
+  FileMeta found;
+  ASSERT_TRUE(index.Lookup("file42", &found));
+  ExpectEqual(MakeMeta("file42", 2), found);
+  EXPECT_FALSE(index.Lookup("file7", &found));
+}
+
+// 测试合并为快照后重启直接映射快照, 不再重放
+TEST_F(MetaIndexTest, CompactToMappedSnapshot) {
+  {
+    MetaIndex index(dir_, nullptr, 0);
+    ASSERT_TRUE(index.Open());
+    for (int i = 0; i < 1000; ++i) {
+      ASSERT_TRUE(index.Put(MakeMeta("dir/" + std::to_string(i), i % 3)));
+    }
+    ASSERT_TRUE(index.Compact());
+    MetaIndexStats stats = index.stats();
+    EXPECT_EQ(stats.snapshot_records, 1000);
+    EXPECT_EQ(stats.log_records, 0);
+    EXPECT_EQ(stats.compactions, 1);
+
+    // 合并后的修改写入新日志
+    ASSERT_TRUE(index.Remove("dir/10"));
+    ASSERT_TRUE(index.Put(MakeMeta("dir/20", 7)));
+    ASSERT_TRUE(index.Put(MakeMeta("new", 1)));
+  }
+
+  MetaIndex index(dir_, nullptr, 0);
+  ASSERT_TRUE(index.Open());
+  EXPECT_EQ(index.stats().snapshot_records, 1000);
+  EXPECT_EQ(index.stats().replayed, 3);
+  EXPECT_EQ(index.size(), 1000);
+  FileMeta found;
+  for (int i = 0; i < 1000; ++i) {
+    std::string path = "dir/" + std::to_string(i);
+    if (i == 10) {
+      EXPECT_FALSE(index.Lookup(path, &found));
+    } else if (i == 20) {
+      ASSERT_TRUE(index.Lookup(path, &found));
+      ExpectEqual(MakeMeta(path, 7), found);
+    } else {
+      ASSERT_TRUE(index.Lookup(path, &found)) << path;
+      ExpectEqual(MakeMeta(path, i % 3), found);
+    }
+  }
+  EXPECT_TRUE(index.Lookup("new", &found));
+
+  long long visited = 0;
+  index.ForEach([&](const FileMeta&) { ++visited; });
+  EXPECT_EQ(visited, 1000);
+}
+
+// 测试截断日志末尾写了一半的记录
+TEST_F(MetaIndexTest, TornLogTail) {
+  {
+    MetaIndex index(dir_, nullptr, 0);
+    ASSERT_TRUE(index.Open());
+    ASSERT_TRUE(index.Put(MakeMeta("kept", 2)));
+  }
+  fs::path log = fs::path(dir_) / "meta.log";
+  auto good_size = fs::file_size(log);
+  {
+    std::ofstream out(log, std::ios::binary | std::ios::app);
+    out.write("\x40\x00\x00\x00garbage", 11);
+  }
+
+  MetaIndex index(dir_, nullptr, 0);
+  ASSERT_TRUE(index.Open());
+  EXPECT_EQ(fs::file_size(log), good_size);
+  FileMeta found;
+  EXPECT_TRUE(index.Lookup("kept", &found));
+  ASSERT_TRUE(index.Put(MakeMeta("after", 1)));
+  EXPECT_TRUE(index.Lookup("after", &found));
+}
+
+// 测试日志达到阈值后在阻塞I/O线程池中合并, 合并期间照常读写
+TEST_F(MetaIndexTest, BackgroundCompaction) {
+  BlockingPool pool;
+  pool.Init(1);
+  {
+    MetaIndex index(dir_, &pool, 100);
+    ASSERT_TRUE(index.Open());
+    FileMeta found;
+    for (int i = 0; i < 1000; ++i) {
+      std::string path = "bg/" + std::to_string(i);
+      ASSERT_TRUE(index.Put(MakeMeta(path, 1)));
+      ASSERT_TRUE(index.Lookup(path, &found));
+      if (i % 10 == 0) {
+        ASSERT_TRUE(index.Remove(path));
+      }
+    }
+    index.WaitCompaction();
+    EXPECT_GE(index.stats().compactions, 1);
+    EXPECT_EQ(index.size(), 900);
+    // 合并剩余的日志
+    ASSERT_TRUE(index.Compact());
+    EXPECT_EQ(index.stats().log_records, 0);
+  }
+  pool.Stop();
+
+  MetaIndex index(dir_);
+  ASSERT_TRUE(index.Open());
+  EXPECT_EQ(index.size(), 900);
+  EXPECT_EQ(index.stats().replayed, 0);
+  FileMeta found;
+  EXPECT_TRUE(index.Lookup("bg/999", &found));
+  EXPECT_FALSE(index.Lookup("bg/990", &found));
+}
+
+// 测试合并中途崩溃(冻结日志未删除)后重启恢复
+TEST_F(MetaIndexTest, RecoverInterruptedCompaction) {
+  {
+    MetaIndex index(dir_, nullptr, 0);
+    ASSERT_TRUE(index.Open());
+    ASSERT_TRUE(index.Put(MakeMeta("a", 1)));
+    ASSERT_TRUE(index.Put(MakeMeta("b", 1)));
+    ASSERT_TRUE(index.Compact());
+    ASSERT_TRUE(index.Put(MakeMeta("c", 1)));
+    ASSERT_TRUE(index.Remove("a"));
+  }
+  // 日志已冻结但新快照还没有写入
+  fs::rename(fs::path(dir_) / "meta.log", fs::path(dir_) / "meta.log.old");
+  {
+    std::ofstream touch(fs::path(dir_) / "meta.log");
+  }
+
+  MetaIndex index(dir_, nullptr, 0);
+  ASSERT_TRUE(index.Open());
+  EXPECT_FALSE(fs::exists(fs::path(dir_) / "meta.log.old"));
+  EXPECT_EQ(index.stats().snapshot_records, 2);
+  EXPECT_EQ(index.size(), 2);
+  FileMeta found;
+  EXPECT_FALSE(index.Lookup("a", &found));
+  EXPECT_TRUE(index.Lookup("b", &found));
+  EXPECT_TRUE(index.Lookup("c", &found));
+}
+
+// 测试写入日志只写了一半后失败: 截断不完整的记录, 之后的记录重启后仍然存在
+TEST_F(MetaIndexTest, FailedAppendKeepsLaterRecords) {
+  MetaIndex index(dir_);
+  ASSERT_TRUE(index.Open());
+  ASSERT_TRUE(index.Put(MakeMeta("first", 1)));
+  long long size = static_cast<long long>(fs::file_size(
+      fs::path(dir_) / "meta.log"));
+
+  // 限制文件大小, 较大的记录只能写入一部分
+  signal(SIGXFSZ, SIG_IGN);
+  rlimit saved;
+  ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &saved), 0);
+  rlimit limited = saved;
+  limited.rlim_cur = static_cast<rlim_t>(size + 100);
+  ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limited), 0);
+  bool put = index.Put(MakeMeta("torn", 50));
+  ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &saved), 0);
+  signal(SIGXFSZ, SIG_DFL);
+  EXPECT_FALSE(put);
+  EXPECT_EQ(static_cast<long long>(
+                fs::file_size(fs::path(dir_) / "meta.log")),
+            size);
+
+  FileMeta later = MakeMeta("later", 2);
+  ASSERT_TRUE(index.Put(later));
+  ASSERT_TRUE(index.Sync());
+
+  MetaIndex reopened(dir_);
+  ASSERT_TRUE(reopened.Open());
+  FileMeta found;
+  EXPECT_TRUE(reopened.Lookup("first", &found));
+  EXPECT_FALSE(reopened.Lookup("torn", &found));
+  ASSERT_TRUE(reopened.Lookup("later", &found));
+  ExpectEqual(later, found);
+}
@@ -0,0 +1,118 @@
+﻿// rate_limiter_test.cpp
+// TokenBucket 和 RateLimiter 类单元测试
+
+#include "include/rate_limiter.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+using namespace crossocean;
+using namespace std::chrono;
+
+// ==================== TokenBucket 测试 ====================
+
+// 测试不限速的令牌桶
+TEST(TokenBucketTest, Unlimited) {
+  TokenBucket bucket(0, 0);
+  EXPECT_EQ(bucket.Acquire(1 << 30), 1 << 30);
+  EXPECT_EQ(bucket.Delay(1 << 30, TokenBucket::Clock::now()).count(), 0);
+}
+
+// 测试令牌消耗和按时间补充
+TEST(TokenBucketTest, AcquireAndRefill) {
+  TokenBucket bucket(1000, 500);
+  auto now = TokenBucket::Clock::now();
+
+  // 初始满桶, 最多允许突发 500 字节
+  EXPECT_EQ(bucket.Acquire(800, now), 500);
+  EXPECT_EQ(bucket.Acquire(100, now), 0);
+
+  // 100ms 后补充 100 字节
+  now += milliseconds(100);
+  EXPECT_EQ(bucket.Acquire(800, now), 100);
+
+  // 补充不会超过桶容量
+  now += seconds(10);
+  EXPECT_EQ(bucket.Acquire(800, now), 500);
+}
+
+// 测试等待时间计算和归还令牌
+TEST(TokenBucketTest, DelayAndRefund) {
+  TokenBucket bucket(1000, 1000);
+  auto now = TokenBucket::Clock::now();
+
+  EXPECT_EQ(bucket.Acquire(1000, now), 1000);
+  auto delay = bucket.Delay(500, now);
+  EXPECT_GE(delay, milliseconds(499));
+  EXPECT_LE(delay, milliseconds(501));
+
+  bucket.Refund(500);
+  EXPECT_EQ(bucket.Delay(500, now).count(), 0);
+  EXPECT_EQ(bucket.Acquire(1000, now), 500);
+}
+
+// ==================== RateLimiter 测试 ====================
+
+// 测试连接、IP、全局三层限速取最小值
+TEST(RateLimiterTest, HierarchicalLimit) {
+  RateLimiter limiter;
+  limiter.SetGlobalLimit(10000, 10000);
+  limiter.SetClientLimit(3000, 3000);
+  limiter.SetConnectionLimit(2000, 2000);
+  auto now = RateLimiter::Clock::now();
+
+  auto conn1 = limiter.Register("10.0.0.1");
+  auto conn2 = limiter.Register("10.0.0.1");
+  EXPECT_EQ(limiter.client_count(), 1);
+
+  // 单连接受连接限速约束
+  EXPECT_EQ(limiter.Acquire(conn1.get(), 5000, now), 2000);
+  // 同IP的第二个连接只能用IP剩余的额度
+  EXPECT_EQ(limiter.Acquire(conn2.get(), 5000, now), 1000);
+  EXPECT_GT(limiter.Delay(conn2.get(), 1000, now).count(), 0);
+
+  // 其它IP不受影响, 全局额度只被实际发送的字节扣除
+  auto conn3 = limiter.Register("10.0.0.2");
+  EXPECT_EQ(limiter.client_count(), 2);
+  EXPECT_EQ(limiter.Acquire(conn3.get(), 5000, now), 2000);
+}
+
+// 测试全局限速被多个IP共享
+TEST(RateLimiterTest, GlobalLimitShared) {
+  RateLimiter limiter;
+  limiter.SetGlobalLimit(1000, 1000);
+  auto now = RateLimiter::Clock::now();
+
+  auto conn1 = limiter.Register("10.0.0.1");
+  auto conn2 = limiter.Register("10.0.0.2");
+  EXPECT_EQ(limiter.Acquire(conn1.get(), 600, now), 600);
+  EXPECT_EQ(limiter.Acquire(conn2.get(), 600, now), 400);
+  EXPECT_EQ(limiter.Acquire(conn2.get(), 600, now), 0);
+}
+
+// 测试单次分配上限使连接轮流发送
+TEST(RateLimiterTest, Quantum) {
+  RateLimiter limiter;
+  limiter.SetGlobalLimit(1000, 1000);
+  limiter.set_quantum(300);
+  auto now = RateLimiter::Clock::now();
+
+  auto conn1 = limiter.Register("10.0.0.1");
+  auto conn2 = limiter.Register("10.0.0.2");
+  EXPECT_EQ(limiter.Acquire(conn1.get(), 1000, now), 300);
+  EXPECT_EQ(limiter.Acquire(conn2.get(), 1000, now), 300);
+  EXPECT_EQ(limiter.Acquire(conn1.get(), 1000, now), 300);
+  EXPECT_EQ(limiter.Acquire(conn2.get(), 1000, now), 100);
+}
+
+// 测试连接关闭后IP令牌桶被释放
+TEST(RateLimiterTest, ClientReleased) {
+  RateLimiter limiter;
+  limiter.SetClientLimit(1000, 1000);
+
+  auto conn = limiter.Register("10.0.0.1");
+  EXPECT_EQ(limiter.client_count(), 1);
+  conn.reset();
+  EXPECT_EQ(limiter.client_count(), 0);
+}
@@ -0,0 +1,194 @@
+﻿// readahead_test.cpp
+// ReadaheadStream 类单元测试
+
+#include "include/readahead.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "include/blocking_pool.h"
+#include "include/file_cache.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+static const long long kKB = 1024;
+static const long long kMB = 1024 * 1024;
+
+// 创建指定大小的测试文件并打开
+static OpenFilePtr CreateFile(const fs::path& path, long long size) {
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::string block(kMB, 'r');
+    for (long long written = 0; written < size; written += kMB) {
+      out.write(block.data(), std::min(kMB, size - written));
+    }
+  }
+  FileCache cache(1);
+  return cache.Open(path.string());
+}
+
+// ==================== ReadaheadStream 测试 ====================
+
+// 测试顺序发送达到阈值后在发送位置之后预读
+TEST(ReadaheadTest, SequentialStreamPrefetches) {
+  fs::path path = fs::temp_directory_path() / "readahead_test_seq.bin";
+  OpenFilePtr file = CreateFile(path, 8 * kMB);
+  ASSERT_NE(file, nullptr);
+
+  ReadaheadOptions options;
+  options.min_window = 256 * kKB;
+  options.sequential_trigger = 2;
+  ReadaheadStream stream(nullptr, file, options);
+
+  auto now = ReadaheadStream::Clock::now();
+  stream.OnSend(0, 64 * kKB, now);
+  stream.OnSend(64 * kKB, 64 * kKB, now);
+  // 还没有达到顺序发送次数, 不预读
+  EXPECT_FALSE(stream.sequential());
+  EXPECT_EQ(stream.stats().prefetches, 0);
+
+  stream.OnSend(128 * kKB, 64 * kKB, now);
+  EXPECT_TRUE(stream.sequential());
+  EXPECT_EQ(stream.stats().prefetches, 1);
+  // 尚未测出发送速率, 使用最小窗口
+  EXPECT_EQ(stream.prefetched_end(), 192 * kKB + options.min_window);
+
+  // 剩余预读量超过半个窗口时不重复预读
+  stream.OnSend(192 * kKB, 64 * kKB, now);
+  EXPECT_EQ(stream.stats().prefetches, 1);
+
+  // 发送接近预读末尾后继续补充, 且不超过文件末尾
+  for (long long offset = 256 * kKB; offset < 8 * kMB; offset += 64 * kKB) {
+    stream.OnSend(offset, 64 * kKB, now);
+    EXPECT_LE(stream.prefetched_end(), 8 * kMB);
+  }
+  EXPECT_GT(stream.stats().prefetches, 1);
+  EXPECT_EQ(stream.prefetched_end(), 8 * kMB);
+
+  file.reset();
+  fs::remove(path);
+}
+
+// 测试预读窗口随发送速率变化
+TEST(ReadaheadTest, WindowFollowsSendRate) {
+  fs::path path = fs::temp_directory_path() / "readahead_test_rate.bin";
+  OpenFilePtr file = CreateFile(path, 64 * kMB);
+  ASSERT_NE(file, nullptr);
+
+  ReadaheadOptions options;
+  options.min_window = 128 * kKB;
+  options.max_window = 4 * kMB;
+  options.lead_ms = 500;
+  options.drop_behind = false;
+
+  // 慢速连接: 每100毫秒发送64KB, 约640KB/s, 窗口约320KB
+  {
+    ReadaheadStream stream(nullptr, file, options);
+    auto now = ReadaheadStream::Clock::now();
+    for (int i = 0; i < 20; ++i) {
+      stream.OnSend(i * 64 * kKB, 64 * kKB, now);
+      now += std::chrono::milliseconds(100);
+    }
+    EXPECT_GT(stream.send_rate(), 400 * kKB);
+    EXPECT_LT(stream.send_rate(), 1 * kMB);
+    EXPECT_GT(stream.window(), options.min_window);
+    EXPECT_LT(stream.window(), 1 * kMB);
+  }
+
+  // 快速连接: 每10毫秒发送1MB, 约100MB/s, 窗口达到上限
+  {
+    ReadaheadStream stream(nullptr, file, options);
+    auto now = ReadaheadStream::Clock::now();
+    for (int i = 0; i < 40; ++i) {
+      stream.OnSend(i * kMB, kMB, now);
+      now += std::chrono::milliseconds(10);
+    }
+    EXPECT_GT(stream.send_rate(), 50 * kMB);
+    EXPECT_EQ(stream.window(), options.max_window);
+    EXPECT_EQ(stream.stats().releases, 0);
+  }
+
+  file.reset();
+  fs::remove(path);
+}
+
+// 测试随机访问时停止预读
+TEST(ReadaheadTest, RandomAccessDisablesPrefetch) {
+  fs::path path = fs::temp_directory_path() / "readahead_test_random.bin";
+  OpenFilePtr file = CreateFile(path, 16 * kMB);
+  ASSERT_NE(file, nullptr);
+
+  ReadaheadStream stream(nullptr, file);
+  long long offsets[] = {8 * kMB, 1 * kMB, 12 * kMB, 3 * kMB, 0, 6 * kMB};
+  for (long long offset : offsets) {
+    stream.OnSend(offset, 64 * kKB);
+    EXPECT_FALSE(stream.sequential());
+  }
+  EXPECT_EQ(stream.stats().prefetches, 0);
+  EXPECT_EQ(stream.stats().releases, 0);
+
+  // 跳转后重新开始顺序发送, 再次预读
+  stream.OnSend(6 * kMB + 64 * kKB, 64 * kKB);
+  stream.OnSend(6 * kMB + 128 * kKB, 64 * kKB);
+  EXPECT_TRUE(stream.sequential());
+  EXPECT_EQ(stream.stats().prefetches, 1);
+
+  file.reset();
+  fs::remove(path);
+}
+
+// 测试释放已发送部分的页缓存
+TEST(ReadaheadTest, DropBehind) {
+  fs::path path = fs::temp_directory_path() / "readahead_test_drop.bin";
+  OpenFilePtr file = CreateFile(path, 8 * kMB);
+  ASSERT_NE(file, nullptr);
+
+  ReadaheadOptions options;
+  options.min_window = 256 * kKB;
+  options.keep_behind = 1 * kMB;
+  ReadaheadStream stream(nullptr, file, options);
+  for (long long offset = 0; offset < 8 * kMB; offset += 128 * kKB) {
+    stream.OnSend(offset, 128 * kKB);
+  }
+  // 发送位置之前保留1MB, 其余按最小窗口分批释放
+  EXPECT_GT(stream.stats().releases, 1);
+  EXPECT_GT(stream.stats().released_bytes, 6 * kMB - options.min_window);
+  EXPECT_LE(stream.stats().released_bytes, 7 * kMB);
+
+  options.drop_behind = false;
+  ReadaheadStream keep(nullptr, file, options);
+  for (long long offset = 0; offset < 8 * kMB; offset += 128 * kKB) {
+    keep.OnSend(offset, 128 * kKB);
+  }
+  EXPECT_EQ(keep.stats().releases, 0);
+
+  file.reset();
+  fs::remove(path);
+}
+
+// 测试预读在阻塞I/O线程池中执行, 流销毁后文件保持打开直到预读完成
+TEST(ReadaheadTest, UsesBlockingPool) {
+  fs::path path = fs::temp_directory_path() / "readahead_test_pool.bin";
+  OpenFilePtr file = CreateFile(path, 16 * kMB);
+  ASSERT_NE(file, nullptr);
+
+  BlockingPool pool;
+  pool.Init(1);
+  {
+    ReadaheadStream stream(&pool, file);
+    for (long long offset = 0; offset < 16 * kMB; offset += 256 * kKB) {
+      stream.OnSend(offset, 256 * kKB);
+    }
+    const ReadaheadStats& stats = stream.stats();
+    EXPECT_GE(stats.prefetches, 1);
+    EXPECT_GT(stats.prefetched_bytes, 0);
+  }
+  file.reset();
+  pool.Stop();
+  fs::remove(path);
+}
@@ -0,0 +1,683 @@
+﻿// replication_test.cpp
+// ReplicaServer 和 ChainClient 类单元测试
+
+#include "include/replication.h"
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/compression.h"
+#include "include/crc32c.h"
+#include "include/frame.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 在子进程中启动三个副本节点, 模拟多台机器
+class ReplicationTest : public ::testing::Test {
+ protected:
+  static constexpr int kNodes = 3;
+  static constexpr size_t kChunkSize = 64 * 1024;
+
+  void SetUp() override {
+    base_ = fs::temp_directory_path() /
+            ("replication_test_" + std::to_string(getpid()));
+    fs::remove_all(base_);
+    int port = 20000 + getpid() % 20000;
+    for (int i = 0; i < kNodes; ++i) {
+      roots_.push_back(base_ / ("node" + std::to_string(i)));
+      ports_.push_back(port + i);
+      addresses_.push_back("127.0.0.1:" + std::to_string(ports_[i]));
+      pids_.push_back(StartNode(ports_[i], roots_[i].string()));
+    }
+    for (const auto& address : addresses_) {
+      ASSERT_TRUE(WaitReady(address)) << address;
+    }
+  }
+
+  void TearDown() override {
+    for (pid_t pid : pids_) {
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+    fs::remove_all(base_);
+  }
+
+  // 启动节点进程
+  static pid_t StartNode(int port, const std::string& root) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      ReplicaOptions options;
+      options.port = port;
+      options.root = root;
+      options.chunk_size = kChunkSize;
+      options.ack_bytes = 64 * 1024;
+      options.high_water = 256 * 1024;
+      ReplicaServer server(options);
+      if (!server.Start()) _exit(1);
+      while (true) pause();
+    }
+    return pid;
+  }
+
+  // 等待节点开始监听
+  static bool WaitReady(const std::string& address) {
+    for (int i = 0; i < 200; ++i) {
+      ChainClient client;
+      if (client.Connect(address)) return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+  }
+
+  // 生成测试数据
+  static std::string Data(size_t size, int seed) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = static_cast<char>((i * 131 + seed) % 251);
+    }
+    return data;
+  }
+
+  // 连接本机端口, 失败返回-1
+  static int ConnectLocal(int port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      close(sock);
+      return -1;
+    }
+    return sock;
+  }
+
+  // 读取一条消息
+  static bool RecvRaw(int sock, FrameType* type, uint32_t* id,
+                      std::string* body) {
+    char header[Frame::kHeaderSize];
+    uint32_t body_size = 0;
+    if (!ReadFull(sock, header, sizeof(header)) ||
+        !Frame::DecodeHeader(header, type, id, &body_size)) {
+      return false;
+    }
+    body->resize(body_size);
+    return ReadFull(sock, &(*body)[0], body_size);
+  }
+
+  static bool ReadFull(int sock, char* data, size_t size) {
+    while (size > 0) {
+      ssize_t len = recv(sock, data, size, 0);
+      if (len <= 0) return false;
+      data += len;
+      size -= static_cast<size_t>(len);
+    }
+    return true;
+  }
+
+  static std::string ReadFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+  }
+
+  // 查找文件的临时文件(`文件名.<编号>后缀`), 没有时返回空路径
+  static fs::path FindTemp(const fs::path& file, const std::string& suffix) {
+    std::error_code ec;
+    std::string prefix = file.filename().string() + ".";
+    for (fs::directory_iterator it(file.parent_path(), ec), end;
+         !ec && it != end; it.increment(ec)) {
+      std::string name = it->path().filename().string();
+      if (name.size() > prefix.size() + suffix.size() &&
+          name.compare(0, prefix.size(), prefix) == 0 &&
+          name.compare(name.size() - suffix.size(), suffix.size(), suffix) ==
+              0) {
+        return it->path();
+      }
+    }
+    return fs::path();
+  }
+
+  fs::path base_;
+  std::vector<fs::path> roots_;
+  std::vector<int> ports_;
+  std::vector<std::string> addresses_;
+  std::vector<pid_t> pids_;
+};
+
+// ==================== ReplicaServer 测试 ====================
+
+// 测试文件沿链写入所有节点, 同一连接上依次写入多个文件
+TEST_F(ReplicationTest, ChainWrite) {
+  ChainClient client;
+  ASSERT_TRUE(client.Connect(addresses_[0]));
+  std::vector<std::string> chain = {addresses_[1], addresses_[2]};
+  std::string a = Data(1000000, 1);
+  std::string b = Data(3, 2);
+  ASSERT_TRUE(client.Put("dir/a.bin", a.data(), a.size(), chain, 100000));
+  EXPECT_EQ(client.acked(), static_cast<long long>(a.size()));
+  ASSERT_TRUE(client.Put("b.bin", b.data(), b.size(), chain));
+
+  for (const auto& root : roots_) {
+    EXPECT_EQ(ReadFile(root / "dir/a.bin"), a) << root;
+    EXPECT_EQ(ReadFile(root / "b.bin"), b) << root;
+    EXPECT_TRUE(FindTemp(root / "dir/a.bin", ".chain.tmp").empty());
+    // 保存了分块校验和
+    ChunkCrc chunks;
+    ASSERT_TRUE(
+        chunks.Load(ChunkCrc::SidecarPath((root / "dir/a.bin").string())));
+    EXPECT_EQ(chunks.total_size(), static_cast<long long>(a.size()));
+  }
+}
+
+// 测试数据块到达即转发: 客户端发送完之前链尾已经在写入
+TEST_F(ReplicationTest, PipelinedForwarding) {
+  ChainClient client;
+  ASSERT_TRUE(client.Connect(addresses_[0]));
+  std::string data = Data(4 * 1024 * 1024, 3);
+  size_t half = data.size() / 2;
+  ASSERT_TRUE(client.Begin("big.bin", data.size(),
+                           {addresses_[1], addresses_[2]}));
+  ASSERT_TRUE(client.Write(data.data(), half));
+
+  bool reached = false;
+  for (int i = 0; i < 500 && !reached; ++i) {
+    fs::path temp = FindTemp(roots_[2] / "big.bin", ".chain.tmp");
+    reached = !temp.empty() &&
+              ReadFile(temp).substr(0, half) == data.substr(0, half);
+    if (!reached) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(reached);
+  EXPECT_FALSE(fs::exists(roots_[2] / "big.bin"));
+
+  ASSERT_TRUE(client.Write(data.data() + half, data.size() - half));
+  ASSERT_TRUE(client.End());
+  EXPECT_EQ(ReadFile(roots_[2] / "big.bin"), data);
+}
+
+// 测试链上节点不可用时写入失败, 不留下临时文件
+TEST_F(ReplicationTest, FailurePropagates) {
+  kill(pids_[2], SIGKILL);
+  waitpid(pids_[2], nullptr, 0);
+  pids_.pop_back();
+
+  ChainClient client;
+  ASSERT_TRUE(client.Connect(addresses_[0]));
+  std::string data = Data(200000, 4);
+  EXPECT_FALSE(client.Put("c.bin", data.data(), data.size(),
+                          {addresses_[1], addresses_[2]}));
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_FALSE(fs::exists(roots_[i] / "c.bin"));
+  }
+  // 等待节点清理临时文件
+  bool cleaned = false;
+  for (int i = 0; i < 200 && !cleaned; ++i) {
+    cleaned = FindTemp(roots_[0] / "c.bin", ".chain.tmp").empty() &&
+              FindTemp(roots_[1] / "c.bin", ".chain.tmp").empty();
+    if (!cleaned) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(cleaned);
+
+  // 非法路径被拒绝
+  ASSERT_TRUE(client.Connect(addresses_[0]));
+  EXPECT_FALSE(client.Put("../x", data.data(), data.size(), {}));
+}
+
+// 测试损坏的副本只追赶不一致的块
+TEST_F(ReplicationTest, CatchUp) {
+  ChainClient client;
+  ASSERT_TRUE(client.Connect(addresses_[0]));
+  std::string data = Data(10 * kChunkSize + 123, 5);
+  ASSERT_TRUE(client.Put("d.bin", data.data(), data.size(),
+                         {addresses_[1]}));
+
+  // 本地副本: 一个块损坏并多出尾部数据
+  fs::path local = base_ / "local";
+  fs::create_directories(local);
+  std::string broken = data + "tail";
+  broken[3 * kChunkSize + 7] ^= 0x5a;
+  std::ofstream(local / "d.bin", std::ios::binary) << broken;
+
+  long long fetched = -1;
+  ASSERT_TRUE(ReplicaServer::CatchUp(local.string(), "d.bin", addresses_[1],
+                                     kChunkSize, &fetched));
+  EXPECT_EQ(fetched, static_cast<long long>(kChunkSize + 123));
+  EXPECT_EQ(ReadFile(local / "d.bin"), data);
+
+  // 缺失的文件全部追赶, 源节点不存在的文件失败
+  EXPECT_FALSE(ReplicaServer::CatchUp(local.string(), "new/d.bin",
+                                      addresses_[0], kChunkSize, &fetched));
+  EXPECT_FALSE(fs::exists(local / "new/d.bin"));
+  ASSERT_TRUE(ReplicaServer::CatchUp((base_ / "empty").string(), "d.bin",
+                                     addresses_[0], kChunkSize, &fetched));
+  EXPECT_EQ(fetched, static_cast<long long>(data.size()));
+  EXPECT_EQ(ReadFile(base_ / "empty/d.bin"), data);
+}
+
+// 测试源节点没有分块校验和文件时在阻塞I/O线程中计算,
+// 同一连接上之后的请求在计算完成后按顺序处理
+TEST_F(ReplicationTest, CatchUpWithoutSidecar) {
+  std::string data = Data(5 * kChunkSize + 9, 6);
+  std::ofstream(roots_[0] / "raw.bin", std::ios::binary) << data;
+  fs::path local = base_ / "raw";
+  long long fetched = -1;
+  ASSERT_TRUE(ReplicaServer::CatchUp(local.string(), "raw.bin", addresses_[0],
+                                     kChunkSize, &fetched));
+  EXPECT_EQ(fetched, static_cast<long long>(data.size()));
+  EXPECT_EQ(ReadFile(local / "raw.bin"), data);
+
+  int sock = ConnectLocal(ports_[1]);
+  ASSERT_GE(sock, 0);
+  std::ofstream(roots_[1] / "raw.bin", std::ios::binary) << data;
+  FrameWriter sync;
+  sync.PutString("raw.bin");
+  sync.PutU32(kChunkSize);
+  sync.PutU32(0);
+  FrameWriter read;
+  read.PutString("raw.bin");
+  read.PutU64(0);
+  read.PutU64(data.size());
+  std::string requests = sync.Finish(FrameType::kSyncRequest, 1) +
+                         read.Finish(FrameType::kReadAt, 2);
+  ASSERT_EQ(send(sock, requests.data(), requests.size(), 0),
+            static_cast<ssize_t>(requests.size()));
+
+  FrameType type;
+  uint32_t id = 0;
+  std::string body;
+  ASSERT_TRUE(RecvRaw(sock, &type, &id, &body));
+  EXPECT_EQ(type, FrameType::kSyncBegin);
+  int chunks = 0;
+  while (RecvRaw(sock, &type, &id, &body) && type == FrameType::kPutData) {
+    ++chunks;
+  }
+  EXPECT_EQ(chunks, 6);
+  EXPECT_EQ(type, FrameType::kAck);
+  EXPECT_EQ(id, 1u);
+  ASSERT_TRUE(RecvRaw(sock, &type, &id, &body));
+  EXPECT_EQ(type, FrameType::kData);
+  EXPECT_EQ(id, 2u);
+  EXPECT_EQ(body.substr(16), data);
+  close(sock);
+}
+
+// 测试提交区间写入的文件时校验CRC32C, 不一致时丢弃, 一致时保存分块校验和
+TEST_F(ReplicationTest, CommitVerifiesCrc) {
+  int sock = ConnectLocal(ports_[0]);
+  ASSERT_GE(sock, 0);
+  std::string data = Data(3 * kChunkSize + 5, 8);
+  auto put = [&](uint32_t id, uint32_t crc) {
+    FrameWriter write;
+    write.PutString("w.bin");
+    write.PutU64(data.size());
+    write.PutU64(id);
+    write.PutU64(0);
+    std::string request = write.Finish(FrameType::kWriteAt, id);
+    // 数据紧跟在字段之后, 修改消息长度
+    request += data;
+    Frame::EncodeHeader(FrameType::kWriteAt, id,
+                        static_cast<uint32_t>(request.size() -
+                                              Frame::kHeaderSize),
+                        &request[0]);
+    FrameWriter commit;
+    commit.PutString("w.bin");
+    commit.PutU64(data.size());
+    commit.PutU64(id);
+    commit.PutU32(crc);
+    request += commit.Finish(FrameType::kCommit, id + 1);
+    send(sock, request.data(), request.size(), 0);
+    FrameType type;
+    uint32_t reply_id = 0;
+    std::string body;
+    RecvRaw(sock, &type, &reply_id, &body);
+    RecvRaw(sock, &type, &reply_id, &body);
+    return !body.empty() &&
+           body[0] == static_cast<char>(AckStatus::kCommitted) &&
+           reply_id == id + 1;
+  };
+  uint32_t crc = Crc32c::Value(data.data(), data.size());
+  EXPECT_FALSE(put(1, crc ^ 1));
+  EXPECT_FALSE(fs::exists(roots_[0] / "w.bin"));
+  EXPECT_TRUE(FindTemp(roots_[0] / "w.bin", ".part.tmp").empty());
+
+  ASSERT_TRUE(put(3, crc));
+  EXPECT_EQ(ReadFile(roots_[0] / "w.bin"), data);
+  ChunkCrc chunks;
+  ASSERT_TRUE(
+      chunks.Load(ChunkCrc::SidecarPath((roots_[0] / "w.bin").string())));
+  EXPECT_EQ(chunks.total_size(), static_cast<long long>(data.size()));
+  EXPECT_EQ(chunks.crcs().size(), 4u);
+  close(sock);
+}
+
+// 测试同一文件同时进行的多个上传使用各自的临时文件, 不会互相覆盖
+TEST_F(ReplicationTest, ConcurrentUploadsOfSamePath) {
+  std::string first = Data(300000, 12);
+  std::string second = Data(200000, 13);
+  ChainClient a, b;
+  ASSERT_TRUE(a.Connect(addresses_[0]));
+  ASSERT_TRUE(b.Connect(addresses_[0]));
+  size_t half = first.size() / 2;
+  ASSERT_TRUE(a.Begin("same.bin", first.size(), {addresses_[1]}));
+  ASSERT_TRUE(a.Write(first.data(), half));
+  // 另一个客户端在中途写入并提交同一文件
+  ASSERT_TRUE(b.Put("same.bin", second.data(), second.size(), {addresses_[1]}));
+  ASSERT_TRUE(a.Write(first.data() + half, first.size() - half));
+  ASSERT_TRUE(a.End());
+  EXPECT_EQ(ReadFile(roots_[0] / "same.bin"), first);
+  EXPECT_EQ(ReadFile(roots_[1] / "same.bin"), first);
+
+  // 区间写入: 两个上传ID交错写入同一文件, 各自提交完整的内容
+  int sock = ConnectLocal(ports_[0]);
+  ASSERT_GE(sock, 0);
+  auto write_at = [&](uint64_t upload, const std::string& data) {
+    FrameWriter write;
+    write.PutString("part.bin");
+    write.PutU64(data.size());
+    write.PutU64(upload);
+    write.PutU64(0);
+    std::string request = write.Finish(FrameType::kWriteAt, 1);
+    request += data;
+    Frame::EncodeHeader(FrameType::kWriteAt, 1,
+                        static_cast<uint32_t>(request.size() -
+                                              Frame::kHeaderSize),
+                        &request[0]);
+    send(sock, request.data(), request.size(), 0);
+  };
+  auto commit = [&](uint64_t upload, const std::string& data) {
+    FrameWriter fields;
+    fields.PutString("part.bin");
+    fields.PutU64(data.size());
+    fields.PutU64(upload);
+    std::string request = fields.Finish(FrameType::kCommit, 2);
+    send(sock, request.data(), request.size(), 0);
+  };
+  auto acked = [&]() {
+    FrameType type;
+    uint32_t id = 0;
+    std::string body;
+    return RecvRaw(sock, &type, &id, &body) && !body.empty() &&
+           body[0] == static_cast<char>(AckStatus::kCommitted);
+  };
+  write_at(1, first);
+  write_at(2, second);
+  EXPECT_TRUE(acked());
+  EXPECT_TRUE(acked());
+  commit(1, first);
+  ASSERT_TRUE(acked());
+  EXPECT_EQ(ReadFile(roots_[0] / "part.bin"), first);
+  commit(2, second);
+  ASSERT_TRUE(acked());
+  EXPECT_EQ(ReadFile(roots_[0] / "part.bin"), second);
+  close(sock);
+}
+
+// 测试启用块缓存后读取请求从缓存发送, 文件被替换后读到新内容
+TEST_F(ReplicationTest, ReadThroughCache) {
+  ReplicaOptions options;
+  options.port = ports_[kNodes - 1] + 2;
+  options.root = (base_ / "cached").string();
+  options.cache_capacity = 4 * 1024 * 1024;
+  ReplicaServer server(options);
+  ASSERT_TRUE(server.Start());
+  ChainClient client;
+  ASSERT_TRUE(client.Connect("127.0.0.1:" + std::to_string(options.port)));
+  int sock = ConnectLocal(options.port);
+  ASSERT_GE(sock, 0);
+  // 读取区间, 返回数据
+  auto read = [&](uint64_t offset, uint64_t length) {
+    FrameWriter request;
+    request.PutString("c.bin");
+    request.PutU64(offset);
+    request.PutU64(length);
+    std::string out = request.Finish(FrameType::kReadAt, 1);
+    send(sock, out.data(), out.size(), 0);
+    FrameType type;
+    uint32_t id = 0;
+    std::string body;
+    if (!RecvRaw(sock, &type, &id, &body) || type != FrameType::kData) {
+      return std::string();
+    }
+    return body.substr(16);
+  };
+
+  std::string data = Data(300 * 1024 + 11, 9);
+  ASSERT_TRUE(client.Put("c.bin", data.data(), data.size(), {}));
+  EXPECT_EQ(read(0, data.size()), data);
+  EXPECT_EQ(read(1000, 100000), data.substr(1000, 100000));
+  BlockCacheStats stats = server.cache()->stats();
+  EXPECT_EQ(stats.misses, 5);
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(server.memory_stats().categories[static_cast<int>(
+                MemoryCategory::kCache)],
+            stats.bytes);
+  // 第二次读取复用打开的文件
+  FileCacheStats files = server.files()->stats();
+  EXPECT_EQ(files.misses, 1);
+  EXPECT_EQ(files.hits, 1);
+
+  // 覆盖写入后缓存的文件失效, 读到新内容
+  std::string other = Data(data.size(), 10);
+  ASSERT_TRUE(client.Put("c.bin", other.data(), other.size(), {}));
+  EXPECT_EQ(read(0, other.size()), other);
+  EXPECT_EQ(server.files()->stats().misses, 2);
+  close(sock);
+}
+
+// 测试连接顺序读取文件时预读, 随机读取时不预读
+TEST_F(ReplicationTest, SequentialReadAtPrefetches) {
+  ReplicaOptions options;
+  options.port = ports_[kNodes - 1] + 4;
+  options.root = (base_ / "readahead").string();
+  ReplicaServer server(options);
+  ASSERT_TRUE(server.Start());
+  std::string data = Data(2 * 1024 * 1024, 12);
+  ChainClient client;
+  ASSERT_TRUE(client.Connect("127.0.0.1:" + std::to_string(options.port)));
+  ASSERT_TRUE(client.Put("r.bin", data.data(), data.size(), {}));
+
+  int sock = ConnectLocal(options.port);
+  ASSERT_GE(sock, 0);
+  auto read = [&](uint64_t offset, uint64_t length) {
+    FrameWriter request;
+    request.PutString("r.bin");
+    request.PutU64(offset);
+    request.PutU64(length);
+    std::string out = request.Finish(FrameType::kReadAt, 1);
+    send(sock, out.data(), out.size(), 0);
+    FrameType type;
+    uint32_t id = 0;
+    std::string body;
+    if (!RecvRaw(sock, &type, &id, &body) || type != FrameType::kData) {
+      return std::string();
+    }
+    return body.substr(16);
+  };
+
+  const uint64_t piece = 64 * 1024;
+  // 跳转读取不触发预读
+  for (uint64_t offset : {piece * 20, piece * 3, piece * 11}) {
+    EXPECT_EQ(read(offset, piece), data.substr(offset, piece));
+  }
+  EXPECT_EQ(server.stats().prefetched_bytes, 0);
+  for (uint64_t offset = 0; offset < 4 * piece; offset += piece) {
+    EXPECT_EQ(read(offset, piece), data.substr(offset, piece));
+  }
+  EXPECT_GT(server.stats().prefetched_bytes, 0);
+  close(sock);
+}
+
+// 测试连接限速: 读取(`sendfile`)的速度不超过`connection_rate`
+TEST_F(ReplicationTest, ThrottledReadAt) {
+  ReplicaOptions options;
+  options.port = ports_[kNodes - 1] + 3;
+  options.root = (base_ / "throttled").string();
+  options.connection_rate = 1024 * 1024;
+  ReplicaServer server(options);
+  ASSERT_TRUE(server.Start());
+  std::string data = Data(3 * 1024 * 1024, 11);
+  ChainClient client;
+  ASSERT_TRUE(client.Connect("127.0.0.1:" + std::to_string(options.port)));
+  ASSERT_TRUE(client.Put("t.bin", data.data(), data.size(), {}));
+
+  int sock = ConnectLocal(options.port);
+  ASSERT_GE(sock, 0);
+  FrameWriter request;
+  request.PutString("t.bin");
+  request.PutU64(0);
+  request.PutU64(data.size());
+  std::string out = request.Finish(FrameType::kReadAt, 1);
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(send(sock, out.data(), out.size(), 0),
+            static_cast<ssize_t>(out.size()));
+  FrameType type;
+  uint32_t id = 0;
+  std::string body;
+  ASSERT_TRUE(RecvRaw(sock, &type, &id, &body));
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  ASSERT_EQ(type, FrameType::kData);
+  EXPECT_EQ(body.substr(16), data);
+  // 突发1MB后按1MB/s发送其余2MB
+  EXPECT_GE(elapsed, std::chrono::milliseconds(1500));
+  close(sock);
+}
+
+// 测试转发限速: 节点转发给下游的数据共用节点的限速句柄
+TEST_F(ReplicationTest, ThrottledForwardingIsPerNode) {
+  ReplicaOptions options;
+  options.port = ports_[kNodes - 1] + 5;
+  options.root = (base_ / "forwarding").string();
+  options.connection_rate = 1024 * 1024;
+  ReplicaServer server(options);
+  ASSERT_TRUE(server.Start());
+  std::string address = "127.0.0.1:" + std::to_string(options.port);
+
+  // 两个连接各转发1.5MB, 合计按1MB/s限速
+  std::string data = Data(1536 * 1024, 14);
+  auto start = std::chrono::steady_clock::now();
+  auto put = [&](const std::string& path) {
+    ChainClient client;
+    return client.Connect(address) &&
+           client.Put(path, data.data(), data.size(), {addresses_[1]});
+  };
+  std::future<bool> first = std::async(std::launch::async, put, "f1.bin");
+  std::future<bool> second = std::async(std::launch::async, put, "f2.bin");
+  ASSERT_TRUE(first.get());
+  ASSERT_TRUE(second.get());
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(ReadFile(roots_[1] / "f1.bin"), data);
+  EXPECT_EQ(ReadFile(roots_[1] / "f2.bin"), data);
+  // 突发1MB后按1MB/s发送其余2MB; 各连接分别限速时约0.5秒
+  EXPECT_GE(elapsed, std::chrono::milliseconds(1500));
+}
+
+// 测试协商压缩: 写入沿链压缩传输, 读取时服务器压缩`kData`数据
+TEST_F(ReplicationTest, CompressedPutAndReadAt) {
+  ChainClient client;
+  ASSERT_TRUE(client.Connect(addresses_[0]));
+  client.set_codecs("zlib");
+  // 熵低的文本数据, 压缩后明显变小
+  std::string data;
+  for (int i = 0; data.size() < 4 * 1024 * 1024; ++i) {
+    data += "line " + std::to_string(i) + ": replicated text\n";
+  }
+  ASSERT_TRUE(client.Put("z.bin", data.data(), data.size(),
+                         {addresses_[1], addresses_[2]}));
+  EXPECT_EQ(client.codec(), CompressionCodec::kZlib);
+  EXPECT_LT(client.encoded_bytes(), static_cast<long long>(data.size()));
+  for (const auto& root : roots_) {
+    EXPECT_EQ(ReadFile(root / "z.bin"), data) << root;
+  }
+
+  int sock = ConnectLocal(ports_[1]);
+  ASSERT_GE(sock, 0);
+  FrameWriter request;
+  request.PutString("z.bin");
+  request.PutU64(1000);
+  request.PutU64(1024 * 1024);
+  request.PutString("lz4,zlib");
+  std::string out = request.Finish(FrameType::kReadAt, 1);
+  send(sock, out.data(), out.size(), 0);
+  FrameType type;
+  uint32_t id = 0;
+  std::string body;
+  ASSERT_TRUE(RecvRaw(sock, &type, &id, &body));
+  ASSERT_EQ(type, FrameType::kData);
+  ASSERT_GT(body.size(), 17u);
+  ASSERT_EQ(static_cast<CompressionCodec>(body[16]), CompressionCodec::kZlib);
+  EXPECT_LT(body.size(), 1024u * 1024);
+  ChunkDecoder decoder(CompressionCodec::kZlib);
+  std::string decoded;
+  ASSERT_TRUE(decoder.Feed(body.data() + 17, body.size() - 17, &decoded));
+  EXPECT_FALSE(decoder.pending());
+  EXPECT_EQ(decoded, data.substr(1000, 1024 * 1024));
+
+  // 不支持的算法回退为不压缩, 仍带算法字段
+  FrameWriter plain;
+  plain.PutString("z.bin");
+  plain.PutU64(0);
+  plain.PutU64(100);
+  plain.PutString("lz4");
+  out = plain.Finish(FrameType::kReadAt, 2);
+  send(sock, out.data(), out.size(), 0);
+  ASSERT_TRUE(RecvRaw(sock, &type, &id, &body));
+  ASSERT_EQ(type, FrameType::kData);
+  ASSERT_EQ(body.size(), 117u);
+  EXPECT_EQ(static_cast<CompressionCodec>(body[16]), CompressionCodec::kNone);
+  EXPECT_EQ(body.substr(17), data.substr(0, 100));
+  close(sock);
+}
+
+// 测试停止节点: 关闭连接并丢弃未提交的写入, 端口可以重新监听
+TEST_F(ReplicationTest, Stop) {
+  ReplicaOptions options;
+  options.port = ports_[kNodes - 1] + 1;
+  options.root = (base_ / "stopped").string();
+  auto server = std::make_unique<ReplicaServer>(options);
+  ASSERT_TRUE(server->Start());
+  std::string address = "127.0.0.1:" + std::to_string(options.port);
+
+  ChainClient client;
+  ASSERT_TRUE(client.Connect(address));
+  std::string data = Data(1000, 7);
+  ASSERT_TRUE(client.Begin("p.bin", 2 * data.size(), {}));
+  ASSERT_TRUE(client.Write(data.data(), data.size()));
+  fs::path temp;
+  for (int i = 0; i < 200 && temp.empty(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    temp = FindTemp(base_ / "stopped/p.bin", ".chain.tmp");
+  }
+  ASSERT_FALSE(temp.empty());
+
+  server->Stop();
+  EXPECT_FALSE(fs::exists(temp));
+  EXPECT_EQ(server->memory_stats().used, 0);
+  EXPECT_FALSE(client.End());
+  ChainClient late;
+  EXPECT_FALSE(late.Connect(address));
+  // 重复停止和销毁不做任何事
+  server->Stop();
+  server.reset();
+
+  ReplicaServer restarted(options);
+  ASSERT_TRUE(restarted.Start());
+  ASSERT_TRUE(late.Connect(address));
+  EXPECT_TRUE(late.Put("q.bin", data.data(), data.size(), {}));
+}
@@ -6,10 +6,57 @@
 #include <event2/event.h>
 #include <gtest/gtest.h>
 
+#include <cstring>
+#include <string>
 #include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#endif
+
+#include "include/rate_limiter.h"
+#include "include/thread_pool.h"
 
 using namespace crossocean;
 
+// 连接本机端口, 返回socket(失败返回-1)
+static evutil_socket_t ConnectLocal(int port) {
+  evutil_socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    evutil_closesocket(sock);
+    return -1;
+  }
+  return sock;
+}
+
+// 读取对端发送的数据直到对端关闭
+static std::string ReadUntilClose(evutil_socket_t sock) {
+  std::string data;
+  char buf[64];
+  for (;;) {
+    int len = recv(sock, buf, sizeof(buf), 0);
+    if (len <= 0) break;
+    data.append(buf, len);
+  }
+  return data;
+}
+
+// 保存被接入的连接, 模拟连接处理者
+static evutil_socket_t accepted_sock = -1;
+static void KeepConnectionCB(int socket_fd, struct sockaddr* /*addr*/,
+                             int /*socklen*/, void* /*user_arg*/) {
+  accepted_sock = socket_fd;
+}
+
 // ==================== ServerTask 测试 ====================
 
 // 测试 ServerTask 端口设置
@@ -51,15 +98,18 @@ TEST(ServerTaskTest, ValidPortInitialization) {
 
   EXPECT_TRUE(task.Init());
 
+  task.Close();
   event_base_free(base);
 }
 
 // 测试 ServerTask 自定义回调函数
 TEST(ServerTaskTest, CustomCallback) {
-  static bool callback_called = false;
+  [[maybe_unused]] static bool callback_called = false;
 
-  auto custom_callback = [](int socket_fd, struct sockaddr* addr, int socklen,
-                            void* user_arg) { callback_called = true; };
+  auto custom_callback = [](int /*socket_fd*/, struct sockaddr* /*addr*/,
+                            int /*socklen*/, void* /*user_arg*/) {
+    callback_called = true;
+  };
 
   ServerTask task;
   task.ListenCB = custom_callback;
@@ -67,6 +117,23 @@ TEST(ServerTaskTest, CustomCallback) {
   EXPECT_NE(task.ListenCB, nullptr);
 }
 
+// 测试自定义回调函数被调用
+TEST(ServerTaskTest, CustomCallbackInvoked) {
+  static bool callback_called = false;
+
+  auto custom_callback = [](int /*socket_fd*/, struct sockaddr* /*addr*/,
+                            int /*socklen*/, void* /*user_arg*/) {
+    callback_called = true;
+  };
+
+  ServerTask task;
+  task.ListenCB = custom_callback;
+
+  ASSERT_NE(task.ListenCB, nullptr);
+  task.ListenCB(-1, nullptr, 0, &task);
+  EXPECT_TRUE(callback_called);
+}
+
 // 测试默认回调为空
 TEST(ServerTaskTest, DefaultCallbackIsNull) {
   ServerTask task;
@@ -94,6 +161,8 @@ TEST(ServerTaskTest, MultipleServerTasks) {
 
   EXPECT_NE(task1.server_port(), task2.server_port());
 
+  task1.Close();
+  task2.Close();
   event_base_free(base1);
   event_base_free(base2);
 }
@@ -145,6 +214,7 @@ TEST(ServerTaskTest, PortReuse) {
   EXPECT_TRUE(task1.Init());
 
   // 清理第一个任务
+  task1.Close();
   event_base_free(base1);
 
   // 稍等一下让端口释放
@@ -157,6 +227,7 @@ TEST(ServerTaskTest, PortReuse) {
 
   EXPECT_TRUE(task2.Init());
 
+  task2.Close();
   event_base_free(base2);
 }
 
@@ -177,3 +248,174 @@ TEST(ServerTaskTest, InheritedTaskProperties) {
 
   event_base_free(base);
 }
+
+// 测试最大连接数准入控制
+TEST(ServerTaskTest, AdmissionMaxConnections) {
+  ServerTask task;
+  task.set_max_connections(2);
+
+  EXPECT_TRUE(task.Admit());
+  EXPECT_TRUE(task.Admit());
+  EXPECT_FALSE(task.Admit());
+  EXPECT_EQ(task.active_connections(), 2);
+
+  // 连接关闭后释放名额
+  task.ConnectionClosed();
+  EXPECT_EQ(task.active_connections(), 1);
+  EXPECT_TRUE(task.Admit());
+}
+
+// 测试多个线程同时关闭连接, 计数准确且不会小于0
+TEST(ServerTaskTest, ConcurrentConnectionClosed) {
+  ServerTask task;
+  const int kThreads = 4;
+  const int kConnections = 10000;
+  for (int i = 0; i < kConnections; ++i) ASSERT_TRUE(task.Admit());
+
+  // 关闭次数多于连接数, 多出的关闭不能使计数变为负数
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&task]() {
+      for (int i = 0; i < kConnections / 2; ++i) task.ConnectionClosed();
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_EQ(task.active_connections(), 0);
+  EXPECT_TRUE(task.Admit());
+  EXPECT_EQ(task.active_connections(), 1);
+}
+
+// 测试新建的 ServerTask 使用线程池的 SO_BUSY_POLL 时间
+TEST(ServerTaskTest, SocketBusyPollFromPool) {
+  ThreadPool* pool = ThreadPool::GetInstance();
+  BusyPollOptions saved = pool->busy_poll();
+  BusyPollOptions options = saved;
+  options.socket_busy_poll_us = 50;
+  pool->set_busy_poll(options);
+
+  ServerTask task;
+  EXPECT_EQ(task.socket_busy_poll_us(), 50);
+  // 单独设置的值优先
+  task.set_socket_busy_poll_us(0);
+  EXPECT_EQ(task.socket_busy_poll_us(), 0);
+
+  pool->set_busy_poll(saved);
+  ServerTask plain;
+  EXPECT_EQ(plain.socket_busy_poll_us(), saved.socket_busy_poll_us);
+}
+
+// 测试接入连接时按客户端IP注册限速句柄
+TEST(ServerTaskTest, RegisterRateLimit) {
+  ServerTask task;
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  // 未设置限速器时不限速
+  EXPECT_EQ(task.RegisterRateLimit(reinterpret_cast<sockaddr*>(&addr)),
+            nullptr);
+
+  RateLimiter limiter;
+  limiter.SetClientLimit(1000, 1000);
+  task.set_rate_limiter(&limiter);
+  auto first = task.RegisterRateLimit(reinterpret_cast<sockaddr*>(&addr));
+  auto second = task.RegisterRateLimit(reinterpret_cast<sockaddr*>(&addr));
+  ASSERT_NE(first, nullptr);
+  ASSERT_NE(second, nullptr);
+  EXPECT_EQ(first->ip, "127.0.0.1");
+  // 同一IP的连接共享IP令牌桶
+  EXPECT_EQ(first->client, second->client);
+  EXPECT_NE(first->connection, second->connection);
+  EXPECT_EQ(limiter.client_count(), 1);
+}
+
+// 测试自定义准入检查(如缓冲池余量)
+TEST(ServerTaskTest, AdmissionCustomCheck) {
+  static bool has_headroom = false;
+  ServerTask task;
+  task.AdmissionCheck = [](void* /*user_arg*/) { return has_headroom; };
+
+  EXPECT_FALSE(task.Admit());
+  EXPECT_EQ(task.active_connections(), 0);
+
+  has_headroom = true;
+  EXPECT_TRUE(task.Admit());
+  EXPECT_EQ(task.active_connections(), 1);
+}
+
+// 测试过载时快速拒绝并返回繁忙响应
+TEST(ServerTaskTest, RejectWithBusyResponse) {
+  struct event_base* base = event_base_new();
+  ASSERT_NE(base, nullptr);
+
+  ServerTask task;
+  task.set_base(base);
+  task.set_server_port(18096);
+  task.set_max_connections(1);
+  task.ListenCB = KeepConnectionCB;
+  ASSERT_TRUE(task.Init());
+
+  timeval tv = {1, 0};
+  event_base_loopexit(base, &tv);
+  std::thread loop([base]() { event_base_dispatch(base); });
+
+  evutil_socket_t client1 = ConnectLocal(18096);
+  evutil_socket_t client2 = ConnectLocal(18096);
+  ASSERT_GE(client1, 0);
+  ASSERT_GE(client2, 0);
+
+  // 第二个连接超过上限, 收到繁忙响应后被关闭
+  EXPECT_EQ(ReadUntilClose(client2), "BUSY\n");
+
+  loop.join();
+  EXPECT_EQ(task.active_connections(), 1);
+  EXPECT_EQ(task.rejected_count(), 1);
+  EXPECT_FALSE(task.paused());
+
+  evutil_closesocket(client1);
+  evutil_closesocket(client2);
+  evutil_closesocket(accepted_sock);
+  task.Close();
+  event_base_free(base);
+}
+
+// 测试过载时暂停监听, 负载下降后恢复
+TEST(ServerTaskTest, PauseAndResume) {
+  struct event_base* base = event_base_new();
+  ASSERT_NE(base, nullptr);
+
+  ServerTask task;
+  task.set_base(base);
+  task.set_server_port(18097);
+  task.set_max_connections(1);
+  task.set_overload_action(OverloadAction::kPause);
+  task.set_resume_interval_ms(50);
+  task.ListenCB = KeepConnectionCB;
+  ASSERT_TRUE(task.Init());
+
+  timeval tv = {1, 0};
+  event_base_loopexit(base, &tv);
+  std::thread loop([base]() { event_base_dispatch(base); });
+
+  evutil_socket_t client1 = ConnectLocal(18097);
+  evutil_socket_t client2 = ConnectLocal(18097);
+  ASSERT_GE(client1, 0);
+  ASSERT_GE(client2, 0);
+  EXPECT_EQ(ReadUntilClose(client2), "BUSY\n");
+  EXPECT_TRUE(task.paused());
+
+  // 连接关闭后, 定时检查恢复监听
+  task.ConnectionClosed();
+  // 负载较高时定时器可能推迟, 在事件循环退出前轮询等待
+  for (int i = 0; i < 40 && task.paused(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  EXPECT_FALSE(task.paused());
+
+  loop.join();
+  evutil_closesocket(client1);
+  evutil_closesocket(client2);
+  evutil_closesocket(accepted_sock);
+  task.Close();
+  event_base_free(base);
+}
@@ -0,0 +1,35 @@
+﻿// sha256_test.cpp
+// Sha256 类单元测试
+
+#include "include/sha256.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace crossocean;
+
+// ==================== Sha256 测试 ====================
+
+// 测试标准测试向量
+TEST(Sha256Test, KnownVectors) {
+  EXPECT_EQ(Sha256::Hex("", 0),
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(Sha256::Hex("abc", 3),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  std::string two_blocks =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  EXPECT_EQ(Sha256::Hex(two_blocks.data(), two_blocks.size()),
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+// 测试流式输入与一次输入结果一致
+TEST(Sha256Test, StreamingUpdate) {
+  std::string data(1000000, 'a');
+  Sha256 sha;
+  for (size_t pos = 0; pos < data.size(); pos += 777) {
+    sha.Update(data.data() + pos, std::min<size_t>(777, data.size() - pos));
+  }
+  EXPECT_EQ(sha.FinalHex(),
+            "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
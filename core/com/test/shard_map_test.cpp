@@ -0,0 +1,75 @@
+﻿// shard_map_test.cpp
+// ShardMap 类单元测试
+
+#include "include/shard_map.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace crossocean;
+
+// ==================== ShardMap 测试 ====================
+
+// 测试按副本数查找归属节点, 路径规范化后归属相同
+TEST(ShardMapTest, Owners) {
+  ShardMap map(64, 2);
+  EXPECT_TRUE(map.Owners("a.txt").empty());
+  map.AddNode("127.0.0.1:1");
+  map.AddNode("127.0.0.1:2");
+  map.AddNode("127.0.0.1:3");
+
+  std::vector<std::string> owners = map.Owners("dir/a.txt");
+  ASSERT_EQ(owners.size(), 2u);
+  EXPECT_NE(owners[0], owners[1]);
+  EXPECT_TRUE(map.Owns(owners[1], "dir/a.txt"));
+  EXPECT_EQ(map.Owners("./dir//a.txt"), owners);
+  EXPECT_EQ(ShardMap::Key("./dir//a.txt/"), "dir/a.txt");
+}
+
+// 测试编码和解码
+TEST(ShardMapTest, EncodeDecode) {
+  ShardMap map(32, 3);
+  map.set_version(7);
+  map.AddNode("10.0.0.1:9340");
+  map.AddNode("10.0.0.2:9340", 2.5);
+
+  ShardMap decoded;
+  ASSERT_TRUE(decoded.Decode(map.Encode()));
+  EXPECT_EQ(decoded.version(), 7u);
+  EXPECT_EQ(decoded.replicas(), 3);
+  ASSERT_EQ(decoded.size(), 2);
+  EXPECT_DOUBLE_EQ(decoded.nodes()[1].second, 2.5);
+  for (int i = 0; i < 100; ++i) {
+    std::string path = "f" + std::to_string(i);
+    EXPECT_EQ(decoded.Owners(path), map.Owners(path));
+  }
+
+  // 截断的数据解码失败, 原内容不变
+  std::string data = map.Encode();
+  EXPECT_FALSE(decoded.Decode(data.substr(0, data.size() - 1)));
+  EXPECT_EQ(decoded.size(), 2);
+}
+
+// 测试增加节点时只有约1/n的文件改变归属
+TEST(ShardMapTest, MinimalMovement) {
+  ShardMap before;
+  for (int i = 0; i < 3; ++i) before.AddNode("node" + std::to_string(i));
+  ShardMap after = before;
+  after.AddNode("node3");
+
+  int moved = 0;
+  const int kFiles = 10000;
+  for (int i = 0; i < kFiles; ++i) {
+    std::string path = "dir/file-" + std::to_string(i);
+    std::string owner = after.Owners(path)[0];
+    if (owner != before.Owners(path)[0]) {
+      ++moved;
+      // 只移到新节点
+      EXPECT_EQ(owner, "node3");
+    }
+  }
+  EXPECT_GT(moved, kFiles / 4 * 0.8);
+  EXPECT_LT(moved, kFiles / 4 * 1.2);
+}
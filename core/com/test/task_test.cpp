@@ -150,3 +150,22 @@ TEST(TaskTest, ChainedSetters) {
   EXPECT_EQ(task.sock(), 200);
   EXPECT_EQ(task.base(), (struct event_base*)0x5678);
 }
+
+// 测试优先级和截止时间
+TEST(TaskTest, PriorityAndDeadline) {
+  SimpleTask task;
+
+  // 默认普通优先级, 没有截止时间
+  EXPECT_EQ(task.priority(), TaskPriority::kNormal);
+  EXPECT_FALSE(task.has_deadline());
+  EXPECT_FALSE(task.IsExpired(Task::Clock::now()));
+
+  task.set_priority(TaskPriority::kHigh);
+  EXPECT_EQ(task.priority(), TaskPriority::kHigh);
+
+  auto now = Task::Clock::now();
+  task.set_deadline(now + std::chrono::milliseconds(50));
+  EXPECT_TRUE(task.has_deadline());
+  EXPECT_FALSE(task.IsExpired(now));
+  EXPECT_TRUE(task.IsExpired(now + std::chrono::milliseconds(50)));
+}
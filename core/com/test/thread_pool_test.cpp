@@ -168,3 +168,48 @@ TEST(ThreadPoolTest, ManyTasksDispatch) {
 
   EXPECT_EQ(success_count, task_count);
 }
+
+// 测试批量分发: 按轮询策略划分, 所有任务都被执行
+TEST(ThreadPoolTest, DispatchBatch) {
+  ThreadPool* pool = ThreadPool::GetInstance();
+  pool->Init(3);
+
+  // 线程池是单例, 轮询位置和线程编号延续自之前的测试,
+  // 先分发一个探测任务, 之后的顺序都相对它断言
+  SimpleTask* probe = new SimpleTask();
+  pool->Dispatch(probe);
+
+  const int task_count = 300;
+  std::vector<SimpleTask*> tasks;
+  std::vector<Task*> batch;
+  for (int i = 0; i < task_count; ++i) {
+    tasks.push_back(new SimpleTask());
+    batch.push_back(tasks.back());
+  }
+  // 空指针被忽略
+  batch.push_back(nullptr);
+  pool->DispatchBatch(batch);
+
+  // 之后的逐个分发接着轮询顺序
+  SimpleTask* next = new SimpleTask();
+  pool->Dispatch(next);
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  ASSERT_TRUE(probe->IsInitCalled());
+  ASSERT_TRUE(next->IsInitCalled());
+  for (int i = 0; i < task_count; ++i) {
+    EXPECT_TRUE(tasks[i]->IsInitCalled());
+    // 与逐个分发的轮询顺序相同: 每3个任务回到同一个线程, 每个线程100个
+    if (i >= 3) {
+      EXPECT_EQ(tasks[i]->thread_id(), tasks[i - 3]->thread_id());
+    }
+  }
+  // 探测任务在批量的前一个位置, 下一个任务在批量的后一个位置
+  EXPECT_EQ(probe->thread_id(), tasks[2]->thread_id());
+  EXPECT_EQ(next->thread_id(), tasks[task_count - 3]->thread_id());
+  EXPECT_EQ(pool->task_count(), 0);
+
+  delete probe;
+  delete next;
+  for (auto* task : tasks) delete task;
+}
@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -27,6 +28,29 @@ class SimpleTask : public Task {
   bool init_called_ = false;
 };
 
+// 记录执行顺序的任务类
+class OrderTask : public Task {
+ public:
+  OrderTask(int tag, std::vector<int>* order, std::mutex* order_mutex)
+      : tag_(tag), order_(order), order_mutex_(order_mutex) {}
+
+  bool Init() override {
+    std::lock_guard<std::mutex> lock(*order_mutex_);
+    order_->push_back(tag_);
+    return true;
+  }
+
+  void OnExpired() override { expired_ = true; }
+
+  bool IsExpiredCalled() const { return expired_; }
+
+ private:
+  int tag_;
+  std::vector<int>* order_;
+  std::mutex* order_mutex_;
+  bool expired_ = false;
+};
+
 // ==================== Thread 测试 ====================
 
 // 测试线程对象的创建和基本功能
@@ -135,3 +159,219 @@ TEST(ThreadTest, AddNullTask) {
 
   delete task;
 }
+
+// 测试严格优先级: 高优先级任务先于先入队的低优先级任务执行
+TEST(ThreadTest, StrictPriorityDrain) {
+  Thread thread;
+  thread.id_ = 1;
+  thread.set_drain_policy(DrainPolicy::kStrict);
+  thread.Start();
+
+  std::vector<int> order;
+  std::mutex order_mutex;
+  std::vector<OrderTask*> tasks;
+  const TaskPriority priorities[] = {TaskPriority::kLow, TaskPriority::kNormal,
+                                     TaskPriority::kHigh};
+  for (int i = 0; i < 3; ++i) {
+    OrderTask* task = new OrderTask(i, &order, &order_mutex);
+    task->set_priority(priorities[i]);
+    tasks.push_back(task);
+    thread.AddTask(task);
+  }
+  for (int i = 0; i < 3; ++i) thread.Activate();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  std::lock_guard<std::mutex> lock(order_mutex);
+  ASSERT_EQ(order.size(), 3u);
+  EXPECT_EQ(order[0], 2);
+  EXPECT_EQ(order[1], 1);
+  EXPECT_EQ(order[2], 0);
+  for (auto* task : tasks) delete task;
+}
+
+// 测试加权公平: 高优先级任务积压时低优先级任务仍按权重得到执行
+TEST(ThreadTest, WeightedPriorityDrain) {
+  Thread thread;
+  thread.id_ = 1;
+  thread.set_lane_weight(TaskPriority::kHigh, 2);
+  thread.set_lane_weight(TaskPriority::kLow, 1);
+  thread.Start();
+
+  std::vector<int> order;
+  std::mutex order_mutex;
+  std::vector<OrderTask*> tasks;
+  // 先放入1个低优先级任务, 再放入4个高优先级任务
+  OrderTask* low = new OrderTask(0, &order, &order_mutex);
+  low->set_priority(TaskPriority::kLow);
+  tasks.push_back(low);
+  thread.AddTask(low);
+  for (int i = 1; i <= 4; ++i) {
+    OrderTask* task = new OrderTask(i, &order, &order_mutex);
+    task->set_priority(TaskPriority::kHigh);
+    tasks.push_back(task);
+    thread.AddTask(task);
+  }
+  for (int i = 0; i < 5; ++i) thread.Activate();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  std::lock_guard<std::mutex> lock(order_mutex);
+  ASSERT_EQ(order.size(), 5u);
+  // 每轮高优先级最多执行2个, 之后轮到低优先级任务
+  EXPECT_EQ(order[0], 1);
+  EXPECT_EQ(order[1], 2);
+  EXPECT_EQ(order[2], 0);
+  for (auto* task : tasks) delete task;
+}
+
+// 测试超时任务被丢弃且不会执行
+TEST(ThreadTest, ExpiredTaskDropped) {
+  Thread thread;
+  thread.id_ = 1;
+  thread.Start();
+
+  std::vector<int> order;
+  std::mutex order_mutex;
+  OrderTask* expired = new OrderTask(0, &order, &order_mutex);
+  expired->set_deadline(Task::Clock::now() - std::chrono::milliseconds(1));
+  OrderTask* alive = new OrderTask(1, &order, &order_mutex);
+  alive->set_timeout(std::chrono::seconds(10));
+  thread.AddTask(expired);
+  thread.AddTask(alive);
+  thread.Activate();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  EXPECT_TRUE(expired->IsExpiredCalled());
+  EXPECT_FALSE(alive->IsExpiredCalled());
+  EXPECT_EQ(thread.expired_count(), 1);
+  {
+    std::lock_guard<std::mutex> lock(order_mutex);
+    ASSERT_EQ(order.size(), 1u);
+    EXPECT_EQ(order[0], 1);
+  }
+  delete expired;
+  delete alive;
+}
+
+// 测试超时任务降级到最低优先级通道后仍会执行
+TEST(ThreadTest, ExpiredTaskDemoted) {
+  Thread thread;
+  thread.id_ = 1;
+  thread.set_drain_policy(DrainPolicy::kStrict);
+  thread.set_expire_policy(ExpirePolicy::kDemote);
+  thread.Start();
+
+  std::vector<int> order;
+  std::mutex order_mutex;
+  OrderTask* expired = new OrderTask(0, &order, &order_mutex);
+  expired->set_priority(TaskPriority::kHigh);
+  expired->set_deadline(Task::Clock::now() - std::chrono::milliseconds(1));
+  OrderTask* normal = new OrderTask(1, &order, &order_mutex);
+  thread.AddTask(expired);
+  thread.AddTask(normal);
+  thread.Activate();
+  thread.Activate();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  EXPECT_FALSE(expired->IsExpiredCalled());
+  EXPECT_EQ(thread.expired_count(), 0);
+  {
+    std::lock_guard<std::mutex> lock(order_mutex);
+    ASSERT_EQ(order.size(), 2u);
+    EXPECT_EQ(order[0], 1);
+    EXPECT_EQ(order[1], 0);
+  }
+  delete expired;
+  delete normal;
+}
+
+// 测试忙等待: 自旋期间分发的任务不写管道, 空闲后停止自旋
+TEST(ThreadTest, BusyPollSkipsWakeups) {
+  // 自旋线程在测试结束后仍可能访问线程对象, 不释放
+  Thread* thread = new Thread();
+  thread->id_ = 1;
+  BusyPollOptions options;
+  options.spin_us = 200000;
+  options.min_spin_us = 200000;
+  thread->set_busy_poll(options);
+  thread->Start();
+
+  std::vector<int> order;
+  std::mutex order_mutex;
+  std::vector<OrderTask*> tasks;
+  // 第一个任务经管道唤醒, 之后线程开始自旋
+  tasks.push_back(new OrderTask(0, &order, &order_mutex));
+  thread->AddTask(tasks[0]);
+  thread->Activate();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  const int kTasks = 50;
+  for (int i = 1; i <= kTasks; ++i) {
+    tasks.push_back(new OrderTask(i, &order, &order_mutex));
+    thread->AddTask(tasks[i]);
+    thread->Activate();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(thread->skipped_activations(), kTasks);
+  {
+    std::lock_guard<std::mutex> lock(order_mutex);
+    ASSERT_EQ(order.size(), static_cast<size_t>(kTasks + 1));
+    for (int i = 0; i <= kTasks; ++i) EXPECT_EQ(order[i], i);
+  }
+
+  // 空闲超过自旋时间后阻塞等待, 新任务经管道唤醒
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  EXPECT_EQ(thread->spin_hits(), 1);
+  long long sleeps = thread->sleep_count();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(thread->sleep_count(), sleeps);
+  tasks.push_back(new OrderTask(kTasks + 1, &order, &order_mutex));
+  thread->AddTask(tasks.back());
+  thread->Activate();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(thread->skipped_activations(), kTasks);
+  {
+    std::lock_guard<std::mutex> lock(order_mutex);
+    EXPECT_EQ(order.size(), static_cast<size_t>(kTasks + 2));
+  }
+
+  // 关闭忙等待
+  thread->set_busy_poll(BusyPollOptions());
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  for (auto* task : tasks) delete task;
+}
+
+// 测试批量添加任务后一次激活多个任务
+TEST(ThreadTest, AddTasksAndActivateMany) {
+  Thread* thread = new Thread();
+  thread->id_ = 1;
+  thread->Start();
+
+  std::vector<int> order;
+  std::mutex order_mutex;
+  std::vector<OrderTask*> tasks;
+  std::vector<Task*> batch;
+  // 超过一次读取的信号数
+  const int kTasks = 200;
+  for (int i = 0; i < kTasks; ++i) {
+    tasks.push_back(new OrderTask(i, &order, &order_mutex));
+    batch.push_back(tasks.back());
+  }
+  batch.push_back(nullptr);
+  thread->AddTasks(batch);
+  EXPECT_EQ(thread->task_count(), kTasks);
+  EXPECT_EQ(tasks[0]->thread_id(), 1);
+  thread->Activate(kTasks);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_EQ(thread->task_count(), 0);
+  {
+    std::lock_guard<std::mutex> lock(order_mutex);
+    ASSERT_EQ(order.size(), static_cast<size_t>(kTasks));
+    for (int i = 0; i < kTasks; ++i) EXPECT_EQ(order[i], i);
+  }
+  for (auto* task : tasks) delete task;
+}
@@ -0,0 +1,225 @@
+﻿// tls_test.cpp
+// TlsContext / TlsConnection 类单元测试
+
+#include "include/tls.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 阻塞socket上完成握手
+static bool DoHandshake(TlsConnection* connection) {
+  TlsStatus status = connection->Handshake();
+  while (status == TlsStatus::kWantRead || status == TlsStatus::kWantWrite) {
+    status = connection->Handshake();
+  }
+  return status == TlsStatus::kDone;
+}
+
+// 读取 len 字节
+static std::string ReadAll(TlsConnection* connection, size_t len) {
+  std::string data;
+  char buf[16 * 1024];
+  while (data.size() < len) {
+    TlsStatus status;
+    long long n = connection->Read(buf, sizeof(buf), &status);
+    if (status != TlsStatus::kDone) break;
+    data.append(buf, n);
+  }
+  return data;
+}
+
+// 写入测试文件
+static std::string WriteTestFile(const fs::path& path, size_t size) {
+  std::string content(size, '\0');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = static_cast<char>(i * 31);
+  }
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(content.data(), content.size());
+  return content;
+}
+
+// 服务器发送整个文件
+static void SendWholeFile(TlsConnection* connection, const fs::path& path,
+                          size_t size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  long long offset = 0;
+  while (offset < static_cast<long long>(size)) {
+    TlsStatus status;
+    long long n = connection->SendFile(fd, offset, size - offset, &status);
+    if (status != TlsStatus::kDone || n <= 0) break;
+    offset += n;
+  }
+  close(fd);
+}
+
+// 在一对socket上运行服务器和客户端, 服务器回显客户端发送的消息
+static void EchoOnce(TlsContext* server_ctx, TlsContext* client_ctx,
+                     const std::string& peer, bool* reused,
+                     std::string* version) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  std::thread server([&] {
+    TlsConnection connection(server_ctx, fds[0]);
+    if (!DoHandshake(&connection)) return;
+    std::string message = ReadAll(&connection, 5);
+    TlsStatus status;
+    connection.Write(message.data(), message.size(), &status);
+    connection.Shutdown();
+  });
+
+  TlsConnection client(client_ctx, fds[1], peer);
+  ASSERT_TRUE(DoHandshake(&client));
+  TlsStatus status;
+  EXPECT_EQ(client.Write("hello", 5, &status), 5);
+  EXPECT_EQ(ReadAll(&client, 5), "hello");
+  *reused = client.session_reused();
+  *version = client.version();
+  client.Shutdown();
+
+  server.join();
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// ==================== TlsContext / TlsConnection 测试 ====================
+
+// 测试握手和加密收发
+TEST(TlsTest, HandshakeAndEcho) {
+  TlsContext server_ctx, client_ctx;
+  ASSERT_TRUE(server_ctx.InitSelfSigned("localhost"));
+  ASSERT_TRUE(client_ctx.InitClient());
+  EXPECT_TRUE(server_ctx.is_server());
+  EXPECT_TRUE(server_ctx.ktls());
+
+  bool reused = true;
+  std::string version;
+  EchoOnce(&server_ctx, &client_ctx, "", &reused, &version);
+  EXPECT_FALSE(reused);
+  EXPECT_EQ(version, "TLSv1.3");
+  EXPECT_EQ(server_ctx.stats().handshakes, 1);
+}
+
+// 测试重连时复用会话
+TEST(TlsTest, SessionResumption) {
+  TlsContext server_ctx, client_ctx;
+  ASSERT_TRUE(server_ctx.InitSelfSigned("localhost"));
+  ASSERT_TRUE(client_ctx.InitClient());
+
+  bool reused = true;
+  std::string version;
+  EchoOnce(&server_ctx, &client_ctx, "server:1", &reused, &version);
+  EXPECT_FALSE(reused);
+  EchoOnce(&server_ctx, &client_ctx, "server:1", &reused, &version);
+  EXPECT_TRUE(reused);
+  // 不同的对端不复用会话
+  EchoOnce(&server_ctx, &client_ctx, "server:2", &reused, &version);
+  EXPECT_FALSE(reused);
+
+  TlsStats stats = server_ctx.stats();
+  EXPECT_EQ(stats.handshakes, 3);
+  EXPECT_EQ(stats.resumed, 1);
+}
+
+// 测试发送文件(不支持kTLS时回退到用户态加密)
+TEST(TlsTest, SendFile) {
+  fs::path path = fs::temp_directory_path() / "tls_test_sendfile.bin";
+  std::string content = WriteTestFile(path, 300 * 1024);
+
+  TlsContext server_ctx, client_ctx;
+  ASSERT_TRUE(server_ctx.InitSelfSigned("localhost"));
+  ASSERT_TRUE(client_ctx.InitClient());
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  bool ktls_send = true;
+  std::thread server([&] {
+    TlsConnection connection(&server_ctx, fds[0]);
+    if (!DoHandshake(&connection)) return;
+    ktls_send = connection.ktls_send();
+    SendWholeFile(&connection, path, content.size());
+  });
+
+  TlsConnection client(&client_ctx, fds[1]);
+  ASSERT_TRUE(DoHandshake(&client));
+  EXPECT_EQ(ReadAll(&client, content.size()), content);
+  server.join();
+  // kTLS只支持TCP, Unix socket上不调用`SSL_sendfile`
+  EXPECT_FALSE(ktls_send);
+  EXPECT_EQ(server_ctx.stats().ktls_sendfile_bytes, 0);
+  close(fds[0]);
+  close(fds[1]);
+  fs::remove(path);
+}
+
+// 测试kTLS: 支持时TCP连接握手后启用kTLS发送, 用`SSL_sendfile`零拷贝发送文件
+TEST(TlsTest, KtlsSendFile) {
+  std::string reason;
+  if (!TlsContext::KtlsSupported(&reason)) {
+    EXPECT_FALSE(reason.empty());
+    GTEST_SKIP() << "kTLS is not available: " << reason;
+  }
+  fs::path path = fs::temp_directory_path() / "tls_test_ktls.bin";
+  std::string content = WriteTestFile(path, 300 * 1024);
+
+  TlsContext server_ctx, client_ctx;
+  ASSERT_TRUE(server_ctx.InitSelfSigned("localhost"));
+  ASSERT_TRUE(client_ctx.InitClient());
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(bind(listen_fd, (sockaddr*)&addr, sizeof(addr)), 0);
+  ASSERT_EQ(listen(listen_fd, 1), 0);
+  ASSERT_EQ(getsockname(listen_fd, (sockaddr*)&addr, &addr_len), 0);
+  int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(connect(client_fd, (sockaddr*)&addr, sizeof(addr)), 0);
+  int server_fd = accept(listen_fd, nullptr, nullptr);
+  ASSERT_GE(server_fd, 0);
+
+  bool ktls_send = false;
+  std::thread server([&] {
+    TlsConnection connection(&server_ctx, server_fd);
+    if (!DoHandshake(&connection)) return;
+    ktls_send = connection.ktls_send();
+    SendWholeFile(&connection, path, content.size());
+  });
+
+  TlsConnection client(&client_ctx, client_fd);
+  ASSERT_TRUE(DoHandshake(&client));
+  EXPECT_EQ(ReadAll(&client, content.size()), content);
+  server.join();
+  EXPECT_TRUE(ktls_send) << client.cipher();
+  EXPECT_EQ(server_ctx.stats().ktls_send, 1);
+  EXPECT_EQ(server_ctx.stats().ktls_sendfile_bytes,
+            static_cast<long long>(content.size()));
+  close(client_fd);
+  close(server_fd);
+  close(listen_fd);
+  fs::remove(path);
+}
+
+// 测试证书文件不存在时初始化失败
+TEST(TlsTest, InvalidCertificate) {
+  TlsContext ctx;
+  EXPECT_FALSE(ctx.InitServer("/nonexistent/cert.pem", "/nonexistent/key.pem"));
+  EXPECT_EQ(ctx.native(), nullptr);
+
+  // 未初始化的配置不能创建连接
+  TlsConnection connection(&ctx, -1);
+  EXPECT_EQ(connection.Handshake(), TlsStatus::kError);
+}
@@ -0,0 +1,282 @@
+﻿// volume_test.cpp
+// Volume 和 VolumeStore 类单元测试
+
+#include "include/volume.h"
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "include/blocking_pool.h"
+
+using namespace crossocean;
+namespace fs = std::filesystem;
+
+// 创建卷目录
+class VolumeTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = fs::temp_directory_path() / "volume_test";
+    fs::remove_all(dir_);
+    fs::create_directories(dir_);
+  }
+
+  void TearDown() override { fs::remove_all(dir_); }
+
+  // 生成小文件内容
+  static std::string Content(int i, size_t len = 100) {
+    std::string data(len + i % 13, '\0');
+    for (size_t j = 0; j < data.size(); ++j) {
+      data[j] = static_cast<char>(i * 17 + j);
+    }
+    return data;
+  }
+
+  fs::path dir_;
+};
+
+// ==================== Volume 测试 ====================
+
+// 测试追加、读取、覆盖和删除
+TEST_F(VolumeTest, AppendReadRemove) {
+  Volume volume((dir_ / "1.vol").string());
+  ASSERT_TRUE(volume.Open());
+
+  ASSERT_TRUE(volume.Append("a.txt", "hello", 5));
+  ASSERT_TRUE(volume.Append("b.txt", "", 0));
+  std::string data;
+  ASSERT_TRUE(volume.Read("a.txt", &data));
+  EXPECT_EQ(data, "hello");
+  ASSERT_TRUE(volume.Read("b.txt", &data));
+  EXPECT_EQ(data, "");
+  EXPECT_FALSE(volume.Read("c.txt", &data));
+
+  // 覆盖后旧记录成为垃圾
+  ASSERT_TRUE(volume.Append("a.txt", "world!", 6));
+  ASSERT_TRUE(volume.Read("a.txt", &data));
+  EXPECT_EQ(data, "world!");
+  VolumeStats stats = volume.stats();
+  EXPECT_EQ(stats.needles, 2);
+  EXPECT_GT(stats.garbage_bytes, 0);
+  // 记录按8字节对齐
+  EXPECT_EQ(stats.file_size % 8, 0);
+
+  ASSERT_TRUE(volume.Remove("a.txt"));
+  EXPECT_FALSE(volume.Remove("a.txt"));
+  EXPECT_FALSE(volume.Read("a.txt", &data));
+  EXPECT_EQ(volume.stats().needles, 1);
+  EXPECT_FALSE(volume.Append("", "x", 1));
+}
+
+// 测试重新打开时扫描重建索引, 截断写了一半的记录
+TEST_F(VolumeTest, ReopenRebuildsIndex) {
+  std::string path = (dir_ / "1.vol").string();
+  long long good_size = 0;
+  {
+    Volume volume(path);
+    ASSERT_TRUE(volume.Open());
+    for (int i = 0; i < 200; ++i) {
+      std::string data = Content(i);
+      ASSERT_TRUE(volume.Append("k" + std::to_string(i), data.data(),
+                                data.size()));
+    }
+    ASSERT_TRUE(volume.Remove("k5"));
+    ASSERT_TRUE(volume.Append("k6", "new", 3));
+    ASSERT_TRUE(volume.Sync());
+    good_size = volume.stats().file_size;
+  }
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out.write("NDL1\0\x03\x00\xff\x00\x00\x00" "abc", 14);
+  }
+
+  Volume volume(path);
+  ASSERT_TRUE(volume.Open());
+  EXPECT_EQ(static_cast<long long>(fs::file_size(path)), good_size);
+  EXPECT_EQ(volume.stats().needles, 199);
+  std::string data;
+  EXPECT_FALSE(volume.Read("k5", &data));
+  ASSERT_TRUE(volume.Read("k6", &data));
+  EXPECT_EQ(data, "new");
+  ASSERT_TRUE(volume.Read("k150", &data));
+  EXPECT_EQ(data, Content(150));
+}
+
+// 测试校验和不匹配时读取失败
+TEST_F(VolumeTest, DetectsCorruption) {
+  std::string path = (dir_ / "1.vol").string();
+  Volume volume(path);
+  ASSERT_TRUE(volume.Open());
+  std::string content = Content(1);
+  ASSERT_TRUE(volume.Append("x", content.data(), content.size()));
+  NeedleRef ref;
+  ASSERT_TRUE(volume.Lookup("x", &ref));
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(ref.offset + 10);
+    file.put('~');
+  }
+  std::string data;
+  EXPECT_FALSE(volume.Read("x", &data));
+}
+
+// 测试合并回收垃圾, 合并前取得的引用仍可读取
+TEST_F(VolumeTest, CompactReclaimsSpace) {
+  std::string path = (dir_ / "1.vol").string();
+  Volume volume(path);
+  ASSERT_TRUE(volume.Open());
+  for (int i = 0; i < 100; ++i) {
+    std::string data = Content(i, 1000);
+    ASSERT_TRUE(volume.Append("k" + std::to_string(i), data.data(),
+                              data.size()));
+  }
+  for (int i = 0; i < 50; ++i) {
+    std::string data = Content(i + 1000, 1000);
+    ASSERT_TRUE(volume.Append("k" + std::to_string(i), data.data(),
+                              data.size()));
+  }
+  for (int i = 50; i < 75; ++i) {
+    ASSERT_TRUE(volume.Remove("k" + std::to_string(i)));
+  }
+  NeedleRef old_ref;
+  ASSERT_TRUE(volume.Lookup("k0", &old_ref));
+  VolumeStats before = volume.stats();
+  EXPECT_GT(before.garbage_ratio(), 0.4);
+
+  ASSERT_TRUE(volume.Compact());
+  VolumeStats after = volume.stats();
+  EXPECT_EQ(after.needles, 75);
+  EXPECT_EQ(after.garbage_bytes, 0);
+  EXPECT_EQ(after.compactions, 1);
+  EXPECT_LT(after.file_size, before.file_size * 6 / 10);
+  EXPECT_EQ(static_cast<long long>(fs::file_size(path)), after.file_size);
+
+  std::string data;
+  for (int i = 0; i < 100; ++i) {
+    std::string key = "k" + std::to_string(i);
+    if (i >= 50 && i < 75) {
+      EXPECT_FALSE(volume.Read(key, &data));
+    } else {
+      ASSERT_TRUE(volume.Read(key, &data)) << key;
+      EXPECT_EQ(data, Content(i < 50 ? i + 1000 : i, 1000));
+    }
+  }
+
+  // 旧文件仍然打开, 合并前的引用读到的是旧位置上的数据
+  std::string old_data(old_ref.length, '\0');
+  ASSERT_EQ(pread(old_ref.file->fd, &old_data[0], old_data.size(),
+                  old_ref.offset),
+            old_ref.length);
+  EXPECT_EQ(old_data, Content(1000, 1000));
+
+  // 合并后重新打开结果一致
+  Volume reopened(path);
+  ASSERT_TRUE(reopened.Open());
+  EXPECT_EQ(reopened.stats().needles, 75);
+}
+
+// 测试用`sendfile`从卷文件发送小文件
+TEST_F(VolumeTest, SendFromVolume) {
+  Volume volume((dir_ / "1.vol").string());
+  ASSERT_TRUE(volume.Open());
+  std::string content = Content(7, 5000);
+  ASSERT_TRUE(volume.Append("send", content.data(), content.size()));
+  NeedleRef ref;
+  ASSERT_TRUE(volume.Lookup("send", &ref));
+
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  long long pos = 100;
+  while (pos < ref.length) {
+    long long sent = Volume::Send(fds[0], ref, pos);
+    ASSERT_GT(sent, 0);
+    pos += sent;
+  }
+  EXPECT_EQ(Volume::Send(fds[0], ref, pos), 0);
+  std::string received(content.size() - 100, '\0');
+  size_t total = 0;
+  while (total < received.size()) {
+    ssize_t n = read(fds[1], &received[total], received.size() - total);
+    ASSERT_GT(n, 0);
+    total += n;
+  }
+  EXPECT_EQ(received, content.substr(100));
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// ==================== VolumeStore 测试 ====================
+
+// 测试小文件写满一个卷后创建新卷, 重新打开后以新卷中的记录为准
+TEST_F(VolumeTest, StoreRollsVolumes) {
+  fs::path store_dir = dir_ / "store";
+  {
+    VolumeStore store(store_dir.string(), nullptr, 4096, 64 * 1024);
+    ASSERT_TRUE(store.Open());
+    EXPECT_TRUE(store.Accepts(4095));
+    EXPECT_FALSE(store.Accepts(4096));
+    std::string big(4096, 'b');
+    EXPECT_FALSE(store.Put("big", big.data(), big.size()));
+
+    for (int i = 0; i < 300; ++i) {
+      std::string data = Content(i, 1000);
+      ASSERT_TRUE(store.Put("f" + std::to_string(i), data.data(), data.size()));
+    }
+    EXPECT_GT(store.volume_count(), 1);
+    // 覆盖旧卷中的小文件
+    ASSERT_TRUE(store.Put("f0", "updated", 7));
+    ASSERT_TRUE(store.Remove("f1"));
+    EXPECT_EQ(store.size(), 299);
+  }
+
+  VolumeStore store(store_dir.string(), nullptr, 4096, 64 * 1024);
+  ASSERT_TRUE(store.Open());
+  EXPECT_EQ(store.size(), 299);
+  std::string data;
+  ASSERT_TRUE(store.Get("f0", &data));
+  EXPECT_EQ(data, "updated");
+  EXPECT_FALSE(store.Get("f1", &data));
+  ASSERT_TRUE(store.Get("f299", &data));
+  EXPECT_EQ(data, Content(299, 1000));
+  NeedleRef ref;
+  ASSERT_TRUE(store.Lookup("f299", &ref));
+  EXPECT_EQ(ref.length, static_cast<long long>(data.size()));
+}
+
+// 测试垃圾占比超过阈值的卷在阻塞I/O线程池中合并
+TEST_F(VolumeTest, StoreBackgroundCompaction) {
+  BlockingPool pool;
+  pool.Init(1);
+  {
+    VolumeStore store((dir_ / "bg").string(), &pool, 4096,
+                      1024 * 1024 * 1024, 0.3);
+    ASSERT_TRUE(store.Open());
+    for (int i = 0; i < 100; ++i) {
+      std::string data = Content(i, 1000);
+      ASSERT_TRUE(store.Put("f" + std::to_string(i), data.data(), data.size()));
+    }
+    EXPECT_EQ(store.CompactIfNeeded(), 0);
+    for (int i = 0; i < 50; ++i) {
+      ASSERT_TRUE(store.Remove("f" + std::to_string(i)));
+    }
+    EXPECT_EQ(store.CompactIfNeeded(), 1);
+    // 合并期间继续读写
+    ASSERT_TRUE(store.Put("during", "x", 1));
+    store.WaitCompaction();
+
+    auto stats = store.stats();
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].compactions, 1);
+    EXPECT_LT(stats[0].garbage_ratio(), 0.3);
+    std::string data;
+    ASSERT_TRUE(store.Get("during", &data));
+    ASSERT_TRUE(store.Get("f99", &data));
+    EXPECT_EQ(data, Content(99, 1000));
+    EXPECT_FALSE(store.Get("f0", &data));
+  }
+  pool.Stop();
+}
@@ -12,9 +12,13 @@
 #include <event2/event.h>
 #include <event2/thread.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <thread>
 
+#include "channel.h"
 #include "task.h"
 
 #ifndef _WIN32  // Unix/Linux 系统
@@ -24,14 +28,27 @@
 using namespace std;
 USING_CROSSOCEAN_NAMESPACE
 
+/// @brief 激活线程执行一个任务的信号
+static const char kActivateSignal = 'c';
+/// @brief 消息通道有新消息的信号
+static const char kChannelSignal = 'm';
+/// @brief 停止线程的信号
+static const char kStopSignal = 's';
+/// @brief 每次读写管道的最大信号数
+static const int kMaxSignalsPerRead = 64;
+
 Thread::Thread() {}
 
-Thread::~Thread() {}
+Thread::~Thread() {
+  // 没有停止的线程继续在后台运行
+  if (thread_.joinable()) thread_.detach();
+}
 
 /**
  * @brief 启动线程
  *
- * @details 安装线程, 启动线程并绑定入口函数, 然后分离线程使其在后台运行
+ * @details 安装线程, 启动线程并绑定入口函数, 线程在后台运行.
+ * 没有调用`Stop`的线程在对象销毁时分离
  *
  */
 void Thread::Start() {
@@ -39,10 +56,34 @@ void Thread::Start() {
   Setup();
 
   // 启动线程，绑定Main函数为线程入口
-  std::thread t(&Thread::Main, this);
+  thread_ = std::thread(&Thread::Main, this);
+}
 
-  // 分离线程，使其在后台运行
-  t.detach();
+/**
+ * @brief 停止线程并等待线程退出
+ *
+ * @details 停止信号不受自旋影响, 总是写入管道,
+ * 线程读到后在自己的事件循环中退出(无锁的`event_base`只能在本线程中操作)
+ */
+void Thread::Stop() {
+  if (!thread_.joinable()) return;
+#ifdef _WIN32
+  int re = send(notify_send_fd_, &kStopSignal, 1, 0);
+#else
+  ssize_t re = write(notify_send_fd_, &kStopSignal, 1);
+#endif
+  if (re <= 0) {
+    cerr << "Thread::Stop() Thread " << id_
+         << " failed to send stop signal." << endl;
+    thread_.detach();
+    return;
+  }
+  thread_.join();
+  // 线程已退出, 之后的激活写入失败而不是写到重用的描述符
+  evutil_closesocket(notify_recv_fd_);
+  evutil_closesocket(notify_send_fd_);
+  notify_recv_fd_ = -1;
+  notify_send_fd_ = -1;
 }
 
 /**
@@ -57,8 +98,38 @@ void Thread::Main() {
 
   cout << "Thread::Main() Thread " << id_ << " begin." << endl;
   // 运行事件循环，等待事件发生
-  event_base_dispatch(base_);
+  // 每一轮阻塞等待之前轮询消息通道, 处理事件期间到达的消息不需要唤醒
+  for (;;) {
+    PollChannels();
+    int spin_us = spin_us_;
+    if (spin_window_us_ > spin_us) spin_window_us_ = spin_us;
+    // 自旋结束时已经空闲了一个自旋时间
+    chrono::microseconds idle(0);
+    if (spin_window_us_ > 0) {
+      Spin();
+      idle = chrono::microseconds(spin_window_us_);
+    }
+    if (event_base_got_break(base_) || event_base_got_exit(base_)) break;
+    ++sleep_count_;
+    auto sleep_begin = chrono::steady_clock::now();
+    if (event_base_loop(base_, EVLOOP_ONCE) != 0) break;
+    if (event_base_got_break(base_) || event_base_got_exit(base_)) break;
+    if (spin_us <= 0) continue;
+    // 自适应: 空闲时间(自旋加阻塞)不超过最长自旋时间说明工作间隔短,
+    // 自旋能接住下一个工作; 否则自旋时间减半, 低于最短自旋时间后不再自旋
+    idle += chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - sleep_begin);
+    if (idle <= chrono::microseconds(spin_us)) {
+      spin_window_us_ = spin_us;
+    } else {
+      spin_window_us_ /= 2;
+      if (spin_window_us_ < min_spin_us_) spin_window_us_ = 0;
+    }
+  }
+  event_free(notify_event_);
+  notify_event_ = nullptr;
   event_base_free(base_);
+  base_ = nullptr;
   cout << "Thread::Main() Thread " << id_ << " end." << endl;
 }
 
@@ -108,6 +179,7 @@ bool Thread::Setup() {
 
   // 读取绑定到 event_base 上，写入要保存
   notify_send_fd_ = fds[1];
+  notify_recv_fd_ = fds[0];
 
   // 创建 event_base 对象(无锁版)
   event_config* ev_conf = event_config_new();
@@ -123,13 +195,13 @@ bool Thread::Setup() {
   }
 
   // 添加管道监听事件到 event_base,用于激活线程执行任务
-  event* notify_event =
+  notify_event_ =
       event_new(base_,                 // event_base
                 fds[0],                // 读取端
                 EV_READ | EV_PERSIST,  // 监听可读事件且持续监听
                 NotifyCB,              // 事件回调函数
                 this);                 // 回调函数参数(传入当前线程对象指针)
-  event_add(notify_event, nullptr);
+  event_add(notify_event_, nullptr);
   return true;
 }
 
@@ -141,38 +213,224 @@ bool Thread::Setup() {
  * @param fd  管道读取端文件描述符
  * @param events  事件类型
  */
-void Thread::Notify(evutil_socket_t fd, short events) {
+void Thread::Notify(evutil_socket_t fd, short /*events*/) {
   // 水平触发模式下循环读取数据(直到接受完毕)
-  char buf[1] = {0};
+  // 一次读取多个信号, 批量分发的任务只需一次唤醒
+  char buf[kMaxSignalsPerRead] = {0};
 #ifdef _WIN32
   // Windows 下用 recv 读取数据
-  int re = recv(fd, buf, 1, 0);
+  int re = recv(fd, buf, sizeof(buf), 0);
 #else
   // Unix/Linux 下用 read 读取数据
-  ssize_t re = read(fd, buf, 1);
+  ssize_t re = read(fd, buf, sizeof(buf));
 #endif
   // 读取数据以清除事件
   if (re <= 0) {
     return;
   }
+  // 停止信号: 先执行同一批中停止之前的激活, 然后退出事件循环,
+  // 之后的信号和任务不再处理
+  char* end = find(buf, buf + re, kStopSignal);
+  if (end != buf + re) event_base_loopbreak(base_);
+  // 每个激活信号执行一个任务
+  // 消息通道的唤醒信号跳过, 返回事件循环后轮询通道
+  int activations = static_cast<int>(count(buf, end, kActivateSignal));
+  if (activations == 0) {
+    return;
+  }
   // 在这里处理线程被激活后的任务
   cout << "Thread::Notify() Thread " << id_ << " activated." << endl;
 
+  for (int i = 0; i < activations; ++i) {
+    if (!RunTask()) {
+      cout << "Thread::Notify() Thread " << id_ << " has no tasks." << endl;
+      break;
+    }
+  }
+}
+
+/**
+ * @brief 取出并执行一个任务, 超时任务按策略处理
+ *
+ * @return true 执行了任务
+ * @return false 没有可执行的任务
+ */
+bool Thread::RunTask() {
   Task* task = nullptr;
-  // 线程安全获取任务列表
+  std::list<Task*> expired;
+  // 线程安全获取任务列表, 按优先级通道选择任务
   tasks_mutex_.lock();
-  if (tasks_.empty()) {
-    tasks_mutex_.unlock();
-    cout << "Thread::Notify() Thread " << id_ << " has no tasks." << endl;
-    return;
-  }
-  task = tasks_.front();  // 先进先出
-  tasks_.pop_front();     // 从任务列表中移除任务
+  task = PopTask(&expired);
   tasks_mutex_.unlock();
 
+  // 超时任务不再执行, 在锁外通知任务自行清理
+  for (Task* expired_task : expired) {
+    ++expired_count_;
+    cout << "Thread::Notify() Thread " << id_ << " dropped expired task."
+         << endl;
+    expired_task->OnExpired();
+  }
+
+  if (!task) {
+    return !expired.empty();
+  }
+
   // 处理任务
   cout << "Thread::Notify() Thread " << id_ << " processing task." << endl;
   task->Init();
+  return true;
+}
+
+/**
+ * @brief 阻塞之前自旋: 反复检查任务队列、消息通道和事件
+ *
+ * @details 每次发现工作后重新计时, 空转`spin_window_us_`后返回
+ */
+void Thread::Spin() {
+  using Clock = chrono::steady_clock;
+  const chrono::microseconds window(spin_window_us_);
+  Clock::time_point deadline = Clock::now() + window;
+  bool worked = false;
+  spinning_ = true;
+  while (Clock::now() < deadline) {
+    bool hit = RunTask();
+    hit = PollChannels() > 0 || hit;
+    // 非阻塞地运行一次事件循环, 用活跃事件数的最大值判断是否处理了事件
+    event_base_get_max_events(base_, EVENT_BASE_COUNT_ACTIVE, 1);
+    event_base_loop(base_, EVLOOP_NONBLOCK);
+    hit = event_base_get_max_events(base_, EVENT_BASE_COUNT_ACTIVE, 1) > 0 ||
+          hit;
+    if (event_base_got_break(base_) || event_base_got_exit(base_)) break;
+    if (hit) {
+      worked = true;
+      deadline = Clock::now() + window;
+    } else {
+      // 让出CPU, 与发送任务的线程共用CPU时不阻塞对方
+      this_thread::yield();
+    }
+  }
+  // 之后的激活和通知会写管道, 自旋期间跳过写管道的任务和消息在这里处理
+  int pending = 0;
+  {
+    lock_guard<mutex> lock(tasks_mutex_);
+    spinning_ = false;
+    for (auto& lane : tasks_) pending += static_cast<int>(lane.size());
+  }
+  for (int i = 0; i < pending; ++i) RunTask();
+  PollChannels();
+
+  if (worked) ++spin_hits_;
+}
+
+/**
+ * @brief 按调度策略选择下一个要处理的优先级通道(需持有`tasks_mutex_`)
+ *
+ * @return int 通道下标, 所有通道为空时返回-1
+ */
+int Thread::PickLane() {
+  if (drain_policy_ == DrainPolicy::kStrict) {
+    for (int lane = 0; lane < kTaskPriorityCount; ++lane) {
+      if (!tasks_[lane].empty()) return lane;
+    }
+    return -1;
+  }
+
+  // 加权公平: 按优先级顺序消耗本轮额度, 所有非空通道额度用完后开始新一轮
+  for (int round = 0; round < 2; ++round) {
+    bool has_task = false;
+    for (int lane = 0; lane < kTaskPriorityCount; ++lane) {
+      if (tasks_[lane].empty()) continue;
+      has_task = true;
+      if (lane_credits_[lane] > 0) {
+        --lane_credits_[lane];
+        return lane;
+      }
+    }
+    if (!has_task) return -1;
+    for (int lane = 0; lane < kTaskPriorityCount; ++lane) {
+      lane_credits_[lane] = lane_weights_[lane];
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief 取出下一个要执行的任务(需持有`tasks_mutex_`)
+ *
+ * @details 超时任务按`expire_policy_`丢弃或降级, 丢弃的任务放入`expired`
+ *
+ * @param expired 输出被丢弃的超时任务
+ * @return Task* 下一个要执行的任务, 没有任务时返回`nullptr`
+ */
+Task* Thread::PopTask(std::list<Task*>* expired) {
+  const int lowest_lane = kTaskPriorityCount - 1;
+  Task::Clock::time_point now = Task::Clock::now();
+  for (;;) {
+    int lane = PickLane();
+    if (lane < 0) return nullptr;
+    Task* task = tasks_[lane].front();  // 同一通道内先进先出
+    tasks_[lane].pop_front();
+    if (!task->IsExpired(now)) return task;
+
+    if (expire_policy_ == ExpirePolicy::kDrop) {
+      expired->push_back(task);
+    } else if (lane < lowest_lane) {
+      // 降级到最低优先级通道, 让未超时的任务先执行
+      tasks_[lowest_lane].push_back(task);
+    } else {
+      // 已经在最低优先级通道, 照常执行
+      return task;
+    }
+  }
+}
+
+/**
+ * @brief 获取等待执行的任务数量(所有优先级通道之和)
+ *
+ * @return int 队列中的任务数量
+ */
+int Thread::task_count() {
+  lock_guard<mutex> lock(tasks_mutex_);
+  size_t count = 0;
+  for (auto& lane : tasks_) count += lane.size();
+  return static_cast<int>(count);
+}
+
+/**
+ * @brief 设置优先级通道的调度策略(默认加权公平)
+ *
+ * @param policy 调度策略
+ */
+void Thread::set_drain_policy(DrainPolicy policy) {
+  lock_guard<mutex> lock(tasks_mutex_);
+  drain_policy_ = policy;
+}
+
+/**
+ * @brief 设置优先级通道的权重
+ *
+ * @param priority 优先级通道
+ * @param weight 权重(最小为1)
+ */
+void Thread::set_lane_weight(TaskPriority priority, int weight) {
+  int lane = static_cast<int>(priority);
+  if (lane < 0 || lane >= kTaskPriorityCount) {
+    cerr << "Thread::set_lane_weight() Invalid priority." << endl;
+    return;
+  }
+  lock_guard<mutex> lock(tasks_mutex_);
+  lane_weights_[lane] = weight < 1 ? 1 : weight;
+  lane_credits_[lane] = lane_weights_[lane];
+}
+
+/**
+ * @brief 设置超过截止时间的任务的处理策略(默认丢弃)
+ *
+ * @param policy 处理策略
+ */
+void Thread::set_expire_policy(ExpirePolicy policy) {
+  lock_guard<mutex> lock(tasks_mutex_);
+  expire_policy_ = policy;
 }
 
 /**
@@ -181,19 +439,32 @@ void Thread::Notify(evutil_socket_t fd, short events) {
  * @details 向线程发送激活消息(通过管道或者`socketpair`写入数据)
  *
  */
-void Thread::Activate() {
+void Thread::Activate(int count) {
+  if (count <= 0) return;
+  // 线程正在自旋, 会直接从队列取出任务(自旋结束时在锁内清除标记并检查队列)
+  if (spinning_) {
+    skipped_activations_ += count;
+    return;
+  }
   // 向线程发送激活消息(通过管道写入数据)
-  char buf[1] = {'c'};  // 发送一个字节的数据作为激活信号
+  // 每个任务一个字节的激活信号, 多个信号一次写入
+  char buf[kMaxSignalsPerRead];
+  memset(buf, kActivateSignal, sizeof(buf));
+  while (count > 0) {
+    int n = min(count, kMaxSignalsPerRead);
 #ifdef _WIN32
-  // Windows 下用 send 发送数据
-  int re = send(notify_send_fd_, buf, 1, 0);
+    // Windows 下用 send 发送数据
+    int re = send(notify_send_fd_, buf, n, 0);
 #else
-  // Unix/Linux 下用 write 发送数据
-  ssize_t re = write(notify_send_fd_, buf, 1);
+    // Unix/Linux 下用 write 发送数据
+    ssize_t re = write(notify_send_fd_, buf, n);
 #endif
-  if (re <= 0) {
-    cerr << "Thread::Activate() Thread " << id_
-         << " failed to send activate signal." << endl;
+    if (re <= 0) {
+      cerr << "Thread::Activate() Thread " << id_
+           << " failed to send activate signal." << endl;
+      return;
+    }
+    count -= static_cast<int>(re);
   }
 }
 
@@ -211,8 +482,122 @@ void Thread::AddTask(Task* task) {
   }
   task->set_base(base_);
   task->set_thread_id(id_);
-  // 线程安全添加任务到任务列表
+  int lane = static_cast<int>(task->priority());
+  if (lane < 0 || lane >= kTaskPriorityCount) {
+    lane = static_cast<int>(TaskPriority::kNormal);
+  }
+  // 线程安全添加任务到对应优先级通道
   tasks_mutex_.lock();
-  tasks_.push_back(task);
+  tasks_[lane].push_back(task);
   tasks_mutex_.unlock();
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 批量添加任务到线程
+ *
+ * @param tasks 任务对象指针, 只加锁一次
+ */
+void Thread::AddTasks(const std::vector<Task*>& tasks) {
+  for (Task* task : tasks) {
+    if (!task) continue;
+    task->set_base(base_);
+    task->set_thread_id(id_);
+  }
+  lock_guard<mutex> lock(tasks_mutex_);
+  for (Task* task : tasks) {
+    if (!task) continue;
+    int lane = static_cast<int>(task->priority());
+    if (lane < 0 || lane >= kTaskPriorityCount) {
+      lane = static_cast<int>(TaskPriority::kNormal);
+    }
+    tasks_[lane].push_back(task);
+  }
+}
+/**
+ * @brief 注册以本线程为接收端的消息通道
+ *
+ * @param channel 消息通道
+ */
+void Thread::AddChannel(ChannelBase* channel) {
+  if (!channel) {
+    cerr << "Thread::AddChannel() Invalid channel." << endl;
+    return;
+  }
+  lock_guard<recursive_mutex> lock(channels_mutex_);
+  channels_.push_back(channel);
+}
+
+/**
+ * @brief 注销消息通道
+ *
+ * @param channel 消息通道
+ */
+void Thread::RemoveChannel(ChannelBase* channel) {
+  lock_guard<recursive_mutex> lock(channels_mutex_);
+  auto it = find(channels_.begin(), channels_.end(), channel);
+  if (it == channels_.end()) return;
+  if (polling_) {
+    // 在消息处理函数中注销, 轮询结束后再移除
+    *it = nullptr;
+  } else {
+    channels_.erase(it);
+  }
+}
+
+/**
+ * @brief 通知线程有新消息
+ *
+ * @return true 写入了唤醒信号
+ * @return false 已经有未处理的唤醒信号
+ */
+bool Thread::Signal() {
+  // 正在自旋, 自旋循环和结束自旋时都会轮询通道
+  if (spinning_) return false;
+  if (signaled_.exchange(true)) return false;
+  char buf[1] = {kChannelSignal};
+#ifdef _WIN32
+  int re = send(notify_send_fd_, buf, 1, 0);
+#else
+  ssize_t re = write(notify_send_fd_, buf, 1);
+#endif
+  if (re <= 0) {
+    cerr << "Thread::Signal() Thread " << id_
+         << " failed to send channel signal." << endl;
+    signaled_ = false;
+    return false;
+  }
+  ++signal_count_;
+  return true;
+}
+
+/**
+ * @brief 轮询所有消息通道并处理其中的消息(在本线程中调用)
+ *
+ * @return size_t 处理的消息数量
+ */
+size_t Thread::PollChannels() {
+  // 先清除标记再取消息: 之后发送的消息一定会再次唤醒
+  signaled_ = false;
+  lock_guard<recursive_mutex> lock(channels_mutex_);
+  if (channels_.empty()) return 0;
+  polling_ = true;
+  size_t count = 0;
+  // 按下标遍历, 处理函数中注册的通道也会被轮询
+  for (size_t i = 0; i < channels_.size(); ++i) {
+    if (channels_[i]) count += channels_[i]->Poll();
+  }
+  polling_ = false;
+  channels_.erase(remove(channels_.begin(), channels_.end(), nullptr),
+                  channels_.end());
+  return count;
+}
+
+/**
+ * @brief 设置忙等待参数(默认不自旋)
+ *
+ * @param options 忙等待参数, 只使用其中的自旋时间
+ */
+void Thread::set_busy_poll(const BusyPollOptions& options) {
+  min_spin_us_ = max(options.min_spin_us, 1);
+  spin_us_ = max(options.spin_us, 0);
+}
@@ -11,16 +11,38 @@
 #define THREAD_H
 #include <event2/util.h>
 
+#include <atomic>
 #include <list>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include "crossocean.h"
+#include "task.h"
+#include "thread_pool.h"
 
 struct event_base;
+struct event;
 
 CROSSOCEAN_NAMESPACE
 
-class Task;
+class ChannelBase;
+
+/**
+ * @brief 优先级通道的调度策略
+ */
+enum class DrainPolicy {
+  kStrict,    ///< 严格优先级, 高优先级通道为空才处理低优先级通道
+  kWeighted,  ///< 加权公平, 按通道权重轮流处理, 低优先级任务不会饿死
+};
+
+/**
+ * @brief 超过截止时间的任务的处理策略
+ */
+enum class ExpirePolicy {
+  kDrop,    ///< 丢弃任务并调用`Task::OnExpired`
+  kDemote,  ///< 降级到最低优先级通道, 在其它任务之后执行
+};
 
 class Thread {
  public:
@@ -30,11 +52,22 @@ class Thread {
   /**
    * @brief 启动线程
    *
-   * @details 安装线程, 启动线程并绑定入口函数, 然后分离线程使其在后台运行
+   * @details 安装线程, 启动线程并绑定入口函数, 线程在后台运行.
+   * 没有调用`Stop`的线程在对象销毁时分离
    *
    */
   void Start();
 
+  /**
+   * @brief 停止线程并等待线程退出
+   *
+   * @details
+   * 向线程发送停止信号, 线程在自己的事件循环中退出, 释放`event_base`和管道.
+   * 队列中未执行的任务不再执行, 注册在`event_base`上的事件(连接、监听)
+   * 需要在停止之前由所属的任务在本线程中释放. 不能在本线程中调用
+   */
+  void Stop();
+
   /**
    * @brief 线程入口函数
    *
@@ -64,31 +97,217 @@ class Thread {
   /**
    * @brief 激活线程
    *
-   * @details 向线程发送激活消息(通过管道或者`socketpair`写入数据)
+   * @details
+   * 向线程发送激活消息(通过管道或者`socketpair`写入数据),
+   * 每个激活消息执行一个任务, 多个激活消息一次写入, 线程一次读取.
+   * 线程正在自旋时不写管道, 任务由自旋循环取出
    *
+   * @param count 激活的任务数量
    */
-  void Activate();
+  void Activate(int count = 1);
 
   /**
    * @brief 添加任务到线程
    *
+   * @details 任务按照`Task::priority`放入对应的优先级通道
+   *
    * @param task	任务对象指针
    */
   void AddTask(Task* task);
 
+  /**
+   * @brief 批量添加任务到线程
+   *
+   * @details 只加锁一次, 之后用`Activate(tasks.size())`一次激活
+   *
+   * @param tasks 任务对象指针, 空指针被忽略
+   */
+  void AddTasks(const std::vector<Task*>& tasks);
+
+  /**
+   * @brief 设置优先级通道的调度策略(默认加权公平)
+   *
+   * @param policy 调度策略
+   */
+  void set_drain_policy(DrainPolicy policy);
+
+  /**
+   * @brief 设置优先级通道的权重
+   *
+   * @details
+   * 加权公平调度时, 每一轮中各通道最多连续处理`weight`个任务,
+   * 默认权重为 高:8 普通:4 低:1
+   *
+   * @param priority 优先级通道
+   * @param weight 权重(最小为1)
+   */
+  void set_lane_weight(TaskPriority priority, int weight);
+
+  /**
+   * @brief 设置超过截止时间的任务的处理策略(默认丢弃)
+   *
+   * @param policy 处理策略
+   */
+  void set_expire_policy(ExpirePolicy policy);
+
+  /**
+   * @brief 获取等待执行的任务数量(所有优先级通道之和)
+   *
+   * @return int 队列中的任务数量
+   */
+  int task_count();
+
+  /**
+   * @brief 获取因超时被丢弃的任务数量
+   *
+   * @return long long 被丢弃的任务数量
+   */
+  long long expired_count() const { return expired_count_; }
+
+  /**
+   * @brief 设置忙等待参数(默认不自旋)
+   *
+   * @param options 忙等待参数, 只使用其中的自旋时间
+   * (`socket_busy_poll_us`由`ServerTask`在创建时读取)
+   */
+  void set_busy_poll(const BusyPollOptions& options);
+
+  /// @brief 自旋期间处理了工作的次数
+  long long spin_hits() const { return spin_hits_; }
+  /// @brief 阻塞等待事件的次数
+  long long sleep_count() const { return sleep_count_; }
+  /// @brief 跳过写管道的激活次数
+  long long skipped_activations() const { return skipped_activations_; }
+
+  /**
+   * @brief 注册以本线程为接收端的消息通道
+   *
+   * @details 事件循环每一轮阻塞等待事件之前轮询所有通道
+   *
+   * @param channel 消息通道
+   */
+  void AddChannel(ChannelBase* channel);
+
+  /**
+   * @brief 注销消息通道
+   *
+   * @details 其它线程注销时等待正在进行的轮询结束
+   *
+   * @param channel 消息通道
+   */
+  void RemoveChannel(ChannelBase* channel);
+
+  /**
+   * @brief 通知线程有新消息
+   *
+   * @details
+   * 从上次轮询开始最多写一次管道, 接收端忙于处理事件或正在自旋时
+   * 不再唤醒, 新消息在下一轮阻塞之前被轮询到
+   *
+   * @return true 写入了唤醒信号
+   * @return false 已经有未处理的唤醒信号
+   */
+  bool Signal();
+
+  /**
+   * @brief 轮询所有消息通道并处理其中的消息(在本线程中调用)
+   *
+   * @return size_t 处理的消息数量
+   */
+  size_t PollChannels();
+
+  /**
+   * @brief 获取消息通道写入唤醒信号的次数
+   *
+   * @return long long 唤醒次数
+   */
+  long long signal_count() const { return signal_count_; }
+
   /// @brief 线程编号
   int id_;
 
  private:
+  /**
+   * @brief 按调度策略选择下一个要处理的优先级通道(需持有`tasks_mutex_`)
+   *
+   * @return int 通道下标, 所有通道为空时返回-1
+   */
+  int PickLane();
+
+  /**
+   * @brief 取出下一个要执行的任务(需持有`tasks_mutex_`)
+   *
+   * @details 超时任务按`expire_policy_`丢弃或降级, 丢弃的任务放入`expired`
+   *
+   * @param expired 输出被丢弃的超时任务
+   * @return Task* 下一个要执行的任务, 没有任务时返回`nullptr`
+   */
+  Task* PopTask(std::list<Task*>* expired);
+
+  /**
+   * @brief 取出并执行一个任务, 超时任务按策略处理
+   *
+   * @return true 执行了任务
+   * @return false 没有可执行的任务
+   */
+  bool RunTask();
+
+  /**
+   * @brief 阻塞之前自旋: 反复检查任务队列、消息通道和事件
+   *
+   * @details 每次发现工作后重新计时, 空转`spin_window_us_`后返回
+   */
+  void Spin();
+
   /// @brief 用于激活线程的管道写入端文件描述符
   int notify_send_fd_ = 0;
+  /// @brief 管道读取端文件描述符
+  int notify_recv_fd_ = -1;
+  /// @brief 管道读取事件
+  ::event* notify_event_ = nullptr;
+  /// @brief 线程对象, `Stop`时等待线程退出
+  std::thread thread_;
   /// @brief libevent 事件循环对象
   ::event_base* base_ = nullptr;
 
-  /// @brief 线程任务列表
-  std::list<Task*> tasks_;
+  /// @brief 线程任务列表(每个优先级一个通道)
+  std::list<Task*> tasks_[kTaskPriorityCount];
   /// @brief 线程安全 互斥
   std::mutex tasks_mutex_;
+
+  /// @brief 优先级通道的调度策略
+  DrainPolicy drain_policy_ = DrainPolicy::kWeighted;
+  /// @brief 各优先级通道的权重
+  int lane_weights_[kTaskPriorityCount] = {8, 4, 1};
+  /// @brief 本轮各优先级通道剩余可处理的任务数
+  int lane_credits_[kTaskPriorityCount] = {8, 4, 1};
+  /// @brief 超时任务的处理策略
+  ExpirePolicy expire_policy_ = ExpirePolicy::kDrop;
+  /// @brief 因超时被丢弃的任务数量
+  std::atomic<long long> expired_count_{0};
+
+  /// @brief 以本线程为接收端的消息通道
+  std::vector<ChannelBase*> channels_;
+  /// @brief 保护`channels_`, 消息处理函数中可以注册或注销通道
+  std::recursive_mutex channels_mutex_;
+  /// @brief 是否正在轮询, 轮询期间注销的通道先置空
+  bool polling_ = false;
+  /// @brief 上次轮询之后是否已经写入唤醒信号
+  std::atomic<bool> signaled_{false};
+  /// @brief 消息通道写入唤醒信号的次数
+  std::atomic<long long> signal_count_{0};
+
+  /// @brief 最长自旋时间(微秒)
+  std::atomic<int> spin_us_{0};
+  /// @brief 最短自旋时间(微秒)
+  std::atomic<int> min_spin_us_{5};
+  /// @brief 当前的自旋时间(微秒, 只在本线程中访问)
+  int spin_window_us_ = 0;
+  /// @brief 是否正在自旋(在`tasks_mutex_`中清除)
+  std::atomic<bool> spinning_{false};
+  std::atomic<long long> spin_hits_{0};
+  std::atomic<long long> sleep_count_{0};
+  std::atomic<long long> skipped_activations_{0};
 };
 
 END_NAMESPACE
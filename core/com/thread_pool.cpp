@@ -34,6 +34,7 @@ void ThreadPool::Init(int thread_num) {
     cout << "ThreadPool::Init() ThreadPool: Created thread " << i + 1 << endl;
     // 启动线程(编号从1开始)
     thread->id_ = i + 1;
+    thread->set_busy_poll(busy_poll_);
     thread->Start();
     // 将线程对象添加到容器中
     threads_.push_back(thread);
@@ -72,4 +73,66 @@ void ThreadPool::Dispatch(Task* task) {
   thread->Activate();
   cout << "ThreadPool::Dispatch() Dispatched task to thread " << thread->id_
        << endl;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 批量分发任务到线程
+ *
+ * @details
+ * 按与`Dispatch`相同的轮询策略把任务划分给各个线程,
+ * 每个线程的任务一次加入队列, 每个线程只激活一次(一次写管道)
+ *
+ * @param tasks 任务指针, 空指针被忽略
+ */
+void ThreadPool::DispatchBatch(const std::vector<Task*>& tasks) {
+  if (threads_.empty()) {
+    cerr << "ThreadPool::DispatchBatch() No threads available to dispatch "
+            "tasks."
+         << endl;
+    return;
+  }
+  // 按轮询顺序划分到各个线程
+  vector<vector<Task*>> batches(thread_num_);
+  for (Task* task : tasks) {
+    if (!task) {
+      cerr << "ThreadPool::DispatchBatch() Invalid task." << endl;
+      continue;
+    }
+    int thread_index = (last_thread_index_ + 1) % thread_num_;
+    last_thread_index_ = thread_index;
+    batches[thread_index].push_back(task);
+  }
+
+  for (int i = 0; i < thread_num_; ++i) {
+    if (batches[i].empty()) continue;
+    Thread* thread = threads_[i];
+    thread->AddTasks(batches[i]);
+    thread->Activate(static_cast<int>(batches[i].size()));
+    cout << "ThreadPool::DispatchBatch() Dispatched " << batches[i].size()
+         << " tasks to thread " << thread->id_ << endl;
+  }
+}
+
+/**
+ * @brief 获取所有线程等待执行的任务总数
+ *
+ * @return int 任务队列总深度
+ */
+int ThreadPool::task_count() {
+  int count = 0;
+  for (Thread* thread : threads_) {
+    count += thread->task_count();
+  }
+  return count;
+}
+/**
+ * @brief 设置工作线程的忙等待参数
+ *
+ * @param options 忙等待参数
+ */
+void ThreadPool::set_busy_poll(const BusyPollOptions& options) {
+  busy_poll_ = options;
+  for (Thread* thread : threads_) {
+    thread->set_busy_poll(options);
+  }
+}
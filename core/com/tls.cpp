@@ -0,0 +1,536 @@
+﻿/**
+ * @file tls.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `TlsContext`和`TlsConnection`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/tls.h"
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#endif
+
+using namespace std;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 服务器会话缓存的会话ID上下文
+static const char kSessionIdContext[] = "crossocean";
+/// @brief 默认缓存的会话数量
+static const long kDefaultSessionCacheSize = 20480;
+/// @brief 默认会话有效期(秒)
+static const long kDefaultSessionTimeout = 3600;
+/// @brief 用户态加密发送文件时每次读取的字节数
+static const size_t kSendFileChunk = 64 * 1024;
+
+/**
+ * @brief 输出并清空OpenSSL错误队列
+ *
+ * @param where 出错位置
+ */
+static void LogSslError(const char* where) {
+  unsigned long err = 0;
+  bool logged = false;
+  while ((err = ERR_get_error()) != 0) {
+    char buf[256];
+    ERR_error_string_n(err, buf, sizeof(buf));
+    cerr << where << " " << buf << endl;
+    logged = true;
+  }
+  if (!logged) cerr << where << " failed." << endl;
+}
+
+/**
+ * @brief 检测kTLS支持
+ *
+ * @return string 不支持的原因, 支持时为空
+ */
+static string ProbeKtls() {
+#if defined(OPENSSL_NO_KTLS)
+  return "OpenSSL is built without kTLS";
+#elif !defined(__linux__)
+  return "kTLS detection is only implemented on Linux";
+#else
+  // `tls` ULP只能设置在已连接的TCP socket上, 连接留在监听队列中即可
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  string reason;
+  if (listener < 0 || sock < 0 ||
+      bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 1) != 0 ||
+      getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addr_len) !=
+          0 ||
+      connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    reason = string("loopback probe failed: ") + strerror(errno);
+  } else if (setsockopt(sock, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+    reason = errno == ENOENT
+                 ? "kernel tls module is not loaded (modprobe tls)"
+                 : string("kernel rejected tls ULP: ") + strerror(errno);
+  }
+  if (sock >= 0) close(sock);
+  if (listener >= 0) close(listener);
+  return reason;
+#endif
+}
+
+// ==================== TlsContext ====================
+
+TlsContext::TlsContext() {}
+
+TlsContext::~TlsContext() {
+  for (auto& item : sessions_) SSL_SESSION_free(item.second);
+  if (ctx_) SSL_CTX_free(ctx_);
+}
+
+/**
+ * @brief 创建`SSL_CTX`并设置公共选项
+ */
+bool TlsContext::Create(bool server) {
+  if (ctx_) {
+    SSL_CTX_free(ctx_);
+    ctx_ = nullptr;
+  }
+  server_ = server;
+  ctx_ = SSL_CTX_new(server ? TLS_server_method() : TLS_client_method());
+  if (!ctx_) {
+    LogSslError("TlsContext::Create()");
+    return false;
+  }
+  SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+  // 非阻塞发送时允许部分写入, 重试时缓冲区地址可以变化
+  SSL_CTX_set_mode(ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                             SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+  set_ktls(ktls_);
+
+  if (server) {
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_session_id_context(
+        ctx_, reinterpret_cast<const unsigned char*>(kSessionIdContext),
+        sizeof(kSessionIdContext) - 1);
+    SetSessionCache(kDefaultSessionCacheSize, kDefaultSessionTimeout);
+  } else {
+    // 客户端会话由`sessions_`按对端保存
+    SSL_CTX_set_session_cache_mode(
+        ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx_, NewSessionCB);
+  }
+  return true;
+}
+
+/**
+ * @brief 初始化服务器配置
+ *
+ * @param cert_file 证书文件(PEM, 可以包含证书链)
+ * @param key_file 私钥文件(PEM)
+ * @return true 初始化成功
+ * @return false 证书或私钥加载失败
+ */
+bool TlsContext::InitServer(const string& cert_file, const string& key_file) {
+  if (!Create(true)) return false;
+  if (SSL_CTX_use_certificate_chain_file(ctx_, cert_file.c_str()) != 1 ||
+      SSL_CTX_use_PrivateKey_file(ctx_, key_file.c_str(), SSL_FILETYPE_PEM) !=
+          1 ||
+      SSL_CTX_check_private_key(ctx_) != 1) {
+    LogSslError("TlsContext::InitServer()");
+    SSL_CTX_free(ctx_);
+    ctx_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 使用临时生成的自签名证书初始化服务器配置(用于开发和测试)
+ *
+ * @param common_name 证书的通用名称
+ * @return true 初始化成功
+ * @return false 生成证书失败
+ */
+bool TlsContext::InitSelfSigned(const string& common_name) {
+  if (!Create(true)) return false;
+
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* cert = X509_new();
+  bool ok = key && cert;
+  if (ok) {
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 365L * 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(
+        name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char*>(common_name.c_str()), -1, -1,
+        0);
+    X509_set_issuer_name(cert, name);
+    ok = X509_sign(cert, key, EVP_sha256()) > 0 &&
+         SSL_CTX_use_certificate(ctx_, cert) == 1 &&
+         SSL_CTX_use_PrivateKey(ctx_, key) == 1;
+  }
+  if (cert) X509_free(cert);
+  if (key) EVP_PKEY_free(key);
+  if (!ok) {
+    LogSslError("TlsContext::InitSelfSigned()");
+    SSL_CTX_free(ctx_);
+    ctx_ = nullptr;
+  }
+  return ok;
+}
+
+/**
+ * @brief 初始化客户端配置
+ *
+ * @param ca_file 用于验证服务器证书的CA文件, 为空时不验证服务器证书
+ * @return true 初始化成功
+ * @return false CA文件加载失败
+ */
+bool TlsContext::InitClient(const string& ca_file) {
+  if (!Create(false)) return false;
+  if (ca_file.empty()) {
+    SSL_CTX_set_verify(ctx_, SSL_VERIFY_NONE, nullptr);
+    return true;
+  }
+  if (SSL_CTX_load_verify_locations(ctx_, ca_file.c_str(), nullptr) != 1) {
+    LogSslError("TlsContext::InitClient()");
+    SSL_CTX_free(ctx_);
+    ctx_ = nullptr;
+    return false;
+  }
+  SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, nullptr);
+  return true;
+}
+
+/**
+ * @brief 是否启用kTLS(默认启用), 对之后创建的连接生效
+ */
+void TlsContext::set_ktls(bool enable) {
+  ktls_ = enable;
+  if (!ctx_) return;
+  if (enable) {
+    SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+  } else {
+    SSL_CTX_clear_options(ctx_, SSL_OP_ENABLE_KTLS);
+  }
+}
+
+/**
+ * @brief 检查OpenSSL和内核是否支持kTLS(结果在第一次调用时检测并缓存)
+ *
+ * @param reason 不支持时输出原因, 可以为`nullptr`
+ * @return true 支持kTLS
+ * @return false OpenSSL编译时未启用kTLS或内核不支持
+ */
+bool TlsContext::KtlsSupported(string* reason) {
+  static const string probed = ProbeKtls();
+  if (reason) *reason = probed;
+  return probed.empty();
+}
+
+/**
+ * @brief 设置服务器会话缓存的容量和超时时间
+ *
+ * @param size 缓存的会话数量
+ * @param timeout_seconds 会话有效期(秒)
+ */
+void TlsContext::SetSessionCache(long size, long timeout_seconds) {
+  if (!ctx_) {
+    cerr << "TlsContext::SetSessionCache() Not initialized." << endl;
+    return;
+  }
+  SSL_CTX_sess_set_cache_size(ctx_, size);
+  SSL_CTX_set_timeout(ctx_, timeout_seconds);
+}
+
+/**
+ * @brief 获取统计信息
+ */
+TlsStats TlsContext::stats() const {
+  TlsStats stats;
+  stats.handshakes = handshakes_;
+  stats.resumed = resumed_;
+  stats.ktls_send = ktls_send_;
+  stats.ktls_recv = ktls_recv_;
+  stats.ktls_sendfile_bytes = ktls_sendfile_bytes_;
+  return stats;
+}
+
+/**
+ * @brief 客户端: 获取对端的缓存会话(引用计数加1), 没有返回`nullptr`
+ */
+SSL_SESSION* TlsContext::FindSession(const string& peer) {
+  lock_guard<mutex> lock(sessions_mutex_);
+  auto it = sessions_.find(peer);
+  if (it == sessions_.end()) return nullptr;
+  if (!SSL_SESSION_is_resumable(it->second)) {
+    SSL_SESSION_free(it->second);
+    sessions_.erase(it);
+    return nullptr;
+  }
+  SSL_SESSION_up_ref(it->second);
+  return it->second;
+}
+
+/**
+ * @brief 客户端: 保存对端的会话(接管引用)
+ */
+void TlsContext::StoreSession(const string& peer, SSL_SESSION* session) {
+  lock_guard<mutex> lock(sessions_mutex_);
+  SSL_SESSION*& slot = sessions_[peer];
+  if (slot) SSL_SESSION_free(slot);
+  slot = session;
+}
+
+/**
+ * @brief 客户端新会话回调(OpenSSL 回调)
+ *
+ * @return int 1表示接管了会话的引用
+ */
+int TlsContext::NewSessionCB(SSL* ssl, SSL_SESSION* session) {
+  auto connection = static_cast<TlsConnection*>(SSL_get_app_data(ssl));
+  if (!connection || connection->peer_.empty()) return 0;
+  connection->context_->StoreSession(connection->peer_, session);
+  return 1;
+}
+
+// ==================== TlsConnection ====================
+
+/**
+ * @brief 构造 TLS 连接
+ *
+ * @param context TLS 配置
+ * @param sock 已连接的socket
+ * @param peer 客户端用于缓存会话的对端标识(如"host:port"), 为空不缓存
+ */
+TlsConnection::TlsConnection(TlsContext* context, int sock,
+                             const string& peer)
+    : context_(context), peer_(peer) {
+  if (!context_ || !context_->native()) {
+    cerr << "TlsConnection::TlsConnection() Invalid context." << endl;
+    return;
+  }
+  ssl_ = SSL_new(context_->native());
+  if (!ssl_) {
+    LogSslError("TlsConnection::TlsConnection()");
+    return;
+  }
+  SSL_set_fd(ssl_, sock);
+  SSL_set_app_data(ssl_, this);
+  if (context_->is_server()) {
+    SSL_set_accept_state(ssl_);
+    return;
+  }
+  SSL_set_connect_state(ssl_);
+  if (!peer_.empty()) {
+    SSL_SESSION* session = context_->FindSession(peer_);
+    if (session) {
+      SSL_set_session(ssl_, session);
+      SSL_SESSION_free(session);
+    }
+  }
+}
+
+TlsConnection::~TlsConnection() {
+  if (ssl_) SSL_free(ssl_);
+}
+
+/**
+ * @brief 执行握手(服务器接受 / 客户端发起)
+ *
+ * @return TlsStatus 握手结果
+ */
+TlsStatus TlsConnection::Handshake() {
+  if (!ssl_) return TlsStatus::kError;
+  if (established_) return TlsStatus::kDone;
+  ERR_clear_error();
+  int ret = SSL_do_handshake(ssl_);
+  if (ret != 1) return StatusFor(ret);
+
+  established_ = true;
+  ++context_->handshakes_;
+  if (session_reused()) ++context_->resumed_;
+  if (ktls_send()) ++context_->ktls_send_;
+  if (ktls_recv()) ++context_->ktls_recv_;
+  return TlsStatus::kDone;
+}
+
+/**
+ * @brief 读取解密后的数据
+ *
+ * @param buf 缓冲区
+ * @param len 缓冲区长度
+ * @param status 输出操作结果
+ * @return long long 读取的字节数
+ */
+long long TlsConnection::Read(char* buf, size_t len, TlsStatus* status) {
+  if (!ssl_) {
+    *status = TlsStatus::kError;
+    return 0;
+  }
+  ERR_clear_error();
+  size_t read_bytes = 0;
+  int ret = SSL_read_ex(ssl_, buf, len, &read_bytes);
+  *status = ret == 1 ? TlsStatus::kDone : StatusFor(ret);
+  return static_cast<long long>(read_bytes);
+}
+
+/**
+ * @brief 加密发送数据
+ *
+ * @param data 数据
+ * @param len 数据长度
+ * @param status 输出操作结果
+ * @return long long 发送的字节数
+ */
+long long TlsConnection::Write(const char* data, size_t len,
+                               TlsStatus* status) {
+  if (!ssl_) {
+    *status = TlsStatus::kError;
+    return 0;
+  }
+  ERR_clear_error();
+  size_t written = 0;
+  int ret = SSL_write_ex(ssl_, data, len, &written);
+  *status = ret == 1 ? TlsStatus::kDone : StatusFor(ret);
+  return static_cast<long long>(written);
+}
+
+/**
+ * @brief 发送文件内容
+ *
+ * @details 只有连接的socket BIO启用了kTLS发送时才使用`SSL_sendfile`
+ * (内核`sendfile`, 零拷贝); 没有启用时`SSL_sendfile`只会失败,
+ * 读取文件后在用户态加密发送
+ *
+ * @param fd 文件描述符
+ * @param offset 文件偏移
+ * @param len 发送长度
+ * @param status 输出操作结果
+ * @return long long 发送的字节数
+ */
+long long TlsConnection::SendFile(int fd, long long offset, size_t len,
+                                  TlsStatus* status) {
+  if (!ssl_) {
+    *status = TlsStatus::kError;
+    return 0;
+  }
+#ifndef _WIN32
+  if (ktls_send()) {
+    ERR_clear_error();
+    ossl_ssize_t re = SSL_sendfile(ssl_, fd, offset, len, 0);
+    if (re >= 0) {
+      context_->ktls_sendfile_bytes_ += re;
+      *status = TlsStatus::kDone;
+      return re;
+    }
+    *status = StatusFor(static_cast<int>(re));
+    return 0;
+  }
+#endif
+
+  // 用户态加密: 读取一段文件后通过`SSL_write`发送
+  vector<char> buf(min(len, kSendFileChunk));
+#ifdef _WIN32
+  _lseeki64(fd, offset, SEEK_SET);
+  long long n = _read(fd, buf.data(), static_cast<unsigned int>(buf.size()));
+#else
+  long long n = pread(fd, buf.data(), buf.size(), offset);
+#endif
+  if (n < 0) {
+    cerr << "TlsConnection::SendFile() Failed to read file." << endl;
+    *status = TlsStatus::kError;
+    return 0;
+  }
+  if (n == 0) {
+    *status = TlsStatus::kDone;
+    return 0;
+  }
+  return Write(buf.data(), static_cast<size_t>(n), status);
+}
+
+/**
+ * @brief 发送关闭通知
+ *
+ * @return TlsStatus 操作结果
+ */
+TlsStatus TlsConnection::Shutdown() {
+  if (!ssl_ || !established_) return TlsStatus::kError;
+  ERR_clear_error();
+  int ret = SSL_shutdown(ssl_);
+  if (ret >= 0) return TlsStatus::kDone;
+  return StatusFor(ret);
+}
+
+/// @brief 是否启用了内核TLS发送
+bool TlsConnection::ktls_send() const {
+  return ssl_ && BIO_get_ktls_send(SSL_get_wbio(ssl_));
+}
+
+/// @brief 是否启用了内核TLS接收
+bool TlsConnection::ktls_recv() const {
+  return ssl_ && BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+}
+
+/// @brief 是否复用了会话
+bool TlsConnection::session_reused() const {
+  return ssl_ && SSL_session_reused(ssl_) == 1;
+}
+
+/// @brief 协商的TLS版本
+string TlsConnection::version() const {
+  return ssl_ ? SSL_get_version(ssl_) : "";
+}
+
+/// @brief 协商的密码套件
+string TlsConnection::cipher() const {
+  const char* name = ssl_ ? SSL_get_cipher_name(ssl_) : nullptr;
+  return name ? name : "";
+}
+
+/**
+ * @brief 根据OpenSSL返回值得到操作结果
+ */
+TlsStatus TlsConnection::StatusFor(int ret) {
+  switch (SSL_get_error(ssl_, ret)) {
+    case SSL_ERROR_WANT_READ:
+      return TlsStatus::kWantRead;
+    case SSL_ERROR_WANT_WRITE:
+      return TlsStatus::kWantWrite;
+    case SSL_ERROR_ZERO_RETURN:
+      return TlsStatus::kClosed;
+    case SSL_ERROR_SYSCALL:
+      if (ERR_peek_error() == 0 && errno == 0) return TlsStatus::kClosed;
+      break;
+    default:
+      break;
+  }
+  LogSslError("TlsConnection::StatusFor()");
+  return TlsStatus::kError;
+}
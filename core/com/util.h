@@ -0,0 +1,159 @@
+﻿/**
+ * @file util.h
+ * @author L.J.H (3414467112@qq.com)
+ * @brief 库内部共用的工具函数: 整数编码、文件区间读写、修改时间和路径校验
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef UTIL_H
+#define UTIL_H
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "crossocean.h"
+
+CROSSOCEAN_NAMESPACE
+
+#ifdef _WIN32
+typedef struct _stat64 StatType;
+#define FileStat _stat64
+#define FileFstat _fstat64
+#else
+typedef struct stat StatType;
+#define FileStat stat
+#define FileFstat fstat
+#endif
+
+/**
+ * @brief 按小端序追加整数
+ */
+inline void PutUint(std::string* out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+/**
+ * @brief 按小端序写入整数
+ */
+inline void PutUint(char* out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+/**
+ * @brief 按小端序读取整数
+ */
+inline uint64_t GetUint(const char* data, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i) {
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i]))
+             << (8 * i);
+  }
+  return value;
+}
+
+/**
+ * @brief 从文件指定偏移读取数据
+ *
+ * @return long long 读取的字节数, 小于`len`表示到达文件末尾, 出错返回-1
+ */
+inline long long ReadFull(int fd, char* buf, size_t len, long long offset) {
+  size_t total = 0;
+  while (total < len) {
+#ifdef _WIN32
+    _lseeki64(fd, offset + total, SEEK_SET);
+    long long re =
+        _read(fd, buf + total, static_cast<unsigned int>(len - total));
+#else
+    long long re = pread(fd, buf + total, len - total, offset + total);
+#endif
+    if (re < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    if (re == 0) break;
+    total += re;
+  }
+  return static_cast<long long>(total);
+}
+
+/**
+ * @brief 向文件指定偏移写入全部数据
+ */
+inline bool WriteFull(int fd, const char* buf, size_t len, long long offset) {
+  size_t total = 0;
+  while (total < len) {
+#ifdef _WIN32
+    _lseeki64(fd, offset + total, SEEK_SET);
+    long long re =
+        _write(fd, buf + total, static_cast<unsigned int>(len - total));
+#else
+    long long re = pwrite(fd, buf + total, len - total, offset + total);
+#endif
+    if (re < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    total += re;
+  }
+  return true;
+}
+
+/**
+ * @brief 关闭文件描述符(忽略-1)
+ */
+inline void CloseFd(int fd) {
+  if (fd < 0) return;
+#ifdef _WIN32
+  _close(fd);
+#else
+  close(fd);
+#endif
+}
+
+/**
+ * @brief 取文件修改时间(纳秒)
+ */
+inline long long MtimeNs(const StatType& st) {
+#if defined(_WIN32)
+  return static_cast<long long>(st.st_mtime) * 1000000000LL;
+#elif defined(__APPLE__)
+  return st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+  return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+/**
+ * @brief 检查相对路径是否合法(非空、非绝对路径、不含`..`)
+ *
+ * @details 请求中的路径和名称都要先经过该检查, 拼接到根目录后不会越出根目录
+ */
+inline bool ValidRelativePath(const std::string& path) {
+  if (path.empty() || path[0] == '/' || path[0] == '\\') return false;
+  std::filesystem::path p(path);
+  if (p.is_absolute() || p.has_root_name()) return false;
+  for (const auto& part : p) {
+    if (part == "..") return false;
+  }
+  return true;
+}
+
+END_NAMESPACE
+
+#endif  // UTIL_H
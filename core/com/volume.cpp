@@ -0,0 +1,753 @@
+﻿/**
+ * @file volume.cpp
+ * @author L.J.H (3414467112@qq.com)
+ * @brief `Volume`和`VolumeStore`类实现
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "include/volume.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include "include/blocking_pool.h"
+#include "include/crc32c.h"
+#include "util.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+USING_CROSSOCEAN_NAMESPACE
+
+/// @brief 卷文件头标识
+static const char kVolumeMagic[4] = {'H', 'V', 'O', 'L'};
+/// @brief 卷文件头长度: 标识4 + 版本4 + 保留8
+static const long long kVolumeHeaderSize = 16;
+/// @brief 卷格式版本
+static const uint32_t kVolumeVersion = 1;
+/// @brief 记录头标识
+static const char kNeedleMagic[4] = {'N', 'D', 'L', '1'};
+/// @brief 记录头长度: 标识4 + 标志1 + 键长度2 + 数据长度4
+static const long long kNeedleHeaderSize = 11;
+/// @brief 记录标志: 墓碑
+static const char kFlagTombstone = 1;
+/// @brief 合并时复制记录的缓冲区大小
+static const size_t kCopyBufferSize = 1024 * 1024;
+
+/**
+ * @brief 记录按8字节对齐后的长度
+ */
+static long long RecordSize(size_t key_len, size_t data_len) {
+  long long size = kNeedleHeaderSize + key_len + data_len + 4;
+  return (size + 7) & ~7LL;
+}
+
+/**
+ * @brief 把文件数据刷到磁盘
+ */
+static bool SyncFd(int fd) {
+#ifdef _WIN32
+  return _commit(fd) == 0;
+#elif defined(__APPLE__)
+  return fsync(fd) == 0;
+#else
+  return fdatasync(fd) == 0;
+#endif
+}
+
+/**
+ * @brief 打开卷文件(读写, 不存在时创建)
+ */
+static int OpenVolumeFile(const string& path, bool truncate) {
+#ifdef _WIN32
+  int flags = _O_RDWR | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : 0);
+  return _open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+  int flags = O_RDWR | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0);
+  return open(path.c_str(), flags, 0644);
+#endif
+}
+
+/**
+ * @brief 生成卷文件头
+ */
+static string VolumeHeader() {
+  string header(kVolumeMagic, sizeof(kVolumeMagic));
+  PutUint(&header, kVolumeVersion, 4);
+  PutUint(&header, 0, 8);
+  return header;
+}
+
+// ==================== Volume ====================
+
+/**
+ * @brief 关闭卷文件
+ */
+VolumeFile::~VolumeFile() {
+  if (fd < 0) return;
+#ifdef _WIN32
+  _close(fd);
+#else
+  close(fd);
+#endif
+}
+
+/**
+ * @brief 构造卷
+ *
+ * @param path 卷文件路径
+ */
+Volume::Volume(const string& path) : path_(path) {}
+
+/**
+ * @brief 解析卷文件中的记录
+ *
+ * @param fd 卷文件
+ * @param begin 起始偏移
+ * @param end 结束偏移
+ * @param apply 每条记录的回调: 键、是否为墓碑、位置
+ * @return long long 最后一条完整记录的结束偏移
+ */
+template <typename Fn>
+long long Volume::Scan(int fd, long long begin, long long end, Fn apply) {
+  long long pos = begin;
+  char header[kNeedleHeaderSize];
+  string key;
+  while (end - pos >= kNeedleHeaderSize) {
+    if (ReadFull(fd, header, sizeof(header), pos) != kNeedleHeaderSize ||
+        memcmp(header, kNeedleMagic, sizeof(kNeedleMagic)) != 0) {
+      break;
+    }
+    bool tombstone = header[4] == kFlagTombstone;
+    size_t key_len = GetUint(header + 5, 2);
+    uint32_t length = static_cast<uint32_t>(GetUint(header + 7, 4));
+    long long record_size = RecordSize(key_len, length);
+    if (end - pos < record_size) break;
+    key.resize(key_len);
+    if (ReadFull(fd, &key[0], key_len, pos + kNeedleHeaderSize) !=
+        static_cast<long long>(key_len)) {
+      break;
+    }
+    Location location;
+    location.record = pos;
+    location.record_size = record_size;
+    location.length = length;
+    apply(key, tombstone, location);
+    pos += record_size;
+  }
+  return pos;
+}
+
+/**
+ * @brief 打开或创建卷文件, 扫描记录重建索引
+ *
+ * @return true 成功
+ * @return false 打开失败或文件格式错误
+ */
+bool Volume::Open() {
+  lock_guard<mutex> lock(mutex_);
+  auto file = make_shared<VolumeFile>();
+  file->fd = OpenVolumeFile(path_, false);
+  struct stat st;
+  if (file->fd < 0 || fstat(file->fd, &st) != 0) {
+    cerr << "Volume::Open() Failed to open " << path_ << ": "
+         << strerror(errno) << endl;
+    return false;
+  }
+
+  long long file_size = static_cast<long long>(st.st_size);
+  if (file_size == 0) {
+    string header = VolumeHeader();
+    if (!WriteFull(file->fd, header.data(), header.size(), 0)) {
+      cerr << "Volume::Open() Failed to write header " << path_ << endl;
+      return false;
+    }
+    file_size = kVolumeHeaderSize;
+  } else {
+    char header[kVolumeHeaderSize];
+    if (ReadFull(file->fd, header, sizeof(header), 0) != kVolumeHeaderSize ||
+        memcmp(header, kVolumeMagic, sizeof(kVolumeMagic)) != 0 ||
+        GetUint(header + 4, 4) != kVolumeVersion) {
+      cerr << "Volume::Open() Invalid volume " << path_ << endl;
+      return false;
+    }
+  }
+
+  index_.clear();
+  live_bytes_ = 0;
+  garbage_bytes_ = 0;
+  long long end = Scan(file->fd, kVolumeHeaderSize, file_size,
+                       [this](const string& key, bool tombstone,
+                              const Location& location) {
+                         auto it = index_.find(key);
+                         if (it != index_.end()) {
+                           live_bytes_ -= it->second.record_size;
+                           garbage_bytes_ += it->second.record_size;
+                         }
+                         if (tombstone) {
+                           if (it != index_.end()) index_.erase(it);
+                           garbage_bytes_ += location.record_size;
+                         } else {
+                           index_[key] = location;
+                           live_bytes_ += location.record_size;
+                         }
+                       });
+  if (end < file_size) {
+    // 崩溃时写了一半的记录
+    cerr << "Volume::Open() Truncating " << file_size - end
+         << " bytes of torn records in " << path_ << endl;
+#ifdef _WIN32
+    _chsize_s(file->fd, end);
+#else
+    if (ftruncate(file->fd, end) != 0) return false;
+#endif
+  }
+  size_ = end;
+  file_ = file;
+  return true;
+}
+
+/**
+ * @brief 追加一条记录(需持有`mutex_`)
+ */
+bool Volume::AppendRecord(const string& key, const char* data, size_t len,
+                          bool tombstone, Location* location) {
+  if (!file_) {
+    cerr << "Volume::Append() Volume is not open." << endl;
+    return false;
+  }
+  long long record_size = RecordSize(key.size(), len);
+  string record;
+  record.reserve(record_size);
+  record.append(kNeedleMagic, sizeof(kNeedleMagic));
+  record.push_back(tombstone ? kFlagTombstone : 0);
+  PutUint(&record, key.size(), 2);
+  PutUint(&record, len, 4);
+  record.append(key);
+  record.append(data, len);
+  uint32_t crc = Crc32c::Extend(Crc32c::Value(key.data(), key.size()), data,
+                                len);
+  PutUint(&record, crc, 4);
+  record.resize(record_size, '\0');
+  if (!WriteFull(file_->fd, record.data(), record.size(), size_)) {
+    cerr << "Volume::Append() Failed to write " << path_ << ": "
+         << strerror(errno) << endl;
+    return false;
+  }
+  location->record = size_;
+  location->record_size = record_size;
+  location->length = static_cast<uint32_t>(len);
+  size_ += record_size;
+  return true;
+}
+
+/**
+ * @brief 追加小文件, 已存在的同名小文件被覆盖
+ *
+ * @param key 键(小文件名)
+ * @param data 数据
+ * @param len 数据长度
+ * @return true 成功
+ * @return false 键为空或过长、写入失败
+ */
+bool Volume::Append(const string& key, const char* data, size_t len) {
+  if (key.empty() || key.size() > kMaxKeySize || len > UINT32_MAX) {
+    cerr << "Volume::Append() Invalid key or data size." << endl;
+    return false;
+  }
+  lock_guard<mutex> lock(mutex_);
+  Location location;
+  if (!AppendRecord(key, data, len, false, &location)) return false;
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    live_bytes_ -= it->second.record_size;
+    garbage_bytes_ += it->second.record_size;
+  }
+  index_[key] = location;
+  live_bytes_ += location.record_size;
+  return true;
+}
+
+/**
+ * @brief 删除小文件(追加墓碑记录)
+ *
+ * @param key 键
+ * @return true 成功
+ * @return false 不存在或写入失败
+ */
+bool Volume::Remove(const string& key) {
+  lock_guard<mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) return false;
+  Location tombstone;
+  if (!AppendRecord(key, "", 0, true, &tombstone)) return false;
+  live_bytes_ -= it->second.record_size;
+  garbage_bytes_ += it->second.record_size + tombstone.record_size;
+  index_.erase(it);
+  return true;
+}
+
+/**
+ * @brief 按位置生成小文件引用(需持有`mutex_`)
+ */
+NeedleRef Volume::MakeRef(const string& key, const Location& location) const {
+  NeedleRef ref;
+  ref.file = file_;
+  ref.offset = location.record + kNeedleHeaderSize + key.size();
+  ref.length = location.length;
+  return ref;
+}
+
+/**
+ * @brief 查找小文件的位置
+ *
+ * @param key 键
+ * @param ref 输出位置
+ * @return true 找到
+ * @return false 不存在
+ */
+bool Volume::Lookup(const string& key, NeedleRef* ref) const {
+  lock_guard<mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) return false;
+  *ref = MakeRef(key, it->second);
+  return true;
+}
+
+/**
+ * @brief 读取小文件(一次`pread`), 并校验CRC32C
+ *
+ * @param key 键
+ * @param data 输出数据
+ * @return true 成功
+ * @return false 不存在、读取失败或校验和不匹配
+ */
+bool Volume::Read(const string& key, string* data) const {
+  NeedleRef ref;
+  if (!Lookup(key, &ref)) return false;
+  // 数据和校验和相邻, 一次读出
+  string buffer(ref.length + 4, '\0');
+  if (ReadFull(ref.file->fd, &buffer[0], buffer.size(), ref.offset) !=
+      static_cast<long long>(buffer.size())) {
+    cerr << "Volume::Read() Failed to read " << key << " from " << path_
+         << endl;
+    return false;
+  }
+  uint32_t stored = static_cast<uint32_t>(GetUint(&buffer[ref.length], 4));
+  uint32_t crc = Crc32c::Extend(Crc32c::Value(key.data(), key.size()),
+                                buffer.data(), ref.length);
+  if (stored != crc) {
+    cerr << "Volume::Read() Checksum mismatch for " << key << " in " << path_
+         << endl;
+    return false;
+  }
+  buffer.resize(ref.length);
+  *data = move(buffer);
+  return true;
+}
+
+/**
+ * @brief 从卷文件发送小文件的一部分到socket
+ *
+ * @param sock 目标socket
+ * @param ref 小文件位置
+ * @param pos 小文件内的起始偏移
+ * @return long long 实际发送的字节数, 出错返回-1
+ */
+long long Volume::Send(int sock, const NeedleRef& ref, long long pos) {
+  if (!ref.file || pos < 0 || pos > ref.length) return -1;
+  long long len = ref.length - pos;
+  if (len == 0) return 0;
+#ifdef __linux__
+  off_t offset = ref.offset + pos;
+  return sendfile(sock, ref.file->fd, &offset, len);
+#else
+  char buffer[64 * 1024];
+  long long n = ReadFull(ref.file->fd, buffer,
+                       static_cast<size_t>(min<long long>(len, sizeof(buffer))),
+                       ref.offset + pos);
+  if (n <= 0) return -1;
+  return send(sock, buffer, static_cast<int>(n), 0);
+#endif
+}
+
+/**
+ * @brief 合并卷文件, 回收被覆盖和删除的记录占用的空间
+ *
+ * @return true 成功
+ * @return false 写入新文件失败
+ */
+bool Volume::Compact() {
+  lock_guard<mutex> compact_lock(compact_mutex_);
+  shared_ptr<VolumeFile> old_file;
+  vector<pair<string, Location>> live;
+  long long end = 0;
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (!file_) return false;
+    old_file = file_;
+    live.assign(index_.begin(), index_.end());
+    end = size_;
+  }
+  // 按原顺序复制, 保持顺序读取
+  sort(live.begin(), live.end(),
+       [](const pair<string, Location>& a, const pair<string, Location>& b) {
+         return a.second.record < b.second.record;
+       });
+
+  string temp_path = path_ + ".compact";
+  auto new_file = make_shared<VolumeFile>();
+  new_file->fd = OpenVolumeFile(temp_path, true);
+  string header = VolumeHeader();
+  bool ok = new_file->fd >= 0 &&
+            WriteFull(new_file->fd, header.data(), header.size(), 0);
+  unordered_map<string, Location> new_index;
+  long long pos = kVolumeHeaderSize;
+  string buffer;
+  auto copy = [&](const string& key, const Location& location) {
+    buffer.resize(location.record_size);
+    if (ReadFull(old_file->fd, &buffer[0], buffer.size(), location.record) !=
+            location.record_size ||
+        !WriteFull(new_file->fd, buffer.data(), buffer.size(), pos)) {
+      ok = false;
+      return;
+    }
+    Location moved = location;
+    moved.record = pos;
+    new_index[key] = moved;
+    pos += location.record_size;
+  };
+  for (auto& item : live) {
+    if (!ok) break;
+    copy(item.first, item.second);
+  }
+  if (buffer.capacity() > kCopyBufferSize) string().swap(buffer);
+  ok = ok && SyncFd(new_file->fd);
+
+  lock_guard<mutex> lock(mutex_);
+  if (ok && size_ > end) {
+    // 复制期间追加的记录(包括墓碑)原样补到新文件末尾
+    Scan(old_file->fd, end, size_,
+         [&](const string& key, bool tombstone, const Location& location) {
+           if (!ok) return;
+           copy(key, location);
+           if (tombstone) new_index.erase(key);
+         });
+    ok = ok && SyncFd(new_file->fd);
+  }
+  error_code ec;
+  if (ok) {
+    fs::rename(temp_path, path_, ec);
+    ok = !ec;
+  }
+  if (!ok) {
+    cerr << "Volume::Compact() Failed to compact " << path_ << endl;
+    new_file.reset();
+    fs::remove(temp_path, ec);
+    return false;
+  }
+
+  // 正在读取旧文件的读者持有旧文件的引用, 读完后才关闭
+  file_ = new_file;
+  index_ = move(new_index);
+  size_ = pos;
+  live_bytes_ = 0;
+  for (auto& item : index_) live_bytes_ += item.second.record_size;
+  garbage_bytes_ = size_ - kVolumeHeaderSize - live_bytes_;
+  ++compactions_;
+  return true;
+}
+
+/**
+ * @brief 把卷文件刷到磁盘(`fdatasync`)
+ *
+ * @return true 成功
+ * @return false 刷写失败
+ */
+bool Volume::Sync() {
+  shared_ptr<VolumeFile> file;
+  {
+    lock_guard<mutex> lock(mutex_);
+    file = file_;
+  }
+  return file && SyncFd(file->fd);
+}
+
+/**
+ * @brief 获取所有有效的键
+ */
+vector<string> Volume::Keys() const {
+  lock_guard<mutex> lock(mutex_);
+  vector<string> keys;
+  keys.reserve(index_.size());
+  for (auto& item : index_) keys.push_back(item.first);
+  return keys;
+}
+
+/**
+ * @brief 获取统计信息
+ */
+VolumeStats Volume::stats() const {
+  lock_guard<mutex> lock(mutex_);
+  VolumeStats stats;
+  stats.needles = static_cast<long long>(index_.size());
+  stats.live_bytes = live_bytes_;
+  stats.garbage_bytes = garbage_bytes_;
+  stats.file_size = size_;
+  stats.compactions = compactions_;
+  return stats;
+}
+
+// ==================== VolumeStore ====================
+
+/**
+ * @brief 构造小文件卷存储
+ *
+ * @param dir 卷目录
+ * @param pool 执行后台合并的阻塞I/O线程池, 为`nullptr`时在调用线程中合并
+ * @param threshold 小文件大小上限(字节)
+ * @param max_volume_size 单个卷文件的大小上限(字节)
+ * @param compact_ratio 垃圾占比超过该值时合并卷
+ */
+VolumeStore::VolumeStore(const string& dir, BlockingPool* pool,
+                         size_t threshold, long long max_volume_size,
+                         double compact_ratio)
+    : dir_(dir),
+      pool_(pool),
+      threshold_(threshold),
+      max_volume_size_(max_volume_size),
+      compact_ratio_(compact_ratio) {}
+
+/**
+ * @brief 等待后台合并完成
+ */
+VolumeStore::~VolumeStore() { WaitCompaction(); }
+
+/**
+ * @brief 创建目录并加载已有的卷
+ *
+ * @return true 成功
+ * @return false 创建目录或打开卷失败
+ */
+bool VolumeStore::Open() {
+  error_code ec;
+  fs::create_directories(dir_, ec);
+  if (ec) {
+    cerr << "VolumeStore::Open() Failed to create " << dir_ << ": "
+         << ec.message() << endl;
+    return false;
+  }
+
+  lock_guard<mutex> lock(mutex_);
+  volumes_.clear();
+  keys_.clear();
+  for (auto& entry : fs::directory_iterator(dir_, ec)) {
+    if (entry.path().extension() != ".vol") continue;
+    string stem = entry.path().stem().string();
+    if (stem.empty() ||
+        stem.find_first_not_of("0123456789") != string::npos) {
+      continue;
+    }
+    int id = stoi(stem);
+    auto volume = make_unique<Volume>(entry.path().string());
+    if (!volume->Open()) return false;
+    volumes_[id] = move(volume);
+  }
+  // 按序号从小到大合并索引, 序号大的卷中的记录更新
+  for (auto& item : volumes_) {
+    for (auto& key : item.second->Keys()) {
+      auto it = keys_.find(key);
+      if (it != keys_.end()) volumes_[it->second]->Remove(key);
+      keys_[key] = item.first;
+    }
+  }
+  writable_ = volumes_.empty() ? -1 : volumes_.rbegin()->first;
+  return true;
+}
+
+/**
+ * @brief 获取可写卷, 当前卷已满时创建新卷(需持有`mutex_`)
+ */
+Volume* VolumeStore::Writable() {
+  if (writable_ >= 0 &&
+      volumes_[writable_]->stats().file_size < max_volume_size_) {
+    return volumes_[writable_].get();
+  }
+  int id = writable_ + 1;
+  fs::path path = fs::path(dir_) / (to_string(id) + ".vol");
+  auto volume = make_unique<Volume>(path.string());
+  if (!volume->Open()) return nullptr;
+  Volume* result = volume.get();
+  volumes_[id] = move(volume);
+  writable_ = id;
+  return result;
+}
+
+/**
+ * @brief 保存小文件
+ *
+ * @param key 键(小文件名)
+ * @param data 数据
+ * @param len 数据长度, 必须小于`threshold`
+ * @return true 成功
+ * @return false 数据过大或写入失败
+ */
+bool VolumeStore::Put(const string& key, const char* data, size_t len) {
+  if (!Accepts(len)) {
+    cerr << "VolumeStore::Put() " << key << " is too large for volumes."
+         << endl;
+    return false;
+  }
+  lock_guard<mutex> lock(mutex_);
+  Volume* volume = Writable();
+  if (!volume || !volume->Append(key, data, len)) return false;
+  auto it = keys_.find(key);
+  if (it != keys_.end() && it->second != writable_) {
+    volumes_[it->second]->Remove(key);
+  }
+  keys_[key] = writable_;
+  return true;
+}
+
+/**
+ * @brief 查找小文件的位置
+ *
+ * @param key 键
+ * @param ref 输出位置
+ * @return true 找到
+ * @return false 不存在
+ */
+bool VolumeStore::Lookup(const string& key, NeedleRef* ref) const {
+  lock_guard<mutex> lock(mutex_);
+  auto it = keys_.find(key);
+  if (it == keys_.end()) return false;
+  return volumes_.at(it->second)->Lookup(key, ref);
+}
+
+/**
+ * @brief 读取小文件
+ *
+ * @param key 键
+ * @param data 输出数据
+ * @return true 成功
+ * @return false 不存在或读取失败
+ */
+bool VolumeStore::Get(const string& key, string* data) const {
+  Volume* volume = nullptr;
+  {
+    lock_guard<mutex> lock(mutex_);
+    auto it = keys_.find(key);
+    if (it == keys_.end()) return false;
+    volume = volumes_.at(it->second).get();
+  }
+  // 卷对象在存储的生命周期内不会释放, 读取不持有存储的锁
+  return volume->Read(key, data);
+}
+
+/**
+ * @brief 删除小文件
+ *
+ * @param key 键
+ * @return true 成功
+ * @return false 不存在或写入失败
+ */
+bool VolumeStore::Remove(const string& key) {
+  lock_guard<mutex> lock(mutex_);
+  auto it = keys_.find(key);
+  if (it == keys_.end()) return false;
+  if (!volumes_[it->second]->Remove(key)) return false;
+  keys_.erase(it);
+  return true;
+}
+
+/**
+ * @brief 检查所有卷, 合并垃圾占比超过阈值的卷
+ *
+ * @return int 开始合并的卷数量
+ */
+int VolumeStore::CompactIfNeeded() {
+  vector<Volume*> candidates;
+  {
+    lock_guard<mutex> lock(mutex_);
+    for (auto& item : volumes_) {
+      Volume* volume = item.second.get();
+      if (volume->stats().garbage_ratio() < compact_ratio_) continue;
+      if (find(compacting_.begin(), compacting_.end(), volume) !=
+          compacting_.end()) {
+        continue;
+      }
+      compacting_.push_back(volume);
+      candidates.push_back(volume);
+    }
+  }
+  for (Volume* volume : candidates) {
+    if (pool_ && pool_->Submit([this, volume]() { RunCompaction(volume); })) {
+      continue;
+    }
+    RunCompaction(volume);
+  }
+  return static_cast<int>(candidates.size());
+}
+
+/**
+ * @brief 合并卷(阻塞)并减少进行中的合并计数
+ */
+void VolumeStore::RunCompaction(Volume* volume) {
+  volume->Compact();
+  lock_guard<mutex> lock(mutex_);
+  compacting_.erase(find(compacting_.begin(), compacting_.end(), volume));
+  compacted_.notify_all();
+}
+
+/**
+ * @brief 等待后台合并完成
+ */
+void VolumeStore::WaitCompaction() {
+  unique_lock<mutex> lock(mutex_);
+  compacted_.wait(lock, [this]() { return compacting_.empty(); });
+}
+
+/**
+ * @brief 获取卷数量
+ */
+int VolumeStore::volume_count() const {
+  lock_guard<mutex> lock(mutex_);
+  return static_cast<int>(volumes_.size());
+}
+
+/**
+ * @brief 获取小文件数量
+ */
+long long VolumeStore::size() const {
+  lock_guard<mutex> lock(mutex_);
+  return static_cast<long long>(keys_.size());
+}
+
+/**
+ * @brief 获取每个卷的统计信息
+ */
+vector<VolumeStats> VolumeStore::stats() const {
+  lock_guard<mutex> lock(mutex_);
+  vector<VolumeStats> result;
+  for (auto& item : volumes_) result.push_back(item.second->stats());
+  return result;
+}